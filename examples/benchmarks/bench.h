@@ -24,6 +24,9 @@
 #ifndef IGRAPH_BENCH_H
 #define IGRAPH_BENCH_H
 
+#include <sys/time.h>
+#include <sys/resource.h>
+
 static inline void igraph_get_cpu_time(igraph_real_t *data) {
 
 	struct rusage self, children;
@@ -39,14 +42,25 @@ static inline void igraph_get_cpu_time(igraph_real_t *data) {
 		1e-3 * (children.ru_stime.tv_usec/1000);
 }
 
+/* Elapsed real time, this is what parallel code should decrease */
+
+static inline double igraph_get_wall_time() {
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return (double) tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
 #define BENCH(NAME, ...)	do {														 \
-	double start[4], stop[4];																 \
+	double start[4], stop[4], wstart, wstop;								 \
 	igraph_get_cpu_time(start);															 \
+	wstart=igraph_get_wall_time();													 \
 	{ __VA_ARGS__; };																				 \
+	wstop=igraph_get_wall_time();														 \
 	igraph_get_cpu_time(stop);															 \
-	printf("%s %.3gs\n", NAME,															 \
+	printf("%s %.3gs (wall %.3gs)\n", NAME,									 \
 				 stop[0]+stop[1]+stop[2]+stop[3] -								 \
-				 start[0]-start[1]-start[2]-start[3]);						 \
+				 start[0]-start[1]-start[2]-start[3],							 \
+				 wstop-wstart);																		 \
 	} while (0)
 
 #endif
@@ -0,0 +1,70 @@
+/* -*- mode: C -*-  */
+/* 
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+   
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA 
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+
+#include "bench.h"
+
+/* Run this with different OMP_NUM_THREADS values to see the
+   scaling of the parallel betweenness code. */
+
+#define N 5000
+#define M 25000
+
+int main() {
+
+	igraph_t g;
+	igraph_vector_t res, weights;
+	long int i;
+
+	igraph_rng_seed(igraph_rng_default(), 42);
+	igraph_erdos_renyi_game(&g, IGRAPH_ERDOS_RENYI_GNM, N, M,
+													IGRAPH_UNDIRECTED, IGRAPH_NO_LOOPS);
+	igraph_vector_init(&res, 0);
+	igraph_vector_init(&weights, igraph_ecount(&g));
+	for (i=0; i<igraph_ecount(&g); i++) {
+		VECTOR(weights)[i] = igraph_rng_get_unif(igraph_rng_default(), 1, 10);
+	}
+
+	BENCH("1 Betweenness GNM               ",
+				igraph_betweenness(&g, &res, igraph_vss_all(), IGRAPH_UNDIRECTED,
+													 /*weights=*/ 0, /*nobigint=*/ 1);
+				);
+	BENCH("2 Betweenness GNM, weighted     ",
+				igraph_betweenness(&g, &res, igraph_vss_all(), IGRAPH_UNDIRECTED,
+													 &weights, /*nobigint=*/ 1);
+				);
+	BENCH("3 Edge betweenness GNM          ",
+				igraph_edge_betweenness(&g, &res, IGRAPH_UNDIRECTED,
+																/*weights=*/ 0);
+				);
+	BENCH("4 Edge betweenness GNM, weighted",
+				igraph_edge_betweenness(&g, &res, IGRAPH_UNDIRECTED, &weights);
+				);
+
+	igraph_vector_destroy(&weights);
+	igraph_vector_destroy(&res);
+	igraph_destroy(&g);
+
+	return 0;
+}
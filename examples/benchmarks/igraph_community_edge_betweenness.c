@@ -0,0 +1,89 @@
+/* -*- mode: C -*-  */
+/* 
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+   
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA 
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+
+#include "bench.h"
+
+/* Edge betweenness communities of a planted partition graph. Only
+   the scores of the sources whose shortest paths used the removed
+   edge are recalculated, or the component of the removed edge, if
+   that is cheaper. Run this with different OMP_NUM_THREADS values to
+   see the scaling of the recalculation. */
+
+#define N 400
+#define BLOCKS 8
+
+int main() {
+
+	igraph_t g;
+	igraph_vector_int_t sizes;
+	igraph_matrix_t pref;
+	igraph_vector_t removed, weights, modularity;
+	long int i;
+
+	igraph_rng_seed(igraph_rng_default(), 42);
+	igraph_vector_int_init(&sizes, BLOCKS);
+	igraph_vector_int_fill(&sizes, N / BLOCKS);
+	igraph_matrix_init(&pref, BLOCKS, BLOCKS);
+	igraph_matrix_fill(&pref, 0.5 / N);
+	for (i=0; i<BLOCKS; i++) { MATRIX(pref, i, i) = 6.0 * BLOCKS / N; }
+	igraph_sbm_game(&g, N, &pref, &sizes, IGRAPH_UNDIRECTED, 0);
+	igraph_vector_init(&removed, 0);
+	igraph_vector_init(&modularity, 0);
+
+	BENCH("1 Edge betweenness communities, SBM          ",
+				igraph_community_edge_betweenness(&g, &removed, 0, 0, 0, &modularity,
+																					0, 0, 0);
+				);
+	printf("  %li edges, modularity %g\n", (long int) igraph_ecount(&g),
+				 igraph_vector_max(&modularity));
+
+	igraph_vector_init(&weights, igraph_ecount(&g));
+	for (i=0; i<igraph_ecount(&g); i++) {
+		VECTOR(weights)[i] = igraph_rng_get_unif(igraph_rng_default(), 1, 2);
+	}
+	BENCH("2 Edge betweenness communities, weighted SBM ",
+				igraph_community_edge_betweenness(&g, &removed, 0, 0, 0, &modularity,
+																					0, 0, &weights);
+				);
+	printf("  modularity %g\n", igraph_vector_max(&modularity));
+	igraph_destroy(&g);
+
+	igraph_sbm_game(&g, N, &pref, &sizes, IGRAPH_DIRECTED, 0);
+	BENCH("3 Edge betweenness communities, directed SBM ",
+				igraph_community_edge_betweenness(&g, &removed, 0, 0, 0, &modularity,
+																					0, 1, 0);
+				);
+	printf("  %li edges, modularity %g\n", (long int) igraph_ecount(&g),
+				 igraph_vector_max(&modularity));
+
+	igraph_vector_destroy(&weights);
+	igraph_vector_destroy(&modularity);
+	igraph_vector_destroy(&removed);
+	igraph_matrix_destroy(&pref);
+	igraph_vector_int_destroy(&sizes);
+	igraph_destroy(&g);
+
+	return 0;
+}
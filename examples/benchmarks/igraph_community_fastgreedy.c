@@ -0,0 +1,84 @@
+/* -*- mode: C -*-  */
+/* 
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+   
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA 
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+
+#include "bench.h"
+
+/* Fast greedy modularity optimization on a planted partition graph and
+   on a sparse random graph without community structure, the latter
+   needs many more re-scans of the neighbor lists. */
+
+#define N 50000
+#define BLOCKS 50
+
+int main() {
+
+	igraph_t g;
+	igraph_vector_int_t sizes;
+	igraph_matrix_t pref, merges;
+	igraph_vector_t modularity, weights;
+	long int i;
+
+	igraph_rng_seed(igraph_rng_default(), 42);
+	igraph_vector_int_init(&sizes, BLOCKS);
+	igraph_vector_int_fill(&sizes, N / BLOCKS);
+	igraph_matrix_init(&pref, BLOCKS, BLOCKS);
+	igraph_matrix_fill(&pref, 2.0 / N);
+	for (i=0; i<BLOCKS; i++) { MATRIX(pref, i, i) = 8.0 * BLOCKS / N; }
+	igraph_sbm_game(&g, N, &pref, &sizes, IGRAPH_UNDIRECTED, 0);
+	igraph_matrix_init(&merges, 0, 0);
+	igraph_vector_init(&modularity, 0);
+
+	BENCH("1 Fast greedy communities, SBM             ",
+				igraph_community_fastgreedy(&g, 0, &merges, &modularity, 0);
+				);
+	printf("  %li edges, modularity %g\n", (long int) igraph_ecount(&g),
+				 igraph_vector_max(&modularity));
+
+	igraph_vector_init(&weights, igraph_ecount(&g));
+	for (i=0; i<igraph_ecount(&g); i++) {
+		VECTOR(weights)[i] = RNG_UNIF(0.5, 1.5);
+	}
+	BENCH("2 Fast greedy communities, SBM, weighted   ",
+				igraph_community_fastgreedy(&g, &weights, &merges, &modularity, 0);
+				);
+	printf("  modularity %g\n", igraph_vector_max(&modularity));
+	igraph_vector_destroy(&weights);
+	igraph_destroy(&g);
+
+	igraph_erdos_renyi_game(&g, IGRAPH_ERDOS_RENYI_GNM, N / 4, N, 
+													IGRAPH_UNDIRECTED, 0);
+	BENCH("3 Fast greedy communities, G(n,m), m=4n    ",
+				igraph_community_fastgreedy(&g, 0, &merges, &modularity, 0);
+				);
+	printf("  modularity %g\n", igraph_vector_max(&modularity));
+
+	igraph_vector_destroy(&modularity);
+	igraph_matrix_destroy(&merges);
+	igraph_matrix_destroy(&pref);
+	igraph_vector_int_destroy(&sizes);
+	igraph_destroy(&g);
+
+	return 0;
+}
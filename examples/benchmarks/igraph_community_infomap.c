@@ -0,0 +1,66 @@
+/* -*- mode: C -*-  */
+/* 
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+   
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA 
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+
+#include "bench.h"
+
+/* Infomap on a directed planted partition graph. Run this with
+   different OMP_NUM_THREADS values to see the scaling of the
+   trials. */
+
+#define N 100000
+#define BLOCKS 200
+
+int main() {
+
+	igraph_t g;
+	igraph_vector_int_t sizes;
+	igraph_matrix_t pref;
+	igraph_vector_t membership;
+	igraph_real_t codelength;
+	long int i;
+
+	igraph_rng_seed(igraph_rng_default(), 42);
+	igraph_vector_int_init(&sizes, BLOCKS);
+	igraph_vector_int_fill(&sizes, N / BLOCKS);
+	igraph_matrix_init(&pref, BLOCKS, BLOCKS);
+	igraph_matrix_fill(&pref, 2.0 / N);
+	for (i=0; i<BLOCKS; i++) { MATRIX(pref, i, i) = 8.0 * BLOCKS / N; }
+	igraph_sbm_game(&g, N, &pref, &sizes, IGRAPH_DIRECTED, 0);
+	igraph_vector_init(&membership, 0);
+
+	BENCH("1 Infomap, directed SBM, 4 trials",
+				igraph_community_infomap(&g, 0, 0, 4, &membership, &codelength);
+				);
+	printf("  %li edges, %li communities, code length %g\n",
+				 (long int) igraph_ecount(&g),
+				 (long int) igraph_vector_max(&membership) + 1, codelength);
+
+	igraph_vector_destroy(&membership);
+	igraph_matrix_destroy(&pref);
+	igraph_vector_int_destroy(&sizes);
+	igraph_destroy(&g);
+
+	return 0;
+}
@@ -0,0 +1,78 @@
+/* -*- mode: C -*-  */
+/* 
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+   
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA 
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+
+#include "bench.h"
+
+/* Multilevel community detection on a large planted partition
+   graph. Run this with different OMP_NUM_THREADS values to see the
+   scaling of the local moving phase. The Leiden method optimizes the
+   same modularity, with degrees as vertex weights. */
+
+#define N 1000000
+#define BLOCKS 1000
+
+int main() {
+
+	igraph_t g;
+	igraph_vector_int_t sizes;
+	igraph_matrix_t pref;
+	igraph_vector_t membership, modularity, degree;
+	igraph_real_t quality;
+	long int i;
+
+	igraph_rng_seed(igraph_rng_default(), 42);
+	igraph_vector_int_init(&sizes, BLOCKS);
+	igraph_vector_int_fill(&sizes, N / BLOCKS);
+	igraph_matrix_init(&pref, BLOCKS, BLOCKS);
+	igraph_matrix_fill(&pref, 4.0 / N);
+	for (i=0; i<BLOCKS; i++) { MATRIX(pref, i, i) = 16.0 * BLOCKS / N; }
+	igraph_sbm_game(&g, N, &pref, &sizes, IGRAPH_UNDIRECTED, 0);
+	igraph_vector_init(&membership, 0);
+	igraph_vector_init(&modularity, 0);
+
+	BENCH("1 Multilevel communities, SBM   ",
+				igraph_community_multilevel(&g, 0, &membership, 0, &modularity);
+				);
+	printf("  %li edges, modularity %g\n", (long int) igraph_ecount(&g),
+				 igraph_vector_max(&modularity));
+
+	igraph_vector_init(&degree, 0);
+	igraph_degree(&g, &degree, igraph_vss_all(), IGRAPH_ALL, IGRAPH_LOOPS);
+	BENCH("2 Leiden communities, SBM       ",
+				igraph_community_leiden(&g, 0, &degree, 1.0 / (2 * igraph_ecount(&g)),
+																0.01, 0, 2, &membership, 0, &quality);
+				);
+	printf("  modularity %g\n", quality);
+
+	igraph_vector_destroy(&degree);
+
+	igraph_vector_destroy(&modularity);
+	igraph_vector_destroy(&membership);
+	igraph_matrix_destroy(&pref);
+	igraph_vector_int_destroy(&sizes);
+	igraph_destroy(&g);
+
+	return 0;
+}
@@ -0,0 +1,79 @@
+/* -*- mode: C -*-  */
+/* 
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+   
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA 
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+
+#include "bench.h"
+
+/* Walktrap on a large planted partition graph, with and without a
+   memory limit. Run this with different OMP_NUM_THREADS values to
+   see the scaling of the computation of the initial probability
+   vectors. */
+
+#define N 200000
+#define BLOCKS 2000
+
+int main() {
+
+	igraph_t g;
+	igraph_vector_int_t sizes;
+	igraph_matrix_t pref, merges;
+	igraph_vector_t membership, modularity;
+	igraph_real_t peak;
+	long int i;
+
+	igraph_rng_seed(igraph_rng_default(), 42);
+	igraph_vector_int_init(&sizes, BLOCKS);
+	igraph_vector_int_fill(&sizes, N / BLOCKS);
+	igraph_matrix_init(&pref, BLOCKS, BLOCKS);
+	igraph_matrix_fill(&pref, 0.2 / N);
+	for (i=0; i<BLOCKS; i++) { MATRIX(pref, i, i) = 8.0 * BLOCKS / N; }
+	igraph_sbm_game(&g, N, &pref, &sizes, IGRAPH_UNDIRECTED, 0);
+	igraph_vector_init(&membership, 0);
+	igraph_vector_init(&modularity, 0);
+	igraph_matrix_init(&merges, 0, 0);
+
+	BENCH("1 Walktrap, SBM, no memory limit",
+				igraph_community_walktrap_memory(&g, 0, 4, -1, &merges, &modularity,
+																				 &membership, &peak);
+				);
+	printf("  %li edges, modularity %g, peak memory %.0f MB\n",
+				 (long int) igraph_ecount(&g), igraph_vector_max(&modularity),
+				 peak / 1048576);
+
+	BENCH("2 Walktrap, SBM, 300 MB limit   ",
+				igraph_community_walktrap_memory(&g, 0, 4, 300 * 1048576.0, &merges,
+																				 &modularity, &membership, &peak);
+				);
+	printf("  modularity %g, peak memory %.0f MB\n",
+				 igraph_vector_max(&modularity), peak / 1048576);
+
+	igraph_matrix_destroy(&merges);
+	igraph_vector_destroy(&modularity);
+	igraph_vector_destroy(&membership);
+	igraph_matrix_destroy(&pref);
+	igraph_vector_int_destroy(&sizes);
+	igraph_destroy(&g);
+
+	return 0;
+}
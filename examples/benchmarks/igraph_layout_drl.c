@@ -0,0 +1,66 @@
+/* -*- mode: C -*-  */
+/* 
+   IGraph library.
+   Copyright (C) 2014  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+   
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA 
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+
+#include "bench.h"
+
+/* DrL layout of preferential attachment graphs, with a shortened
+   schedule. The nodes of graphs this large are updated in parallel,
+   run this with different OMP_NUM_THREADS values to see the scaling,
+   the layout is the same. */
+
+int main() {
+
+	igraph_t g;
+	igraph_matrix_t res;
+	igraph_layout_drl_options_t options;
+
+	igraph_layout_drl_options_init(&options, IGRAPH_LAYOUT_DRL_DEFAULT);
+	options.liquid_iterations=10;
+	options.expansion_iterations=10;
+	options.cooldown_iterations=10;
+	options.crunch_iterations=10;
+	options.simmer_iterations=10;
+	igraph_matrix_init(&res, 0, 0);
+
+	igraph_rng_seed(igraph_rng_default(), 42);
+	igraph_barabasi_game(&g, 20000, 1, 2, 0, 0, 1, 0,
+											 IGRAPH_BARABASI_PSUMTREE, 0);
+	BENCH("1 DrL layout, 20000 BA graph, 2D            ",
+				igraph_layout_drl(&g, &res, 0, &options, 0, 0);
+				);
+	igraph_destroy(&g);
+
+	igraph_rng_seed(igraph_rng_default(), 42);
+	igraph_barabasi_game(&g, 10000, 1, 2, 0, 0, 1, 0,
+											 IGRAPH_BARABASI_PSUMTREE, 0);
+	BENCH("2 DrL layout, 10000 BA graph, 3D            ",
+				igraph_layout_drl_3d(&g, &res, 0, &options, 0, 0);
+				);
+	igraph_destroy(&g);
+
+	igraph_matrix_destroy(&res);
+
+	return 0;
+}
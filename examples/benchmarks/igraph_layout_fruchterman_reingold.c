@@ -0,0 +1,93 @@
+/* -*- mode: C -*-  */
+/* 
+   IGraph library.
+   Copyright (C) 2014  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+   
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA 
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+
+#include "bench.h"
+
+/* Fruchterman-Reingold layout of a square lattice, with all-pairs,
+   grid based and Barnes-Hut repulsion. The Barnes-Hut forces are
+   computed in parallel, run this with different OMP_NUM_THREADS
+   values to see the scaling. */
+
+#define SMALL 50
+#define LARGE 200
+
+int main() {
+
+	igraph_t g;
+	igraph_vector_t dims;
+	igraph_matrix_t res;
+
+	igraph_vector_init(&dims, 2);
+	igraph_matrix_init(&res, 0, 0);
+
+	VECTOR(dims)[0]=SMALL; VECTOR(dims)[1]=SMALL;
+	igraph_lattice(&g, &dims, 1, IGRAPH_UNDIRECTED, 0, 0);
+
+	igraph_rng_seed(igraph_rng_default(), 42);
+	BENCH("1 FR layout, 2500 vertices, all pairs, 100 iterations     ",
+				igraph_layout_fruchterman_reingold(&g, &res, 0, 100, 50,
+																					 IGRAPH_LAYOUT_NOGRID, 0,
+																					 0, 0, 0, 0, 0);
+				);
+	igraph_rng_seed(igraph_rng_default(), 42);
+	BENCH("2 FR layout, 2500 vertices, grid, 100 iterations          ",
+				igraph_layout_fruchterman_reingold(&g, &res, 0, 100, 50,
+																					 IGRAPH_LAYOUT_GRID, 0,
+																					 0, 0, 0, 0, 0);
+				);
+	igraph_rng_seed(igraph_rng_default(), 42);
+	BENCH("3 FR layout, 2500 vertices, Barnes-Hut, 100 iterations    ",
+				igraph_layout_fruchterman_reingold(&g, &res, 0, 100, 50,
+																					 IGRAPH_LAYOUT_BARNES_HUT, 0,
+																					 0, 0, 0, 0, 0);
+				);
+	igraph_destroy(&g);
+
+	VECTOR(dims)[0]=LARGE; VECTOR(dims)[1]=LARGE;
+	igraph_lattice(&g, &dims, 1, IGRAPH_UNDIRECTED, 0, 0);
+
+	igraph_rng_seed(igraph_rng_default(), 42);
+	BENCH("4 FR layout, 40000 vertices, grid, 10 iterations          ",
+				igraph_layout_fruchterman_reingold(&g, &res, 0, 10, 200,
+																					 IGRAPH_LAYOUT_GRID, 0,
+																					 0, 0, 0, 0, 0);
+				);
+	igraph_rng_seed(igraph_rng_default(), 42);
+	BENCH("5 FR layout, 40000 vertices, Barnes-Hut, 10 iterations    ",
+				igraph_layout_fruchterman_reingold_bh(&g, &res, 0, 10, 200, 0.8, 0,
+																							0, 0, 0, 0, 0);
+				);
+	igraph_rng_seed(igraph_rng_default(), 42);
+	BENCH("6 3D FR layout, 40000 vertices, Barnes-Hut, 10 iterations ",
+				igraph_layout_fruchterman_reingold_3d_bh(&g, &res, 0, 10, 200, 0.8, 0,
+																								 0, 0, 0, 0, 0, 0, 0);
+				);
+	igraph_destroy(&g);
+
+	igraph_matrix_destroy(&res);
+	igraph_vector_destroy(&dims);
+
+	return 0;
+}
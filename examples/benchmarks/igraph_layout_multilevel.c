@@ -0,0 +1,72 @@
+/* -*- mode: C -*-  */
+/* 
+   IGraph library.
+   Copyright (C) 2014  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+   
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA 
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+
+#include "bench.h"
+
+/* Multilevel layout compared to the Barnes-Hut Fruchterman-Reingold
+   layout of the whole graph, on a lattice and on a preferential
+   attachment graph. */
+
+#define N 10000
+
+int main() {
+
+	igraph_t g;
+	igraph_vector_t dims;
+	igraph_matrix_t res;
+
+	igraph_matrix_init(&res, 0, 0);
+	igraph_vector_init(&dims, 2);
+	VECTOR(dims)[0]=100; VECTOR(dims)[1]=N / 100;
+	igraph_lattice(&g, &dims, 1, IGRAPH_UNDIRECTED, 0, 0);
+
+	igraph_rng_seed(igraph_rng_default(), 42);
+	BENCH("1 FR Barnes-Hut layout, lattice, 500 iterations ",
+				igraph_layout_fruchterman_reingold_bh(&g, &res, 0, 500, 100, 0.8, 0,
+																							0, 0, 0, 0, 0);
+				);
+	igraph_rng_seed(igraph_rng_default(), 42);
+	BENCH("2 Multilevel layout, lattice, 50 iterations     ",
+				igraph_layout_multilevel(&g, &res, 2, 50, 50, 0.8, 0);
+				);
+	igraph_destroy(&g);
+
+	igraph_rng_seed(igraph_rng_default(), 42);
+	igraph_barabasi_game(&g, N, 1, 2, 0, 0, 1, 0, IGRAPH_BARABASI_PSUMTREE, 0);
+	BENCH("3 FR Barnes-Hut layout, BA graph, 500 iterations",
+				igraph_layout_fruchterman_reingold_bh(&g, &res, 0, 500, 100, 0.8, 0,
+																							0, 0, 0, 0, 0);
+				);
+	igraph_rng_seed(igraph_rng_default(), 42);
+	BENCH("4 Multilevel layout, BA graph, 50 iterations    ",
+				igraph_layout_multilevel(&g, &res, 2, 50, 50, 0.8, 0);
+				);
+	igraph_destroy(&g);
+
+	igraph_vector_destroy(&dims);
+	igraph_matrix_destroy(&res);
+
+	return 0;
+}
@@ -0,0 +1,78 @@
+/* -*- mode: C -*-  */
+/* 
+   IGraph library.
+   Copyright (C) 2014  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+   
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA 
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+
+#include "bench.h"
+
+/* Pivot MDS compared to classical MDS, which needs the full distance
+   matrix, and pivot MDS on large preferential attachment graphs. */
+
+int main() {
+
+	igraph_t g;
+	igraph_vector_t dims;
+	igraph_matrix_t res;
+
+	igraph_matrix_init(&res, 0, 0);
+	igraph_vector_init(&dims, 2);
+	VECTOR(dims)[0]=50; VECTOR(dims)[1]=40;
+	igraph_lattice(&g, &dims, 1, IGRAPH_UNDIRECTED, 0, 0);
+
+	igraph_rng_seed(igraph_rng_default(), 42);
+	BENCH("1 MDS layout, 2000 lattice                  ",
+				igraph_layout_mds(&g, &res, 0, 2, 0);
+				);
+	igraph_rng_seed(igraph_rng_default(), 42);
+	BENCH("2 Pivot MDS layout, 2000 lattice, 50 pivots ",
+				igraph_layout_pivot_mds(&g, &res, 2, 50, 0);
+				);
+	igraph_destroy(&g);
+
+	igraph_rng_seed(igraph_rng_default(), 42);
+	igraph_barabasi_game(&g, 200000, 1, 3, 0, 0, 1, 0,
+											 IGRAPH_BARABASI_PSUMTREE, 0);
+	igraph_rng_seed(igraph_rng_default(), 42);
+	BENCH("3 Pivot MDS layout, 200000 BA, 50 pivots    ",
+				igraph_layout_pivot_mds(&g, &res, 2, 50, 0);
+				);
+	igraph_rng_seed(igraph_rng_default(), 42);
+	BENCH("4 Pivot MDS layout, 200000 BA, 100 pivots   ",
+				igraph_layout_pivot_mds(&g, &res, 2, 100, 0);
+				);
+	igraph_destroy(&g);
+
+	igraph_rng_seed(igraph_rng_default(), 42);
+	igraph_barabasi_game(&g, 1000000, 1, 3, 0, 0, 1, 0,
+											 IGRAPH_BARABASI_PSUMTREE, 0);
+	igraph_rng_seed(igraph_rng_default(), 42);
+	BENCH("5 Pivot MDS layout, 1000000 BA, 50 pivots   ",
+				igraph_layout_pivot_mds(&g, &res, 2, 50, 0);
+				);
+	igraph_destroy(&g);
+
+	igraph_vector_destroy(&dims);
+	igraph_matrix_destroy(&res);
+
+	return 0;
+}
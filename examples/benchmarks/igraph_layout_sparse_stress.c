@@ -0,0 +1,74 @@
+/* -*- mode: C -*-  */
+/* 
+   IGraph library.
+   Copyright (C) 2014  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+   
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA 
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+
+#include "bench.h"
+
+/* Sparse stress layout compared to the Kamada-Kawai layout, which
+   needs the full distance matrix, on lattices and on a preferential
+   attachment graph. */
+
+int main() {
+
+	igraph_t g;
+	igraph_vector_t dims;
+	igraph_matrix_t res;
+
+	igraph_matrix_init(&res, 0, 0);
+	igraph_vector_init(&dims, 2);
+	VECTOR(dims)[0]=40; VECTOR(dims)[1]=40;
+	igraph_lattice(&g, &dims, 1, IGRAPH_UNDIRECTED, 0, 0);
+
+	igraph_rng_seed(igraph_rng_default(), 42);
+	BENCH("1 Kamada-Kawai layout, 1600 lattice         ",
+				igraph_layout_kamada_kawai(&g, &res, 0, 16000, 0, 1600, 0,
+																	 0, 0, 0, 0);
+				);
+	igraph_rng_seed(igraph_rng_default(), 42);
+	BENCH("2 Sparse stress layout, 1600 lattice        ",
+				igraph_layout_sparse_stress(&g, &res, 0, 2, 50, 100, 1e-4, 0);
+				);
+	igraph_destroy(&g);
+
+	VECTOR(dims)[0]=100; VECTOR(dims)[1]=100;
+	igraph_lattice(&g, &dims, 1, IGRAPH_UNDIRECTED, 0, 0);
+	igraph_rng_seed(igraph_rng_default(), 42);
+	BENCH("3 Sparse stress layout, 10000 lattice       ",
+				igraph_layout_sparse_stress(&g, &res, 0, 2, 50, 100, 1e-4, 0);
+				);
+	igraph_destroy(&g);
+
+	igraph_rng_seed(igraph_rng_default(), 42);
+	igraph_barabasi_game(&g, 10000, 1, 2, 0, 0, 1, 0,
+											 IGRAPH_BARABASI_PSUMTREE, 0);
+	BENCH("4 Sparse stress layout, 10000 BA graph      ",
+				igraph_layout_sparse_stress(&g, &res, 0, 2, 50, 100, 1e-4, 0);
+				);
+	igraph_destroy(&g);
+
+	igraph_vector_destroy(&dims);
+	igraph_matrix_destroy(&res);
+
+	return 0;
+}
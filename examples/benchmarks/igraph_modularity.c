@@ -0,0 +1,84 @@
+/* -*- mode: C -*-  */
+/* 
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+   
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA 
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+
+#include "bench.h"
+
+/* Scoring many candidate partitions of the same graph, one by one
+   and in batches, and local moves with the modularity tracker. */
+
+#define N 100000
+#define M 1000000
+#define K 256
+
+int main() {
+
+	igraph_t g;
+	igraph_matrix_t memberships;
+	igraph_vector_t row, modularity;
+	igraph_modularity_tracker_t tracker;
+	igraph_real_t q;
+	long int i, j;
+
+	igraph_rng_seed(igraph_rng_default(), 42);
+	igraph_erdos_renyi_game(&g, IGRAPH_ERDOS_RENYI_GNM, N, M,
+													IGRAPH_UNDIRECTED, IGRAPH_NO_LOOPS);
+	igraph_matrix_init(&memberships, K, N);
+	for (i=0; i<K; i++) {
+		for (j=0; j<N; j++) {
+			MATRIX(memberships, i, j) = RNG_INTEGER(0, 99);
+		}
+	}
+	igraph_vector_init(&row, N);
+	igraph_vector_init(&modularity, K);
+
+	BENCH("1 Modularity of 256 partitions, one by one ",
+				for (i=0; i<K; i++) {
+					igraph_matrix_get_row(&memberships, &row, i);
+					igraph_modularity(&g, &row, &VECTOR(modularity)[i], 0);
+				}
+				);
+	BENCH("2 Modularity of 256 partitions, batch      ",
+				igraph_modularity_batch(&g, &memberships, &modularity, 0);
+				);
+
+	igraph_matrix_get_row(&memberships, &row, 0);
+	igraph_modularity_tracker_init(&tracker, &g, &row, 0);
+	BENCH("3 Modularity after 1M moves, tracker       ",
+				for (i=0; i<1000000; i++) {
+					igraph_modularity_tracker_move(&tracker, RNG_INTEGER(0, N-1),
+																				 RNG_INTEGER(0, 99));
+				}
+				q=igraph_modularity_tracker_get(&tracker);
+				);
+	printf("  modularity %g\n", q);
+	igraph_modularity_tracker_destroy(&tracker);
+
+	igraph_vector_destroy(&modularity);
+	igraph_vector_destroy(&row);
+	igraph_matrix_destroy(&memberships);
+	igraph_destroy(&g);
+
+	return 0;
+}
@@ -0,0 +1,85 @@
+/* -*- mode: C -*-  */
+/* 
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard st, Cambridge MA, 02139 USA
+   
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA 
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+
+#include "bench.h"
+
+#define N 1000000
+#define M 10000000
+
+/* Size of the edge index of a graph, in bytes. The six index vectors
+   hold 4|E| + 2(|V|+1) elements. */
+#define INDEX_BYTES(g, elemsize)					\
+	((double) (elemsize) *																	\
+	 (4.0 * igraph_ecount(g) + 2.0 * (igraph_vcount(g) + 1)))
+
+int main() {
+
+	igraph_t g;
+	igraph_vector_t edges, neis;
+	igraph_adjlist_t adjlist;
+	igraph_inclist_t inclist;
+	long int i;
+
+	igraph_rng_seed(igraph_rng_default(), 42);
+	igraph_erdos_renyi_game(&g, IGRAPH_ERDOS_RENYI_GNM, N, M,
+													IGRAPH_DIRECTED, IGRAPH_NO_LOOPS);
+	igraph_vector_init(&edges, 0);
+	igraph_get_edgelist(&g, &edges, /*bycol=*/ 0);
+	igraph_destroy(&g);
+
+	BENCH("1 Create graph         ",
+				igraph_create(&g, &edges, N, IGRAPH_DIRECTED);
+				);
+
+	printf("Edge index: %.0f MB, was %.0f MB with igraph_real_t storage\n",
+				 INDEX_BYTES(&g, sizeof(VECTOR(g.from)[0])) / 1048576.0,
+				 INDEX_BYTES(&g, sizeof(igraph_real_t)) / 1048576.0);
+
+	igraph_vector_init(&neis, 0);
+	BENCH("2 Neighbors, all nodes ",
+				for (i=0; i<N; i++) {
+					igraph_neighbors(&g, &neis, (igraph_integer_t) i, IGRAPH_ALL);
+				}
+				);
+	BENCH("3 Incident, all nodes  ",
+				for (i=0; i<N; i++) {
+					igraph_incident(&g, &neis, (igraph_integer_t) i, IGRAPH_ALL);
+				}
+				);
+	BENCH("4 Adjacency list       ",
+				igraph_adjlist_init(&g, &adjlist, IGRAPH_ALL);
+				);
+	BENCH("5 Incidence list       ",
+				igraph_inclist_init(&g, &inclist, IGRAPH_ALL);
+				);
+
+	igraph_inclist_destroy(&inclist);
+	igraph_adjlist_destroy(&adjlist);
+	igraph_vector_destroy(&neis);
+	igraph_vector_destroy(&edges);
+	igraph_destroy(&g);
+
+	return 0;
+}
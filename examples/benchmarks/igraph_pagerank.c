@@ -0,0 +1,89 @@
+/* -*- mode: C -*-  */
+/* 
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+   
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA 
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+
+#include "bench.h"
+
+/* PageRank of a large sparse graph, with the parallel power method
+   and PRPACK, and personalized PageRank for many seed vertices,
+   batched and one by one. Run this with different OMP_NUM_THREADS
+   values to see the scaling of the power method. */
+
+#define N 1000000
+#define M 10000000
+#define SEEDS 16
+
+int main() {
+
+	igraph_t g;
+	igraph_vector_t res, reset;
+	igraph_matrix_t resets, batch;
+	igraph_pagerank_power_options_t options;
+	long int i;
+
+	igraph_rng_seed(igraph_rng_default(), 42);
+	igraph_erdos_renyi_game(&g, IGRAPH_ERDOS_RENYI_GNM, N, M,
+													IGRAPH_DIRECTED, IGRAPH_NO_LOOPS);
+	igraph_vector_init(&res, 0);
+	options.niter=1000; options.eps=1e-10;
+
+	BENCH("1 PageRank, GNM, power method   ",
+				igraph_pagerank(&g, IGRAPH_PAGERANK_ALGO_POWER, &res, 0,
+												igraph_vss_all(), IGRAPH_DIRECTED, 0.85, 0,
+												&options);
+				);
+	BENCH("2 PageRank, GNM, PRPACK         ",
+				igraph_pagerank(&g, IGRAPH_PAGERANK_ALGO_PRPACK, &res, 0,
+												igraph_vss_all(), IGRAPH_DIRECTED, 0.85, 0, 0);
+				);
+
+	igraph_vector_init(&reset, N);
+	igraph_matrix_init(&resets, N, SEEDS);
+	igraph_matrix_init(&batch, 0, 0);
+	for (i=0; i<SEEDS; i++) {
+		MATRIX(resets, RNG_INTEGER(0, N-1), i) = 1;
+	}
+
+	BENCH("3 Personalized PageRank, GNM, 16 seeds, one by one",
+				for (i=0; i<SEEDS; i++) {
+					igraph_matrix_get_col(&resets, &reset, i);
+					igraph_personalized_pagerank(&g, IGRAPH_PAGERANK_ALGO_POWER, &res,
+																			 0, igraph_vss_all(), IGRAPH_DIRECTED,
+																			 0.85, &reset, 0, &options);
+				}
+				);
+	BENCH("4 Personalized PageRank, GNM, 16 seeds, batched   ",
+				igraph_personalized_pagerank_batch(&g, &batch, igraph_vss_all(),
+																					 IGRAPH_DIRECTED, 0.85, &resets,
+																					 0, &options);
+				);
+
+	igraph_matrix_destroy(&batch);
+	igraph_matrix_destroy(&resets);
+	igraph_vector_destroy(&reset);
+	igraph_vector_destroy(&res);
+	igraph_destroy(&g);
+
+	return 0;
+}
@@ -0,0 +1,65 @@
+/* -*- mode: C -*-  */
+/* 
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+   
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA 
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+#include <stdio.h>
+
+#include "bench.h"
+
+/* Reads a large edge list file. Run this with different
+   OMP_NUM_THREADS values to see the scaling of the parser. */
+
+#define N 1000000
+#define M 10000000
+
+int main() {
+
+	igraph_t g, g2;
+	FILE *file;
+	long int size;
+	double wstart, wstop;
+
+	igraph_rng_seed(igraph_rng_default(), 42);
+	igraph_erdos_renyi_game(&g, IGRAPH_ERDOS_RENYI_GNM, N, M,
+													IGRAPH_DIRECTED, IGRAPH_NO_LOOPS);
+
+	file=tmpfile();
+	if (!file) { return 1; }
+	igraph_write_graph_edgelist(&g, file);
+	fflush(file);
+	size=ftell(file);
+	igraph_destroy(&g);
+
+	rewind(file);
+	wstart=igraph_get_wall_time();
+	BENCH("1 Read edge list, GNM           ",
+				igraph_read_graph_edgelist(&g2, file, 0, IGRAPH_DIRECTED);
+				);
+	wstop=igraph_get_wall_time();
+	printf("  %.1f MB, %.1f MB/s\n", size / 1e6, size / 1e6 / (wstop-wstart));
+	igraph_destroy(&g2);
+
+	fclose(file);
+
+	return 0;
+}
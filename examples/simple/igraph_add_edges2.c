@@ -0,0 +1,113 @@
+/* -*- mode: C -*-  */
+/* 
+   IGraph library.
+   Copyright (C) 2006-2012  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+   
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA 
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+
+/* Add edges in many small batches, so that the edge index is updated
+   incrementally, and compare the result to the graph created in one
+   go. The incident edges come straight from the index, so they must
+   be in exactly the same order. */
+
+int check(const igraph_t *g1, const igraph_t *g2) {
+  igraph_vector_t v1, v2;
+  igraph_neimode_t modes[3] = { IGRAPH_OUT, IGRAPH_IN, IGRAPH_ALL };
+  long int i, m;
+
+  igraph_vector_init(&v1, 0);
+  igraph_vector_init(&v2, 0);
+  for (m=0; m<3; m++) {
+    for (i=0; i<igraph_vcount(g1); i++) {
+      igraph_incident(g1, &v1, (igraph_integer_t) i, modes[m]);
+      igraph_incident(g2, &v2, (igraph_integer_t) i, modes[m]);
+      if (!igraph_vector_all_e(&v1, &v2)) { return 1; }
+      igraph_neighbors(g1, &v1, (igraph_integer_t) i, modes[m]);
+      igraph_neighbors(g2, &v2, (igraph_integer_t) i, modes[m]);
+      if (!igraph_vector_all_e(&v1, &v2)) { return 2; }
+    }
+  }
+  igraph_vector_destroy(&v1);
+  igraph_vector_destroy(&v2);
+  return 0;
+}
+
+int test(igraph_bool_t directed) {
+  igraph_t g, g2;
+  igraph_vector_t edges, batch;
+  long int i, n=100, m=5000, b=7;
+  igraph_integer_t eid1, eid2;
+  int ret;
+
+  /* Random edges with multi-edges and loops */
+  igraph_vector_init(&edges, 2*m);
+  for (i=0; i<2*m; i++) {
+    VECTOR(edges)[i] = igraph_rng_get_integer(igraph_rng_default(), 0, n-1);
+  }
+
+  /* The first batch is large, the rest are small */
+  igraph_vector_init(&batch, 0);
+  igraph_vector_resize(&batch, m);
+  for (i=0; i<m; i++) {
+    VECTOR(batch)[i] = VECTOR(edges)[i];
+  }
+  igraph_create(&g, &batch, (igraph_integer_t) n, directed);
+  for (i=m; i<2*m; i+=2*b) {
+    long int j, len = i+2*b > 2*m ? 2*m-i : 2*b;
+    igraph_vector_resize(&batch, len);
+    for (j=0; j<len; j++) {
+      VECTOR(batch)[j] = VECTOR(edges)[i+j];
+    }
+    igraph_add_edges(&g, &batch, 0);
+  }
+
+  igraph_create(&g2, &edges, (igraph_integer_t) n, directed);
+  if (igraph_ecount(&g) != igraph_ecount(&g2)) { return 10; }
+  if ((ret=check(&g, &g2))) { return ret; }
+
+  /* The same edge id is found for multi-edges */
+  for (i=0; i<2*m; i+=2) {
+    igraph_get_eid(&g, &eid1, (igraph_integer_t) VECTOR(edges)[i],
+		   (igraph_integer_t) VECTOR(edges)[i+1], IGRAPH_DIRECTED,
+		   /*error=*/ 1);
+    igraph_get_eid(&g2, &eid2, (igraph_integer_t) VECTOR(edges)[i],
+		   (igraph_integer_t) VECTOR(edges)[i+1], IGRAPH_DIRECTED,
+		   /*error=*/ 1);
+    if (eid1 != eid2) { return 11; }
+  }
+
+  igraph_vector_destroy(&batch);
+  igraph_vector_destroy(&edges);
+  igraph_destroy(&g2);
+  igraph_destroy(&g);
+  return 0;
+}
+
+int main() {
+  int ret;
+
+  igraph_rng_seed(igraph_rng_default(), 42);
+
+  if ((ret=test(IGRAPH_DIRECTED))) { return ret; }
+  if ((ret=test(IGRAPH_UNDIRECTED))) { return ret+20; }
+
+  return 0;
+}
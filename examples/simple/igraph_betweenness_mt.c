@@ -0,0 +1,128 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+#include <math.h>
+
+/* The betweenness calculations run in parallel if igraph was
+   compiled with OpenMP. Check that the different methods agree with
+   each other, the sequential big integer version and the shortest
+   path lengths. */
+
+int check(const igraph_vector_t *v1, const igraph_vector_t *v2, int code) {
+  long int i, n=igraph_vector_size(v1);
+  if (igraph_vector_size(v2) != n) { return code; }
+  for (i=0; i<n; i++) {
+    igraph_real_t a=VECTOR(*v1)[i], b=VECTOR(*v2)[i];
+    if (fabs(a-b) > 1e-8 * (1+fabs(a))) { return code; }
+  }
+  return 0;
+}
+
+int test(igraph_bool_t directed, igraph_real_t cutoff, int code) {
+  igraph_t g;
+  igraph_vector_t bet, bet2, weights, eb, eb2, subset;
+  igraph_matrix_t dist;
+  igraph_real_t sum, sumdist=0, sumpairs=0;
+  long int i, j, no_of_nodes;
+  int ret;
+
+  igraph_erdos_renyi_game(&g, IGRAPH_ERDOS_RENYI_GNM, 300, 900, directed,
+			  /*loops=*/ 0);
+  no_of_nodes=igraph_vcount(&g);
+  igraph_vector_init(&weights, igraph_ecount(&g));
+  igraph_vector_fill(&weights, 1.0);
+  igraph_vector_init(&bet, 0);
+  igraph_vector_init(&bet2, 0);
+  igraph_vector_init(&eb, 0);
+  igraph_vector_init(&eb2, 0);
+
+  /* Vertex betweenness, parallel vs. big integers vs. weighted */
+  igraph_betweenness_estimate(&g, &bet, igraph_vss_all(), directed, cutoff,
+			      /*weights=*/ 0, /*nobigint=*/ 1);
+  igraph_betweenness_estimate(&g, &bet2, igraph_vss_all(), directed, cutoff,
+			      /*weights=*/ 0, /*nobigint=*/ 0);
+  if ((ret=check(&bet, &bet2, code+1))) { return ret; }
+  igraph_betweenness_estimate(&g, &bet2, igraph_vss_all(), directed, cutoff,
+			      &weights, /*nobigint=*/ 1);
+  if ((ret=check(&bet, &bet2, code+2))) { return ret; }
+
+  /* Subset of the vertices */
+  igraph_vector_init_seq(&subset, 10, 20);
+  igraph_betweenness_estimate(&g, &bet2, igraph_vss_vector(&subset),
+			      directed, cutoff, /*weights=*/ 0, /*nobigint=*/ 1);
+  for (i=0; i<igraph_vector_size(&subset); i++) {
+    if (fabs(VECTOR(bet2)[i] - VECTOR(bet)[10+i]) > 1e-8) { return code+3; }
+  }
+  igraph_vector_destroy(&subset);
+
+  /* Edge betweenness, unweighted vs. weighted */
+  igraph_edge_betweenness_estimate(&g, &eb, directed, cutoff, /*weights=*/ 0);
+  igraph_edge_betweenness_estimate(&g, &eb2, directed, cutoff, &weights);
+  if ((ret=check(&eb, &eb2, code+4))) { return ret; }
+
+  /* Without cutoff, every shortest path of length d goes through
+     d edges and d-1 inner vertices */
+  if (cutoff < 0) {
+    igraph_matrix_init(&dist, 0, 0);
+    igraph_shortest_paths(&g, &dist, igraph_vss_all(), igraph_vss_all(),
+			  directed ? IGRAPH_OUT : IGRAPH_ALL);
+    for (i=0; i<no_of_nodes; i++) {
+      for (j=0; j<no_of_nodes; j++) {
+	igraph_real_t d=MATRIX(dist, i, j);
+	if (i != j && d != IGRAPH_INFINITY) { sumdist += d; sumpairs += 1; }
+      }
+    }
+    if (!directed) { sumdist /= 2; sumpairs /= 2; }
+    igraph_matrix_destroy(&dist);
+
+    if (fabs(igraph_vector_sum(&eb) - sumdist) > 1e-6 * sumdist) {
+      return code+5;
+    }
+    sum=igraph_vector_sum(&bet);
+    if (fabs(sum - (sumdist-sumpairs)) > 1e-6 * sumdist) {
+      return code+6;
+    }
+  }
+
+  igraph_vector_destroy(&eb2);
+  igraph_vector_destroy(&eb);
+  igraph_vector_destroy(&bet2);
+  igraph_vector_destroy(&bet);
+  igraph_vector_destroy(&weights);
+  igraph_destroy(&g);
+  return 0;
+}
+
+int main() {
+  int ret;
+
+  igraph_rng_seed(igraph_rng_default(), 42);
+
+  if ((ret=test(/*directed=*/ 0, /*cutoff=*/ -1, 0)))  { return ret; }
+  if ((ret=test(/*directed=*/ 1, /*cutoff=*/ -1, 10))) { return ret; }
+  if ((ret=test(/*directed=*/ 0, /*cutoff=*/ 3, 20)))  { return ret; }
+  if ((ret=test(/*directed=*/ 1, /*cutoff=*/ 3, 30)))  { return ret; }
+
+  return 0;
+}
@@ -0,0 +1,205 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+#include <math.h>
+
+/* The edge betweenness scores are recalculated in parallel, if
+   igraph was compiled with OpenMP, and only for the sources whose
+   shortest paths used the removed edge. Check the scores of the
+   removed edges against igraph_edge_betweenness(), that repeated runs
+   and unit weights give the same result, and that the planted
+   communities of a stochastic block model are found. */
+
+int run(const igraph_t *g, const igraph_vector_t *weights,
+	igraph_bool_t directed, igraph_vector_t *removed,
+	igraph_vector_t *eb, igraph_vector_t *membership) {
+  igraph_vector_t modularity;
+  int ret;
+  igraph_vector_init(&modularity, 0);
+  ret=igraph_community_edge_betweenness(g, removed, eb, /*merges=*/ 0,
+					/*bridges=*/ 0, &modularity,
+					membership, directed, weights);
+  igraph_vector_destroy(&modularity);
+  return ret;
+}
+
+int check_first(const igraph_t *g, const igraph_vector_t *weights,
+		igraph_bool_t directed, const igraph_vector_t *removed,
+		const igraph_vector_t *eb) {
+  igraph_vector_t all;
+  igraph_real_t max;
+  igraph_vector_init(&all, 0);
+  igraph_edge_betweenness(g, &all, directed, weights);
+  max=igraph_vector_max(&all);
+  if (fabs(VECTOR(*eb)[0] - max) > 1e-8 * max) { return 1; }
+  if (fabs(VECTOR(all)[(long int) VECTOR(*removed)[0]] - max) > 1e-8 * max) {
+    return 1;
+  }
+  igraph_vector_destroy(&all);
+  return 0;
+}
+
+/* Every removed edge has the largest score in the remaining graph */
+
+int check_all(const igraph_t *g, const igraph_vector_t *weights,
+	      igraph_bool_t directed, const igraph_vector_t *removed,
+	      const igraph_vector_t *eb) {
+  igraph_t g2;
+  igraph_vector_t all, ids, w2;
+  long int e, no_of_edges=igraph_ecount(g);
+  int res=0;
+  igraph_vector_init(&all, 0);
+  igraph_vector_init_seq(&ids, 0, no_of_edges-1);
+  igraph_vector_init(&w2, 0);
+  if (weights) { igraph_vector_update(&w2, weights); }
+  igraph_copy(&g2, g);
+  for (e=0; e<no_of_edges-1 && !res; e++) {
+    igraph_real_t max;
+    long int pos;
+    igraph_edge_betweenness(&g2, &all, directed, weights ? &w2 : 0);
+    max=igraph_vector_max(&all);
+    if (fabs(VECTOR(*eb)[e] - max) > 1e-8 * max) { res=1; }
+    /* 'ids' are the original ids of the edges of g2 */
+    igraph_vector_search(&ids, 0, VECTOR(*removed)[e], &pos);
+    igraph_delete_edges(&g2, igraph_ess_1((igraph_integer_t) pos));
+    igraph_vector_remove(&ids, pos);
+    if (weights) { igraph_vector_remove(&w2, pos); }
+  }
+  igraph_destroy(&g2);
+  igraph_vector_destroy(&w2);
+  igraph_vector_destroy(&ids);
+  igraph_vector_destroy(&all);
+  return res;
+}
+
+int main() {
+  igraph_t g;
+  igraph_vector_int_t sizes;
+  igraph_matrix_t pref;
+  igraph_vector_t removed, removed2, eb, eb2, membership, membership2;
+  igraph_vector_t planted, weights, sorted;
+  igraph_real_t nmi;
+  long int i;
+
+  igraph_rng_seed(igraph_rng_default(), 42);
+
+  /* 4 blocks of 25 vertices */
+  igraph_vector_int_init(&sizes, 4);
+  igraph_vector_int_fill(&sizes, 25);
+  igraph_matrix_init(&pref, 4, 4);
+  igraph_matrix_fill(&pref, 0.01);
+  for (i=0; i<4; i++) { MATRIX(pref, i, i) = 0.4; }
+  igraph_sbm_game(&g, 100, &pref, &sizes, IGRAPH_UNDIRECTED, /*loops=*/ 0);
+  igraph_vector_init(&planted, 100);
+  for (i=0; i<100; i++) { VECTOR(planted)[i] = i / 25; }
+
+  igraph_vector_init(&removed, 0);
+  igraph_vector_init(&removed2, 0);
+  igraph_vector_init(&eb, 0);
+  igraph_vector_init(&eb2, 0);
+  igraph_vector_init(&membership, 0);
+  igraph_vector_init(&membership2, 0);
+  igraph_vector_init(&sorted, 0);
+
+  /* Unweighted */
+  run(&g, 0, 0, &removed, &eb, &membership);
+  if (check_first(&g, 0, 0, &removed, &eb)) { return 1; }
+  igraph_vector_update(&sorted, &removed);
+  igraph_vector_sort(&sorted);
+  for (i=0; i<igraph_vector_size(&sorted); i++) {
+    if (VECTOR(sorted)[i] != i) { return 2; }
+  }
+  igraph_compare_communities(&membership, &planted, &nmi,
+			     IGRAPH_COMMCMP_NMI);
+  if (nmi < 0.99) { return 3; }
+
+  /* Again */
+  run(&g, 0, 0, &removed2, &eb2, &membership2);
+  if (!igraph_vector_all_e(&removed, &removed2)) { return 4; }
+  if (!igraph_vector_all_e(&eb, &eb2)) { return 5; }
+  if (!igraph_vector_all_e(&membership, &membership2)) { return 6; }
+
+  /* Unit weights */
+  igraph_vector_init(&weights, igraph_ecount(&g));
+  igraph_vector_fill(&weights, 1.0);
+  run(&g, &weights, 0, &removed2, &eb2, &membership2);
+  if (!igraph_vector_all_e(&removed, &removed2)) { return 11; }
+  for (i=0; i<igraph_vector_size(&eb); i++) {
+    if (fabs(VECTOR(eb)[i] - VECTOR(eb2)[i]) > 1e-8 * VECTOR(eb)[i]) {
+      return 12;
+    }
+  }
+
+  /* Random weights */
+  for (i=0; i<igraph_ecount(&g); i++) {
+    VECTOR(weights)[i] = igraph_rng_get_unif(igraph_rng_default(), 1, 2);
+  }
+  run(&g, &weights, 0, &removed, &eb, &membership);
+  if (check_first(&g, &weights, 0, &removed, &eb)) { return 13; }
+  run(&g, &weights, 0, &removed2, &eb2, &membership2);
+  if (!igraph_vector_all_e(&removed, &removed2)) { return 14; }
+  if (!igraph_vector_all_e(&membership, &membership2)) { return 15; }
+  igraph_vector_destroy(&weights);
+  igraph_destroy(&g);
+
+  /* Directed */
+  igraph_sbm_game(&g, 100, &pref, &sizes, IGRAPH_DIRECTED, /*loops=*/ 0);
+  run(&g, 0, 1, &removed, &eb, &membership);
+  if (check_first(&g, 0, 1, &removed, &eb)) { return 21; }
+  run(&g, 0, 1, &removed2, &eb2, &membership2);
+  if (!igraph_vector_all_e(&removed, &removed2)) { return 22; }
+  if (!igraph_vector_all_e(&eb, &eb2)) { return 23; }
+  if (check_all(&g, 0, 1, &removed, &eb)) { return 24; }
+  igraph_destroy(&g);
+
+  /* A random geometric graph, here the removed edge is often only on
+     the shortest paths from a few sources, and their contributions
+     are updated instead of recalculating the component */
+  igraph_grg_game(&g, 100, 0.2, /*torus=*/ 0, 0, 0);
+  run(&g, 0, 0, &removed, &eb, &membership);
+  if (check_all(&g, 0, 0, &removed, &eb)) { return 25; }
+  igraph_vector_init(&weights, igraph_ecount(&g));
+  for (i=0; i<igraph_ecount(&g); i++) {
+    VECTOR(weights)[i] = igraph_rng_get_unif(igraph_rng_default(), 1, 2);
+  }
+  run(&g, &weights, 0, &removed, &eb, &membership);
+  if (check_all(&g, &weights, 0, &removed, &eb)) { return 26; }
+  igraph_vector_destroy(&weights);
+
+  igraph_vector_destroy(&sorted);
+  igraph_vector_destroy(&membership2);
+  igraph_vector_destroy(&membership);
+  igraph_vector_destroy(&eb2);
+  igraph_vector_destroy(&eb);
+  igraph_vector_destroy(&removed2);
+  igraph_vector_destroy(&removed);
+  igraph_vector_destroy(&planted);
+  igraph_matrix_destroy(&pref);
+  igraph_vector_int_destroy(&sizes);
+  igraph_destroy(&g);
+
+  if (IGRAPH_FINALLY_STACK_SIZE() != 0) { return 30; }
+
+  return 0;
+}
@@ -0,0 +1,149 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+#include <math.h>
+
+/* The runs of igraph_community_ensemble() run in parallel, if igraph
+   was compiled with OpenMP. Check that the result does not depend on
+   the scheduling of the runs, that the outputs are consistent, and
+   that the planted communities of a stochastic block model are
+   found by all methods. */
+
+int run(const igraph_t *g, igraph_community_ensemble_method_t method,
+	igraph_integer_t runs, igraph_real_t threshold,
+	igraph_vector_t *membership, igraph_real_t *modularity,
+	igraph_matrix_t *memberships, igraph_vector_t *coassignment) {
+  igraph_rng_seed(igraph_rng_default(), 42);
+  return igraph_community_ensemble(g, 0, method, runs, threshold,
+				   membership, modularity, memberships,
+				   coassignment);
+}
+
+int check(const igraph_t *g, igraph_community_ensemble_method_t method,
+	  const igraph_vector_t *planted) {
+  igraph_vector_t membership, membership2, coassignment;
+  igraph_matrix_t memberships;
+  igraph_real_t modularity, modularity2, q, nmi;
+  long int i;
+
+  igraph_vector_init(&membership, 0);
+  igraph_vector_init(&membership2, 0);
+  igraph_vector_init(&coassignment, 0);
+  igraph_matrix_init(&memberships, 0, 0);
+
+  run(g, method, 10, 0.5, &membership, &modularity, &memberships,
+      &coassignment);
+  run(g, method, 10, 0.5, &membership2, &modularity2, 0, 0);
+  if (modularity != modularity2) { return 1; }
+  if (!igraph_vector_all_e(&membership, &membership2)) { return 2; }
+
+  igraph_modularity(g, &membership, &q, 0);
+  if (fabs(q - modularity) > 1e-10) { return 3; }
+  igraph_compare_communities(&membership, planted, &nmi,
+			     IGRAPH_COMMCMP_NMI);
+  if (nmi < 0.99) { return 4; }
+
+  if (igraph_matrix_nrow(&memberships) != 10 ||
+      igraph_matrix_ncol(&memberships) != igraph_vcount(g)) {
+    return 5;
+  }
+  if (MATRIX(memberships, 0, 0) != 0) { return 6; }
+  if (igraph_vector_size(&coassignment) != igraph_ecount(g)) { return 7; }
+  for (i=0; i<igraph_ecount(g); i++) {
+    igraph_real_t w=VECTOR(coassignment)[i], same=0;
+    long int r, from=IGRAPH_FROM(g, i), to=IGRAPH_TO(g, i);
+    for (r=0; r<10; r++) {
+      if (MATRIX(memberships, r, from) == MATRIX(memberships, r, to)) {
+	same++;
+      }
+    }
+    if (w != same / 10) { return 8; }
+  }
+
+  igraph_matrix_destroy(&memberships);
+  igraph_vector_destroy(&coassignment);
+  igraph_vector_destroy(&membership2);
+  igraph_vector_destroy(&membership);
+  return 0;
+}
+
+int main() {
+  igraph_t g;
+  igraph_vector_int_t sizes;
+  igraph_matrix_t pref;
+  igraph_vector_t planted, membership;
+  igraph_real_t modularity;
+  long int i;
+  int ret;
+
+  igraph_rng_seed(igraph_rng_default(), 42);
+
+  /* 4 blocks of 50 vertices */
+  igraph_vector_int_init(&sizes, 4);
+  igraph_vector_int_fill(&sizes, 50);
+  igraph_matrix_init(&pref, 4, 4);
+  igraph_matrix_fill(&pref, 0.01);
+  for (i=0; i<4; i++) { MATRIX(pref, i, i) = 0.3; }
+  igraph_sbm_game(&g, 200, &pref, &sizes, IGRAPH_UNDIRECTED, /*loops=*/ 0);
+  igraph_vector_init(&planted, 200);
+  for (i=0; i<200; i++) { VECTOR(planted)[i] = i / 50; }
+
+  if ((ret=check(&g, IGRAPH_ENSEMBLE_MULTILEVEL, &planted))) {
+    return ret;
+  }
+  if ((ret=check(&g, IGRAPH_ENSEMBLE_LABEL_PROPAGATION, &planted))) {
+    return 10+ret;
+  }
+  if ((ret=check(&g, IGRAPH_ENSEMBLE_INFOMAP, &planted))) {
+    return 20+ret;
+  }
+
+  /* Invalid arguments */
+  igraph_vector_init(&membership, 0);
+  igraph_set_error_handler(igraph_error_handler_ignore);
+  if (run(&g, IGRAPH_ENSEMBLE_MULTILEVEL, 0, 0.5, &membership, &modularity,
+	  0, 0) != IGRAPH_EINVAL) {
+    return 31;
+  }
+  if (run(&g, IGRAPH_ENSEMBLE_MULTILEVEL, 10, 1.5, &membership, &modularity,
+	  0, 0) != IGRAPH_EINVAL) {
+    return 32;
+  }
+  igraph_destroy(&g);
+  igraph_ring(&g, 10, IGRAPH_DIRECTED, 0, 1);
+  if (run(&g, IGRAPH_ENSEMBLE_MULTILEVEL, 10, 0.5, &membership, &modularity,
+	  0, 0) != IGRAPH_UNIMPLEMENTED) {
+    return 33;
+  }
+
+  igraph_vector_destroy(&membership);
+  igraph_vector_destroy(&planted);
+  igraph_matrix_destroy(&pref);
+  igraph_vector_int_destroy(&sizes);
+  igraph_destroy(&g);
+
+  if (IGRAPH_FINALLY_STACK_SIZE() != 0) { return 40; }
+
+  return 0;
+}
@@ -0,0 +1,94 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+
+/* The trials of Infomap run in parallel, if igraph was compiled with
+   OpenMP. Check that the planted communities of a directed stochastic
+   block model are found, and that the result only depends on the
+   seed of the default random number generator. */
+
+int main() {
+  igraph_t g;
+  igraph_vector_int_t sizes;
+  igraph_matrix_t pref;
+  igraph_vector_t membership, membership2, planted, weights;
+  igraph_real_t nmi, codelength, codelength2;
+  long int i, no_of_edges;
+
+  igraph_rng_seed(igraph_rng_default(), 42);
+
+  /* 20 blocks of 500 vertices */
+  igraph_vector_int_init(&sizes, 20);
+  igraph_vector_int_fill(&sizes, 500);
+  igraph_matrix_init(&pref, 20, 20);
+  igraph_matrix_fill(&pref, 0.0002);
+  for (i=0; i<20; i++) { MATRIX(pref, i, i) = 0.02; }
+  igraph_sbm_game(&g, 10000, &pref, &sizes, IGRAPH_DIRECTED,
+		  /*loops=*/ 0);
+  igraph_vector_init(&planted, 10000);
+  for (i=0; i<10000; i++) { VECTOR(planted)[i] = i / 500; }
+  no_of_edges=igraph_ecount(&g);
+
+  igraph_vector_init(&membership, 0);
+  igraph_vector_init(&membership2, 0);
+  igraph_rng_seed(igraph_rng_default(), 42);
+  igraph_community_infomap(&g, 0, 0, /*nb_trials=*/ 8, &membership,
+			   &codelength);
+  igraph_compare_communities(&membership, &planted, &nmi, IGRAPH_COMMCMP_NMI);
+  if (nmi < 0.99) { return 1; }
+
+  /* Same seed, same result */
+  igraph_rng_seed(igraph_rng_default(), 42);
+  igraph_community_infomap(&g, 0, 0, /*nb_trials=*/ 8, &membership2,
+			   &codelength2);
+  if (codelength != codelength2) { return 2; }
+  if (!igraph_vector_all_e(&membership, &membership2)) { return 3; }
+
+  /* Weighted, the code length is optional */
+  igraph_vector_init(&weights, no_of_edges);
+  for (i=0; i<no_of_edges; i++) { VECTOR(weights)[i] = RNG_UNIF(0.5, 1.5); }
+  igraph_community_infomap(&g, &weights, 0, /*nb_trials=*/ 3, &membership, 0);
+  igraph_compare_communities(&membership, &planted, &nmi, IGRAPH_COMMCMP_NMI);
+  if (nmi < 0.99) { return 4; }
+
+  /* Wrong weight vector length */
+  igraph_set_error_handler(igraph_error_handler_ignore);
+  igraph_vector_resize(&weights, no_of_edges - 1);
+  if (igraph_community_infomap(&g, &weights, 0, 3, &membership, 0) !=
+      IGRAPH_EINVAL) {
+    return 5;
+  }
+
+  igraph_vector_destroy(&weights);
+  igraph_vector_destroy(&membership2);
+  igraph_vector_destroy(&membership);
+  igraph_vector_destroy(&planted);
+  igraph_matrix_destroy(&pref);
+  igraph_vector_int_destroy(&sizes);
+  igraph_destroy(&g);
+
+  if (IGRAPH_FINALLY_STACK_SIZE() != 0) { return 6; }
+
+  return 0;
+}
@@ -0,0 +1,97 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+#include <igraph.h>
+
+/* Label propagation updates the vertices of a round in parallel on
+   large graphs, if igraph was compiled with OpenMP. Check that the
+   planted communities of a stochastic block model are found, and
+   that fixed labels are kept and spread. */
+
+int main() {
+  igraph_t g;
+  igraph_vector_int_t sizes;
+  igraph_matrix_t pref;
+  igraph_vector_t membership, planted, weights, initial;
+  igraph_vector_bool_t fixed;
+  igraph_real_t nmi, modularity, q;
+  long int i, no_of_edges;
+
+  igraph_rng_seed(igraph_rng_default(), 42);
+
+  /* 40 blocks of 500 vertices */
+  igraph_vector_int_init(&sizes, 40);
+  igraph_vector_int_fill(&sizes, 500);
+  igraph_matrix_init(&pref, 40, 40);
+  igraph_matrix_fill(&pref, 0.0002);
+  for (i=0; i<40; i++) { MATRIX(pref, i, i) = 0.03; }
+  igraph_sbm_game(&g, 20000, &pref, &sizes, IGRAPH_UNDIRECTED,
+		  /*loops=*/ 0);
+  igraph_vector_init(&planted, 20000);
+  for (i=0; i<20000; i++) { VECTOR(planted)[i] = i / 500; }
+  no_of_edges=igraph_ecount(&g);
+
+  igraph_vector_init(&membership, 0);
+  igraph_community_label_propagation(&g, &membership, 0, 0, 0, &modularity);
+  igraph_compare_communities(&membership, &planted, &nmi, IGRAPH_COMMCMP_NMI);
+  if (nmi < 0.99) { return 1; }
+  igraph_modularity(&g, &membership, &q, 0);
+  if (q != modularity) { return 2; }
+
+  /* Weighted */
+  igraph_vector_init(&weights, no_of_edges);
+  for (i=0; i<no_of_edges; i++) { VECTOR(weights)[i] = RNG_UNIF(0.5, 1.5); }
+  igraph_community_label_propagation(&g, &membership, &weights, 0, 0, 0);
+  igraph_compare_communities(&membership, &planted, &nmi, IGRAPH_COMMCMP_NMI);
+  if (nmi < 0.99) { return 3; }
+
+  /* Ten fixed seed vertices in every block, the others are
+     unlabeled. The seeds keep their labels, and every vertex gets
+     one. */
+  igraph_vector_init(&initial, 20000);
+  igraph_vector_fill(&initial, -1);
+  igraph_vector_bool_init(&fixed, 20000);
+  for (i=0; i<400; i++) {
+    VECTOR(initial)[i*50] = 39 - i/10;
+    VECTOR(fixed)[i*50] = 1;
+  }
+  igraph_community_label_propagation(&g, &membership, 0, &initial, &fixed, 0);
+  if (igraph_vector_min(&membership) < 0) { return 4; }
+  igraph_compare_communities(&membership, &planted, &nmi, IGRAPH_COMMCMP_NMI);
+  if (nmi < 0.99) { return 5; }
+  for (i=0; i<400; i++) {
+    if (VECTOR(membership)[i*50] != i/10) { return 6; }
+  }
+
+  igraph_vector_bool_destroy(&fixed);
+  igraph_vector_destroy(&initial);
+  igraph_vector_destroy(&weights);
+  igraph_vector_destroy(&membership);
+  igraph_vector_destroy(&planted);
+  igraph_matrix_destroy(&pref);
+  igraph_vector_int_destroy(&sizes);
+  igraph_destroy(&g);
+
+  if (IGRAPH_FINALLY_STACK_SIZE() != 0) { return 7; }
+
+  return 0;
+}
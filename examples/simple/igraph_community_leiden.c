@@ -0,0 +1,154 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+#include <math.h>
+
+/* Every community must induce a connected subgraph */
+int check_connected(const igraph_t *g, const igraph_vector_t *membership,
+		    igraph_integer_t nb_clusters, int code) {
+  igraph_vector_t vids;
+  igraph_t sub;
+  igraph_bool_t conn;
+  long int i, c, n=igraph_vcount(g);
+
+  if (nb_clusters != igraph_vector_max(membership) + 1) { return code; }
+  igraph_vector_init(&vids, 0);
+  for (c=0; c<nb_clusters; c++) {
+    igraph_vector_clear(&vids);
+    for (i=0; i<n; i++) {
+      if (VECTOR(*membership)[i] == c) { igraph_vector_push_back(&vids, i); }
+    }
+    igraph_induced_subgraph(g, &sub, igraph_vss_vector(&vids),
+			    IGRAPH_SUBGRAPH_AUTO);
+    igraph_is_connected(&sub, &conn, IGRAPH_WEAK);
+    igraph_destroy(&sub);
+    if (!conn) { return code+1; }
+  }
+  igraph_vector_destroy(&vids);
+  return 0;
+}
+
+int main() {
+  igraph_t g;
+  igraph_vector_int_t sizes;
+  igraph_matrix_t pref;
+  igraph_vector_t membership, planted, degree, weights;
+  igraph_integer_t nb_clusters;
+  igraph_real_t quality, q, nmi;
+  long int i, no_of_edges;
+  int ret;
+
+  igraph_rng_seed(igraph_rng_default(), 42);
+
+  /* 20 blocks of 100 vertices */
+  igraph_vector_int_init(&sizes, 20);
+  igraph_vector_int_fill(&sizes, 100);
+  igraph_matrix_init(&pref, 20, 20);
+  igraph_matrix_fill(&pref, 0.002);
+  for (i=0; i<20; i++) { MATRIX(pref, i, i) = 0.15; }
+  igraph_sbm_game(&g, 2000, &pref, &sizes, IGRAPH_UNDIRECTED,
+		  /*loops=*/ 0);
+  igraph_vector_init(&planted, 2000);
+  for (i=0; i<2000; i++) { VECTOR(planted)[i] = i / 100; }
+  no_of_edges=igraph_ecount(&g);
+
+  /* Modularity: the degrees are the vertex weights */
+  igraph_vector_init(&membership, 0);
+  igraph_vector_init(&degree, 0);
+  igraph_degree(&g, &degree, igraph_vss_all(), IGRAPH_ALL, IGRAPH_LOOPS);
+  igraph_community_leiden(&g, 0, &degree, 1.0 / (2 * no_of_edges), 0.01,
+			  /*start=*/ 0, /*n_iterations=*/ -1, &membership,
+			  &nb_clusters, &quality);
+  igraph_modularity(&g, &membership, &q, 0);
+  if (fabs(q - quality) > 1e-10) { return 1; }
+  igraph_compare_communities(&membership, &planted, &nmi, IGRAPH_COMMCMP_NMI);
+  if (nmi < 0.99) { return 2; }
+  if ((ret=check_connected(&g, &membership, nb_clusters, 3))) { return ret; }
+
+  /* Starting from the planted partition does not make it worse */
+  igraph_vector_update(&membership, &planted);
+  igraph_modularity(&g, &planted, &q, 0);
+  igraph_community_leiden(&g, 0, &degree, 1.0 / (2 * no_of_edges), 0.01,
+			  /*start=*/ 1, /*n_iterations=*/ 2, &membership,
+			  &nb_clusters, &quality);
+  if (quality < q - 1e-10) { return 5; }
+
+  /* CPM, with weights. The resolution is between the densities
+     inside and between the blocks. */
+  igraph_vector_init(&weights, no_of_edges);
+  for (i=0; i<no_of_edges; i++) { VECTOR(weights)[i] = RNG_UNIF(0.5, 1.5); }
+  igraph_community_leiden(&g, &weights, 0, 0.02, 0.01, /*start=*/ 0,
+			  /*n_iterations=*/ 2, &membership, &nb_clusters,
+			  &quality);
+  igraph_compare_communities(&membership, &planted, &nmi, IGRAPH_COMMCMP_NMI);
+  if (nmi < 0.99) { return 6; }
+  if ((ret=check_connected(&g, &membership, nb_clusters, 7))) { return ret; }
+
+  /* A high resolution gives many small, connected communities, and
+     no randomness is allowed as well */
+  igraph_community_leiden(&g, 0, 0, 0.5, 0, /*start=*/ 0,
+			  /*n_iterations=*/ 1, &membership, &nb_clusters,
+			  &quality);
+  if (nb_clusters <= 20) { return 9; }
+  if ((ret=check_connected(&g, &membership, nb_clusters, 10))) { return ret; }
+
+  /* Errors */
+  igraph_set_error_handler(igraph_error_handler_ignore);
+  igraph_vector_resize(&weights, 10);
+  ret=igraph_community_leiden(&g, &weights, 0, 0.02, 0.01, 0, 1,
+			      &membership, 0, 0);
+  if (ret != IGRAPH_EINVAL) { return 12; }
+  igraph_vector_resize(&degree, 10);
+  ret=igraph_community_leiden(&g, 0, &degree, 0.02, 0.01, 0, 1,
+			      &membership, 0, 0);
+  if (ret != IGRAPH_EINVAL) { return 13; }
+  igraph_destroy(&g);
+  igraph_small(&g, 3, IGRAPH_DIRECTED, 0,1, 1,2, -1);
+  ret=igraph_community_leiden(&g, 0, 0, 0.02, 0.01, 0, 1,
+			      &membership, 0, 0);
+  if (ret != IGRAPH_UNIMPLEMENTED) { return 14; }
+  igraph_set_error_handler(igraph_error_handler_abort);
+  igraph_destroy(&g);
+
+  /* Null graph */
+  igraph_empty(&g, 0, IGRAPH_UNDIRECTED);
+  igraph_community_leiden(&g, 0, 0, 1, 0.01, 0, -1, &membership,
+			  &nb_clusters, &quality);
+  if (nb_clusters != 0 || igraph_vector_size(&membership) != 0 ||
+      !igraph_is_nan(quality)) {
+    return 15;
+  }
+  igraph_destroy(&g);
+
+  igraph_vector_destroy(&weights);
+  igraph_vector_destroy(&degree);
+  igraph_vector_destroy(&planted);
+  igraph_vector_destroy(&membership);
+  igraph_matrix_destroy(&pref);
+  igraph_vector_int_destroy(&sizes);
+
+  if (IGRAPH_FINALLY_STACK_SIZE() != 0) { return 16; }
+
+  return 0;
+}
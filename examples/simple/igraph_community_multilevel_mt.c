@@ -0,0 +1,121 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+#include <math.h>
+
+/* The local moving phase of the multi-level method runs in parallel
+   on large graphs, if igraph was compiled with OpenMP. Check that the
+   reported modularities match the membership vectors, and that the
+   planted communities of a stochastic block model are found. */
+
+int check_levels(const igraph_t *g, const igraph_vector_t *weights,
+		 const igraph_vector_t *membership,
+		 const igraph_matrix_t *memberships,
+		 const igraph_vector_t *modularity, int code) {
+  igraph_vector_t row;
+  igraph_real_t q;
+  long int i, n=igraph_matrix_nrow(memberships);
+
+  if (n == 0 || igraph_vector_size(modularity) != n) { return code; }
+  igraph_vector_init(&row, 0);
+  for (i=0; i<n; i++) {
+    igraph_matrix_get_row(memberships, &row, i);
+    igraph_modularity(g, &row, &q, weights);
+    if (fabs(q - VECTOR(*modularity)[i]) > 1e-10) { return code+1; }
+    if (i > 0 && VECTOR(*modularity)[i] <= VECTOR(*modularity)[i-1]) {
+      return code+2;
+    }
+  }
+  if (!igraph_vector_all_e(&row, membership)) { return code+3; }
+  igraph_vector_destroy(&row);
+  return 0;
+}
+
+int main() {
+  igraph_t g;
+  igraph_vector_int_t sizes;
+  igraph_matrix_t pref, memberships;
+  igraph_vector_t membership, modularity, weights, planted;
+  igraph_real_t nmi;
+  long int i, no_of_edges;
+  int ret;
+
+  igraph_rng_seed(igraph_rng_default(), 42);
+
+  /* 40 blocks of 500 vertices */
+  igraph_vector_int_init(&sizes, 40);
+  igraph_vector_int_fill(&sizes, 500);
+  igraph_matrix_init(&pref, 40, 40);
+  igraph_matrix_fill(&pref, 0.0002);
+  for (i=0; i<40; i++) { MATRIX(pref, i, i) = 0.03; }
+  igraph_sbm_game(&g, 20000, &pref, &sizes, IGRAPH_UNDIRECTED,
+		  /*loops=*/ 1);
+  igraph_vector_init(&planted, 20000);
+  for (i=0; i<20000; i++) { VECTOR(planted)[i] = i / 500; }
+
+  igraph_vector_init(&membership, 0);
+  igraph_vector_init(&modularity, 0);
+  igraph_matrix_init(&memberships, 0, 0);
+  igraph_community_multilevel(&g, 0, &membership, &memberships, &modularity);
+  if ((ret=check_levels(&g, 0, &membership, &memberships, &modularity, 10))) {
+    return ret;
+  }
+  igraph_compare_communities(&membership, &planted, &nmi,
+			     IGRAPH_COMMCMP_NMI);
+  if (nmi < 0.99) { return 14; }
+
+  /* Weighted, with multiple edges */
+  no_of_edges=igraph_ecount(&g);
+  igraph_vector_init(&weights, no_of_edges);
+  for (i=0; i<no_of_edges; i++) { VECTOR(weights)[i] = RNG_UNIF(0.5, 2); }
+  igraph_vector_resize(&weights, no_of_edges + 1000);
+  for (i=0; i<1000; i++) {
+    igraph_integer_t from, to;
+    igraph_edge(&g, (igraph_integer_t) i, &from, &to);
+    igraph_add_edge(&g, from, to);
+    VECTOR(weights)[no_of_edges+i] = 1;
+  }
+  igraph_community_multilevel(&g, &weights, &membership, &memberships,
+			      &modularity);
+  if ((ret=check_levels(&g, &weights, &membership, &memberships, &modularity,
+			20))) {
+    return ret;
+  }
+  igraph_compare_communities(&membership, &planted, &nmi,
+			     IGRAPH_COMMCMP_NMI);
+  if (nmi < 0.99) { return 24; }
+
+  igraph_matrix_destroy(&memberships);
+  igraph_vector_destroy(&modularity);
+  igraph_vector_destroy(&membership);
+  igraph_vector_destroy(&weights);
+  igraph_vector_destroy(&planted);
+  igraph_matrix_destroy(&pref);
+  igraph_vector_int_destroy(&sizes);
+  igraph_destroy(&g);
+
+  if (IGRAPH_FINALLY_STACK_SIZE() != 0) { return 30; }
+
+  return 0;
+}
@@ -0,0 +1,149 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+#include <math.h>
+
+/* The replicas of igraph_community_spinglass_replicas() run in
+   parallel, if igraph was compiled with OpenMP. Check that the
+   result does not depend on the scheduling of the replicas, that a
+   single replica is the same as igraph_community_spinglass(), and
+   that the planted communities of a stochastic block model are
+   found. */
+
+int run(const igraph_t *g, const igraph_vector_t *weights,
+	igraph_spinglass_implementation_t implementation,
+	igraph_integer_t replicas, igraph_vector_t *membership,
+	igraph_vector_t *csize, igraph_real_t *modularity) {
+  igraph_real_t temperature;
+  igraph_rng_seed(igraph_rng_default(), 42);
+  return igraph_community_spinglass_replicas(g, weights, modularity,
+					     &temperature, membership, csize,
+					     /*spins=*/ 10, /*parupdate=*/ 0,
+					     /*starttemp=*/ 1.0,
+					     /*stoptemp=*/ 0.01,
+					     /*coolfact=*/ 0.99,
+					     IGRAPH_SPINCOMM_UPDATE_CONFIG,
+					     /*gamma=*/ 1.0, implementation,
+					     /*gamma_minus=*/ 1.0, replicas);
+}
+
+int check_sizes(const igraph_vector_t *membership,
+		const igraph_vector_t *csize) {
+  long int i, n=igraph_vector_size(csize);
+  igraph_vector_t count;
+  igraph_vector_init(&count, n);
+  for (i=0; i<igraph_vector_size(membership); i++) {
+    long int c=(long int) VECTOR(*membership)[i];
+    if (c < 0 || c >= n) { return 1; }
+    VECTOR(count)[c] += 1;
+  }
+  if (!igraph_vector_all_e(&count, csize)) { return 1; }
+  igraph_vector_destroy(&count);
+  return 0;
+}
+
+int main() {
+  igraph_t g;
+  igraph_vector_int_t sizes;
+  igraph_matrix_t pref;
+  igraph_vector_t membership, membership2, csize, planted, weights;
+  igraph_real_t modularity, modularity2, temperature, q, nmi;
+  long int i;
+
+  igraph_rng_seed(igraph_rng_default(), 42);
+
+  /* 4 blocks of 50 vertices */
+  igraph_vector_int_init(&sizes, 4);
+  igraph_vector_int_fill(&sizes, 50);
+  igraph_matrix_init(&pref, 4, 4);
+  igraph_matrix_fill(&pref, 0.01);
+  for (i=0; i<4; i++) { MATRIX(pref, i, i) = 0.3; }
+  igraph_sbm_game(&g, 200, &pref, &sizes, IGRAPH_UNDIRECTED, /*loops=*/ 0);
+  igraph_vector_init(&planted, 200);
+  for (i=0; i<200; i++) { VECTOR(planted)[i] = i / 50; }
+
+  igraph_vector_init(&membership, 0);
+  igraph_vector_init(&membership2, 0);
+  igraph_vector_init(&csize, 0);
+
+  /* A single replica is the original function */
+  run(&g, 0, IGRAPH_SPINCOMM_IMP_ORIG, 1, &membership, &csize, &modularity);
+  igraph_rng_seed(igraph_rng_default(), 42);
+  igraph_community_spinglass(&g, 0, &modularity2, &temperature,
+			     &membership2, 0, 10, 0, 1.0, 0.01, 0.99,
+			     IGRAPH_SPINCOMM_UPDATE_CONFIG, 1.0,
+			     IGRAPH_SPINCOMM_IMP_ORIG, 1.0);
+  if (modularity != modularity2) { return 1; }
+  if (!igraph_vector_all_e(&membership, &membership2)) { return 2; }
+
+  /* Several replicas, twice */
+  run(&g, 0, IGRAPH_SPINCOMM_IMP_ORIG, 4, &membership, &csize, &modularity);
+  run(&g, 0, IGRAPH_SPINCOMM_IMP_ORIG, 4, &membership2, 0, &modularity2);
+  if (modularity != modularity2) { return 3; }
+  if (!igraph_vector_all_e(&membership, &membership2)) { return 4; }
+  if (check_sizes(&membership, &csize)) { return 5; }
+  igraph_modularity(&g, &membership, &q, 0);
+  if (fabs(q - modularity) > 1e-10) { return 6; }
+  igraph_compare_communities(&membership, &planted, &nmi,
+			     IGRAPH_COMMCMP_NMI);
+  if (nmi < 0.99) { return 7; }
+
+  /* Negative weights */
+  igraph_vector_init(&weights, igraph_ecount(&g));
+  for (i=0; i<igraph_ecount(&g); i++) {
+    igraph_integer_t from, to;
+    igraph_edge(&g, (igraph_integer_t) i, &from, &to);
+    VECTOR(weights)[i] = (from / 50 == to / 50) ? 1 : -1;
+  }
+  run(&g, &weights, IGRAPH_SPINCOMM_IMP_NEG, 4, &membership, &csize,
+      &modularity);
+  run(&g, &weights, IGRAPH_SPINCOMM_IMP_NEG, 4, &membership2, 0,
+      &modularity2);
+  if (modularity != modularity2) { return 11; }
+  if (!igraph_vector_all_e(&membership, &membership2)) { return 12; }
+  if (check_sizes(&membership, &csize)) { return 13; }
+  igraph_compare_communities(&membership, &planted, &nmi,
+			     IGRAPH_COMMCMP_NMI);
+  if (nmi < 0.99) { return 14; }
+
+  /* Invalid number of replicas */
+  igraph_set_error_handler(igraph_error_handler_ignore);
+  if (run(&g, 0, IGRAPH_SPINCOMM_IMP_ORIG, 0, &membership, 0,
+	  &modularity) != IGRAPH_EINVAL) {
+    return 20;
+  }
+
+  igraph_vector_destroy(&weights);
+  igraph_vector_destroy(&csize);
+  igraph_vector_destroy(&membership2);
+  igraph_vector_destroy(&membership);
+  igraph_vector_destroy(&planted);
+  igraph_matrix_destroy(&pref);
+  igraph_vector_int_destroy(&sizes);
+  igraph_destroy(&g);
+
+  if (IGRAPH_FINALLY_STACK_SIZE() != 0) { return 30; }
+
+  return 0;
+}
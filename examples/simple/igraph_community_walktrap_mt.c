@@ -0,0 +1,83 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+#include <math.h>
+
+/* Walktrap computes the probability vectors of the vertices in
+   parallel on large graphs, if igraph was compiled with OpenMP. Check
+   that the planted communities of a stochastic block model are found,
+   with and without a memory limit, and that the limit is kept. */
+
+int main() {
+  igraph_t g;
+  igraph_vector_int_t sizes;
+  igraph_matrix_t pref, merges;
+  igraph_vector_t membership, modularity, planted;
+  igraph_real_t nmi, q, peak, peak2;
+  long int i;
+
+  igraph_rng_seed(igraph_rng_default(), 42);
+
+  /* 200 blocks of 100 vertices */
+  igraph_vector_int_init(&sizes, 200);
+  igraph_vector_int_fill(&sizes, 100);
+  igraph_matrix_init(&pref, 200, 200);
+  igraph_matrix_fill(&pref, 0.00001);
+  for (i=0; i<200; i++) { MATRIX(pref, i, i) = 0.1; }
+  igraph_sbm_game(&g, 20000, &pref, &sizes, IGRAPH_UNDIRECTED,
+		  /*loops=*/ 0);
+  igraph_vector_init(&planted, 20000);
+  for (i=0; i<20000; i++) { VECTOR(planted)[i] = i / 100; }
+
+  igraph_vector_init(&membership, 0);
+  igraph_vector_init(&modularity, 0);
+  igraph_matrix_init(&merges, 0, 0);
+  igraph_community_walktrap_memory(&g, 0, 4, /*max_memory=*/ -1, &merges,
+				   &modularity, &membership, &peak);
+  igraph_compare_communities(&membership, &planted, &nmi, IGRAPH_COMMCMP_NMI);
+  if (nmi < 0.99) { return 1; }
+  igraph_modularity(&g, &membership, &q, 0);
+  if (fabs(q - igraph_vector_max(&modularity)) > 1e-5) { return 2; }
+
+  /* Half of the memory */
+  igraph_community_walktrap_memory(&g, 0, 4, peak / 2, &merges,
+				   &modularity, &membership, &peak2);
+  if (peak2 > peak / 2) { return 3; }
+  igraph_compare_communities(&membership, &planted, &nmi, IGRAPH_COMMCMP_NMI);
+  if (nmi < 0.99) { return 4; }
+  igraph_modularity(&g, &membership, &q, 0);
+  if (fabs(q - igraph_vector_max(&modularity)) > 1e-5) { return 5; }
+
+  igraph_matrix_destroy(&merges);
+  igraph_vector_destroy(&modularity);
+  igraph_vector_destroy(&membership);
+  igraph_vector_destroy(&planted);
+  igraph_matrix_destroy(&pref);
+  igraph_vector_int_destroy(&sizes);
+  igraph_destroy(&g);
+
+  if (IGRAPH_FINALLY_STACK_SIZE() != 0) { return 6; }
+
+  return 0;
+}
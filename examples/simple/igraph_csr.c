@@ -0,0 +1,122 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+
+/* Compare a CSR snapshot to igraph_neighbors() and igraph_incident() */
+
+int check(const igraph_t *g, igraph_neimode_t mode,
+	  const igraph_vector_t *weights) {
+  igraph_csr_t csr;
+  igraph_vector_t neis, eids;
+  long int i, j, n=igraph_vcount(g);
+
+  igraph_vector_init(&neis, 0);
+  igraph_vector_init(&eids, 0);
+  igraph_csr_init(g, &csr, mode, weights);
+  if (igraph_csr_size(&csr) != n) {
+    return 1;
+  }
+  for (i=0; i<n; i++) {
+    const int *cn=igraph_csr_neis(&csr, i);
+    const int *ce=igraph_csr_edges(&csr, i);
+    igraph_neighbors(g, &neis, i, mode);
+    igraph_incident(g, &eids, i, mode);
+    if (igraph_csr_degree(&csr, i) != igraph_vector_size(&neis) ||
+	igraph_csr_degree(&csr, i) != igraph_vector_size(&eids)) {
+      return 2;
+    }
+    for (j=0; j<igraph_vector_size(&neis); j++) {
+      /* Same neighbors, in the same order */
+      if (cn[j] != VECTOR(neis)[j]) {
+	return 3;
+      }
+      /* Every edge leads to its neighbor */
+      if (IGRAPH_OTHER(g, ce[j], i) != cn[j]) {
+	return 4;
+      }
+      if (!igraph_vector_contains(&eids, ce[j])) {
+	return 5;
+      }
+      if (weights && igraph_csr_weights(&csr, i)[j] != 
+	  VECTOR(*weights)[(long int) ce[j]]) {
+	return 6;
+      }
+    }
+  }
+  igraph_csr_destroy(&csr);
+  igraph_vector_destroy(&eids);
+  igraph_vector_destroy(&neis);
+  return 0;
+}
+
+int main() {
+  igraph_t g;
+  igraph_vector_t weights;
+  igraph_csr_t csr;
+  long int i;
+  int ret;
+
+  igraph_rng_seed(igraph_rng_default(), 42);
+
+  /* Random multigraph with loops */
+  igraph_erdos_renyi_game(&g, IGRAPH_ERDOS_RENYI_GNM, 50, 300,
+			  IGRAPH_DIRECTED, IGRAPH_LOOPS);
+  igraph_add_edge(&g, 3, 7);
+  igraph_add_edge(&g, 3, 7);
+  igraph_add_edge(&g, 7, 3);
+  igraph_add_edge(&g, 5, 5);
+  igraph_vector_init(&weights, igraph_ecount(&g));
+  for (i=0; i<igraph_ecount(&g); i++) {
+    VECTOR(weights)[i]=i % 7 + 1;
+  }
+
+  if ((ret=check(&g, IGRAPH_OUT, 0))) { return ret; }
+  if ((ret=check(&g, IGRAPH_IN, 0))) { return 10+ret; }
+  if ((ret=check(&g, IGRAPH_ALL, &weights))) { return 20+ret; }
+  igraph_to_undirected(&g, IGRAPH_TO_UNDIRECTED_EACH, 0);
+  if ((ret=check(&g, IGRAPH_OUT, &weights))) { return 30+ret; }
+  if ((ret=check(&g, IGRAPH_ALL, 0))) { return 40+ret; }
+  igraph_destroy(&g);
+
+  /* Empty graphs */
+  igraph_empty(&g, 0, IGRAPH_DIRECTED);
+  if ((ret=check(&g, IGRAPH_ALL, 0))) { return 50+ret; }
+  igraph_destroy(&g);
+  igraph_empty(&g, 10, IGRAPH_UNDIRECTED);
+  if ((ret=check(&g, IGRAPH_ALL, 0))) { return 60+ret; }
+
+  /* Errors */
+  igraph_set_error_handler(igraph_error_handler_ignore);
+  if (igraph_csr_init(&g, &csr, IGRAPH_ALL, &weights) != IGRAPH_EINVAL) {
+    return 70;
+  }
+  if (igraph_csr_init(&g, &csr, (igraph_neimode_t) 42, 0) != 
+      IGRAPH_EINVMODE) {
+    return 71;
+  }
+  igraph_destroy(&g);
+  igraph_vector_destroy(&weights);
+
+  return 0;
+}
@@ -0,0 +1,78 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2014  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+
+/* The parallel functions call the interruption handler only between
+   their parallel regions. This handler frees the temporary objects
+   before it interrupts the computation, like the one of the R
+   interface, so it would free the buffers of the running threads if
+   it was called from a parallel region. */
+
+int calls, limit;
+
+int handler(void *data) {
+  if (++calls == limit) {
+    IGRAPH_FINALLY_FREE();
+    return IGRAPH_INTERRUPTED;
+  }
+  return IGRAPH_SUCCESS;
+}
+
+#define CHECK(expr, code) do {						\
+    calls=0; limit=2;							\
+    if ((expr) != IGRAPH_INTERRUPTED) { return (code); }		\
+    if (IGRAPH_FINALLY_STACK_SIZE() != 0) { return (code)+1; }		\
+  } while (0)
+
+int main() {
+  igraph_t g;
+  igraph_vector_t res;
+  igraph_matrix_t dist;
+  igraph_integer_t diameter;
+
+  igraph_rng_seed(igraph_rng_default(), 42);
+  igraph_barabasi_game(&g, 2000, 1, 3, 0, 0, 1, 0,
+		       IGRAPH_BARABASI_PSUMTREE, 0);
+  igraph_vector_init(&res, 0);
+  igraph_matrix_init(&dist, 0, 0);
+
+  igraph_set_error_handler(igraph_error_handler_ignore);
+  igraph_set_interruption_handler(handler);
+
+  CHECK(igraph_betweenness(&g, &res, igraph_vss_all(), 0, 0, 1), 1);
+  CHECK(igraph_edge_betweenness(&g, &res, 0, 0), 3);
+  CHECK(igraph_closeness(&g, &res, igraph_vss_all(), IGRAPH_ALL, 0, 1), 5);
+  CHECK(igraph_diameter(&g, &diameter, 0, 0, 0, 0, 1), 7);
+  CHECK(igraph_shortest_paths(&g, &dist, igraph_vss_all(), igraph_vss_all(),
+			      IGRAPH_ALL), 9);
+  CHECK(igraph_community_ensemble(&g, 0, IGRAPH_ENSEMBLE_LABEL_PROPAGATION,
+				  8, 0.5, &res, 0, 0, 0), 11);
+
+  igraph_set_interruption_handler(0);
+  igraph_matrix_destroy(&dist);
+  igraph_vector_destroy(&res);
+  igraph_destroy(&g);
+
+  return 0;
+}
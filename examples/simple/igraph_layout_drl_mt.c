@@ -0,0 +1,128 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2014  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+#include <math.h>
+
+/* DrL updates the nodes of large graphs in batches, in parallel, if
+   igraph was compiled with OpenMP. Check that the layout only depends
+   on the seed of the default random number generator, and that the
+   edges are shorter than the distance of random vertex pairs. */
+
+igraph_real_t dist(const igraph_matrix_t *res, long int i, long int j) {
+  long int k;
+  igraph_real_t d=0;
+  for (k=0; k<igraph_matrix_ncol(res); k++) {
+    d += (MATRIX(*res, i, k)-MATRIX(*res, j, k)) *
+      (MATRIX(*res, i, k)-MATRIX(*res, j, k));
+  }
+  return sqrt(d);
+}
+
+/* Mean edge length divided by the mean distance of random pairs */
+igraph_real_t ratio(const igraph_t *g, const igraph_matrix_t *res) {
+  long int no_of_nodes=igraph_vcount(g), no_of_edges=igraph_ecount(g);
+  long int i;
+  igraph_real_t edges=0, pairs=0;
+  for (i=0; i<no_of_edges; i++) {
+    edges += dist(res, IGRAPH_FROM(g, i), IGRAPH_TO(g, i));
+  }
+  for (i=0; i<no_of_edges; i++) {
+    pairs += dist(res, RNG_INTEGER(0, no_of_nodes-1),
+		  RNG_INTEGER(0, no_of_nodes-1));
+  }
+  return edges / pairs;
+}
+
+int test(igraph_integer_t dim, int iterations, int code) {
+  igraph_t g;
+  igraph_matrix_t seed, res, res2;
+  igraph_layout_drl_options_t options;
+  igraph_vector_t dims;
+  long int i;
+
+  /* 2D or 3D lattice, with 12000 or 10648 vertices */
+  if (dim == 2) {
+    igraph_vector_init_int_end(&dims, -1, 100, 120, -1);
+  } else {
+    igraph_vector_init_int_end(&dims, -1, 22, 22, 22, -1);
+  }
+  igraph_lattice(&g, &dims, 1, IGRAPH_UNDIRECTED, 0, 0);
+
+  /* A short schedule, from a random layout */
+  igraph_layout_drl_options_init(&options, IGRAPH_LAYOUT_DRL_DEFAULT);
+  options.liquid_iterations=iterations;
+  options.expansion_iterations=iterations;
+  options.cooldown_iterations=iterations;
+  options.crunch_iterations=iterations;
+  options.simmer_iterations=iterations;
+  igraph_matrix_init(&seed, igraph_vcount(&g), dim);
+  for (i=0; i<igraph_matrix_size(&seed); i++) {
+    VECTOR(seed.data)[i] = RNG_UNIF(-50, 50);
+  }
+
+  igraph_rng_seed(igraph_rng_default(), 42);
+  igraph_matrix_copy(&res, &seed);
+  if (dim == 2) {
+    igraph_layout_drl(&g, &res, 1, &options, 0, 0);
+  } else {
+    igraph_layout_drl_3d(&g, &res, 1, &options, 0, 0);
+  }
+  if (igraph_matrix_nrow(&res) != igraph_vcount(&g) ||
+      igraph_matrix_ncol(&res) != dim) {
+    return code;
+  }
+  for (i=0; i<igraph_matrix_size(&res); i++) {
+    if (!igraph_finite(VECTOR(res.data)[i])) { return code+1; }
+  }
+  if (ratio(&g, &res) > 0.75) { return code+2; }
+
+  igraph_rng_seed(igraph_rng_default(), 42);
+  igraph_matrix_copy(&res2, &seed);
+  if (dim == 2) {
+    igraph_layout_drl(&g, &res2, 1, &options, 0, 0);
+  } else {
+    igraph_layout_drl_3d(&g, &res2, 1, &options, 0, 0);
+  }
+  if (!igraph_matrix_all_e(&res, &res2)) { return code+3; }
+
+  igraph_matrix_destroy(&res2);
+  igraph_matrix_destroy(&res);
+  igraph_matrix_destroy(&seed);
+  igraph_vector_destroy(&dims);
+  igraph_destroy(&g);
+
+  return 0;
+}
+
+int main() {
+  int ret;
+
+  igraph_rng_seed(igraph_rng_default(), 42);
+  if ((ret=test(2, 2, 1))) { return ret; }
+  if ((ret=test(3, 1, 11))) { return ret; }
+
+  if (IGRAPH_FINALLY_STACK_SIZE() != 0) { return 21; }
+
+  return 0;
+}
@@ -0,0 +1,190 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2014  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+#include <math.h>
+
+/* The forces of the Barnes-Hut Fruchterman-Reingold layout are
+   computed in parallel, if igraph was compiled with OpenMP. Check
+   that the layout is reproducible, that it unfolds lattices, and that
+   the bounds and the new_v argument are respected. */
+
+/* Mean edge length divided by the mean distance of all pairs, this is
+   small for a good layout of a lattice */
+igraph_real_t ratio(const igraph_t *g, const igraph_matrix_t *res) {
+  long int no_of_nodes=igraph_vcount(g), no_of_edges=igraph_ecount(g);
+  long int i, j, k, dim=igraph_matrix_ncol(res);
+  igraph_real_t edges=0, pairs=0;
+  for (i=0; i<no_of_nodes; i++) {
+    for (j=i+1; j<no_of_nodes; j++) {
+      igraph_real_t d=0;
+      for (k=0; k<dim; k++) {
+	d += (MATRIX(*res, i, k)-MATRIX(*res, j, k)) *
+	  (MATRIX(*res, i, k)-MATRIX(*res, j, k));
+      }
+      pairs += sqrt(d);
+    }
+  }
+  for (i=0; i<no_of_edges; i++) {
+    long int from=IGRAPH_FROM(g, i), to=IGRAPH_TO(g, i);
+    igraph_real_t d=0;
+    for (k=0; k<dim; k++) {
+      d += (MATRIX(*res, from, k)-MATRIX(*res, to, k)) *
+	(MATRIX(*res, from, k)-MATRIX(*res, to, k));
+    }
+    edges += sqrt(d);
+  }
+  return (edges / no_of_edges) / (pairs / (no_of_nodes*(no_of_nodes-1)/2));
+}
+
+int main() {
+  igraph_t g;
+  igraph_vector_t dims, new_v, minx, maxx;
+  igraph_matrix_t res, res2, seed;
+  long int i;
+
+  /* 2D lattice */
+  igraph_vector_init(&dims, 2);
+  VECTOR(dims)[0]=20; VECTOR(dims)[1]=20;
+  igraph_lattice(&g, &dims, 1, IGRAPH_UNDIRECTED, 0, 0);
+  igraph_matrix_init(&res, 0, 0);
+  igraph_matrix_init(&res2, 0, 0);
+  igraph_rng_seed(igraph_rng_default(), 42);
+  igraph_layout_fruchterman_reingold_bh(&g, &res, 0, 500, 20, 0.8, 0,
+					0, 0, 0, 0, 0);
+  if (ratio(&g, &res) > 0.15) { return 1; }
+
+  /* the exact forces give a similar layout */
+  igraph_rng_seed(igraph_rng_default(), 42);
+  igraph_layout_fruchterman_reingold_bh(&g, &res2, 0, 100, 20, 0.0, 0,
+					0, 0, 0, 0, 0);
+  if (ratio(&g, &res2) > 0.15) { return 2; }
+
+  /* IGRAPH_LAYOUT_BARNES_HUT is the same with theta 0.8 */
+  igraph_rng_seed(igraph_rng_default(), 42);
+  igraph_layout_fruchterman_reingold(&g, &res2, 0, 500, 20,
+				     IGRAPH_LAYOUT_BARNES_HUT, 0,
+				     0, 0, 0, 0, 0);
+  if (!igraph_matrix_all_e(&res, &res2)) { return 3; }
+
+  /* bounds */
+  igraph_vector_init(&minx, igraph_vcount(&g));
+  igraph_vector_init(&maxx, igraph_vcount(&g));
+  igraph_vector_fill(&minx, -1);
+  igraph_vector_fill(&maxx, 1);
+  igraph_layout_fruchterman_reingold_bh(&g, &res, 0, 100, 20, 0.5, 0,
+					&minx, &maxx, 0, 0, 0);
+  for (i=0; i<igraph_vcount(&g); i++) {
+    if (MATRIX(res, i, 0) < -1 || MATRIX(res, i, 0) > 1) { return 4; }
+  }
+  igraph_vector_destroy(&minx);
+  igraph_vector_destroy(&maxx);
+
+  /* only the vertices in new_v move */
+  igraph_matrix_copy(&seed, &res);
+  igraph_vector_init(&new_v, 0);
+  igraph_vector_push_back(&new_v, 7);
+  igraph_vector_push_back(&new_v, 3);
+  igraph_vector_push_back(&new_v, 7);
+  igraph_layout_fruchterman_reingold_bh(&g, &res, 1, 100, 1, 0.5, 0,
+					0, 0, 0, 0, &new_v);
+  for (i=0; i<igraph_vcount(&g); i++) {
+    igraph_bool_t moved = MATRIX(res, i, 0) != MATRIX(seed, i, 0) ||
+      MATRIX(res, i, 1) != MATRIX(seed, i, 1);
+    if (moved != (i == 3 || i == 7)) { return 5; }
+  }
+  igraph_matrix_destroy(&seed);
+  igraph_vector_destroy(&new_v);
+  igraph_destroy(&g);
+
+  /* large enough for the parallel code, reproducible, and moving all
+     vertices explicitly is the same as moving all of them by default */
+  VECTOR(dims)[0]=50; VECTOR(dims)[1]=40;
+  igraph_lattice(&g, &dims, 1, IGRAPH_UNDIRECTED, 0, 0);
+  igraph_vector_init_seq(&new_v, 0, igraph_vcount(&g)-1);
+  igraph_vector_reverse(&new_v);
+  igraph_rng_seed(igraph_rng_default(), 42);
+  igraph_layout_fruchterman_reingold_bh(&g, &res, 0, 50, 20, 0.8, 0,
+					0, 0, 0, 0, 0);
+  igraph_rng_seed(igraph_rng_default(), 42);
+  igraph_layout_fruchterman_reingold_bh(&g, &res2, 0, 50, 20, 0.8, 0,
+					0, 0, 0, 0, &new_v);
+  if (!igraph_matrix_all_e(&res, &res2)) { return 6; }
+  for (i=0; i<igraph_vcount(&g); i++) {
+    if (!igraph_finite(MATRIX(res, i, 0)) ||
+	!igraph_finite(MATRIX(res, i, 1))) {
+      return 7;
+    }
+  }
+  igraph_vector_destroy(&new_v);
+  igraph_destroy(&g);
+
+  /* 3D lattice, and a disconnected graph, to have the extra
+     attraction as well */
+  igraph_vector_resize(&dims, 3);
+  VECTOR(dims)[0]=8; VECTOR(dims)[1]=8; VECTOR(dims)[2]=8;
+  igraph_lattice(&g, &dims, 1, IGRAPH_UNDIRECTED, 0, 0);
+  igraph_rng_seed(igraph_rng_default(), 42);
+  igraph_layout_fruchterman_reingold_3d_bh(&g, &res, 0, 300, 20, 0.8, 0,
+					   0, 0, 0, 0, 0, 0, 0);
+  if (igraph_matrix_ncol(&res) != 3) { return 8; }
+  if (ratio(&g, &res) > 0.25) { return 9; }
+  igraph_destroy(&g);
+
+  igraph_ring(&g, 50, IGRAPH_UNDIRECTED, 0, 1);
+  igraph_add_vertices(&g, 10, 0);
+  igraph_rng_seed(igraph_rng_default(), 42);
+  igraph_layout_fruchterman_reingold_3d_bh(&g, &res, 0, 500, 20, 0.5, 0,
+					   0, 0, 0, 0, 0, 0, 0);
+  for (i=0; i<igraph_vcount(&g); i++) {
+    if (!igraph_finite(MATRIX(res, i, 0)) ||
+	!igraph_finite(MATRIX(res, i, 1)) ||
+	!igraph_finite(MATRIX(res, i, 2))) {
+      return 10;
+    }
+  }
+  igraph_destroy(&g);
+
+  /* errors */
+  igraph_set_error_handler(igraph_error_handler_ignore);
+  igraph_ring(&g, 10, IGRAPH_UNDIRECTED, 0, 1);
+  if (igraph_layout_fruchterman_reingold_bh(&g, &res, 0, 10, 1, -1, 0,
+					    0, 0, 0, 0, 0) != IGRAPH_EINVAL) {
+    return 11;
+  }
+  igraph_vector_init(&new_v, 1);
+  VECTOR(new_v)[0]=10;
+  if (igraph_layout_fruchterman_reingold_bh(&g, &res, 0, 10, 1, 0.5, 0,
+					    0, 0, 0, 0, &new_v) !=
+      IGRAPH_EINVVID) {
+    return 12;
+  }
+  igraph_vector_destroy(&new_v);
+  igraph_destroy(&g);
+
+  igraph_matrix_destroy(&res2);
+  igraph_matrix_destroy(&res);
+  igraph_vector_destroy(&dims);
+
+  return 0;
+}
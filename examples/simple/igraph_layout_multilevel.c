@@ -0,0 +1,134 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2014  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+#include <math.h>
+
+/* Mean edge length divided by the mean distance of all pairs, this is
+   small for a good layout of a lattice or a tree */
+igraph_real_t ratio(const igraph_t *g, const igraph_matrix_t *res) {
+  long int no_of_nodes=igraph_vcount(g), no_of_edges=igraph_ecount(g);
+  long int i, j, k, dim=igraph_matrix_ncol(res);
+  igraph_real_t edges=0, pairs=0;
+  for (i=0; i<no_of_nodes; i++) {
+    for (j=i+1; j<no_of_nodes; j++) {
+      igraph_real_t d=0;
+      for (k=0; k<dim; k++) {
+	d += (MATRIX(*res, i, k)-MATRIX(*res, j, k)) *
+	  (MATRIX(*res, i, k)-MATRIX(*res, j, k));
+      }
+      pairs += sqrt(d);
+    }
+  }
+  for (i=0; i<no_of_edges; i++) {
+    long int from=IGRAPH_FROM(g, i), to=IGRAPH_TO(g, i);
+    igraph_real_t d=0;
+    for (k=0; k<dim; k++) {
+      d += (MATRIX(*res, from, k)-MATRIX(*res, to, k)) *
+	(MATRIX(*res, from, k)-MATRIX(*res, to, k));
+    }
+    edges += sqrt(d);
+  }
+  return (edges / no_of_edges) / (pairs / (no_of_nodes*(no_of_nodes-1)/2));
+}
+
+int all_finite(const igraph_matrix_t *res) {
+  long int i;
+  for (i=0; i<igraph_matrix_size(res); i++) {
+    if (!igraph_finite(VECTOR(res->data)[i])) { return 0; }
+  }
+  return 1;
+}
+
+int main() {
+  igraph_t g, g2;
+  igraph_vector_t dims, weights;
+  igraph_matrix_t res;
+  long int i;
+
+  igraph_matrix_init(&res, 0, 0);
+  igraph_rng_seed(igraph_rng_default(), 42);
+
+  /* a 2D lattice is unfolded, several levels are needed */
+  igraph_vector_init(&dims, 2);
+  VECTOR(dims)[0]=40; VECTOR(dims)[1]=40;
+  igraph_lattice(&g, &dims, 1, IGRAPH_UNDIRECTED, 0, 0);
+  igraph_layout_multilevel(&g, &res, 2, 50, 20, 0.8, 0);
+  if (igraph_matrix_nrow(&res) != 1600 || igraph_matrix_ncol(&res) != 2) {
+    return 1;
+  }
+  if (ratio(&g, &res) > 0.05) { return 2; }
+
+  /* weighted */
+  igraph_vector_init(&weights, igraph_ecount(&g));
+  for (i=0; i<igraph_ecount(&g); i++) {
+    VECTOR(weights)[i]=igraph_rng_get_unif(igraph_rng_default(), 1, 2);
+  }
+  igraph_layout_multilevel(&g, &res, 2, 50, 20, 0.8, &weights);
+  if (ratio(&g, &res) > 0.05) { return 3; }
+  igraph_vector_destroy(&weights);
+  igraph_destroy(&g);
+
+  /* a tree in 3D, stars collapse quickly */
+  igraph_tree(&g, 1000, 5, IGRAPH_TREE_OUT);
+  igraph_layout_multilevel(&g, &res, 3, 50, 20, 0.8, 0);
+  if (igraph_matrix_ncol(&res) != 3 || !all_finite(&res)) { return 4; }
+  if (ratio(&g, &res) > 0.2) { return 5; }
+  igraph_destroy(&g);
+
+  /* several components, isolated vertices and loops */
+  igraph_ring(&g, 100, IGRAPH_UNDIRECTED, 0, 1);
+  igraph_full(&g2, 10, IGRAPH_UNDIRECTED, IGRAPH_LOOPS);
+  igraph_disjoint_union(&g, &g, &g2);
+  igraph_add_vertices(&g, 5, 0);
+  igraph_layout_multilevel(&g, &res, 2, 50, 10, 0.8, 0);
+  if (igraph_matrix_nrow(&res) != 115 || !all_finite(&res)) { return 6; }
+  igraph_destroy(&g2);
+  igraph_destroy(&g);
+
+  /* small graphs are laid out directly */
+  igraph_ring(&g, 10, IGRAPH_UNDIRECTED, 0, 1);
+  igraph_layout_multilevel(&g, &res, 2, 50, 20, 0.8, 0);
+  if (igraph_matrix_nrow(&res) != 10 || !all_finite(&res)) { return 7; }
+  igraph_destroy(&g);
+  igraph_empty(&g, 0, IGRAPH_UNDIRECTED);
+  igraph_layout_multilevel(&g, &res, 2, 50, 20, 0.8, 0);
+  if (igraph_matrix_nrow(&res) != 0) { return 8; }
+
+  /* errors */
+  igraph_set_error_handler(igraph_error_handler_ignore);
+  if (igraph_layout_multilevel(&g, &res, 4, 50, 20, 0.8, 0) !=
+      IGRAPH_EINVAL) {
+    return 9;
+  }
+  if (igraph_layout_multilevel(&g, &res, 2, 50, 0, 0.8, 0) !=
+      IGRAPH_EINVAL) {
+    return 10;
+  }
+  igraph_destroy(&g);
+
+  igraph_vector_destroy(&dims);
+  igraph_matrix_destroy(&res);
+
+  return 0;
+}
@@ -0,0 +1,186 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2014  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+#include <math.h>
+
+igraph_real_t dist(const igraph_matrix_t *res, long int i, long int j) {
+  long int k;
+  igraph_real_t d=0;
+  for (k=0; k<igraph_matrix_ncol(res); k++) {
+    d += (MATRIX(*res, i, k)-MATRIX(*res, j, k)) *
+      (MATRIX(*res, i, k)-MATRIX(*res, j, k));
+  }
+  return sqrt(d);
+}
+
+igraph_real_t mean_edge_length(const igraph_t *g, const igraph_matrix_t *res) {
+  long int i, no_of_edges=igraph_ecount(g);
+  igraph_real_t sum=0;
+  for (i=0; i<no_of_edges; i++) {
+    sum += dist(res, IGRAPH_FROM(g, i), IGRAPH_TO(g, i));
+  }
+  return sum / no_of_edges;
+}
+
+/* Mean edge length divided by the mean distance of all pairs, this is
+   small for a good layout of a lattice */
+igraph_real_t ratio(const igraph_t *g, const igraph_matrix_t *res) {
+  long int no_of_nodes=igraph_vcount(g);
+  long int i, j;
+  igraph_real_t pairs=0;
+  for (i=0; i<no_of_nodes; i++) {
+    for (j=i+1; j<no_of_nodes; j++) {
+      pairs += dist(res, i, j);
+    }
+  }
+  return mean_edge_length(g, res) /
+    (pairs / (no_of_nodes*(no_of_nodes-1)/2));
+}
+
+int all_finite(const igraph_matrix_t *res) {
+  long int i;
+  for (i=0; i<igraph_matrix_size(res); i++) {
+    if (!igraph_finite(VECTOR(res->data)[i])) { return 0; }
+  }
+  return 1;
+}
+
+int main() {
+  igraph_t g;
+  igraph_vector_t dims, weights;
+  igraph_matrix_t res, mds;
+  igraph_real_t len;
+  long int i;
+
+  igraph_rng_seed(igraph_rng_default(), 42);
+  igraph_matrix_init(&res, 0, 0);
+
+  /* A 2D lattice is drawn as a grid, at about the scale of classical
+     MDS with a few pivots, and exactly like classical MDS, up to
+     reflections, with all vertices as pivots */
+  igraph_vector_init_int_end(&dims, -1, 30, 20, -1);
+  igraph_lattice(&g, &dims, 1, IGRAPH_UNDIRECTED, 0, 0);
+  igraph_matrix_init(&mds, 0, 0);
+  igraph_layout_mds(&g, &mds, 0, 2, 0);
+  igraph_layout_pivot_mds(&g, &res, 2, 20, 0);
+  if (igraph_matrix_nrow(&res) != 600 || igraph_matrix_ncol(&res) != 2) {
+    return 1;
+  }
+  if (ratio(&g, &res) > 0.1) { return 2; }
+  len=mean_edge_length(&g, &res) / mean_edge_length(&g, &mds);
+  if (len < 0.8 || len > 1.25) { return 3; }
+  igraph_layout_pivot_mds(&g, &res, 2, 1000, 0);
+  for (i=0; i<igraph_ecount(&g); i++) {
+    long int from=IGRAPH_FROM(&g, i), to=IGRAPH_TO(&g, i);
+    if (fabs(dist(&res, from, to) - dist(&mds, from, to)) > 1e-6) {
+      return 4;
+    }
+  }
+  igraph_matrix_destroy(&mds);
+  igraph_destroy(&g);
+
+  /* 3D lattice */
+  igraph_vector_destroy(&dims);
+  igraph_vector_init_int_end(&dims, -1, 8, 8, 8, -1);
+  igraph_lattice(&g, &dims, 1, IGRAPH_UNDIRECTED, 0, 0);
+  igraph_layout_pivot_mds(&g, &res, 3, 30, 0);
+  if (igraph_matrix_ncol(&res) != 3) { return 5; }
+  if (ratio(&g, &res) > 0.2) { return 6; }
+  igraph_destroy(&g);
+
+  /* A path in 1D */
+  igraph_ring(&g, 10, IGRAPH_UNDIRECTED, 0, 0);
+  igraph_layout_pivot_mds(&g, &res, 1, 10, 0);
+  if (fabs(dist(&res, 0, 9) - 9) > 1e-6) { return 7; }
+  igraph_destroy(&g);
+
+  /* A weighted triangle, with all vertices as pivots, is exact */
+  igraph_small(&g, 3, IGRAPH_UNDIRECTED, 0,1, 1,2, 0,2, -1);
+  igraph_vector_init_int_end(&weights, -1, 3, 4, 5, -1);
+  igraph_layout_pivot_mds(&g, &res, 2, 3, &weights);
+  if (fabs(dist(&res, 0, 1)-3) > 1e-6 || fabs(dist(&res, 1, 2)-4) > 1e-6 ||
+      fabs(dist(&res, 0, 2)-5) > 1e-6) {
+    return 8;
+  }
+  igraph_vector_destroy(&weights);
+  igraph_destroy(&g);
+
+  /* Disconnected graph with loops, multiple edges and isolated
+     vertices */
+  igraph_ring(&g, 20, IGRAPH_UNDIRECTED, 0, 1);
+  igraph_add_vertices(&g, 5, 0);
+  igraph_add_edge(&g, 0, 0);
+  igraph_add_edge(&g, 3, 4);
+  igraph_add_edge(&g, 20, 21);
+  igraph_layout_pivot_mds(&g, &res, 2, 10, 0);
+  if (igraph_matrix_nrow(&res) != 25 || !all_finite(&res)) { return 9; }
+  igraph_destroy(&g);
+
+  /* Small graphs */
+  igraph_empty(&g, 0, IGRAPH_UNDIRECTED);
+  igraph_layout_pivot_mds(&g, &res, 2, 10, 0);
+  if (igraph_matrix_nrow(&res) != 0 || igraph_matrix_ncol(&res) != 2) {
+    return 10;
+  }
+  igraph_destroy(&g);
+  igraph_empty(&g, 1, IGRAPH_UNDIRECTED);
+  igraph_layout_pivot_mds(&g, &res, 3, 10, 0);
+  if (igraph_matrix_nrow(&res) != 1 || igraph_matrix_ncol(&res) != 3) {
+    return 11;
+  }
+  igraph_destroy(&g);
+  igraph_empty(&g, 2, IGRAPH_UNDIRECTED);
+  igraph_layout_pivot_mds(&g, &res, 2, 10, 0);
+  if (!all_finite(&res)) { return 12; }
+  igraph_destroy(&g);
+
+  /* Errors */
+  igraph_set_error_handler(igraph_error_handler_ignore);
+  igraph_ring(&g, 10, IGRAPH_UNDIRECTED, 0, 1);
+  if (igraph_layout_pivot_mds(&g, &res, 0, 10, 0) != IGRAPH_EINVAL) {
+    return 13;
+  }
+  if (igraph_layout_pivot_mds(&g, &res, 2, 2, 0) != IGRAPH_EINVAL) {
+    return 14;
+  }
+  igraph_vector_init(&weights, 10);
+  igraph_vector_fill(&weights, 1);
+  VECTOR(weights)[5]=0;
+  if (igraph_layout_pivot_mds(&g, &res, 2, 10, &weights) != IGRAPH_EINVAL) {
+    return 15;
+  }
+  igraph_vector_resize(&weights, 5);
+  if (igraph_layout_pivot_mds(&g, &res, 2, 10, &weights) != IGRAPH_EINVAL) {
+    return 16;
+  }
+  igraph_vector_destroy(&weights);
+  igraph_destroy(&g);
+
+  igraph_matrix_destroy(&res);
+  igraph_vector_destroy(&dims);
+
+  if (IGRAPH_FINALLY_STACK_SIZE() != 0) { return 17; }
+
+  return 0;
+}
@@ -0,0 +1,172 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2014  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+#include <math.h>
+
+/* Mean edge length divided by the mean distance of all pairs, this is
+   small for a good layout of a lattice */
+igraph_real_t ratio(const igraph_t *g, const igraph_matrix_t *res) {
+  long int no_of_nodes=igraph_vcount(g), no_of_edges=igraph_ecount(g);
+  long int i, j, k, dim=igraph_matrix_ncol(res);
+  igraph_real_t edges=0, pairs=0;
+  for (i=0; i<no_of_nodes; i++) {
+    for (j=i+1; j<no_of_nodes; j++) {
+      igraph_real_t d=0;
+      for (k=0; k<dim; k++) {
+	d += (MATRIX(*res, i, k)-MATRIX(*res, j, k)) *
+	  (MATRIX(*res, i, k)-MATRIX(*res, j, k));
+      }
+      pairs += sqrt(d);
+    }
+  }
+  for (i=0; i<no_of_edges; i++) {
+    long int from=IGRAPH_FROM(g, i), to=IGRAPH_TO(g, i);
+    igraph_real_t d=0;
+    for (k=0; k<dim; k++) {
+      d += (MATRIX(*res, from, k)-MATRIX(*res, to, k)) *
+	(MATRIX(*res, from, k)-MATRIX(*res, to, k));
+    }
+    edges += sqrt(d);
+  }
+  return (edges / no_of_edges) / (pairs / (no_of_nodes*(no_of_nodes-1)/2));
+}
+
+igraph_real_t dist(const igraph_matrix_t *res, long int i, long int j) {
+  long int k;
+  igraph_real_t d=0;
+  for (k=0; k<igraph_matrix_ncol(res); k++) {
+    d += (MATRIX(*res, i, k)-MATRIX(*res, j, k)) *
+      (MATRIX(*res, i, k)-MATRIX(*res, j, k));
+  }
+  return sqrt(d);
+}
+
+int all_finite(const igraph_matrix_t *res) {
+  long int i;
+  for (i=0; i<igraph_matrix_size(res); i++) {
+    if (!igraph_finite(VECTOR(res->data)[i])) { return 0; }
+  }
+  return 1;
+}
+
+int main() {
+  igraph_t g;
+  igraph_vector_t dims, weights;
+  igraph_matrix_t res, seed;
+
+  igraph_rng_seed(igraph_rng_default(), 42);
+  igraph_matrix_init(&res, 0, 0);
+
+  /* 2D lattice, with a few pivots and with all vertices as pivots */
+  igraph_vector_init(&dims, 2);
+  VECTOR(dims)[0]=30; VECTOR(dims)[1]=30;
+  igraph_lattice(&g, &dims, 1, IGRAPH_UNDIRECTED, 0, 0);
+  igraph_layout_sparse_stress(&g, &res, 0, 2, 20, 100, 1e-4, 0);
+  if (igraph_matrix_nrow(&res) != 900 || igraph_matrix_ncol(&res) != 2) {
+    return 1;
+  }
+  if (ratio(&g, &res) > 0.07) { return 2; }
+  igraph_layout_sparse_stress(&g, &res, 0, 2, 1000, 100, 1e-4, 0);
+  if (ratio(&g, &res) > 0.07) { return 3; }
+
+  /* no iterations, the seed is kept */
+  igraph_matrix_copy(&seed, &res);
+  igraph_layout_sparse_stress(&g, &res, 1, 2, 20, 0, 0, 0);
+  if (!igraph_matrix_all_e(&res, &seed)) { return 4; }
+  igraph_matrix_destroy(&seed);
+  igraph_destroy(&g);
+
+  /* 3D lattice */
+  igraph_vector_resize(&dims, 3);
+  VECTOR(dims)[0]=8; VECTOR(dims)[1]=8; VECTOR(dims)[2]=8;
+  igraph_lattice(&g, &dims, 1, IGRAPH_UNDIRECTED, 0, 0);
+  igraph_layout_sparse_stress(&g, &res, 0, 3, 20, 100, 1e-4, 0);
+  if (igraph_matrix_ncol(&res) != 3) { return 5; }
+  if (ratio(&g, &res) > 0.25) { return 6; }
+  igraph_destroy(&g);
+
+  /* a weighted triangle can be drawn exactly */
+  igraph_small(&g, 3, IGRAPH_UNDIRECTED, 0,1, 1,2, 0,2, -1);
+  igraph_vector_init_int_end(&weights, -1, 3, 4, 5, -1);
+  igraph_layout_sparse_stress(&g, &res, 0, 2, 3, 100, 0, &weights);
+  if (fabs(dist(&res, 0, 1)-3) > 1e-2 || fabs(dist(&res, 1, 2)-4) > 1e-2 ||
+      fabs(dist(&res, 0, 2)-5) > 1e-2) {
+    return 7;
+  }
+  igraph_vector_destroy(&weights);
+  igraph_destroy(&g);
+
+  /* disconnected graph with loops, multiple edges and isolated
+     vertices */
+  igraph_ring(&g, 20, IGRAPH_UNDIRECTED, 0, 1);
+  igraph_add_vertices(&g, 5, 0);
+  igraph_add_edge(&g, 0, 0);
+  igraph_add_edge(&g, 3, 4);
+  igraph_add_edge(&g, 20, 21);
+  igraph_layout_sparse_stress(&g, &res, 0, 2, 10, 100, 1e-4, 0);
+  if (!all_finite(&res)) { return 8; }
+  igraph_destroy(&g);
+
+  /* small graphs */
+  igraph_empty(&g, 0, IGRAPH_UNDIRECTED);
+  igraph_layout_sparse_stress(&g, &res, 0, 2, 10, 100, 1e-4, 0);
+  if (igraph_matrix_nrow(&res) != 0) { return 9; }
+  igraph_destroy(&g);
+  igraph_empty(&g, 1, IGRAPH_UNDIRECTED);
+  igraph_layout_sparse_stress(&g, &res, 0, 3, 10, 100, 1e-4, 0);
+  if (igraph_matrix_nrow(&res) != 1 || igraph_matrix_ncol(&res) != 3) {
+    return 10;
+  }
+  igraph_destroy(&g);
+  igraph_empty(&g, 3, IGRAPH_UNDIRECTED);
+  igraph_layout_sparse_stress(&g, &res, 0, 2, 10, 100, 1e-4, 0);
+  if (!all_finite(&res)) { return 11; }
+  igraph_destroy(&g);
+
+  /* errors */
+  igraph_set_error_handler(igraph_error_handler_ignore);
+  igraph_ring(&g, 10, IGRAPH_UNDIRECTED, 0, 1);
+  if (igraph_layout_sparse_stress(&g, &res, 0, 4, 10, 100, 0, 0) !=
+      IGRAPH_EINVAL) {
+    return 12;
+  }
+  if (igraph_layout_sparse_stress(&g, &res, 0, 2, 0, 100, 0, 0) !=
+      IGRAPH_EINVAL) {
+    return 13;
+  }
+  igraph_vector_init(&weights, 10);
+  igraph_vector_fill(&weights, 1);
+  VECTOR(weights)[5]=-1;
+  if (igraph_layout_sparse_stress(&g, &res, 0, 2, 10, 100, 0, &weights) !=
+      IGRAPH_EINVAL) {
+    return 14;
+  }
+  igraph_vector_destroy(&weights);
+  igraph_destroy(&g);
+
+  igraph_matrix_destroy(&res);
+  igraph_vector_destroy(&dims);
+
+  return 0;
+}
@@ -0,0 +1,173 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+#include <igraph.h>
+#include <math.h>
+
+/* Check the modularity tracker and the batch modularity calculation
+   against igraph_modularity(), on graphs with loops and multiple
+   edges. */
+
+int check_tracker(const igraph_t *g, const igraph_vector_t *weights,
+		  int code) {
+  igraph_modularity_tracker_t tracker;
+  igraph_vector_t membership;
+  igraph_real_t q, before, gain;
+  long int i, n=igraph_vcount(g);
+
+  igraph_vector_init(&membership, n);
+  for (i=0; i<n; i++) { VECTOR(membership)[i] = RNG_INTEGER(0, 9); }
+  igraph_modularity_tracker_init(&tracker, g, &membership, weights);
+  igraph_modularity(g, &membership, &q, weights);
+  if (fabs(q - igraph_modularity_tracker_get(&tracker)) > 1e-12) {
+    return code;
+  }
+
+  for (i=0; i<5000; i++) {
+    igraph_integer_t v=RNG_INTEGER(0, n-1), c=RNG_INTEGER(0, 14);
+    before=igraph_modularity_tracker_get(&tracker);
+    igraph_modularity_tracker_gain(&tracker, v, c, &gain);
+    igraph_modularity_tracker_move(&tracker, v, c);
+    VECTOR(membership)[(long int) v] = c;
+    if (fabs(igraph_modularity_tracker_get(&tracker) - before - gain) >
+	1e-12) {
+      return code+1;
+    }
+    if (i % 500 == 0) {
+      igraph_modularity(g, &membership, &q, weights);
+      if (fabs(q - igraph_modularity_tracker_get(&tracker)) > 1e-10) {
+	return code+2;
+      }
+    }
+  }
+  if (!igraph_vector_all_e(&membership,
+			   igraph_modularity_tracker_membership(&tracker))) {
+    return code+3;
+  }
+
+  igraph_modularity_tracker_destroy(&tracker);
+  igraph_vector_destroy(&membership);
+  return 0;
+}
+
+int check_batch(const igraph_t *g, const igraph_vector_t *weights,
+		int code) {
+  igraph_matrix_t memberships;
+  igraph_vector_t modularity, row;
+  igraph_real_t q;
+  long int i, j, n=igraph_vcount(g);
+
+  /* Not a multiple of the batch size, different number of
+     communities in the rows */
+  igraph_matrix_init(&memberships, 21, n);
+  for (i=0; i<21; i++) {
+    for (j=0; j<n; j++) {
+      MATRIX(memberships, i, j) = RNG_INTEGER(0, i+1);
+    }
+  }
+  igraph_vector_init(&modularity, 0);
+  igraph_vector_init(&row, 0);
+  igraph_modularity_batch(g, &memberships, &modularity, weights);
+  if (igraph_vector_size(&modularity) != 21) { return code; }
+  for (i=0; i<21; i++) {
+    igraph_matrix_get_row(&memberships, &row, i);
+    igraph_modularity(g, &row, &q, weights);
+    if (q != VECTOR(modularity)[i]) { return code+1; }
+  }
+
+  igraph_vector_destroy(&row);
+  igraph_vector_destroy(&modularity);
+  igraph_matrix_destroy(&memberships);
+  return 0;
+}
+
+int main() {
+  igraph_t g;
+  igraph_vector_t edges, weights, membership, modularity;
+  igraph_matrix_t memberships;
+  igraph_modularity_tracker_t tracker;
+  long int i;
+  int ret;
+
+  igraph_rng_seed(igraph_rng_default(), 42);
+
+  igraph_erdos_renyi_game(&g, IGRAPH_ERDOS_RENYI_GNM, 300, 1500,
+			  IGRAPH_UNDIRECTED, IGRAPH_LOOPS);
+  igraph_vector_init(&edges, 0);
+  igraph_get_edgelist(&g, &edges, 0);
+  igraph_vector_resize(&edges, 100);
+  igraph_add_edges(&g, &edges, 0);	/* multiple edges */
+  igraph_vector_destroy(&edges);
+  igraph_vector_init(&weights, igraph_ecount(&g));
+  for (i=0; i<igraph_ecount(&g); i++) {
+    VECTOR(weights)[i] = RNG_UNIF(0, 2);
+  }
+  if ((ret=check_tracker(&g, 0, 10))) { return ret; }
+  if ((ret=check_tracker(&g, &weights, 20))) { return ret; }
+  if ((ret=check_batch(&g, 0, 30))) { return ret; }
+  if ((ret=check_batch(&g, &weights, 40))) { return ret; }
+  igraph_destroy(&g);
+
+  /* Directed, the directions are ignored */
+  igraph_erdos_renyi_game(&g, IGRAPH_ERDOS_RENYI_GNM, 300, 1500,
+			  IGRAPH_DIRECTED, IGRAPH_LOOPS);
+  igraph_vector_resize(&weights, igraph_ecount(&g));
+  if ((ret=check_tracker(&g, &weights, 50))) { return ret; }
+  if ((ret=check_batch(&g, &weights, 60))) { return ret; }
+  igraph_destroy(&g);
+
+  /* No edges */
+  igraph_empty(&g, 5, IGRAPH_UNDIRECTED);
+  igraph_vector_init(&membership, 5);
+  igraph_modularity_tracker_init(&tracker, &g, &membership, 0);
+  igraph_modularity_tracker_move(&tracker, 2, 3);
+  if (igraph_modularity_tracker_get(&tracker) != 0) { return 70; }
+  igraph_modularity_tracker_destroy(&tracker);
+
+  /* Errors */
+  igraph_set_error_handler(igraph_error_handler_ignore);
+  VECTOR(membership)[0] = -1;
+  ret=igraph_modularity_tracker_init(&tracker, &g, &membership, 0);
+  if (ret != IGRAPH_EINVAL) { return 71; }
+  igraph_matrix_init(&memberships, 2, 4);
+  igraph_vector_init(&modularity, 0);
+  ret=igraph_modularity_batch(&g, &memberships, &modularity, 0);
+  if (ret != IGRAPH_EINVAL) { return 72; }
+  VECTOR(membership)[0] = 0;
+  igraph_modularity_tracker_init(&tracker, &g, &membership, 0);
+  ret=igraph_modularity_tracker_move(&tracker, 5, 0);
+  if (ret != IGRAPH_EINVVID) { return 73; }
+  ret=igraph_modularity_tracker_move(&tracker, 0, -1);
+  if (ret != IGRAPH_EINVAL) { return 74; }
+  igraph_modularity_tracker_destroy(&tracker);
+  igraph_set_error_handler(igraph_error_handler_abort);
+
+  igraph_vector_destroy(&modularity);
+  igraph_matrix_destroy(&memberships);
+  igraph_vector_destroy(&membership);
+  igraph_vector_destroy(&weights);
+  igraph_destroy(&g);
+
+  if (IGRAPH_FINALLY_STACK_SIZE() != 0) { return 80; }
+
+  return 0;
+}
@@ -0,0 +1,149 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+#include <math.h>
+
+/* The power method runs in parallel if igraph was compiled with
+   OpenMP. Check it against PRPACK, with and without weights and
+   reset vectors, on graphs with dangling vertices, loops and
+   multiple edges. */
+
+int check(const igraph_vector_t *v1, const igraph_vector_t *v2, int code) {
+  long int i, n=igraph_vector_size(v1);
+  if (igraph_vector_size(v2) != n) { return code; }
+  for (i=0; i<n; i++) {
+    if (fabs(VECTOR(*v1)[i] - VECTOR(*v2)[i]) > 1e-8) { return code; }
+  }
+  return 0;
+}
+
+igraph_real_t last_diff;
+long int no_of_calls;
+
+int progress(const char *message, igraph_real_t percent, void *data) {
+  last_diff=*(igraph_real_t*) data;
+  no_of_calls++;
+  return IGRAPH_SUCCESS;
+}
+
+int compare(const igraph_t *g, igraph_bool_t directed,
+	    const igraph_vector_t *weights, igraph_vector_t *reset,
+	    int code) {
+  igraph_vector_t power, prpack;
+  igraph_pagerank_power_options_t options;
+  igraph_real_t value;
+  int ret;
+
+  options.niter=1000; options.eps=1e-12;
+  igraph_vector_init(&power, 0);
+  igraph_vector_init(&prpack, 0);
+  igraph_personalized_pagerank(g, IGRAPH_PAGERANK_ALGO_POWER, &power,
+			       &value, igraph_vss_all(), directed, 0.85,
+			       reset, weights, &options);
+  igraph_personalized_pagerank(g, IGRAPH_PAGERANK_ALGO_PRPACK, &prpack,
+			       0, igraph_vss_all(), directed, 0.85,
+			       reset, weights, 0);
+  ret=check(&power, &prpack, code);
+  if (value != 1.0) { ret=code+1; }
+  igraph_vector_destroy(&prpack);
+  igraph_vector_destroy(&power);
+  return ret;
+}
+
+int main() {
+  igraph_t g;
+  igraph_vector_t weights, reset, res;
+  igraph_pagerank_power_options_t options;
+  long int i, no_of_edges;
+  int ret;
+
+  igraph_rng_seed(igraph_rng_default(), 42);
+
+  /* Sparse random graph, many vertices have no out-edges */
+  igraph_erdos_renyi_game(&g, IGRAPH_ERDOS_RENYI_GNM, 2000, 3000,
+			  IGRAPH_DIRECTED, IGRAPH_LOOPS);
+  no_of_edges=igraph_ecount(&g);
+  igraph_vector_init(&weights, no_of_edges);
+  for (i=0; i<no_of_edges; i++) {
+    VECTOR(weights)[i] = RNG_UNIF(0.5, 3);
+  }
+  igraph_vector_init(&reset, igraph_vcount(&g));
+  for (i=0; i<100; i++) {
+    VECTOR(reset)[RNG_INTEGER(0, igraph_vcount(&g)-1)] += 1;
+  }
+
+  if ((ret=compare(&g, 1, 0, 0, 10))) { return ret; }
+  if ((ret=compare(&g, 1, &weights, 0, 20))) { return ret; }
+  if ((ret=compare(&g, 1, 0, &reset, 30))) { return ret; }
+  if ((ret=compare(&g, 1, &weights, &reset, 40))) { return ret; }
+  if ((ret=compare(&g, 0, 0, 0, 50))) { return ret; }
+  if ((ret=compare(&g, 0, &weights, &reset, 60))) { return ret; }
+
+  /* Edges with zero weight are ignored */
+  VECTOR(weights)[0]=0; VECTOR(weights)[1]=0;
+  if ((ret=compare(&g, 1, &weights, 0, 70))) { return ret; }
+
+  /* Progress handler gets the largest change */
+  igraph_vector_init(&res, 0);
+  igraph_set_progress_handler(progress);
+  options.niter=1000; options.eps=1e-6;
+  igraph_pagerank(&g, IGRAPH_PAGERANK_ALGO_POWER, &res, 0,
+		  igraph_vss_all(), 1, 0.85, 0, &options);
+  igraph_set_progress_handler(0);
+  if (no_of_calls == 0 || no_of_calls >= 1000 || last_diff >= 1e-6) {
+    return 80;
+  }
+
+  /* Default options, vertex selector */
+  igraph_pagerank(&g, IGRAPH_PAGERANK_ALGO_POWER, &res, 0,
+		  igraph_vss_1(5), 1, 0.85, 0, 0);
+  if (igraph_vector_size(&res) != 1) { return 81; }
+
+  /* Negative reset vector */
+  VECTOR(reset)[0] = -1;
+  igraph_set_error_handler(igraph_error_handler_ignore);
+  ret=igraph_personalized_pagerank(&g, IGRAPH_PAGERANK_ALGO_POWER, &res, 0,
+				   igraph_vss_all(), 1, 0.85, &reset, 0, 0);
+  if (ret != IGRAPH_EINVAL) { return 82; }
+  igraph_set_error_handler(igraph_error_handler_abort);
+
+  igraph_vector_destroy(&res);
+  igraph_vector_destroy(&reset);
+  igraph_vector_destroy(&weights);
+  igraph_destroy(&g);
+
+  /* Undirected graph with isolated vertices */
+  igraph_small(&g, 6, IGRAPH_UNDIRECTED, 0,1, 1,2, 2,0, 2,3, 3,3, -1);
+  if ((ret=compare(&g, 1, 0, 0, 90))) { return ret; }
+  igraph_destroy(&g);
+
+  /* Null graph */
+  igraph_empty(&g, 0, IGRAPH_DIRECTED);
+  if ((ret=compare(&g, 1, 0, 0, 100))) { return ret; }
+  igraph_destroy(&g);
+
+  if (IGRAPH_FINALLY_STACK_SIZE() != 0) { return 110; }
+
+  return 0;
+}
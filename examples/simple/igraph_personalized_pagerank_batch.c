@@ -0,0 +1,145 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+#include <math.h>
+
+/* The batched personalized PageRank must give the same results as
+   separate calls for every reset vector, for full and partial
+   blocks of columns. */
+
+int compare(const igraph_t *g, igraph_bool_t directed,
+	    const igraph_vector_t *weights, const igraph_matrix_t *reset,
+	    igraph_vs_t vids, int code) {
+  igraph_matrix_t res;
+  igraph_vector_t col, single;
+  igraph_pagerank_power_options_t options;
+  long int i, j, ncol=igraph_matrix_ncol(reset);
+
+  options.niter=1000; options.eps=1e-12;
+  igraph_matrix_init(&res, 0, 0);
+  igraph_vector_init(&col, 0);
+  igraph_vector_init(&single, 0);
+  igraph_personalized_pagerank_batch(g, &res, vids, directed, 0.85, reset,
+				     weights, &options);
+  if (igraph_matrix_ncol(&res) != ncol) { return code; }
+  for (j=0; j<ncol; j++) {
+    igraph_matrix_get_col(reset, &col, j);
+    igraph_personalized_pagerank(g, IGRAPH_PAGERANK_ALGO_POWER, &single,
+				 0, vids, directed, 0.85, &col, weights,
+				 &options);
+    if (igraph_matrix_nrow(&res) != igraph_vector_size(&single)) {
+      return code+1;
+    }
+    for (i=0; i<igraph_vector_size(&single); i++) {
+      if (fabs(MATRIX(res, i, j) - VECTOR(single)[i]) > 1e-10) {
+	return code+2;
+      }
+    }
+  }
+  igraph_vector_destroy(&single);
+  igraph_vector_destroy(&col);
+  igraph_matrix_destroy(&res);
+  return 0;
+}
+
+int main() {
+  igraph_t g;
+  igraph_matrix_t reset, res;
+  igraph_vector_t weights;
+  long int i, j, no_of_nodes, no_of_edges;
+  int ret;
+
+  igraph_rng_seed(igraph_rng_default(), 42);
+
+  igraph_erdos_renyi_game(&g, IGRAPH_ERDOS_RENYI_GNM, 1000, 2500,
+			  IGRAPH_DIRECTED, IGRAPH_LOOPS);
+  no_of_nodes=igraph_vcount(&g);
+  no_of_edges=igraph_ecount(&g);
+  igraph_vector_init(&weights, no_of_edges);
+  for (i=0; i<no_of_edges; i++) {
+    VECTOR(weights)[i] = RNG_UNIF(0.5, 3);
+  }
+
+  /* 19 columns: two full blocks and a partial one. Single seeds,
+     seed sets with weights and a uniform column. */
+  igraph_matrix_init(&reset, no_of_nodes, 19);
+  for (j=0; j<18; j++) {
+    for (i=0; i<=j%4; i++) {
+      MATRIX(reset, RNG_INTEGER(0, no_of_nodes-1), j) += i+1;
+    }
+  }
+  for (i=0; i<no_of_nodes; i++) {
+    MATRIX(reset, i, 18) = 1;
+  }
+
+  if ((ret=compare(&g, 1, 0, &reset, igraph_vss_all(), 10))) { return ret; }
+  if ((ret=compare(&g, 1, &weights, &reset, igraph_vss_all(), 20))) {
+    return ret;
+  }
+  if ((ret=compare(&g, 0, &weights, &reset, igraph_vss_seq(10, 20), 30))) {
+    return ret;
+  }
+
+  /* A single column */
+  igraph_matrix_resize(&reset, no_of_nodes, 1);
+  if ((ret=compare(&g, 1, 0, &reset, igraph_vss_all(), 40))) { return ret; }
+
+  /* No columns */
+  igraph_matrix_init(&res, 0, 0);
+  igraph_matrix_resize(&reset, no_of_nodes, 0);
+  igraph_personalized_pagerank_batch(&g, &res, igraph_vss_all(), 1, 0.85,
+				     &reset, 0, 0);
+  if (igraph_matrix_nrow(&res) != no_of_nodes ||
+      igraph_matrix_ncol(&res) != 0) {
+    return 50;
+  }
+
+  /* Invalid reset matrices */
+  igraph_set_error_handler(igraph_error_handler_ignore);
+  igraph_matrix_resize(&reset, no_of_nodes, 2);
+  igraph_matrix_fill(&reset, 1);
+  MATRIX(reset, 3, 1) = -1;
+  ret=igraph_personalized_pagerank_batch(&g, &res, igraph_vss_all(), 1,
+					 0.85, &reset, 0, 0);
+  if (ret != IGRAPH_EINVAL) { return 51; }
+  igraph_matrix_fill(&reset, 1);
+  for (i=0; i<no_of_nodes; i++) { MATRIX(reset, i, 1) = 0; }
+  ret=igraph_personalized_pagerank_batch(&g, &res, igraph_vss_all(), 1,
+					 0.85, &reset, 0, 0);
+  if (ret != IGRAPH_EINVAL) { return 52; }
+  igraph_matrix_resize(&reset, 10, 2);
+  ret=igraph_personalized_pagerank_batch(&g, &res, igraph_vss_all(), 1,
+					 0.85, &reset, 0, 0);
+  if (ret != IGRAPH_EINVAL) { return 53; }
+  igraph_set_error_handler(igraph_error_handler_abort);
+
+  igraph_matrix_destroy(&res);
+  igraph_matrix_destroy(&reset);
+  igraph_vector_destroy(&weights);
+  igraph_destroy(&g);
+
+  if (IGRAPH_FINALLY_STACK_SIZE() != 0) { return 60; }
+
+  return 0;
+}
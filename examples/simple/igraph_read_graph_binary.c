@@ -0,0 +1,159 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+#include <stdio.h>
+
+/* Write a graph in binary format and read it back, both into memory
+   and memory mapped. The mapped graph must be usable and modifiable
+   like any other graph. */
+
+int same(const igraph_t *g1, const igraph_t *g2) {
+  igraph_vector_t el1, el2, deg1, deg2;
+  int res;
+  igraph_vector_init(&el1, 0);
+  igraph_vector_init(&el2, 0);
+  igraph_vector_init(&deg1, 0);
+  igraph_vector_init(&deg2, 0);
+  igraph_get_edgelist(g1, &el1, 0);
+  igraph_get_edgelist(g2, &el2, 0);
+  igraph_degree(g1, &deg1, igraph_vss_all(), IGRAPH_IN, IGRAPH_LOOPS);
+  igraph_degree(g2, &deg2, igraph_vss_all(), IGRAPH_IN, IGRAPH_LOOPS);
+  res = igraph_vcount(g1) == igraph_vcount(g2) &&
+    igraph_is_directed(g1) == igraph_is_directed(g2) &&
+    igraph_vector_all_e(&el1, &el2) && igraph_vector_all_e(&deg1, &deg2);
+  igraph_vector_destroy(&deg2);
+  igraph_vector_destroy(&deg1);
+  igraph_vector_destroy(&el2);
+  igraph_vector_destroy(&el1);
+  return res;
+}
+
+/* Write the graph, overwrite the integer at index 'pos' of the edge
+   index with 'value', and read the file back into memory */
+
+int damaged(const igraph_t *graph, long int pos, int value) {
+  igraph_t g;
+  FILE *file=tmpfile();
+  int ret;
+  if (!file) { return -1; }
+  igraph_write_graph_binary(graph, file);
+  fseek(file, 40 + pos * (long int) sizeof(int), SEEK_SET);
+  fwrite(&value, sizeof(int), 1, file);
+  rewind(file);
+  ret=igraph_read_graph_binary(&g, file, /*map=*/ 0);
+  if (ret == 0) { igraph_destroy(&g); }
+  fclose(file);
+  return ret;
+}
+
+int main() {
+  igraph_t g, g2, g3, g4;
+  igraph_vector_t edges;
+  FILE *file;
+  long int pos;
+
+  igraph_i_set_attribute_table(&igraph_cattribute_table);
+  igraph_rng_seed(igraph_rng_default(), 42);
+
+  /* Two graphs in one file */
+  igraph_erdos_renyi_game(&g, IGRAPH_ERDOS_RENYI_GNM, 100, 300, 
+			  IGRAPH_DIRECTED, IGRAPH_LOOPS);
+  igraph_empty(&g2, 10, IGRAPH_UNDIRECTED);
+  file=tmpfile();
+  if (!file) { return 1; }
+  igraph_write_graph_binary(&g, file);
+  pos=ftell(file);
+  igraph_write_graph_binary(&g2, file);
+  igraph_destroy(&g2);
+
+  /* Read into memory */
+  rewind(file);
+  igraph_read_graph_binary(&g2, file, /*map=*/ 0);
+  if (!same(&g, &g2)) { return 2; }
+  if (ftell(file) != pos) { return 3; }
+  igraph_destroy(&g2);
+
+  /* Memory mapped */
+  rewind(file);
+  igraph_read_graph_binary(&g2, file, /*map=*/ 1);
+  if (!same(&g, &g2)) { return 4; }
+  if (ftell(file) != pos) { return 5; }
+  igraph_read_graph_binary(&g3, file, /*map=*/ 1);
+  if (igraph_vcount(&g3) != 10 || igraph_ecount(&g3) != 0 ||
+      igraph_is_directed(&g3)) {
+    return 6;
+  }
+  fclose(file);
+
+  /* Copies, attributes and modifications work */
+  igraph_copy(&g4, &g2);
+  if (!same(&g, &g4)) { return 7; }
+  SETVAN(&g2, "color", 99, 1);
+  SETEAN(&g2, "weight", 299, 2);
+  igraph_vector_init_seq(&edges, 0, 9);
+  igraph_add_edges(&g, &edges, 0);
+  igraph_add_edges(&g2, &edges, 0);
+  if (!same(&g, &g2)) { return 8; }
+  if (VAN(&g2, "color", 99) != 1 || EAN(&g2, "weight", 299) != 2) {
+    return 9;
+  }
+  igraph_delete_vertices(&g3, igraph_vss_1(0));
+  igraph_add_vertices(&g3, 2, 0);
+  if (igraph_vcount(&g3) != 11) { return 10; }
+  igraph_delete_edges(&g4, igraph_ess_1(0));
+  if (igraph_ecount(&g4) != 299) { return 11; }
+
+  igraph_vector_destroy(&edges);
+  igraph_destroy(&g4);
+  igraph_destroy(&g3);
+  igraph_destroy(&g2);
+  igraph_destroy(&g);
+
+  /* Not a binary graph */
+  file=tmpfile();
+  fprintf(file, "0 1\n1 2\n2 3\n3 4\n4 5\n5 6\n6 7\n7 8\n8 9\n9 10\n");
+  rewind(file);
+  igraph_set_error_handler(igraph_error_handler_ignore);
+  if (igraph_read_graph_binary(&g, file, 1) != IGRAPH_PARSEERROR) {
+    return 12;
+  }
+  fclose(file);
+
+  /* Damaged files. The index of this graph is: from (0-2), to (3-5),
+     oi (6-8), ii (9-11), os (12-15) and is (16-19). */
+  igraph_small(&g, 3, IGRAPH_DIRECTED, 0,1, 0,2, 1,2, -1);
+  if (damaged(&g, 15, 3) != 0) { return 13; }
+  if (damaged(&g, 0, 3) != IGRAPH_PARSEERROR) { return 14; }
+  if (damaged(&g, 4, -1) != IGRAPH_PARSEERROR) { return 15; }
+  if (damaged(&g, 6, 1) != IGRAPH_PARSEERROR) { return 16; }
+  if (damaged(&g, 8, 1) != IGRAPH_PARSEERROR) { return 17; }
+  if (damaged(&g, 13, 5) != IGRAPH_PARSEERROR) { return 18; }
+  if (damaged(&g, 17, 2) != IGRAPH_PARSEERROR) { return 19; }
+  if (damaged(&g, 9, 2) != IGRAPH_PARSEERROR) { return 20; }
+  igraph_destroy(&g);
+
+  if (IGRAPH_FINALLY_STACK_SIZE() != 0) { return 21; }
+
+  return 0;
+}
@@ -0,0 +1,149 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/* The edge list reader parses the input in chunks, possibly in
+   parallel, check that this gives the same result as writing the
+   graph out. */
+
+int check(const char *text, const igraph_real_t *expected, long int n) {
+  igraph_t g;
+  igraph_vector_t el, exp;
+  FILE *file=tmpfile();
+  int ret;
+
+  /* The reader starts at the current position of the stream */
+  fputs("garbage ", file);
+  fputs(text, file);
+  fseek(file, 8, SEEK_SET);
+  ret=igraph_read_graph_edgelist(&g, file, 0, IGRAPH_DIRECTED);
+  fclose(file);
+  if (ret) { return ret; }
+  igraph_vector_init(&el, 0);
+  igraph_get_edgelist(&g, &el, 0);
+  igraph_vector_view(&exp, expected, n);
+  ret=igraph_vector_all_e(&el, &exp) ? 0 : 1;
+  igraph_vector_destroy(&el);
+  igraph_destroy(&g);
+  return ret;
+}
+
+int main() {
+  igraph_t g, g2;
+  igraph_vector_t el, el2;
+  igraph_eit_t eit;
+  FILE *file;
+  int fd[2];
+  igraph_real_t exp1[] = { 0, 1, 1, 2, 2, 3, 8, 16, 10, 255 };
+
+  igraph_set_error_handler(igraph_error_handler_ignore);
+
+  /* Whitespace, octal and hexadecimal numbers, like fscanf("%li") */
+  if (check("0 1\n1\t2\r\n  +2 3 010 0x10 \f\v 10 0XfF", exp1, 10)) {
+    return 1;
+  }
+  if (check("", exp1, 0)) {
+    return 2;
+  }
+  if (check("\n\n0\n1\n", exp1, 2)) {
+    return 3;
+  }
+  
+  /* Errors */
+  if (check("0 1 2", exp1, 0) != IGRAPH_PARSEERROR) {
+    return 4;
+  }
+  if (check("0 1 2 x", exp1, 0) != IGRAPH_PARSEERROR) {
+    return 5;
+  }
+  if (check("0 1 2 09", exp1, 0) != IGRAPH_PARSEERROR) {
+    return 6;
+  }
+  if (check("0 1 2 3.0", exp1, 0) != IGRAPH_PARSEERROR) {
+    return 7;
+  }
+  if (check("0 1 - 3", exp1, 0) != IGRAPH_PARSEERROR) {
+    return 8;
+  }
+  if (check("0 1 -1 3", exp1, 0) != IGRAPH_EINVVID) {
+    return 9;
+  }
+
+  /* A large graph, the file is read in many chunks */
+  igraph_rng_seed(igraph_rng_default(), 42);
+  igraph_erdos_renyi_game(&g, IGRAPH_ERDOS_RENYI_GNM, 100000, 500000,
+			  IGRAPH_DIRECTED, IGRAPH_LOOPS);
+  file=tmpfile();
+  igraph_write_graph_edgelist(&g, file);
+  rewind(file);
+  if (igraph_read_graph_edgelist(&g2, file, 0, IGRAPH_DIRECTED)) {
+    return 10;
+  }
+  fclose(file);
+  /* The edges are written in the order of their source vertex */
+  igraph_vector_init(&el, 0);
+  igraph_vector_init(&el2, 0);
+  igraph_eit_create(&g, igraph_ess_all(IGRAPH_EDGEORDER_FROM), &eit);
+  for (; !IGRAPH_EIT_END(eit); IGRAPH_EIT_NEXT(eit)) {
+    igraph_integer_t from, to;
+    igraph_edge(&g, IGRAPH_EIT_GET(eit), &from, &to);
+    igraph_vector_push_back(&el, from);
+    igraph_vector_push_back(&el, to);
+  }
+  igraph_eit_destroy(&eit);
+  igraph_get_edgelist(&g2, &el2, 0);
+  if (!igraph_vector_all_e(&el, &el2)) {
+    return 11;
+  }
+  igraph_destroy(&g2);
+
+  /* A pipe cannot be mapped to memory, it is read into a buffer */
+  if (pipe(fd)) {
+    return 12;
+  }
+  file=fdopen(fd[0], "r");
+  if (write(fd[1], "1 2\n3 4\n", 8) != 8) {
+    return 13;
+  }
+  close(fd[1]);
+  if (igraph_read_graph_edgelist(&g2, file, 0, IGRAPH_UNDIRECTED)) {
+    return 14;
+  }
+  fclose(file);
+  igraph_get_edgelist(&g2, &el2, 0);
+  if (igraph_vcount(&g2) != 5 || igraph_vector_size(&el2) != 4 ||
+      VECTOR(el2)[0] != 1 || VECTOR(el2)[3] != 4) {
+    return 15;
+  }
+  igraph_destroy(&g2);
+
+  igraph_vector_destroy(&el2);
+  igraph_vector_destroy(&el);
+  igraph_destroy(&g);
+
+  return 0;
+}
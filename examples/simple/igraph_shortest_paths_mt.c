@@ -0,0 +1,180 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#include <igraph.h>
+#include <math.h>
+
+/* The shortest path length calculations run in parallel if igraph
+   was compiled with OpenMP, and unweighted ones use a bit-parallel
+   BFS. Compare them to the Bellman-Ford algorithm, which is
+   sequential, and check that the derived measures agree with the
+   distance matrix. */
+
+int check_matrix(const igraph_matrix_t *m1, const igraph_matrix_t *m2,
+		 int code) {
+  long int i, n=igraph_matrix_size(m1);
+  if (igraph_matrix_nrow(m1) != igraph_matrix_nrow(m2) ||
+      igraph_matrix_ncol(m1) != igraph_matrix_ncol(m2)) { return code; }
+  for (i=0; i<n; i++) {
+    igraph_real_t a=VECTOR(m1->data)[i], b=VECTOR(m2->data)[i];
+    if (a == b) { continue; }
+    if (fabs(a-b) > 1e-10 * (1+fabs(a))) { return code; }
+  }
+  return 0;
+}
+
+int check_vector(const igraph_vector_t *v1, const igraph_vector_t *v2,
+		 int code) {
+  long int i, n=igraph_vector_size(v1);
+  if (igraph_vector_size(v2) != n) { return code; }
+  for (i=0; i<n; i++) {
+    if (fabs(VECTOR(*v1)[i] - VECTOR(*v2)[i]) > 1e-12) { return code; }
+  }
+  return 0;
+}
+
+int test(igraph_bool_t directed, int code) {
+  igraph_t g;
+  igraph_vector_t weights, close, close2, ecc, nsize, hist, to;
+  igraph_matrix_t dist, dist2;
+  igraph_neimode_t mode=directed ? IGRAPH_OUT : IGRAPH_ALL;
+  igraph_real_t apl, unconn, sum, pairs=0, sumdist=0, maxdist=0;
+  igraph_integer_t diam;
+  long int i, j, no_of_nodes, no_of_edges;
+  int ret;
+
+  igraph_erdos_renyi_game(&g, IGRAPH_ERDOS_RENYI_GNM, 300, 400, directed,
+			  /*loops=*/ 0);
+  no_of_nodes=igraph_vcount(&g);
+  no_of_edges=igraph_ecount(&g);
+  igraph_vector_init(&weights, no_of_edges);
+  igraph_matrix_init(&dist, 0, 0);
+  igraph_matrix_init(&dist2, 0, 0);
+
+  /* Unweighted vs. unit weights */
+  igraph_vector_fill(&weights, 1.0);
+  igraph_shortest_paths(&g, &dist, igraph_vss_all(), igraph_vss_all(), mode);
+  igraph_shortest_paths_bellman_ford(&g, &dist2, igraph_vss_all(),
+				     igraph_vss_all(), &weights, mode);
+  if ((ret=check_matrix(&dist, &dist2, code+1))) { return ret; }
+
+  /* Some of the targets only, in reverse order */
+  igraph_vector_init_seq(&to, 0, 49);
+  igraph_vector_reverse(&to);
+  igraph_shortest_paths(&g, &dist2, igraph_vss_all(), igraph_vss_vector(&to),
+			mode);
+  for (i=0; i<no_of_nodes; i++) {
+    for (j=0; j<50; j++) {
+      if (MATRIX(dist2, i, j) != MATRIX(dist, i, 49-j)) { return code+2; }
+    }
+  }
+
+  /* Derived measures */
+  igraph_vector_init(&close, 0);
+  igraph_vector_init(&close2, 0);
+  igraph_vector_init(&ecc, 0);
+  igraph_vector_init(&nsize, 0);
+  igraph_closeness(&g, &close, igraph_vss_all(), mode, /*weights=*/ 0,
+		   /*normalized=*/ 0);
+  for (i=0; i<no_of_nodes; i++) {
+    sum=0;
+    for (j=0; j<no_of_nodes; j++) {
+      igraph_real_t d=MATRIX(dist, i, j);
+      sum += d == IGRAPH_INFINITY ? no_of_nodes : d;
+      if (i != j && d != IGRAPH_INFINITY) {
+	pairs += 1; sumdist += d;
+	if (d > maxdist) { maxdist = d; }
+      }
+    }
+    if (fabs(VECTOR(close)[i] - 1.0/sum) > 1e-12) { return code+3; }
+  }
+  igraph_closeness_estimate(&g, &close2, igraph_vss_all(), mode, 
+			    /*cutoff=*/ 2, /*weights=*/ 0, /*normalized=*/ 0);
+  igraph_closeness_estimate(&g, &close, igraph_vss_all(), mode, 
+			    /*cutoff=*/ 2, &weights, /*normalized=*/ 0);
+  if ((ret=check_vector(&close, &close2, code+13))) { return ret; }
+  igraph_eccentricity(&g, &ecc, igraph_vss_all(), mode);
+  igraph_neighborhood_size(&g, &nsize, igraph_vss_all(), /*order=*/ 3, 
+			   mode, /*mindist=*/ 1);
+  for (i=0; i<no_of_nodes; i++) {
+    igraph_real_t maxd=0, sum2=0, size=0;
+    for (j=0; j<no_of_nodes; j++) {
+      igraph_real_t d=MATRIX(dist, i, j);
+      sum2 += d <= 2 ? d : no_of_nodes;
+      if (d != IGRAPH_INFINITY && d > maxd) { maxd = d; }
+      if (d >= 1 && d <= 3) { size++; }
+    }
+    if (fabs(VECTOR(close2)[i] - 1.0/sum2) > 1e-12) { return code+10; }
+    if (VECTOR(ecc)[i] != maxd) { return code+11; }
+    if (VECTOR(nsize)[i] != size) { return code+12; }
+  }
+  igraph_average_path_length(&g, &apl, directed, /*unconn=*/ 1);
+  if (fabs(apl - sumdist/pairs) > 1e-10) { return code+4; }
+  igraph_diameter(&g, &diam, 0, 0, 0, directed, /*unconn=*/ 1);
+  if (diam != maxdist) { return code+5; }
+  igraph_vector_init(&hist, 0);
+  igraph_path_length_hist(&g, &hist, &unconn, directed);
+  if (igraph_vector_size(&hist) != maxdist) { return code+6; }
+  if (!directed) { pairs /= 2; }
+  if (igraph_vector_sum(&hist) != pairs) { return code+7; }
+
+  /* Random weights, Dijkstra vs. Bellman-Ford */
+  for (i=0; i<no_of_edges; i++) {
+    VECTOR(weights)[i] = igraph_rng_get_unif(igraph_rng_default(), 1, 10);
+  }
+  igraph_shortest_paths_dijkstra(&g, &dist, igraph_vss_all(), 
+				 igraph_vss_all(), &weights, mode);
+  igraph_shortest_paths_bellman_ford(&g, &dist2, igraph_vss_all(),
+				     igraph_vss_all(), &weights, mode);
+  if ((ret=check_matrix(&dist, &dist2, code+8))) { return ret; }
+  igraph_shortest_paths_dijkstra(&g, &dist2, igraph_vss_all(),
+				 igraph_vss_vector(&to), &weights, mode);
+  for (i=0; i<no_of_nodes; i++) {
+    for (j=0; j<50; j++) {
+      if (MATRIX(dist2, i, j) != MATRIX(dist, i, 49-j)) { return code+9; }
+    }
+  }
+
+  igraph_vector_destroy(&hist);
+  igraph_vector_destroy(&nsize);
+  igraph_vector_destroy(&ecc);
+  igraph_vector_destroy(&close2);
+  igraph_vector_destroy(&close);
+  igraph_vector_destroy(&to);
+  igraph_matrix_destroy(&dist2);
+  igraph_matrix_destroy(&dist);
+  igraph_vector_destroy(&weights);
+  igraph_destroy(&g);
+  return 0;
+}
+
+int main() {
+  int ret;
+
+  igraph_rng_seed(igraph_rng_default(), 42);
+
+  if ((ret=test(/*directed=*/ 0, 0)))  { return ret; }
+  if ((ret=test(/*directed=*/ 1, 10))) { return ret; }
+
+  return 0;
+}
@@ -188,6 +188,94 @@ void igraph_lazy_inclist_clear(igraph_lazy_inclist_t *il);
 igraph_vector_t *igraph_lazy_inclist_get_real(igraph_lazy_inclist_t *al,
 						    igraph_integer_t no);
 
+typedef struct igraph_csr_t {
+  igraph_integer_t length;
+  igraph_bool_t weighted;
+  igraph_vector_int_t offsets;
+  igraph_vector_int_t neis;
+  igraph_vector_int_t edges;
+  igraph_vector_t weights;
+} igraph_csr_t;
+
+int igraph_csr_init(const igraph_t *graph, igraph_csr_t *csr,
+		    igraph_neimode_t mode, const igraph_vector_t *weights);
+void igraph_csr_destroy(igraph_csr_t *csr);
+
+/**
+ * \define igraph_csr_size
+ * The number of vertices in a CSR snapshot
+ * 
+ * \param csr The CSR snapshot.
+ * \return The number of vertices.
+ * 
+ * Time complexity: O(1).
+ */
+#define igraph_csr_size(csr) ((csr)->length)
+
+/**
+ * \define igraph_csr_degree
+ * The number of neighbors of a vertex in a CSR snapshot
+ * 
+ * \param csr The CSR snapshot.
+ * \param no The vertex id.
+ * \return The number of adjacent vertices, which is the same as the
+ *   number of incident edges.
+ * 
+ * Time complexity: O(1).
+ */
+#define igraph_csr_degree(csr,no) \
+  (VECTOR((csr)->offsets)[(long int)(no)+1] - \
+   VECTOR((csr)->offsets)[(long int)(no)])
+
+/**
+ * \define igraph_csr_neis
+ * The neighbors of a vertex in a CSR snapshot
+ * 
+ * \param csr The CSR snapshot.
+ * \param no The vertex id.
+ * \return Pointer to the first neighbor of the vertex, an
+ *   <type>int</type> array of length \ref igraph_csr_degree(). It
+ *   must not be modified.
+ * 
+ * Time complexity: O(1).
+ */
+#define igraph_csr_neis(csr,no) \
+  (VECTOR((csr)->neis) + VECTOR((csr)->offsets)[(long int)(no)])
+
+/**
+ * \define igraph_csr_edges
+ * The incident edges of a vertex in a CSR snapshot
+ * 
+ * \param csr The CSR snapshot.
+ * \param no The vertex id.
+ * \return Pointer to the first incident edge of the vertex, an
+ *   <type>int</type> array of length \ref igraph_csr_degree(). The
+ *   edges are in the same order as the neighbors returned by \ref
+ *   igraph_csr_neis(). It must not be modified.
+ * 
+ * Time complexity: O(1).
+ */
+#define igraph_csr_edges(csr,no) \
+  (VECTOR((csr)->edges) + VECTOR((csr)->offsets)[(long int)(no)])
+
+/**
+ * \define igraph_csr_weights
+ * The weights of the incident edges of a vertex in a CSR snapshot
+ * 
+ * This can only be used if the snapshot was created with weights.
+ * \param csr The CSR snapshot.
+ * \param no The vertex id.
+ * \return Pointer to the weight of the first incident edge of the
+ *   vertex, an <type>igraph_real_t</type> array of length \ref
+ *   igraph_csr_degree(). The weights are in the same order as the
+ *   edges returned by \ref igraph_csr_edges(). It must not be
+ *   modified.
+ * 
+ * Time complexity: O(1).
+ */
+#define igraph_csr_weights(csr,no) \
+  (VECTOR((csr)->weights) + VECTOR((csr)->offsets)[(long int)(no)])
+
 /************************************************************************* 
  * DEPRECATED TYPES AND FUNCTIONS
  */
@@ -79,8 +79,9 @@ int igraph_pagerank_old(const igraph_t *graph, igraph_vector_t *res,
  * \brief PageRank algorithm implementation
  *
  * Algorithms to calculate PageRank.
- * \enumval IGRAPH_PAGERANK_ALGO_POWER Use a simple power iteration,
- *   as it was implemented before igraph version 0.5.
+ * \enumval IGRAPH_PAGERANK_ALGO_POWER Use igraph's own power
+ *   iteration, which runs in parallel if igraph was compiled with
+ *   OpenMP support.
  * \enumval IGRAPH_PAGERANK_ALGO_ARPACK Use the ARPACK library, this
  *   was the PageRank implementation in igraph from version 0.5, until
  *   version 0.7.
@@ -98,10 +99,17 @@ typedef enum {
  * \struct igraph_pagerank_power_options_t
  * \brief Options for the power method
  *
- * \member niter The number of iterations to perform, integer.
+ * If a progress handler is installed, it is called after every
+ * iteration, and its \c data argument points to the largest change
+ * of a PageRank value in that iteration, an <type>igraph_real_t</type>.
+ * If a null pointer is given instead of the options, then at most
+ * 1000 iterations are performed, with \c eps 1e-10.
+ *
+ * \member niter The maximum number of iterations to perform, integer.
  * \member eps  The algorithm will consider the calculation as complete
  *        if the difference of values between iterations change
- *        less than this value for every vertex.
+ *        less than this value for every vertex. If zero, then
+ *        exactly \c niter iterations are performed.
  */
 
 typedef struct igraph_pagerank_power_options_t {
@@ -127,6 +135,12 @@ int igraph_personalized_pagerank_vs(const igraph_t *graph,
 		    igraph_bool_t directed, igraph_real_t damping,
 			igraph_vs_t reset_vids,
 		    const igraph_vector_t *weights, void *options);
+int igraph_personalized_pagerank_batch(const igraph_t *graph,
+		    igraph_matrix_t *res, const igraph_vs_t vids,
+		    igraph_bool_t directed, igraph_real_t damping,
+		    const igraph_matrix_t *reset,
+		    const igraph_vector_t *weights,
+		    const igraph_pagerank_power_options_t *options);
 
 int igraph_eigenvector_centrality(const igraph_t *graph, igraph_vector_t *vector,
 				  igraph_real_t *value,
@@ -39,6 +39,7 @@
 #include "igraph_types.h"
 #include "igraph_arpack.h"
 #include "igraph_vector_ptr.h"
+#include "igraph_adjlist.h"
 
 __BEGIN_DECLS
 
@@ -82,6 +83,23 @@ int igraph_community_spinglass(const igraph_t *graph,
 /* 			       igraph_real_t *polarization, */
 			       igraph_real_t lambda);
 
+int igraph_community_spinglass_replicas(const igraph_t *graph,
+					const igraph_vector_t *weights,
+					igraph_real_t *modularity,
+					igraph_real_t *temperature,
+					igraph_vector_t *membership, 
+					igraph_vector_t *csize, 
+					igraph_integer_t spins,
+					igraph_bool_t parupdate,
+					igraph_real_t starttemp,
+					igraph_real_t stoptemp,
+					igraph_real_t coolfact,
+					igraph_spincomm_update_t update_rule,
+					igraph_real_t gamma,
+					igraph_spinglass_implementation_t implementation,
+					igraph_real_t lambda,
+					igraph_integer_t replicas);
+
 int igraph_community_spinglass_single(const igraph_t *graph,
 				      const igraph_vector_t *weights,
 				      igraph_integer_t vertex,
@@ -100,6 +118,13 @@ int igraph_community_walktrap(const igraph_t *graph,
 			      igraph_matrix_t *merges,
 			      igraph_vector_t *modularity, 
 			      igraph_vector_t *membership);
+int igraph_community_walktrap_memory(const igraph_t *graph, 
+				     const igraph_vector_t *weights,
+				     int steps, igraph_real_t max_memory,
+				     igraph_matrix_t *merges,
+				     igraph_vector_t *modularity, 
+				     igraph_vector_t *membership,
+				     igraph_real_t *peak_memory);
 
 int igraph_community_infomap(const igraph_t * graph,
 			     const igraph_vector_t *e_weights,
@@ -146,6 +171,47 @@ int igraph_modularity(const igraph_t *graph,
 		      igraph_real_t *modularity,
               const igraph_vector_t *weights);
 
+int igraph_modularity_batch(const igraph_t *graph,
+			    const igraph_matrix_t *memberships,
+			    igraph_vector_t *modularity,
+			    const igraph_vector_t *weights);
+
+typedef struct igraph_modularity_tracker_t {
+  igraph_csr_t csr;
+  igraph_vector_t membership;
+  igraph_vector_t strength;	/* of the vertices */
+  igraph_vector_t internal;	/* twice the internal weight */
+  igraph_vector_t total;	/* total strength of the communities */
+  igraph_real_t m, sum_internal, sum_total2;
+} igraph_modularity_tracker_t;
+
+int igraph_modularity_tracker_init(igraph_modularity_tracker_t *tracker,
+				   const igraph_t *graph,
+				   const igraph_vector_t *membership,
+				   const igraph_vector_t *weights);
+void igraph_modularity_tracker_destroy(igraph_modularity_tracker_t *tracker);
+igraph_real_t igraph_modularity_tracker_get(const igraph_modularity_tracker_t *tracker);
+int igraph_modularity_tracker_gain(const igraph_modularity_tracker_t *tracker,
+				   igraph_integer_t vertex,
+				   igraph_integer_t community,
+				   igraph_real_t *gain);
+int igraph_modularity_tracker_move(igraph_modularity_tracker_t *tracker,
+				   igraph_integer_t vertex,
+				   igraph_integer_t community);
+
+/**
+ * \define igraph_modularity_tracker_membership
+ * The current communities of a modularity tracker
+ *
+ * \param tracker The modularity tracker.
+ * \return Pointer to the membership vector. It must not be modified,
+ *   use \ref igraph_modularity_tracker_move() instead.
+ *
+ * Time complexity: O(1).
+ */
+#define igraph_modularity_tracker_membership(tracker) \
+  ((const igraph_vector_t *) &(tracker)->membership)
+
 int igraph_modularity_matrix(const igraph_t *graph, 
 			     const igraph_vector_t *membership,
 			     igraph_matrix_t *modmat, 
@@ -222,6 +288,30 @@ int igraph_community_multilevel(const igraph_t *graph,
                                 igraph_vector_t *membership,
                                 igraph_matrix_t *memberships,
                                 igraph_vector_t *modularity);
+int igraph_community_leiden(const igraph_t *graph,
+                            const igraph_vector_t *edge_weights,
+                            const igraph_vector_t *node_weights,
+                            igraph_real_t resolution_parameter,
+                            igraph_real_t beta, igraph_bool_t start,
+                            igraph_integer_t n_iterations,
+                            igraph_vector_t *membership,
+                            igraph_integer_t *nb_clusters,
+                            igraph_real_t *quality);
+
+typedef enum { IGRAPH_ENSEMBLE_MULTILEVEL=0,
+	       IGRAPH_ENSEMBLE_LABEL_PROPAGATION,
+	       IGRAPH_ENSEMBLE_INFOMAP 
+} igraph_community_ensemble_method_t;
+
+int igraph_community_ensemble(const igraph_t *graph,
+			      const igraph_vector_t *weights,
+			      igraph_community_ensemble_method_t method,
+			      igraph_integer_t runs,
+			      igraph_real_t threshold,
+			      igraph_vector_t *membership,
+			      igraph_real_t *modularity,
+			      igraph_matrix_t *memberships,
+			      igraph_vector_t *coassignment);
 
 /* -------------------------------------------------- */
 /* Community Structure Comparison                     */
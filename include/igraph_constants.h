@@ -156,7 +156,8 @@ typedef void igraph_vector_function_t(const igraph_vector_t *var,
 
 typedef enum { IGRAPH_LAYOUT_GRID = 0,
 	       IGRAPH_LAYOUT_NOGRID,
-	       IGRAPH_LAYOUT_AUTOGRID } igraph_layout_grid_t;
+	       IGRAPH_LAYOUT_AUTOGRID,
+	       IGRAPH_LAYOUT_BARNES_HUT } igraph_layout_grid_t;
 
 typedef enum { IGRAPH_RANDOM_WALK_STUCK_ERROR = 0,
 	       IGRAPH_RANDOM_WALK_STUCK_RETURN } igraph_random_walk_stuck_t;
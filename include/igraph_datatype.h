@@ -65,6 +65,10 @@ __BEGIN_DECLS
  *   queries.
  * - <b>is</b> This is basically the same as <b>os</b>, but this time
  *   for the incoming edges.
+ * - <b>mapping</b> Null pointer, unless the graph was read with
+ *   \ref igraph_read_graph_binary() from a memory mapped file. Then
+ *   the six vectors above point into the read-only mapping, and they
+ *   are copied to memory before the first modification of the graph.
  * 
  * For undirected graph, the same edge list is stored, ie. an
  * undirected edge is stored only once, and for checking whether there
@@ -72,18 +76,24 @@ __BEGIN_DECLS
  * should search for both \c from=v1, \c to=v2 and 
  * \c from=v2, \c to=v1.
  *
+ * All six vectors are integer vectors: vertex and edge ids are
+ * \type igraph_integer_t values anyway, so storing them as doubles
+ * would only double the memory footprint of the index and cost a
+ * conversion on every lookup.
+ *
  * The storage requirements for a graph with \c |V| vertices
  * and \c |E| edges is \c O(|E|+|V|).
  */
 typedef struct igraph_s {
   igraph_integer_t n;
   igraph_bool_t directed;
-  igraph_vector_t from;
-  igraph_vector_t to;
-  igraph_vector_t oi;
-  igraph_vector_t ii;
-  igraph_vector_t os;
-  igraph_vector_t is;
+  igraph_vector_int_t from;
+  igraph_vector_int_t to;
+  igraph_vector_int_t oi;
+  igraph_vector_int_t ii;
+  igraph_vector_int_t os;
+  igraph_vector_int_t is;
+  void *mapping;
   void *attr;
 } igraph_t;
 
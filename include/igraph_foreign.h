@@ -70,6 +70,8 @@ int igraph_read_graph_graphdb(igraph_t *graph, FILE *instream,
 int igraph_read_graph_gml(igraph_t *graph, FILE *instream);
 int igraph_read_graph_dl(igraph_t *graph, FILE *instream, 
 			 igraph_bool_t directed);
+int igraph_read_graph_binary(igraph_t *graph, FILE *instream,
+			     igraph_bool_t map);
 
 int igraph_write_graph_edgelist(const igraph_t *graph, FILE *outstream);
 int igraph_write_graph_ncol(const igraph_t *graph, FILE *outstream,
@@ -88,6 +90,7 @@ int igraph_write_graph_gml(const igraph_t *graph, FILE *outstream,
 int igraph_write_graph_dot(const igraph_t *graph, FILE *outstream);
 int igraph_write_graph_leda(const igraph_t *graph, FILE *outstream,
         const char* vertex_attr_name, const char* edge_attr_name);
+int igraph_write_graph_binary(const igraph_t *graph, FILE *outstream);
 
 __END_DECLS
 
@@ -67,6 +67,23 @@ int igraph_layout_fruchterman_reingold(const igraph_t *graph,
 				       const igraph_vector_t *miny,
 				       const igraph_vector_t *maxy,
 					   igraph_vector_t *new_v);
+int igraph_layout_fruchterman_reingold_bh(const igraph_t *graph,
+					  igraph_matrix_t *res,
+					  igraph_bool_t use_seed,
+					  igraph_integer_t niter,
+					  igraph_real_t start_temp,
+					  igraph_real_t theta,
+					  const igraph_vector_t *weight,
+					  const igraph_vector_t *minx,
+					  const igraph_vector_t *maxx,
+					  const igraph_vector_t *miny,
+					  const igraph_vector_t *maxy,
+					  const igraph_vector_t *new_v);
+
+int igraph_layout_multilevel(const igraph_t *graph, igraph_matrix_t *res,
+			     igraph_integer_t dim, igraph_integer_t niter,
+			     igraph_integer_t min_size, igraph_real_t theta,
+			     const igraph_vector_t *weights);
 
 int igraph_layout_kamada_kawai(const igraph_t *graph, igraph_matrix_t *res,
 	       igraph_bool_t use_seed, igraph_integer_t maxiter,
@@ -75,6 +92,13 @@ int igraph_layout_kamada_kawai(const igraph_t *graph, igraph_matrix_t *res,
 	       const igraph_vector_t *minx, const igraph_vector_t *maxx,
 	       const igraph_vector_t *miny, const igraph_vector_t *maxy);
 
+int igraph_layout_sparse_stress(const igraph_t *graph, igraph_matrix_t *res,
+				igraph_bool_t use_seed, igraph_integer_t dim,
+				igraph_integer_t pivots,
+				igraph_integer_t maxiter,
+				igraph_real_t epsilon,
+				const igraph_vector_t *weights);
+
 int igraph_layout_springs(const igraph_t *graph, igraph_matrix_t *res,
 			  igraph_real_t mass, igraph_real_t equil, igraph_real_t k,
 			  igraph_real_t repeqdis, igraph_real_t kfr, igraph_bool_t repulse);
@@ -113,6 +137,20 @@ int igraph_layout_fruchterman_reingold_3d(const igraph_t *graph,
 					  const igraph_vector_t *minz,
 					  const igraph_vector_t *maxz,
 					  igraph_vector_t *new_v);
+int igraph_layout_fruchterman_reingold_3d_bh(const igraph_t *graph,
+					     igraph_matrix_t *res,
+					     igraph_bool_t use_seed,
+					     igraph_integer_t niter,
+					     igraph_real_t start_temp,
+					     igraph_real_t theta,
+					     const igraph_vector_t *weight,
+					     const igraph_vector_t *minx,
+					     const igraph_vector_t *maxx,
+					     const igraph_vector_t *miny,
+					     const igraph_vector_t *maxy,
+					     const igraph_vector_t *minz,
+					     const igraph_vector_t *maxz,
+					     const igraph_vector_t *new_v);
 
 int igraph_layout_kamada_kawai_3d(const igraph_t *graph, igraph_matrix_t *res,
 	       igraph_bool_t use_seed, igraph_integer_t maxiter,
@@ -134,6 +172,10 @@ int igraph_layout_mds(const igraph_t *graph, igraph_matrix_t *res,
                       const igraph_matrix_t *dist, long int dim,
                       igraph_arpack_options_t *options);
 
+int igraph_layout_pivot_mds(const igraph_t *graph, igraph_matrix_t *res,
+			    long int dim, long int pivots,
+			    const igraph_vector_t *weights);
+
 int igraph_layout_bipartite(const igraph_t *graph, 
 			    const igraph_vector_bool_t *types,
 			    igraph_matrix_t *res, igraph_real_t hgap, 
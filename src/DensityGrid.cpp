@@ -44,6 +44,7 @@ using namespace std;
 #include "drl_Node.h"
 #include "DensityGrid.h"
 #include "igraph_error.h"
+#include "igraph_parallel_internal.h"
 
 #define GET_BIN(y, x) (Bins[y*GRID_SIZE+x])
 
@@ -151,6 +152,71 @@ float DensityGrid::GetDensity(float Nx, float Ny, bool fineDensity)
 	return density;
 }
 
+/***************************************************
+ * Function: DensityGrid::GetDensity               *
+ * Description: Get_Density from density grid,     *
+ * without node n, i.e. as if Subtract had been    *
+ * called for it. Used by the parallel update,     *
+ * that does not modify the grid while computing   *
+ * the node energies.                              *
+ **************************************************/
+float DensityGrid::GetDensity(float Nx, float Ny, bool fineDensity, Node &n,
+			      bool first_add, bool fine_first_add)
+{
+	deque<Node>::iterator BI;
+	int x_grid, y_grid, x_sub, y_sub, corner, off;
+	float x_dist, y_dist, distance, density=0;
+	int boundary=10;	// boundary around plane
+
+	/* Where to look */
+	x_grid = (int)((Nx+HALF_VIEW+.5)*VIEW_TO_GRID);
+	y_grid = (int)((Ny+HALF_VIEW+.5)*VIEW_TO_GRID);
+
+	// Check for edges of density grid (10000 is arbitrary high density)
+	if (x_grid > GRID_SIZE-boundary || x_grid < boundary) return 10000;
+	if (y_grid > GRID_SIZE-boundary || y_grid < boundary) return 10000;
+
+	// Fine density?
+	if (fineDensity) {
+
+		// fineSubtract would remove the front of this bin
+		x_sub = (int)((n.sub_x+HALF_VIEW+.5)*VIEW_TO_GRID);
+		y_sub = (int)((n.sub_y+HALF_VIEW+.5)*VIEW_TO_GRID);
+
+		// Go through nearest bins
+		for(int i=y_grid-1; i<=y_grid+1; i++)
+			for(int j=x_grid-1; j<=x_grid+1; j++) {
+
+			BI = GET_BIN(i, j).begin();
+			if (!fine_first_add && i == y_sub && j == x_sub &&
+			    BI != GET_BIN(i, j).end()) ++BI;
+
+			// Look through bin and add fine repulsions
+			for(; BI != GET_BIN(i, j).end(); ++BI) {
+				x_dist =  Nx-(BI->x);
+				y_dist =  Ny-(BI->y);
+				distance = x_dist*x_dist+y_dist*y_dist;
+				density += 1e-4/(distance + 1e-50);
+		 }
+		}
+	// Course density
+	} else {
+
+		// Add rough estimate, minus the fall off of the node,
+		// if Subtract would have removed it
+		density = Density[y_grid][x_grid];
+		if (!first_add && (corner = Corner(n.sub_x, n.sub_y)) >= 0) {
+			off = y_grid*GRID_SIZE + x_grid - corner;
+			if (off >= 0 && off / GRID_SIZE <= 2*RADIUS &&
+			    off % GRID_SIZE <= 2*RADIUS)
+				density -= fall_off[off / GRID_SIZE][off % GRID_SIZE];
+		}
+		density *= density;
+	}
+
+	return density;
+}
+
 /// Wrapper functions for the Add and subtract methods
 /// Nodes should all be passed by constant ref
 
@@ -285,4 +351,128 @@ void DensityGrid::fineAdd(Node &N)
   GET_BIN(y_grid, x_grid).push_back(N);
 }
 
+/***************************************************
+ * Function: DensityGrid::Corner                   *
+ * Description: Index of the first grid cell       *
+ * covered by the fall off of a node at (x, y),    *
+ * or -1 if Add and Subtract would fail there      *
+ **************************************************/
+int DensityGrid::Corner(float x, float y)
+{
+  int x_grid, y_grid;
+
+  x_grid = (int)((x+HALF_VIEW+.5)*VIEW_TO_GRID) - RADIUS;
+  y_grid = (int)((y+HALF_VIEW+.5)*VIEW_TO_GRID) - RADIUS;
+  if ( (x_grid >= GRID_SIZE) || (x_grid < 0) ||
+       (y_grid >= GRID_SIZE) || (y_grid < 0) )
+    return -1;
+  return y_grid*GRID_SIZE + x_grid;
+}
+
+/***************************************************
+ * Function: DensityGrid::Subtract, Add,           *
+ *           fineSubtract, fineAdd                 *
+ * Description: The same as above, but only the    *
+ * grid cells and bins in [first, last) are        *
+ * updated, and N is not modified. Nodes outside   *
+ * of the grid are ignored, the error is reported  *
+ * by Move.                                        *
+ **************************************************/
+void DensityGrid::Subtract(Node &N, int first, int last)
+{
+  int corner, start, from, to, diam = 2*RADIUS;
+  float *den = &Density[0][0], *fall = &fall_off[0][0];
+
+  if ( (corner = Corner(N.sub_x, N.sub_y)) < 0 ) return;
+  for(int i = 0; i <= diam; i++) {
+    start = corner + i*GRID_SIZE;
+    from = start > first ? start : first;
+    to = start + diam + 1 < last ? start + diam + 1 : last;
+    for(int j = from; j < to; j++)
+      den[j] -= fall[i*(diam+1) + j - start];
+  }
+}
+
+void DensityGrid::Add(Node &N, int first, int last)
+{
+  int corner, start, from, to, diam = 2*RADIUS;
+  float *den = &Density[0][0], *fall = &fall_off[0][0];
+
+  if ( (corner = Corner(N.x, N.y)) < 0 ) return;
+  for(int i = 0; i <= diam; i++) {
+    start = corner + i*GRID_SIZE;
+    from = start > first ? start : first;
+    to = start + diam + 1 < last ? start + diam + 1 : last;
+    for(int j = from; j < to; j++)
+      den[j] += fall[i*(diam+1) + j - start];
+  }
+}
+
+void DensityGrid::fineSubtract(Node &N, int first, int last)
+{
+  int x_grid, y_grid;
+
+  x_grid = (int)((N.sub_x+HALF_VIEW+.5)*VIEW_TO_GRID);
+  y_grid = (int)((N.sub_y+HALF_VIEW+.5)*VIEW_TO_GRID);
+  if (y_grid*GRID_SIZE+x_grid >= first && y_grid*GRID_SIZE+x_grid < last)
+    GET_BIN(y_grid, x_grid).pop_front();
+}
+
+void DensityGrid::fineAdd(Node &N, int first, int last)
+{
+  int x_grid, y_grid;
+
+  x_grid = (int)((N.x+HALF_VIEW+.5)*VIEW_TO_GRID);
+  y_grid = (int)((N.y+HALF_VIEW+.5)*VIEW_TO_GRID);
+  if (y_grid*GRID_SIZE+x_grid >= first && y_grid*GRID_SIZE+x_grid < last)
+    GET_BIN(y_grid, x_grid).push_back(N);
+}
+
+/***************************************************
+ * Function: DensityGrid::Move                     *
+ * Description: Move the nodes node_indices of     *
+ * positions to new_nodes, i.e. Subtract the old   *
+ * and Add the new node, for each node in order.   *
+ * The grid is split into num_threads parts, that  *
+ * are updated in parallel. Every cell and bin is  *
+ * updated in the same order as by the serial      *
+ * code, so the result does not depend on the      *
+ * number of threads.                              *
+ **************************************************/
+void DensityGrid::Move(vector<Node> &positions, vector<int> &node_indices,
+		       vector<Node> &new_nodes, bool first_add,
+		       bool fine_first_add, bool fineDensity, int num_threads)
+{
+  int no_of_nodes = node_indices.size();
+
+  // report the errors of Subtract and Add before the update
+  for (int j = 0; j < no_of_nodes; j++) {
+    Node &old = positions[node_indices[j]];
+    if ( !(fineDensity && !fine_first_add) && !first_add &&
+	 Corner(old.sub_x, old.sub_y) < 0 )
+      igraph_error("Exceeded density grid in DrL", __FILE__,
+		   __LINE__, IGRAPH_EDRL);
+    if ( !fineDensity && Corner(new_nodes[j].x, new_nodes[j].y) < 0 )
+      igraph_error("Exceeded density grid in DrL", __FILE__,
+		   __LINE__, IGRAPH_EDRL);
+    new_nodes[j].sub_x = new_nodes[j].x;
+    new_nodes[j].sub_y = new_nodes[j].y;
+  }
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads) schedule(static, 1)
+#endif
+  for (int t = 0; t < num_threads; t++) {
+    int first = (int)((long)GRID_SIZE*GRID_SIZE*t/num_threads);
+    int last = (int)((long)GRID_SIZE*GRID_SIZE*(t+1)/num_threads);
+    for (int j = 0; j < no_of_nodes; j++) {
+      Node &old = positions[node_indices[j]];
+      if ( fineDensity && !fine_first_add ) fineSubtract(old, first, last);
+      else if ( !first_add ) Subtract(old, first, last);
+      if ( fineDensity ) fineAdd(new_nodes[j], first, last);
+      else Add(new_nodes[j], first, last);
+    }
+  }
+}
+
 } // namespace drl
@@ -44,6 +44,7 @@ using namespace std;
 #include "drl_Node_3d.h"
 #include "DensityGrid_3d.h"
 #include "igraph_error.h"
+#include "igraph_parallel_internal.h"
 
 #define GET_BIN(z, y, x) (Bins[(z*GRID_SIZE+y)*GRID_SIZE+x])
 
@@ -161,6 +162,83 @@ float DensityGrid::GetDensity(float Nx, float Ny, float Nz,bool fineDensity)
 	return density;
 }
 
+/***************************************************
+ * Function: DensityGrid::GetDensity               *
+ * Description: Get_Density from density grid,     *
+ * without node n, i.e. as if Subtract had been    *
+ * called for it. Used by the parallel update,     *
+ * that does not modify the grid while computing   *
+ * the node energies.                              *
+ **************************************************/
+float DensityGrid::GetDensity(float Nx, float Ny, float Nz, bool fineDensity,
+			      Node &n, bool first_add, bool fine_first_add)
+{
+	deque<Node>::iterator BI;
+	int x_grid, y_grid, z_grid, x_sub, y_sub, z_sub, corner, off;
+	int diam = 2*RADIUS, block = (diam+1)*(diam+1);
+	float x_dist, y_dist, z_dist, distance, density=0;
+	int boundary=10;	// boundary around plane
+
+	/* Where to look */
+	x_grid = (int)((Nx+HALF_VIEW+.5)*VIEW_TO_GRID);
+	y_grid = (int)((Ny+HALF_VIEW+.5)*VIEW_TO_GRID);
+	z_grid = (int)((Nz+HALF_VIEW+.5)*VIEW_TO_GRID);
+
+	// Check for edges of density grid (10000 is arbitrary high density)
+	if (x_grid > GRID_SIZE-boundary || x_grid < boundary) return 10000;
+	if (y_grid > GRID_SIZE-boundary || y_grid < boundary) return 10000;
+	if (z_grid > GRID_SIZE-boundary || z_grid < boundary) return 10000;
+
+	// Fine density?
+	if (fineDensity) {
+
+	  // fineSubtract would remove the front of this bin
+	  x_sub = (int)((n.sub_x+HALF_VIEW+.5)*VIEW_TO_GRID);
+	  y_sub = (int)((n.sub_y+HALF_VIEW+.5)*VIEW_TO_GRID);
+	  z_sub = (int)((n.sub_z+HALF_VIEW+.5)*VIEW_TO_GRID);
+
+		// Go through nearest bins
+	  for (int k=z_grid-1; k<=z_grid+1; k++)
+	    for(int i=y_grid-1; i<=y_grid+1; i++)
+	      for(int j=x_grid-1; j<=x_grid+1; j++) {
+
+		BI = GET_BIN(k,i,j).begin();
+		if (!fine_first_add && k == z_sub && i == y_sub && j == x_sub &&
+		    BI < GET_BIN(k,i,j).end()) ++BI;
+
+		// Look through bin and add fine repulsions
+		for(; BI < GET_BIN(k,i,j).end(); ++BI) {
+		  x_dist =  Nx-(BI->x);
+		  y_dist =  Ny-(BI->y);
+		  z_dist =  Nz-(BI->z);
+		  distance = x_dist*x_dist+y_dist*y_dist+z_dist*z_dist;
+		  density += 1e-4/(distance + 1e-50);
+		}
+	      }
+
+	// Course density
+	} else {
+
+		// Add rough estimate, minus the fall off of the node,
+		// if Subtract would have removed it. Subtract goes
+		// through the fall off in blocks of block cells, with
+		// GRID_SIZE-(diam+1) cells between them.
+		density = Density[z_grid][y_grid][x_grid];
+		if (!first_add &&
+		    (corner = Corner(n.sub_x, n.sub_y, n.sub_z)) >= 0) {
+			off = (z_grid*GRID_SIZE + y_grid)*GRID_SIZE + x_grid - corner;
+			if (off >= 0 && off / (block+GRID_SIZE-(diam+1)) <= diam &&
+			    off % (block+GRID_SIZE-(diam+1)) < block)
+				density -= (&fall_off[0][0][0])
+				  [off / (block+GRID_SIZE-(diam+1)) * block +
+				   off % (block+GRID_SIZE-(diam+1))];
+		}
+		density *= density;
+	}
+
+	return density;
+}
+
 /// Wrapper functions for the Add and subtract methods
 /// Nodes should all be passed by constant ref
 
@@ -307,4 +385,137 @@ void DensityGrid::fineAdd(Node &N)
   GET_BIN(z_grid,y_grid,x_grid).push_back(N);
 }
 
+/***************************************************
+ * Function: DensityGrid::Corner                   *
+ * Description: Index of the first grid cell       *
+ * covered by the fall off of a node at (x, y, z), *
+ * or -1 if Add and Subtract would fail there      *
+ **************************************************/
+int DensityGrid::Corner(float x, float y, float z)
+{
+  int x_grid, y_grid, z_grid;
+
+  x_grid = (int)((x+HALF_VIEW+.5)*VIEW_TO_GRID) - RADIUS;
+  y_grid = (int)((y+HALF_VIEW+.5)*VIEW_TO_GRID) - RADIUS;
+  z_grid = (int)((z+HALF_VIEW+.5)*VIEW_TO_GRID) - RADIUS;
+  if ( (x_grid >= GRID_SIZE) || (x_grid < 0) ||
+       (y_grid >= GRID_SIZE) || (y_grid < 0) ||
+       (z_grid >= GRID_SIZE) || (z_grid < 0) )
+    return -1;
+  return (z_grid*GRID_SIZE + y_grid)*GRID_SIZE + x_grid;
+}
+
+/***************************************************
+ * Function: DensityGrid::Subtract, Add,           *
+ *           fineSubtract, fineAdd                 *
+ * Description: The same as above, but only the    *
+ * grid cells and bins in [first, last) are        *
+ * updated, and N is not modified. Nodes outside   *
+ * of the grid are ignored, the error is reported  *
+ * by Move. The cells are the same as in the       *
+ * serial Subtract and Add.                        *
+ **************************************************/
+void DensityGrid::Subtract(Node &N, int first, int last)
+{
+  int corner, start, from, to, diam = 2*RADIUS, block = (diam+1)*(diam+1);
+  float *den = &Density[0][0][0], *fall = &fall_off[0][0][0];
+
+  if ( (corner = Corner(N.sub_x, N.sub_y, N.sub_z)) < 0 ) return;
+  for(int i = 0; i <= diam; i++) {
+    start = corner + i*(block + GRID_SIZE - (diam+1));
+    from = start > first ? start : first;
+    to = start + block < last ? start + block : last;
+    for(int j = from; j < to; j++)
+      den[j] -= fall[i*block + j - start];
+  }
+}
+
+void DensityGrid::Add(Node &N, int first, int last)
+{
+  int corner, start, from, to, diam = 2*RADIUS, block = (diam+1)*(diam+1);
+  float *den = &Density[0][0][0], *fall = &fall_off[0][0][0];
+
+  if ( (corner = Corner(N.x, N.y, N.z)) < 0 ) return;
+  for(int i = 0; i <= diam; i++) {
+    start = corner + i*(block + GRID_SIZE - (diam+1));
+    from = start > first ? start : first;
+    to = start + block < last ? start + block : last;
+    for(int j = from; j < to; j++)
+      den[j] += fall[i*block + j - start];
+  }
+}
+
+void DensityGrid::fineSubtract(Node &N, int first, int last)
+{
+  int x_grid, y_grid, z_grid, index;
+
+  x_grid = (int)((N.sub_x+HALF_VIEW+.5)*VIEW_TO_GRID);
+  y_grid = (int)((N.sub_y+HALF_VIEW+.5)*VIEW_TO_GRID);
+  z_grid = (int)((N.sub_z+HALF_VIEW+.5)*VIEW_TO_GRID);
+  index = (z_grid*GRID_SIZE+y_grid)*GRID_SIZE+x_grid;
+  if (index >= first && index < last)
+    GET_BIN(z_grid,y_grid,x_grid).pop_front();
+}
+
+void DensityGrid::fineAdd(Node &N, int first, int last)
+{
+  int x_grid, y_grid, z_grid, index;
+
+  x_grid = (int)((N.x+HALF_VIEW+.5)*VIEW_TO_GRID);
+  y_grid = (int)((N.y+HALF_VIEW+.5)*VIEW_TO_GRID);
+  z_grid = (int)((N.z+HALF_VIEW+.5)*VIEW_TO_GRID);
+  index = (z_grid*GRID_SIZE+y_grid)*GRID_SIZE+x_grid;
+  if (index >= first && index < last)
+    GET_BIN(z_grid,y_grid,x_grid).push_back(N);
+}
+
+/***************************************************
+ * Function: DensityGrid::Move                     *
+ * Description: Move the nodes node_indices of     *
+ * positions to new_nodes, i.e. Subtract the old   *
+ * and Add the new node, for each node in order.   *
+ * The grid is split into num_threads parts, that  *
+ * are updated in parallel. Every cell and bin is  *
+ * updated in the same order as by the serial      *
+ * code, so the result does not depend on the      *
+ * number of threads.                              *
+ **************************************************/
+void DensityGrid::Move(vector<Node> &positions, vector<int> &node_indices,
+		       vector<Node> &new_nodes, bool first_add,
+		       bool fine_first_add, bool fineDensity, int num_threads)
+{
+  int no_of_nodes = node_indices.size();
+
+  // report the errors of Subtract and Add before the update
+  for (int j = 0; j < no_of_nodes; j++) {
+    Node &old = positions[node_indices[j]];
+    if ( !(fineDensity && !fine_first_add) && !first_add &&
+	 Corner(old.sub_x, old.sub_y, old.sub_z) < 0 )
+      igraph_error("Exceeded density grid in DrL", __FILE__,
+		   __LINE__, IGRAPH_EDRL);
+    if ( !fineDensity &&
+	 Corner(new_nodes[j].x, new_nodes[j].y, new_nodes[j].z) < 0 )
+      igraph_error("Exceeded density grid in DrL", __FILE__,
+		   __LINE__, IGRAPH_EDRL);
+    new_nodes[j].sub_x = new_nodes[j].x;
+    new_nodes[j].sub_y = new_nodes[j].y;
+    new_nodes[j].sub_z = new_nodes[j].z;
+  }
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads) schedule(static, 1)
+#endif
+  for (int t = 0; t < num_threads; t++) {
+    int first = (int)((long)GRID_SIZE*GRID_SIZE*GRID_SIZE*t/num_threads);
+    int last = (int)((long)GRID_SIZE*GRID_SIZE*GRID_SIZE*(t+1)/num_threads);
+    for (int j = 0; j < no_of_nodes; j++) {
+      Node &old = positions[node_indices[j]];
+      if ( fineDensity && !fine_first_add ) fineSubtract(old, first, last);
+      else if ( !first_add ) Subtract(old, first, last);
+      if ( fineDensity ) fineAdd(new_nodes[j], first, last);
+      else Add(new_nodes[j], first, last);
+    }
+  }
+}
+
 } // namespace drl3d
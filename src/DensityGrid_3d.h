@@ -38,6 +38,7 @@
 
 
 #include <deque>
+#include <vector>
 
 using namespace std;
 
@@ -58,6 +59,11 @@ public:
 	  void Subtract(Node &n, bool first_add, bool fine_first_add, bool fineDensity);
 	  void Add(Node &n, bool fineDensity );
 	  float GetDensity(float Nx, float Ny, float Nz, bool fineDensity);
+	  float GetDensity(float Nx, float Ny, float Nz, bool fineDensity,
+			   Node &n, bool first_add, bool fine_first_add);
+	  void Move(vector<Node> &positions, vector<int> &node_indices,
+		    vector<Node> &new_nodes, bool first_add,
+		    bool fine_first_add, bool fineDensity, int num_threads);
 
 	  // Contructor/Destructor
 	  DensityGrid() {};
@@ -70,6 +76,11 @@ private:
 	  void Add( Node &N );
 	  void fineSubtract( Node &N );
 	  void fineAdd( Node &N );
+	  int Corner( float x, float y, float z );
+	  void Subtract( Node &N, int first, int last );
+	  void Add( Node &N, int first, int last );
+	  void fineSubtract( Node &N, int first, int last );
+	  void fineAdd( Node &N, int first, int last );
 
 	  // new dynamic variables -- SBM
 	  float (*fall_off)[RADIUS*2+1][RADIUS*2+1];
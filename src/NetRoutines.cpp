@@ -133,6 +133,43 @@ int igraph_i_read_network(const igraph_t *graph,
   return 0;
 }
 
+/* Flat adjacency of the network, for the inner loops of the spin
+   glass models. The links of node i are at positions start[i],
+   ..., start[i+1]-1 of 'nei' (the index of the other node) and
+   'weight', in the order of the link list of the node. If 'out' is
+   not NULL, then out[k] is true if node i is the start of the
+   link. 'start' has one more element than the number of nodes, the
+   others have twice the number of links. */
+
+void igraph_i_network_adjacency(network *net, unsigned long *start,
+				unsigned long *nei, double *weight,
+				bool *out) {
+  DLList_Iter<NNode*> iter;
+  DLList_Iter<NLink*> l_iter;
+  NNode *n_cur;
+  NLink *l_cur;
+  unsigned long i=0, k=0;
+
+  n_cur=iter.First(net->node_list);
+  while (!iter.End()) {
+    start[i++]=k;
+    l_cur=l_iter.First(n_cur->Get_Links());
+    while (!l_iter.End()) {
+      if (l_cur->Get_Start()==n_cur) {
+	nei[k]=l_cur->Get_End()->Get_Index();
+      } else {
+	nei[k]=l_cur->Get_Start()->Get_Index();
+      }
+      weight[k]=l_cur->Get_Weight();
+      if (out) { out[k]=(l_cur->Get_Start()==n_cur); }
+      k++;
+      l_cur=l_iter.Next();
+    }
+    n_cur=iter.Next();
+  }
+  start[i]=k;
+}
+
 //###############################################################################################################
 void reduce_cliques(DLList<ClusterList<NNode*>*> *global_cluster_list, FILE *file)
 {
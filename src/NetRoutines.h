@@ -52,6 +52,9 @@ int igraph_i_read_network(const igraph_t *graph,
 			  const igraph_vector_t *weights,
 			  network *net, igraph_bool_t use_weights,
 			  unsigned int states);
+void igraph_i_network_adjacency(network *net, unsigned long *start,
+				unsigned long *nei, double *weight,
+				bool *out);
 
 void reduce_cliques(DLList<ClusterList<NNode*>*>*, FILE *file);
 void reduce_cliques2(network*, bool,  long );
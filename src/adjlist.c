@@ -25,6 +25,7 @@
 #include "igraph_memory.h"
 #include "igraph_interface.h"
 #include "igraph_interrupt_internal.h"
+#include "igraph_interface_internal.h"
 #include "config.h"
 
 #include <string.h>   /* memset */
@@ -66,6 +67,14 @@
  * during the computation.
  * </para>
  *
+ * <para>The <type>igraph_csr_t</type> compressed sparse row snapshot
+ * is a read-only alternative to adjacency and incidence lists. It
+ * keeps the neighbors, the incident edges and possibly the weights of
+ * the incident edges of all vertices in contiguous arrays, so it is
+ * cheap to create and to scan. Use it if the lists are not modified,
+ * e.g. when the same graph is traversed from many vertices.
+ * </para>
+ *
  * <para>
  * \example examples/simple/adjlist.c
  * </para>
@@ -95,15 +104,11 @@
 int igraph_adjlist_init(const igraph_t *graph, igraph_adjlist_t *al, 
 			  igraph_neimode_t mode) {
   igraph_integer_t i;
-  igraph_vector_t tmp;  
 
   if (mode != IGRAPH_IN && mode != IGRAPH_OUT && mode != IGRAPH_ALL) {
     IGRAPH_ERROR("Cannot create adjlist view", IGRAPH_EINVMODE);
   }
 
-  igraph_vector_init(&tmp, 0);
-  IGRAPH_FINALLY(igraph_vector_destroy, &tmp);
-
   if (!igraph_is_directed(graph)) { mode=IGRAPH_ALL; }
 
   al->length=igraph_vcount(graph);
@@ -114,18 +119,12 @@ int igraph_adjlist_init(const igraph_t *graph, igraph_adjlist_t *al,
 
   IGRAPH_FINALLY(igraph_adjlist_destroy, al);
   for (i=0; i<al->length; i++) {
-    int j, n;
     IGRAPH_ALLOW_INTERRUPTION();
-    IGRAPH_CHECK(igraph_neighbors(graph, &tmp, i, mode));
-    n=igraph_vector_size(&tmp);
-    IGRAPH_CHECK(igraph_vector_int_init(&al->adjs[i], n));
-    for (j=0; j<n; j++) {
-      VECTOR(al->adjs[i])[j] = VECTOR(tmp)[j];
-    }
+    IGRAPH_CHECK(igraph_vector_int_init(&al->adjs[i], 0));
+    IGRAPH_CHECK(igraph_i_neighbors(graph, &al->adjs[i], i, mode));
   }
 
-  igraph_vector_destroy(&tmp);
-  IGRAPH_FINALLY_CLEAN(2);
+  IGRAPH_FINALLY_CLEAN(1);
   return 0;
 }
 
@@ -553,15 +552,11 @@ int igraph_inclist_init(const igraph_t *graph,
 			      igraph_inclist_t *il, 
 			      igraph_neimode_t mode) {
   igraph_integer_t i;
-  igraph_vector_t tmp;
 
   if (mode != IGRAPH_IN && mode != IGRAPH_OUT && mode != IGRAPH_ALL) {
     IGRAPH_ERROR("Cannot create incidence list view", IGRAPH_EINVMODE);
   }
 
-  igraph_vector_init(&tmp, 0);
-  IGRAPH_FINALLY(igraph_vector_destroy, &tmp);
-
   if (!igraph_is_directed(graph)) { mode=IGRAPH_ALL; }
 
   il->length=igraph_vcount(graph);
@@ -572,18 +567,12 @@ int igraph_inclist_init(const igraph_t *graph,
 
   IGRAPH_FINALLY(igraph_inclist_destroy, il);  
   for (i=0; i<il->length; i++) {
-    int j, n;
     IGRAPH_ALLOW_INTERRUPTION();
-    IGRAPH_CHECK(igraph_incident(graph, &tmp, i, mode));
-    n=igraph_vector_size(&tmp);
-    IGRAPH_CHECK(igraph_vector_int_init(&il->incs[i], n));
-    for (j=0; j<n; j++) {
-      VECTOR(il->incs[i])[j] = VECTOR(tmp)[j];
-    }
+    IGRAPH_CHECK(igraph_vector_int_init(&il->incs[i], 0));
+    IGRAPH_CHECK(igraph_i_incident(graph, &il->incs[i], i, mode));
   }
   
-  igraph_vector_destroy(&tmp);
-  IGRAPH_FINALLY_CLEAN(2);
+  IGRAPH_FINALLY_CLEAN(1);
   return 0;
 }
 
@@ -654,6 +643,131 @@ void igraph_inclist_clear(igraph_inclist_t *il) {
   }
 }
 
+/**
+ * \function igraph_csr_init
+ * Create a compressed sparse row snapshot of a graph
+ * 
+ * The snapshot stores the neighbors and the incident edges of all
+ * vertices in two contiguous integer arrays, and optionally the edge
+ * weights in a third one, in the same order. The arrays are indexed
+ * by a common offset array. Compared to \ref igraph_adjlist_init()
+ * and \ref igraph_inclist_init(), the snapshot needs only a few
+ * memory allocations, and scanning the neighbors of many vertices
+ * reads memory sequentially. The snapshot cannot be modified, it is
+ * independent of the graph after creation.
+ * 
+ * </para><para>
+ * The neighbors of a vertex are sorted by vertex id, and the edges
+ * and weights follow the same order. Loop edges appear twice if
+ * \p mode is \c IGRAPH_ALL or the graph is undirected, like in \ref
+ * igraph_neighbors().
+ * \param graph The input graph.
+ * \param csr Pointer to an uninitialized <type>igraph_csr_t</type>
+ *   object.
+ * \param mode Constant specifying whether outgoing
+ *   (<code>IGRAPH_OUT</code>), incoming (<code>IGRAPH_IN</code>),
+ *   or both (<code>IGRAPH_ALL</code>) types of neighbors to include
+ *   in the snapshot. It is ignored for undirected networks.
+ * \param weights Pointer to a vector of edge weights, or a null
+ *   pointer. If not null, the weights are copied to the snapshot and
+ *   can be queried with \ref igraph_csr_weights().
+ * \return Error code.
+ * 
+ * Time complexity: O(|V|+|E|), linear in the number of vertices and
+ * edges.
+ */
+
+int igraph_csr_init(const igraph_t *graph, igraph_csr_t *csr,
+		    igraph_neimode_t mode, const igraph_vector_t *weights) {
+  long int no_of_nodes=igraph_vcount(graph);
+  long int no_of_edges=igraph_ecount(graph);
+  const int *from=VECTOR(graph->from), *to=VECTOR(graph->to);
+  const int *oi=VECTOR(graph->oi), *ii=VECTOR(graph->ii);
+  const int *os=VECTOR(graph->os), *is=VECTOR(graph->is);
+  int *offsets, *neis, *edges;
+  long int i, size;
+
+  if (mode != IGRAPH_IN && mode != IGRAPH_OUT && mode != IGRAPH_ALL) {
+    IGRAPH_ERROR("Cannot create CSR snapshot", IGRAPH_EINVMODE);
+  }
+  if (weights && igraph_vector_size(weights) != no_of_edges) {
+    IGRAPH_ERROR("Weight vector length does not match", IGRAPH_EINVAL);
+  }
+
+  if (!igraph_is_directed(graph)) { mode=IGRAPH_ALL; }
+
+  csr->length=no_of_nodes;
+  csr->weighted= weights != 0;
+
+  IGRAPH_CHECK(igraph_vector_int_init(&csr->offsets, no_of_nodes+1));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &csr->offsets);
+  offsets=VECTOR(csr->offsets);
+  for (i=0; i<no_of_nodes; i++) {
+    offsets[i+1]=offsets[i];
+    if (mode & IGRAPH_OUT) { offsets[i+1] += os[i+1]-os[i]; }
+    if (mode & IGRAPH_IN)  { offsets[i+1] += is[i+1]-is[i]; }
+  }
+  size=offsets[no_of_nodes];
+
+  IGRAPH_CHECK(igraph_vector_int_init(&csr->neis, size));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &csr->neis);
+  IGRAPH_CHECK(igraph_vector_int_init(&csr->edges, size));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &csr->edges);
+  IGRAPH_CHECK(igraph_vector_init(&csr->weights, weights ? size : 0));
+  IGRAPH_FINALLY(igraph_vector_destroy, &csr->weights);
+  neis=VECTOR(csr->neis);
+  edges=VECTOR(csr->edges);
+
+  for (i=0; i<no_of_nodes; i++) {
+    long int k=offsets[i];
+    long int i1=os[i], j1=os[i+1], i2=is[i], j2=is[i+1];
+    int e;
+    IGRAPH_ALLOW_INTERRUPTION();
+    if (mode == IGRAPH_ALL && igraph_is_directed(graph)) {
+      /* merge the sorted out- and in-neighbors */
+      while (i1 < j1 && i2 < j2) {
+	if (to[oi[i1]] <= from[ii[i2]]) {
+	  e=oi[i1++]; neis[k]=to[e];
+	} else {
+	  e=ii[i2++]; neis[k]=from[e];
+	}
+	edges[k++]=e;
+      }
+    }
+    if (mode & IGRAPH_OUT) {
+      while (i1 < j1) { e=oi[i1++]; neis[k]=to[e]; edges[k++]=e; }
+    }
+    if (mode & IGRAPH_IN) {
+      while (i2 < j2) { e=ii[i2++]; neis[k]=from[e]; edges[k++]=e; }
+    }
+  }
+
+  if (weights) {
+    for (i=0; i<size; i++) {
+      VECTOR(csr->weights)[i]=VECTOR(*weights)[(long int) edges[i]];
+    }
+  }
+
+  IGRAPH_FINALLY_CLEAN(4);
+  return 0;
+}
+
+/**
+ * \function igraph_csr_destroy
+ * Frees the memory of a CSR snapshot
+ * 
+ * \param csr The CSR snapshot to destroy.
+ * 
+ * Time complexity: depends on memory management.
+ */
+
+void igraph_csr_destroy(igraph_csr_t *csr) {
+  igraph_vector_destroy(&csr->weights);
+  igraph_vector_int_destroy(&csr->edges);
+  igraph_vector_int_destroy(&csr->neis);
+  igraph_vector_int_destroy(&csr->offsets);
+}
+
 /**
  * \function igraph_lazy_adjlist_init
  * Constructor
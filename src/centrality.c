@@ -33,6 +33,8 @@
 #include "igraph_interface.h"
 #include "igraph_progress.h"
 #include "igraph_interrupt_internal.h"
+#include "igraph_parallel_internal.h"
+#include "igraph_paths_internal.h"
 #include "igraph_topology.h"
 #include "igraph_types_internal.h"
 #include "igraph_stack.h"
@@ -50,6 +52,14 @@ int igraph_personalized_pagerank_arpack(const igraph_t *graph,
 		    const igraph_vector_t *weights,
 		    igraph_arpack_options_t *options);
 
+static int igraph_i_personalized_pagerank_power(const igraph_t *graph,
+		    igraph_vector_t *vector,
+		    igraph_real_t *value, const igraph_vs_t vids,
+		    igraph_bool_t directed, igraph_real_t damping, 
+		    const igraph_vector_t *reset,
+		    const igraph_vector_t *weights,
+		    const igraph_pagerank_power_options_t *options);
+
 igraph_bool_t igraph_i_vector_mostly_negative(const igraph_vector_t *vector) {
   /* Many of the centrality measures correspond to the eigenvector of some
    * matrix. When v is an eigenvector, c*v is also an eigenvector, therefore
@@ -1040,10 +1050,13 @@ int igraph_i_pagerank2(igraph_real_t *to, const igraph_real_t *from,
  *
  * Starting from version 0.7, igraph has three PageRank implementations,
  * and the user can choose between them. The first implementation is
- * \c IGRAPH_PAGERANK_ALGO_POWER, also available as the (now
- * deprecated) function \ref igraph_pagerank_old(). The second
- * implementation is based on the ARPACK library, this was the default
- * before igraph version 0.7: \c IGRAPH_PAGERANK_ALGO_ARPACK.
+ * \c IGRAPH_PAGERANK_ALGO_POWER, igraph's own power iteration. It
+ * runs in parallel if igraph was compiled with OpenMP support, and
+ * it is the best choice for very large graphs. (The deprecated \ref
+ * igraph_pagerank_old() function implements the original, sequential
+ * power method.) The second implementation is based on the ARPACK
+ * library, this was the default before igraph version 0.7: \c
+ * IGRAPH_PAGERANK_ALGO_ARPACK.
  *
  * The third and recommmended implementation is \c
  * IGRAPH_PAGERANK_ALGO_PRPACK. This is using the the PRPACK package,
@@ -1088,7 +1101,8 @@ int igraph_i_pagerank2(igraph_real_t *to, const igraph_real_t *from,
  *    as the number of edges.
  * \param options Options to the power method or ARPACK. For the power
  *    method, \c IGRAPH_PAGERANK_ALGO_POWER it must be a pointer to
- *    a \ref igraph_pagerank_power_options_t object.
+ *    a \ref igraph_pagerank_power_options_t object, or a null pointer
+ *    for the default options.
  *    For \c IGRAPH_PAGERANK_ALGO_ARPACK it must be a pointer to an
  *    \ref igraph_arpack_options_t object. See \ref igraph_arpack_options_t
  *    for details. Note that the function overwrites the
@@ -1166,7 +1180,8 @@ int igraph_pagerank(const igraph_t *graph, igraph_pagerank_algo_t algo,
  *    as the number of edges.
  * \param options Options to the power method or ARPACK. For the power
  *    method, \c IGRAPH_PAGERANK_ALGO_POWER it must be a pointer to
- *    a \ref igraph_pagerank_power_options_t object.
+ *    a \ref igraph_pagerank_power_options_t object, or a null pointer
+ *    for the default options.
  *    For \c IGRAPH_PAGERANK_ALGO_ARPACK it must be a pointer to an
  *    \ref igraph_arpack_options_t object. See \ref igraph_arpack_options_t
  *    for details. Note that the function overwrites the
@@ -1260,7 +1275,8 @@ int igraph_personalized_pagerank_vs(const igraph_t *graph,
  *    as the number of edges.
  * \param options Options to the power method or ARPACK. For the power
  *    method, \c IGRAPH_PAGERANK_ALGO_POWER it must be a pointer to
- *    a \ref igraph_pagerank_power_options_t object.
+ *    a \ref igraph_pagerank_power_options_t object, or a null pointer
+ *    for the default options.
  *    For \c IGRAPH_PAGERANK_ALGO_ARPACK it must be a pointer to an
  *    \ref igraph_arpack_options_t object. See \ref igraph_arpack_options_t
  *    for details. Note that the function overwrites the
@@ -1292,13 +1308,9 @@ int igraph_personalized_pagerank(const igraph_t *graph,
   if (algo == IGRAPH_PAGERANK_ALGO_POWER) {
     igraph_pagerank_power_options_t *o = 
       (igraph_pagerank_power_options_t *) options;
-    if (reset) { 
-      IGRAPH_WARNING("Cannot use weights with power method, "
-		     "weights will be ignored");
-    }
-    return igraph_pagerank_old(graph, vector, vids, directed, 
-			       o->niter, o->eps, damping, 
-			       /*old=*/ 0);
+    return igraph_i_personalized_pagerank_power(graph, vector, value, vids,
+						directed, damping, reset,
+						weights, o);
   } else if (algo == IGRAPH_PAGERANK_ALGO_ARPACK) {
     igraph_arpack_options_t *o= (igraph_arpack_options_t*) options;
     return igraph_personalized_pagerank_arpack(graph, vector, value, vids,
@@ -1522,6 +1534,504 @@ int igraph_personalized_pagerank_arpack(const igraph_t *graph, igraph_vector_t *
   return 0;
 }
 
+/*
+ * Native power iteration, the implementation of
+ * IGRAPH_PAGERANK_ALGO_POWER and igraph_personalized_pagerank_batch().
+ * It works on a CSR snapshot of the incoming edges: every vertex
+ * pulls the scores of its in-neighbors, so the rows can be computed
+ * in parallel without two threads ever writing the same element. The
+ * rows are cut into chunks of about the same number of edges plus
+ * vertices, and the threads take the chunks dynamically, in-degrees
+ * are far too skewed in real networks for equal row ranges. The
+ * inner loops are plain gathers, simple enough for the compiler to
+ * vectorize.
+ *
+ * Several reset distributions are iterated together, as a block of
+ * 'width' columns. The scores of a vertex are stored next to each
+ * other, so a single pass over the edges updates all columns of the
+ * block: a sparse matrix times dense matrix product, instead of
+ * 'width' sparse matrix-vector products.
+ *
+ * The random walk is the same as the one of PRPACK: random jumps
+ * follow the reset distribution, dangling vertices jump to a
+ * uniformly chosen vertex, edges with non-positive weights are
+ * ignored, and loop edges of undirected graphs count twice.
+ */
+
+#define IGRAPH_I_PAGERANK_CHUNKS_PER_THREAD 8
+#define IGRAPH_I_PAGERANK_BLOCK 8
+
+typedef struct igraph_i_pagerank_power_t {
+  igraph_csr_t csr;
+  igraph_bool_t weighted;
+  igraph_vector_t invout;	/* inverse out-strength, zero if dangling */
+  igraph_vector_long_t dangling;
+  igraph_vector_long_t chunks;	/* first row of every chunk */
+  long int no_of_chunks;
+  int nthreads;
+} igraph_i_pagerank_power_t;
+
+static void igraph_i_pagerank_power_destroy(igraph_i_pagerank_power_t *pr) {
+  igraph_vector_long_destroy(&pr->chunks);
+  igraph_vector_long_destroy(&pr->dangling);
+  igraph_vector_destroy(&pr->invout);
+  igraph_csr_destroy(&pr->csr);
+}
+
+static int igraph_i_pagerank_power_init(igraph_i_pagerank_power_t *pr,
+					const igraph_t *graph,
+					igraph_bool_t directed,
+					const igraph_vector_t *weights) {
+  long int no_of_nodes=igraph_vcount(graph);
+  long int i, k, size;
+
+  directed = directed && igraph_is_directed(graph);
+  pr->weighted = weights != 0;
+  IGRAPH_CHECK(igraph_csr_init(graph, &pr->csr,
+			       directed ? IGRAPH_IN : IGRAPH_ALL, weights));
+  IGRAPH_FINALLY(igraph_csr_destroy, &pr->csr);
+  IGRAPH_VECTOR_INIT_FINALLY(&pr->invout, no_of_nodes);
+  IGRAPH_CHECK(igraph_vector_long_init(&pr->dangling, 0));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &pr->dangling);
+
+  size=VECTOR(pr->csr.offsets)[no_of_nodes];
+  for (k=0; k<size; k++) {
+    long int from=VECTOR(pr->csr.neis)[k];
+    if (!weights) {
+      VECTOR(pr->invout)[from] += 1;
+    } else if (VECTOR(pr->csr.weights)[k] > 0) {
+      VECTOR(pr->invout)[from] += VECTOR(pr->csr.weights)[k];
+    } else {
+      VECTOR(pr->csr.weights)[k] = 0;
+    }
+  }
+  for (i=0; i<no_of_nodes; i++) {
+    if (VECTOR(pr->invout)[i] > 0) {
+      VECTOR(pr->invout)[i] = 1.0/VECTOR(pr->invout)[i];
+    } else {
+      IGRAPH_CHECK(igraph_vector_long_push_back(&pr->dangling, i));
+    }
+  }
+
+  /* Chunks of rows, see above */
+  pr->nthreads=IGRAPH_I_THREAD_COUNT(no_of_nodes);
+  pr->no_of_chunks=pr->nthreads * IGRAPH_I_PAGERANK_CHUNKS_PER_THREAD;
+  if (pr->no_of_chunks > no_of_nodes) { pr->no_of_chunks=no_of_nodes; }
+  IGRAPH_CHECK(igraph_vector_long_init(&pr->chunks, pr->no_of_chunks+1));
+  for (i=0, k=1; k<pr->no_of_chunks; k++) {
+    igraph_real_t target=(igraph_real_t) (size+no_of_nodes) * k /
+      pr->no_of_chunks;
+    while (i < no_of_nodes && VECTOR(pr->csr.offsets)[i] + i < target) {
+      i++;
+    }
+    VECTOR(pr->chunks)[k]=i;
+  }
+  VECTOR(pr->chunks)[pr->no_of_chunks]=no_of_nodes;
+
+  IGRAPH_FINALLY_CLEAN(3);
+  return 0;
+}
+
+/*
+ * Iterates a block of 'width' columns until the largest change is
+ * less than 'eps', or for 'niter' iterations. 'reset' contains the
+ * normalized reset distributions row-wise, or it is a null pointer
+ * for the uniform distribution. '*x' is the starting point, '*y' and
+ * 'tmp' are work vectors, all three of them have width times the
+ * number of vertices elements. '*x' and '*y' are exchanged after
+ * every iteration, so on return '*x' points to the result. 'chunkdiff' has one
+ * element per chunk. Progress is reported from 'pstart' to
+ * 'pstart+pscale' percent.
+ */
+
+static int igraph_i_pagerank_power_iterate(const igraph_i_pagerank_power_t *pr,
+					   igraph_real_t damping,
+					   const igraph_real_t *reset,
+					   int width,
+					   igraph_integer_t niter,
+					   igraph_real_t eps,
+					   igraph_vector_t **x,
+					   igraph_vector_t **y,
+					   igraph_vector_t *tmp,
+					   igraph_vector_t *chunkdiff,
+					   igraph_real_t pstart,
+					   igraph_real_t pscale) {
+
+  long int no_of_nodes=igraph_vector_size(&pr->invout);
+  long int no_of_dangling=igraph_vector_long_size(&pr->dangling);
+  long int i, k, iter;
+  igraph_real_t diff=0;
+
+  for (iter=0; iter<niter; iter++) {
+    const igraph_real_t *xv=VECTOR(**x), *inv=VECTOR(pr->invout);
+    igraph_real_t *yv=VECTOR(**y), *tmpv=VECTOR(*tmp);
+    igraph_vector_t *swap;
+    igraph_real_t uniform[IGRAPH_I_PAGERANK_BLOCK];
+    int c;
+
+    IGRAPH_ALLOW_INTERRUPTION();
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(pr->nthreads)
+#endif
+    for (i=0; i<no_of_nodes; i++) {
+      int c;
+      for (c=0; c<width; c++) {
+	tmpv[i*width+c] = xv[i*width+c] * inv[i];
+      }
+    }
+
+    /* Walkers at dangling vertices are spread uniformly */
+    for (c=0; c<width; c++) {
+      igraph_real_t dangling=0;
+      for (i=0; i<no_of_dangling; i++) {
+	dangling += xv[VECTOR(pr->dangling)[i]*width+c];
+      }
+      uniform[c] = damping * dangling / no_of_nodes;
+    }
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(pr->nthreads) schedule(dynamic, 1)
+#endif
+    for (k=0; k<pr->no_of_chunks; k++) {
+      const int *offsets=VECTOR(pr->csr.offsets), *neis=VECTOR(pr->csr.neis);
+      const igraph_real_t *w= pr->weighted ? VECTOR(pr->csr.weights) : 0;
+      igraph_real_t maxdiff=0, s[IGRAPH_I_PAGERANK_BLOCK];
+      long int v, j;
+      int c;
+      for (v=VECTOR(pr->chunks)[k]; v<VECTOR(pr->chunks)[k+1]; v++) {
+	const igraph_real_t *xr=xv+v*width, *rr= reset ? reset+v*width : 0;
+	igraph_real_t *yr=yv+v*width;
+	if (width == 1) {
+	  igraph_real_t s1=0;
+	  if (w) {
+	    for (j=offsets[v]; j<offsets[v+1]; j++) {
+	      s1 += w[j] * tmpv[neis[j]];
+	    }
+	  } else {
+	    for (j=offsets[v]; j<offsets[v+1]; j++) {
+	      s1 += tmpv[neis[j]];
+	    }
+	  }
+	  s[0]=s1;
+	} else if (width == IGRAPH_I_PAGERANK_BLOCK) {
+	  /* Constant trip count, the compiler can keep 's' in registers */
+	  for (c=0; c<IGRAPH_I_PAGERANK_BLOCK; c++) { s[c]=0; }
+	  for (j=offsets[v]; j<offsets[v+1]; j++) {
+	    const igraph_real_t *t=tmpv + (long int) neis[j]*IGRAPH_I_PAGERANK_BLOCK;
+	    igraph_real_t wj= w ? w[j] : 1.0;
+	    for (c=0; c<IGRAPH_I_PAGERANK_BLOCK; c++) { s[c] += wj * t[c]; }
+	  }
+	} else {
+	  for (c=0; c<width; c++) { s[c]=0; }
+	  for (j=offsets[v]; j<offsets[v+1]; j++) {
+	    const igraph_real_t *t=tmpv + (long int) neis[j]*width;
+	    igraph_real_t wj= w ? w[j] : 1.0;
+	    for (c=0; c<width; c++) { s[c] += wj * t[c]; }
+	  }
+	}
+	for (c=0; c<width; c++) {
+	  igraph_real_t d;
+	  yr[c] = damping * s[c] + uniform[c] +
+	    (1 - damping) * (rr ? rr[c] : 1.0/no_of_nodes);
+	  d = fabs(yr[c] - xr[c]);
+	  if (d > maxdiff) { maxdiff = d; }
+	}
+      }
+      VECTOR(*chunkdiff)[k]=maxdiff;
+    }
+
+    swap=*x; *x=*y; *y=swap;
+    diff=igraph_vector_max(chunkdiff);
+    IGRAPH_PROGRESS("PageRank: ", pstart + pscale*(iter+1)/niter, &diff);
+    if (diff < eps) { break; }
+  }
+
+  if (iter == niter && eps > 0) {
+    IGRAPH_WARNING("PageRank power iteration did not converge");
+  }
+
+  return 0;
+}
+
+static int igraph_i_pagerank_power_check(const igraph_t *graph,
+		    igraph_real_t damping,
+		    const igraph_vector_t *weights,
+		    const igraph_pagerank_power_options_t *options) {
+  if (options && options->niter <= 0) {
+    IGRAPH_ERROR("Invalid iteration count", IGRAPH_EINVAL);
+  }
+  if (options && options->eps < 0) {
+    IGRAPH_ERROR("Invalid epsilon value", IGRAPH_EINVAL);
+  }
+  if (damping < 0 || damping > 1) {
+    IGRAPH_ERROR("Invalid damping factor", IGRAPH_EINVAL);
+  }
+  if (weights && igraph_vector_size(weights) != igraph_ecount(graph)) {
+    IGRAPH_ERROR("Invalid length of weights vector when calculating "
+                 "PageRank scores", IGRAPH_EINVAL);
+  }
+  return 0;
+}
+
+static int igraph_i_personalized_pagerank_power(const igraph_t *graph,
+		    igraph_vector_t *vector,
+		    igraph_real_t *value, const igraph_vs_t vids,
+		    igraph_bool_t directed, igraph_real_t damping,
+		    const igraph_vector_t *reset,
+		    const igraph_vector_t *weights,
+		    const igraph_pagerank_power_options_t *options) {
+
+  long int no_of_nodes=igraph_vcount(graph);
+  igraph_integer_t niter= options ? options->niter : 1000;
+  igraph_real_t eps= options ? options->eps : 1e-10;
+  igraph_i_pagerank_power_t pr;
+  igraph_vector_t x, y, tmp, myreset, chunkdiff;
+  igraph_vector_t *px=&x, *py=&y;
+  igraph_real_t sum;
+  long int i;
+
+  IGRAPH_CHECK(igraph_i_pagerank_power_check(graph, damping, weights,
+					     options));
+  if (reset && igraph_vector_size(reset) != no_of_nodes) {
+    IGRAPH_ERROR("Invalid length of reset vector when calculating "
+		 "personalized PageRank scores", IGRAPH_EINVAL);
+  }
+
+  if (no_of_nodes == 0) {
+    if (value) { *value = 1.0; }
+    if (vector) { IGRAPH_CHECK(igraph_vector_resize(vector, 0)); }
+    return 0;
+  }
+
+  /* Normalized copy of the reset vector, the original is untouched */
+  IGRAPH_VECTOR_INIT_FINALLY(&myreset, 0);
+  if (reset) {
+    if (igraph_vector_min(reset) < 0) {
+      IGRAPH_ERROR("the reset vector must not contain negative elements",
+		   IGRAPH_EINVAL);
+    }
+    sum=igraph_vector_sum(reset);
+    if (sum == 0) {
+      IGRAPH_ERROR("the sum of the elements in the reset vector must "
+		   "not be zero", IGRAPH_EINVAL);
+    }
+    IGRAPH_CHECK(igraph_vector_update(&myreset, reset));
+    igraph_vector_scale(&myreset, 1.0/sum);
+  }
+
+  IGRAPH_CHECK(igraph_i_pagerank_power_init(&pr, graph, directed, weights));
+  IGRAPH_FINALLY(igraph_i_pagerank_power_destroy, &pr);
+  IGRAPH_VECTOR_INIT_FINALLY(&chunkdiff, pr.no_of_chunks);
+  IGRAPH_VECTOR_INIT_FINALLY(&x, no_of_nodes);
+  IGRAPH_VECTOR_INIT_FINALLY(&y, no_of_nodes);
+  IGRAPH_VECTOR_INIT_FINALLY(&tmp, no_of_nodes);
+  igraph_vector_fill(&x, 1.0/no_of_nodes);
+
+  IGRAPH_CHECK(igraph_i_pagerank_power_iterate(&pr, damping,
+					       reset ? VECTOR(myreset) : 0,
+					       1, niter, eps, &px, &py, &tmp,
+					       &chunkdiff, 0, 100));
+
+  if (value) {
+    *value = 1.0;
+  }
+
+  if (vector) {
+    igraph_vit_t vit;
+    sum=igraph_vector_sum(px);
+    IGRAPH_CHECK(igraph_vit_create(graph, vids, &vit));
+    IGRAPH_FINALLY(igraph_vit_destroy, &vit);
+    IGRAPH_CHECK(igraph_vector_resize(vector, IGRAPH_VIT_SIZE(vit)));
+    for (IGRAPH_VIT_RESET(vit), i=0; !IGRAPH_VIT_END(vit);
+	 IGRAPH_VIT_NEXT(vit), i++) {
+      VECTOR(*vector)[i] = VECTOR(*px)[(long int) IGRAPH_VIT_GET(vit)] / sum;
+    }
+    igraph_vit_destroy(&vit);
+    IGRAPH_FINALLY_CLEAN(1);
+  }
+
+  igraph_vector_destroy(&tmp);
+  igraph_vector_destroy(&y);
+  igraph_vector_destroy(&x);
+  igraph_vector_destroy(&chunkdiff);
+  igraph_i_pagerank_power_destroy(&pr);
+  igraph_vector_destroy(&myreset);
+  IGRAPH_FINALLY_CLEAN(6);
+
+  return 0;
+}
+
+/**
+ * \function igraph_personalized_pagerank_batch
+ * \brief Personalized PageRank for many reset distributions at once.
+ *
+ * Calculates the personalized PageRank of the vertices for every
+ * column of a reset matrix. This gives the same results as calling
+ * \ref igraph_personalized_pagerank() with \c
+ * IGRAPH_PAGERANK_ALGO_POWER for every column, but it is much faster:
+ * the columns are iterated together, in blocks, and the edges of the
+ * graph are traversed once per iteration for a whole block, instead
+ * of once per column. The iteration runs in parallel if igraph was
+ * compiled with OpenMP support.
+ *
+ * </para><para>
+ * The iteration of a block stops when the largest change of its
+ * scores is less than the \c eps member of \p options, so a block
+ * runs until its slowest column converges.
+ *
+ * \param graph The graph object.
+ * \param res Pointer to an initialized matrix, the result is stored
+ *    here. It will have one row for each vertex in \p vids and one
+ *    column for each column of \p reset.
+ * \param vids The vertex ids for which the PageRank is returned.
+ * \param directed Boolean, whether to consider the directedness of
+ *    the edges. This is ignored for undirected graphs.
+ * \param damping The damping factor ("d" in the original paper).
+ * \param reset The reset distributions, one in each column. It must
+ *    have as many rows as the number of vertices. The columns need not
+ *    be normalized, but they must be non-negative, and each must have
+ *    at least one non-zero element.
+ * \param weights Optional edge weights, it is either a null pointer,
+ *    then the edges are not weighted, or a vector of the same length
+ *    as the number of edges.
+ * \param options The options of the power method, see \ref
+ *    igraph_pagerank_power_options_t, or a null pointer for the
+ *    defaults.
+ * \return Error code:
+ *         \c IGRAPH_ENOMEM, not enough memory for
+ *         temporary data.
+ *         \c IGRAPH_EINVVID, invalid vertex id in \p vids.
+ *         \c IGRAPH_EINVAL, invalid reset matrix, weights or options.
+ *
+ * Time complexity: O(k(|V|+|E|)) per iteration, where k is the
+ * number of columns in \p reset.
+ *
+ * \sa \ref igraph_personalized_pagerank() for a single reset
+ * distribution.
+ */
+
+int igraph_personalized_pagerank_batch(const igraph_t *graph,
+		    igraph_matrix_t *res, const igraph_vs_t vids,
+		    igraph_bool_t directed, igraph_real_t damping,
+		    const igraph_matrix_t *reset,
+		    const igraph_vector_t *weights,
+		    const igraph_pagerank_power_options_t *options) {
+
+  long int no_of_nodes=igraph_vcount(graph);
+  long int no_of_cols=igraph_matrix_ncol(reset);
+  igraph_integer_t niter= options ? options->niter : 1000;
+  igraph_real_t eps= options ? options->eps : 1e-10;
+  igraph_i_pagerank_power_t pr;
+  igraph_vector_t x, y, tmp, myreset, chunkdiff, vidv;
+  igraph_vector_t *px, *py;
+  igraph_real_t sum[IGRAPH_I_PAGERANK_BLOCK];
+  igraph_vit_t vit;
+  long int i, first, no_of_vids;
+  int c, width;
+
+  IGRAPH_CHECK(igraph_i_pagerank_power_check(graph, damping, weights,
+					     options));
+  if (igraph_matrix_nrow(reset) != no_of_nodes) {
+    IGRAPH_ERROR("Invalid number of rows in reset matrix when calculating "
+		 "personalized PageRank scores", IGRAPH_EINVAL);
+  }
+  if (no_of_nodes > 0 && no_of_cols > 0 && igraph_matrix_min(reset) < 0) {
+    IGRAPH_ERROR("the reset matrix must not contain negative elements",
+		 IGRAPH_EINVAL);
+  }
+  for (first=0; first<no_of_cols; first++) {
+    for (i=0; i<no_of_nodes; i++) {
+      if (MATRIX(*reset, i, first) != 0) { break; }
+    }
+    if (i == no_of_nodes) {
+      IGRAPH_ERROR("the sum of the elements in a column of the reset "
+		   "matrix must not be zero", IGRAPH_EINVAL);
+    }
+  }
+
+  IGRAPH_CHECK(igraph_vit_create(graph, vids, &vit));
+  IGRAPH_FINALLY(igraph_vit_destroy, &vit);
+  no_of_vids=IGRAPH_VIT_SIZE(vit);
+  IGRAPH_VECTOR_INIT_FINALLY(&vidv, 0);
+  IGRAPH_CHECK(igraph_vit_as_vector(&vit, &vidv));
+  IGRAPH_CHECK(igraph_matrix_resize(res, no_of_vids, no_of_cols));
+
+  if (no_of_cols == 0) {
+    igraph_vector_destroy(&vidv);
+    igraph_vit_destroy(&vit);
+    IGRAPH_FINALLY_CLEAN(2);
+    return 0;
+  }
+
+  width= no_of_cols < IGRAPH_I_PAGERANK_BLOCK ? (int) no_of_cols :
+    IGRAPH_I_PAGERANK_BLOCK;
+  IGRAPH_CHECK(igraph_i_pagerank_power_init(&pr, graph, directed, weights));
+  IGRAPH_FINALLY(igraph_i_pagerank_power_destroy, &pr);
+  IGRAPH_VECTOR_INIT_FINALLY(&chunkdiff, pr.no_of_chunks);
+  IGRAPH_VECTOR_INIT_FINALLY(&myreset, no_of_nodes*width);
+  IGRAPH_VECTOR_INIT_FINALLY(&x, no_of_nodes*width);
+  IGRAPH_VECTOR_INIT_FINALLY(&y, no_of_nodes*width);
+  IGRAPH_VECTOR_INIT_FINALLY(&tmp, no_of_nodes*width);
+
+  for (first=0; first<no_of_cols; first+=width) {
+    int bwidth= no_of_cols-first < width ? (int) (no_of_cols-first) : width;
+
+    /* The last block might be narrower */
+    if (bwidth != width) {
+      IGRAPH_CHECK(igraph_vector_resize(&myreset, no_of_nodes*bwidth));
+      IGRAPH_CHECK(igraph_vector_resize(&x, no_of_nodes*bwidth));
+      IGRAPH_CHECK(igraph_vector_resize(&y, no_of_nodes*bwidth));
+      IGRAPH_CHECK(igraph_vector_resize(&tmp, no_of_nodes*bwidth));
+    }
+
+    /* Normalized reset distributions of the block, row-wise */
+    for (c=0; c<bwidth; c++) {
+      sum[c]=0;
+      for (i=0; i<no_of_nodes; i++) {
+	sum[c] += MATRIX(*reset, i, first+c);
+      }
+      for (i=0; i<no_of_nodes; i++) {
+	VECTOR(myreset)[i*bwidth+c] = MATRIX(*reset, i, first+c) / sum[c];
+      }
+    }
+    igraph_vector_fill(&x, 1.0/no_of_nodes);
+    px=&x; py=&y;
+
+    IGRAPH_CHECK(igraph_i_pagerank_power_iterate(&pr, damping,
+						 VECTOR(myreset), bwidth,
+						 niter, eps, &px, &py, &tmp,
+						 &chunkdiff,
+						 100.0*first/no_of_cols,
+						 100.0*bwidth/no_of_cols));
+
+    for (c=0; c<bwidth; c++) {
+      sum[c]=0;
+      for (i=0; i<no_of_nodes; i++) {
+	sum[c] += VECTOR(*px)[i*bwidth+c];
+      }
+    }
+    for (i=0; i<no_of_vids; i++) {
+      long int v=(long int) VECTOR(vidv)[i];
+      for (c=0; c<bwidth; c++) {
+	MATRIX(*res, i, first+c) = VECTOR(*px)[v*bwidth+c] / sum[c];
+      }
+    }
+  }
+
+  igraph_vector_destroy(&tmp);
+  igraph_vector_destroy(&y);
+  igraph_vector_destroy(&x);
+  igraph_vector_destroy(&myreset);
+  igraph_vector_destroy(&chunkdiff);
+  igraph_i_pagerank_power_destroy(&pr);
+  igraph_vector_destroy(&vidv);
+  igraph_vit_destroy(&vit);
+  IGRAPH_FINALLY_CLEAN(8);
+
+  return 0;
+}
+
 /**
  * \ingroup structural
  * \function igraph_betweenness
@@ -1573,6 +2083,386 @@ int igraph_betweenness(const igraph_t *graph, igraph_vector_t *res,
 				     nobigint);
 }
 
+/*
+ * The betweenness functions below run one single-source shortest
+ * path search (BFS or Dijkstra) from every vertex, followed by the
+ * dependency accumulation of Brandes' algorithm. The sources are
+ * independent, so they are distributed among the OpenMP threads (if
+ * any). Every thread has its own work area, allocated in advance,
+ * because the searches themselves must not allocate memory or call
+ * the error handler, see igraph_parallel_internal.h. Each thread
+ * sums the dependencies into its own score vector, these are added
+ * up after the parallel region. Thread zero uses the result vector.
+ */
+
+typedef struct igraph_i_betweenness_thread_t {
+  long int *distance;		/* BFS: distance+1, zero if not reached */
+  unsigned long long int *nrgeo; /* BFS: number of shortest paths */
+  igraph_real_t *wdistance;	/* Dijkstra: distance+1, zero if not reached */
+  igraph_real_t *wnrgeo;	/* Dijkstra: number of shortest paths */
+  igraph_integer_t *nfathers;	/* Dijkstra: number of shortest path */
+  igraph_integer_t *fathers;	/*   edges into a vertex, and the edges */
+  igraph_2wheap_t Q;
+  igraph_bool_t Q_init;
+  igraph_real_t *tmpscore;
+  long int *order;		/* vertices in the order they were reached */
+  igraph_real_t *score;
+} igraph_i_betweenness_thread_t;
+
+typedef struct igraph_i_betweenness_work_t {
+  int nthreads;
+  long int *fstart;		/* Dijkstra: where the fathers of a vertex */
+				/*   start in 'fathers' */
+  igraph_i_betweenness_thread_t *threads;
+} igraph_i_betweenness_work_t;
+
+static void igraph_i_betweenness_work_destroy(igraph_i_betweenness_work_t *work) {
+  int i;
+  if (work->threads) {
+    for (i=0; i<work->nthreads; i++) {
+      igraph_i_betweenness_thread_t *t=&work->threads[i];
+      if (t->distance) { igraph_Free(t->distance); }
+      if (t->nrgeo) { igraph_Free(t->nrgeo); }
+      if (t->wdistance) { igraph_Free(t->wdistance); }
+      if (t->wnrgeo) { igraph_Free(t->wnrgeo); }
+      if (t->nfathers) { igraph_Free(t->nfathers); }
+      if (t->fathers) { igraph_Free(t->fathers); }
+      if (t->Q_init) { igraph_2wheap_destroy(&t->Q); }
+      if (t->tmpscore) { igraph_Free(t->tmpscore); }
+      if (t->order) { igraph_Free(t->order); }
+      if (i > 0 && t->score) { igraph_Free(t->score); }
+    }
+    igraph_Free(work->threads);
+  }
+  if (work->fstart) { igraph_Free(work->fstart); }
+}
+
+/*
+ * 'csr' is the weighted CSR snapshot used by Dijkstra's algorithm, or
+ * a null pointer for BFS. 'score' is the score vector of thread zero,
+ * of length 'score_size'; the score vectors of the other threads are
+ * allocated here.
+ */
+
+static int igraph_i_betweenness_work_init(igraph_i_betweenness_work_t *work,
+					  const igraph_t *graph,
+					  const igraph_csr_t *csr,
+					  igraph_real_t *score,
+					  long int score_size) {
+  long int no_of_nodes=igraph_vcount(graph);
+  long int alloc_nodes= no_of_nodes > 0 ? no_of_nodes : 1;
+  long int no_of_fathers=1;
+  long int i, j;
+
+  work->nthreads=IGRAPH_I_THREAD_COUNT(no_of_nodes);
+  work->fstart=0;
+  work->threads=igraph_Calloc(work->nthreads, igraph_i_betweenness_thread_t);
+  if (!work->threads) {
+    IGRAPH_ERROR("betweenness failed", IGRAPH_ENOMEM);
+  }
+  IGRAPH_FINALLY(igraph_i_betweenness_work_destroy, work);
+
+  if (csr) {
+    /* A vertex cannot have more fathers than the number of times it
+       appears as a neighbor in the snapshot */
+    work->fstart=igraph_Calloc(no_of_nodes+1, long int);
+    if (!work->fstart) {
+      IGRAPH_ERROR("betweenness failed", IGRAPH_ENOMEM);
+    }
+    for (i=0; i<no_of_nodes; i++) {
+      const int *neis=igraph_csr_neis(csr, i);
+      long int nlen=igraph_csr_degree(csr, i);
+      for (j=0; j<nlen; j++) {
+	work->fstart[neis[j]+1] += 1;
+      }
+    }
+    for (i=0; i<no_of_nodes; i++) {
+      work->fstart[i+1] += work->fstart[i];
+    }
+    if (work->fstart[no_of_nodes] > 0) {
+      no_of_fathers=work->fstart[no_of_nodes];
+    }
+  }
+
+  for (i=0; i<work->nthreads; i++) {
+    igraph_i_betweenness_thread_t *t=&work->threads[i];
+    t->tmpscore=igraph_Calloc(alloc_nodes, igraph_real_t);
+    t->order=igraph_Calloc(alloc_nodes, long int);
+    if (!t->tmpscore || !t->order) {
+      IGRAPH_ERROR("betweenness failed", IGRAPH_ENOMEM);
+    }
+    if (csr) {
+      t->wdistance=igraph_Calloc(alloc_nodes, igraph_real_t);
+      t->wnrgeo=igraph_Calloc(alloc_nodes, igraph_real_t);
+      t->nfathers=igraph_Calloc(alloc_nodes, igraph_integer_t);
+      t->fathers=igraph_Calloc(no_of_fathers, igraph_integer_t);
+      if (!t->wdistance || !t->wnrgeo || !t->nfathers || !t->fathers) {
+	IGRAPH_ERROR("betweenness failed", IGRAPH_ENOMEM);
+      }
+      IGRAPH_CHECK(igraph_2wheap_init(&t->Q, no_of_nodes));
+      t->Q_init=1;
+      /* Every vertex enters the heap at most once, make sure that
+	 the heap never needs to grow during the search */
+      IGRAPH_CHECK(igraph_vector_reserve(&t->Q.data, no_of_nodes));
+      IGRAPH_CHECK(igraph_vector_long_reserve(&t->Q.index, no_of_nodes));
+    } else {
+      t->distance=igraph_Calloc(alloc_nodes, long int);
+      t->nrgeo=igraph_Calloc(alloc_nodes, unsigned long long int);
+      if (!t->distance || !t->nrgeo) {
+	IGRAPH_ERROR("betweenness failed", IGRAPH_ENOMEM);
+      }
+    }
+    if (i == 0) {
+      t->score=score;
+    } else {
+      t->score=igraph_Calloc(score_size > 0 ? score_size : 1, igraph_real_t);
+      if (!t->score) {
+	IGRAPH_ERROR("betweenness failed", IGRAPH_ENOMEM);
+      }
+    }
+  }
+
+  IGRAPH_FINALLY_CLEAN(1);
+  return 0;
+}
+
+/* Add the scores of all threads to the score vector of thread zero */
+
+static void igraph_i_betweenness_work_reduce(igraph_i_betweenness_work_t *work,
+					     long int score_size) {
+  igraph_real_t *score=work->threads[0].score;
+  long int i, j;
+  for (i=1; i<work->nthreads; i++) {
+    igraph_real_t *tscore=work->threads[i].score;
+    for (j=0; j<score_size; j++) {
+      score[j] += tscore[j];
+    }
+  }
+}
+
+/*
+ * Vertex betweenness, unweighted, from a single source. The fathers
+ * of a vertex on the shortest paths are not stored: they are its
+ * neighbors in 'csr_in' that are one step closer to the source.
+ */
+
+static void igraph_i_betweenness_bfs(const igraph_csr_t *csr_out,
+				     const igraph_csr_t *csr_in,
+				     long int source, igraph_real_t cutoff,
+				     igraph_i_betweenness_thread_t *t) {
+  long int *distance=t->distance;
+  unsigned long long int *nrgeo=t->nrgeo;
+  igraph_real_t *tmpscore=t->tmpscore;
+  long int *order=t->order;
+  long int head=0, tail=0, j, nneis;
+  const int *neis;
+
+  order[tail++]=source;
+  nrgeo[source]=1;
+  distance[source]=1;
+
+  while (head < tail) {
+    long int actnode=order[head++];
+
+    if (cutoff >= 0 && distance[actnode] >= cutoff+1) { continue; }
+
+    neis = igraph_csr_neis(csr_out, actnode);
+    nneis = igraph_csr_degree(csr_out, actnode);
+    for (j=0; j<nneis; j++) {
+      long int neighbor=neis[j];
+      if (distance[neighbor]==0) {
+	distance[neighbor]=distance[actnode]+1;
+	order[tail++]=neighbor;
+      }
+      if (distance[neighbor]==distance[actnode]+1) {
+	nrgeo[neighbor]+=nrgeo[actnode];
+      }
+    }
+  }
+
+  /* Ok, we've the distance of each node and also the number of
+     shortest paths to them. Now we do an inverse search, starting
+     with the farthest nodes. */
+  while (tail > 0) {
+    long int actnode=order[--tail];
+    if (actnode != source) {
+      neis = igraph_csr_neis(csr_in, actnode);
+      nneis = igraph_csr_degree(csr_in, actnode);
+      for (j=0; j<nneis; j++) {
+	long int neighbor=neis[j];
+	if (distance[neighbor]==distance[actnode]-1) {
+	  tmpscore[neighbor] +=  (tmpscore[actnode]+1)*
+	    ((double)(nrgeo[neighbor]))/nrgeo[actnode];
+	}
+      }
+      t->score[actnode] += tmpscore[actnode];
+    }
+    distance[actnode]=0;
+    nrgeo[actnode]=0;
+    tmpscore[actnode]=0;
+  }
+}
+
+/*
+ * Edge betweenness, unweighted, from a single source.
+ */
+
+static void igraph_i_edge_betweenness_bfs(const igraph_csr_t *csr_out,
+					  const igraph_csr_t *csr_in,
+					  long int source, igraph_real_t cutoff,
+					  igraph_i_betweenness_thread_t *t) {
+  long int *distance=t->distance;
+  unsigned long long int *nrgeo=t->nrgeo;
+  igraph_real_t *tmpscore=t->tmpscore;
+  long int *order=t->order;
+  long int head=0, tail=0, i, neino;
+  const int *neis, *eids;
+
+  order[tail++]=source;
+  nrgeo[source]=1;
+  distance[source]=0;
+
+  while (head < tail) {
+    long int actnode=order[head++];
+
+    /* TODO: we could just as well 'break' here, no? */
+    if (cutoff > 0 && distance[actnode] >= cutoff ) continue;
+
+    neis=igraph_csr_neis(csr_out, actnode);
+    neino=igraph_csr_degree(csr_out, actnode);
+    for (i=0; i<neino; i++) {
+      long int neighbor=neis[i];
+      if (nrgeo[neighbor] != 0) {
+	/* we've already seen this node, another shortest path? */
+	if (distance[neighbor]==distance[actnode]+1) {
+	  nrgeo[neighbor]+=nrgeo[actnode];
+	}
+      } else {
+	/* we haven't seen this node yet */
+	nrgeo[neighbor]+=nrgeo[actnode];
+	distance[neighbor]=distance[actnode]+1;
+	order[tail++]=neighbor;
+      }
+    }
+  }
+
+  /* Ok, we've the distance of each node and also the number of
+     shortest paths to them. Now we do an inverse search, starting
+     with the farthest nodes. */
+  while (tail > 0) {
+    long int actnode=order[--tail];
+    if (distance[actnode] >= 1) {	/* skip source node */
+      /* set the temporary score of the friends */
+      neis=igraph_csr_neis(csr_in, actnode);
+      eids=igraph_csr_edges(csr_in, actnode);
+      neino=igraph_csr_degree(csr_in, actnode);
+      for (i=0; i<neino; i++) {
+	long int edgeno=eids[i];
+	long int neighbor=neis[i];
+	if (distance[neighbor]==distance[actnode]-1 &&
+	    nrgeo[neighbor] != 0) {
+	  tmpscore[neighbor] +=
+	    (tmpscore[actnode]+1)*nrgeo[neighbor]/nrgeo[actnode];
+	  t->score[edgeno] +=
+	    (tmpscore[actnode]+1)*nrgeo[neighbor]/nrgeo[actnode];
+	}
+      }
+    }
+    distance[actnode]=0;
+    nrgeo[actnode]=0;
+    tmpscore[actnode]=0;
+  }
+}
+
+/*
+ * Weighted vertex (if 'edges' is false) or edge (if it is true)
+ * betweenness from a single source, using Dijkstra's algorithm.
+ */
+
+static void igraph_i_betweenness_dijkstra(const igraph_t *graph,
+					  const igraph_csr_t *csr,
+					  const long int *fstart,
+					  long int source, igraph_real_t cutoff,
+					  igraph_bool_t edges,
+					  igraph_i_betweenness_thread_t *t) {
+  igraph_2wheap_t *Q=&t->Q;
+  igraph_real_t *dist=t->wdistance;
+  igraph_real_t *nrgeo=t->wnrgeo;
+  igraph_real_t *tmpscore=t->tmpscore;
+  igraph_integer_t *nfathers=t->nfathers;
+  igraph_integer_t *fathers=t->fathers;
+  long int *order=t->order;
+  long int nreached=0, j;
+
+  /* The heap has enough space reserved, these cannot fail */
+  igraph_2wheap_push_with_index(Q, source, 0);
+  dist[source]=1.0;
+  nrgeo[source]=1;
+
+  while (!igraph_2wheap_empty(Q)) {
+    long int minnei=igraph_2wheap_max_index(Q);
+    igraph_real_t mindist=-igraph_2wheap_delete_max(Q);
+    const int *neis, *eids;
+    const igraph_real_t *w;
+    long int nlen;
+
+    order[nreached++]=minnei;
+
+    if (cutoff >=0 && dist[minnei] >= cutoff+1.0) { continue; }
+
+    /* Now check all neighbors of 'minnei' for a shorter path */
+    neis=igraph_csr_neis(csr, minnei);
+    eids=igraph_csr_edges(csr, minnei);
+    w=igraph_csr_weights(csr, minnei);
+    nlen=igraph_csr_degree(csr, minnei);
+    for (j=0; j<nlen; j++) {
+      long int edge=eids[j];
+      long int to=neis[j];
+      igraph_real_t altdist=mindist + w[j];
+      igraph_real_t curdist=dist[to];
+      if (curdist==0) {
+	/* This is the first non-infinite distance */
+	nfathers[to]=1;
+	fathers[fstart[to]]=(igraph_integer_t) edge;
+	nrgeo[to]=nrgeo[minnei];
+	dist[to]=altdist+1.0;
+	igraph_2wheap_push_with_index(Q, to, -altdist);
+      } else if (altdist < curdist-1) {
+	/* This is a shorter path */
+	nfathers[to]=1;
+	fathers[fstart[to]]=(igraph_integer_t) edge;
+	nrgeo[to]=nrgeo[minnei];
+	dist[to]=altdist+1.0;
+	igraph_2wheap_modify(Q, to, -altdist);
+      } else if (altdist == curdist-1) {
+	fathers[fstart[to]+nfathers[to]]=(igraph_integer_t) edge;
+	nfathers[to] += 1;
+	nrgeo[to] += nrgeo[minnei];
+      }
+    }
+  }
+
+  while (nreached > 0) {
+    long int w=order[--nreached];
+    igraph_integer_t *fatv=fathers+fstart[w];
+    long int fatv_len=nfathers[w];
+    for (j=0; j<fatv_len; j++) {
+      long int fedge=fatv[j];
+      long int f=IGRAPH_OTHER(graph, fedge, w);
+      tmpscore[f] += nrgeo[f]/nrgeo[w] * (1+tmpscore[w]);
+      if (edges) {
+	t->score[fedge] += ((tmpscore[w]+1) * nrgeo[f]) / nrgeo[w];
+      }
+    }
+    if (!edges && w != source) { t->score[w] += tmpscore[w]; }
+
+    tmpscore[w]=0;
+    dist[w]=0;
+    nrgeo[w]=0;
+    nfathers[w]=0;
+  }
+}
+
 int igraph_i_betweenness_estimate_weighted(const igraph_t *graph, 
 					 igraph_vector_t *res, 
 					 const igraph_vs_t vids, 
@@ -1583,38 +2473,23 @@ int igraph_i_betweenness_estimate_weighted(const igraph_t *graph,
 
   igraph_integer_t no_of_nodes=(igraph_integer_t) igraph_vcount(graph);
   igraph_integer_t no_of_edges=(igraph_integer_t) igraph_ecount(graph);
-  igraph_2wheap_t Q;
-  igraph_inclist_t inclist;
-  igraph_adjlist_t fathers;
-  long int source, j;
-  igraph_stack_t S;
+  igraph_csr_t csr;
+  igraph_i_betweenness_work_t work;
+  long int j;
   igraph_neimode_t mode= directed ? IGRAPH_OUT : IGRAPH_ALL;
-  igraph_vector_t dist, nrgeo, tmpscore;
   igraph_vector_t v_tmpres, *tmpres=&v_tmpres;
   igraph_vit_t vit;
+  long int first, chunk;
 
   IGRAPH_UNUSED(nobigint);
 
   if (igraph_vector_size(weights) != no_of_edges) {
     IGRAPH_ERROR("Weight vector length does not match", IGRAPH_EINVAL);
   }
-  if (igraph_vector_min(weights) <= 0) {
+  if (no_of_edges > 0 && igraph_vector_min(weights) <= 0) {
     IGRAPH_ERROR("Weight vector must be positive", IGRAPH_EINVAL);
   }
 
-  IGRAPH_CHECK(igraph_2wheap_init(&Q, no_of_nodes));
-  IGRAPH_FINALLY(igraph_2wheap_destroy, &Q);
-  IGRAPH_CHECK(igraph_inclist_init(graph, &inclist, mode));  
-  IGRAPH_FINALLY(igraph_inclist_destroy, &inclist);
-  IGRAPH_CHECK(igraph_adjlist_init_empty(&fathers, no_of_nodes));
-  IGRAPH_FINALLY(igraph_adjlist_destroy, &fathers);
-
-  IGRAPH_CHECK(igraph_stack_init(&S, no_of_nodes));
-  IGRAPH_FINALLY(igraph_stack_destroy, &S);
-  IGRAPH_VECTOR_INIT_FINALLY(&dist, no_of_nodes);
-  IGRAPH_VECTOR_INIT_FINALLY(&tmpscore, no_of_nodes);
-  IGRAPH_VECTOR_INIT_FINALLY(&nrgeo, no_of_nodes);
-
   if (igraph_vs_is_all(&vids)) {
     IGRAPH_CHECK(igraph_vector_resize(res, no_of_nodes));
     igraph_vector_null(res);
@@ -1623,76 +2498,40 @@ int igraph_i_betweenness_estimate_weighted(const igraph_t *graph,
     IGRAPH_VECTOR_INIT_FINALLY(tmpres, no_of_nodes);
   }
 
-  for (source=0; source<no_of_nodes; source++) {
-    IGRAPH_PROGRESS("Betweenness centrality: ", 100.0*source/no_of_nodes, 0);
+  IGRAPH_CHECK(igraph_csr_init(graph, &csr, mode, weights));
+  IGRAPH_FINALLY(igraph_csr_destroy, &csr);
+
+  IGRAPH_CHECK(igraph_i_betweenness_work_init(&work, graph, &csr,
+					      VECTOR(*tmpres), no_of_nodes));
+  IGRAPH_FINALLY(igraph_i_betweenness_work_destroy, &work);
+
+  chunk=IGRAPH_I_PARALLEL_CHUNK(work.nthreads);
+  for (first=0; first<no_of_nodes; first+=chunk) {
+    long int last= first+chunk < no_of_nodes ? first+chunk : no_of_nodes;
+    IGRAPH_PROGRESS("Betweenness centrality: ", 100.0*first/no_of_nodes, 0);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(work.nthreads)
+#endif
+    {
+      igraph_i_betweenness_thread_t *t=&work.threads[IGRAPH_I_THREAD_NUM()];
+      long int source;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+      for (source=first; source<last; source++) {
+	igraph_i_betweenness_dijkstra(graph, &csr, work.fstart, source,
+				      cutoff, /*edges=*/ 0, t);
+      }
+    }
     IGRAPH_ALLOW_INTERRUPTION();
+  }
 
-    igraph_2wheap_push_with_index(&Q, source, 0);
-    VECTOR(dist)[source]=1.0;
-    VECTOR(nrgeo)[source]=1;
-    
-    while (!igraph_2wheap_empty(&Q)) {
-      long int minnei=igraph_2wheap_max_index(&Q);
-      igraph_real_t mindist=-igraph_2wheap_delete_max(&Q);
-      igraph_vector_int_t *neis;
-      long int nlen;
-      
-      igraph_stack_push(&S, minnei);
-      
-      if (cutoff >=0 && VECTOR(dist)[minnei] >= cutoff+1.0) { continue; }
-      
-      /* Now check all neighbors of 'minnei' for a shorter path */
-      neis=igraph_inclist_get(&inclist, minnei);
-      nlen=igraph_vector_int_size(neis);
-      for (j=0; j<nlen; j++) {
-	long int edge=(long int) VECTOR(*neis)[j];
-	long int to=IGRAPH_OTHER(graph, edge, minnei);
-	igraph_real_t altdist=mindist + VECTOR(*weights)[edge];
-	igraph_real_t curdist=VECTOR(dist)[to];
-	if (curdist==0) {
-	  /* This is the first non-infinite distance */
-	  igraph_vector_int_t *v=igraph_adjlist_get(&fathers, to);
-	  igraph_vector_int_resize(v,1);
-	  VECTOR(*v)[0]=minnei;
-	  VECTOR(nrgeo)[to] = VECTOR(nrgeo)[minnei];
-
-	  VECTOR(dist)[to]=altdist+1.0;
-	  IGRAPH_CHECK(igraph_2wheap_push_with_index(&Q, to, -altdist));
-	} else if (altdist < curdist-1) {
-	  /* This is a shorter path */
-	  igraph_vector_int_t *v=igraph_adjlist_get(&fathers, to);
-	  igraph_vector_int_resize(v,1);
-	  VECTOR(*v)[0]=minnei;
-	  VECTOR(nrgeo)[to] = VECTOR(nrgeo)[minnei];
-
-	  VECTOR(dist)[to]=altdist+1.0;
-	  IGRAPH_CHECK(igraph_2wheap_modify(&Q, to, -altdist));
-	} else if (altdist == curdist-1) {
-	  igraph_vector_int_t *v=igraph_adjlist_get(&fathers, to);
-	  igraph_vector_int_push_back(v, minnei);
-	  VECTOR(nrgeo)[to] += VECTOR(nrgeo)[minnei];
-	}
-      }
-      
-    } /* !igraph_2wheap_empty(&Q) */
-
-    while (!igraph_stack_empty(&S)) {
-      long int w=(long int) igraph_stack_pop(&S);
-      igraph_vector_int_t *fatv=igraph_adjlist_get(&fathers, w);
-      long int fatv_len=igraph_vector_int_size(fatv);
-      for (j=0; j<fatv_len; j++) {
-	long int f=(long int) VECTOR(*fatv)[j];
-	VECTOR(tmpscore)[f] += VECTOR(nrgeo)[f]/VECTOR(nrgeo)[w] * (1+VECTOR(tmpscore)[w]);
-      }
-      if (w!=source) { VECTOR(*tmpres)[w] += VECTOR(tmpscore)[w]; }
+  igraph_i_betweenness_work_reduce(&work, no_of_nodes);
+  igraph_i_betweenness_work_destroy(&work);
+  IGRAPH_FINALLY_CLEAN(1);
 
-      VECTOR(tmpscore)[w]=0;
-      VECTOR(dist)[w]=0;
-      VECTOR(nrgeo)[w]=0;
-      igraph_vector_int_clear(igraph_adjlist_get(&fathers, w));
-    }
-    
-  } /* source < no_of_nodes */
+  igraph_csr_destroy(&csr);
+  IGRAPH_FINALLY_CLEAN(1);
 
   if (!igraph_vs_is_all(&vids)) {
     IGRAPH_CHECK(igraph_vit_create(graph, vids, &vit));
@@ -1720,15 +2559,6 @@ int igraph_i_betweenness_estimate_weighted(const igraph_t *graph,
   
   IGRAPH_PROGRESS("Betweenness centrality: ", 100.0, 0);
 
-  igraph_vector_destroy(&nrgeo);
-  igraph_vector_destroy(&tmpscore);
-  igraph_vector_destroy(&dist);
-  igraph_stack_destroy(&S);
-  igraph_adjlist_destroy(&fathers);
-  igraph_inclist_destroy(&inclist);
-  igraph_2wheap_destroy(&Q);
-  IGRAPH_FINALLY_CLEAN(7);
-  
   return 0;
 }
 
@@ -1755,6 +2585,13 @@ void igraph_i_destroy_biguints(igraph_biguint_t *p) {
  * equal to a prescribed length. Note that the estimated centrality
  * will always be less than the real one.
  *
+ * </para><para>
+ * If igraph was compiled with OpenMP support, the shortest paths
+ * from the different source vertices are calculated in parallel, the
+ * number of threads can be set via the \c OMP_NUM_THREADS
+ * environment variable. The unweighted calculation with \p nobigint
+ * set to false is always sequential, as it uses big integers.
+ *
  * \param graph The graph object.
  * \param res The result of the computation, a vector containing the
  *        estimated betweenness scores for the specified vertices.
@@ -1796,23 +2633,13 @@ int igraph_betweenness_estimate(const igraph_t *graph, igraph_vector_t *res,
 				igraph_bool_t nobigint) {
 
   long int no_of_nodes=igraph_vcount(graph);
-  igraph_dqueue_t q=IGRAPH_DQUEUE_NULL;
-  long int *distance;
-  unsigned long long int *nrgeo=0;  /* must be long long; consider grid
-				       graphs for example */
-  igraph_biguint_t *big_nrgeo=0;
-  double *tmpscore;
-  igraph_stack_t stack=IGRAPH_STACK_NULL;
-  long int source;
   long int j, k, nneis;
-  igraph_vector_int_t *neis;
+  const int *neis;
   igraph_vector_t v_tmpres, *tmpres=&v_tmpres;
   igraph_vit_t vit;
 
-  igraph_adjlist_t adjlist_out, adjlist_in;
-  igraph_adjlist_t *adjlist_out_p, *adjlist_in_p;
-
-  igraph_biguint_t D, R, T;
+  igraph_csr_t csr_out, csr_in;
+  igraph_csr_t *csr_out_p, *csr_in_p;
 
   if (weights) { 
     return igraph_i_betweenness_estimate_weighted(graph, res, vids, directed,
@@ -1831,36 +2658,70 @@ int igraph_betweenness_estimate(const igraph_t *graph, igraph_vector_t *res,
 
   directed=directed && igraph_is_directed(graph);
   if (directed) {
-    IGRAPH_CHECK(igraph_adjlist_init(graph, &adjlist_out, IGRAPH_OUT));
-    IGRAPH_FINALLY(igraph_adjlist_destroy, &adjlist_out);
-    IGRAPH_CHECK(igraph_adjlist_init(graph, &adjlist_in, IGRAPH_IN));
-    IGRAPH_FINALLY(igraph_adjlist_destroy, &adjlist_in);
-    adjlist_out_p=&adjlist_out;
-    adjlist_in_p=&adjlist_in;
+    IGRAPH_CHECK(igraph_csr_init(graph, &csr_out, IGRAPH_OUT, 0));
+    IGRAPH_FINALLY(igraph_csr_destroy, &csr_out);
+    IGRAPH_CHECK(igraph_csr_init(graph, &csr_in, IGRAPH_IN, 0));
+    IGRAPH_FINALLY(igraph_csr_destroy, &csr_in);
+    csr_out_p=&csr_out;
+    csr_in_p=&csr_in;
   } else {
-    IGRAPH_CHECK(igraph_adjlist_init(graph, &adjlist_out, IGRAPH_ALL));
-    IGRAPH_FINALLY(igraph_adjlist_destroy, &adjlist_out);
-    IGRAPH_CHECK(igraph_adjlist_init(graph, &adjlist_in, IGRAPH_ALL));
-    IGRAPH_FINALLY(igraph_adjlist_destroy, &adjlist_in);
-    adjlist_out_p=&adjlist_out;
-    adjlist_in_p=&adjlist_in;
-  }
-  for (j=0; j<no_of_nodes; j++) {
-    igraph_vector_int_clear(igraph_adjlist_get(adjlist_in_p, j));
-  }
-  
-  distance=igraph_Calloc(no_of_nodes, long int);
-  if (distance==0) {
-    IGRAPH_ERROR("betweenness failed", IGRAPH_ENOMEM);
+    IGRAPH_CHECK(igraph_csr_init(graph, &csr_out, IGRAPH_ALL, 0));
+    IGRAPH_FINALLY(igraph_csr_destroy, &csr_out);
+    csr_out_p=csr_in_p=&csr_out;
   }
-  IGRAPH_FINALLY(igraph_free, distance);
+
   if (nobigint) {
-    nrgeo=igraph_Calloc(no_of_nodes, unsigned long long int);
-    if (nrgeo==0) {
-      IGRAPH_ERROR("betweenness failed", IGRAPH_ENOMEM);
+
+    /* Sources are processed in parallel, see igraph_i_betweenness_bfs */
+    igraph_i_betweenness_work_t work;
+    long int first, chunk;
+
+    IGRAPH_CHECK(igraph_i_betweenness_work_init(&work, graph, 0,
+						VECTOR(*tmpres), no_of_nodes));
+    IGRAPH_FINALLY(igraph_i_betweenness_work_destroy, &work);
+
+    chunk=IGRAPH_I_PARALLEL_CHUNK(work.nthreads);
+    for (first=0; first<no_of_nodes; first+=chunk) {
+      long int last= first+chunk < no_of_nodes ? first+chunk : no_of_nodes;
+      IGRAPH_PROGRESS("Betweenness centrality: ", 100.0*first/no_of_nodes,
+		      0);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(work.nthreads)
+#endif
+      {
+	igraph_i_betweenness_thread_t *t=
+	  &work.threads[IGRAPH_I_THREAD_NUM()];
+	long int source;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+	for (source=first; source<last; source++) {
+	  igraph_i_betweenness_bfs(csr_out_p, csr_in_p, source, cutoff, t);
+	}
+      }
+      IGRAPH_ALLOW_INTERRUPTION();
     }
-    IGRAPH_FINALLY(igraph_free, nrgeo);
+
+    igraph_i_betweenness_work_reduce(&work, no_of_nodes);
+    igraph_i_betweenness_work_destroy(&work);
+    IGRAPH_FINALLY_CLEAN(1);
+
   } else {
+
+    /* Big integers need memory allocation, so this is done serially */
+    igraph_dqueue_t q=IGRAPH_DQUEUE_NULL;
+    long int *distance;
+    igraph_biguint_t *big_nrgeo=0;
+    double *tmpscore;
+    igraph_stack_t stack=IGRAPH_STACK_NULL;
+    long int source;
+    igraph_biguint_t D, R, T;
+
+    distance=igraph_Calloc(no_of_nodes, long int);
+    if (distance==0) {
+      IGRAPH_ERROR("betweenness failed", IGRAPH_ENOMEM);
+    }
+    IGRAPH_FINALLY(igraph_free, distance);
     /* +1 is to have one containing zeros, when we free it, we stop
        at the zero */
     big_nrgeo=igraph_Calloc(no_of_nodes+1, igraph_biguint_t);
@@ -1877,119 +2738,105 @@ int igraph_betweenness_estimate(const igraph_t *graph, igraph_vector_t *res,
     IGRAPH_FINALLY(igraph_biguint_destroy, &R);
     IGRAPH_CHECK(igraph_biguint_init(&T));
     IGRAPH_FINALLY(igraph_biguint_destroy, &T);
-  }
-  tmpscore=igraph_Calloc(no_of_nodes, double);
-  if (tmpscore==0) {
-    IGRAPH_ERROR("betweenness failed", IGRAPH_ENOMEM);
-  }
-  IGRAPH_FINALLY(igraph_free, tmpscore);
+    tmpscore=igraph_Calloc(no_of_nodes, double);
+    if (tmpscore==0) {
+      IGRAPH_ERROR("betweenness failed", IGRAPH_ENOMEM);
+    }
+    IGRAPH_FINALLY(igraph_free, tmpscore);
 
-  IGRAPH_DQUEUE_INIT_FINALLY(&q, 100);
-  igraph_stack_init(&stack, no_of_nodes);
-  IGRAPH_FINALLY(igraph_stack_destroy, &stack);
+    IGRAPH_DQUEUE_INIT_FINALLY(&q, 100);
+    IGRAPH_CHECK(igraph_stack_init(&stack, no_of_nodes));
+    IGRAPH_FINALLY(igraph_stack_destroy, &stack);
     
-  /* here we go */
+    /* here we go */
   
-  for (source=0; source<no_of_nodes; source++) {
-    IGRAPH_PROGRESS("Betweenness centrality: ", 100.0*source/no_of_nodes, 0);
-    IGRAPH_ALLOW_INTERRUPTION();
+    for (source=0; source<no_of_nodes; source++) {
+      IGRAPH_PROGRESS("Betweenness centrality: ", 100.0*source/no_of_nodes, 0);
+      IGRAPH_ALLOW_INTERRUPTION();
 
-    IGRAPH_CHECK(igraph_dqueue_push(&q, source));
-    if (nobigint) { 
-      nrgeo[source]=1;
-    } else {
+      IGRAPH_CHECK(igraph_dqueue_push(&q, source));
       igraph_biguint_set_limb(&big_nrgeo[source], 1);
-    }
-    distance[source]=1;
+      distance[source]=1;
     
-    while (!igraph_dqueue_empty(&q)) {
-      long int actnode=(long int) igraph_dqueue_pop(&q);
-      IGRAPH_CHECK(igraph_stack_push(&stack, actnode));
+      while (!igraph_dqueue_empty(&q)) {
+	long int actnode=(long int) igraph_dqueue_pop(&q);
+	IGRAPH_CHECK(igraph_stack_push(&stack, actnode));
 
-      if (cutoff >= 0 && distance[actnode] >= cutoff+1) { continue; }
+	if (cutoff >= 0 && distance[actnode] >= cutoff+1) { continue; }
       
-      neis = igraph_adjlist_get(adjlist_out_p, actnode);
-      nneis = igraph_vector_int_size(neis);
-      for (j=0; j<nneis; j++) {
-        long int neighbor=(long int) VECTOR(*neis)[j];
-        if (distance[neighbor]==0) {
-	  distance[neighbor]=distance[actnode]+1;
-	  IGRAPH_CHECK(igraph_dqueue_push(&q, neighbor));
-	} 
-	if (distance[neighbor]==distance[actnode]+1) {
-	  igraph_vector_int_t *v=igraph_adjlist_get(adjlist_in_p, 
-						    neighbor);
-	  igraph_vector_int_push_back(v, actnode);
-	  if (nobigint) { 
-	    nrgeo[neighbor]+=nrgeo[actnode];
-	  } else {
+	neis = igraph_csr_neis(csr_out_p, actnode);
+	nneis = igraph_csr_degree(csr_out_p, actnode);
+	for (j=0; j<nneis; j++) {
+	  long int neighbor=neis[j];
+	  if (distance[neighbor]==0) {
+	    distance[neighbor]=distance[actnode]+1;
+	    IGRAPH_CHECK(igraph_dqueue_push(&q, neighbor));
+	  } 
+	  if (distance[neighbor]==distance[actnode]+1) {
 	    IGRAPH_CHECK(igraph_biguint_add(&big_nrgeo[neighbor],
 					    &big_nrgeo[neighbor], 
 					    &big_nrgeo[actnode]));
 	  }
 	}
-      }
-    } /* while !igraph_dqueue_empty */
+      } /* while !igraph_dqueue_empty */
     
-    /* Ok, we've the distance of each node and also the number of
-       shortest paths to them. Now we do an inverse search, starting
-       with the farthest nodes. */
-    while (!igraph_stack_empty(&stack)) {
-      long int actnode=(long int) igraph_stack_pop(&stack);
-      neis = igraph_adjlist_get(adjlist_in_p, actnode);
-      nneis = igraph_vector_int_size(neis);
-      for (j=0; j<nneis; j++) {
-        long int neighbor=(long int) VECTOR(*neis)[j];
-	if (nobigint) {
-	  tmpscore[neighbor] +=  (tmpscore[actnode]+1)*
-	    ((double)(nrgeo[neighbor]))/nrgeo[actnode];
-	} else {
-	  if (!igraph_biguint_compare_limb(&big_nrgeo[actnode], 0)) {
-	    tmpscore[neighbor] = IGRAPH_INFINITY;
-	  } else {
-	    double div;
-	    limb_t shift=1000000000L;
-	    IGRAPH_CHECK(igraph_biguint_mul_limb(&T, &big_nrgeo[neighbor], 
-						 shift));	  
-	    igraph_biguint_div(&D, &R, &T, &big_nrgeo[actnode]);
-	    div=igraph_biguint_get(&D) / shift;
-	    tmpscore[neighbor] += (tmpscore[actnode]+1) * div;
+      /* Ok, we've the distance of each node and also the number of
+	 shortest paths to them. Now we do an inverse search, starting
+	 with the farthest nodes. The fathers of a node are its
+	 neighbors one step closer to the source. */
+      while (!igraph_stack_empty(&stack)) {
+	long int actnode=(long int) igraph_stack_pop(&stack);
+	if (actnode != source) {
+	  neis = igraph_csr_neis(csr_in_p, actnode);
+	  nneis = igraph_csr_degree(csr_in_p, actnode);
+	  for (j=0; j<nneis; j++) {
+	    long int neighbor=neis[j];
+	    if (distance[neighbor] != distance[actnode]-1) { continue; }
+	    if (!igraph_biguint_compare_limb(&big_nrgeo[actnode], 0)) {
+	      tmpscore[neighbor] = IGRAPH_INFINITY;
+	    } else {
+	      double div;
+	      limb_t shift=1000000000L;
+	      IGRAPH_CHECK(igraph_biguint_mul_limb(&T, &big_nrgeo[neighbor], 
+						   shift));	  
+	      igraph_biguint_div(&D, &R, &T, &big_nrgeo[actnode]);
+	      div=igraph_biguint_get(&D) / shift;
+	      tmpscore[neighbor] += (tmpscore[actnode]+1) * div;
+	    }
 	  }
-	}
-      }
       
-      if (actnode != source) { VECTOR(*tmpres)[actnode] += tmpscore[actnode]; }
+	  VECTOR(*tmpres)[actnode] += tmpscore[actnode];
+	}
 
-      distance[actnode]=0;
-      if (nobigint) { 
-	nrgeo[actnode]=0;
-      } else {
+	distance[actnode]=0;
 	igraph_biguint_set_limb(&big_nrgeo[actnode], 0);
+	tmpscore[actnode]=0;
       }
-      tmpscore[actnode]=0;
-      igraph_vector_int_clear(igraph_adjlist_get(adjlist_in_p, actnode));
-    }
-
-  } /* for source < no_of_nodes */
 
-  IGRAPH_PROGRESS("Betweenness centrality: ", 100.0, 0);
+    } /* for source < no_of_nodes */
 
-  /* clean  */
-  igraph_Free(distance);
-  if (nobigint) {
-    igraph_Free(nrgeo); 
-  } else {
+    /* clean  */
+    igraph_Free(distance);
     igraph_biguint_destroy(&T);
     igraph_biguint_destroy(&R);
     igraph_biguint_destroy(&D);
     IGRAPH_FINALLY_CLEAN(3);
     igraph_i_destroy_biguints(big_nrgeo);
-  }
-  igraph_Free(tmpscore);
+    igraph_Free(tmpscore);
   
-  igraph_dqueue_destroy(&q);
-  igraph_stack_destroy(&stack);
-  IGRAPH_FINALLY_CLEAN(5);
+    igraph_dqueue_destroy(&q);
+    igraph_stack_destroy(&stack);
+    IGRAPH_FINALLY_CLEAN(5);
+  }
+
+  IGRAPH_PROGRESS("Betweenness centrality: ", 100.0, 0);
+
+  if (csr_in_p != csr_out_p) {
+    igraph_csr_destroy(&csr_in);
+    IGRAPH_FINALLY_CLEAN(1);
+  }
+  igraph_csr_destroy(&csr_out);
+  IGRAPH_FINALLY_CLEAN(1);
 
   /* Keep only the requested vertices */
   if (!igraph_vs_is_all(&vids)) { 
@@ -2016,10 +2863,6 @@ int igraph_betweenness_estimate(const igraph_t *graph, igraph_vector_t *res,
     }
   }
   
-  igraph_adjlist_destroy(&adjlist_out);
-  igraph_adjlist_destroy(&adjlist_in);
-  IGRAPH_FINALLY_CLEAN(2);
-
   return 0;
 }
 
@@ -2030,126 +2873,51 @@ int igraph_i_edge_betweenness_estimate_weighted(const igraph_t *graph,
 					      const igraph_vector_t *weights) {
   igraph_integer_t no_of_nodes=(igraph_integer_t) igraph_vcount(graph);
   igraph_integer_t no_of_edges=(igraph_integer_t) igraph_ecount(graph);
-  igraph_2wheap_t Q;
-  igraph_inclist_t inclist;
-  igraph_inclist_t fathers;
+  igraph_csr_t csr;
+  igraph_i_betweenness_work_t work;
   igraph_neimode_t mode= directed ? IGRAPH_OUT : IGRAPH_ALL;
-  igraph_vector_t distance, tmpscore;
-  igraph_vector_long_t nrgeo;
-  long int source, j;
-  igraph_stack_t S;
+  long int j, first, chunk;
 
   if (igraph_vector_size(weights) != no_of_edges) {
     IGRAPH_ERROR("Weight vector length does not match", IGRAPH_EINVAL);
   }
-  if (igraph_vector_min(weights) < 0) {
+  if (no_of_edges > 0 && igraph_vector_min(weights) < 0) {
     IGRAPH_ERROR("Weight vector must be non-negative", IGRAPH_EINVAL);
   }
   
-  IGRAPH_CHECK(igraph_inclist_init(graph, &inclist, mode));
-  IGRAPH_FINALLY(igraph_inclist_destroy, &inclist);
-  IGRAPH_CHECK(igraph_inclist_init_empty(&fathers, no_of_nodes));
-  IGRAPH_FINALLY(igraph_inclist_destroy, &fathers);
-
-  IGRAPH_VECTOR_INIT_FINALLY(&distance, no_of_nodes);
-  IGRAPH_VECTOR_INIT_FINALLY(&tmpscore, no_of_nodes);
-  IGRAPH_CHECK(igraph_vector_long_init(&nrgeo, no_of_nodes));
-  IGRAPH_FINALLY(igraph_vector_long_destroy, &nrgeo);
-
-  IGRAPH_CHECK(igraph_2wheap_init(&Q, no_of_nodes));
-  IGRAPH_FINALLY(igraph_2wheap_destroy, &Q);
-  IGRAPH_CHECK(igraph_stack_init(&S, no_of_nodes));
-  IGRAPH_FINALLY(igraph_stack_destroy, &S);
+  IGRAPH_CHECK(igraph_csr_init(graph, &csr, mode, weights));
+  IGRAPH_FINALLY(igraph_csr_destroy, &csr);
 
   IGRAPH_CHECK(igraph_vector_resize(result, no_of_edges));
   igraph_vector_null(result);
 
-  for (source=0; source<no_of_nodes; source++) {
-    IGRAPH_PROGRESS("Edge betweenness centrality: ", 100.0*source/no_of_nodes, 0);
-    IGRAPH_ALLOW_INTERRUPTION();
-
-/*     printf("source: %li\n", source); */
-    
-    igraph_vector_null(&distance);
-    igraph_vector_null(&tmpscore);
-    igraph_vector_long_null(&nrgeo);
-    
-    igraph_2wheap_push_with_index(&Q, source, 0);
-    VECTOR(distance)[source]=1.0;
-    VECTOR(nrgeo)[source]=1;
-    
-    while (!igraph_2wheap_empty(&Q)) {
-      long int minnei=igraph_2wheap_max_index(&Q);
-      igraph_real_t mindist=-igraph_2wheap_delete_max(&Q);
-      igraph_vector_int_t *neis;
-      long int nlen;
-
-/*       printf("SP to %li is final, dist: %g, nrgeo: %li\n", minnei, */
-/* 	     VECTOR(distance)[minnei]-1.0, VECTOR(nrgeo)[minnei]); */
-      
-      igraph_stack_push(&S, minnei);
-
-      if (cutoff >=0 && VECTOR(distance)[minnei] >= cutoff+1.0) { continue; }
-
-      neis=igraph_inclist_get(&inclist, minnei);
-      nlen=igraph_vector_int_size(neis);
-      for (j=0; j<nlen; j++) {
-	long int edge=(long int) VECTOR(*neis)[j];
-	long int to=IGRAPH_OTHER(graph, edge, minnei);
-	igraph_real_t altdist=mindist + VECTOR(*weights)[edge];
-	igraph_real_t curdist=VECTOR(distance)[to];
-	
-	if (curdist==0) {
-	  /* This is the first finite distance to 'to' */
-	  igraph_vector_int_t *v=igraph_inclist_get(&fathers, to);
-/* 	  printf("Found first path to %li (from %li)\n", to, minnei); */
-	  igraph_vector_int_resize(v,1);
-	  VECTOR(*v)[0]=edge;
-	  VECTOR(nrgeo)[to] = VECTOR(nrgeo)[minnei];
-	  VECTOR(distance)[to]=altdist+1.0;
-	  IGRAPH_CHECK(igraph_2wheap_push_with_index(&Q, to, -altdist));
-	} else if (altdist < curdist-1) {
-	  /* This is a shorter path */
-	  igraph_vector_int_t *v =igraph_inclist_get(&fathers, to);
-/* 	  printf("Found a shorter path to %li (from %li)\n", to, minnei); */
-	  igraph_vector_int_resize(v,1);
-	  VECTOR(*v)[0]=edge;
-	  VECTOR(nrgeo)[to] = VECTOR(nrgeo)[minnei];
-	  VECTOR(distance)[to] = altdist+1.0;
-	  IGRAPH_CHECK(igraph_2wheap_modify(&Q, to, -altdist));
-	} else if (altdist == curdist-1) {
-	  igraph_vector_int_t *v=igraph_inclist_get(&fathers, to);
-/* 	  printf("Found a second SP to %li (from %li)\n", to, minnei); */
-	  igraph_vector_int_push_back(v, edge);
-	  VECTOR(nrgeo)[to] += VECTOR(nrgeo)[minnei];
-	}
+  IGRAPH_CHECK(igraph_i_betweenness_work_init(&work, graph, &csr,
+					      VECTOR(*result), no_of_edges));
+  IGRAPH_FINALLY(igraph_i_betweenness_work_destroy, &work);
+
+  chunk=IGRAPH_I_PARALLEL_CHUNK(work.nthreads);
+  for (first=0; first<no_of_nodes; first+=chunk) {
+    long int last= first+chunk < no_of_nodes ? first+chunk : no_of_nodes;
+    IGRAPH_PROGRESS("Edge betweenness centrality: ",
+		    100.0*first/no_of_nodes, 0);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(work.nthreads)
+#endif
+    {
+      igraph_i_betweenness_thread_t *t=&work.threads[IGRAPH_I_THREAD_NUM()];
+      long int source;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+      for (source=first; source<last; source++) {
+	igraph_i_betweenness_dijkstra(graph, &csr, work.fstart, source,
+				      cutoff, /*edges=*/ 1, t);
       }
-	  
-    } /* igraph_2wheap_empty(&Q) */
-
-    while (!igraph_stack_empty(&S)) {
-      long int w=(long int) igraph_stack_pop(&S);
-      igraph_vector_int_t *fatv=igraph_inclist_get(&fathers, w);
-      long int fatv_len=igraph_vector_int_size(fatv);
-/*       printf("Popping %li.\n", w); */
-      for (j=0; j<fatv_len; j++) {
-	long int fedge=(long int) VECTOR(*fatv)[j];
-	long int neighbor=IGRAPH_OTHER(graph, fedge, w);
-	VECTOR(tmpscore)[neighbor] += ((double)VECTOR(nrgeo)[neighbor]) /
-	  VECTOR(nrgeo)[w] * (1.0+VECTOR(tmpscore)[w]);
-/* 	printf("Scoring %li (edge %li)\n", neighbor, fedge); */
-	VECTOR(*result)[fedge] += 
-	  ((VECTOR(tmpscore)[w]+1) * VECTOR(nrgeo)[neighbor]) / 
-	  VECTOR(nrgeo)[w];
-      }
-      
-      VECTOR(tmpscore)[w]=0;
-      VECTOR(distance)[w]=0;
-      VECTOR(nrgeo)[w]=0;
-      igraph_vector_int_clear(fatv);
     }
-    
-  } /* source < no_of_nodes */
+    IGRAPH_ALLOW_INTERRUPTION();
+  }
+
+  igraph_i_betweenness_work_reduce(&work, no_of_edges);
 
   if (!directed || !igraph_is_directed(graph)) {
     for (j=0; j<no_of_edges; j++) {
@@ -2159,17 +2927,10 @@ int igraph_i_edge_betweenness_estimate_weighted(const igraph_t *graph,
 
   IGRAPH_PROGRESS("Edge betweenness centrality: ", 100.0, 0);
 
-  igraph_stack_destroy(&S);
-  igraph_2wheap_destroy(&Q);
+  igraph_i_betweenness_work_destroy(&work);
+  igraph_csr_destroy(&csr);
   IGRAPH_FINALLY_CLEAN(2);
   
-  igraph_inclist_destroy(&inclist);
-  igraph_inclist_destroy(&fathers);  
-  igraph_vector_destroy(&distance);
-  igraph_vector_destroy(&tmpscore);
-  igraph_vector_long_destroy(&nrgeo);
-  IGRAPH_FINALLY_CLEAN(5);
-  
   return 0;
 }
 
@@ -2227,6 +2988,11 @@ int igraph_edge_betweenness(const igraph_t *graph, igraph_vector_t *result,
  * takes into consideration only those paths that are shorter than or
  * equal to a prescribed length. Note that the estimated centrality
  * will always be less than the real one.
+ *
+ * </para><para>
+ * If igraph was compiled with OpenMP support, the shortest paths
+ * from the different source vertices are calculated in parallel, see
+ * \ref igraph_betweenness_estimate() for details.
  * \param graph The graph object.
  * \param result The result of the computation, vector containing the
  *        betweenness scores for the edges.
@@ -2256,19 +3022,12 @@ int igraph_edge_betweenness_estimate(const igraph_t *graph, igraph_vector_t *res
 				     const igraph_vector_t *weights) {
   long int no_of_nodes=igraph_vcount(graph);
   long int no_of_edges=igraph_ecount(graph);
-  igraph_dqueue_t q=IGRAPH_DQUEUE_NULL;
-  long int *distance;
-  unsigned long long int *nrgeo;
-  double *tmpscore;
-  igraph_stack_t stack=IGRAPH_STACK_NULL;
-  long int source;
   long int j;
+  igraph_i_betweenness_work_t work;
+  long int first, chunk;
 
-  igraph_inclist_t elist_out, elist_in;
-  igraph_inclist_t *elist_out_p, *elist_in_p;
-  igraph_vector_int_t *neip;
-  long int neino;
-  long int i;
+  igraph_csr_t csr_out, csr_in;
+  igraph_csr_t *csr_out_p, *csr_in_p;
 
   if (weights) { 
     return igraph_i_edge_betweenness_estimate_weighted(graph, result, 
@@ -2277,129 +3036,62 @@ int igraph_edge_betweenness_estimate(const igraph_t *graph, igraph_vector_t *res
 
   directed=directed && igraph_is_directed(graph);
   if (directed) {
-    IGRAPH_CHECK(igraph_inclist_init(graph, &elist_out, IGRAPH_OUT));
-    IGRAPH_FINALLY(igraph_inclist_destroy, &elist_out);
-    IGRAPH_CHECK(igraph_inclist_init(graph, &elist_in, IGRAPH_IN));
-    IGRAPH_FINALLY(igraph_inclist_destroy, &elist_in);
-    elist_out_p=&elist_out;
-    elist_in_p=&elist_in;
+    IGRAPH_CHECK(igraph_csr_init(graph, &csr_out, IGRAPH_OUT, 0));
+    IGRAPH_FINALLY(igraph_csr_destroy, &csr_out);
+    IGRAPH_CHECK(igraph_csr_init(graph, &csr_in, IGRAPH_IN, 0));
+    IGRAPH_FINALLY(igraph_csr_destroy, &csr_in);
+    csr_out_p=&csr_out;
+    csr_in_p=&csr_in;
   } else {
-    IGRAPH_CHECK(igraph_inclist_init(graph,&elist_out, IGRAPH_ALL));
-    IGRAPH_FINALLY(igraph_inclist_destroy, &elist_out);
-    elist_out_p=elist_in_p=&elist_out;
+    IGRAPH_CHECK(igraph_csr_init(graph, &csr_out, IGRAPH_ALL, 0));
+    IGRAPH_FINALLY(igraph_csr_destroy, &csr_out);
+    csr_out_p=csr_in_p=&csr_out;
   }
   
-  distance=igraph_Calloc(no_of_nodes, long int);
-  if (distance==0) {
-    IGRAPH_ERROR("edge betweenness failed", IGRAPH_ENOMEM);
-  }
-  IGRAPH_FINALLY(igraph_free, distance);
-  nrgeo=igraph_Calloc(no_of_nodes, unsigned long long int);
-  if (nrgeo==0) {
-    IGRAPH_ERROR("edge betweenness failed", IGRAPH_ENOMEM);
-  }
-  IGRAPH_FINALLY(igraph_free, nrgeo);
-  tmpscore=igraph_Calloc(no_of_nodes, double);
-  if (tmpscore==0) {
-    IGRAPH_ERROR("edge betweenness failed", IGRAPH_ENOMEM);
-  }
-  IGRAPH_FINALLY(igraph_free, tmpscore);
-
-  IGRAPH_DQUEUE_INIT_FINALLY(&q, 100);
-  IGRAPH_CHECK(igraph_stack_init(&stack, no_of_nodes));
-  IGRAPH_FINALLY(igraph_stack_destroy, &stack);
-
   IGRAPH_CHECK(igraph_vector_resize(result, no_of_edges));
 
   igraph_vector_null(result);
 
-  /* here we go */
-  
-  for (source=0; source<no_of_nodes; source++) {
-    IGRAPH_PROGRESS("Edge betweenness centrality: ", 100.0*source/no_of_nodes, 0);
-    IGRAPH_ALLOW_INTERRUPTION();
-
-    memset(distance, 0, (size_t) no_of_nodes * sizeof(long int));
-    memset(nrgeo, 0, (size_t) no_of_nodes*sizeof(unsigned long long int));
-    memset(tmpscore, 0, (size_t) no_of_nodes*sizeof(double));
-    igraph_stack_clear(&stack); /* it should be empty anyway... */
-    
-    IGRAPH_CHECK(igraph_dqueue_push(&q, source));
-      
-    nrgeo[source]=1;
-    distance[source]=0;
-    
-    while (!igraph_dqueue_empty(&q)) {
-      long int actnode=(long int) igraph_dqueue_pop(&q);
+  IGRAPH_CHECK(igraph_i_betweenness_work_init(&work, graph, 0,
+					      VECTOR(*result), no_of_edges));
+  IGRAPH_FINALLY(igraph_i_betweenness_work_destroy, &work);
 
-      /* TODO: we could just as well 'break' here, no? */
-      if (cutoff > 0 && distance[actnode] >= cutoff ) continue;
+  /* here we go */
 
-      neip=igraph_inclist_get(elist_out_p, actnode);
-      neino=igraph_vector_int_size(neip);
-      for (i=0; i<neino; i++) {
-	igraph_integer_t edge=(igraph_integer_t) VECTOR(*neip)[i], from, to;
-	long int neighbor;
-	igraph_edge(graph, edge, &from, &to);
-	neighbor = actnode!=from ? from : to;
-	if (nrgeo[neighbor] != 0) {
-	  /* we've already seen this node, another shortest path? */
-	  if (distance[neighbor]==distance[actnode]+1) {
-	    nrgeo[neighbor]+=nrgeo[actnode];
-	  }
-	} else {
-	  /* we haven't seen this node yet */
-	  nrgeo[neighbor]+=nrgeo[actnode];
-	  distance[neighbor]=distance[actnode]+1;
-	  IGRAPH_CHECK(igraph_dqueue_push(&q, neighbor));
-	  IGRAPH_CHECK(igraph_stack_push(&stack, neighbor));
-	}
-      }
-    } /* while !igraph_dqueue_empty */
-    
-    /* Ok, we've the distance of each node and also the number of
-       shortest paths to them. Now we do an inverse search, starting
-       with the farthest nodes. */
-    while (!igraph_stack_empty(&stack)) {
-      long int actnode=(long int) igraph_stack_pop(&stack);
-      if (distance[actnode]<1) { continue; } /* skip source node */
-      
-      /* set the temporary score of the friends */
-      neip=igraph_inclist_get(elist_in_p, actnode);
-      neino=igraph_vector_int_size(neip);
-      for (i=0; i<neino; i++) {
-	igraph_integer_t from, to;
-	long int neighbor;
-	igraph_integer_t edgeno=(igraph_integer_t) VECTOR(*neip)[i];
-	igraph_edge(graph, edgeno, &from, &to);
-	neighbor= actnode != from ? from : to;
-	if (distance[neighbor]==distance[actnode]-1 &&
-	    nrgeo[neighbor] != 0) {
-	  tmpscore[neighbor] +=
-	    (tmpscore[actnode]+1)*nrgeo[neighbor]/nrgeo[actnode];
-	  VECTOR(*result)[edgeno] +=
-	    (tmpscore[actnode]+1)*nrgeo[neighbor]/nrgeo[actnode];
-	}
+  chunk=IGRAPH_I_PARALLEL_CHUNK(work.nthreads);
+  for (first=0; first<no_of_nodes; first+=chunk) {
+    long int last= first+chunk < no_of_nodes ? first+chunk : no_of_nodes;
+    IGRAPH_PROGRESS("Edge betweenness centrality: ",
+		    100.0*first/no_of_nodes, 0);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(work.nthreads)
+#endif
+    {
+      igraph_i_betweenness_thread_t *t=&work.threads[IGRAPH_I_THREAD_NUM()];
+      long int source;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+      for (source=first; source<last; source++) {
+	igraph_i_edge_betweenness_bfs(csr_out_p, csr_in_p, source, cutoff, t);
       }
     }
-    /* Ok, we've the scores for this source */
-  } /* for source <= no_of_nodes */
+    IGRAPH_ALLOW_INTERRUPTION();
+  }
+
+  igraph_i_betweenness_work_reduce(&work, no_of_edges);
   IGRAPH_PROGRESS("Edge betweenness centrality: ", 100.0, 0);
 
   /* clean and return */
-  igraph_Free(distance);
-  igraph_Free(nrgeo);
-  igraph_Free(tmpscore);
-  igraph_dqueue_destroy(&q);
-  igraph_stack_destroy(&stack);
-  IGRAPH_FINALLY_CLEAN(5);
+  igraph_i_betweenness_work_destroy(&work);
+  IGRAPH_FINALLY_CLEAN(1);
 
   if (directed) {
-    igraph_inclist_destroy(&elist_out);
-    igraph_inclist_destroy(&elist_in);
+    igraph_csr_destroy(&csr_out);
+    igraph_csr_destroy(&csr_in);
     IGRAPH_FINALLY_CLEAN(2);
   } else {
-    igraph_inclist_destroy(&elist_out);
+    igraph_csr_destroy(&csr_out);
     IGRAPH_FINALLY_CLEAN(1);
   }
 
@@ -2478,115 +3170,80 @@ int igraph_closeness(const igraph_t *graph, igraph_vector_t *res,
 				   normalized);
 }
 
-int igraph_i_closeness_estimate_weighted(const igraph_t *graph, 
-				       igraph_vector_t *res, 
-				       const igraph_vs_t vids, 
-				       igraph_neimode_t mode,
-				       igraph_real_t cutoff,
-				       const igraph_vector_t *weights,
-				       igraph_bool_t normalized) {
-
-  /* See igraph_shortest_paths_dijkstra() for the implementation 
-     details and the dirty tricks. */
+/* 
+ * The sums of the distances and the number of reached vertices, for
+ * closeness. Unweighted graphs use a bit-parallel BFS, weighted ones
+ * run Dijkstra's algorithm from the vertices in parallel.
+ */
 
-  long int no_of_nodes=igraph_vcount(graph);
-  long int no_of_edges=igraph_ecount(graph);
-  
-  igraph_2wheap_t Q;
-  igraph_vit_t vit;
-  long int nodes_to_calc;
-  
-  igraph_lazy_inclist_t inclist;
-  long int i, j;
-  
-  igraph_vector_t dist;
-  igraph_vector_long_t which;
-  long int nodes_reached;
-  
-  if (igraph_vector_size(weights) != no_of_edges) {
-    IGRAPH_ERROR("Invalid weight vector length", IGRAPH_EINVAL);
+typedef struct igraph_i_closeness_t {
+  igraph_vector_t *res;
+  igraph_vector_t *reached;
+} igraph_i_closeness_t;
+
+static void igraph_i_closeness_visitor(long int first, long int vertex,
+				       long int dist,
+				       igraph_i_msbfs_mask_t sources,
+				       void *extra) {
+  igraph_i_closeness_t *data=(igraph_i_closeness_t *) extra;
+  while (sources) {
+    long int i=first + IGRAPH_I_MSBFS_LOWBIT(sources);
+    VECTOR(*data->res)[i] += dist;
+    VECTOR(*data->reached)[i] += 1;
+    sources &= sources-1;
   }
-  
-  if (igraph_vector_min(weights) < 0) {
-    IGRAPH_ERROR("Weight vector must be non-negative", IGRAPH_EINVAL);
-  }
-  
-  IGRAPH_CHECK(igraph_vit_create(graph, vids, &vit));
-  IGRAPH_FINALLY(igraph_vit_destroy, &vit);
-  
-  nodes_to_calc=IGRAPH_VIT_SIZE(vit);
-  
-  IGRAPH_CHECK(igraph_2wheap_init(&Q, no_of_nodes));
-  IGRAPH_FINALLY(igraph_2wheap_destroy, &Q);
-  IGRAPH_CHECK(igraph_lazy_inclist_init(graph, &inclist, mode));
-  IGRAPH_FINALLY(igraph_lazy_inclist_destroy, &inclist);
-
-  IGRAPH_VECTOR_INIT_FINALLY(&dist, no_of_nodes);
-  IGRAPH_CHECK(igraph_vector_long_init(&which, no_of_nodes));
-  IGRAPH_FINALLY(igraph_vector_long_destroy, &which);
-
-  IGRAPH_CHECK(igraph_vector_resize(res, nodes_to_calc));
-  igraph_vector_null(res);
+}
 
-  for (i=0; !IGRAPH_VIT_END(vit); IGRAPH_VIT_NEXT(vit), i++) {
-    
-    long int source=IGRAPH_VIT_GET(vit);
-    igraph_2wheap_clear(&Q);
-    igraph_2wheap_push_with_index(&Q, source, 0);
-    VECTOR(which)[source]=i+1;
-    VECTOR(dist)[source]=0.0;
-    nodes_reached=0;
-    
-    while (!igraph_2wheap_empty(&Q)) {
-      igraph_integer_t minnei=(igraph_integer_t) igraph_2wheap_max_index(&Q);
-      igraph_real_t mindist=-igraph_2wheap_delete_max(&Q);
-      
-      /* Now check all neighbors of minnei for a shorter path */
-      igraph_vector_t *neis=igraph_lazy_inclist_get(&inclist, minnei);
-      long int nlen=igraph_vector_size(neis);
+static int igraph_i_closeness_weighted(const igraph_t *graph,
+				       igraph_vector_t *res,
+				       igraph_vector_t *reached,
+				       const igraph_vector_t *vidv,
+				       igraph_neimode_t mode,
+				       igraph_real_t cutoff,
+				       const igraph_vector_t *weights) {
 
-      VECTOR(*res)[i] += mindist;
-      nodes_reached++;
-      
-      if (cutoff>0 && mindist>=cutoff) continue;    /* NOT break!!! */
-      
-      for (j=0; j<nlen; j++) {
-	long int edge=(long int) VECTOR(*neis)[j];
-	long int to=IGRAPH_OTHER(graph, edge, minnei);
-	igraph_real_t altdist=mindist+VECTOR(*weights)[edge];
-	igraph_real_t curdist=VECTOR(dist)[to];
-	if (VECTOR(which)[to] != i+1) {
-	  /* First non-infinite distance */
-	  VECTOR(which)[to]=i+1;
-	  VECTOR(dist)[to]=altdist;
-	  IGRAPH_CHECK(igraph_2wheap_push_with_index(&Q, to, -altdist));
-	} else if (altdist < curdist) {
-	  /* This is a shorter path */
-	  VECTOR(dist)[to]=altdist;
-	  IGRAPH_CHECK(igraph_2wheap_modify(&Q, to, -altdist));
+  long int nodes_to_calc=igraph_vector_size(vidv);
+  long int i;
+  igraph_i_sssp_t sssp;
+  long int first, chunk;
+
+  IGRAPH_CHECK(igraph_i_sssp_init(&sssp, graph, weights, mode, 
+				  nodes_to_calc));
+  IGRAPH_FINALLY(igraph_i_sssp_destroy, &sssp);
+
+  chunk=IGRAPH_I_PARALLEL_CHUNK(sssp.nthreads);
+  for (first=0; first<nodes_to_calc; first+=chunk) {
+    long int last= first+chunk < nodes_to_calc ? first+chunk : nodes_to_calc;
+    IGRAPH_PROGRESS("Closeness: ", 100.0*first/nodes_to_calc, 0);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(sssp.nthreads)
+#endif
+    {
+      int thread=IGRAPH_I_THREAD_NUM();
+      igraph_i_sssp_thread_t *t=&sssp.threads[thread];
+      long int k;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+      for (i=first; i<last; i++) {
+	long int n;
+	igraph_real_t sum=0.0;
+
+	n=igraph_i_sssp(&sssp, thread, (long int) VECTOR(*vidv)[i],
+			cutoff > 0 ? cutoff : -1, 0, 0);
+	for (k=0; k<n; k++) {
+	  sum += t->dist[t->order[k]];
 	}
+	VECTOR(*res)[i] = sum;
+	VECTOR(*reached)[i] = n;
       }
-
-    } /* !igraph_2wheap_empty(&Q) */
-
-    /* using igraph_real_t here instead of igraph_integer_t to avoid overflow */
-    VECTOR(*res)[i] += ((igraph_real_t)no_of_nodes * (no_of_nodes-nodes_reached));
-    VECTOR(*res)[i] = (no_of_nodes-1) / VECTOR(*res)[i];
-
-  } /* !IGRAPH_VIT_END(vit) */
-
-  if (!normalized) {
-    for (i=0; i<nodes_to_calc; i++) {
-      VECTOR(*res)[i] /= (no_of_nodes-1);
     }
+    IGRAPH_ALLOW_INTERRUPTION();
   }
 
-  igraph_vector_long_destroy(&which);
-  igraph_vector_destroy(&dist);
-  igraph_lazy_inclist_destroy(&inclist);
-  igraph_2wheap_destroy(&Q);
-  igraph_vit_destroy(&vit);
-  IGRAPH_FINALLY_CLEAN(5);
+
+  igraph_i_sssp_destroy(&sssp);
+  IGRAPH_FINALLY_CLEAN(1);
 
   return 0;
 }
@@ -2615,6 +3272,11 @@ int igraph_i_closeness_estimate_weighted(const igraph_t *graph,
  * the given value as disconnected, the resulting estimation will always be
  * lower than the actual closeness centrality.
  * 
+ * </para><para>
+ * Without weights, the breadth-first searches of 64 vertices are
+ * done together, in a single traversal of the graph. If igraph was
+ * compiled with OpenMP, the searches run in parallel.
+ * 
  * \param graph The graph object.
  * \param res The result of the computation, a vector containing the
  *        closeness centrality scores for the given vertices.
@@ -2664,73 +3326,54 @@ int igraph_closeness_estimate(const igraph_t *graph, igraph_vector_t *res,
 			      igraph_bool_t normalized) {
 
   long int no_of_nodes=igraph_vcount(graph);
-  igraph_vector_t already_counted;
-  igraph_vector_int_t *neis;
-  long int i, j;
-  long int nodes_reached;
-  igraph_adjlist_t allneis;
-
-  igraph_dqueue_t q;
-  
-  long int nodes_to_calc;
+  long int no_of_edges=igraph_ecount(graph);
+  long int i;
+  igraph_vector_t vidv, reached;
   igraph_vit_t vit;
+  long int nodes_to_calc;
 
-  if (weights) { 
-    return igraph_i_closeness_estimate_weighted(graph, res, vids, mode, cutoff,
-						weights, normalized);
-  }
-
-  IGRAPH_CHECK(igraph_vit_create(graph, vids, &vit));
-  IGRAPH_FINALLY(igraph_vit_destroy, &vit);
-
-  nodes_to_calc=IGRAPH_VIT_SIZE(vit);
-  
   if (mode != IGRAPH_OUT && mode != IGRAPH_IN && 
       mode != IGRAPH_ALL) {
     IGRAPH_ERROR("calculating closeness", IGRAPH_EINVMODE);
   }
 
-  IGRAPH_VECTOR_INIT_FINALLY(&already_counted, no_of_nodes);
-  IGRAPH_DQUEUE_INIT_FINALLY(&q, 100);
+  if (weights) {
+    if (igraph_vector_size(weights) != no_of_edges) {
+      IGRAPH_ERROR("Invalid weight vector length", IGRAPH_EINVAL);
+    }
+    if (no_of_edges > 0 && igraph_vector_min(weights) < 0) {
+      IGRAPH_ERROR("Weight vector must be non-negative", IGRAPH_EINVAL);
+    }
+  }
 
-  IGRAPH_CHECK(igraph_adjlist_init(graph, &allneis, mode));
-  IGRAPH_FINALLY(igraph_adjlist_destroy, &allneis);
+  IGRAPH_CHECK(igraph_vit_create(graph, vids, &vit));
+  IGRAPH_FINALLY(igraph_vit_destroy, &vit);
+  IGRAPH_VECTOR_INIT_FINALLY(&vidv, 0);
+  IGRAPH_CHECK(igraph_vit_as_vector(&vit, &vidv));
+  nodes_to_calc=IGRAPH_VIT_SIZE(vit);
 
   IGRAPH_CHECK(igraph_vector_resize(res, nodes_to_calc));
   igraph_vector_null(res);
-  
-  for (IGRAPH_VIT_RESET(vit), i=0; 
-       !IGRAPH_VIT_END(vit); 
-       IGRAPH_VIT_NEXT(vit), i++) {
-    igraph_dqueue_clear(&q);
-    IGRAPH_CHECK(igraph_dqueue_push(&q, IGRAPH_VIT_GET(vit)));
-    IGRAPH_CHECK(igraph_dqueue_push(&q, 0));
-    nodes_reached=1;
-    VECTOR(already_counted)[(long int)IGRAPH_VIT_GET(vit)]=i+1;
-
-    IGRAPH_PROGRESS("Closeness: ", 100.0*i/no_of_nodes, NULL);
-    IGRAPH_ALLOW_INTERRUPTION();
-    
-    while (!igraph_dqueue_empty(&q)) {
-      long int act=(long int) igraph_dqueue_pop(&q);
-      long int actdist=(long int) igraph_dqueue_pop(&q);
-      
-      VECTOR(*res)[i] += actdist;
-
-      if (cutoff>0 && actdist>=cutoff) continue;   /* NOT break!!! */
-
-      neis=igraph_adjlist_get(&allneis, act);
-      for (j=0; j<igraph_vector_int_size(neis); j++) {
-        long int neighbor=(long int) VECTOR(*neis)[j];
-        if (VECTOR(already_counted)[neighbor] == i+1) { continue; }
-        VECTOR(already_counted)[neighbor] = i+1;
-        nodes_reached++;
-        IGRAPH_CHECK(igraph_dqueue_push(&q, neighbor));
-        IGRAPH_CHECK(igraph_dqueue_push(&q, actdist+1));
-      }
-    }
-    /* using igraph_real_t here instead of igraph_integer_t to avoid overflow */
-    VECTOR(*res)[i] += ((igraph_real_t)no_of_nodes * (no_of_nodes-nodes_reached));
+  IGRAPH_VECTOR_INIT_FINALLY(&reached, nodes_to_calc);
+
+  if (!weights) {
+    igraph_i_closeness_t data;
+    data.res=res;
+    data.reached=&reached;
+    IGRAPH_CHECK(igraph_i_msbfs(graph, &vidv, mode, 
+				cutoff > 0 ? (long int) ceil(cutoff) : -1,
+				igraph_i_closeness_visitor, &data,
+				"Closeness: "));
+  } else {
+    IGRAPH_CHECK(igraph_i_closeness_weighted(graph, res, &reached, &vidv,
+					     mode, cutoff, weights));
+  }
+
+  for (i=0; i<nodes_to_calc; i++) {
+    /* using igraph_real_t here instead of igraph_integer_t to avoid
+       overflow */
+    VECTOR(*res)[i] += ((igraph_real_t)no_of_nodes * 
+			(no_of_nodes-VECTOR(reached)[i]));
     VECTOR(*res)[i] = (no_of_nodes-1) / VECTOR(*res)[i];
   }
 
@@ -2743,11 +3386,10 @@ int igraph_closeness_estimate(const igraph_t *graph, igraph_vector_t *res,
   IGRAPH_PROGRESS("Closeness: ", 100.0, NULL);
 
   /* Clean */
-  igraph_dqueue_destroy(&q);
-  igraph_vector_destroy(&already_counted);
+  igraph_vector_destroy(&reached);
+  igraph_vector_destroy(&vidv);
   igraph_vit_destroy(&vit);
-  igraph_adjlist_destroy(&allneis);
-  IGRAPH_FINALLY_CLEAN(4);
+  IGRAPH_FINALLY_CLEAN(3);
   
   return 0;
 }
@@ -49,6 +49,7 @@
 #include <cstdlib>
 #include <cstdio>
 #include <ctime>
+#include <vector>
 
 #include "NetDataTypes.h"
 #include "NetRoutines.h"
@@ -61,6 +62,7 @@
 #include "igraph_interface.h"
 #include "igraph_components.h"
 #include "igraph_interrupt_internal.h"
+#include "igraph_parallel_internal.h"
 
 int igraph_i_community_spinglass_orig(const igraph_t *graph,
 				      const igraph_vector_t *weights,
@@ -74,7 +76,8 @@ int igraph_i_community_spinglass_orig(const igraph_t *graph,
 				      igraph_real_t stoptemp,
 				      igraph_real_t coolfact,
 				      igraph_spincomm_update_t update_rule,
-				      igraph_real_t gamma);
+				      igraph_real_t gamma,
+				      igraph_integer_t replicas);
 
 int igraph_i_community_spinglass_negative(const igraph_t *graph,
 					  const igraph_vector_t *weights,
@@ -92,7 +95,8 @@ int igraph_i_community_spinglass_negative(const igraph_t *graph,
 /* 					  igraph_matrix_t *adhesion, */
 /* 					  igraph_matrix_t *normalised_adhesion, */
 /* 					  igraph_real_t *polarization, */
-					  igraph_real_t gamma_minus);
+					  igraph_real_t gamma_minus,
+					  igraph_integer_t replicas);
 
 /**
  * \function igraph_community_spinglass
@@ -178,7 +182,8 @@ int igraph_i_community_spinglass_negative(const igraph_t *graph,
  * \return Error code.
  * 
  * \sa igraph_community_spinglass_single() for calculating the community
- * of a single vertex.
+ * of a single vertex, igraph_community_spinglass_replicas() to run
+ * several independent annealings and keep the best one.
  * 
  * Time complexity: TODO.
  * 
@@ -204,14 +209,97 @@ int igraph_community_spinglass(const igraph_t *graph,
 /* 			       igraph_matrix_t *normalised_adhesion, */
 /* 			       igraph_real_t *polarization, */
 			       igraph_real_t gamma_minus) {
-  
+
+  return igraph_community_spinglass_replicas(graph, weights, modularity,
+					     temperature, membership, csize,
+					     spins, parupdate, starttemp,
+					     stoptemp, coolfact, update_rule,
+					     gamma, implementation,
+					     gamma_minus, /*replicas=*/ 1);
+}
+
+/**
+ * \function igraph_community_spinglass_replicas
+ * \brief Spin glass community detection with several independent annealings
+ * 
+ * The simulated annealing of igraph_community_spinglass() ends up
+ * in a different local optimum in every run. This function runs
+ * several replicas of the annealing, from different random initial
+ * states, and returns the best result. If igraph was compiled with
+ * OpenMP support, the replicas run in parallel. The replicas are
+ * seeded from the default random number generator, and the result
+ * does not depend on the number of threads.
+ * 
+ * </para><para>
+ * For the \c IGRAPH_SPINCOMM_IMP_ORIG implementation the best
+ * replica is the one with the largest (weighted, generalized)
+ * modularity, i.e. the lowest energy; for \c IGRAPH_SPINCOMM_IMP_NEG
+ * it is the one with the largest modularity, as reported in \p
+ * modularity. Ties are broken in favor of the replica that was
+ * started first. With a single replica this function gives exactly
+ * the same result as igraph_community_spinglass().
+ * 
+ * \param graph The input graph, it may be directed but the direction
+ *     of the edge is not used in the original implementation.
+ * \param weights The vector giving the edge weights, or \c NULL.
+ * \param modularity Pointer to a real number, if not \c NULL then the
+ *     modularity score of the best solution is stored here.
+ * \param temperature Pointer to a real number, if not \c NULL then
+ *     the final temperature of the best replica is stored here.
+ * \param membership Pointer to an initialized vector or \c NULL, the
+ *     membership vector of the best solution.
+ * \param csize Pointer to an initialized vector or \c NULL, the
+ *     cluster sizes of the best solution.
+ * \param spins The number of spins, see igraph_community_spinglass().
+ * \param parupdate Whether to update the spins in parallel, see
+ *     igraph_community_spinglass().
+ * \param starttemp The start temperature.
+ * \param stoptemp The stop temperature.
+ * \param coolfact The cooling factor.
+ * \param update_rule The null model, see igraph_community_spinglass().
+ * \param gamma The gamma parameter.
+ * \param implementation The implementation, \c IGRAPH_SPINCOMM_IMP_ORIG
+ *     or \c IGRAPH_SPINCOMM_IMP_NEG.
+ * \param gamma_minus The gamma parameter for negative edges, for the
+ *     \c IGRAPH_SPINCOMM_IMP_NEG implementation.
+ * \param replicas The number of independent annealings, at least one.
+ * \return Error code.
+ * 
+ * \sa igraph_community_spinglass() for the details of the algorithm
+ * and its parameters.
+ * 
+ * Time complexity: \p replicas times the time complexity of
+ * igraph_community_spinglass(), divided by the number of threads.
+ */
+
+int igraph_community_spinglass_replicas(const igraph_t *graph,
+					const igraph_vector_t *weights,
+					igraph_real_t *modularity,
+					igraph_real_t *temperature,
+					igraph_vector_t *membership, 
+					igraph_vector_t *csize, 
+					igraph_integer_t spins,
+					igraph_bool_t parupdate,
+					igraph_real_t starttemp,
+					igraph_real_t stoptemp,
+					igraph_real_t coolfact,
+					igraph_spincomm_update_t update_rule,
+					igraph_real_t gamma,
+					igraph_spinglass_implementation_t implementation,
+					igraph_real_t gamma_minus,
+					igraph_integer_t replicas) {
+
+  if (replicas < 1) {
+    IGRAPH_ERROR("Number of replicas must be at least one", IGRAPH_EINVAL);
+  }
+
   switch (implementation) {
   case IGRAPH_SPINCOMM_IMP_ORIG:
     return igraph_i_community_spinglass_orig(graph, weights, modularity, 
 					     temperature, membership, csize, 
 					     spins, parupdate, starttemp, 
 					     stoptemp, coolfact, update_rule, 
-					     gamma);
+					     gamma, replicas);
     break;
   case IGRAPH_SPINCOMM_IMP_NEG:
     return igraph_i_community_spinglass_negative(graph, weights, modularity, 
@@ -221,7 +309,7 @@ int igraph_community_spinglass(const igraph_t *graph,
 						 update_rule, gamma, 
 /* 						 adhesion, normalised_adhesion, */
 /* 						 polarization, */
-						 gamma_minus);
+						 gamma_minus, replicas);
     break;
   default:
     IGRAPH_ERROR("Unknown `implementation' in spinglass community finding",
@@ -231,6 +319,165 @@ int igraph_community_spinglass(const igraph_t *graph,
   return 0;
 }
 
+static void igraph_i_spinglass_destroy_network(network *net) {
+  ClusterList<NNode*> *cl_cur;
+  while (net->link_list->Size()) delete net->link_list->Pop();
+  while (net->node_list->Size()) delete net->node_list->Pop();
+  while (net->cluster_list->Size())
+    {
+      cl_cur=net->cluster_list->Pop();
+      while (cl_cur->Size()) cl_cur->Pop();
+      delete cl_cur;
+    }
+  delete net->link_list;
+  delete net->node_list;
+  delete net->cluster_list;
+  delete net;
+}
+
+template <class MODEL>
+static void igraph_i_spinglass_destroy_models(std::vector<MODEL*> *models) {
+  for (size_t i=0; i<models->size(); i++) {
+    delete (*models)[i];
+  }
+}
+
+static void igraph_i_spinglass_destroy_rngs(std::vector<igraph_rng_t> *rngs) {
+  for (size_t i=0; i<rngs->size(); i++) {
+    igraph_rng_destroy(&(*rngs)[i]);
+  }
+}
+
+/* Random number generators for the replicas. A single replica uses
+   the default generator, so that it gives the same result as it did
+   before there were replicas. Otherwise every replica has its own
+   generator, seeded from the default one. */
+
+static int igraph_i_spinglass_rngs(std::vector<igraph_rng_t> *rngs,
+				   std::vector<igraph_rng_t*> *replica_rng,
+				   long int replicas) {
+  long int r;
+  if (replicas == 1) {
+    replica_rng->push_back(igraph_rng_default());
+    return 0;
+  }
+  rngs->reserve(replicas);
+  for (r=0; r<replicas; r++) {
+    igraph_rng_t rng;
+    IGRAPH_CHECK(igraph_rng_init(&rng, &igraph_rngtype_mt19937));
+    rngs->push_back(rng);
+  }
+  RNG_BEGIN();
+  for (r=0; r<replicas; r++) {
+    igraph_rng_seed(&(*rngs)[r], RNG_INT31());
+    replica_rng->push_back(&(*rngs)[r]);
+  }
+  RNG_END();
+  return 0;
+}
+
+/* One annealing of the original implementation, returns the final
+   temperature */
+
+static double igraph_i_spinglass_anneal_orig(PottsModel *pm, double prob,
+					     igraph_integer_t spins,
+					     igraph_bool_t parupdate,
+					     igraph_real_t starttemp,
+					     igraph_real_t stoptemp,
+					     igraph_real_t coolfact,
+					     igraph_real_t gamma,
+					     bool &interrupted) {
+  unsigned long changes, runs;
+  bool zeroT;
+  double kT, acc;
+
+  if ((stoptemp==0.0) && (starttemp==0.0)) zeroT=true; else zeroT=false;
+  if (!zeroT) kT=pm->FindStartTemp(gamma, prob, starttemp); else kT=stoptemp;
+  /* assign random initial configuration */
+  pm->assign_initial_conf(-1);
+  runs=0;
+  changes=1;
+
+  while (changes>0 && (kT/stoptemp>1.0 || (zeroT && runs<150))) {
+
+    IGRAPH_I_PARALLEL_ALLOW_INTERRUPTION(interrupted);
+    if (interrupted) { break; }
+    
+    runs++;
+    if (!zeroT) {
+      kT*=coolfact;
+      if (parupdate) { 
+	changes=pm->HeatBathParallelLookup(gamma, prob, kT, 50);
+      } else {
+	acc=pm->HeatBathLookup(gamma, prob, kT, 50);
+	if (acc<(1.0-1.0/double(spins))*0.01) {
+	  changes=0; 
+	} else { 
+	  changes=1;
+	}
+      }
+    } else {
+      if (parupdate) { 
+	changes=pm->HeatBathParallelLookupZeroTemp(gamma, prob, 50);
+      } else {
+	acc=pm->HeatBathLookupZeroTemp(gamma, prob, 50);
+	/* less than 1 percent acceptance ratio */
+	if (acc<(1.0-1.0/double(spins))*0.01) {
+	  changes=0; 
+	} else { 
+	  changes=1;
+	}
+      }
+    }
+  } /* while loop */
+
+  return kT;
+}
+
+/* The same for the implementation with negative weights */
+
+static double igraph_i_spinglass_anneal_negative(PottsModelN *pm,
+						 igraph_integer_t spins,
+						 igraph_real_t starttemp,
+						 igraph_real_t stoptemp,
+						 igraph_real_t coolfact,
+						 igraph_real_t gamma,
+						 igraph_real_t gamma_minus,
+						 bool &interrupted) {
+  unsigned long changes, runs;
+  bool zeroT;
+  double kT, acc;
+
+  if ((stoptemp==0.0) && (starttemp==0.0)) zeroT=true; else zeroT=false;
+
+  //Begin at a high enough temperature
+  kT=pm->FindStartTemp(gamma, gamma_minus, starttemp);
+
+  /* assign random initial configuration */
+  pm->assign_initial_conf(true);
+
+  runs=0;
+  changes=1;
+  acc = 0;
+	while (changes>0 && (kT/stoptemp>1.0 || (zeroT && runs<150))) 
+	{
+		
+		IGRAPH_I_PARALLEL_ALLOW_INTERRUPTION(interrupted);
+		if (interrupted) { break; }
+		
+		runs++;
+		kT = kT*coolfact; 
+		acc=pm->HeatBathLookup(gamma, gamma_minus, kT, 50);
+		if (acc<(1.0-1.0/double(spins))*0.001)
+			changes=0; 
+		else 
+			changes=1;
+		
+	} /* while loop */
+
+  return kT;
+}
+
 int igraph_i_community_spinglass_orig(const igraph_t *graph,
 				      const igraph_vector_t *weights,
 				      igraph_real_t *modularity,
@@ -243,15 +490,14 @@ int igraph_i_community_spinglass_orig(const igraph_t *graph,
 				      igraph_real_t stoptemp,
 				      igraph_real_t coolfact,
 				      igraph_spincomm_update_t update_rule,
-				      igraph_real_t gamma) {
+				      igraph_real_t gamma,
+				      igraph_integer_t replicas) {
 
-  unsigned long changes, runs;
   igraph_bool_t use_weights=0;
-  bool zeroT;
-  double kT, acc, prob;
-  ClusterList<NNode*> *cl_cur;
+  double prob;
   network *net;
-  PottsModel *pm;
+  long int r, best, first;
+  bool interrupted=false;
 
   /* Check arguments */
 
@@ -290,6 +536,7 @@ int igraph_i_community_spinglass_orig(const igraph_t *graph,
   net->node_list   =new DL_Indexed_List<NNode*>();
   net->link_list   =new DL_Indexed_List<NLink*>();
   net->cluster_list=new DL_Indexed_List<ClusterList<NNode*>*>();
+  IGRAPH_FINALLY(igraph_i_spinglass_destroy_network, net);
 
   /* Transform the igraph_t */
   IGRAPH_CHECK(igraph_i_read_network(graph, weights,
@@ -298,68 +545,60 @@ int igraph_i_community_spinglass_orig(const igraph_t *graph,
   prob=2.0*net->sum_weights/double(net->node_list->Size())
     /double(net->node_list->Size()-1);
 
-  pm=new PottsModel(net,(unsigned int)spins,update_rule);
+  /* initialize the random number generators */
+  std::vector<igraph_rng_t> rngs;
+  std::vector<igraph_rng_t*> replica_rng;
+  IGRAPH_FINALLY(igraph_i_spinglass_destroy_rngs, &rngs);
+  IGRAPH_CHECK(igraph_i_spinglass_rngs(&rngs, &replica_rng, replicas));
+
+  /* The models share the network, but not the spin states */
+  std::vector<PottsModel*> pms(replicas, (PottsModel*) 0);
+  IGRAPH_FINALLY(igraph_i_spinglass_destroy_models<PottsModel>, &pms);
+  for (r=0; r<replicas; r++) {
+    pms[r]=new PottsModel(net,(unsigned int)spins,update_rule,
+			  replica_rng[r]);
+  }
+  std::vector<double> kT(replicas), quality(replicas);
+  int nthreads=IGRAPH_I_THREAD_COUNT(replicas);
 
-  /* initialize the random number generator */
   RNG_BEGIN();
-  
-  if ((stoptemp==0.0) && (starttemp==0.0)) zeroT=true; else zeroT=false;
-  if (!zeroT) kT=pm->FindStartTemp(gamma, prob, starttemp); else kT=stoptemp;
-  /* assign random initial configuration */
-  pm->assign_initial_conf(-1);
-  runs=0;
-  changes=1;
 
-  while (changes>0 && (kT/stoptemp>1.0 || (zeroT && runs<150))) {
-
-    IGRAPH_ALLOW_INTERRUPTION(); /* This is not clean.... */
-    
-    runs++;
-    if (!zeroT) {
-      kT*=coolfact;
-      if (parupdate) { 
-	changes=pm->HeatBathParallelLookup(gamma, prob, kT, 50);
-      } else {
-	acc=pm->HeatBathLookup(gamma, prob, kT, 50);
-	if (acc<(1.0-1.0/double(spins))*0.01) {
-	  changes=0; 
-	} else { 
-	  changes=1;
-	}
-      }
-    } else {
-      if (parupdate) { 
-	changes=pm->HeatBathParallelLookupZeroTemp(gamma, prob, 50);
-      } else {
-	acc=pm->HeatBathLookupZeroTemp(gamma, prob, 50);
-	/* less than 1 percent acceptance ratio */
-	if (acc<(1.0-1.0/double(spins))*0.01) {
-	  changes=0; 
-	} else { 
-	  changes=1;
-	}
+  /* One replica per thread at a time, the interruption handler is
+     called between them, and also from the annealing if there is a
+     single thread */
+  for (first=0; first<replicas && !interrupted; first+=nthreads) {
+    long int last= first+nthreads < replicas ? first+nthreads : replicas;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic, 1)
+#endif
+    for (r=first; r<last; r++) {
+      kT[r]=igraph_i_spinglass_anneal_orig(pms[r], prob, spins, parupdate,
+					   starttemp, stoptemp, coolfact,
+					   gamma, interrupted);
+      if (replicas > 1 && !interrupted) {
+	/* the energy of the final state */
+	pms[r]->initialize_Qmatrix();
+	quality[r]=pms[r]->calculate_genQ(gamma);
       }
     }
-  } /* while loop */
-
-  pm->WriteClusters(modularity, temperature, csize, membership, kT, gamma);
+    IGRAPH_I_PARALLEL_ALLOW_INTERRUPTION(interrupted);
+  }
 
-  while (net->link_list->Size()) delete net->link_list->Pop();
-  while (net->node_list->Size()) delete net->node_list->Pop();
-  while (net->cluster_list->Size())
-    {
-      cl_cur=net->cluster_list->Pop();
-      while (cl_cur->Size()) cl_cur->Pop();
-      delete cl_cur;
-    }
-  delete net->link_list;
-  delete net->node_list;
-  delete net->cluster_list;
-  
   RNG_END();
-  
-  delete net;
-  delete pm;
+
+  IGRAPH_I_PARALLEL_INTERRUPTED(interrupted);
+
+  best=0;
+  for (r=1; r<replicas; r++) {
+    if (quality[r] > quality[best]) { best=r; }
+  }
+  pms[best]->WriteClusters(modularity, temperature, csize, membership,
+			   kT[best], gamma);
+
+  igraph_i_spinglass_destroy_models<PottsModel>(&pms);
+  igraph_i_spinglass_destroy_rngs(&rngs);
+  igraph_i_spinglass_destroy_network(net);
+  IGRAPH_FINALLY_CLEAN(3);
 
   return 0;
 }
@@ -438,7 +677,6 @@ int igraph_community_spinglass_single(const igraph_t *graph,
 
   igraph_bool_t use_weights=0;
   double prob;
-  ClusterList<NNode*> *cl_cur;
   network *net;
   PottsModel *pm;
   char startnode[255];
@@ -476,6 +714,7 @@ int igraph_community_spinglass_single(const igraph_t *graph,
   net->node_list   =new DL_Indexed_List<NNode*>();
   net->link_list   =new DL_Indexed_List<NLink*>();
   net->cluster_list=new DL_Indexed_List<ClusterList<NNode*>*>();
+  IGRAPH_FINALLY(igraph_i_spinglass_destroy_network, net);
 
   /* Transform the igraph_t */
   IGRAPH_CHECK(igraph_i_read_network(graph, weights,
@@ -497,22 +736,11 @@ int igraph_community_spinglass_single(const igraph_t *graph,
   pm->FindCommunityFromStart(gamma, prob, startnode, community,
 			     cohesion, adhesion, inner_links, outer_links);
   
-  while (net->link_list->Size()) delete net->link_list->Pop();
-  while (net->node_list->Size()) delete net->node_list->Pop();
-  while (net->cluster_list->Size())
-    {
-      cl_cur=net->cluster_list->Pop();
-      while (cl_cur->Size()) cl_cur->Pop();
-      delete cl_cur;
-    }
-  delete net->link_list;
-  delete net->node_list;
-  delete net->cluster_list;
-  
   RNG_END();
 
-  delete net;
   delete pm;
+  igraph_i_spinglass_destroy_network(net);
+  IGRAPH_FINALLY_CLEAN(1);
 
   return 0;
 }
@@ -533,15 +761,11 @@ int igraph_i_community_spinglass_negative(const igraph_t *graph,
 /* 					  igraph_matrix_t *adhesion, */
 /* 					  igraph_matrix_t *normalised_adhesion, */
 /* 					  igraph_real_t *polarization, */
-					  igraph_real_t gamma_minus) {
+					  igraph_real_t gamma_minus,
+					  igraph_integer_t replicas) {
 
-  unsigned long changes, runs;
   igraph_bool_t use_weights=0;
-  bool zeroT;
-  double kT, acc;
-  ClusterList<NNode*> *cl_cur;
   network *net;
-  PottsModelN *pm;
   igraph_real_t d_n;
   igraph_real_t d_p;
 
@@ -597,66 +821,77 @@ int igraph_i_community_spinglass_negative(const igraph_t *graph,
   net->node_list   =new DL_Indexed_List<NNode*>();
   net->link_list   =new DL_Indexed_List<NLink*>();
   net->cluster_list=new DL_Indexed_List<ClusterList<NNode*>*>();
+  IGRAPH_FINALLY(igraph_i_spinglass_destroy_network, net);
 
   /* Transform the igraph_t */
   IGRAPH_CHECK(igraph_i_read_network(graph, weights,
 				     net, use_weights, 0));
 	
   bool directed = igraph_is_directed(graph);
-  
-  pm=new PottsModelN(net,(unsigned int)spins, directed);
+  long int r, best, first;
+  bool interrupted=false;
+
+  /* initialize the random number generators */
+  std::vector<igraph_rng_t> rngs;
+  std::vector<igraph_rng_t*> replica_rng;
+  IGRAPH_FINALLY(igraph_i_spinglass_destroy_rngs, &rngs);
+  IGRAPH_CHECK(igraph_i_spinglass_rngs(&rngs, &replica_rng, replicas));
+
+  std::vector<PottsModelN*> pms(replicas, (PottsModelN*) 0);
+  IGRAPH_FINALLY(igraph_i_spinglass_destroy_models<PottsModelN>, &pms);
+  for (r=0; r<replicas; r++) {
+    pms[r]=new PottsModelN(net,(unsigned int)spins, directed,
+			   replica_rng[r]);
+  }
+  std::vector<double> kT(replicas);
+  int nthreads=IGRAPH_I_THREAD_COUNT(replicas);
 
-  /* initialize the random number generator */
   RNG_BEGIN();
-  
-  if ((stoptemp==0.0) && (starttemp==0.0)) zeroT=true; else zeroT=false;
 
-  //Begin at a high enough temperature
-  kT=pm->FindStartTemp(gamma, gamma_minus, starttemp);
+  /* One replica per thread at a time, see above */
+  for (first=0; first<replicas && !interrupted; first+=nthreads) {
+    long int last= first+nthreads < replicas ? first+nthreads : replicas;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic, 1)
+#endif
+    for (r=first; r<last; r++) {
+      kT[r]=igraph_i_spinglass_anneal_negative(pms[r], spins, starttemp,
+					       stoptemp, coolfact, gamma,
+					       gamma_minus, interrupted);
+    }
+    IGRAPH_I_PARALLEL_ALLOW_INTERRUPTION(interrupted);
+  }
 
-  /* assign random initial configuration */
-  pm->assign_initial_conf(true);
+  RNG_END();
 
-  runs=0;
-  changes=1;
-  acc = 0;
-	while (changes>0 && (kT/stoptemp>1.0 || (zeroT && runs<150))) 
-	{
-		
-		IGRAPH_ALLOW_INTERRUPTION(); /* This is not clean.... */
-		
-		runs++;
-		kT = kT*coolfact; 
-		acc=pm->HeatBathLookup(gamma, gamma_minus, kT, 50);
-		if (acc<(1.0-1.0/double(spins))*0.001)
-			changes=0; 
-		else 
-			changes=1;
-		
-	} /* while loop */
+  IGRAPH_I_PARALLEL_INTERRUPTED(interrupted);
 
   /* These are needed, otherwise 'modularity' is not calculated */
   igraph_matrix_t adhesion, normalized_adhesion;
   igraph_real_t polarization;
   IGRAPH_MATRIX_INIT_FINALLY(&adhesion, 0, 0);
   IGRAPH_MATRIX_INIT_FINALLY(&normalized_adhesion, 0, 0);
-  pm->WriteClusters(modularity, temperature, csize, membership, 
-		    &adhesion, &normalized_adhesion, &polarization, 
-		    kT, d_p, d_n, gamma, gamma_minus);
+  best=0;
+  if (replicas > 1) {
+    igraph_real_t q, best_q=0;
+    for (r=0; r<replicas; r++) {
+      pms[r]->WriteClusters(&q, 0, 0, 0, &adhesion, &normalized_adhesion,
+			    &polarization, kT[r], d_p, d_n, gamma,
+			    gamma_minus);
+      if (r == 0 || q > best_q) { best=r; best_q=q; }
+    }
+  }
+  pms[best]->WriteClusters(modularity, temperature, csize, membership, 
+			   &adhesion, &normalized_adhesion, &polarization, 
+			   kT[best], d_p, d_n, gamma, gamma_minus);
   igraph_matrix_destroy(&normalized_adhesion);
   igraph_matrix_destroy(&adhesion);
   IGRAPH_FINALLY_CLEAN(2);
 
-  while (net->link_list->Size()) delete net->link_list->Pop();
-  while (net->node_list->Size()) delete net->node_list->Pop();
-  while (net->cluster_list->Size())
-    {
-      cl_cur=net->cluster_list->Pop();
-      while (cl_cur->Size()) cl_cur->Pop();
-      delete cl_cur;
-    }
-  
-  RNG_END();
+  igraph_i_spinglass_destroy_models<PottsModelN>(&pms);
+  igraph_i_spinglass_destroy_rngs(&rngs);
+  igraph_i_spinglass_destroy_network(net);
+  IGRAPH_FINALLY_CLEAN(3);
 
   return 0;
 }
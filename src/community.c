@@ -40,6 +40,8 @@
 #include "igraph_types_internal.h"
 #include "igraph_conversion.h"
 #include "igraph_centrality.h"
+#include "igraph_parallel_internal.h"
+#include "igraph_community_internal.h"
 #include "config.h"
 
 #include <string.h>
@@ -287,7 +289,12 @@ int igraph_community_eb_get_merges(const igraph_t *graph,
   return 0;
 }
 
-/* Find the smallest active element in the vector */
+/* Find the largest active element in the vector. Elements that are
+   equal up to rounding errors count as equal, and the first one of
+   them is chosen: the edge betweenness scores are sums of many terms,
+   and their last bits depend on the order of summation. */
+#define IGRAPH_I_EB_COMMUNITY_EPS 1e-10
+
 long int igraph_i_vector_which_max_not_null(const igraph_vector_t *v, 
 					    const char *passive) {
   long int which, i=0, size=igraph_vector_size(v);
@@ -299,7 +306,7 @@ long int igraph_i_vector_which_max_not_null(const igraph_vector_t *v,
   max=VECTOR(*v)[which];
   for (i++; i<size; i++) {
     igraph_real_t elem=VECTOR(*v)[i];
-    if (!passive[i] && elem > max) {
+    if (!passive[i] && elem > max + fabs(max) * IGRAPH_I_EB_COMMUNITY_EPS) {
       max=elem;
       which=i;
     }
@@ -308,6 +315,541 @@ long int igraph_i_vector_which_max_not_null(const igraph_vector_t *v,
   return which;
 }
 
+/*
+ * After an edge is removed, the edge betweenness scores are updated
+ * incrementally. The removal only changes the shortest paths from the
+ * sources whose shortest path DAG contains the edge: for an edge from
+ * u to v these are the sources s with d(s,u)+w(u,v) == d(s,v), and
+ * for undirected graphs also the ones with d(s,v)+w(u,v) == d(s,u).
+ * Two searches along the reversed edges, from u and from v, give
+ * these distances. For each affected source its contribution is
+ * subtracted, computed on the graph before the removal, and its new
+ * contribution is added, computed after the removal. The scores are
+ * thus sums of many terms of both signs; the rounding errors are
+ * tolerated by the tie rule of igraph_i_vector_which_max_not_null().
+ *
+ * If at least half of the sources in the weakly connected component
+ * of the edge are affected, which is typical for the edge with the
+ * largest score of an undirected graph, then recalculating the
+ * component is cheaper, and it is done instead. Shortest paths never
+ * leave a component, so the scores of the other components do not
+ * change in either case.
+ *
+ * The sources are split into consecutive blocks; every block
+ * sums its dependencies into its own score vector and the block
+ * scores are added up in block order. The blocks are processed by the
+ * OpenMP threads (if any). The number of blocks depends only on the
+ * number of sources, so the result does not depend on the number of
+ * threads. Every thread has its own work area, allocated in
+ * advance, see igraph_parallel_internal.h.
+ */
+
+#define IGRAPH_I_EB_COMMUNITY_BLOCKS 16
+
+typedef struct igraph_i_eb_community_thread_t {
+  double *distance;		/* BFS: distance, Dijkstra: distance+1 */
+  unsigned long long int *nrgeo; /* number of shortest paths */
+  double *tmpscore;
+  long int *order;		/* vertices in the order they were reached */
+  long int *nfathers;		/* Dijkstra: number of shortest path */
+  long int *fathers;		/*   edges into a vertex, and the edges */
+  igraph_2wheap_t heap;
+  igraph_bool_t heap_init;
+} igraph_i_eb_community_thread_t;
+
+typedef struct igraph_i_eb_community_work_t {
+  int nthreads;
+  long int nblocks;
+  igraph_real_t *blockscore;	/* 'nblocks' score vectors, one after */
+				/*   the other */
+  long int *fstart;		/* Dijkstra: where the fathers of a vertex */
+				/*   start in 'fathers' */
+  double *dist_from, *dist_to;	/* distances to the ends of the removed */
+				/*   edge, -1 if not reached */
+  igraph_i_eb_community_thread_t *threads;
+} igraph_i_eb_community_work_t;
+
+static void igraph_i_eb_community_work_destroy(igraph_i_eb_community_work_t *work) {
+  int i;
+  if (work->threads) {
+    for (i=0; i<work->nthreads; i++) {
+      igraph_i_eb_community_thread_t *t=&work->threads[i];
+      if (t->distance) { igraph_Free(t->distance); }
+      if (t->nrgeo) { igraph_Free(t->nrgeo); }
+      if (t->tmpscore) { igraph_Free(t->tmpscore); }
+      if (t->order) { igraph_Free(t->order); }
+      if (t->nfathers) { igraph_Free(t->nfathers); }
+      if (t->fathers) { igraph_Free(t->fathers); }
+      if (t->heap_init) { igraph_2wheap_destroy(&t->heap); }
+    }
+    igraph_Free(work->threads);
+  }
+  if (work->blockscore) { igraph_Free(work->blockscore); }
+  if (work->fstart) { igraph_Free(work->fstart); }
+  if (work->dist_from) { igraph_Free(work->dist_from); }
+  if (work->dist_to) { igraph_Free(work->dist_to); }
+}
+
+/*
+ * 'elist_in_p' is the initial incidence list of the incoming edges,
+ * the fathers of a vertex are a subset of these. It is only used in
+ * the weighted case.
+ */
+
+static int igraph_i_eb_community_work_init(igraph_i_eb_community_work_t *work,
+					   const igraph_t *graph,
+					   igraph_inclist_t *elist_in_p,
+					   igraph_bool_t weighted) {
+  long int no_of_nodes=igraph_vcount(graph);
+  long int no_of_edges=igraph_ecount(graph);
+  long int alloc_nodes= no_of_nodes > 0 ? no_of_nodes : 1;
+  long int no_of_fathers=1;
+  long int i;
+
+  work->nblocks= no_of_nodes < IGRAPH_I_EB_COMMUNITY_BLOCKS ? 
+    (no_of_nodes > 0 ? no_of_nodes : 1) : IGRAPH_I_EB_COMMUNITY_BLOCKS;
+  work->nthreads=IGRAPH_I_THREAD_COUNT(work->nblocks);
+  work->blockscore=0;
+  work->fstart=0;
+  work->dist_from=work->dist_to=0;
+  work->threads=igraph_Calloc(work->nthreads, igraph_i_eb_community_thread_t);
+  if (!work->threads) {
+    IGRAPH_ERROR("edge betweenness community structure failed", 
+		 IGRAPH_ENOMEM);
+  }
+  IGRAPH_FINALLY(igraph_i_eb_community_work_destroy, work);
+
+  work->blockscore=igraph_Calloc(work->nblocks * 
+				 (no_of_edges > 0 ? no_of_edges : 1),
+				 igraph_real_t);
+  if (!work->blockscore) {
+    IGRAPH_ERROR("edge betweenness community structure failed", 
+		 IGRAPH_ENOMEM);
+  }
+
+  work->dist_from=igraph_Calloc(alloc_nodes, double);
+  work->dist_to=igraph_Calloc(alloc_nodes, double);
+  if (!work->dist_from || !work->dist_to) {
+    IGRAPH_ERROR("edge betweenness community structure failed", 
+		 IGRAPH_ENOMEM);
+  }
+  for (i=0; i<no_of_nodes; i++) {
+    work->dist_from[i] = work->dist_to[i] = -1;
+  }
+
+  if (weighted) {
+    work->fstart=igraph_Calloc(no_of_nodes+1, long int);
+    if (!work->fstart) {
+      IGRAPH_ERROR("edge betweenness community structure failed", 
+		   IGRAPH_ENOMEM);
+    }
+    for (i=0; i<no_of_nodes; i++) {
+      work->fstart[i+1] = work->fstart[i] + 
+	igraph_vector_int_size(igraph_inclist_get(elist_in_p, i));
+    }
+    if (work->fstart[no_of_nodes] > 0) {
+      no_of_fathers=work->fstart[no_of_nodes];
+    }
+  }
+
+  for (i=0; i<work->nthreads; i++) {
+    igraph_i_eb_community_thread_t *t=&work->threads[i];
+    t->distance=igraph_Calloc(alloc_nodes, double);
+    t->nrgeo=igraph_Calloc(alloc_nodes, unsigned long long int);
+    t->tmpscore=igraph_Calloc(alloc_nodes, double);
+    t->order=igraph_Calloc(alloc_nodes, long int);
+    if (!t->distance || !t->nrgeo || !t->tmpscore || !t->order) {
+      IGRAPH_ERROR("edge betweenness community structure failed", 
+		   IGRAPH_ENOMEM);
+    }
+    if (weighted) {
+      t->nfathers=igraph_Calloc(alloc_nodes, long int);
+      t->fathers=igraph_Calloc(no_of_fathers, long int);
+      if (!t->nfathers || !t->fathers) {
+	IGRAPH_ERROR("edge betweenness community structure failed", 
+		     IGRAPH_ENOMEM);
+      }
+      IGRAPH_CHECK(igraph_2wheap_init(&t->heap, no_of_nodes));
+      t->heap_init=1;
+      /* Every vertex enters the heap at most once, make sure that
+	 the heap never needs to grow during the search */
+      IGRAPH_CHECK(igraph_vector_reserve(&t->heap.data, no_of_nodes));
+      IGRAPH_CHECK(igraph_vector_long_reserve(&t->heap.index, no_of_nodes));
+    }
+  }
+
+  IGRAPH_FINALLY_CLEAN(1);
+  return 0;
+}
+
+/* Unweighted edge betweenness, from a single source, multiplied by
+   'sign' and added to 'score'. The work area is left clean. */
+
+static void igraph_i_eb_community_bfs(const igraph_t *graph,
+				      igraph_inclist_t *elist_out_p,
+				      igraph_inclist_t *elist_in_p,
+				      long int source,
+				      igraph_i_eb_community_thread_t *t,
+				      igraph_real_t sign,
+				      igraph_real_t *score) {
+  double *distance=t->distance, *tmpscore=t->tmpscore;
+  unsigned long long int *nrgeo=t->nrgeo;
+  long int *order=t->order;
+  long int head=0, nreached=0, i, neino;
+  igraph_vector_int_t *neip;
+
+  order[nreached++]=source;
+  nrgeo[source]=1;
+  distance[source]=0;
+
+  while (head < nreached) {
+    long int actnode=order[head++];
+    
+    neip=igraph_inclist_get(elist_out_p, actnode);
+    neino=igraph_vector_int_size(neip);
+    for (i=0; i<neino; i++) {
+      long int edge=(long int) VECTOR(*neip)[i];
+      long int neighbor=IGRAPH_OTHER(graph, edge, actnode);
+      if (nrgeo[neighbor] != 0) {
+	/* we've already seen this node, another shortest path? */
+	if (distance[neighbor]==distance[actnode]+1) {
+	  nrgeo[neighbor]+=nrgeo[actnode];
+	}
+      } else {
+	/* we haven't seen this node yet */
+	nrgeo[neighbor]+=nrgeo[actnode];
+	distance[neighbor]=distance[actnode]+1;
+	order[nreached++]=neighbor;
+      }
+    }
+  }
+
+  /* Ok, we've the distance of each node and also the number of
+     shortest paths to them. Now we do an inverse search, starting
+     with the farthest nodes. The source is the first one reached. */
+  while (nreached > 1) {
+    long int actnode=order[--nreached];
+    
+    /* set the temporary score of the friends */
+    neip=igraph_inclist_get(elist_in_p, actnode);
+    neino=igraph_vector_int_size(neip);
+    for (i=0; i<neino; i++) {
+      long int edge = (long int) VECTOR(*neip)[i];
+      long int neighbor = IGRAPH_OTHER(graph, edge, actnode);
+      if (distance[neighbor]==distance[actnode]-1 &&
+	  nrgeo[neighbor] != 0) {
+	tmpscore[neighbor] +=
+	  (tmpscore[actnode]+1)*nrgeo[neighbor]/nrgeo[actnode];
+	score[edge] += sign *
+	  (tmpscore[actnode]+1)*nrgeo[neighbor]/nrgeo[actnode];
+      }
+    }
+
+    distance[actnode]=0;
+    nrgeo[actnode]=0;
+    tmpscore[actnode]=0;
+  }
+
+  distance[source]=0;
+  nrgeo[source]=0;
+  tmpscore[source]=0;
+}
+
+/* Weighted edge betweenness, from a single source, multiplied by
+   'sign' and added to 'score'. The work area is left clean. */
+
+static void igraph_i_eb_community_dijkstra(const igraph_t *graph,
+					   igraph_inclist_t *elist_out_p,
+					   const igraph_vector_t *weights,
+					   const long int *fstart,
+					   long int source,
+					   igraph_i_eb_community_thread_t *t,
+					   igraph_real_t sign,
+					   igraph_real_t *score) {
+  double *distance=t->distance, *tmpscore=t->tmpscore;
+  unsigned long long int *nrgeo=t->nrgeo;
+  long int *order=t->order, *nfathers=t->nfathers, *fathers=t->fathers;
+  igraph_2wheap_t *heap=&t->heap;
+  long int nreached=0, i, neino;
+  igraph_vector_int_t *neip;
+
+  igraph_2wheap_push_with_index(heap, source, 0);
+  distance[source]=1.0;
+  nrgeo[source]=1;
+
+  while (!igraph_2wheap_empty(heap)) {
+    long int minnei = igraph_2wheap_max_index(heap);
+    igraph_real_t mindist = -igraph_2wheap_delete_max(heap);
+
+    order[nreached++]=minnei;
+
+    neip=igraph_inclist_get(elist_out_p, minnei);
+    neino=igraph_vector_int_size(neip);
+
+    for (i=0; i<neino; i++) {
+      long int edge=VECTOR(*neip)[i];
+      long int to=IGRAPH_OTHER(graph, edge, minnei);
+      igraph_real_t altdist = mindist + VECTOR(*weights)[edge];
+      igraph_real_t curdist = distance[to];
+
+      if (curdist == 0) {
+	/* This is the first finite distance to 'to' */
+	nfathers[to] = 1;
+	fathers[fstart[to]] = edge;
+	nrgeo[to] = nrgeo[minnei];
+	distance[to] = altdist + 1.0;
+	igraph_2wheap_push_with_index(heap, to, -altdist);
+      } else if (altdist < curdist-1) {
+	/* This is a shorter path */
+	nfathers[to] = 1;
+	fathers[fstart[to]] = edge;
+	nrgeo[to] = nrgeo[minnei];
+	distance[to] = altdist + 1.0;
+	igraph_2wheap_modify(heap, to, -altdist);
+      } else if (altdist == curdist-1) {
+	/* Another path with the same length */
+	fathers[fstart[to] + nfathers[to]] = edge;
+	nfathers[to] += 1;
+	nrgeo[to] += nrgeo[minnei];
+      }
+    }
+  }
+
+  while (nreached > 0) {
+    long int w = order[--nreached];
+    long int *fatv = fathers + fstart[w];
+
+    for (i = 0; i < nfathers[w]; i++) {
+      long int fedge = fatv[i];
+      long int neighbor = IGRAPH_OTHER(graph, fedge, w);
+      tmpscore[neighbor] += (tmpscore[w] + 1) * nrgeo[neighbor] / nrgeo[w];
+      score[fedge] += sign * (tmpscore[w] + 1) * nrgeo[neighbor] / nrgeo[w];
+    }
+
+    tmpscore[w] = 0;
+    distance[w] = 0;
+    nrgeo[w] = 0;
+    nfathers[w] = 0;
+  }
+}
+
+/* The distances from all vertices to 'target', along the edges in
+   'elist_in_p', are stored in 'dist', which must be -1 for all
+   vertices on entry. The vertices that reach 'target' are stored in
+   'reached'. The heap is only used if there are weights. */
+
+static int igraph_i_eb_community_dist_to(const igraph_t *graph,
+					 igraph_inclist_t *elist_in_p,
+					 const igraph_vector_t *weights,
+					 long int target,
+					 igraph_2wheap_t *heap,
+					 double *dist,
+					 igraph_vector_long_t *reached) {
+  long int head=0, i, neino;
+  igraph_vector_int_t *neip;
+
+  igraph_vector_long_clear(reached);
+  dist[target]=0;
+
+  if (weights == 0) {
+    IGRAPH_CHECK(igraph_vector_long_push_back(reached, target));
+    while (head < igraph_vector_long_size(reached)) {
+      long int actnode=VECTOR(*reached)[head++];
+      neip=igraph_inclist_get(elist_in_p, actnode);
+      neino=igraph_vector_int_size(neip);
+      for (i=0; i<neino; i++) {
+	long int neighbor=IGRAPH_OTHER(graph, VECTOR(*neip)[i], actnode);
+	if (dist[neighbor] < 0) {
+	  dist[neighbor]=dist[actnode]+1;
+	  IGRAPH_CHECK(igraph_vector_long_push_back(reached, neighbor));
+	}
+      }
+    }
+  } else {
+    IGRAPH_CHECK(igraph_2wheap_push_with_index(heap, target, 0));
+    while (!igraph_2wheap_empty(heap)) {
+      long int minnei=igraph_2wheap_max_index(heap);
+      igraph_real_t mindist=-igraph_2wheap_delete_max(heap);
+      IGRAPH_CHECK(igraph_vector_long_push_back(reached, minnei));
+      neip=igraph_inclist_get(elist_in_p, minnei);
+      neino=igraph_vector_int_size(neip);
+      for (i=0; i<neino; i++) {
+	long int edge=VECTOR(*neip)[i];
+	long int neighbor=IGRAPH_OTHER(graph, edge, minnei);
+	igraph_real_t altdist=mindist + VECTOR(*weights)[edge];
+	if (dist[neighbor] < 0) {
+	  dist[neighbor]=altdist;
+	  IGRAPH_CHECK(igraph_2wheap_push_with_index(heap, neighbor,
+						     -altdist));
+	} else if (altdist < dist[neighbor]) {
+	  /* 'neighbor' is still in the heap, the weights are positive */
+	  dist[neighbor]=altdist;
+	  igraph_2wheap_modify(heap, neighbor, -altdist);
+	}
+      }
+    }
+  }
+
+  return 0;
+}
+
+/* Find the sources whose shortest path DAG contains the edge from
+   'from' to 'to', or the edge in any direction if 'undirected' is
+   true, and store them in 'sources', in increasing order. Distances
+   computed by different searches may differ in their last bits, so
+   with weights a source is also affected if its distances are equal
+   up to rounding errors; a few extra sources only cost time. */
+
+static int igraph_i_eb_community_affected(const igraph_t *graph,
+					  igraph_inclist_t *elist_in_p,
+					  const igraph_vector_t *weights,
+					  igraph_i_eb_community_work_t *work,
+					  long int edge, igraph_bool_t undirected,
+					  igraph_vector_long_t *reached_to,
+					  igraph_vector_long_t *sources) {
+  long int from=IGRAPH_FROM(graph, edge), to=IGRAPH_TO(graph, edge);
+  igraph_real_t w= weights ? VECTOR(*weights)[edge] : 1.0;
+  igraph_real_t eps= weights ? IGRAPH_I_EB_COMMUNITY_EPS : 0.0;
+  igraph_2wheap_t *heap= weights ? &work->threads[0].heap : 0;
+  double *dfrom=work->dist_from, *dto=work->dist_to;
+  long int i, n;
+
+  IGRAPH_CHECK(igraph_i_eb_community_dist_to(graph, elist_in_p, weights,
+					     from, heap, dfrom, sources));
+  IGRAPH_CHECK(igraph_i_eb_community_dist_to(graph, elist_in_p, weights,
+					     to, heap, dto, reached_to));
+
+  /* The affected sources reach 'from', they are kept in 'sources' */
+  n=igraph_vector_long_size(sources);
+  for (i=0; i<n; ) {
+    long int s=VECTOR(*sources)[i];
+    igraph_real_t df=dfrom[s], dt=dto[s];
+    dfrom[s]=-1;
+    if (dt >= 0 &&
+	(fabs(df + w - dt) <= eps * (df + w) ||
+	 (undirected && fabs(dt + w - df) <= eps * (dt + w)))) {
+      i++;
+    } else {
+      VECTOR(*sources)[i]=VECTOR(*sources)[--n];
+    }
+  }
+  for (i=0; i<igraph_vector_long_size(reached_to); i++) {
+    dto[VECTOR(*reached_to)[i]] = -1;
+  }
+  IGRAPH_CHECK(igraph_vector_long_resize(sources, n));
+  igraph_vector_long_sort(sources);
+
+  return 0;
+}
+
+/* Add the edge betweenness of 'sources', multiplied by 'sign', to
+   the block scores, in parallel. */
+
+static void igraph_i_eb_community_sources(const igraph_t *graph,
+					  igraph_inclist_t *elist_out_p,
+					  igraph_inclist_t *elist_in_p,
+					  const igraph_vector_t *weights,
+					  igraph_i_eb_community_work_t *work,
+					  const igraph_vector_long_t *sources,
+					  igraph_real_t sign) {
+  long int no_of_edges=igraph_ecount(graph);
+  long int nsources=igraph_vector_long_size(sources);
+  long int nblocks= nsources < work->nblocks ? nsources : work->nblocks;
+  long int b;
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(IGRAPH_I_THREAD_COUNT(nblocks)) schedule(dynamic, 1)
+#endif
+  for (b=0; b<nblocks; b++) {
+    igraph_i_eb_community_thread_t *t=&work->threads[IGRAPH_I_THREAD_NUM()];
+    igraph_real_t *score=work->blockscore + b * no_of_edges;
+    long int k, kend=(b+1) * nsources / nblocks;
+    for (k=b * nsources / nblocks; k<kend; k++) {
+      long int source=VECTOR(*sources)[k];
+      if (weights == 0) {
+	igraph_i_eb_community_bfs(graph, elist_out_p, elist_in_p, source,
+				  t, sign, score);
+      } else {
+	igraph_i_eb_community_dijkstra(graph, elist_out_p, weights,
+				       work->fstart, source, t, sign, score);
+      }
+    }
+  }
+}
+
+/* Add the block scores of the edges of the vertices in 'comp' to
+   'eb', in block order, and clear them. If 'reset' is true, then the
+   block scores replace the old scores. */
+
+static void igraph_i_eb_community_sum(const igraph_t *graph,
+				      igraph_inclist_t *elist_out_p,
+				      igraph_i_eb_community_work_t *work,
+				      const igraph_vector_long_t *comp,
+				      long int nblocks,
+				      igraph_bool_t reset,
+				      igraph_vector_t *eb) {
+  long int no_of_edges=igraph_ecount(graph);
+  long int i, j, b, ncomp=igraph_vector_long_size(comp);
+
+  for (i=0; i<ncomp; i++) {
+    long int v=VECTOR(*comp)[i];
+    igraph_vector_int_t *neip=igraph_inclist_get(elist_out_p, v);
+    long int neino=igraph_vector_int_size(neip);
+    for (j=0; j<neino; j++) {
+      long int edge=VECTOR(*neip)[j];
+      if (IGRAPH_FROM(graph, edge) != v) { continue; }
+      if (reset) { VECTOR(*eb)[edge]=0; }
+      for (b=0; b<nblocks; b++) {
+	VECTOR(*eb)[edge] += work->blockscore[b * no_of_edges + edge];
+	work->blockscore[b * no_of_edges + edge]=0;
+      }
+    }
+  }
+}
+
+/* Collect the vertices of the weakly connected component of 'root'
+   into 'comp', unless it was already collected in this round, as
+   indicated by 'mark'. */
+
+static int igraph_i_eb_community_component(const igraph_t *graph,
+					   igraph_inclist_t *elist_out_p,
+					   igraph_inclist_t *elist_in_p,
+					   long int *mark, long int round,
+					   long int root,
+					   igraph_vector_long_t *comp) {
+  long int head=igraph_vector_long_size(comp), i, neino;
+  igraph_vector_int_t *neip;
+
+  if (mark[root] == round) { return 0; }
+  mark[root]=round;
+  IGRAPH_CHECK(igraph_vector_long_push_back(comp, root));
+
+  while (head < igraph_vector_long_size(comp)) {
+    long int actnode=VECTOR(*comp)[head++];
+    neip=igraph_inclist_get(elist_out_p, actnode);
+    neino=igraph_vector_int_size(neip);
+    for (i=0; i<neino; i++) {
+      long int neighbor=IGRAPH_OTHER(graph, VECTOR(*neip)[i], actnode);
+      if (mark[neighbor] != round) {
+	mark[neighbor]=round;
+	IGRAPH_CHECK(igraph_vector_long_push_back(comp, neighbor));
+      }
+    }
+    if (elist_in_p == elist_out_p) { continue; }
+    neip=igraph_inclist_get(elist_in_p, actnode);
+    neino=igraph_vector_int_size(neip);
+    for (i=0; i<neino; i++) {
+      long int neighbor=IGRAPH_OTHER(graph, VECTOR(*neip)[i], actnode);
+      if (mark[neighbor] != round) {
+	mark[neighbor]=round;
+	IGRAPH_CHECK(igraph_vector_long_push_back(comp, neighbor));
+      }
+    }
+  }
+
+  return 0;
+}
+
 /**
  * \function igraph_community_edge_betweenness
  * \brief Community finding based on edge betweenness
@@ -364,8 +906,23 @@ long int igraph_i_vector_which_max_not_null(const igraph_vector_t *v,
  * \sa \ref igraph_community_eb_get_merges(), \ref
  * igraph_community_spinglass(), \ref igraph_community_walktrap().
  * 
+ * </para><para>
+ * After an edge removal the edge betweenness scores are updated
+ * incrementally: only the sources whose shortest paths used the
+ * removed edge are searched again, their old contributions are
+ * subtracted and the new ones are added. If there are many such
+ * sources, then the scores of the weakly connected component that
+ * contained the removed edge are recalculated instead; the scores of
+ * the other components do not change. The shortest path searches from
+ * the different sources run in parallel if igraph was compiled with
+ * OpenMP support; the result does not depend on the number of
+ * threads.
+ * 
  * Time complexity: O(|V||E|^2), as the betweenness calculation requires
- * O(|V||E|) and we do it |E|-1 times.
+ * O(|V||E|) and we do it |E|-1 times. A step costs at most
+ * O(|V_c||E_c|), where V_c and E_c are the vertices and edges of the
+ * component of the removed edge, and O(|A||E_c|) if only the A
+ * affected sources are searched again.
  * 
  * \example examples/simple/igraph_community_edge_betweenness.c
  */
@@ -382,11 +939,9 @@ int igraph_community_edge_betweenness(const igraph_t *graph,
   
   long int no_of_nodes=igraph_vcount(graph);
   long int no_of_edges=igraph_ecount(graph);
-  double *distance, *tmpscore;
-  unsigned long long int *nrgeo;
-  long int source, i, e;
+  long int e;
   
-  igraph_inclist_t elist_out, elist_in, fathers;
+  igraph_inclist_t elist_out, elist_in;
   igraph_inclist_t *elist_out_p, *elist_in_p;
   igraph_vector_int_t *neip;
   long int neino;
@@ -394,17 +949,14 @@ int igraph_community_edge_betweenness(const igraph_t *graph,
   long int maxedge, pos;
   igraph_integer_t from, to;
   igraph_bool_t result_owned = 0;
-  igraph_stack_t stack=IGRAPH_STACK_NULL;
   igraph_real_t steps, steps_done;
+  igraph_i_eb_community_work_t work;
+  igraph_vector_long_t sources, reached, comp;
+  long int *mark, nblocks;
+  igraph_bool_t incremental;
 
   char *passive;
 
-  /* Needed only for the unweighted case */
-  igraph_dqueue_t q=IGRAPH_DQUEUE_NULL;
-
-  /* Needed only for the weighted case */
-  igraph_2wheap_t heap;
-
   if (result == 0) {
     result = igraph_Calloc(1, igraph_vector_t);
     if (result == 0)
@@ -428,37 +980,30 @@ int igraph_community_edge_betweenness(const igraph_t *graph,
     elist_out_p=elist_in_p=&elist_out;
   }
   
-  distance=igraph_Calloc(no_of_nodes, double);
-  if (distance==0) {
-    IGRAPH_ERROR("edge betweenness community structure failed", IGRAPH_ENOMEM);
-  }
-  IGRAPH_FINALLY(igraph_free, distance);
-  nrgeo=igraph_Calloc(no_of_nodes, unsigned long long int);
-  if (nrgeo==0) {
-    IGRAPH_ERROR("edge betweenness community structure failed", IGRAPH_ENOMEM);
-  }
-  IGRAPH_FINALLY(igraph_free, nrgeo);
-  tmpscore=igraph_Calloc(no_of_nodes, double);
-  if (tmpscore==0) {
-    IGRAPH_ERROR("edge betweenness community structure failed", IGRAPH_ENOMEM);
-  }
-  IGRAPH_FINALLY(igraph_free, tmpscore);
-
-  if (weights == 0) {
-    IGRAPH_DQUEUE_INIT_FINALLY(&q, 100);
-  } else {
+  if (weights != 0) {
     if (igraph_vector_min(weights) <= 0) {
       IGRAPH_ERROR("weights must be strictly positive", IGRAPH_EINVAL);
     }
-    IGRAPH_CHECK(igraph_2wheap_init(&heap, no_of_nodes));
-    IGRAPH_FINALLY(igraph_2wheap_destroy, &heap);
-    IGRAPH_CHECK(igraph_inclist_init_empty(&fathers, 
-					   (igraph_integer_t) no_of_nodes));
-    IGRAPH_FINALLY(igraph_inclist_destroy, &fathers);
   }
 
-  IGRAPH_CHECK(igraph_stack_init(&stack, no_of_nodes));
-  IGRAPH_FINALLY(igraph_stack_destroy, &stack);
+  IGRAPH_CHECK(igraph_i_eb_community_work_init(&work, graph, elist_in_p,
+					       weights != 0));
+  IGRAPH_FINALLY(igraph_i_eb_community_work_destroy, &work);
+
+  /* The sources of the next update, all vertices at first */
+  IGRAPH_CHECK(igraph_vector_long_init_seq(&sources, 0, no_of_nodes-1));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &sources);
+  IGRAPH_CHECK(igraph_vector_long_reserve(&sources, no_of_nodes));
+  IGRAPH_CHECK(igraph_vector_long_init_seq(&comp, 0, no_of_nodes-1));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &comp);
+  IGRAPH_CHECK(igraph_vector_long_reserve(&comp, no_of_nodes));
+  IGRAPH_VECTOR_LONG_INIT_FINALLY(&reached, 0);
+  IGRAPH_CHECK(igraph_vector_long_reserve(&reached, no_of_nodes));
+  mark=igraph_Calloc(no_of_nodes > 0 ? no_of_nodes : 1, long int);
+  if (mark==0) {
+    IGRAPH_ERROR("edge betweenness community structure failed", IGRAPH_ENOMEM);
+  }
+  IGRAPH_FINALLY(igraph_free, mark);
   
   IGRAPH_CHECK(igraph_vector_resize(result, no_of_edges));
   if (edge_betweenness) {
@@ -483,158 +1028,21 @@ int igraph_community_edge_betweenness(const igraph_t *graph,
   steps = no_of_edges / 2.0 * (no_of_edges+1);
   steps_done = 0;
 
+  /* The scores of the whole graph */
+  if (no_of_edges > 0) {
+    igraph_i_eb_community_sources(graph, elist_out_p, elist_in_p, weights,
+				  &work, &sources, 1.0);
+    IGRAPH_ALLOW_INTERRUPTION();
+    nblocks= no_of_nodes < work.nblocks ? no_of_nodes : work.nblocks;
+    igraph_i_eb_community_sum(graph, elist_out_p, &work, &comp, nblocks,
+			      /*reset=*/ 1, &eb);
+  }
+
   for (e=0; e<no_of_edges; steps_done += no_of_edges-e, e++) {
+
     IGRAPH_PROGRESS("Edge betweenness community detection: ",
         100.0*steps_done/steps, NULL);
 
-    igraph_vector_null(&eb);
-
-    if (weights == 0) {
-      /* Unweighted variant follows */
-
-      /* The following for loop is copied almost intact from
-       * igraph_edge_betweenness_estimate */
-      for (source=0; source<no_of_nodes; source++) {
-
-        IGRAPH_ALLOW_INTERRUPTION();
-
-        memset(distance, 0, (size_t) no_of_nodes*sizeof(double));
-        memset(nrgeo, 0, (size_t) no_of_nodes*sizeof(unsigned long long int));
-        memset(tmpscore, 0, (size_t) no_of_nodes*sizeof(double));
-        igraph_stack_clear(&stack); /* it should be empty anyway... */
-        
-        IGRAPH_CHECK(igraph_dqueue_push(&q, source));
-        
-        nrgeo[source]=1;
-        distance[source]=0;
-        
-        while (!igraph_dqueue_empty(&q)) {
-          long int actnode=(long int) igraph_dqueue_pop(&q);
-          
-          neip=igraph_inclist_get(elist_out_p, actnode);
-          neino=igraph_vector_int_size(neip);
-          for (i=0; i<neino; i++) {
-            igraph_integer_t edge=(igraph_integer_t) VECTOR(*neip)[i], from, to;
-            long int neighbor;
-            igraph_edge(graph, edge, &from, &to);
-            neighbor = actnode!=from ? from : to;
-            if (nrgeo[neighbor] != 0) {
-              /* we've already seen this node, another shortest path? */
-              if (distance[neighbor]==distance[actnode]+1) {
-                nrgeo[neighbor]+=nrgeo[actnode];
-              }
-            } else {
-              /* we haven't seen this node yet */
-              nrgeo[neighbor]+=nrgeo[actnode];
-              distance[neighbor]=distance[actnode]+1;
-              IGRAPH_CHECK(igraph_dqueue_push(&q, neighbor));
-              IGRAPH_CHECK(igraph_stack_push(&stack, neighbor));
-            }
-          }
-        } /* while !igraph_dqueue_empty */
-        
-        /* Ok, we've the distance of each node and also the number of
-           shortest paths to them. Now we do an inverse search, starting
-           with the farthest nodes. */
-        while (!igraph_stack_empty(&stack)) {
-          long int actnode=(long int) igraph_stack_pop(&stack);
-          if (distance[actnode]<1) { continue; } /* skip source node */
-          
-          /* set the temporary score of the friends */
-          neip=igraph_inclist_get(elist_in_p, actnode);
-          neino=igraph_vector_int_size(neip);
-          for (i=0; i<neino; i++) {
-            long int edge = (long int) VECTOR(*neip)[i];
-            long int neighbor = IGRAPH_OTHER(graph, edge, actnode);
-            if (distance[neighbor]==distance[actnode]-1 &&
-                nrgeo[neighbor] != 0) {
-              tmpscore[neighbor] +=
-                (tmpscore[actnode]+1)*nrgeo[neighbor]/nrgeo[actnode];
-              VECTOR(eb)[edge] +=
-                (tmpscore[actnode]+1)*nrgeo[neighbor]/nrgeo[actnode];
-            }
-          }
-        }
-        /* Ok, we've the scores for this source */
-      } /* for source <= no_of_nodes */
-    } else {
-      /* Weighted variant follows */
-
-      /* The following for loop is copied almost intact from
-       * igraph_i_edge_betweenness_estimate_weighted */
-      for (source=0; source<no_of_nodes; source++) {
-        /* This will contain the edge betweenness in the current step */
-        IGRAPH_ALLOW_INTERRUPTION();
-
-        memset(distance, 0, (size_t) no_of_nodes*sizeof(double));
-        memset(nrgeo, 0, (size_t) no_of_nodes*sizeof(unsigned long long int));
-        memset(tmpscore, 0, (size_t) no_of_nodes*sizeof(double));
-
-        igraph_2wheap_push_with_index(&heap, source, 0);
-        distance[source]=1.0;
-        nrgeo[source]=1;
-
-        while (!igraph_2wheap_empty(&heap)) {
-          long int minnei = igraph_2wheap_max_index(&heap);
-          igraph_real_t mindist = -igraph_2wheap_delete_max(&heap);
-
-          igraph_stack_push(&stack, minnei);
-
-          neip=igraph_inclist_get(elist_out_p, minnei);
-          neino=igraph_vector_int_size(neip);
-
-          for (i=0; i<neino; i++) {
-            long int edge=VECTOR(*neip)[i];
-            long int to=IGRAPH_OTHER(graph, edge, minnei);
-            igraph_real_t altdist = mindist + VECTOR(*weights)[edge];
-            igraph_real_t curdist = distance[to];
-            igraph_vector_int_t *v;
-
-            if (curdist == 0) {
-              /* This is the first finite distance to 'to' */
-              v = igraph_inclist_get(&fathers, to);
-              igraph_vector_int_resize(v, 1);
-              VECTOR(*v)[0] = edge;
-              nrgeo[to] = nrgeo[minnei];
-              distance[to] = altdist + 1.0;
-              IGRAPH_CHECK(igraph_2wheap_push_with_index(&heap, to, -altdist));
-            } else if (altdist < curdist-1) {
-              /* This is a shorter path */
-              v = igraph_inclist_get(&fathers, to);
-              igraph_vector_int_resize(v, 1);
-              VECTOR(*v)[0] = edge;
-              nrgeo[to] = nrgeo[minnei];
-              distance[to] = altdist + 1.0;
-              IGRAPH_CHECK(igraph_2wheap_modify(&heap, to, -altdist));
-            } else if (altdist == curdist-1) {
-              /* Another path with the same length */
-              v = igraph_inclist_get(&fathers, to);
-              igraph_vector_int_push_back(v, edge);
-              nrgeo[to] += nrgeo[minnei];
-            }
-          }
-        } /* igraph_2wheap_empty(&Q) */
-
-        while (!igraph_stack_empty(&stack)) {
-          long int w = (long int) igraph_stack_pop(&stack);
-          igraph_vector_int_t *fatv = igraph_inclist_get(&fathers, w);
-          long int fatv_len = igraph_vector_int_size(fatv);
-
-          for (i = 0; i < fatv_len; i++) {
-            long int fedge = (long int) VECTOR(*fatv)[i];
-            long int neighbor = IGRAPH_OTHER(graph, fedge, w);
-            tmpscore[neighbor] += (tmpscore[w] + 1) * nrgeo[neighbor] / nrgeo[w];
-            VECTOR(eb)[fedge] += (tmpscore[w] + 1) * nrgeo[neighbor] / nrgeo[w];
-          }
-
-          tmpscore[w] = 0;
-          distance[w] = 0;
-          nrgeo[w] = 0;
-          igraph_vector_int_clear(fatv);
-        }
-      } /* source < no_of_nodes */
-    }
-    
     /* Now look for the smallest edge betweenness */
     /* and eliminate that edge from the network */
     maxedge=igraph_i_vector_which_max_not_null(&eb, passive);
@@ -646,7 +1054,33 @@ int igraph_community_edge_betweenness(const igraph_t *graph,
       }
     }
     passive[maxedge]=1;
+    if (e == no_of_edges-1) { break; }
+
+    /* The affected sources, and the component of the edge, as the
+       changed scores are all in the component */
+    IGRAPH_CHECK(igraph_i_eb_community_affected(graph, elist_in_p, weights,
+						&work, maxedge, !directed,
+						&reached, &sources));
     igraph_edge(graph, (igraph_integer_t) maxedge, &from, &to);
+    igraph_vector_long_clear(&comp);
+    IGRAPH_CHECK(igraph_i_eb_community_component(graph, elist_out_p,
+						 elist_in_p, mark, e+1,
+						 from, &comp));
+
+    /* Updating costs two searches per affected source, if there are
+       many of them, the component is recalculated instead */
+    incremental= 2 * igraph_vector_long_size(&sources) <
+      igraph_vector_long_size(&comp);
+    if (incremental) {
+      nblocks=igraph_vector_long_size(&sources);
+      igraph_i_eb_community_sources(graph, elist_out_p, elist_in_p, weights,
+				    &work, &sources, -1.0);
+    } else {
+      IGRAPH_CHECK(igraph_vector_long_update(&sources, &comp));
+      igraph_vector_long_sort(&sources);
+      nblocks=igraph_vector_long_size(&sources);
+    }
+    if (nblocks > work.nblocks) { nblocks=work.nblocks; }
 
     neip=igraph_inclist_get(elist_in_p, to);
     neino=igraph_vector_int_size(neip);
@@ -659,27 +1093,31 @@ int igraph_community_edge_betweenness(const igraph_t *graph,
     igraph_vector_int_search(neip, 0, maxedge, &pos);
     VECTOR(*neip)[pos]=VECTOR(*neip)[neino-1];
     igraph_vector_int_pop_back(neip);
+
+    igraph_i_eb_community_sources(graph, elist_out_p, elist_in_p, weights,
+				  &work, &sources, 1.0);
+    IGRAPH_ALLOW_INTERRUPTION();
+
+    if (nblocks > 0) {
+      long int b;
+      igraph_i_eb_community_sum(graph, elist_out_p, &work, &comp, nblocks,
+				/*reset=*/ !incremental, &eb);
+      for (b=0; b<nblocks; b++) {
+	work.blockscore[b * no_of_edges + maxedge]=0;
+      }
+    }
   }
 
   IGRAPH_PROGRESS("Edge betweenness community detection: ", 100.0, NULL);
 
   igraph_free(passive);
   igraph_vector_destroy(&eb);
-  igraph_stack_destroy(&stack);
-  IGRAPH_FINALLY_CLEAN(3);
-
-  if (weights == 0) {
-    igraph_dqueue_destroy(&q);
-    IGRAPH_FINALLY_CLEAN(1);
-  } else {
-    igraph_2wheap_destroy(&heap);
-    igraph_inclist_destroy(&fathers);
-    IGRAPH_FINALLY_CLEAN(2);
-  }
-  igraph_free(tmpscore);
-  igraph_free(nrgeo);
-  igraph_free(distance);
-  IGRAPH_FINALLY_CLEAN(3);
+  igraph_free(mark);
+  igraph_vector_long_destroy(&reached);
+  igraph_vector_long_destroy(&comp);
+  igraph_vector_long_destroy(&sources);
+  igraph_i_eb_community_work_destroy(&work);
+  IGRAPH_FINALLY_CLEAN(7);
 
   if (directed) {
     igraph_inclist_destroy(&elist_out);
@@ -940,78 +1378,495 @@ int igraph_modularity(const igraph_t *graph,
   return 0;
 }
 
-/** 
- * \function igraph_modularity_matrix
+/* The number of membership vectors that igraph_modularity_batch()
+   evaluates in one pass over the edges */
+#define IGRAPH_I_MODULARITY_BATCH 16
+
+/**
+ * \function igraph_modularity_batch
+ * \brief Modularity of many divisions of the same graph
+ *
+ * Calculates the same values as \ref igraph_modularity(), for many
+ * membership vectors at once. The membership vectors are the rows of
+ * a matrix, this is the format of the \c memberships argument of
+ * \ref igraph_community_multilevel(), for example. Several membership
+ * vectors are evaluated in a single pass over the edges, and if
+ * igraph was compiled with OpenMP support, the groups of membership
+ * vectors are evaluated in parallel. The results are exactly the same
+ * as the ones of \ref igraph_modularity().
+ *
+ * \param graph The input graph.
+ * \param memberships Numeric matrix, each row is a membership vector,
+ *     so it must have one column for each vertex. Empty communities
+ *     are allowed, but the community IDs must not be negative.
+ * \param modularity Pointer to an initialized vector, the modularity
+ *     values are stored here, one for each row of \p memberships. It
+ *     will be resized as needed.
+ * \param weights Weight vector or NULL if no weights are specified.
+ * \return Error code.
+ *
+ * Time complexity: O(k(|V|+|E|)) for k membership vectors, plus the
+ * largest community ID times the number of threads, for the
+ * temporary storage.
  */
 
-int igraph_modularity_matrix(const igraph_t *graph, 
-			     const igraph_vector_t *membership,
-			     igraph_matrix_t *modmat, 
-			     const igraph_vector_t *weights) {
+int igraph_modularity_batch(const igraph_t *graph,
+			    const igraph_matrix_t *memberships,
+			    igraph_vector_t *modularity,
+			    const igraph_vector_t *weights) {
 
   long int no_of_nodes=igraph_vcount(graph);
-  long int no_of_edges=igraph_ecount(graph);  
-  igraph_real_t sw= weights ? igraph_vector_sum(weights) : no_of_edges;
-  igraph_vector_t deg;
-  long int i, j;
+  long int no_of_edges=igraph_ecount(graph);
+  long int no_of_rows=igraph_matrix_nrow(memberships);
+  long int no_of_blocks, types=0, b;
+  igraph_vector_t ea;
+  igraph_vector_int_t comms;
+  igraph_real_t m;
+  int nthreads;
 
-  if (igraph_vector_size(membership) != igraph_vcount(graph)) {
-    IGRAPH_ERROR("Cannot calculate modularity matrix, invalid "
-		 "membership vector length", IGRAPH_EINVAL);
+  if (igraph_matrix_ncol(memberships) != no_of_nodes) {
+    IGRAPH_ERROR("cannot calculate modularity, invalid membership matrix "
+		 "size", IGRAPH_EINVAL);
   }
-  
-  if (weights && igraph_vector_size(weights) != no_of_edges) {
-    IGRAPH_ERROR("Invalid weight vector length", IGRAPH_EINVAL);
+  if (no_of_rows > 0 && no_of_nodes > 0) {
+    if (igraph_matrix_min(memberships) < 0) {
+      IGRAPH_ERROR("Invalid membership vector", IGRAPH_EINVAL);
+    }
+    types=(long int) igraph_matrix_max(memberships)+1;
   }
-
-  IGRAPH_VECTOR_INIT_FINALLY(&deg, no_of_nodes);
-  if (!weights) {
-    IGRAPH_CHECK(igraph_degree(graph, &deg, igraph_vss_all(), IGRAPH_ALL, 
-			       IGRAPH_LOOPS));
+  if (weights) {
+    if (igraph_vector_size(weights) < no_of_edges)
+      IGRAPH_ERROR("cannot calculate modularity, weight vector too short",
+        IGRAPH_EINVAL);
+    if (no_of_edges > 0 && igraph_vector_min(weights) < 0)
+      IGRAPH_ERROR("negative weight in weight vector", IGRAPH_EINVAL);
+    m=igraph_vector_sum(weights);
   } else {
-    IGRAPH_CHECK(igraph_strength(graph, &deg, igraph_vss_all(), IGRAPH_ALL, 
-				 IGRAPH_LOOPS, weights));
+    m=no_of_edges;
   }
-  IGRAPH_CHECK(igraph_get_adjacency(graph, modmat, IGRAPH_GET_ADJACENCY_BOTH, 
-				    /*eids=*/ 0));
 
-  for (i=0; i<no_of_nodes; i++) {
-    for (j=0; j<no_of_nodes; j++) {
-      MATRIX(*modmat, i, j) -= VECTOR(deg)[i] * VECTOR(deg)[j] / 2.0 / sw;
+  IGRAPH_CHECK(igraph_vector_resize(modularity, no_of_rows));
+  no_of_blocks=(no_of_rows + IGRAPH_I_MODULARITY_BATCH - 1) /
+    IGRAPH_I_MODULARITY_BATCH;
+  nthreads=IGRAPH_I_THREAD_COUNT(no_of_blocks);
+
+  /* Every thread has the 'e' and 'a' vectors of igraph_modularity(),
+     for every membership vector of a block */
+  IGRAPH_VECTOR_INIT_FINALLY(&ea, nthreads * 2 * 
+			     IGRAPH_I_MODULARITY_BATCH * types);
+  /* And a copy of the communities of the block, vertex by vertex, so
+     that the communities of an edge endpoint are in one cache line */
+  IGRAPH_CHECK(igraph_vector_int_init(&comms, nthreads * no_of_nodes *
+				      IGRAPH_I_MODULARITY_BATCH));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &comms);
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic, 1)
+#endif
+  for (b=0; b<no_of_blocks; b++) {
+    long int first=b * IGRAPH_I_MODULARITY_BATCH;
+    long int size= no_of_rows-first < IGRAPH_I_MODULARITY_BATCH ?
+      no_of_rows-first : IGRAPH_I_MODULARITY_BATCH;
+    igraph_real_t *e=VECTOR(ea) + 
+      IGRAPH_I_THREAD_NUM() * 2 * IGRAPH_I_MODULARITY_BATCH * types;
+    igraph_real_t *a=e + IGRAPH_I_MODULARITY_BATCH * types;
+    int *comm=VECTOR(comms) + 
+      IGRAPH_I_THREAD_NUM() * no_of_nodes * IGRAPH_I_MODULARITY_BATCH;
+    long int i, r;
+
+    /* The matrix is stored by columns, so this reads it sequentially */
+    for (i=0; i<no_of_nodes; i++) {
+      for (r=0; r<size; r++) {
+	comm[i*IGRAPH_I_MODULARITY_BATCH + r] = (int) (r*types + 
+	  (long int) MATRIX(*memberships, first+r, i));
+      }
+    }
+
+    for (i=0; i<no_of_edges; i++) {
+      igraph_real_t w= weights ? VECTOR(*weights)[i] : 1.0;
+      const int *m1=comm + 
+	IGRAPH_FROM(graph, i) * (long int) IGRAPH_I_MODULARITY_BATCH;
+      const int *m2=comm + 
+	IGRAPH_TO(graph, i) * (long int) IGRAPH_I_MODULARITY_BATCH;
+      for (r=0; r<size; r++) {
+	long int c1=m1[r], c2=m2[r];
+	if (c1==c2) e[c1] += 2*w;
+	a[c1] += w;
+	a[c2] += w;
+      }
+    }
+
+    for (r=0; r<size; r++) {
+      igraph_real_t q=0.0;
+      if (m > 0) {
+	for (i=r*types; i<(r+1)*types; i++) {
+	  igraph_real_t tmp=a[i]/2/m;
+	  q += e[i]/2/m;
+	  q -= tmp*tmp;
+	}
+      }
+      VECTOR(*modularity)[first+r]=q;
     }
+    memset(e, 0, sizeof(igraph_real_t) * 2 * IGRAPH_I_MODULARITY_BATCH *
+	   (size_t) types);
   }
-  
-  igraph_vector_destroy(&deg);
-  IGRAPH_FINALLY_CLEAN(1);
-  
+
+  igraph_vector_int_destroy(&comms);
+  igraph_vector_destroy(&ea);
+  IGRAPH_FINALLY_CLEAN(2);
+
   return 0;
 }
 
 /**
- * \function igraph_reindex_membership
- * \brief Makes the IDs in a membership vector continuous
- *
- * This function reindexes component IDs in a membership vector
- * in a way that the new IDs start from zero and go up to C-1,
- * where C is the number of unique component IDs in the original
- * vector.
+ * \function igraph_modularity_tracker_init
+ * \brief Initializes a modularity tracker
  *
- * This function was contributed by Tom Gregorovic.
+ * A modularity tracker stores a division of a graph into communities,
+ * the total internal edge weight and the total vertex strength of
+ * every community, and the modularity, as defined in \ref
+ * igraph_modularity(). When a vertex moves to another community,
+ * only the totals of its old and new communities change, so the
+ * modularity can be updated in O(d) time, where d is the degree of
+ * the vertex, see \ref igraph_modularity_tracker_move(). The
+ * tracker keeps a snapshot of the graph, it is not affected by later
+ * changes of the graph or the weights.
  *
- * \param  membership  Numeric vector which gives the type of each
- *                     vertex, ie. the component to which it belongs.
- *                     The vector will be altered in-place.
- * \param  new_to_old  Pointer to a vector which will contain the
- *                     old component ID for each new one, or NULL,
- *                     in which case it is not returned. The vector
- *                     will be resized as needed.
+ * \param tracker Pointer to an uninitialized modularity tracker.
+ * \param graph The input graph. The directions of the edges are
+ *     ignored, like in \ref igraph_modularity().
+ * \param membership The initial communities of the vertices. Empty
+ *     communities are allowed, but the community IDs must not be
+ *     negative.
+ * \param weights Weight vector or NULL if no weights are specified.
+ *     The weights must not be negative.
+ * \return Error code.
  *
- * Time complexity: should be O(n log n) for n elements.
+ * Time complexity: O(|V|+|E|+C), C is the largest community ID.
  */
-int igraph_reindex_membership(igraph_vector_t *membership,
-                              igraph_vector_t *new_to_old) {
-  long int i, pos, size = igraph_vector_size(membership);
-  igraph_vector_t old_sorted, *new_to_old_real;
+
+int igraph_modularity_tracker_init(igraph_modularity_tracker_t *tracker,
+				   const igraph_t *graph,
+				   const igraph_vector_t *membership,
+				   const igraph_vector_t *weights) {
+  long int no_of_nodes=igraph_vcount(graph);
+  long int no_of_edges=igraph_ecount(graph);
+  long int types=0, i, j;
+
+  if (igraph_vector_size(membership) != no_of_nodes) {
+    IGRAPH_ERROR("Invalid membership vector length", IGRAPH_EINVAL);
+  }
+  if (no_of_nodes > 0) {
+    if (igraph_vector_min(membership) < 0) {
+      IGRAPH_ERROR("Invalid membership vector", IGRAPH_EINVAL);
+    }
+    types=(long int) igraph_vector_max(membership)+1;
+  }
+  if (weights) {
+    if (igraph_vector_size(weights) != no_of_edges) {
+      IGRAPH_ERROR("Invalid weight vector length", IGRAPH_EINVAL);
+    }
+    if (no_of_edges > 0 && igraph_vector_min(weights) < 0) {
+      IGRAPH_ERROR("negative weight in weight vector", IGRAPH_EINVAL);
+    }
+  }
+
+  IGRAPH_CHECK(igraph_csr_init(graph, &tracker->csr, IGRAPH_ALL, weights));
+  IGRAPH_FINALLY(igraph_csr_destroy, &tracker->csr);
+  IGRAPH_CHECK(igraph_vector_copy(&tracker->membership, membership));
+  IGRAPH_FINALLY(igraph_vector_destroy, &tracker->membership);
+  IGRAPH_VECTOR_INIT_FINALLY(&tracker->strength, no_of_nodes);
+  IGRAPH_VECTOR_INIT_FINALLY(&tracker->internal, types);
+  IGRAPH_VECTOR_INIT_FINALLY(&tracker->total, types);
+
+  /* Edges between different vertices are in the rows of both
+     endpoints, loop edges twice in the row of their vertex, so every
+     edge is counted twice in 'internal' */
+  for (i=0; i<no_of_nodes; i++) {
+    long int c=(long int) VECTOR(*membership)[i];
+    for (j=VECTOR(tracker->csr.offsets)[i];
+	 j<VECTOR(tracker->csr.offsets)[i+1]; j++) {
+      igraph_real_t w= weights ? VECTOR(tracker->csr.weights)[j] : 1.0;
+      long int nei=VECTOR(tracker->csr.neis)[j];
+      VECTOR(tracker->strength)[i] += w;
+      if (VECTOR(*membership)[nei] == c) {
+	VECTOR(tracker->internal)[c] += w;
+      }
+    }
+    VECTOR(tracker->total)[c] += VECTOR(tracker->strength)[i];
+  }
+
+  tracker->m= weights ? igraph_vector_sum(weights) : no_of_edges;
+  tracker->sum_internal=0.0;
+  tracker->sum_total2=0.0;
+  for (i=0; i<types; i++) {
+    tracker->sum_internal += VECTOR(tracker->internal)[i];
+    tracker->sum_total2 += VECTOR(tracker->total)[i] *
+      VECTOR(tracker->total)[i];
+  }
+
+  IGRAPH_FINALLY_CLEAN(5);
+  return 0;
+}
+
+/**
+ * \function igraph_modularity_tracker_destroy
+ * \brief Deallocates a modularity tracker
+ *
+ * \param tracker The tracker to destroy.
+ *
+ * Time complexity: operating system dependent.
+ */
+
+void igraph_modularity_tracker_destroy(igraph_modularity_tracker_t *tracker) {
+  igraph_vector_destroy(&tracker->total);
+  igraph_vector_destroy(&tracker->internal);
+  igraph_vector_destroy(&tracker->strength);
+  igraph_vector_destroy(&tracker->membership);
+  igraph_csr_destroy(&tracker->csr);
+}
+
+/**
+ * \function igraph_modularity_tracker_get
+ * \brief The modularity of the current division
+ *
+ * The value is maintained incrementally, so after very many moves it
+ * may differ from the result of \ref igraph_modularity() by a small
+ * rounding error. It is zero if the graph has no edges.
+ *
+ * \param tracker The modularity tracker.
+ * \return The modularity.
+ *
+ * Time complexity: O(1).
+ */
+
+igraph_real_t igraph_modularity_tracker_get(const igraph_modularity_tracker_t *tracker) {
+  igraph_real_t m=tracker->m;
+  if (m <= 0) { return 0.0; }
+  return tracker->sum_internal/2/m - tracker->sum_total2/4/m/m;
+}
+
+/* The weight of the edges from 'vertex' to the other vertices of its
+   own community, and to the vertices of 'community'. Loop edges are
+   not counted, their weight is in 'self', twice. */
+static void igraph_i_modularity_tracker_weights(
+			      const igraph_modularity_tracker_t *tracker,
+			      long int vertex, long int community,
+			      igraph_real_t *w_own, igraph_real_t *w_other,
+			      igraph_real_t *self) {
+  const igraph_csr_t *csr=&tracker->csr;
+  igraph_real_t own=VECTOR(tracker->membership)[vertex];
+  long int j;
+
+  *w_own=*w_other=*self=0.0;
+  for (j=VECTOR(csr->offsets)[vertex]; j<VECTOR(csr->offsets)[vertex+1];
+       j++) {
+    long int nei=VECTOR(csr->neis)[j];
+    igraph_real_t w= csr->weighted ? VECTOR(csr->weights)[j] : 1.0;
+    if (nei == vertex) {
+      *self += w;
+    } else if (VECTOR(tracker->membership)[nei] == own) {
+      *w_own += w;
+    } else if (VECTOR(tracker->membership)[nei] == community) {
+      *w_other += w;
+    }
+  }
+}
+
+static int igraph_i_modularity_tracker_check(
+			      const igraph_modularity_tracker_t *tracker,
+			      igraph_integer_t vertex,
+			      igraph_integer_t community) {
+  if (vertex < 0 || vertex >= igraph_vector_size(&tracker->membership)) {
+    IGRAPH_ERROR("Invalid vertex id", IGRAPH_EINVVID);
+  }
+  if (community < 0) {
+    IGRAPH_ERROR("Invalid community id", IGRAPH_EINVAL);
+  }
+  return 0;
+}
+
+/* The change of 'sum_internal' and 'sum_total2' if 'vertex' moves to
+   'community', from the results of the previous function */
+static void igraph_i_modularity_tracker_delta(
+			      const igraph_modularity_tracker_t *tracker,
+			      long int vertex, long int community,
+			      igraph_real_t w_own, igraph_real_t w_other,
+			      igraph_real_t *d_internal,
+			      igraph_real_t *d_total2) {
+  long int own=(long int) VECTOR(tracker->membership)[vertex];
+  igraph_real_t s=VECTOR(tracker->strength)[vertex];
+  igraph_real_t a_other= community < igraph_vector_size(&tracker->total) ?
+    VECTOR(tracker->total)[community] : 0.0;
+
+  *d_internal=2 * (w_other - w_own);
+  *d_total2=2 * s * (a_other - VECTOR(tracker->total)[own]) + 2 * s * s;
+}
+
+/**
+ * \function igraph_modularity_tracker_gain
+ * \brief The modularity change of moving a vertex
+ *
+ * Calculates how the modularity would change if a vertex moved to
+ * another community, without moving it.
+ *
+ * \param tracker The modularity tracker.
+ * \param vertex The vertex to move.
+ * \param community The new community of the vertex. It may be a
+ *     community that has no vertices yet.
+ * \param gain Pointer to a real number, the change of the modularity
+ *     is stored here.
+ * \return Error code.
+ *
+ * Time complexity: O(d), the degree of the vertex.
+ */
+
+int igraph_modularity_tracker_gain(const igraph_modularity_tracker_t *tracker,
+				   igraph_integer_t vertex,
+				   igraph_integer_t community,
+				   igraph_real_t *gain) {
+  igraph_real_t d_internal, d_total2, w_own, w_other, self, m=tracker->m;
+
+  IGRAPH_CHECK(igraph_i_modularity_tracker_check(tracker, vertex,
+						 community));
+  if (community == VECTOR(tracker->membership)[(long int) vertex] || m <= 0) {
+    *gain=0.0;
+    return 0;
+  }
+  igraph_i_modularity_tracker_weights(tracker, vertex, community, &w_own,
+				      &w_other, &self);
+  igraph_i_modularity_tracker_delta(tracker, vertex, community, w_own,
+				    w_other, &d_internal, &d_total2);
+  *gain=d_internal/2/m - d_total2/4/m/m;
+
+  return 0;
+}
+
+/**
+ * \function igraph_modularity_tracker_move
+ * \brief Moves a vertex to another community
+ *
+ * Updates the community of the vertex, the totals of its old and new
+ * communities, and the modularity.
+ *
+ * \param tracker The modularity tracker.
+ * \param vertex The vertex to move.
+ * \param community The new community of the vertex. It may be a
+ *     community that has no vertices yet.
+ * \return Error code.
+ *
+ * Time complexity: O(d), the degree of the vertex, amortized, if the
+ * new community ID is not larger than the largest one used so far.
+ */
+
+int igraph_modularity_tracker_move(igraph_modularity_tracker_t *tracker,
+				   igraph_integer_t vertex,
+				   igraph_integer_t community) {
+  long int own, types=igraph_vector_size(&tracker->total);
+  igraph_real_t d_internal, d_total2, w_own, w_other, self, s;
+
+  IGRAPH_CHECK(igraph_i_modularity_tracker_check(tracker, vertex,
+						 community));
+  own=(long int) VECTOR(tracker->membership)[(long int) vertex];
+  if (community == own) { return 0; }
+
+  if (community >= types) {
+    long int i;
+    IGRAPH_CHECK(igraph_vector_resize(&tracker->internal, community+1));
+    IGRAPH_CHECK(igraph_vector_resize(&tracker->total, community+1));
+    for (i=types; i<=community; i++) {
+      VECTOR(tracker->internal)[i]=VECTOR(tracker->total)[i]=0.0;
+    }
+  }
+
+  igraph_i_modularity_tracker_weights(tracker, vertex, community, &w_own,
+				      &w_other, &self);
+  igraph_i_modularity_tracker_delta(tracker, vertex, community, w_own,
+				    w_other, &d_internal, &d_total2);
+  s=VECTOR(tracker->strength)[(long int) vertex];
+  VECTOR(tracker->internal)[own] -= 2*w_own + self;
+  VECTOR(tracker->internal)[(long int) community] += 2*w_other + self;
+  VECTOR(tracker->total)[own] -= s;
+  VECTOR(tracker->total)[(long int) community] += s;
+  VECTOR(tracker->membership)[(long int) vertex] = community;
+  tracker->sum_internal += d_internal;
+  tracker->sum_total2 += d_total2;
+
+  return 0;
+}
+
+/** 
+ * \function igraph_modularity_matrix
+ */
+
+int igraph_modularity_matrix(const igraph_t *graph, 
+			     const igraph_vector_t *membership,
+			     igraph_matrix_t *modmat, 
+			     const igraph_vector_t *weights) {
+
+  long int no_of_nodes=igraph_vcount(graph);
+  long int no_of_edges=igraph_ecount(graph);  
+  igraph_real_t sw= weights ? igraph_vector_sum(weights) : no_of_edges;
+  igraph_vector_t deg;
+  long int i, j;
+
+  if (igraph_vector_size(membership) != igraph_vcount(graph)) {
+    IGRAPH_ERROR("Cannot calculate modularity matrix, invalid "
+		 "membership vector length", IGRAPH_EINVAL);
+  }
+  
+  if (weights && igraph_vector_size(weights) != no_of_edges) {
+    IGRAPH_ERROR("Invalid weight vector length", IGRAPH_EINVAL);
+  }
+
+  IGRAPH_VECTOR_INIT_FINALLY(&deg, no_of_nodes);
+  if (!weights) {
+    IGRAPH_CHECK(igraph_degree(graph, &deg, igraph_vss_all(), IGRAPH_ALL, 
+			       IGRAPH_LOOPS));
+  } else {
+    IGRAPH_CHECK(igraph_strength(graph, &deg, igraph_vss_all(), IGRAPH_ALL, 
+				 IGRAPH_LOOPS, weights));
+  }
+  IGRAPH_CHECK(igraph_get_adjacency(graph, modmat, IGRAPH_GET_ADJACENCY_BOTH, 
+				    /*eids=*/ 0));
+
+  for (i=0; i<no_of_nodes; i++) {
+    for (j=0; j<no_of_nodes; j++) {
+      MATRIX(*modmat, i, j) -= VECTOR(deg)[i] * VECTOR(deg)[j] / 2.0 / sw;
+    }
+  }
+  
+  igraph_vector_destroy(&deg);
+  IGRAPH_FINALLY_CLEAN(1);
+  
+  return 0;
+}
+
+/**
+ * \function igraph_reindex_membership
+ * \brief Makes the IDs in a membership vector continuous
+ *
+ * This function reindexes component IDs in a membership vector
+ * in a way that the new IDs start from zero and go up to C-1,
+ * where C is the number of unique component IDs in the original
+ * vector.
+ *
+ * This function was contributed by Tom Gregorovic.
+ *
+ * \param  membership  Numeric vector which gives the type of each
+ *                     vertex, ie. the component to which it belongs.
+ *                     The vector will be altered in-place.
+ * \param  new_to_old  Pointer to a vector which will contain the
+ *                     old component ID for each new one, or NULL,
+ *                     in which case it is not returned. The vector
+ *                     will be resized as needed.
+ *
+ * Time complexity: should be O(n log n) for n elements.
+ */
+int igraph_reindex_membership(igraph_vector_t *membership,
+                              igraph_vector_t *new_to_old) {
+  long int i, pos, size = igraph_vector_size(membership);
+  igraph_vector_t old_sorted, *new_to_old_real;
   igraph_real_t last_id, this_id;
 
   /* Make sure that membership is not empty; if empty, return
@@ -2082,6 +2937,170 @@ int igraph_le_community_to_membership(const igraph_matrix_t *merges,
 
 /********************************************************************/
 
+/*
+ * Label propagation works on CSR snapshots of the graph: the labels
+ * are taken from the in-neighbors, and a vertex that changes its
+ * label activates its out-neighbors for the next round. Only the
+ * active vertices are visited in a round, the others already have a
+ * dominant label. The labels are shifted by one, zero means an
+ * unlabeled vertex.
+ *
+ * The labels of the neighbors are counted in a small open addressing
+ * hash table, every thread has its own. 'touched' lists the labels in
+ * the table, so that it can be cleared quickly.
+ */
+
+#define IGRAPH_I_LPA_PARALLEL_MIN 10000
+
+typedef struct igraph_i_lpa_table_t {
+  unsigned int mask;
+  int *keys, *touched;
+  igraph_real_t *counts;
+} igraph_i_lpa_table_t;
+
+/* Murmur3 finalizer, for the hash table and the random choices */
+static unsigned int igraph_i_lpa_hash(unsigned int x) {
+  x ^= x >> 16; x *= 0x85ebca6bU;
+  x ^= x >> 13; x *= 0xc2b2ae35U;
+  x ^= x >> 16;
+  return x;
+}
+
+/*
+ * Returns the new label of vertex 'v': one of the labels with the
+ * largest total weight among the in-neighbors, chosen randomly, with
+ * 'seed' and 'v' determining the choice. Unlabeled vertices without
+ * labeled neighbors stay unlabeled. Does not allocate memory, so the
+ * threads can call it concurrently, each with its own table.
+ */
+
+static int igraph_i_lpa_choose(const igraph_csr_t *csr, const int *labels,
+			       igraph_i_lpa_table_t *table, long int v,
+			       unsigned int seed) {
+  const int *offsets=VECTOR(csr->offsets), *neis=VECTOR(csr->neis);
+  const igraph_real_t *weights= csr->weighted ? VECTOR(csr->weights) : 0;
+  int *keys=table->keys, *touched=table->touched;
+  igraph_real_t *counts=table->counts, max_count=0;
+  long int j, nt=0, no_of_dominant=0;
+  int own, k, chosen=0;
+
+#ifdef _OPENMP
+#pragma omp atomic read
+#endif
+  own=labels[v];
+
+  for (j=offsets[v]; j<offsets[v+1]; j++) {
+    unsigned int pos;
+#ifdef _OPENMP
+#pragma omp atomic read
+#endif
+    k=labels[neis[j]];
+    if (k == 0) { continue; }	/* no label yet */
+    pos=igraph_i_lpa_hash((unsigned int) k) & table->mask;
+    while (keys[pos] != 0 && keys[pos] != k) { pos=(pos+1) & table->mask; }
+    if (keys[pos] == 0) {
+      keys[pos]=k;
+      counts[pos]=0;
+      touched[nt++]=(int) pos;
+    }
+    counts[pos] += weights ? weights[j] : 1.0;
+  }
+
+  if (nt == 0) { return own; }
+
+  for (j=0; j<nt; j++) {
+    igraph_real_t c=counts[touched[j]];
+    if (c > max_count || j == 0) {
+      max_count=c;
+      no_of_dominant=1;
+    } else if (c == max_count) {
+      no_of_dominant++;
+    }
+  }
+
+  /* Choose among the dominant labels, even if the current label is
+     one of them, otherwise the ties freeze too early and the
+     communities stay small */
+  k=(int) (igraph_i_lpa_hash(seed ^ igraph_i_lpa_hash((unsigned int) v)) %
+	   (unsigned int) no_of_dominant);
+  for (j=0; j<nt; j++) {
+    int pos=touched[j];
+    if (counts[pos] == max_count) {
+      if (k-- == 0) { chosen=keys[pos]; }
+    }
+    keys[pos]=0;
+  }
+
+  return chosen;
+}
+
+/*
+ * The rounds of label propagation, until there are no active
+ * vertices. 'lab' holds the labels, 'q' marks the active vertices,
+ * 'act' is a work array for them. 'activate' gives the vertices whose
+ * label depends on the label of a vertex. Does not allocate memory
+ * and does not call the error handler, so the independent runs of
+ * igraph_community_ensemble() can use it in a parallel region, with a
+ * single thread and their own random number generator each.
+ */
+
+static void igraph_i_lpa_propagate(const igraph_csr_t *in,
+				   const igraph_csr_t *activate,
+				   const igraph_vector_bool_t *fixed,
+				   long int no_of_nodes, int *lab, int *act,
+				   char *q, igraph_i_lpa_table_t *tables,
+				   int nthreads, igraph_rng_t *rng,
+				   igraph_bool_t *interrupted) {
+  long int no_of_active, i, j, k;
+
+  while (!*interrupted) {
+    unsigned int seed;
+
+    /* The active vertices of this round, in random order */
+    no_of_active=0;
+    for (i=0; i<no_of_nodes; i++) {
+      if (q[i]) {
+	q[i]=0;
+	k=igraph_rng_get_integer(rng, 0, no_of_active);
+	act[no_of_active]=act[k];
+	act[k]=(int) i;
+	no_of_active++;
+      }
+    }
+    if (no_of_active == 0) { break; }
+    seed=(unsigned int) igraph_rng_get_integer(rng, 0, 0x7fffffff);
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic, 256) \
+  if (no_of_active >= IGRAPH_I_LPA_PARALLEL_MIN) private(j)
+#endif
+    for (i=0; i<no_of_active; i++) {
+      long int v=act[i];
+      int newlabel=igraph_i_lpa_choose(in, lab,
+				       &tables[IGRAPH_I_THREAD_NUM()], v,
+				       seed);
+      if (newlabel != lab[v]) {
+#ifdef _OPENMP
+#pragma omp atomic write
+#endif
+	lab[v]=newlabel;
+	for (j=VECTOR(activate->offsets)[v];
+	     j<VECTOR(activate->offsets)[v+1]; j++) {
+	  long int u=VECTOR(activate->neis)[j];
+	  if (!fixed || !VECTOR(*fixed)[u]) {
+#ifdef _OPENMP
+#pragma omp atomic write
+#endif
+	    q[u]=1;
+	  }
+	}
+      }
+    }
+
+    IGRAPH_I_PARALLEL_ALLOW_INTERRUPTION(*interrupted);
+  }
+}
+
 /**
  * \ingroup communities
  * \function igraph_community_label_propagation
@@ -2101,6 +3120,17 @@ int igraph_le_community_to_membership(const igraph_matrix_t *merges,
  * nodes with label 0, 1, 2, ..., k-1 (where k is the number of possible
  * labels). The new label of node i will then be the label whose edges
  * (among the ones incident on node i) have the highest total weight.
+ * If there are several such labels, one of them is chosen randomly,
+ * even if the current label of the node is among them.
+ *
+ * </para><para>
+ * The nodes are updated asynchronously, in random order. After the
+ * first round, only the nodes that have a neighbor whose label
+ * changed in the previous round are visited again, so converged parts
+ * of the graph do not cost anything. If igraph was compiled with
+ * OpenMP support, the nodes of a round are updated in parallel on
+ * large graphs, and then the result depends on the number of
+ * threads and on their timing.
  * 
  * \param graph The input graph, should be undirected to make sense.
  * \param membership The membership vector, the result is returned here.
@@ -2133,17 +3163,20 @@ int igraph_community_label_propagation(const igraph_t *graph,
   long int no_of_nodes=igraph_vcount(graph);
   long int no_of_edges=igraph_ecount(graph);
   long int no_of_not_fixed_nodes=no_of_nodes;
-  long int i, j, k;
-  igraph_adjlist_t al;
-  igraph_inclist_t il;
-  igraph_bool_t running = 1;
-
-  igraph_vector_t label_counters, dominant_labels, nonzero_labels, node_order;
+  long int i, j, k, maxdeg=0;
+  igraph_csr_t in, out;
+  igraph_i_lpa_table_t *tables;
+  igraph_vector_int_t labels, active, table_keys, table_touched;
+  igraph_vector_char_t queued;
+  igraph_vector_t table_counts, relabel;
+  unsigned int size=16;
+  int nthreads;
+  igraph_bool_t interrupted=0;
 
   /* The implementation uses a trick to avoid negative array indexing:
-   * elements of the membership vector are increased by 1 at the start
-   * of the algorithm; this to allow us to denote unlabeled vertices
-   * (if any) by zeroes. The membership vector is shifted back in the end
+   * labels are increased by 1 at the start of the algorithm; this to
+   * allow us to denote unlabeled vertices (if any) by zeroes. The
+   * labels are shifted back in the end
    */
 
   /* Do some initial checks */
@@ -2162,690 +3195,617 @@ int igraph_community_label_propagation(const igraph_t *graph,
   }
 
   IGRAPH_CHECK(igraph_vector_resize(membership, no_of_nodes));
+  IGRAPH_CHECK(igraph_vector_int_init(&labels, no_of_nodes));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &labels);
+  IGRAPH_CHECK(igraph_vector_char_init(&queued, no_of_nodes));
+  IGRAPH_FINALLY(igraph_vector_char_destroy, &queued);
+  igraph_vector_char_fill(&queued, 1);
 
   if (initial) {
     if (igraph_vector_size(initial) != no_of_nodes) {
       IGRAPH_ERROR("Invalid initial labeling vector length", IGRAPH_EINVAL);
     }
-    /* Check if the labels used are valid, initialize membership vector */
+    /* Check if the labels used are valid, initialize the labels */
     for (i=0; i<no_of_nodes; i++) {
       if (VECTOR(*initial)[i] < 0) {
-        VECTOR(*membership)[i] = 0;
+        VECTOR(labels)[i] = 0;
+      } else if (floor(VECTOR(*initial)[i]) + 1 > no_of_nodes) {
+        IGRAPH_ERROR("elements of the initial labeling vector must be between 0 and |V|-1", IGRAPH_EINVAL);
       } else {
-        VECTOR(*membership)[i] = floor(VECTOR(*initial)[i]) + 1;
+        VECTOR(labels)[i] = (int) floor(VECTOR(*initial)[i]) + 1;
       }
     }
     if (fixed) {
       for (i=0; i<no_of_nodes; i++) {
         if (VECTOR(*fixed)[i]) {
-          if (VECTOR(*membership)[i] == 0) {
+          if (VECTOR(labels)[i] == 0) {
             IGRAPH_WARNING("Fixed nodes cannot be unlabeled, ignoring them");
             VECTOR(*fixed)[i] = 0;
           } else {
             no_of_not_fixed_nodes--;
+	    VECTOR(queued)[i] = 0;
           }
         }
       }
     }
 
-    i = (long int) igraph_vector_max(membership);
-    if (i > no_of_nodes) {
-      IGRAPH_ERROR("elements of the initial labeling vector must be between 0 and |V|-1", IGRAPH_EINVAL);
-    }
-    if (i <= 0) {
+    if (no_of_nodes == 0 || igraph_vector_int_max(&labels) <= 0) {
       IGRAPH_ERROR("at least one vertex must be labeled in the initial labeling", IGRAPH_EINVAL);
     }
   } else {
     for (i=0; i<no_of_nodes; i++) {
-      VECTOR(*membership)[i] = i+1;
+      VECTOR(labels)[i] = (int) i+1;
     }
   }
 
-  /* Create an adjacency/incidence list representation for efficiency.
-   * For the unweighted case, the adjacency list is enough. For the
-   * weighted case, we need the incidence list */
-  if (weights) {
-    IGRAPH_CHECK(igraph_inclist_init(graph, &il, IGRAPH_IN));
-    IGRAPH_FINALLY(igraph_inclist_destroy, &il);
-  } else {
-    IGRAPH_CHECK(igraph_adjlist_init(graph, &al, IGRAPH_IN));
-    IGRAPH_FINALLY(igraph_adjlist_destroy, &al);
+  /* CSR snapshots for reading the labels and for activating the
+   * neighbors. They are the same for undirected graphs. */
+  IGRAPH_CHECK(igraph_csr_init(graph, &in, IGRAPH_IN, weights));
+  IGRAPH_FINALLY(igraph_csr_destroy, &in);
+  if (igraph_is_directed(graph)) {
+    IGRAPH_CHECK(igraph_csr_init(graph, &out, IGRAPH_OUT, 0));
+    IGRAPH_FINALLY(igraph_csr_destroy, &out);
   }
 
-  /* Create storage space for counting distinct labels and dominant ones */
-  IGRAPH_VECTOR_INIT_FINALLY(&label_counters, no_of_nodes+1);
-  IGRAPH_VECTOR_INIT_FINALLY(&dominant_labels, 0);
-  IGRAPH_VECTOR_INIT_FINALLY(&nonzero_labels, 0);
-  IGRAPH_CHECK(igraph_vector_reserve(&dominant_labels, 2));
+  /* The hash tables of the threads, at most half full. There are at
+   * most 'maxdeg' and at most 'no_of_nodes' different labels around
+   * a vertex. */
+  for (i=0; i<no_of_nodes; i++) {
+    long int deg=VECTOR(in.offsets)[i+1] - VECTOR(in.offsets)[i];
+    if (deg > maxdeg) { maxdeg=deg; }
+  }
+  if (maxdeg > no_of_nodes) { maxdeg=no_of_nodes; }
+  while (size < 2*maxdeg) { size *= 2; }
+  nthreads=IGRAPH_I_THREAD_COUNT(no_of_not_fixed_nodes);
+  IGRAPH_CHECK(igraph_vector_int_init(&table_keys, nthreads * (long int) size));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &table_keys);
+  IGRAPH_CHECK(igraph_vector_int_init(&table_touched,
+				      nthreads * (long int) size));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &table_touched);
+  IGRAPH_VECTOR_INIT_FINALLY(&table_counts, nthreads * (long int) size);
+  tables=igraph_Calloc(nthreads, igraph_i_lpa_table_t);
+  if (!tables) {
+    IGRAPH_ERROR("label propagation failed", IGRAPH_ENOMEM);
+  }
+  IGRAPH_FINALLY(igraph_free, tables);
+  for (i=0; i<nthreads; i++) {
+    tables[i].mask=size-1;
+    tables[i].keys=VECTOR(table_keys) + i*size;
+    tables[i].touched=VECTOR(table_touched) + i*size;
+    tables[i].counts=VECTOR(table_counts) + i*size;
+  }
+
+  IGRAPH_CHECK(igraph_vector_int_init(&active, no_of_not_fixed_nodes));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &active);
 
   RNG_BEGIN();
-
-  /* Initialize node ordering vector with only the not fixed nodes */
-  if (fixed) {
-    IGRAPH_VECTOR_INIT_FINALLY(&node_order, no_of_not_fixed_nodes);
-    for (i=0, j=0; i<no_of_nodes; i++) {
-      if (!VECTOR(*fixed)[i]) {
-        VECTOR(node_order)[j] = i;
-        j++;
-      }
-    }
-  } else {
-    IGRAPH_CHECK(igraph_vector_init_seq(&node_order, 0, no_of_nodes-1));
-    IGRAPH_FINALLY(igraph_vector_destroy, &node_order);
-  }
-
-  running = 1;
-  while (running) {
-    long int v1, num_neis;
-    igraph_real_t max_count;
-    igraph_vector_int_t *neis;
-    igraph_vector_int_t *ineis;
-    igraph_bool_t was_zero;
-
-    running = 0;
-
-    /* Shuffle the node ordering vector */
-    IGRAPH_CHECK(igraph_vector_shuffle(&node_order));
-    /* In the prescribed order, loop over the vertices and reassign labels */
-    for (i=0; i<no_of_not_fixed_nodes; i++) {
-      v1 = (long int) VECTOR(node_order)[i];
-
-      /* Count the weights corresponding to different labels */
-      igraph_vector_clear(&dominant_labels);
-      igraph_vector_clear(&nonzero_labels);
-      max_count = 0.0;
-      if (weights) {
-        ineis = igraph_inclist_get(&il, v1);
-        num_neis = igraph_vector_int_size(ineis);
-        for (j=0; j<num_neis; j++) {
-          k = (long int) VECTOR(*membership)[
-		     (long)IGRAPH_OTHER(graph, VECTOR(*ineis)[j], v1) ];
-          if (k == 0)
-            continue;   /* skip if it has no label yet */
-          was_zero = (VECTOR(label_counters)[k] == 0);
-          VECTOR(label_counters)[k] += VECTOR(*weights)[(long)VECTOR(*ineis)[j]];
-          if (was_zero && VECTOR(label_counters)[k] != 0) {
-            /* counter just became nonzero */
-            IGRAPH_CHECK(igraph_vector_push_back(&nonzero_labels, k));
-          }
-          if (max_count < VECTOR(label_counters)[k]) {
-            max_count = VECTOR(label_counters)[k];
-            IGRAPH_CHECK(igraph_vector_resize(&dominant_labels, 1));
-            VECTOR(dominant_labels)[0] = k;
-          } else if (max_count == VECTOR(label_counters)[k]) {
-            IGRAPH_CHECK(igraph_vector_push_back(&dominant_labels, k));
-          }
-        }
-      } else {
-        neis = igraph_adjlist_get(&al, v1);
-        num_neis = igraph_vector_int_size(neis);
-        for (j=0; j<num_neis; j++) {
-          k = (long int) VECTOR(*membership)[(long)VECTOR(*neis)[j]];
-          if (k == 0)
-            continue;   /* skip if it has no label yet */
-          VECTOR(label_counters)[k]++;
-          if (VECTOR(label_counters)[k] == 1) {
-            /* counter just became nonzero */
-            IGRAPH_CHECK(igraph_vector_push_back(&nonzero_labels, k));
-          }
-          if (max_count < VECTOR(label_counters)[k]) {
-            max_count = VECTOR(label_counters)[k];
-            IGRAPH_CHECK(igraph_vector_resize(&dominant_labels, 1));
-            VECTOR(dominant_labels)[0] = k;
-          } else if (max_count == VECTOR(label_counters)[k]) {
-            IGRAPH_CHECK(igraph_vector_push_back(&dominant_labels, k));
-          }
-        }
-      }
-
-      if (igraph_vector_size(&dominant_labels) > 0) {
-        /* Select randomly from the dominant labels */
-        k = RNG_INTEGER(0, igraph_vector_size(&dominant_labels)-1); 
-        k = (long int) VECTOR(dominant_labels)[k];
-        /* Check if the _current_ label of the node is also dominant */
-        if (VECTOR(label_counters)[(long)VECTOR(*membership)[v1]]!=max_count) {
-          /* Nope, we need at least one more iteration */
-          running = 1;
-        }
-        VECTOR(*membership)[v1] = k;
-      }
-
-      /* Clear the nonzero elements in label_counters */
-      num_neis = igraph_vector_size(&nonzero_labels);
-      for (j = 0; j < num_neis; j++) {
-        VECTOR(label_counters)[(long int)VECTOR(nonzero_labels)[j]] = 0;
-      }
-    }
-  }
-
+  igraph_i_lpa_propagate(&in, igraph_is_directed(graph) ? &out : &in, fixed,
+			 no_of_nodes, VECTOR(labels), VECTOR(active),
+			 VECTOR(queued), tables, nthreads, igraph_rng_default(),
+			 &interrupted);
   RNG_END();
+  IGRAPH_I_PARALLEL_INTERRUPTED(interrupted);
 
-  /* Shift back the membership vector, permute labels in increasing order */
-  /* We recycle label_counters here :) */
-  igraph_vector_fill(&label_counters, -1);
+  /* Shift back the labels, permute them in increasing order */
+  IGRAPH_VECTOR_INIT_FINALLY(&relabel, no_of_nodes+1);
+  igraph_vector_fill(&relabel, -1);
   j = 0;
   for (i=0; i<no_of_nodes; i++) {
-    k = (long)VECTOR(*membership)[i]-1;
-    if (k >= 0) {
-      if (VECTOR(label_counters)[k] == -1) {
+    k = VECTOR(labels)[i];
+    if (k > 0) {
+      if (VECTOR(relabel)[k] == -1) {
         /* We have seen this label for the first time */
-        VECTOR(label_counters)[k] = j;
-        k = j;
+        VECTOR(relabel)[k] = j;
         j++;
-      } else {
-        k = (long int) VECTOR(label_counters)[k];
       }
+      VECTOR(*membership)[i] = VECTOR(relabel)[k];
     } else {
       /* This is an unlabeled vertex */
+      VECTOR(*membership)[i] = -1;
     }
-    VECTOR(*membership)[i] = k;
   }
 
-  if (weights)
-    igraph_inclist_destroy(&il);
-  else
-    igraph_adjlist_destroy(&al);
-  IGRAPH_FINALLY_CLEAN(1);
-
   if (modularity) {
     IGRAPH_CHECK(igraph_modularity(graph, membership, modularity,
 				   weights));
   }
 
-  igraph_vector_destroy(&node_order);
-  igraph_vector_destroy(&label_counters);
-  igraph_vector_destroy(&dominant_labels);
-  igraph_vector_destroy(&nonzero_labels);
-  IGRAPH_FINALLY_CLEAN(4);
+  igraph_vector_destroy(&relabel);
+  igraph_vector_int_destroy(&active);
+  igraph_free(tables);
+  igraph_vector_destroy(&table_counts);
+  igraph_vector_int_destroy(&table_touched);
+  igraph_vector_int_destroy(&table_keys);
+  if (igraph_is_directed(graph)) {
+    igraph_csr_destroy(&out);
+    IGRAPH_FINALLY_CLEAN(1);
+  }
+  igraph_csr_destroy(&in);
+  igraph_vector_char_destroy(&queued);
+  igraph_vector_int_destroy(&labels);
+  IGRAPH_FINALLY_CLEAN(9);
 
   return 0;
 }
 
 /********************************************************************/
 
-/* Structure storing a community */
-typedef struct {
-  igraph_integer_t size;           /* Size of the community */
-  igraph_real_t weight_inside;     /* Sum of edge weights inside community */
-  igraph_real_t weight_all;        /* Sum of edge weights starting/ending
-                                      in the community */
-} igraph_i_multilevel_community;
-
-/* Global community list structure */
-typedef struct {
-  long int communities_no, vertices_no;  /* Number of communities, number of vertices */
-  igraph_real_t weight_sum;              /* Sum of edges weight in the whole graph */
-  igraph_i_multilevel_community *item;   /* List of communities */
-  igraph_vector_t *membership;           /* Community IDs */
-  igraph_vector_t *weights;        /* Graph edge weights */
-} igraph_i_multilevel_community_list;
-
-/* Computes the modularity of a community partitioning */
-igraph_real_t igraph_i_multilevel_community_modularity(
-  const igraph_i_multilevel_community_list *communities) {
-  igraph_real_t result = 0;
-  long int i;
-  igraph_real_t m = communities->weight_sum;
-  
-  for (i = 0; i < communities->vertices_no; i++) {
-    if (communities->item[i].size > 0) {
-      result += (communities->item[i].weight_inside - communities->item[i].weight_all*communities->item[i].weight_all/m)/m;
-    } 
-  }
+/*
+ * The multi-level (Louvain) and the Leiden methods work on their own
+ * compressed sparse row representation of the graph, the coarse graph
+ * of every level is built directly in this form. Every undirected
+ * edge appears in the rows of both of its endpoints, with its weight.
+ * Loop edges are not stored in the rows: 'self' contains twice their
+ * total weight, which is their contribution to the internal weight
+ * of the community of the vertex. 'node_weights' are the weights of
+ * the vertices in the null model: the strengths for modularity, i.e.
+ * the sum of the weights in the row plus 'self'.
+ */
 
-  return result;
+typedef struct igraph_i_multilevel_graph_t {
+  long int n;
+  igraph_vector_int_t offsets, neis;
+  igraph_vector_t weights, self, node_weights;
+} igraph_i_multilevel_graph_t;
+
+static void igraph_i_multilevel_graph_destroy(igraph_i_multilevel_graph_t *g) {
+  igraph_vector_destroy(&g->node_weights);
+  igraph_vector_destroy(&g->self);
+  igraph_vector_destroy(&g->weights);
+  igraph_vector_int_destroy(&g->neis);
+  igraph_vector_int_destroy(&g->offsets);
 }
 
-typedef struct {
-  long int from;
-  long int to;
-  long int id;
-} igraph_i_multilevel_link;
+static int igraph_i_multilevel_graph_init(igraph_i_multilevel_graph_t *g) {
+  g->n=0;
+  IGRAPH_CHECK(igraph_vector_int_init(&g->offsets, 1));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &g->offsets);
+  IGRAPH_CHECK(igraph_vector_int_init(&g->neis, 0));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &g->neis);
+  IGRAPH_VECTOR_INIT_FINALLY(&g->weights, 0);
+  IGRAPH_VECTOR_INIT_FINALLY(&g->self, 0);
+  IGRAPH_VECTOR_INIT_FINALLY(&g->node_weights, 0);
+  IGRAPH_FINALLY_CLEAN(5);
+  return 0;
+}
 
-int igraph_i_multilevel_link_cmp(const void *a, const void *b)
-{
-  long int r = (((igraph_i_multilevel_link*)a)->from -
-                ((igraph_i_multilevel_link*)b)->from);
-  if (r != 0) return (int) r;
-  
-  return (int) (((igraph_i_multilevel_link*)a)->to -
-		((igraph_i_multilevel_link*)b)->to);
+/* The first level, from an igraph graph */
+static int igraph_i_multilevel_graph_create(igraph_i_multilevel_graph_t *g,
+					    const igraph_t *graph,
+					    const igraph_vector_t *weights) {
+  long int no_of_nodes=igraph_vcount(graph);
+  long int i, j, k=0;
+  igraph_csr_t csr;
+
+  IGRAPH_CHECK(igraph_csr_init(graph, &csr, IGRAPH_ALL, weights));
+  IGRAPH_FINALLY(igraph_csr_destroy, &csr);
+
+  g->n=no_of_nodes;
+  IGRAPH_CHECK(igraph_vector_int_resize(&g->offsets, no_of_nodes+1));
+  IGRAPH_CHECK(igraph_vector_int_resize(&g->neis,
+					igraph_vector_int_size(&csr.neis)));
+  IGRAPH_CHECK(igraph_vector_resize(&g->weights,
+				    igraph_vector_int_size(&csr.neis)));
+  IGRAPH_CHECK(igraph_vector_resize(&g->self, no_of_nodes));
+  IGRAPH_CHECK(igraph_vector_resize(&g->node_weights, no_of_nodes));
+  igraph_vector_null(&g->self);
+  igraph_vector_null(&g->node_weights);
+
+  /* Loop edges are in the row of their vertex twice */
+  for (i=0; i<no_of_nodes; i++) {
+    VECTOR(g->offsets)[i]=k;
+    for (j=VECTOR(csr.offsets)[i]; j<VECTOR(csr.offsets)[i+1]; j++) {
+      igraph_real_t w= weights ? VECTOR(csr.weights)[j] : 1.0;
+      VECTOR(g->node_weights)[i] += w;
+      if (VECTOR(csr.neis)[j] == i) {
+	VECTOR(g->self)[i] += w;
+      } else {
+	VECTOR(g->neis)[k]=VECTOR(csr.neis)[j];
+	VECTOR(g->weights)[k]=w;
+	k++;
+      }
+    }
+  }
+  VECTOR(g->offsets)[no_of_nodes]=k;
+  IGRAPH_CHECK(igraph_vector_int_resize(&g->neis, k));
+  IGRAPH_CHECK(igraph_vector_resize(&g->weights, k));
+
+  igraph_csr_destroy(&csr);
+  IGRAPH_FINALLY_CLEAN(1);
+  return 0;
 }
 
-/* removes multiple edges and returns new edge id's for each edge in |E|log|E| */
-int igraph_i_multilevel_simplify_multiple(igraph_t *graph, igraph_vector_t *eids) {
-  long int ecount = igraph_ecount(graph);
-  long int i, l = -1, last_from = -1, last_to = -1;
-  igraph_bool_t directed = igraph_is_directed(graph);
-  igraph_integer_t from, to;
-  igraph_vector_t edges;
-  igraph_i_multilevel_link *links;
+/*
+ * Work areas, allocated once, for the number of vertices of the
+ * first level. Every thread has a 'mark' array that is -1 for every
+ * community, except while a vertex or community is being processed:
+ * then it gives the position of the community in the 'touched' list
+ * of the thread, and 'acc' holds the total weight of the edges
+ * towards it.
+ */
 
-  /* Make sure there's enough space in eids to store the new edge IDs */
-  IGRAPH_CHECK(igraph_vector_resize(eids, ecount));
+typedef struct igraph_i_multilevel_work_t {
+  int nthreads;
+  int *mark, *touched;
+  igraph_real_t *acc;
+  int *membership, *target;	/* current and proposed community */
+  igraph_real_t *w_own, *w_target; /* edge weight towards them */
+  igraph_real_t *tot, *in;	/* community node weight, internal weight */
+  int *order, *color_start;	/* vertices grouped by color */
+  int *cstart, *cverts;		/* vertices grouped by community */
+} igraph_i_multilevel_work_t;
+
+static void igraph_i_multilevel_work_destroy(igraph_i_multilevel_work_t *work) {
+  if (work->mark) { igraph_Free(work->mark); }
+  if (work->touched) { igraph_Free(work->touched); }
+  if (work->acc) { igraph_Free(work->acc); }
+  if (work->membership) { igraph_Free(work->membership); }
+  if (work->target) { igraph_Free(work->target); }
+  if (work->w_own) { igraph_Free(work->w_own); }
+  if (work->w_target) { igraph_Free(work->w_target); }
+  if (work->tot) { igraph_Free(work->tot); }
+  if (work->in) { igraph_Free(work->in); }
+  if (work->order) { igraph_Free(work->order); }
+  if (work->color_start) { igraph_Free(work->color_start); }
+  if (work->cstart) { igraph_Free(work->cstart); }
+  if (work->cverts) { igraph_Free(work->cverts); }
+}
 
-  links = igraph_Calloc(ecount, igraph_i_multilevel_link);
-  if (links == 0) {
-    IGRAPH_ERROR("multi-level community structure detection failed", IGRAPH_ENOMEM);
+static int igraph_i_multilevel_work_init(igraph_i_multilevel_work_t *work,
+					 long int no_of_nodes, int nthreads) {
+  long int n= no_of_nodes > 0 ? no_of_nodes : 1, i;
+
+  memset(work, 0, sizeof(igraph_i_multilevel_work_t));
+  IGRAPH_FINALLY(igraph_i_multilevel_work_destroy, work);
+  work->nthreads=nthreads;
+  work->mark=igraph_Calloc(work->nthreads * n, int);
+  work->touched=igraph_Calloc(work->nthreads * n, int);
+  work->acc=igraph_Calloc(work->nthreads * n, igraph_real_t);
+  work->membership=igraph_Calloc(n, int);
+  work->target=igraph_Calloc(n, int);
+  work->w_own=igraph_Calloc(n, igraph_real_t);
+  work->w_target=igraph_Calloc(n, igraph_real_t);
+  work->tot=igraph_Calloc(n, igraph_real_t);
+  work->in=igraph_Calloc(n, igraph_real_t);
+  work->order=igraph_Calloc(n, int);
+  work->color_start=igraph_Calloc(n+2, int);
+  work->cstart=igraph_Calloc(n+1, int);
+  work->cverts=igraph_Calloc(n, int);
+  if (!work->mark || !work->touched || !work->acc || !work->membership ||
+      !work->target || !work->w_own || !work->w_target || !work->tot ||
+      !work->in || !work->order || !work->color_start || !work->cstart ||
+      !work->cverts) {
+    IGRAPH_ERROR("multi-level community structure detection failed",
+		 IGRAPH_ENOMEM);
+  }
+  for (i=0; i<work->nthreads * n; i++) {
+    work->mark[i] = -1;
   }
-  IGRAPH_FINALLY(free, links);
 
-  for (i = 0; i < ecount; i++) {
-    igraph_edge(graph, (igraph_integer_t) i, &from, &to);
-    links[i].from = from;
-    links[i].to = to;
-    links[i].id = i;
-  }  
+  IGRAPH_FINALLY_CLEAN(1);
+  return 0;
+}
 
-  qsort((void*)links, (size_t) ecount, sizeof(igraph_i_multilevel_link),
-      igraph_i_multilevel_link_cmp);
+/*
+ * Greedy coloring of the vertices: adjacent vertices get different
+ * colors, so the vertices of a color class can choose their new
+ * communities at the same time, without changing each other's edge
+ * weights towards the communities. Fills 'order' and 'color_start',
+ * returns the number of colors.
+ */
 
-  IGRAPH_VECTOR_INIT_FINALLY(&edges, 0);
-  for (i = 0; i < ecount; i++) {
-    if (links[i].from == last_from && links[i].to == last_to) {
-      VECTOR(*eids)[links[i].id] = l;
-      continue;
+static long int igraph_i_multilevel_color(const igraph_i_multilevel_graph_t *g,
+					  igraph_i_multilevel_work_t *work) {
+  const int *offsets=VECTOR(g->offsets), *neis=VECTOR(g->neis);
+  int *color=work->target, *mark=work->mark, *touched=work->touched;
+  int *start=work->color_start;
+  long int i, j, no_of_colors=0;
+
+  for (i=0; i<g->n; i++) {
+    long int nt=0, c;
+    for (j=offsets[i]; j<offsets[i+1]; j++) {
+      if (neis[j] < i && mark[color[neis[j]]] < 0) {
+	mark[color[neis[j]]]=1;
+	touched[nt++]=color[neis[j]];
+      }
     }
+    for (c=0; mark[c] >= 0; c++) ;
+    color[i]=(int) c;
+    if (c >= no_of_colors) { no_of_colors=c+1; }
+    for (j=0; j<nt; j++) { mark[touched[j]] = -1; }
+  }
 
-    last_from = links[i].from;
-    last_to = links[i].to;
+  /* Counting sort by color, vertex ids are increasing within a class */
+  memset(start, 0, sizeof(int) * (size_t) (no_of_colors+1));
+  for (i=0; i<g->n; i++) { start[color[i]+1]++; }
+  for (i=0; i<no_of_colors; i++) { start[i+1] += start[i]; }
+  for (i=0; i<g->n; i++) { work->order[start[color[i]]++]=(int) i; }
+  for (i=no_of_colors; i>0; i--) { start[i]=start[i-1]; }
+  start[0]=0;
 
-    igraph_vector_push_back(&edges, last_from);
-    igraph_vector_push_back(&edges, last_to);
+  return no_of_colors;
+}
 
-    l++;
+/*
+ * Chooses the best community of vertex 'v', as if it was removed
+ * from its own community: the community with the largest modularity
+ * gain among its own and the ones of its neighbors. The gain of
+ * joining community 'c' is the weight of the edges towards 'c',
+ * minus 'resolution' times the node weight of the vertex times the
+ * node weight of 'c'. Only reads the shared data, so it can run in
+ * parallel for non-adjacent vertices.
+ */
 
-    VECTOR(*eids)[links[i].id] = l;
+static void igraph_i_multilevel_choose(const igraph_i_multilevel_graph_t *g,
+				       igraph_i_multilevel_work_t *work,
+				       int thread, long int v,
+				       igraph_real_t resolution) {
+  const int *offsets=VECTOR(g->offsets), *neis=VECTOR(g->neis);
+  const igraph_real_t *weights=VECTOR(g->weights);
+  const int *membership=work->membership;
+  const igraph_real_t *tot=work->tot;
+  long int n= g->n > 0 ? g->n : 1;
+  int *mark=work->mark + thread*n, *touched=work->touched + thread*n;
+  igraph_real_t *acc=work->acc + thread*n;
+  igraph_real_t k=VECTOR(g->node_weights)[v], w_own, best_gain;
+  int own=membership[v], best=own;
+  long int j, nt=0;
+
+  for (j=offsets[v]; j<offsets[v+1]; j++) {
+    int c=membership[neis[j]];
+    if (mark[c] < 0) {
+      mark[c]=(int) nt;
+      touched[nt]=c;
+      acc[nt++]=weights[j];
+    } else {
+      acc[mark[c]] += weights[j];
+    }
   }
 
-  free(links);
-  IGRAPH_FINALLY_CLEAN(1);
-
-  igraph_destroy(graph);
-  IGRAPH_CHECK(igraph_create(graph, &edges, igraph_vcount(graph), directed));
-
-  igraph_vector_destroy(&edges);
-  IGRAPH_FINALLY_CLEAN(1);
-
-  return 0;
+  w_own = mark[own] >= 0 ? acc[mark[own]] : 0.0;
+  best_gain = w_own - (tot[own]-k) * k * resolution;
+  work->w_own[v] = work->w_target[v] = w_own;
+  for (j=0; j<nt; j++) {
+    int c=touched[j];
+    igraph_real_t gain=acc[j] - tot[c] * k * resolution;
+    if (c != own && gain > best_gain) {
+      best=c;
+      best_gain=gain;
+      work->w_target[v]=acc[j];
+    }
+    mark[c] = -1;
+  }
+  work->target[v]=best;
 }
 
-typedef struct {
-  long int community;
-  igraph_real_t weight;
-} igraph_i_multilevel_community_link;
-
-int igraph_i_multilevel_community_link_cmp(const void *a, const void *b)
-{
-  return (int) (((igraph_i_multilevel_community_link*)a)->community -
-		((igraph_i_multilevel_community_link*)b)->community);
+static igraph_real_t igraph_i_multilevel_modularity(
+				 const igraph_i_multilevel_work_t *work,
+				 long int n, igraph_real_t m2) {
+  igraph_real_t q=0;
+  long int i;
+  if (m2 == 0) { return IGRAPH_NAN; }
+  for (i=0; i<n; i++) {
+    q += (work->in[i] - work->tot[i]*work->tot[i]/m2) / m2;
+  }
+  return q;
 }
 
-/**
- * Given a graph, a community structure and a vertex ID, this method
- * calculates:
- *
- * - edges: the list of edge IDs that are incident on the vertex
- * - weight_all: the total weight of these edges
- * - weight_inside: the total weight of edges that stay within the same
- *   community where the given vertex is right now, excluding loop edges
- * - weight_loop: the total weight of loop edges
- * - links_community and links_weight: together these two vectors list the
- *   communities incident on this vertex and the total weight of edges
- *   pointing to these communities
+/*
+ * A single step of the multi-level modularity optimization method:
+ * vertices are moved to neighboring communities while this increases
+ * the modularity. The vertices of a color class choose their new
+ * communities in parallel, then the moves are applied one by one, in
+ * the order of the vertex ids. A move is applied only if it still
+ * increases the modularity, the strengths of the communities might
+ * have changed since the choice. As the vertices of a class are not
+ * adjacent, their edge weights towards the communities did not.
+ * The result does not depend on the number of threads.
+ *
+ * Graphs with less than IGRAPH_I_MULTILEVEL_PARALLEL_MIN vertices,
+ * typically the higher levels, are not colored, their vertices are
+ * moved one by one, in the order of their ids.
+ *
+ * If 'rng' is not a null pointer, then the vertices are visited in a
+ * random order instead: within their color class, or all of them if
+ * they are not colored. Interruption is reported in 'interrupted'.
+ * The step does not allocate memory and does not call the error
+ * handler, igraph_community_ensemble() runs it in parallel.
+ *
+ * Afterwards the 'membership' array of 'work' contains the new
+ * communities, renumbered from zero without gaps, keeping their
+ * order, like igraph_reindex_membership() does.
  */
-int igraph_i_multilevel_community_links(const igraph_t *graph,
-  const igraph_i_multilevel_community_list *communities,
-  igraph_integer_t vertex, igraph_vector_t *edges,
-  igraph_real_t *weight_all, igraph_real_t *weight_inside, igraph_real_t *weight_loop,
-  igraph_vector_t *links_community, igraph_vector_t *links_weight) {
-  
-  long int i, n, last = -1, c = -1;
-  igraph_real_t weight = 1;
-  long int to, to_community;
-  long int community = (long int) VECTOR(*(communities->membership))[(long int)vertex];
-  igraph_i_multilevel_community_link *links;
-
-  *weight_all = *weight_inside = *weight_loop = 0;
-
-  igraph_vector_clear(links_community);
-  igraph_vector_clear(links_weight);
 
-  /* Get the list of incident edges */
-  igraph_incident(graph, edges, vertex, IGRAPH_ALL);
+#define IGRAPH_I_MULTILEVEL_PARALLEL_MIN 10000
+
+static int igraph_i_community_multilevel_step(
+				 const igraph_i_multilevel_graph_t *g,
+				 igraph_i_multilevel_work_t *work,
+				 long int *no_of_communities,
+				 igraph_real_t *modularity,
+				 igraph_rng_t *rng,
+				 igraph_bool_t *interrupted) {
+  long int n=g->n, i, no_of_colors, color, no_of_comms;
+  int *membership=work->membership;
+  igraph_real_t m2=igraph_vector_sum(&g->node_weights), q, pass_q;
+  igraph_real_t resolution= m2 > 0 ? 1.0/m2 : 0.0;
+  igraph_bool_t changed;
 
-  n = igraph_vector_size(edges);
-  links = igraph_Calloc(n, igraph_i_multilevel_community_link);
-  if (links == 0) {
-    IGRAPH_ERROR("multi-level community structure detection failed", IGRAPH_ENOMEM);
+  for (i=0; i<n; i++) {
+    membership[i]=(int) i;
+    work->tot[i]=VECTOR(g->node_weights)[i];
+    work->in[i]=VECTOR(g->self)[i];
   }
-  IGRAPH_FINALLY(igraph_free, links);
-
-  for (i = 0; i < n; i++) {
-    long int eidx = (long int) VECTOR(*edges)[i];
-    weight = VECTOR(*communities->weights)[eidx];
-
-    to = IGRAPH_OTHER(graph, eidx, vertex);
-
-    *weight_all += weight;
-    if (to == vertex) {
-      *weight_loop += weight;
-      
-      links[i].community = community;
-      links[i].weight = 0;
-      continue;
+  q=igraph_i_multilevel_modularity(work, n, m2);
+  if (n >= IGRAPH_I_MULTILEVEL_PARALLEL_MIN) {
+    no_of_colors=igraph_i_multilevel_color(g, work);
+  } else {
+    /* Every vertex is a class of its own, this is the sequential
+       method of the original paper */
+    for (i=0; i<=n; i++) {
+      work->color_start[i]=(int) i;
+      if (i < n) { work->order[i]=(int) i; }
     }
-
-    to_community = (long int)VECTOR(*(communities->membership))[to];
-    if (community == to_community)
-      *weight_inside += weight;
-
-    /* debug("Link %ld (C: %ld) <-> %ld (C: %ld)\n", vertex, community, to, to_community); */
-    
-    links[i].community = to_community;
-    links[i].weight = weight;
-  }
-
-  /* Sort links by community ID and merge the same */
-  qsort((void*)links, (size_t) n, sizeof(igraph_i_multilevel_community_link),
-      igraph_i_multilevel_community_link_cmp);
-  for (i = 0; i < n; i++) {
-    to_community = links[i].community;
-    if (to_community != last) {
-      igraph_vector_push_back(links_community, to_community);
-      igraph_vector_push_back(links_weight, links[i].weight);
-      last = to_community;
-      c++;
-    } else {    
-      VECTOR(*links_weight)[c] += links[i].weight;
+    no_of_colors=n;
+  }
+  if (rng) {
+    /* Random order within the color classes, or of all vertices if
+       every vertex is a class of its own */
+    igraph_bool_t colored= n >= IGRAPH_I_MULTILEVEL_PARALLEL_MIN;
+    long int c, no_of_ranges= colored ? no_of_colors : 1;
+    for (c=0; c<no_of_ranges; c++) {
+      long int first= colored ? work->color_start[c] : 0;
+      long int last= colored ? work->color_start[c+1] : n;
+      for (i=last-1; i>first; i--) {
+	long int k=igraph_rng_get_integer(rng, first, i);
+	int tmp=work->order[i];
+	work->order[i]=work->order[k];
+	work->order[k]=tmp;
+      }
     }
   }
 
-  igraph_free(links);
-  IGRAPH_FINALLY_CLEAN(1);
-
-  return 0;
-}
+  do {
+    pass_q=q;
+    changed=0;
 
-igraph_real_t igraph_i_multilevel_community_modularity_gain(
-  const igraph_i_multilevel_community_list *communities,
-  igraph_integer_t community, igraph_integer_t vertex,
-  igraph_real_t weight_all, igraph_real_t weight_inside) {
-  IGRAPH_UNUSED(vertex);
-  return weight_inside -
-      communities->item[(long int)community].weight_all*weight_all/communities->weight_sum;
-}
+    for (color=0; m2 > 0 && color<no_of_colors; color++) {
+      long int first=work->color_start[color];
+      long int last=work->color_start[color+1];
 
-/* Shrinks communities into single vertices, keeping all the edges.
- * This method is internal because it destroys the graph in-place and
- * creates a new one -- this is fine for the multilevel community
- * detection where a copy of the original graph is used anyway.
- * The membership vector will also be rewritten by the underlying
- * igraph_membership_reindex call */
-int igraph_i_multilevel_shrink(igraph_t *graph, igraph_vector_t *membership) {
-  igraph_vector_t edges;
-  long int no_of_nodes = igraph_vcount(graph);
-  long int no_of_edges = igraph_ecount(graph);
-  igraph_bool_t directed = igraph_is_directed(graph);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(work->nthreads) if(last-first > 1000) \
+  schedule(dynamic, 256)
+#endif
+      for (i=first; i<last; i++) {
+	igraph_i_multilevel_choose(g, work, IGRAPH_I_THREAD_NUM(),
+				   work->order[i], resolution);
+      }
 
-  long int i;
-  igraph_eit_t eit;
+      for (i=first; i<last; i++) {
+	long int v=work->order[i];
+	int own=membership[v], target=work->target[v];
+	igraph_real_t k=VECTOR(g->node_weights)[v];
+	if (target == own ||
+	    work->w_target[v] - work->tot[target] * k * resolution <=
+	    work->w_own[v] - (work->tot[own]-k) * k * resolution) {
+	  continue;
+	}
+	work->tot[own] -= k;
+	work->in[own] -= 2*work->w_own[v] + VECTOR(g->self)[v];
+	work->tot[target] += k;
+	work->in[target] += 2*work->w_target[v] + VECTOR(g->self)[v];
+	membership[v]=target;
+	changed=1;
+      }
+    }
 
-  if (no_of_nodes == 0)
-    return 0;
+    q=igraph_i_multilevel_modularity(work, n, m2);
+    IGRAPH_I_PARALLEL_ALLOW_INTERRUPTION(*interrupted);
+    if (*interrupted) { return 0; }
+  } while (changed && q > pass_q);
 
-  if (igraph_vector_size(membership) < no_of_nodes) {
-    IGRAPH_ERROR("cannot shrink graph, membership vector too short",
-        IGRAPH_EINVAL);
+  if (modularity) {
+    *modularity = q;
   }
 
-  IGRAPH_VECTOR_INIT_FINALLY(&edges, no_of_edges * 2);
-
-  IGRAPH_CHECK(igraph_reindex_membership(membership, 0));
-
-  /* Create the new edgelist */
-  igraph_eit_create(graph, igraph_ess_all(IGRAPH_EDGEORDER_ID), &eit);
-  IGRAPH_FINALLY(igraph_eit_destroy, &eit);
-  i = 0;
-  while (!IGRAPH_EIT_END(eit)) {
-    igraph_integer_t from, to;
-    IGRAPH_CHECK(igraph_edge(graph, IGRAPH_EIT_GET(eit), &from, &to));
-    VECTOR(edges)[i++] = VECTOR(*membership)[(long int) from];
-    VECTOR(edges)[i++] = VECTOR(*membership)[(long int) to];
-    IGRAPH_EIT_NEXT(eit);
+  /* Renumber the communities, the 'target' array is free now */
+  for (i=0; i<n; i++) { work->target[i] = -1; }
+  for (i=0; i<n; i++) { work->target[membership[i]] = 0; }
+  for (i=0, no_of_comms=0; i<n; i++) {
+    if (work->target[i] == 0) { work->target[i] = (int) no_of_comms++; }
   }
-  igraph_eit_destroy(&eit);
-  IGRAPH_FINALLY_CLEAN(1);
-
-  /* Create the new graph */
-  igraph_destroy(graph);
-  no_of_nodes = (long int) igraph_vector_max(membership)+1;
-  IGRAPH_CHECK(igraph_create(graph, &edges, (igraph_integer_t) no_of_nodes,
-			     directed));
-
-  igraph_vector_destroy(&edges);
-  IGRAPH_FINALLY_CLEAN(1);
+  for (i=0; i<n; i++) { membership[i] = work->target[membership[i]]; }
 
+  *no_of_communities=no_of_comms;
   return 0;
 }
 
-/**
- * \ingroup communities
- * \function igraph_i_community_multilevel_step
- * \brief Performs a single step of the multi-level modularity optimization method
- *
- * This function implements a single step of the multi-level modularity optimization
- * algorithm for finding community structure, see VD Blondel, J-L Guillaume,
- * R Lambiotte and E Lefebvre: Fast unfolding of community hierarchies in large
- * networks, http://arxiv.org/abs/0803.0476 for the details.
- *
- * This function was contributed by Tom Gregorovic.
- *
- * \param graph   The input graph. It must be an undirected graph.
- * \param weights Numeric vector containing edge weights. If \c NULL, every edge
- *     has equal weight. The weights are expected to be non-negative.
- * \param membership The membership vector, the result is returned here.
- *     For each vertex it gives the ID of its community.
- * \param modularity The modularity of the partition is returned here.
- *     \c NULL means that the modularity is not needed.
- * \return Error code.
- *
- * Time complexity: in average near linear on sparse graphs.
+/*
+ * Builds the graph of the next level: every community becomes a
+ * single vertex. The rows are computed in parallel, in two passes,
+ * the first one counts the neighboring communities and the second
+ * one fills the rows. Memory is only allocated if the vectors of
+ * 'coarse' are not large enough.
  */
-int igraph_i_community_multilevel_step(igraph_t *graph,
-  igraph_vector_t *weights, igraph_vector_t *membership,
-  igraph_real_t *modularity) {
-  
-  long int i, j;
-  long int vcount = igraph_vcount(graph);
-  long int ecount = igraph_ecount(graph);
-  igraph_integer_t ffrom, fto;
-  igraph_real_t q, pass_q;
+
+static int igraph_i_multilevel_aggregate(const igraph_i_multilevel_graph_t *g,
+					 igraph_i_multilevel_work_t *work,
+					 const int *membership,
+					 long int no_of_comms,
+					 igraph_i_multilevel_graph_t *coarse) {
+  int *cstart=work->cstart, *cverts=work->cverts;
+  long int i, n= g->n > 0 ? g->n : 1, c;
   int pass;
-  igraph_bool_t changed = 0;
-  igraph_vector_t links_community;
-  igraph_vector_t links_weight;
-  igraph_vector_t edges;
-  igraph_vector_t temp_membership;
-  igraph_i_multilevel_community_list communities;
 
-  /* Initial sanity checks on the input parameters */
-  if (igraph_is_directed(graph)) {
-    IGRAPH_ERROR("multi-level community detection works for undirected graphs only",
-        IGRAPH_UNIMPLEMENTED);
+  /* Vertices grouped by community */
+  memset(cstart, 0, sizeof(int) * (size_t) (no_of_comms+1));
+  for (i=0; i<g->n; i++) { cstart[membership[i]+1]++; }
+  for (i=0; i<no_of_comms; i++) {
+    cstart[i+1] += cstart[i];
   }
-  if (igraph_vector_size(weights) < igraph_ecount(graph))
-    IGRAPH_ERROR("multi-level community detection: weight vector too short", IGRAPH_EINVAL);
-  if (igraph_vector_any_smaller(weights, 0))
-    IGRAPH_ERROR("weights must be positive", IGRAPH_EINVAL);
-
-  /* Initialize data structures */
-  IGRAPH_VECTOR_INIT_FINALLY(&links_community, 0);
-  IGRAPH_VECTOR_INIT_FINALLY(&links_weight, 0);
-  IGRAPH_VECTOR_INIT_FINALLY(&edges, 0);
-  IGRAPH_VECTOR_INIT_FINALLY(&temp_membership, vcount);
-  IGRAPH_CHECK(igraph_vector_resize(membership, vcount));
- 
-  /* Initialize list of communities from graph vertices */
-  communities.vertices_no = vcount;
-  communities.communities_no = vcount;
-  communities.weights = weights;
-  communities.weight_sum = 2 * igraph_vector_sum(weights);
-  communities.membership = membership;
-  communities.item = igraph_Calloc(vcount, igraph_i_multilevel_community);
-  if (communities.item == 0) {
-    IGRAPH_ERROR("multi-level community structure detection failed", IGRAPH_ENOMEM);
-  }
-  IGRAPH_FINALLY(igraph_free, communities.item);
-
-  /* Still initializing the communities data structure */
-  for (i=0; i < vcount; i++) {
-    VECTOR(*communities.membership)[i] = i;
-    communities.item[i].size = 1;
-    communities.item[i].weight_inside = 0;
-    communities.item[i].weight_all = 0;
-  }
-
-  /* Some more initialization :) */
-  for (i = 0; i < ecount; i++) {
-    igraph_real_t weight = 1;
-    igraph_edge(graph, (igraph_integer_t) i, &ffrom, &fto);
-
-    weight = VECTOR(*weights)[i];
-    communities.item[(long int) ffrom].weight_all += weight;
-    communities.item[(long int) fto].weight_all += weight;
-    if (ffrom == fto)
-      communities.item[(long int) ffrom].weight_inside += 2*weight;
-  }
-
-  q = igraph_i_multilevel_community_modularity(&communities);
-  pass = 1;
-
-  do { /* Pass begin */
-    long int temp_communities_no = communities.communities_no;
-
-    pass_q = q;
-    changed = 0;
-    
-    /* Save the current membership, it will be restored in case of worse result */
-    IGRAPH_CHECK(igraph_vector_update(&temp_membership, communities.membership));
-
-    for (i = 0; i < vcount; i++) {
-      /* Exclude vertex from its current community */
-      igraph_real_t weight_all = 0;
-      igraph_real_t weight_inside = 0;
-      igraph_real_t weight_loop = 0;
-      igraph_real_t max_q_gain = 0;
-      igraph_real_t max_weight;
-      long int old_id, new_id, n;
-
-      igraph_i_multilevel_community_links(graph, &communities, 
-					  (igraph_integer_t) i, &edges,
-					  &weight_all, &weight_inside, 
-					  &weight_loop, &links_community,
-					  &links_weight);
-
-      old_id = (long int)VECTOR(*(communities.membership))[i];
-      new_id = old_id;
-
-      /* Update old community */
-      igraph_vector_set(communities.membership, i, -1);
-      communities.item[old_id].size--;
-      if (communities.item[old_id].size == 0) {communities.communities_no--;}
-      communities.item[old_id].weight_all -= weight_all;
-      communities.item[old_id].weight_inside -= 2*weight_inside + weight_loop;
-
-      /* debug("Remove %ld all: %lf Inside: %lf\n", i, -weight_all, -2*weight_inside + weight_loop); */
-
-      /* Find new community to join with the best modification gain */
-      max_q_gain = 0;
-      max_weight = weight_inside;
-      n = igraph_vector_size(&links_community);
-
-      for (j = 0; j < n; j++) {
-        long int c = (long int) VECTOR(links_community)[j];
-        igraph_real_t w = VECTOR(links_weight)[j];
-
-        igraph_real_t q_gain = 
-	  igraph_i_multilevel_community_modularity_gain(&communities, 
-							(igraph_integer_t) c, 
-							(igraph_integer_t) i,
-							weight_all, w);
-        /* debug("Link %ld -> %ld weight: %lf gain: %lf\n", i, c, (double) w, (double) q_gain); */
-        if (q_gain > max_q_gain) {
-          new_id = c;
-          max_q_gain = q_gain;
-          max_weight = w;
-        }
-      }
-
-      /* debug("Added vertex %ld to community %ld (gain %lf).\n", i, new_id, (double) max_q_gain); */
+  for (i=0; i<g->n; i++) {
+    cverts[cstart[membership[i]]++]=(int) i;
+  }
+  for (i=no_of_comms; i>0; i--) { cstart[i]=cstart[i-1]; }
+  cstart[0]=0;
 
-      /* Add vertex to "new" community and update it */
-      igraph_vector_set(communities.membership, i, new_id);
-      if (communities.item[new_id].size == 0) {communities.communities_no++;}
-      communities.item[new_id].size++;
-      communities.item[new_id].weight_all += weight_all;
-      communities.item[new_id].weight_inside += 2*max_weight + weight_loop;
+  coarse->n=no_of_comms;
+  IGRAPH_CHECK(igraph_vector_int_resize(&coarse->offsets, no_of_comms+1));
+  IGRAPH_CHECK(igraph_vector_resize(&coarse->self, no_of_comms));
+  IGRAPH_CHECK(igraph_vector_resize(&coarse->node_weights, no_of_comms));
+  VECTOR(coarse->offsets)[0]=0;
 
-      if (new_id != old_id) {
-        changed++;
+  for (pass=0; pass<2; pass++) {
+    if (pass == 1) {
+      for (c=0; c<no_of_comms; c++) {
+	VECTOR(coarse->offsets)[c+1] += VECTOR(coarse->offsets)[c];
       }
+      IGRAPH_CHECK(igraph_vector_int_resize(&coarse->neis,
+				    VECTOR(coarse->offsets)[no_of_comms]));
+      IGRAPH_CHECK(igraph_vector_resize(&coarse->weights,
+				    VECTOR(coarse->offsets)[no_of_comms]));
     }
 
-    q = igraph_i_multilevel_community_modularity(&communities);
-
-    if (changed && (q > pass_q)) { 
-      /* debug("Pass %d (changed: %d) Communities: %ld Modularity from %lf to %lf\n",
-        pass, changed, communities.communities_no, (double) pass_q, (double) q); */
-      pass++;
-    } else {
-      /* No changes or the modularity became worse, restore last membership */
-      IGRAPH_CHECK(igraph_vector_update(communities.membership, &temp_membership));
-      communities.communities_no = temp_communities_no;
-      break;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(work->nthreads) schedule(dynamic, 64)
+#endif
+    for (c=0; c<no_of_comms; c++) {
+      const int *offsets=VECTOR(g->offsets), *neis=VECTOR(g->neis);
+      const igraph_real_t *weights=VECTOR(g->weights);
+      int thread=IGRAPH_I_THREAD_NUM();
+      int *mark=work->mark + thread*n, *touched=work->touched + thread*n;
+      int *cneis= pass ? VECTOR(coarse->neis) : 0;
+      igraph_real_t *cweights= pass ? VECTOR(coarse->weights) : 0;
+      igraph_real_t self=0, node_weight=0;
+      long int k, j, nt=0, pos= pass ? VECTOR(coarse->offsets)[c] : 0;
+      for (k=cstart[c]; k<cstart[c+1]; k++) {
+	long int v=cverts[k];
+	self += VECTOR(g->self)[v];
+	node_weight += VECTOR(g->node_weights)[v];
+	for (j=offsets[v]; j<offsets[v+1]; j++) {
+	  int d=membership[neis[j]];
+	  if (d == c) {
+	    self += weights[j];
+	  } else if (mark[d] < 0) {
+	    mark[d]=(int) (pos+nt);
+	    touched[nt++]=d;
+	    if (pass) { cneis[mark[d]]=d; cweights[mark[d]]=weights[j]; }
+	  } else if (pass) {
+	    cweights[mark[d]] += weights[j];
+	  }
+	}
+      }
+      for (j=0; j<nt; j++) { mark[touched[j]] = -1; }
+      if (pass) {
+	VECTOR(coarse->self)[c]=self;
+	VECTOR(coarse->node_weights)[c]=node_weight;
+      } else {
+	VECTOR(coarse->offsets)[c+1]=(int) nt;
+      }
     }
-
-    IGRAPH_ALLOW_INTERRUPTION();
-  } while (changed && (q > pass_q)); /* Pass end */
-
-  if (modularity) {
-    *modularity = q;
-  }
-
-  /* debug("Result Communities: %ld Modularity: %lf\n",
-    communities.communities_no, (double) q); */
-
-  IGRAPH_CHECK(igraph_reindex_membership(membership, 0));
-
-  /* Shrink the nodes of the graph according to the present community structure
-   * and simplify the resulting graph */
-
-  /* TODO: check if we really need to copy temp_membership */
-  IGRAPH_CHECK(igraph_vector_update(&temp_membership, membership));
-  IGRAPH_CHECK(igraph_i_multilevel_shrink(graph, &temp_membership));
-  igraph_vector_destroy(&temp_membership);
-  IGRAPH_FINALLY_CLEAN(1);  
-  
-  /* Update edge weights after shrinking and simplification */
-  /* Here we reuse the edges vector as we don't need the previous contents anymore */
-  /* TODO: can we use igraph_simplify here? */
-  IGRAPH_CHECK(igraph_i_multilevel_simplify_multiple(graph, &edges));
-
-  /* We reuse the links_weight vector to store the old edge weights */
-  IGRAPH_CHECK(igraph_vector_update(&links_weight, weights));
-  igraph_vector_fill(weights, 0);
-   
-  for (i = 0; i < ecount; i++) {
-    VECTOR(*weights)[(long int)VECTOR(edges)[i]] += VECTOR(links_weight)[i];
   }
 
-  igraph_free(communities.item);
-  igraph_vector_destroy(&links_community);
-  igraph_vector_destroy(&links_weight);
-  igraph_vector_destroy(&edges);
-  IGRAPH_FINALLY_CLEAN(4);
-  
   return 0;
 }
 
@@ -2869,6 +3829,13 @@ int igraph_i_community_multilevel_step(igraph_t *graph,
  * The process stops when there is only a single vertex left or when the modularity
  * cannot be increased any more in a step.
  *
+ * </para><para>
+ * If igraph was compiled with OpenMP support, the re-assignment step
+ * runs in parallel on large graphs. The vertices are colored, so that
+ * no two adjacent vertices have the same color, and the vertices of
+ * the same color choose their new communities at the same time. The
+ * result does not depend on the number of threads.
+ *
  * This function was contributed by Tom Gregorovic.
  *
  * \param graph The input graph. It must be an undirected graph.
@@ -2894,25 +3861,34 @@ int igraph_community_multilevel(const igraph_t *graph,
   const igraph_vector_t *weights, igraph_vector_t *membership,
   igraph_matrix_t *memberships, igraph_vector_t *modularity) {
  
-  igraph_t g;
-  igraph_vector_t w, m, level_membership;
+  igraph_i_multilevel_graph_t levels[2];
+  igraph_i_multilevel_work_t work;
+  igraph_vector_t level_membership;
   igraph_real_t prev_q = -1, q = -1;
-  int i, level = 1;
-  long int vcount = igraph_vcount(graph);
-
-  /* Make a copy of the original graph, we will do the merges on the copy */
-  IGRAPH_CHECK(igraph_copy(&g, graph));
-  IGRAPH_FINALLY(igraph_destroy, &g);
+  int i, level = 1, cur = 0;
+  long int vcount = igraph_vcount(graph), no_of_comms;
+  igraph_bool_t interrupted = 0;
 
-  if (weights) {
-    IGRAPH_CHECK(igraph_vector_copy(&w, weights));   
-    IGRAPH_FINALLY(igraph_vector_destroy, &w);  
-  } else {
-    IGRAPH_VECTOR_INIT_FINALLY(&w, igraph_ecount(&g));
-    igraph_vector_fill(&w, 1);
+  /* Initial sanity checks on the input parameters */
+  if (igraph_is_directed(graph)) {
+    IGRAPH_ERROR("multi-level community detection works for undirected graphs only",
+        IGRAPH_UNIMPLEMENTED);
   }
+  if (weights && igraph_vector_size(weights) != igraph_ecount(graph))
+    IGRAPH_ERROR("multi-level community detection: invalid weight vector length", IGRAPH_EINVAL);
+  if (weights && igraph_vector_any_smaller(weights, 0))
+    IGRAPH_ERROR("weights must be positive", IGRAPH_EINVAL);
+
+  /* The graphs of the current and the next level */
+  IGRAPH_CHECK(igraph_i_multilevel_graph_init(&levels[0]));
+  IGRAPH_FINALLY(igraph_i_multilevel_graph_destroy, &levels[0]);
+  IGRAPH_CHECK(igraph_i_multilevel_graph_init(&levels[1]));
+  IGRAPH_FINALLY(igraph_i_multilevel_graph_destroy, &levels[1]);
+  IGRAPH_CHECK(igraph_i_multilevel_graph_create(&levels[0], graph, weights));
 
-  IGRAPH_VECTOR_INIT_FINALLY(&m, vcount);
+  IGRAPH_CHECK(igraph_i_multilevel_work_init(&work, vcount,
+					       IGRAPH_I_THREAD_COUNT(vcount)));
+  IGRAPH_FINALLY(igraph_i_multilevel_work_destroy, &work);
   IGRAPH_VECTOR_INIT_FINALLY(&level_membership, vcount);
 
   if (memberships || membership) {
@@ -2932,19 +3908,22 @@ int igraph_community_multilevel(const igraph_t *graph,
   
   while (1) {
     /* Remember the previous modularity and vertex count, do a single step */
-    igraph_integer_t step_vcount = igraph_vcount(&g);
+    long int step_vcount = levels[cur].n;
 
     prev_q = q;
-    IGRAPH_CHECK(igraph_i_community_multilevel_step(&g, &w, &m, &q));
+    IGRAPH_CHECK(igraph_i_community_multilevel_step(&levels[cur], &work,
+						    &no_of_comms, &q, 0,
+						    &interrupted));
+    IGRAPH_I_PARALLEL_INTERRUPTED(interrupted);
 
     /* Were there any merges? If not, we have to stop the process */
-    if (igraph_vcount(&g) == step_vcount || q < prev_q)
+    if (no_of_comms == step_vcount || q < prev_q)
       break;
 
     if (memberships || membership) {
       for (i = 0; i < vcount; i++) {
         /* Readjust the membership vector */
-        VECTOR(level_membership)[i] = VECTOR(m)[(long int) VECTOR(level_membership)[i]];
+        VECTOR(level_membership)[i] = work.membership[(long int) VECTOR(level_membership)[i]];
       }
     }
 
@@ -2960,8 +3939,11 @@ int igraph_community_multilevel(const igraph_t *graph,
       IGRAPH_CHECK(igraph_matrix_set_row(memberships, &level_membership, level - 1));
     }
 
-    /* debug("Level: %d Communities: %ld Modularity: %f\n", level, (long int) igraph_vcount(&g),
-      (double) q); */
+    /* Shrink the communities to single vertices for the next level */
+    IGRAPH_CHECK(igraph_i_multilevel_aggregate(&levels[cur], &work,
+					       work.membership, no_of_comms,
+					       &levels[1-cur]));
+    cur = 1-cur;
 
     /* Increase the level counter */
     level++;
@@ -2990,19 +3972,987 @@ int igraph_community_multilevel(const igraph_t *graph,
     }
   }
 
-  /* Destroy the copy of the graph */
-  igraph_destroy(&g);
-
-  /* Destroy the temporary vectors */
-  igraph_vector_destroy(&m);
-  igraph_vector_destroy(&w);
   igraph_vector_destroy(&level_membership);
+  igraph_i_multilevel_work_destroy(&work);
+  igraph_i_multilevel_graph_destroy(&levels[1]);
+  igraph_i_multilevel_graph_destroy(&levels[0]);
   IGRAPH_FINALLY_CLEAN(4);
 
   return 0;
 }
 
 
+/*
+ * The Leiden method, see V.A. Traag, L. Waltman and N.J. van Eck: From
+ * Louvain to Leiden: guaranteeing well-connected communities,
+ * Scientific Reports 9, 5233 (2019). It works on the graph
+ * representation of the multi-level method, and uses its aggregation
+ * and its work areas. The current communities are in the
+ * 'membership' array of the work area, their total node weight in
+ * 'tot'. The additional work areas of the method are below, all of
+ * them have one element for every vertex.
+ */
+
+typedef struct igraph_i_leiden_work_t {
+  igraph_vector_int_t csize;	/* number of vertices in the communities */
+  igraph_vector_int_t empty;	/* stack of unused community ids */
+  igraph_vector_bool_t queued;	/* vertices in the queue */
+  igraph_vector_int_t refined;	/* refined communities */
+  igraph_vector_int_t rsize;	/* number of vertices in them */
+  igraph_vector_t rtot;		/* their total node weight */
+  igraph_vector_t rext;		/* their edge weight to the rest of the
+				   community */
+  igraph_vector_int_t cstart, cverts; /* vertices grouped by community */
+  igraph_vector_t prob;		/* choice probabilities */
+  igraph_vector_int_t level_of;	/* vertex of the current level */
+} igraph_i_leiden_work_t;
+
+static void igraph_i_leiden_work_destroy(igraph_i_leiden_work_t *lw) {
+  igraph_vector_int_destroy(&lw->level_of);
+  igraph_vector_destroy(&lw->prob);
+  igraph_vector_int_destroy(&lw->cverts);
+  igraph_vector_int_destroy(&lw->cstart);
+  igraph_vector_destroy(&lw->rext);
+  igraph_vector_destroy(&lw->rtot);
+  igraph_vector_int_destroy(&lw->rsize);
+  igraph_vector_int_destroy(&lw->refined);
+  igraph_vector_bool_destroy(&lw->queued);
+  igraph_vector_int_destroy(&lw->empty);
+  igraph_vector_int_destroy(&lw->csize);
+}
+
+static int igraph_i_leiden_work_init(igraph_i_leiden_work_t *lw,
+				     long int n) {
+  IGRAPH_CHECK(igraph_vector_int_init(&lw->csize, n));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &lw->csize);
+  IGRAPH_CHECK(igraph_vector_int_init(&lw->empty, n));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &lw->empty);
+  IGRAPH_CHECK(igraph_vector_bool_init(&lw->queued, n));
+  IGRAPH_FINALLY(igraph_vector_bool_destroy, &lw->queued);
+  IGRAPH_CHECK(igraph_vector_int_init(&lw->refined, n));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &lw->refined);
+  IGRAPH_CHECK(igraph_vector_int_init(&lw->rsize, n));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &lw->rsize);
+  IGRAPH_VECTOR_INIT_FINALLY(&lw->rtot, n);
+  IGRAPH_VECTOR_INIT_FINALLY(&lw->rext, n);
+  IGRAPH_CHECK(igraph_vector_int_init(&lw->cstart, n+1));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &lw->cstart);
+  IGRAPH_CHECK(igraph_vector_int_init(&lw->cverts, n));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &lw->cverts);
+  IGRAPH_VECTOR_INIT_FINALLY(&lw->prob, n);
+  IGRAPH_CHECK(igraph_vector_int_init(&lw->level_of, n));
+  IGRAPH_FINALLY_CLEAN(10);
+  return 0;
+}
+
+/*
+ * Renumbers the communities in 'membership' from zero without gaps,
+ * keeping their order, using 'tmp' as a work area. Returns the
+ * number of communities.
+ */
+
+static long int igraph_i_leiden_renumber(int *membership, long int n,
+					 int *tmp) {
+  long int i, no_of_comms=0;
+  for (i=0; i<n; i++) { tmp[i] = -1; }
+  for (i=0; i<n; i++) { tmp[membership[i]] = 0; }
+  for (i=0; i<n; i++) {
+    if (tmp[i] == 0) { tmp[i] = (int) no_of_comms++; }
+  }
+  for (i=0; i<n; i++) { membership[i] = tmp[membership[i]]; }
+  return no_of_comms;
+}
+
+/*
+ * Fast local moving. The vertices are put in a queue, in random
+ * order. The first vertex of the queue moves to the community with
+ * the largest gain, or to an empty community if every gain is
+ * negative. If it moved, its neighbors outside of its new community
+ * are queued again, unless they are already in the queue. Unlike in
+ * the multi-level method, there are no full sweeps over the vertices.
+ */
+
+static void igraph_i_leiden_fastmove(const igraph_i_multilevel_graph_t *g,
+				     igraph_i_multilevel_work_t *work,
+				     igraph_i_leiden_work_t *lw,
+				     igraph_real_t resolution) {
+  const int *offsets=VECTOR(g->offsets), *neis=VECTOR(g->neis);
+  int *membership=work->membership, *queue=work->order;
+  int *csize=VECTOR(lw->csize), *empty=VECTOR(lw->empty);
+  igraph_bool_t *queued=VECTOR(lw->queued);
+  igraph_real_t *tot=work->tot;
+  long int n=g->n, i, j, head=0, count=n, no_of_empty=0;
+
+  igraph_vector_int_null(&lw->csize);
+  memset(tot, 0, sizeof(igraph_real_t) * (size_t) n);
+  for (i=0; i<n; i++) {
+    csize[membership[i]]++;
+    tot[membership[i]] += VECTOR(g->node_weights)[i];
+  }
+  for (i=n-1; i>=0; i--) {
+    if (csize[i] == 0) { empty[no_of_empty++]=(int) i; }
+  }
+
+  for (i=0; i<n; i++) {
+    long int k=RNG_INTEGER(0, i);
+    queue[i]=queue[k];
+    queue[k]=(int) i;
+    queued[i]=1;
+  }
+
+  while (count > 0) {
+    long int v=queue[head];
+    int own=membership[v], best;
+    igraph_real_t k=VECTOR(g->node_weights)[v], best_gain;
+
+    head = (head+1) % n;
+    count--;
+    queued[v]=0;
+
+    igraph_i_multilevel_choose(g, work, /*thread=*/ 0, v, resolution);
+    best=work->target[v];
+    best_gain = best == own ?
+      work->w_own[v] - (tot[own]-k) * k * resolution :
+      work->w_target[v] - tot[best] * k * resolution;
+    if (best_gain < 0 && csize[own] > 1) {
+      best=empty[--no_of_empty];
+    }
+    if (best == own) { continue; }
+
+    tot[own] -= k;
+    tot[best] += k;
+    csize[best]++;
+    if (--csize[own] == 0) { empty[no_of_empty++]=own; }
+    membership[v]=best;
+
+    for (j=offsets[v]; j<offsets[v+1]; j++) {
+      long int u=neis[j];
+      if (!queued[u] && membership[u] != best) {
+	queue[(head+count) % n]=(int) u;
+	queued[u]=1;
+	count++;
+      }
+    }
+  }
+}
+
+/*
+ * Refinement: every community is split into refined communities
+ * that are well connected. The refined communities start as
+ * singletons. The singleton vertices that are well connected to the
+ * rest of their community are visited in random order, and they may
+ * join a well connected refined community of the same community, if
+ * this does not decrease the quality. The choice is random, the
+ * probability is proportional to exp(gain/beta), so that a zero
+ * 'beta' means the largest gain. Returns the number of refined
+ * communities, the communities are in 'refined'.
+ */
+
+static long int igraph_i_leiden_refine(const igraph_i_multilevel_graph_t *g,
+				       igraph_i_multilevel_work_t *work,
+				       igraph_i_leiden_work_t *lw,
+				       long int no_of_comms,
+				       igraph_real_t resolution,
+				       igraph_real_t beta) {
+  const int *offsets=VECTOR(g->offsets), *neis=VECTOR(g->neis);
+  const igraph_real_t *weights=VECTOR(g->weights);
+  const igraph_real_t *nw=VECTOR(g->node_weights);
+  const int *membership=work->membership;
+  int *refined=VECTOR(lw->refined), *rsize=VECTOR(lw->rsize);
+  int *cstart=VECTOR(lw->cstart), *cverts=VECTOR(lw->cverts);
+  int *mark=work->mark, *touched=work->touched;
+  igraph_real_t *rtot=VECTOR(lw->rtot), *rext=VECTOR(lw->rext);
+  igraph_real_t *acc=work->acc, *prob=VECTOR(lw->prob);
+  long int n=g->n, i, j, c;
+
+  for (i=0; i<n; i++) {
+    refined[i]=(int) i;
+    rsize[i]=1;
+    rtot[i]=nw[i];
+    rext[i]=0;
+    for (j=offsets[i]; j<offsets[i+1]; j++) {
+      if (membership[neis[j]] == membership[i]) { rext[i] += weights[j]; }
+    }
+  }
+
+  /* Vertices grouped by community, in random order */
+  memset(cstart, 0, sizeof(int) * (size_t) (no_of_comms+1));
+  for (i=0; i<n; i++) { cstart[membership[i]+1]++; }
+  for (c=0; c<no_of_comms; c++) { cstart[c+1] += cstart[c]; }
+  for (i=0; i<n; i++) {
+    cverts[cstart[membership[i]]++]=(int) i;
+  }
+  for (c=no_of_comms; c>0; c--) { cstart[c]=cstart[c-1]; }
+  cstart[0]=0;
+
+  for (c=0; c<no_of_comms; c++) {
+    igraph_real_t ctot=0;
+    long int first=cstart[c], last=cstart[c+1];
+
+    for (i=first; i<last; i++) {
+      long int k=RNG_INTEGER(first, i);
+      int tmp=cverts[i]; cverts[i]=cverts[k]; cverts[k]=tmp;
+      ctot += nw[tmp];
+    }
+
+    for (i=first; i<last; i++) {
+      long int v=cverts[i], nt=0, chosen=v;
+      igraph_real_t max_gain=0, sum=0, r;
+
+      if (rsize[refined[v]] != 1) { continue; }
+      if (rext[v] < resolution * nw[v] * (ctot - nw[v])) { continue; }
+
+      for (j=offsets[v]; j<offsets[v+1]; j++) {
+	int u=neis[j], s=refined[u];
+	if (membership[u] != c) { continue; }
+	if (mark[s] < 0) {
+	  mark[s]=(int) nt;
+	  touched[nt]=s;
+	  acc[nt++]=weights[j];
+	} else {
+	  acc[mark[s]] += weights[j];
+	}
+      }
+
+      /* The gains, -1 for the communities that are not candidates */
+      for (j=0; j<nt; j++) {
+	int s=touched[j];
+	prob[j] = -1;
+	if (rext[s] >= resolution * rtot[s] * (ctot - rtot[s])) {
+	  igraph_real_t gain=acc[j] - resolution * nw[v] * rtot[s];
+	  if (gain >= 0) {
+	    prob[j]=gain;
+	    if (gain > max_gain) { max_gain=gain; chosen=s; }
+	  }
+	}
+      }
+
+      if (beta > 0) {
+	/* Staying alone is a candidate too, with zero gain */
+	sum=exp(-max_gain/beta);
+	for (j=0; j<nt; j++) {
+	  if (prob[j] >= 0) {
+	    prob[j]=exp((prob[j]-max_gain)/beta);
+	    sum += prob[j];
+	  }
+	}
+	r=RNG_UNIF(0, sum) - exp(-max_gain/beta);
+	chosen=v;
+	for (j=0; j<nt && r >= 0; j++) {
+	  if (prob[j] >= 0) {
+	    r -= prob[j];
+	    if (r < 0) { chosen=touched[j]; }
+	  }
+	}
+      }
+
+      if (chosen != v) {
+	igraph_real_t w=acc[mark[chosen]];
+	refined[v]=(int) chosen;
+	rsize[chosen]++;
+	rsize[v]=0;
+	rtot[chosen] += nw[v];
+	rext[chosen] += rext[v] - 2*w;
+      }
+
+      for (j=0; j<nt; j++) { mark[touched[j]] = -1; }
+    }
+  }
+
+  return igraph_i_leiden_renumber(refined, n, work->target);
+}
+
+/*
+ * One run of the Leiden method, starting from the communities in
+ * 'membership', the result is written there too. 'base' is the graph
+ * itself, 'levels' are the work areas of the aggregated graphs.
+ */
+
+static int igraph_i_community_leiden(const igraph_i_multilevel_graph_t *base,
+				     igraph_i_multilevel_graph_t *levels,
+				     igraph_i_multilevel_work_t *work,
+				     igraph_i_leiden_work_t *lw,
+				     igraph_real_t resolution,
+				     igraph_real_t beta,
+				     igraph_vector_t *membership) {
+  const igraph_i_multilevel_graph_t *fine=base;
+  int *level_of=VECTOR(lw->level_of);
+  long int no_of_nodes=base->n, i, no_of_comms, no_of_refined;
+  igraph_bool_t again=1;
+  int next=0;
+
+  for (i=0; i<no_of_nodes; i++) {
+    work->membership[i]=(int) VECTOR(*membership)[i];
+    level_of[i]=(int) i;
+  }
+
+  while (again) {
+    long int n=fine->n;
+
+    igraph_i_leiden_fastmove(fine, work, lw, resolution);
+    no_of_comms=igraph_i_leiden_renumber(work->membership, n, work->target);
+    if (no_of_comms == n) { break; }
+
+    /* Refine and aggregate. If the refinement merged nothing, the
+       communities themselves are aggregated. */
+    no_of_refined=igraph_i_leiden_refine(fine, work, lw, no_of_comms,
+					 resolution, beta);
+    if (no_of_refined == n) {
+      memcpy(VECTOR(lw->refined), work->membership, sizeof(int) * (size_t) n);
+      no_of_refined=no_of_comms;
+    }
+    IGRAPH_CHECK(igraph_i_multilevel_aggregate(fine, work,
+					       VECTOR(lw->refined),
+					       no_of_refined, &levels[next]));
+
+    /* The aggregated vertices start in the community of their
+       members */
+    for (i=0; i<n; i++) {
+      work->target[VECTOR(lw->refined)[i]] = work->membership[i];
+    }
+    memcpy(work->membership, work->target, sizeof(int) * (size_t) no_of_refined);
+    for (i=0; i<no_of_nodes; i++) {
+      level_of[i]=VECTOR(lw->refined)[level_of[i]];
+    }
+
+    again = no_of_comms < no_of_refined;
+    fine=&levels[next];
+    next=1-next;
+
+    IGRAPH_ALLOW_INTERRUPTION();
+  }
+
+  for (i=0; i<no_of_nodes; i++) {
+    VECTOR(*membership)[i]=work->membership[level_of[i]];
+  }
+
+  return 0;
+}
+
+/**
+ * \ingroup communities
+ * \function igraph_community_leiden
+ * \brief Finding community structure using the Leiden algorithm.
+ *
+ * This function implements the Leiden algorithm of V.A. Traag,
+ * L. Waltman and N.J. van Eck: From Louvain to Leiden: guaranteeing
+ * well-connected communities, Scientific Reports 9, 5233 (2019).
+ *
+ * </para><para>
+ * It optimizes the quality function
+ * Q = 1/(2m) sum_ij (A_ij - gamma n_i n_j) d(s_i, s_j), where m is the
+ * total edge weight, A is the weighted adjacency matrix, n_i is the
+ * weight of vertex i, gamma is the resolution parameter and
+ * d(s_i, s_j) is one if vertices i and j are in the same community.
+ * With unit vertex weights, this is the Constant Potts Model (CPM).
+ * If the vertex weights are the degrees (or strengths for weighted
+ * graphs) and the resolution parameter is 1/(2m), this is the
+ * modularity.
+ *
+ * </para><para>
+ * Like \ref igraph_community_multilevel(), the algorithm moves the
+ * vertices to neighboring communities, and then aggregates the
+ * communities into single vertices, repeatedly. The local moving uses
+ * a queue: only vertices whose neighborhood changed are visited
+ * again. Before aggregation, a refinement step splits every community
+ * into well connected parts, and these are aggregated. Thus the
+ * communities found by the Leiden algorithm are always connected.
+ *
+ * \param graph The input graph. It must be an undirected graph.
+ * \param edge_weights Numeric vector containing edge weights. If
+ *    \c NULL, every edge has weight one.
+ * \param node_weights Numeric vector containing the vertex weights.
+ *    If \c NULL, every vertex has weight one.
+ * \param resolution_parameter The resolution parameter, gamma above.
+ *    Higher values lead to more, smaller communities.
+ * \param beta The randomness of the refinement step. Zero means no
+ *    randomness, the most often used value is 0.01.
+ * \param start Whether to start from the communities given in \p
+ *    membership. If false, every vertex starts in its own community.
+ * \param n_iterations The number of iterations of the algorithm, each
+ *    one starting from the result of the previous one. If negative,
+ *    it runs until the communities do not change any more.
+ * \param membership The membership vector, the result is returned
+ *    here. It must be initialized, and if \p start is true, it must
+ *    contain the initial communities.
+ * \param nb_clusters The number of communities is stored here, if not
+ *    \c NULL.
+ * \param quality The value of the quality function is stored here,
+ *    if not \c NULL.
+ * \return Error code.
+ *
+ * Time complexity: near linear on sparse graphs, per iteration.
+ *
+ * \example examples/simple/igraph_community_leiden.c
+ */
+
+int igraph_community_leiden(const igraph_t *graph,
+			    const igraph_vector_t *edge_weights,
+			    const igraph_vector_t *node_weights,
+			    igraph_real_t resolution_parameter,
+			    igraph_real_t beta, igraph_bool_t start,
+			    igraph_integer_t n_iterations,
+			    igraph_vector_t *membership,
+			    igraph_integer_t *nb_clusters,
+			    igraph_real_t *quality) {
+
+  long int no_of_nodes=igraph_vcount(graph), i, j, iter;
+  igraph_i_multilevel_graph_t base, levels[2];
+  igraph_i_multilevel_work_t work;
+  igraph_i_leiden_work_t lw;
+  igraph_vector_t previous;
+  igraph_real_t m2;
+
+  if (igraph_is_directed(graph)) {
+    IGRAPH_ERROR("Leiden community detection works for undirected graphs only",
+		 IGRAPH_UNIMPLEMENTED);
+  }
+  if (edge_weights &&
+      igraph_vector_size(edge_weights) != igraph_ecount(graph)) {
+    IGRAPH_ERROR("Invalid edge weight vector length", IGRAPH_EINVAL);
+  }
+  if (edge_weights && igraph_vector_any_smaller(edge_weights, 0)) {
+    IGRAPH_ERROR("Edge weights must not be negative", IGRAPH_EINVAL);
+  }
+  if (node_weights && igraph_vector_size(node_weights) != no_of_nodes) {
+    IGRAPH_ERROR("Invalid node weight vector length", IGRAPH_EINVAL);
+  }
+  if (beta < 0) {
+    IGRAPH_ERROR("The randomness must not be negative", IGRAPH_EINVAL);
+  }
+  if (start) {
+    if (igraph_vector_size(membership) != no_of_nodes) {
+      IGRAPH_ERROR("Invalid initial membership vector length",
+		   IGRAPH_EINVAL);
+    }
+    if (no_of_nodes > 0 && igraph_vector_min(membership) < 0) {
+      IGRAPH_ERROR("Invalid initial membership vector", IGRAPH_EINVAL);
+    }
+    IGRAPH_CHECK(igraph_reindex_membership(membership, 0));
+  } else {
+    IGRAPH_CHECK(igraph_vector_resize(membership, no_of_nodes));
+    for (i=0; i<no_of_nodes; i++) { VECTOR(*membership)[i]=i; }
+  }
+
+  IGRAPH_CHECK(igraph_i_multilevel_graph_init(&base));
+  IGRAPH_FINALLY(igraph_i_multilevel_graph_destroy, &base);
+  IGRAPH_CHECK(igraph_i_multilevel_graph_init(&levels[0]));
+  IGRAPH_FINALLY(igraph_i_multilevel_graph_destroy, &levels[0]);
+  IGRAPH_CHECK(igraph_i_multilevel_graph_init(&levels[1]));
+  IGRAPH_FINALLY(igraph_i_multilevel_graph_destroy, &levels[1]);
+  IGRAPH_CHECK(igraph_i_multilevel_graph_create(&base, graph, edge_weights));
+  m2=igraph_vector_sum(&base.node_weights);
+  if (node_weights) {
+    IGRAPH_CHECK(igraph_vector_update(&base.node_weights, node_weights));
+  } else {
+    igraph_vector_fill(&base.node_weights, 1.0);
+  }
+
+  IGRAPH_CHECK(igraph_i_multilevel_work_init(&work, no_of_nodes,
+					       IGRAPH_I_THREAD_COUNT(no_of_nodes)));
+  IGRAPH_FINALLY(igraph_i_multilevel_work_destroy, &work);
+  IGRAPH_CHECK(igraph_i_leiden_work_init(&lw, no_of_nodes));
+  IGRAPH_FINALLY(igraph_i_leiden_work_destroy, &lw);
+  IGRAPH_VECTOR_INIT_FINALLY(&previous, 0);
+
+  RNG_BEGIN();
+
+  for (iter=0; n_iterations < 0 || iter < n_iterations; iter++) {
+    IGRAPH_CHECK(igraph_vector_update(&previous, membership));
+    IGRAPH_CHECK(igraph_i_community_leiden(&base, levels, &work, &lw,
+					   resolution_parameter, beta,
+					   membership));
+    IGRAPH_CHECK(igraph_reindex_membership(membership, 0));
+    if (igraph_vector_all_e(&previous, membership)) { break; }
+  }
+
+  RNG_END();
+
+  if (nb_clusters) {
+    *nb_clusters = no_of_nodes > 0 ?
+      (igraph_integer_t) igraph_vector_max(membership) + 1 : 0;
+  }
+
+  if (quality) {
+    /* The 'tot' and 'in' arrays are free now */
+    memset(work.tot, 0, sizeof(igraph_real_t) * (size_t) no_of_nodes);
+    memset(work.in, 0, sizeof(igraph_real_t) * (size_t) no_of_nodes);
+    for (i=0; i<no_of_nodes; i++) {
+      long int c=(long int) VECTOR(*membership)[i];
+      work.tot[c] += VECTOR(base.node_weights)[i];
+      work.in[c] += VECTOR(base.self)[i];
+      for (j=VECTOR(base.offsets)[i]; j<VECTOR(base.offsets)[i+1]; j++) {
+	if (VECTOR(*membership)[(long int) VECTOR(base.neis)[j]] == c) {
+	  work.in[c] += VECTOR(base.weights)[j];
+	}
+      }
+    }
+    *quality = m2 > 0 ? 0 : IGRAPH_NAN;
+    for (i=0; m2 > 0 && i<no_of_nodes; i++) {
+      *quality += (work.in[i] - resolution_parameter *
+		   work.tot[i] * work.tot[i]) / m2;
+    }
+  }
+
+  igraph_vector_destroy(&previous);
+  igraph_i_leiden_work_destroy(&lw);
+  igraph_i_multilevel_work_destroy(&work);
+  igraph_i_multilevel_graph_destroy(&levels[1]);
+  igraph_i_multilevel_graph_destroy(&levels[0]);
+  igraph_i_multilevel_graph_destroy(&base);
+  IGRAPH_FINALLY_CLEAN(6);
+
+  return 0;
+}
+
+/*
+ * Ensembles of randomized community detection runs. The setup that
+ * does not depend on the random choices (the CSR snapshots of label
+ * propagation, the first level of the multi-level method, the flow
+ * graph of Infomap) is done once and shared by the runs. The runs are
+ * distributed among the threads; every thread has its own work area
+ * and random number generator, allocated in advance, and the
+ * generator is reseeded for every run from a seed drawn in advance,
+ * so the result does not depend on the number of threads.
+ */
+
+typedef struct igraph_i_ensemble_thread_t {
+  igraph_rng_t rng;
+  igraph_bool_t rng_init;
+  /* multi-level */
+  igraph_i_multilevel_work_t mwork;
+  igraph_bool_t mwork_init;
+  igraph_i_multilevel_graph_t levels[2];
+  int levels_init;
+  /* label propagation */
+  igraph_i_lpa_table_t table;
+  int *act;
+  char *queued;
+} igraph_i_ensemble_thread_t;
+
+typedef struct igraph_i_ensemble_work_t {
+  int nthreads;
+  igraph_i_ensemble_thread_t *threads;
+} igraph_i_ensemble_work_t;
+
+static void igraph_i_ensemble_work_destroy(igraph_i_ensemble_work_t *work) {
+  int i, j;
+  if (!work->threads) { return; }
+  for (i=0; i<work->nthreads; i++) {
+    igraph_i_ensemble_thread_t *t=&work->threads[i];
+    if (t->rng_init) { igraph_rng_destroy(&t->rng); }
+    if (t->mwork_init) { igraph_i_multilevel_work_destroy(&t->mwork); }
+    for (j=0; j<t->levels_init; j++) {
+      igraph_i_multilevel_graph_destroy(&t->levels[j]);
+    }
+    if (t->table.keys) { igraph_Free(t->table.keys); }
+    if (t->table.touched) { igraph_Free(t->table.touched); }
+    if (t->table.counts) { igraph_Free(t->table.counts); }
+    if (t->act) { igraph_Free(t->act); }
+    if (t->queued) { igraph_Free(t->queued); }
+  }
+  igraph_Free(work->threads);
+}
+
+/* Reserves room for the levels of 'base' in 'g', so that
+   igraph_i_multilevel_aggregate() never allocates memory into it */
+
+static int igraph_i_ensemble_reserve_level(igraph_i_multilevel_graph_t *g,
+				   const igraph_i_multilevel_graph_t *base) {
+  long int nneis=igraph_vector_int_size(&base->neis);
+  IGRAPH_CHECK(igraph_vector_int_reserve(&g->offsets, base->n+1));
+  IGRAPH_CHECK(igraph_vector_int_reserve(&g->neis, nneis));
+  IGRAPH_CHECK(igraph_vector_reserve(&g->weights, nneis));
+  IGRAPH_CHECK(igraph_vector_reserve(&g->self, base->n));
+  IGRAPH_CHECK(igraph_vector_reserve(&g->node_weights, base->n));
+  return 0;
+}
+
+/* 'base' is the first level of the multi-level method, a null
+   pointer for other methods. 'lpa_size' is the size of the hash
+   table of label propagation, zero for other methods. */
+
+static int igraph_i_ensemble_work_init(igraph_i_ensemble_work_t *work,
+				       long int no_of_nodes, long int runs,
+				       const igraph_i_multilevel_graph_t *base,
+				       unsigned int lpa_size) {
+  long int n= no_of_nodes > 0 ? no_of_nodes : 1;
+  int i, j;
+
+  work->nthreads=IGRAPH_I_THREAD_COUNT(runs);
+  work->threads=igraph_Calloc(work->nthreads, igraph_i_ensemble_thread_t);
+  if (!work->threads) {
+    IGRAPH_ERROR("community ensemble failed", IGRAPH_ENOMEM);
+  }
+  IGRAPH_FINALLY(igraph_i_ensemble_work_destroy, work);
+
+  for (i=0; i<work->nthreads; i++) {
+    igraph_i_ensemble_thread_t *t=&work->threads[i];
+    IGRAPH_CHECK(igraph_rng_init(&t->rng, &igraph_rngtype_mt19937));
+    t->rng_init=1;
+    if (base) {
+      IGRAPH_CHECK(igraph_i_multilevel_work_init(&t->mwork, no_of_nodes, 1));
+      t->mwork_init=1;
+      for (j=0; j<2; j++) {
+	IGRAPH_CHECK(igraph_i_multilevel_graph_init(&t->levels[j]));
+	t->levels_init++;
+	IGRAPH_CHECK(igraph_i_ensemble_reserve_level(&t->levels[j], base));
+      }
+    }
+    if (lpa_size > 0) {
+      t->table.mask=lpa_size-1;
+      t->table.keys=igraph_Calloc(lpa_size, int);
+      t->table.touched=igraph_Calloc(lpa_size, int);
+      t->table.counts=igraph_Calloc(lpa_size, igraph_real_t);
+      t->act=igraph_Calloc(n, int);
+      t->queued=igraph_Calloc(n, char);
+      if (!t->table.keys || !t->table.touched || !t->table.counts ||
+	  !t->act || !t->queued) {
+	IGRAPH_ERROR("community ensemble failed", IGRAPH_ENOMEM);
+      }
+    }
+  }
+
+  IGRAPH_FINALLY_CLEAN(1);
+  return 0;
+}
+
+/*
+ * A complete run of the multi-level method, from the first level
+ * 'base', the coarser levels are built in 'levels'. The vertices are
+ * visited in random order if 'rng' is not a null pointer. Does not
+ * allocate memory if 'levels' have room for the levels of 'base', see
+ * igraph_i_ensemble_reserve_level(), and then it does not call the
+ * error handler either.
+ */
+
+static int igraph_i_ensemble_multilevel(const igraph_i_multilevel_graph_t *base,
+					igraph_i_multilevel_graph_t *levels,
+					igraph_i_multilevel_work_t *work,
+					int *membership, igraph_rng_t *rng,
+					igraph_bool_t *interrupted) {
+  const igraph_i_multilevel_graph_t *g=base;
+  long int i, no_of_comms;
+  igraph_real_t q=-1, prev_q;
+  int cur=0, ret;
+
+  for (i=0; i<base->n; i++) { membership[i]=(int) i; }
+
+  while (1) {
+    prev_q=q;
+    ret=igraph_i_community_multilevel_step(g, work, &no_of_comms, &q, rng,
+					   interrupted);
+    if (ret) { return ret; }
+    if (*interrupted || no_of_comms == g->n || q < prev_q) { break; }
+    for (i=0; i<base->n; i++) {
+      membership[i]=work->membership[membership[i]];
+    }
+    ret=igraph_i_multilevel_aggregate(g, work, work->membership,
+				      no_of_comms, &levels[cur]);
+    if (ret) { return ret; }
+    g=&levels[cur];
+    cur=1-cur;
+  }
+
+  return 0;
+}
+
+/**
+ * \ingroup communities
+ * \function igraph_community_ensemble
+ * \brief Consensus of many randomized community detection runs
+ *
+ * Runs a randomized community detection method several times, and
+ * combines the results into a consensus partition, following the
+ * idea of A. Lancichinetti and S. Fortunato: Consensus clustering in
+ * complex networks, Scientific Reports 2, 336 (2012).
+ *
+ * </para><para>
+ * The co-assignment weight of an edge is the fraction of runs that
+ * put its two endpoints into the same community. Edges with a weight
+ * below \p threshold are dropped, and the resulting weighted graph
+ * is clustered with the multi-level method (see \ref
+ * igraph_community_multilevel()), ignoring edge directions. 
+ *
+ * </para><para>
+ * The methods are randomized as follows.
+ * \c IGRAPH_ENSEMBLE_MULTILEVEL runs the multi-level method with the
+ * vertices visited in random order, \c
+ * IGRAPH_ENSEMBLE_LABEL_PROPAGATION is label propagation (see \ref
+ * igraph_community_label_propagation()) from distinct initial labels,
+ * and \c IGRAPH_ENSEMBLE_INFOMAP is a single trial of Infomap (see
+ * \ref igraph_community_infomap()). The setup of the method is done
+ * only once, and shared by the runs.
+ *
+ * </para><para>
+ * If igraph was compiled with OpenMP support, the runs are executed
+ * in parallel. Every run uses its own random number generator, seeded
+ * from the default one, so the result does not depend on the number
+ * of threads.
+ *
+ * \param graph The input graph. It must be undirected for the
+ *    multi-level method.
+ * \param weights Numeric vector containing non-negative edge weights,
+ *    or a null pointer for unweighted graphs. The weights are used by
+ *    the runs and by the modularity of the result, not by the
+ *    consensus clustering.
+ * \param method The community detection method of the runs, see
+ *    above.
+ * \param runs The number of runs, at least one.
+ * \param threshold Edges with a smaller co-assignment weight than
+ *    this are not considered in the consensus clustering. It must be
+ *    between zero and one.
+ * \param membership Pointer to an initialized vector, the membership
+ *    vector of the consensus partition is stored here. 
+ * \param modularity If not a null pointer, then the modularity of the
+ *    consensus partition is stored here, with the edge weights.
+ * \param memberships If not a null pointer, then the membership
+ *    vectors of the runs are stored here, one run in each row. The
+ *    matrix will be resized as needed.
+ * \param coassignment If not a null pointer, then the co-assignment
+ *    weights of the edges are stored here, before applying the
+ *    threshold.
+ * \return Error code.
+ *
+ * \sa \ref igraph_community_multilevel(), \ref
+ * igraph_community_label_propagation(), \ref
+ * igraph_community_infomap().
+ *
+ * Time complexity: the time of \p runs runs of the chosen method,
+ * plus O(runs |E|) for the co-assignment weights, plus a multi-level
+ * run.
+ *
+ * \example examples/simple/igraph_community_ensemble.c
+ */
+
+int igraph_community_ensemble(const igraph_t *graph,
+			      const igraph_vector_t *weights,
+			      igraph_community_ensemble_method_t method,
+			      igraph_integer_t runs,
+			      igraph_real_t threshold,
+			      igraph_vector_t *membership,
+			      igraph_real_t *modularity,
+			      igraph_matrix_t *memberships,
+			      igraph_vector_t *coassignment) {
+  long int no_of_nodes=igraph_vcount(graph);
+  long int no_of_edges=igraph_ecount(graph);
+  long int i, r, first;
+  igraph_i_multilevel_graph_t base, consensus, levels[2];
+  igraph_i_multilevel_work_t work;
+  igraph_i_ensemble_work_t ework;
+  igraph_csr_t in, out;
+  void *fgraph=0;
+  unsigned int lpa_size=0;
+  igraph_vector_t seeds, cweights;
+  int *runmemb, *result;
+  igraph_bool_t interrupted=0, failed=0;
+
+  if (method != IGRAPH_ENSEMBLE_MULTILEVEL &&
+      method != IGRAPH_ENSEMBLE_LABEL_PROPAGATION &&
+      method != IGRAPH_ENSEMBLE_INFOMAP) {
+    IGRAPH_ERROR("Invalid community detection method", IGRAPH_EINVAL);
+  }
+  if (runs < 1) {
+    IGRAPH_ERROR("Number of runs must be at least one", IGRAPH_EINVAL);
+  }
+  if (threshold < 0 || threshold > 1) {
+    IGRAPH_ERROR("Threshold must be between zero and one", IGRAPH_EINVAL);
+  }
+  if (weights) {
+    if (igraph_vector_size(weights) != no_of_edges) {
+      IGRAPH_ERROR("Invalid weight vector length", IGRAPH_EINVAL);
+    }
+    if (no_of_edges > 0 && igraph_vector_min(weights) < 0) {
+      IGRAPH_ERROR("Weights must be non-negative", IGRAPH_EINVAL);
+    }
+  }
+  if (method == IGRAPH_ENSEMBLE_MULTILEVEL && igraph_is_directed(graph)) {
+    IGRAPH_ERROR("multi-level community detection works for undirected graphs only",
+		 IGRAPH_UNIMPLEMENTED);
+  }
+
+  /* The shared setup of the method */
+  if (method == IGRAPH_ENSEMBLE_MULTILEVEL) {
+    IGRAPH_CHECK(igraph_i_multilevel_graph_init(&base));
+    IGRAPH_FINALLY(igraph_i_multilevel_graph_destroy, &base);
+    IGRAPH_CHECK(igraph_i_multilevel_graph_create(&base, graph, weights));
+  } else if (method == IGRAPH_ENSEMBLE_LABEL_PROPAGATION) {
+    long int maxdeg=0;
+    IGRAPH_CHECK(igraph_csr_init(graph, &in, IGRAPH_IN, weights));
+    IGRAPH_FINALLY(igraph_csr_destroy, &in);
+    if (igraph_is_directed(graph)) {
+      IGRAPH_CHECK(igraph_csr_init(graph, &out, IGRAPH_OUT, 0));
+      IGRAPH_FINALLY(igraph_csr_destroy, &out);
+    }
+    for (i=0; i<no_of_nodes; i++) {
+      long int deg=VECTOR(in.offsets)[i+1] - VECTOR(in.offsets)[i];
+      if (deg > maxdeg) { maxdeg=deg; }
+    }
+    if (maxdeg > no_of_nodes) { maxdeg=no_of_nodes; }
+    lpa_size=16;
+    while (lpa_size < 2*maxdeg) { lpa_size *= 2; }
+  } else {
+    IGRAPH_CHECK(igraph_i_infomap_flowgraph_init(graph, weights, &fgraph));
+    IGRAPH_FINALLY(igraph_i_infomap_flowgraph_destroy, fgraph);
+  }
+
+  IGRAPH_CHECK(igraph_i_ensemble_work_init(&ework, no_of_nodes, runs,
+		   method == IGRAPH_ENSEMBLE_MULTILEVEL ? &base : 0, lpa_size));
+  IGRAPH_FINALLY(igraph_i_ensemble_work_destroy, &ework);
+
+  /* The seeds of the runs, from the default generator */
+  IGRAPH_VECTOR_INIT_FINALLY(&seeds, runs);
+  RNG_BEGIN();
+  for (r=0; r<runs; r++) {
+    VECTOR(seeds)[r] = RNG_INT31();
+  }
+  RNG_END();
+
+  runmemb=igraph_Calloc(runs * (no_of_nodes > 0 ? no_of_nodes : 1), int);
+  if (!runmemb) {
+    IGRAPH_ERROR("community ensemble failed", IGRAPH_ENOMEM);
+  }
+  IGRAPH_FINALLY(igraph_free, runmemb);
+
+  /* One run per thread at a time, the interruption handler is called
+     between them, and also from the run if there is a single thread */
+  for (first=0; first<runs && !interrupted && !failed;
+       first+=ework.nthreads) {
+    long int last= first+ework.nthreads < runs ? first+ework.nthreads : runs;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(ework.nthreads) schedule(dynamic, 1) \
+  private(i)
+#endif
+    for (r=first; r<last; r++) {
+      igraph_i_ensemble_thread_t *t=&ework.threads[IGRAPH_I_THREAD_NUM()];
+      int *memb=runmemb + r*no_of_nodes;
+      int ret=0;
+      igraph_rng_seed(&t->rng, (unsigned long int) VECTOR(seeds)[r]);
+      if (method == IGRAPH_ENSEMBLE_MULTILEVEL) {
+	ret=igraph_i_ensemble_multilevel(&base, t->levels, &t->mwork, memb,
+					 &t->rng, &interrupted);
+      } else if (method == IGRAPH_ENSEMBLE_LABEL_PROPAGATION) {
+	for (i=0; i<no_of_nodes; i++) {
+	  memb[i]=(int) i+1;
+	  t->queued[i]=1;
+	}
+	igraph_i_lpa_propagate(&in, igraph_is_directed(graph) ? &out : &in,
+			       0, no_of_nodes, memb, t->act, t->queued,
+			       &t->table, 1, &t->rng, &interrupted);
+      } else {
+	ret=igraph_i_infomap_flowgraph_partition(fgraph, &t->rng, memb,
+						 &interrupted);
+      }
+      if (ret) {
+#ifdef _OPENMP
+#pragma omp atomic write
+#endif
+	failed=1;
+      }
+    }
+    IGRAPH_I_PARALLEL_ALLOW_INTERRUPTION(interrupted);
+  }
+
+  IGRAPH_I_PARALLEL_INTERRUPTED(interrupted);
+  if (failed) {
+    IGRAPH_ERROR("community ensemble failed", IGRAPH_ENOMEM);
+  }
+
+  /* Co-assignment weights */
+  IGRAPH_VECTOR_INIT_FINALLY(&cweights, no_of_edges);
+  for (i=0; i<no_of_edges; i++) {
+    long int from=IGRAPH_FROM(graph, i), to=IGRAPH_TO(graph, i);
+    long int same=0;
+    for (r=0; r<runs; r++) {
+      const int *memb=runmemb + r*no_of_nodes;
+      if (memb[from] == memb[to]) { same++; }
+    }
+    VECTOR(cweights)[i] = same / (igraph_real_t) runs;
+  }
+  if (coassignment) {
+    IGRAPH_CHECK(igraph_vector_update(coassignment, &cweights));
+  }
+  for (i=0; i<no_of_edges; i++) {
+    if (VECTOR(cweights)[i] < threshold) { VECTOR(cweights)[i]=0; }
+  }
+
+  if (memberships) {
+    /* Number the communities of each run in the order of their
+       first vertex */
+    int *relabel=igraph_Calloc(no_of_nodes+2, int);
+    if (!relabel) {
+      IGRAPH_ERROR("community ensemble failed", IGRAPH_ENOMEM);
+    }
+    IGRAPH_FINALLY(igraph_free, relabel);
+    IGRAPH_CHECK(igraph_matrix_resize(memberships, runs, no_of_nodes));
+    for (r=0; r<runs; r++) {
+      const int *memb=runmemb + r*no_of_nodes;
+      int next=0;
+      for (i=0; i<no_of_nodes+2; i++) { relabel[i] = -1; }
+      for (i=0; i<no_of_nodes; i++) {
+	if (relabel[memb[i]] < 0) { relabel[memb[i]]=next++; }
+	MATRIX(*memberships, r, i)=relabel[memb[i]];
+      }
+    }
+    igraph_free(relabel);
+    IGRAPH_FINALLY_CLEAN(1);
+  }
+
+  /* The consensus clustering, into the row of the first run, which
+     is not needed any more */
+  IGRAPH_CHECK(igraph_i_multilevel_graph_init(&consensus));
+  IGRAPH_FINALLY(igraph_i_multilevel_graph_destroy, &consensus);
+  IGRAPH_CHECK(igraph_i_multilevel_graph_init(&levels[0]));
+  IGRAPH_FINALLY(igraph_i_multilevel_graph_destroy, &levels[0]);
+  IGRAPH_CHECK(igraph_i_multilevel_graph_init(&levels[1]));
+  IGRAPH_FINALLY(igraph_i_multilevel_graph_destroy, &levels[1]);
+  IGRAPH_CHECK(igraph_i_multilevel_graph_create(&consensus, graph,
+						&cweights));
+  IGRAPH_CHECK(igraph_i_multilevel_work_init(&work, no_of_nodes,
+				     IGRAPH_I_THREAD_COUNT(no_of_nodes)));
+  IGRAPH_FINALLY(igraph_i_multilevel_work_destroy, &work);
+  result=runmemb;
+  IGRAPH_CHECK(igraph_i_ensemble_multilevel(&consensus, levels, &work,
+					    result, 0, &interrupted));
+  IGRAPH_I_PARALLEL_INTERRUPTED(interrupted);
+
+  IGRAPH_CHECK(igraph_vector_resize(membership, no_of_nodes));
+  for (i=0; i<no_of_nodes; i++) {
+    VECTOR(*membership)[i]=result[i];
+  }
+  if (modularity) {
+    IGRAPH_CHECK(igraph_modularity(graph, membership, modularity, weights));
+  }
+
+  igraph_i_multilevel_work_destroy(&work);
+  igraph_i_multilevel_graph_destroy(&levels[1]);
+  igraph_i_multilevel_graph_destroy(&levels[0]);
+  igraph_i_multilevel_graph_destroy(&consensus);
+  igraph_vector_destroy(&cweights);
+  igraph_free(runmemb);
+  igraph_vector_destroy(&seeds);
+  igraph_i_ensemble_work_destroy(&ework);
+  IGRAPH_FINALLY_CLEAN(8);
+
+  if (method == IGRAPH_ENSEMBLE_MULTILEVEL) {
+    igraph_i_multilevel_graph_destroy(&base);
+    IGRAPH_FINALLY_CLEAN(1);
+  } else if (method == IGRAPH_ENSEMBLE_LABEL_PROPAGATION) {
+    if (igraph_is_directed(graph)) {
+      igraph_csr_destroy(&out);
+      IGRAPH_FINALLY_CLEAN(1);
+    }
+    igraph_csr_destroy(&in);
+    IGRAPH_FINALLY_CLEAN(1);
+  } else {
+    igraph_i_infomap_flowgraph_destroy(fgraph);
+    IGRAPH_FINALLY_CLEAN(1);
+  }
+
+  return 0;
+}
+
+
 int igraph_i_compare_communities_vi(const igraph_vector_t *v1,
     const igraph_vector_t *v2, igraph_real_t* result);
 int igraph_i_compare_communities_nmi(const igraph_vector_t *v1,
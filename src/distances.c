@@ -29,98 +29,209 @@
 #include "igraph_vector.h"
 #include "igraph_interface.h"
 #include "igraph_adjlist.h"
+#include "igraph_memory.h"
+#include "igraph_parallel_internal.h"
+#include "igraph_paths_internal.h"
 
-int igraph_i_eccentricity(const igraph_t *graph,
-			  igraph_vector_t *res,
-			  igraph_vs_t vids,
-			  igraph_neimode_t mode,
-			  const igraph_adjlist_t *adjlist) {
+/*
+ * Bit-parallel multi-source BFS, see igraph_paths_internal.h and
+ * M. Then et al.: The more the merrier: Efficient multi-source graph
+ * traversal, Proceedings of the VLDB Endowment 8(4), 2014.
+ */
 
-  int no_of_nodes=igraph_vcount(graph);
-  igraph_dqueue_long_t q;
-  igraph_vit_t vit;
-  igraph_vector_int_t counted;
-  int i, mark=1;
-  igraph_vector_t vneis;
-  igraph_vector_int_t *neis;
+#ifndef __GNUC__
+int igraph_i_msbfs_lowbit(igraph_i_msbfs_mask_t mask) {
+  int b=0;
+  while (!(mask & 1)) { mask >>= 1; b++; }
+  return b;
+}
+#endif
 
-  IGRAPH_CHECK(igraph_dqueue_long_init(&q, 100));
-  IGRAPH_FINALLY(igraph_dqueue_long_destroy, &q);
-  
-  IGRAPH_CHECK(igraph_vit_create(graph, vids, &vit));
-  IGRAPH_FINALLY(igraph_vit_destroy, &vit);
+typedef struct igraph_i_msbfs_thread_t {
+  igraph_i_msbfs_mask_t *seen, *visit, *next;
+  long int *front, *nextfront, *touched;
+} igraph_i_msbfs_thread_t;
 
-  IGRAPH_CHECK(igraph_vector_int_init(&counted, no_of_nodes));
-  IGRAPH_FINALLY(igraph_vector_int_destroy, &counted);
+typedef struct igraph_i_msbfs_t {
+  igraph_csr_t csr;
+  int nthreads;
+  igraph_i_msbfs_thread_t *threads;
+} igraph_i_msbfs_t;
 
-  if (!adjlist) {
-    IGRAPH_VECTOR_INIT_FINALLY(&vneis, 0);
+static void igraph_i_msbfs_destroy(igraph_i_msbfs_t *msbfs) {
+  int i;
+  for (i=0; i<msbfs->nthreads; i++) {
+    igraph_i_msbfs_thread_t *t=&msbfs->threads[i];
+    if (t->seen) { igraph_Free(t->seen); }
+    if (t->visit) { igraph_Free(t->visit); }
+    if (t->next) { igraph_Free(t->next); }
+    if (t->front) { igraph_Free(t->front); }
+    if (t->nextfront) { igraph_Free(t->nextfront); }
+    if (t->touched) { igraph_Free(t->touched); }
   }
+  igraph_Free(msbfs->threads);
+  igraph_csr_destroy(&msbfs->csr);
+}
 
-  IGRAPH_CHECK(igraph_vector_resize(res, IGRAPH_VIT_SIZE(vit)));
-  igraph_vector_fill(res, -1);
-
-  for (i=0, IGRAPH_VIT_RESET(vit); 
-       !IGRAPH_VIT_END(vit); 
-       IGRAPH_VIT_NEXT(vit), mark++, i++) {
-
-    long int source;
-    source=IGRAPH_VIT_GET(vit);
-    IGRAPH_CHECK(igraph_dqueue_long_push(&q, source));
-    IGRAPH_CHECK(igraph_dqueue_long_push(&q, 0));
-    VECTOR(counted)[source]=mark;
-    
-    IGRAPH_ALLOW_INTERRUPTION();
-    
-    while (!igraph_dqueue_long_empty(&q)) {
-      long int act=igraph_dqueue_long_pop(&q);
-      long int dist=igraph_dqueue_long_pop(&q);
-      int j, n;
-
-      if (dist > VECTOR(*res)[i]) {
-	VECTOR(*res)[i]=dist;
-      }
+static int igraph_i_msbfs_init(igraph_i_msbfs_t *msbfs,
+			       const igraph_t *graph, igraph_neimode_t mode,
+			       long int no_of_batches) {
+  long int no_of_nodes=igraph_vcount(graph);
+  long int alloc_nodes= no_of_nodes > 0 ? no_of_nodes : 1;
+  long int i;
+
+  IGRAPH_CHECK(igraph_csr_init(graph, &msbfs->csr, mode, 0));
+  msbfs->nthreads=IGRAPH_I_THREAD_COUNT(no_of_batches);
+  msbfs->threads=igraph_Calloc(msbfs->nthreads, igraph_i_msbfs_thread_t);
+  if (!msbfs->threads) {
+    igraph_csr_destroy(&msbfs->csr);
+    IGRAPH_ERROR("Multi-source BFS failed", IGRAPH_ENOMEM);
+  }
+  IGRAPH_FINALLY(igraph_i_msbfs_destroy, msbfs);
+
+  for (i=0; i<msbfs->nthreads; i++) {
+    igraph_i_msbfs_thread_t *t=&msbfs->threads[i];
+    t->seen=igraph_Calloc(alloc_nodes, igraph_i_msbfs_mask_t);
+    t->visit=igraph_Calloc(alloc_nodes, igraph_i_msbfs_mask_t);
+    t->next=igraph_Calloc(alloc_nodes, igraph_i_msbfs_mask_t);
+    t->front=igraph_Calloc(alloc_nodes, long int);
+    t->nextfront=igraph_Calloc(alloc_nodes, long int);
+    t->touched=igraph_Calloc(alloc_nodes, long int);
+    if (!t->seen || !t->visit || !t->next || !t->front || 
+	!t->nextfront || !t->touched) {
+      IGRAPH_ERROR("Multi-source BFS failed", IGRAPH_ENOMEM);
+    }
+  }
+
+  IGRAPH_FINALLY_CLEAN(1);
+  return 0;
+}
+
+/*
+ * One batch of sources, in the work area of one thread. The masks
+ * are all zero before and after the search.
+ */
+
+static void igraph_i_msbfs_batch(igraph_i_msbfs_t *msbfs, int thread,
+				 const igraph_real_t *sources,
+				 long int first, long int no_of_sources,
+				 long int maxdist,
+				 igraph_i_msbfs_visitor_t *visitor,
+				 void *extra) {
+  igraph_i_msbfs_thread_t *t=&msbfs->threads[thread];
+  igraph_i_msbfs_mask_t *seen=t->seen, *visit=t->visit, *next=t->next;
+  long int *front=t->front, *nextfront=t->nextfront, *tmp;
+  const int *offsets=VECTOR(msbfs->csr.offsets);
+  const int *neis=VECTOR(msbfs->csr.neis);
+  long int nfront=0, nnext, ntouched=0, dist=0;
+  long int i, j;
 
-      if (adjlist) {
-	neis=igraph_adjlist_get(adjlist, act);
-	n=(int) igraph_vector_int_size(neis);
-	for (j=0; j<n; j++) {
-	  int nei=(int) VECTOR(*neis)[j];
-	  if (VECTOR(counted)[nei] != mark) {
-	    VECTOR(counted)[nei]=mark;
-	    IGRAPH_CHECK(igraph_dqueue_long_push(&q, nei));
-	    IGRAPH_CHECK(igraph_dqueue_long_push(&q, dist+1));
-	  }
-	}  
-      } else {
-	IGRAPH_CHECK(igraph_neighbors(graph, &vneis,
-				      (igraph_integer_t) act, mode));
-	n=(int) igraph_vector_size(&vneis);
-	for (j=0; j<n; j++) {
-	  int nei=(int) VECTOR(vneis)[j];
-	  if (VECTOR(counted)[nei] != mark) {
-	    VECTOR(counted)[nei]=mark;
-	    IGRAPH_CHECK(igraph_dqueue_long_push(&q, nei));
-	    IGRAPH_CHECK(igraph_dqueue_long_push(&q, dist+1));
-	  }
-	}  
+  for (i=0; i<no_of_sources; i++) {
+    long int s=(long int) sources[first+i];
+    if (!visit[s]) { front[nfront++]=s; t->touched[ntouched++]=s; }
+    visit[s] |= ((igraph_i_msbfs_mask_t) 1) << i;
+    seen[s] = visit[s];
+  }
+  for (i=0; i<nfront; i++) {
+    visitor(first, front[i], 0, visit[front[i]], extra);
+  }
+
+  while (nfront > 0 && (maxdist < 0 || dist < maxdist)) {
+    dist++;
+    nnext=0;
+    for (i=0; i<nfront; i++) {
+      long int v=front[i];
+      igraph_i_msbfs_mask_t m=visit[v];
+      for (j=offsets[v]; j<offsets[v+1]; j++) {
+	long int nei=neis[j];
+	igraph_i_msbfs_mask_t d=m & ~seen[nei];
+	if (d) {
+	  if (!next[nei]) { nextfront[nnext++]=nei; }
+	  next[nei] |= d;
+	}
       }
-    } /* while !igraph_dqueue_long_empty(dqueue) */
+    }
+    for (i=0; i<nfront; i++) {
+      visit[front[i]] = 0;
+    }
+    for (i=0; i<nnext; i++) {
+      long int v=nextfront[i];
+      if (!seen[v]) { t->touched[ntouched++]=v; }
+      seen[v] |= next[v];
+      visit[v] = next[v];
+      next[v] = 0;
+      visitor(first, v, dist, visit[v], extra);
+    }
+    tmp=front; front=nextfront; nextfront=tmp; nfront=nnext;
+  }
 
-  } /* for IGRAPH_VIT_NEXT(vit) */
+  for (i=0; i<nfront; i++) {
+    visit[front[i]] = 0;
+  }
+  for (i=0; i<ntouched; i++) {
+    seen[t->touched[i]] = 0;
+  }
+}
 
-  if (!adjlist) {
-    igraph_vector_destroy(&vneis);
-    IGRAPH_FINALLY_CLEAN(1);
+int igraph_i_msbfs(const igraph_t *graph, const igraph_vector_t *sources,
+		   igraph_neimode_t mode, long int maxdist,
+		   igraph_i_msbfs_visitor_t *visitor, void *extra,
+		   const char *progress_message) {
+
+  long int no_of_sources=igraph_vector_size(sources);
+  long int no_of_batches=(no_of_sources + IGRAPH_I_MSBFS_BATCH - 1) / 
+    IGRAPH_I_MSBFS_BATCH;
+  long int b, first, chunk;
+  igraph_i_msbfs_t msbfs;
+
+  IGRAPH_CHECK(igraph_i_msbfs_init(&msbfs, graph, mode, no_of_batches));
+  IGRAPH_FINALLY(igraph_i_msbfs_destroy, &msbfs);
+
+  /* A batch is 64 searches, so a chunk has a few batches per thread */
+  chunk=4 * msbfs.nthreads;
+  for (first=0; first<no_of_batches; first+=chunk) {
+    long int last= first+chunk < no_of_batches ? first+chunk : no_of_batches;
+    if (progress_message) {
+      IGRAPH_PROGRESS(progress_message, 100.0*first/no_of_batches, 0);
+    }
+#ifdef _OPENMP
+#pragma omp parallel num_threads(msbfs.nthreads)
+#endif
+    {
+      int thread=IGRAPH_I_THREAD_NUM();
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1)
+#endif
+      for (b=first; b<last; b++) {
+	long int start=b * IGRAPH_I_MSBFS_BATCH;
+	long int size=no_of_sources-start < IGRAPH_I_MSBFS_BATCH ?
+	  no_of_sources-start : IGRAPH_I_MSBFS_BATCH;
+	igraph_i_msbfs_batch(&msbfs, thread, VECTOR(*sources), start, size,
+			     maxdist, visitor, extra);
+      }
+    }
+    IGRAPH_ALLOW_INTERRUPTION();
   }
-  igraph_vector_int_destroy(&counted);
-  igraph_vit_destroy(&vit);
-  igraph_dqueue_long_destroy(&q);
-  IGRAPH_FINALLY_CLEAN(3);
-  
+
+
+  igraph_i_msbfs_destroy(&msbfs);
+  IGRAPH_FINALLY_CLEAN(1);
+
   return 0;
 }
 
+static void igraph_i_eccentricity_visitor(long int first, long int vertex,
+					  long int dist,
+					  igraph_i_msbfs_mask_t sources,
+					  void *extra) {
+  igraph_vector_t *res=(igraph_vector_t *) extra;
+  /* The distances grow during the search */
+  while (sources) {
+    VECTOR(*res)[first + IGRAPH_I_MSBFS_LOWBIT(sources)] = dist;
+    sources &= sources-1;
+  }
+}
+
 /**
  * \function igraph_eccentricity
  * Eccentricity of some vertices
@@ -133,6 +244,11 @@ int igraph_i_eccentricity(const igraph_t *graph,
  * This implementation ignores vertex pairs that are in different
  * components. Isolated vertices have eccentricity zero.
  * 
+ * </para><para>
+ * The breadth-first searches of 64 vertices are done together, in a
+ * single traversal of the graph. If igraph was compiled with OpenMP,
+ * these batches run in parallel.
+ * 
  * \param graph The input graph, it can be directed or undirected.
  * \param res Pointer to an initialized vector, the result is stored
  *    here.
@@ -158,7 +274,25 @@ int igraph_eccentricity(const igraph_t *graph,
 			igraph_vs_t vids,
 			igraph_neimode_t mode) {
 
-  return igraph_i_eccentricity(graph, res, vids, mode, /*adjlist=*/ 0);
+  igraph_vit_t vit;
+  igraph_vector_t vidv;
+
+  IGRAPH_CHECK(igraph_vit_create(graph, vids, &vit));
+  IGRAPH_FINALLY(igraph_vit_destroy, &vit);
+  IGRAPH_VECTOR_INIT_FINALLY(&vidv, 0);
+  IGRAPH_CHECK(igraph_vit_as_vector(&vit, &vidv));
+
+  IGRAPH_CHECK(igraph_vector_resize(res, IGRAPH_VIT_SIZE(vit)));
+  igraph_vector_null(res);
+  IGRAPH_CHECK(igraph_i_msbfs(graph, &vidv, mode, /*maxdist=*/ -1,
+			      igraph_i_eccentricity_visitor, res,
+			      /*progress_message=*/ 0));
+
+  igraph_vector_destroy(&vidv);
+  igraph_vit_destroy(&vit);
+  IGRAPH_FINALLY_CLEAN(2);
+
+  return 0;
 }
 
 /**
@@ -194,17 +328,12 @@ int igraph_radius(const igraph_t *graph, igraph_real_t *radius,
   if (no_of_nodes==0) {
     *radius = IGRAPH_NAN;
   } else {
-    igraph_adjlist_t adjlist;
     igraph_vector_t ecc;
-    IGRAPH_CHECK(igraph_adjlist_init(graph, &adjlist, mode));
-    IGRAPH_FINALLY(igraph_adjlist_destroy, &adjlist);
     IGRAPH_VECTOR_INIT_FINALLY(&ecc, igraph_vcount(graph));
-    IGRAPH_CHECK(igraph_i_eccentricity(graph, &ecc, igraph_vss_all(), 
-				       mode, &adjlist));
+    IGRAPH_CHECK(igraph_eccentricity(graph, &ecc, igraph_vss_all(), mode));
     *radius = igraph_vector_min(&ecc);
     igraph_vector_destroy(&ecc);
-    igraph_adjlist_destroy(&adjlist);
-    IGRAPH_FINALLY_CLEAN(2);
+    IGRAPH_FINALLY_CLEAN(1);
   }
   
   return 0;
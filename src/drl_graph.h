@@ -79,7 +79,10 @@ private:
 	// Methods
 	int ReCompute ( );
 	void update_nodes ( );
+	void update_nodes_parallel ( );
 	float Compute_Node_Energy ( int node_ind );
+	float Compute_Node_Energy ( int node_ind, float x, float y );
+	float Compute_Edge_Energy ( int node_ind, float x, float y );
 	void Solve_Analytic ( int node_ind, float &pos_x, float &pos_y );
 	void get_positions ( vector<int> &node_indices, float return_positions[2*MAX_PROCS] );
 	void update_density ( vector<int> &node_indices,
@@ -88,6 +91,7 @@ private:
 	void update_node_pos ( int node_ind,
 				      float old_positions[2*MAX_PROCS],
 				      float new_positions[2*MAX_PROCS] );
+	void update_node_pos ( int node_ind, double jump[2], Node &new_node );
 								  
 	// MPI information
 	int myid, num_procs;
@@ -97,6 +101,7 @@ private:
 	float highest_sim;				// highest sim for normalization
 	map <int, int> id_catalog;		// id_catalog[file id] = internal id
 	map <int, map <int, float> > neighbors;		// neighbors of nodes on this proc.
+	vector<map <int, float> *> neighbor_lists;	// neighbors[i] of node i
 	
 	// graph layout information
 	vector<Node> positions;  
@@ -47,6 +47,7 @@ using namespace std;
 #include "igraph_interface.h"
 #include "igraph_progress.h"
 #include "igraph_interrupt_internal.h"
+#include "igraph_parallel_internal.h"
 #ifdef MUSE_MPI
   #include <mpi.h>
 #endif
@@ -120,6 +121,13 @@ graph::graph(const igraph_t *igraph,
     positions.push_back ( Node( cat_iter->first ) );
   }
   
+  // every node has a neighbor list; they are looked up here once,
+  // update_nodes_parallel must not search neighbors from several threads
+  neighbor_lists.reserve ( num_nodes );
+  for (long int i=0; i<num_nodes; i++) {
+    neighbor_lists.push_back ( &neighbors[id_catalog[i]] );
+  }
+
   // read .int file for graph info
   long int node_1, node_2;
   double weight;
@@ -265,7 +273,10 @@ int graph::ReCompute( )
   }
 
   /* Compute Energies for individual nodes */
-  update_nodes ();
+  if ( num_nodes >= PARALLEL_MIN )
+    update_nodes_parallel ();
+  else
+    update_nodes ();
   
   // check to see if we need to free fixed nodes
   tot_iterations++;
@@ -555,6 +566,68 @@ void graph::update_nodes ( )
 	
 }
 
+// update_nodes_parallel -- the node update loop for large graphs.  The
+// nodes are updated in batches of MAX_PROCS nodes, as in the parallel
+// DrL: all nodes of a batch are moved based on the positions and the
+// density grid before the batch, by several threads, and then the
+// density grid is updated by several threads, each of them handling
+// a part of the grid.  The result does not depend on the number of
+// threads.
+
+void graph::update_nodes_parallel ( )
+{
+
+	vector<int> node_indices;			// nodes of the batch that are not fixed
+	vector<Node> new_nodes;				// their new positions
+	double jumps[3*MAX_PROCS];			// random jumps of the nodes
+	int num_threads = IGRAPH_I_THREAD_COUNT(MAX_PROCS);
+
+	node_indices.reserve ( MAX_PROCS );
+	new_nodes.reserve ( MAX_PROCS );
+
+	for ( int first = 0; first < num_nodes; first += MAX_PROCS )
+	{
+
+		int last = first + MAX_PROCS < num_nodes ? first + MAX_PROCS : num_nodes;
+
+		node_indices.clear ( );
+		new_nodes.clear ( );
+		for ( int i = first; i < last; i++ )
+		  if ( !(positions[i].fixed && real_fixed) )
+		  {
+		    node_indices.push_back ( i );
+		    new_nodes.push_back ( positions[i] );
+		  }
+
+		if ( node_indices.empty ( ) )
+		  continue;
+
+		// the random numbers are drawn in the same order as
+		// by update_nodes
+		for ( unsigned int j = 0; j < 3*node_indices.size(); j++ )
+		  jumps[j] = RNG_UNIF01();
+
+		// compute the new positions
+		#ifdef _OPENMP
+		#pragma omp parallel for num_threads(num_threads) schedule(dynamic, 16)
+		#endif
+		for ( int j = 0; j < (int) node_indices.size(); j++ )
+		  update_node_pos ( node_indices[j], &jumps[3*j], new_nodes[j] );
+
+		// update density grid and positions
+		density_server.Move ( positions, node_indices, new_nodes, first_add,
+				      fine_first_add, fineDensity, num_threads );
+		for ( unsigned int j = 0; j < node_indices.size(); j++ )
+		  positions[ node_indices[j] ] = new_nodes[j];
+
+	}
+
+	// update first_add and fine_first_add
+	first_add = false;
+	if ( fineDensity ) fine_first_add = false;
+
+}
+
 // The get_positions function takes the node_indices list
 // and returns the corresponding positions in an array.
 
@@ -654,6 +727,61 @@ void graph::update_node_pos ( int node_ind,
 		
 }
 
+// The same for update_nodes_parallel.  The density grid and the
+// positions are not modified, the density of the node itself is left
+// out of its energy instead.  The new position and energy of the
+// node is stored in new_node.  This is called from several threads,
+// only the neighbor list of the node is modified, by Solve_Analytic.
+
+void graph::update_node_pos ( int node_ind, double jump[3], Node &new_node )
+{
+
+		float energies[2];			// node energies for possible positions
+		float updated_pos[2][3];	// possible positions
+		float pos_x, pos_y, pos_z;
+
+		// old VxOrd parameter
+		float jump_length = .010 * temperature;
+
+		// compute node energy for old solution
+		energies[0] = Compute_Node_Energy ( node_ind, positions[node_ind].x,
+						    positions[node_ind].y,
+						    positions[node_ind].z );
+
+	        // move node to centroid position
+		Solve_Analytic ( node_ind, pos_x, pos_y, pos_z );
+		updated_pos[0][0] = pos_x;
+		updated_pos[0][1] = pos_y;
+		updated_pos[0][2] = pos_z;
+
+		// Do random method
+		updated_pos[1][0] = updated_pos[0][0] + (.5 - jump[0]) * jump_length;
+		updated_pos[1][1] = updated_pos[0][1] + (.5 - jump[1]) * jump_length;
+		updated_pos[1][2] = updated_pos[0][2] + (.5 - jump[2]) * jump_length;
+
+		// compute node energy for random position
+		energies[1] = Compute_Node_Energy ( node_ind, updated_pos[1][0],
+						    updated_pos[1][1],
+						    updated_pos[1][2] );
+
+		// choose updated node position with lowest energy
+		if ( energies[0] < energies[1] )
+		{
+			new_node.x = updated_pos[0][0];
+			new_node.y = updated_pos[0][1];
+			new_node.z = updated_pos[0][2];
+			new_node.energy = energies[0];
+		}
+		else
+		{
+			new_node.x = updated_pos[1][0];
+			new_node.y = updated_pos[1][1];
+			new_node.z = updated_pos[1][2];
+			new_node.energy = energies[1];
+		}
+
+}
+
 // update_density takes a sequence of node_indices and their positions and
 // updates the positions by subtracting the old positions and adding the
 // new positions to the density grid.
@@ -689,27 +817,73 @@ void graph::update_density ( vector<int> &node_indices,
 *********************************************/
 
 float graph::Compute_Node_Energy( int node_ind )
+{
+	
+	float node_energy;
+	
+	// Add up all connection energies
+	node_energy = Compute_Edge_Energy ( node_ind, positions[ node_ind ].x,
+					    positions[ node_ind ].y,
+					    positions[ node_ind ].z );
+
+	// output effect of density (debugging)
+	//cout << "[before: " << node_energy;
+	
+	// add density
+	node_energy += density_server.GetDensity ( positions[ node_ind ].x, positions[ node_ind ].y,
+						   positions[ node_ind ].z, fineDensity );
+
+	// after calling density server (debugging)
+	//cout << ", after: " << node_energy << "]" << endl;
+	
+	// return computated energy
+	return node_energy;
+}
+
+// The energy of the node at (x, y, z), without its own density, for
+// update_nodes_parallel
+
+float graph::Compute_Node_Energy( int node_ind, float x, float y, float z )
+{
+	
+	float node_energy;
+	
+	node_energy = Compute_Edge_Energy ( node_ind, x, y, z );
+	node_energy += density_server.GetDensity ( x, y, z, fineDensity,
+						   positions[ node_ind ],
+						   first_add, fine_first_add );
+	return node_energy;
+}
+
+// The energy of the edges of the node at (x, y, z)
+
+float graph::Compute_Edge_Energy( int node_ind, float x, float y, float z )
 {
 	
 	/* Want to expand 4th power range of attraction */
 	float attraction_factor = attraction*attraction*
 			attraction*attraction*2e-2;
 	
+	map <int,float> &node_neighbors = *neighbor_lists[node_ind];
 	map <int,float>::iterator EI;
 	float x_dis,y_dis,z_dis;
 	float energy_distance, weight;
 	float node_energy=0;
 	
 	// Add up all connection energies
-	for(EI = neighbors[node_ind].begin(); EI != neighbors[node_ind].end(); ++EI) {
+	for(EI = node_neighbors.begin(); EI != node_neighbors.end(); ++EI) {
 
 		// Get edge weight
 		weight = EI->second;
 				
-		// Compute x,y distance
-		x_dis = positions[ node_ind ].x - positions[ EI->first ].x;
-		y_dis = positions[ node_ind ].y - positions[ EI->first ].y;
-		z_dis = positions[ node_ind ].z - positions[ EI->first ].z;
+		// Compute x,y distance, loop edges have zero length
+		if ( EI->first == node_ind ) {
+		  x_dis = y_dis = z_dis = 0;
+		} else {
+		  x_dis = x - positions[ EI->first ].x;
+		  y_dis = y - positions[ EI->first ].y;
+		  z_dis = z - positions[ EI->first ].z;
+		}
 		
 		// Energy Distance
 		energy_distance = x_dis*x_dis + y_dis*y_dis + z_dis*z_dis;
@@ -721,17 +895,6 @@ float graph::Compute_Node_Energy( int node_ind )
 		node_energy += weight * attraction_factor * energy_distance;
 	}
 
-	// output effect of density (debugging)
-	//cout << "[before: " << node_energy;
-	
-	// add density
-	node_energy += density_server.GetDensity ( positions[ node_ind ].x, positions[ node_ind ].y,
-						   positions[ node_ind ].z, fineDensity );
-
-	// after calling density server (debugging)
-	//cout << ", after: " << node_energy << "]" << endl;
-	
-	// return computated energy
 	return node_energy;
 }
 
@@ -747,6 +910,7 @@ void graph::Solve_Analytic( int node_ind, float &pos_x, float &pos_y,
 			    float &pos_z)
 {
 
+   map <int,float> &node_neighbors = *neighbor_lists[node_ind];
    map <int,float>::iterator EI;
    float total_weight = 0;
    float x_dis, y_dis, z_dis, x_cen=0, y_cen=0, z_cen=0;
@@ -754,7 +918,7 @@ void graph::Solve_Analytic( int node_ind, float &pos_x, float &pos_y,
    float damping,weight;
 
    // Sum up all connections
-   for(EI = neighbors[node_ind].begin(); EI != neighbors[node_ind].end(); ++EI) {
+   for(EI = node_neighbors.begin(); EI != node_neighbors.end(); ++EI) {
 		weight = EI->second;
 		total_weight += weight;
 		x +=  weight * positions[ EI->first ].x;  
@@ -781,17 +945,17 @@ void graph::Solve_Analytic( int node_ind, float &pos_x, float &pos_y,
    // Don't cut at end of scale
    if ( CUT_END >= 39500 ) return;
 
-   float num_connections = (float)sqrt((float)neighbors[node_ind].size());
+   float num_connections = (float)sqrt((float)node_neighbors.size());
    float maxLength = 0;
 
    map<int, float>::iterator maxIndex;
 
    // Go through nodes edges... cutting if necessary
-   for(EI = maxIndex = neighbors[node_ind].begin();
-	   EI !=neighbors[node_ind].end(); ++EI) {
+   for(EI = maxIndex = node_neighbors.begin();
+	   EI !=node_neighbors.end(); ++EI) {
 
 		// Check for at least min edges
-		if (neighbors[node_ind].size() < min_edges) continue;
+		if (node_neighbors.size() < min_edges) continue;
 
 		x_dis = x_cen - positions[ EI->first ].x;
 		y_dis = y_cen - positions[ EI->first ].y;
@@ -804,7 +968,7 @@ void graph::Solve_Analytic( int node_ind, float &pos_x, float &pos_y,
    }
 
    // If max length greater than cut_length then cut
-   if (maxLength > cut_off_length) neighbors[ node_ind ].erase( maxIndex ); 
+   if (maxLength > cut_off_length) node_neighbors.erase( maxIndex ); 
    
 }
 
@@ -433,6 +433,13 @@ int igraph_layout_drl_options_init(igraph_layout_drl_options_t *options,
  * Please see more in the following technical report: Martin, S.,
  * Brown, W.M., Klavans, R., Boyack, K.W., DrL: Distributed Recursive
  * (Graph) Layout. SAND Reports, 2008. 2936: p. 1-10. 
+ *
+ * </para><para> Graphs with at least 10000 vertices are laid out
+ * like in the parallel version of DrL: the vertices are moved in
+ * batches of 256, all vertices of a batch at the same time. If igraph
+ * was compiled with OpenMP support, the vertices of a batch and the
+ * density grid are updated by several threads. The layout does not
+ * depend on the number of threads.
  * \param graph The input graph.
  * \param use_seed Logical scalar, if true, then the coordinates
  *    supplied in the \p res argument are used as starting points.
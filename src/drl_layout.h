@@ -40,6 +40,10 @@
 #define MAX_FILE_NAME 250   // max length of filename
 #define MAX_INT_LENGTH 4   // max length of integer suffix of intermediate .coord file
 
+// graphs with at least this many nodes are updated in batches of
+// MAX_PROCS nodes, in parallel, as in the original parallel DrL
+#define PARALLEL_MIN 10000
+
 // Compile time adjustable parameters for the Density grid
 
 #define GRID_SIZE 1000			// size of Density grid
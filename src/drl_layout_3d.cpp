@@ -81,6 +81,9 @@ using namespace drl3d;
  *
  * </para><para> This function uses a modified DrL generator that does
  * the layout in three dimensions.
+ *
+ * </para><para> Large graphs are laid out in parallel, see \ref
+ * igraph_layout_drl() for details.
  * \param graph The input graph.
  * \param use_seed Logical scalar, if true, then the coordinates
  *    supplied in the \p res argument are used as starting points.
@@ -28,9 +28,10 @@
 #include "igraph_progress.h"
 #include "igraph_interrupt_internal.h"
 #include "igraph_structural.h"
-#include "igraph_vector_ptr.h"
 #include "config.h"
 
+#include <string.h>
+
 /* #define IGRAPH_FASTCOMM_DEBUG */
 
 #ifdef _MSC_VER
@@ -66,182 +67,192 @@ void debug(const char* fmt, ...) {
  * networks.". arXiv:cs/0702048v1.
  *
  * We maintain a vector of communities, each of which containing a list of
- * pointers to their neighboring communities along with the increase in the
- * modularity score that could be achieved by joining the two communities.
- * Each community has a pointer to one of its neighbors - the one which would
- * result in the highest increase in modularity after a join. The local
- * (community-level) maximums are also stored in an indexed max-heap. The
- * max-heap itself stores its elements in an array which satisfies the heap
- * property, but to allow us to access any of the elements in the array based
- * on the community index (and not based on the array index - which depends on
- * the element's actual position in the heap), we also maintain an index
- * vector in the heap: the ith element of the index vector contains the
- * position of community i in the array of the max-heap. When we perform
- * sifting operations on the heap to restore the heap property, we also maintain
- * the index vector.
+ * community pairs towards their neighboring communities along with the
+ * increase in the modularity score that could be achieved by joining the two
+ * communities. Each community knows the pair in its list which would result
+ * in the highest increase in modularity after a join. The local
+ * (community-level) maximums are also stored in an indexed 4-ary max-heap.
+ * The heap stores community indices along with a copy of their maximal dq
+ * values, so sifting does not need to look up the communities or the pairs
+ * at all. To allow us to access any of the elements in the heap based on the
+ * community index (and not based on the array index - which depends on the
+ * element's actual position in the heap), we also maintain an index vector:
+ * the ith element of the index vector contains the position of community i
+ * in the heap arrays.
+ *
+ * No memory is allocated per community or per join. Both directions of a
+ * community pair live in one array, pair 2k and 2k+1 are the opposites of
+ * each other and share dq[k]. The neighbor lists are segments of a single
+ * pool of pair indices, each segment is preceded by its owner and its
+ * capacity. A join writes the merged neighbor list to the end of the pool,
+ * and the two old segments become garbage, which is reclaimed by compacting
+ * the pool when it fills up.
  */
 
-/* Structure storing a pair of communities along with their dQ values */
-typedef struct s_igraph_i_fastgreedy_commpair {
-  long int first;       /* first member of the community pair */
-  long int second;      /* second member of the community pair */
-  igraph_real_t *dq;    /* pointer to a member of the dq vector storing the */
-                        /* increase in modularity achieved when joining */
-  struct s_igraph_i_fastgreedy_commpair *opposite;
+/* Arity of the community heap */
+#define IGRAPH_I_FASTGREEDY_HEAP_D 4
+
+/* Structure storing a pair of communities. Pairs 2k and 2k+1 are the two
+ * directions of the same pair, and their dq value is stored in dq[k]. */
+typedef struct {
+  igraph_integer_t first;   /* first member of the community pair */
+  igraph_integer_t second;  /* second member of the community pair */
 } igraph_i_fastgreedy_commpair;
 
+#define OPPOSITE(p) ((p) ^ 1)
+#define DQ(list,p) ((list)->dq[(p) >> 1])
+
 /* Structure storing a community */
 typedef struct {
   igraph_integer_t id;      /* Identifier of the community (for merges matrix) */
   igraph_integer_t size;    /* Size of the community */
-  igraph_vector_ptr_t neis; /* references to neighboring communities */
-  igraph_i_fastgreedy_commpair* maxdq; /* community pair with maximal dq */
+  long int neis;            /* start of the neighbor list in the pool */
+  long int no_of_neis;      /* number of neighboring communities */
+  long int maxdq;           /* community pair with maximal dq, -1 if none */
 } igraph_i_fastgreedy_community;
 
 /* Global community list structure */
 typedef struct {
-  long int no_of_communities, n;  /* number of communities, number of vertices */
+  long int no_of_communities, n;  /* number of communities in the heap, number of vertices */
   igraph_i_fastgreedy_community* e;     /* list of communities */
-  igraph_i_fastgreedy_community** heap; /* heap of communities */
-  igraph_integer_t *heapindex; /* heap index to speed up lookup by community idx */
+  igraph_i_fastgreedy_commpair* pairs;  /* community pairs */
+  igraph_real_t* dq;                    /* dq values of the pairs */
+  long int* pool;               /* neighbor lists, sorted by `second' */
+  long int pool_size, pool_end, pool_used;
+  igraph_integer_t* heap;       /* heap of communities */
+  igraph_real_t* heapdq;        /* maximal dq values of the heap elements */
+  igraph_integer_t* heapindex;  /* heap index to speed up lookup by community idx */
 } igraph_i_fastgreedy_community_list;
 
-/* Scans the community neighborhood list for the new maximal dq value.
- * Returns 1 if the maximum is different from the previous one,
- * 0 otherwise. */
-int igraph_i_fastgreedy_community_rescan_max(
-  igraph_i_fastgreedy_community* comm) {
-  long int i, n;
-  igraph_i_fastgreedy_commpair *p, *best;
+/* Scans the community neighborhood list for the new maximal dq value. */
+static void igraph_i_fastgreedy_community_rescan_max(
+  igraph_i_fastgreedy_community_list* list, long int c) {
+  igraph_i_fastgreedy_community *comm = &list->e[c];
+  long int i, n, *neis, best;
   igraph_real_t bestdq, currdq;
 
-  n = igraph_vector_ptr_size(&comm->neis);
+  n = comm->no_of_neis;
   if (n == 0) {
-    comm->maxdq = 0;
-    return 1;
+    comm->maxdq = -1;
+    return;
   }
 
-  best = (igraph_i_fastgreedy_commpair*)VECTOR(comm->neis)[0];
-  bestdq = *best->dq;
+  neis = list->pool + comm->neis;
+  best = neis[0];
+  bestdq = DQ(list, best);
   for (i = 1; i < n; i++) {
-	p = (igraph_i_fastgreedy_commpair*)VECTOR(comm->neis)[i];
-    currdq = *p->dq;
-	if (currdq > bestdq) {
-      best = p;
+    currdq = DQ(list, neis[i]);
+    if (currdq > bestdq) {
+      best = neis[i];
       bestdq = currdq;
     }
   }
-
-  if (best != comm->maxdq) {
-    comm->maxdq = best;
-    return 1;
-  } else {
-    return 0;
-  }
+  comm->maxdq = best;
 }
 
 /* Destroys the global community list object */
-void igraph_i_fastgreedy_community_list_destroy(
+static void igraph_i_fastgreedy_community_list_destroy(
   igraph_i_fastgreedy_community_list* list) {
-  long int i;
-  for (i=0; i<list->n; i++) {
-	igraph_vector_ptr_destroy(&list->e[i].neis);
-  }
-  free(list->e);
-  if (list->heapindex != 0) free(list->heapindex);
+  if (list->e != 0) free(list->e);
+  if (list->pairs != 0) free(list->pairs);
+  if (list->dq != 0) free(list->dq);
+  if (list->pool != 0) free(list->pool);
   if (list->heap != 0) free(list->heap);
+  if (list->heapdq != 0) free(list->heapdq);
+  if (list->heapindex != 0) free(list->heapindex);
 }
 
 /* Community list heap maintenance: sift down */
-void igraph_i_fastgreedy_community_list_sift_down(
+static void igraph_i_fastgreedy_community_list_sift_down(
   igraph_i_fastgreedy_community_list* list, long int idx) {
-  long int root, child, c1, c2;
-  igraph_i_fastgreedy_community* dummy;
-  igraph_integer_t dummy2;
-  igraph_i_fastgreedy_community** heap = list->heap;
-  igraph_integer_t* heapindex = list->heapindex;
-
-  root = idx;
-  while (root*2+1 < list->no_of_communities) {
-    child = root*2+1;
-	if (child+1 < list->no_of_communities &&
-		*heap[child]->maxdq->dq < *heap[child+1]->maxdq->dq)
-	  child++;
-	if (*heap[root]->maxdq->dq < *heap[child]->maxdq->dq) {
-	  c1 = heap[root]->maxdq->first;
-	  c2 = heap[child]->maxdq->first;
-
-	  dummy = heap[root];
-	  heap[root] = heap[child];
-	  heap[child] = dummy;
-	  
-	  dummy2 = heapindex[c1];
-	  heapindex[c1] = heapindex[c2];
-	  heapindex[c2] = dummy2;
-
-	  root = child;
-	} else break;
-  }
+  igraph_integer_t *heap = list->heap, *heapindex = list->heapindex;
+  igraph_real_t *heapdq = list->heapdq;
+  long int n = list->no_of_communities, child, last, i;
+  igraph_integer_t comm = heap[idx];
+  igraph_real_t dq = heapdq[idx];
+
+  while ((child = idx*IGRAPH_I_FASTGREEDY_HEAP_D+1) < n) {
+    last = child + IGRAPH_I_FASTGREEDY_HEAP_D;
+    if (last > n) last = n;
+    for (i = child+1; i < last; i++) {
+      if (heapdq[child] < heapdq[i]) child = i;
+    }
+    if (dq < heapdq[child]) {
+      heap[idx] = heap[child];
+      heapdq[idx] = heapdq[child];
+      heapindex[heap[idx]] = (igraph_integer_t) idx;
+      idx = child;
+    } else break;
+  }
+  heap[idx] = comm;
+  heapdq[idx] = dq;
+  heapindex[comm] = (igraph_integer_t) idx;
 }
 
 /* Community list heap maintenance: sift up */
-void igraph_i_fastgreedy_community_list_sift_up(
+static void igraph_i_fastgreedy_community_list_sift_up(
   igraph_i_fastgreedy_community_list* list, long int idx) {
-  long int root, parent, c1, c2;
-  igraph_i_fastgreedy_community* dummy;
-  igraph_integer_t dummy2;
-  igraph_i_fastgreedy_community** heap = list->heap;
-  igraph_integer_t* heapindex = list->heapindex;
-
-  root = idx;
-  while (root>0) {
-    parent = (root-1)/2;
-	if (*heap[parent]->maxdq->dq < *heap[root]->maxdq->dq) {
-	  c1 = heap[root]->maxdq->first;
-	  c2 = heap[parent]->maxdq->first;
-	  
-	  dummy = heap[parent];
-	  heap[parent] = heap[root];
-	  heap[root] = dummy;
-	  
-	  dummy2 = heapindex[c1];
-	  heapindex[c1] = heapindex[c2];
-	  heapindex[c2] = dummy2;
-
-	  root = parent;
-	} else break;
-  }
+  igraph_integer_t *heap = list->heap, *heapindex = list->heapindex;
+  igraph_real_t *heapdq = list->heapdq;
+  long int parent;
+  igraph_integer_t comm = heap[idx];
+  igraph_real_t dq = heapdq[idx];
+
+  while (idx > 0) {
+    parent = (idx-1)/IGRAPH_I_FASTGREEDY_HEAP_D;
+    if (heapdq[parent] < dq) {
+      heap[idx] = heap[parent];
+      heapdq[idx] = heapdq[parent];
+      heapindex[heap[idx]] = (igraph_integer_t) idx;
+      idx = parent;
+    } else break;
+  }
+  heap[idx] = comm;
+  heapdq[idx] = dq;
+  heapindex[comm] = (igraph_integer_t) idx;
 }
 
 /* Builds the community heap for the first time */
-void igraph_i_fastgreedy_community_list_build_heap(
+static void igraph_i_fastgreedy_community_list_build_heap(
   igraph_i_fastgreedy_community_list* list) {
   long int i;
-  for (i=list->no_of_communities/2-1; i>=0; i--)
+  if (list->no_of_communities < 2) return;
+  for (i=(list->no_of_communities-2)/IGRAPH_I_FASTGREEDY_HEAP_D; i>=0; i--)
 	igraph_i_fastgreedy_community_list_sift_down(list, i);
 }
 
-/* Finds the element belonging to a given community in the heap and return its
- * index in the heap array */
-#define igraph_i_fastgreedy_community_list_find_in_heap(list, idx) (list)->heapindex[idx]
+/* Restores the heap property after the maximal dq of community c has
+ * changed */
+static void igraph_i_fastgreedy_community_list_update(
+  igraph_i_fastgreedy_community_list* list, long int c) {
+  long int idx = list->heapindex[c];
+  igraph_real_t old = list->heapdq[idx];
 
-/* Dumps the heap - for debugging purposes */
-void igraph_i_fastgreedy_community_list_dump_heap(
-  igraph_i_fastgreedy_community_list* list) {
-  long int i;
-  debug("Heap:\n");
-  for (i=0; i<list->no_of_communities; i++) {
-	debug("(%ld, %p, %p)", i, list->heap[i],
-	  list->heap[i]->maxdq);
-	if (list->heap[i]->maxdq) {
-	  debug(" (%ld, %ld, %.7f)", list->heap[i]->maxdq->first,
-		list->heap[i]->maxdq->second, *list->heap[i]->maxdq->dq);
-	}
-	debug("\n");
-  }
-  debug("Heap index:\n");
-  for (i=0; i<list->no_of_communities; i++) debug("%ld ", (long)list->heapindex[i]);
-  debug("\nEND\n");
+  list->heapdq[idx] = DQ(list, list->e[c].maxdq);
+  if (old < list->heapdq[idx])
+	igraph_i_fastgreedy_community_list_sift_up(list, idx);
+  else
+	igraph_i_fastgreedy_community_list_sift_down(list, idx);
+}
+
+/* Removes community c from the heap */
+static void igraph_i_fastgreedy_community_list_remove(
+  igraph_i_fastgreedy_community_list* list, long int c) {
+  long int idx = list->heapindex[c], last;
+  igraph_real_t old;
+
+  list->heapindex[c] = -1;
+  last = --list->no_of_communities;
+  if (idx == last) return;
+
+  old = list->heapdq[idx];
+  list->heap[idx] = list->heap[last];
+  list->heapdq[idx] = list->heapdq[last];
+  list->heapindex[list->heap[idx]] = (igraph_integer_t) idx;
+  if (old < list->heapdq[idx])
+	igraph_i_fastgreedy_community_list_sift_up(list, idx);
+  else
+	igraph_i_fastgreedy_community_list_sift_down(list, idx);
 }
 
 /* Checks if the community heap satisfies the heap property.
@@ -249,303 +260,269 @@ void igraph_i_fastgreedy_community_list_dump_heap(
 void igraph_i_fastgreedy_community_list_check_heap(
   igraph_i_fastgreedy_community_list* list) {
   long int i;
-  for (i=0; i<list->no_of_communities/2; i++) {
-	if ((2*i+1<list->no_of_communities && *list->heap[i]->maxdq->dq < *list->heap[2*i+1]->maxdq->dq) ||
-		(2*i+2<list->no_of_communities && *list->heap[i]->maxdq->dq < *list->heap[2*i+2]->maxdq->dq)) {
+  for (i=1; i<list->no_of_communities; i++) {
+	if (list->heapdq[(i-1)/IGRAPH_I_FASTGREEDY_HEAP_D] < list->heapdq[i]) {
 	  IGRAPH_WARNING("Heap property violated");
-	  debug("Position: %ld, %ld and %ld\n", i, 2*i+1, 2*i+2);
-	  igraph_i_fastgreedy_community_list_dump_heap(list);
+	  debug("Position: %ld\n", i);
 	}
   }
 }
 
-/* Removes a given element from the heap */
-void igraph_i_fastgreedy_community_list_remove(
-  igraph_i_fastgreedy_community_list* list, long int idx) {
-  igraph_real_t old;
-  long int commidx;
-  
-  /* First adjust the index */
-  commidx=list->heap[list->no_of_communities-1]->maxdq->first;
-  list->heapindex[commidx] = (igraph_integer_t) idx;
-  commidx=list->heap[idx]->maxdq->first;
-  list->heapindex[commidx] = -1;
-
-  /* Now remove the element */
-  old=*list->heap[idx]->maxdq->dq;
-  list->heap[idx] = list->heap[list->no_of_communities-1];
-  list->no_of_communities--;
-  
-  /* Recover heap property */
-  if (old > *list->heap[idx]->maxdq->dq)
-	igraph_i_fastgreedy_community_list_sift_down(list, idx);
-  else
-	igraph_i_fastgreedy_community_list_sift_up(list, idx);
+/* Moves the live neighbor lists to the beginning of the pool */
+static void igraph_i_fastgreedy_community_list_compact(
+  igraph_i_fastgreedy_community_list* list) {
+  long int *pool = list->pool;
+  long int pos = 0, end = 0, len;
+
+  while (pos < list->pool_end) {
+    len = pool[pos+1] + 2;
+    if (pool[pos] >= 0) {
+      if (end != pos) {
+        memmove(pool + end, pool + pos, sizeof(long int) * (size_t) len);
+      }
+      list->e[pool[end]].neis = end + 2;
+      end += len;
+    }
+    pos += len;
+  }
+  list->pool_end = end;
 }
 
-/* Removes a given element from the heap when there are no more neighbors
- * for it (comm->maxdq is NULL) */
-void igraph_i_fastgreedy_community_list_remove2(
-  igraph_i_fastgreedy_community_list* list, long int idx, long int comm) {
-  long int i;
- 
-  if (idx == list->no_of_communities-1) {
-    /* We removed the rightmost element on the bottom level, no problem,
-     * there's nothing to be done */
-    list->heapindex[comm] = -1;
-    list->no_of_communities--;
-    return;
+/* Reserves room for a neighbor list of community c at the end of the pool
+ * and returns its start in *start. The pool is compacted or grown if
+ * needed, this invalidates all pointers into it. */
+static int igraph_i_fastgreedy_community_list_reserve(
+  igraph_i_fastgreedy_community_list* list, long int c, long int capacity,
+  long int *start) {
+  long int need = capacity + 2, size;
+  long int *pool;
+
+  if (list->pool_end + need > list->pool_size) {
+    igraph_i_fastgreedy_community_list_compact(list);
+    if (2 * (list->pool_used + need) > list->pool_size) {
+      /* Keep at least half of the pool free, so that compactions are rare */
+      size = 2 * (list->pool_used + need);
+      pool = igraph_Realloc(list->pool, size, long int);
+      if (pool == 0) {
+        IGRAPH_ERROR("can't run fast greedy community detection", IGRAPH_ENOMEM);
+      }
+      list->pool = pool;
+      list->pool_size = size;
+    }
   }
 
-  /* First adjust the index */
-  i=list->heap[list->no_of_communities-1]->maxdq->first;
-  list->heapindex[i] = (igraph_integer_t) idx;
-  list->heapindex[comm] = -1;
+  list->pool[list->pool_end] = c;
+  list->pool[list->pool_end+1] = capacity;
+  *start = list->pool_end + 2;
+  list->pool_end += need;
+  list->pool_used += need;
+  return 0;
+}
 
-  /* Now remove the element */
-  list->heap[idx] = list->heap[list->no_of_communities-1];
-  list->no_of_communities--;
-  
-  /* Recover heap property */
-  for (i=list->no_of_communities/2-1; i>=0; i--)
-	igraph_i_fastgreedy_community_list_sift_down(list, i);
+/* Releases the neighbor list starting at the given position of the pool */
+static void igraph_i_fastgreedy_community_list_release(
+  igraph_i_fastgreedy_community_list* list, long int start) {
+  list->pool[start-2] = -1;
+  list->pool_used -= list->pool[start-1] + 2;
 }
 
-/* Removes the pair belonging to community k from the neighborhood list
- * of community c (that is, clist[c]) and recalculates maxdq */
-void igraph_i_fastgreedy_community_remove_nei(
+/* Finds the position of the pair towards community k in the (sorted)
+ * neighbor list of community c, returns -1 if there is no such pair */
+static long int igraph_i_fastgreedy_community_find_nei(
   igraph_i_fastgreedy_community_list* list, long int c, long int k) {
-  long int i, n;
-  igraph_bool_t rescan=0;
-  igraph_i_fastgreedy_commpair *p;
-  igraph_i_fastgreedy_community *comm;
-  igraph_real_t olddq;
-
-  comm=&list->e[c];
-  n=igraph_vector_ptr_size(&comm->neis);
-  for (i=0; i<n; i++) {
-	p=(igraph_i_fastgreedy_commpair*)VECTOR(comm->neis)[i];
-    if (p->second == k) {
-	  /* Check current maxdq */
-	  if (comm->maxdq == p) rescan=1;
-	  break;
-	}
-  }
-  if (i<n) {
-	olddq = *comm->maxdq->dq;
-	igraph_vector_ptr_remove(&comm->neis, i);
-	if (rescan) {
-	  igraph_i_fastgreedy_community_rescan_max(comm);
-      i=igraph_i_fastgreedy_community_list_find_in_heap(list, c);
-	  if (comm->maxdq) {
-        if (*comm->maxdq->dq > olddq)
-		  igraph_i_fastgreedy_community_list_sift_up(list, i);
-        else
-		  igraph_i_fastgreedy_community_list_sift_down(list, i);
-      } else {
-        /* no more neighbors for this community. we should remove this
-         * community from the heap and restore the heap property */
-        debug("REMOVING (NO MORE NEIS): %ld\n", i);
-        igraph_i_fastgreedy_community_list_remove2(list, i, c);
-      }
-	}
+  long int *neis = list->pool + list->e[c].neis;
+  long int lo = 0, hi = list->e[c].no_of_neis - 1, mid, second;
+
+  while (lo <= hi) {
+    mid = (lo + hi) / 2;
+    second = list->pairs[neis[mid]].second;
+    if (second < k) {
+      lo = mid + 1;
+    } else if (second > k) {
+      hi = mid - 1;
+    } else {
+      return mid;
+    }
   }
+  return -1;
 }
 
-/* Auxiliary function to sort a community pair list with respect to the
- * `second` field */
-int igraph_i_fastgreedy_commpair_cmp(const void* p1, const void* p2) {
-  igraph_i_fastgreedy_commpair *cp1, *cp2;
-  cp1=*(igraph_i_fastgreedy_commpair**)p1;
-  cp2=*(igraph_i_fastgreedy_commpair**)p2;
-  return (int) (cp1->second - cp2->second);
-}
+/* Removes the pair belonging to community k from the neighborhood list
+ * of community c. Does not touch maxdq. */
+static void igraph_i_fastgreedy_community_remove_nei(
+  igraph_i_fastgreedy_community_list* list, long int c, long int k) {
+  long int i = igraph_i_fastgreedy_community_find_nei(list, c, k);
+  long int *neis = list->pool + list->e[c].neis;
 
-/* Sorts the neighbor list of the community with the given index, optionally
- * optimizing the process if we know that the list is nearly sorted and only
- * a given pair is in the wrong place. */
-void igraph_i_fastgreedy_community_sort_neighbors_of(
-  igraph_i_fastgreedy_community_list* list, long int index,
-  igraph_i_fastgreedy_commpair* changed_pair) {
-  igraph_vector_ptr_t* vec;
-  long int i, n;
-  igraph_bool_t can_skip_sort = 0;
-  igraph_i_fastgreedy_commpair *other_pair;
-
-  vec = &list->e[index].neis;
-  if (changed_pair != 0) {
-    /* Optimized sorting */
-
-    /* First we look for changed_pair in vec */
-    n = igraph_vector_ptr_size(vec);
-    for (i = 0; i < n; i++) {
-      if (VECTOR(*vec)[i] == changed_pair) {
-        break;
-      }
-    }
+  if (i < 0) {
+    IGRAPH_WARNING("pair not found in neighbor vector while removing a "
+                   "neighbor of a community; this is probably a bug");
+    return;
+  }
+  memmove(neis + i, neis + i + 1,
+          sizeof(long int) * (size_t) (list->e[c].no_of_neis - i - 1));
+  list->e[c].no_of_neis--;
+}
 
-    /* Did we find it? We should have -- otherwise it's a bug */
-    if (i >= n) {
-      IGRAPH_WARNING("changed_pair not found in neighbor vector while re-sorting "
-          "the neighbors of a community; this is probably a bug. Falling back to "
-          "full sort instead."
-      );
-    } else {
-      /* Okay, the pair that changed is at index i. We need to figure out where
-       * its new place should be. We can simply try moving the item all the way
-       * to the left as long as the comparison function tells so (since the
-       * rest of the vector is sorted), and then move all the way to the right
-       * as long as the comparison function tells so, and we will be okay. */
-
-      /* Shifting to the left */
-      while (i > 0) {
-        other_pair = VECTOR(*vec)[i-1];
-        if (other_pair->second > changed_pair->second) {
-          VECTOR(*vec)[i] = other_pair;
-          i--;
-        } else {
-          break;
-        }
-      }
-      VECTOR(*vec)[i] = changed_pair;
-
-      /* Shifting to the right */
-      while (i < n-1) {
-        other_pair = VECTOR(*vec)[i+1];
-        if (other_pair->second < changed_pair->second) {
-          VECTOR(*vec)[i] = other_pair;
-          i++;
-        } else {
-          break;
-        }
-      }
-      VECTOR(*vec)[i] = changed_pair;
+/* Redirects the pair of community c towards community `from' to community
+ * `to' and moves it to its new place in the sorted neighbor list. */
+static void igraph_i_fastgreedy_community_rename_nei(
+  igraph_i_fastgreedy_community_list* list, long int c, long int from,
+  long int to) {
+  long int i = igraph_i_fastgreedy_community_find_nei(list, c, from);
+  long int *neis = list->pool + list->e[c].neis;
+  long int n = list->e[c].no_of_neis, lo, hi, mid, p;
+
+  if (i < 0) {
+    IGRAPH_WARNING("pair not found in neighbor vector while re-sorting "
+                   "the neighbors of a community; this is probably a bug");
+    return;
+  }
+  p = neis[i];
+  list->pairs[p].second = (igraph_integer_t) to;
 
-      /* Mark that we don't need a full sort */
-      can_skip_sort = 1;
+  /* Binary search for the new place on the side where it must be */
+  if (to > from) {
+    lo = i + 1; hi = n;
+    while (lo < hi) {
+      mid = (lo + hi) / 2;
+      if (list->pairs[neis[mid]].second < to) lo = mid + 1; else hi = mid;
+    }
+    memmove(neis + i, neis + i + 1, sizeof(long int) * (size_t) (lo - i - 1));
+    neis[lo - 1] = p;
+  } else {
+    lo = 0; hi = i;
+    while (lo < hi) {
+      mid = (lo + hi) / 2;
+      if (list->pairs[neis[mid]].second < to) lo = mid + 1; else hi = mid;
     }
+    memmove(neis + lo + 1, neis + lo, sizeof(long int) * (size_t) (i - lo));
+    neis[lo] = p;
   }
+}
 
-  if (!can_skip_sort) {
-    /* Fallback to full sorting */
-    igraph_vector_ptr_sort(vec, igraph_i_fastgreedy_commpair_cmp);
+/* Updates the maximal dq of community c after the dq value of its pair p
+ * has changed. `oldmax' is the pair that was maximal before the change and
+ * `olddq' its dq value, `removed' is a pair that was removed from the
+ * neighbor list of c in the meanwhile, or -1. */
+static void igraph_i_fastgreedy_community_update_max(
+  igraph_i_fastgreedy_community_list* list, long int c, long int p,
+  long int oldmax, igraph_real_t olddq, long int removed) {
+  igraph_i_fastgreedy_community *comm = &list->e[c];
+
+  if (oldmax == p || oldmax == removed) {
+    if (DQ(list, p) >= olddq) {
+      /* The maximum was increased, no need to re-scan */
+      comm->maxdq = p;
+    } else {
+      /* The maximum was decreased, we have to re-scan the whole community */
+      igraph_i_fastgreedy_community_rescan_max(list, c);
+    }
+  } else if (DQ(list, p) > olddq) {
+    /* It was not the maximum, but it will become the maximum */
+    comm->maxdq = p;
+  } else {
+    return;
   }
+  igraph_i_fastgreedy_community_list_update(list, c);
 }
 
-/* Updates the dq value of community pair p in the community with index p->first
- * of the community list clist to newdq and restores the heap property
- * in community c if necessary. Returns 1 if the maximum in the row had
- * to be updated, zero otherwise */
-int igraph_i_fastgreedy_community_update_dq(
-  igraph_i_fastgreedy_community_list* list,
-  igraph_i_fastgreedy_commpair* p, igraph_real_t newdq) {
-  long int i,j,to,from;
-  igraph_real_t olddq;
-  igraph_i_fastgreedy_community *comm_to, *comm_from;
-  to=p->first; from=p->second;
-  comm_to=&list->e[to];
-  comm_from=&list->e[from];
-  if (comm_to->maxdq == p && newdq >= *p->dq) {
-	/* If we are adjusting the current maximum and it is increased, we don't
-	 * have to re-scan for the new maximum */
-	*p->dq = newdq;
-	/* The maximum was increased, so perform a sift-up in the heap */
-	i = igraph_i_fastgreedy_community_list_find_in_heap(list, to);
-	igraph_i_fastgreedy_community_list_sift_up(list, i);
-	/* Let's check the opposite side. If the pair was not the maximal in
-	 * the opposite side (the other community list)... */
-	if (comm_from->maxdq != p->opposite) {
-	  if (*comm_from->maxdq->dq < newdq) {
-	    /* ...and it will become the maximal, we need to adjust and sift up */
-		comm_from->maxdq = p->opposite;
-	    j = igraph_i_fastgreedy_community_list_find_in_heap(list, from);
-	    igraph_i_fastgreedy_community_list_sift_up(list, j);
-	  } else {
-		/* The pair was not the maximal in the opposite side and it will
-		 * NOT become the maximal, there's nothing to do there */
-	  }
-	} else {
-	  /* The pair was maximal in the opposite side, so we need to sift it up
-	   * with the new value */
-	  j = igraph_i_fastgreedy_community_list_find_in_heap(list, from);
-	  igraph_i_fastgreedy_community_list_sift_up(list, j);
-	}
-	return 1;
-  } else if (comm_to->maxdq != p && (newdq <= *comm_to->maxdq->dq)) {
-	/* If we are modifying an item which is not the current maximum, and the
-	 * new value is less than the current maximum, we don't
-	 * have to re-scan for the new maximum */
-	olddq = *p->dq;
-	*p->dq = newdq;
-	/* However, if the item was the maximum on the opposite side, we'd better
-	 * re-scan it */
-	if (comm_from->maxdq == p->opposite) {
-	  if (olddq>newdq) {
-		/* Decreased the maximum on the other side, we have to re-scan for the
-		 * new maximum */
-		igraph_i_fastgreedy_community_rescan_max(comm_from);
-  	    j = igraph_i_fastgreedy_community_list_find_in_heap(list, from);
-	    igraph_i_fastgreedy_community_list_sift_down(list, j);
-	  } else {
-		/* Increased the maximum on the other side, we don't have to re-scan
-		 * but we might have to sift up */
-		j = igraph_i_fastgreedy_community_list_find_in_heap(list, from);
-		igraph_i_fastgreedy_community_list_sift_up(list, j);
-	  }
-	}
-	return 0;
-  } else {
-	/* We got here in two cases:
-     (1) the pair we are modifying right now is the maximum in the given
-	     community and we are decreasing it
-	 (2) the pair we are modifying right now is NOT the maximum in the
-	     given community, but we increase it so much that it will become
-		 the new maximum
-     */
-    *p->dq = newdq;
-    if (comm_to->maxdq != p) {
-	  /* case (2) */
-	  comm_to->maxdq = p;
-	  /* The maximum was increased, so perform a sift-up in the heap */
-	  i = igraph_i_fastgreedy_community_list_find_in_heap(list, to);
-	  igraph_i_fastgreedy_community_list_sift_up(list, i);
-	  /* Opposite side. Chances are that the new value became the maximum
-	   * in the opposite side, but check it first */
-	  if (comm_from->maxdq != p->opposite) {
-		if (*comm_from->maxdq->dq < newdq) {
-		  /* Yes, it will become the new maximum */
-		  comm_from->maxdq = p->opposite;
-  	      j = igraph_i_fastgreedy_community_list_find_in_heap(list, from);
-	      igraph_i_fastgreedy_community_list_sift_up(list, j);
-		} else {
-		  /* No, nothing to do there */
-		}
-	  } else {
-	    /* Already increased the maximum on the opposite side, so sift it up */
-  	    j = igraph_i_fastgreedy_community_list_find_in_heap(list, from);
-	    igraph_i_fastgreedy_community_list_sift_up(list, j);
-	  }
-    } else {
-	  /* case (1) */
-	  /* This is the worst, we have to re-scan the whole community to find
-	   * the new maximum and update the global maximum as well if necessary */
-      igraph_i_fastgreedy_community_rescan_max(comm_to);
-	  /* The maximum was decreased, so perform a sift-down in the heap */
-	  i = igraph_i_fastgreedy_community_list_find_in_heap(list, to);
-	  igraph_i_fastgreedy_community_list_sift_down(list, i);
-  	  if (comm_from->maxdq != p->opposite) {
-		/* The one that we decreased on the opposite side is not the
-		 * maximal one. Nothing to do. */
-	  } else {
-		/* We decreased the maximal on the opposite side as well. Re-scan
-		 * and sift down */
-		igraph_i_fastgreedy_community_rescan_max(comm_from);
-	    j = igraph_i_fastgreedy_community_list_find_in_heap(list, from);
-	    igraph_i_fastgreedy_community_list_sift_down(list, j);
+/* Merges community `from' into community `to': the two sorted neighbor
+ * lists are merged into a new list at the end of the pool, the dq values
+ * are updated according to the CNM rules, and so are the maximums of the
+ * neighbors and the heap. */
+static int igraph_i_fastgreedy_community_merge(
+  igraph_i_fastgreedy_community_list* list, const igraph_vector_t *a,
+  long int from, long int to) {
+  igraph_i_fastgreedy_commpair *pairs = list->pairs;
+  igraph_i_fastgreedy_community *comm_to = &list->e[to],
+    *comm_from = &list->e[from];
+  long int n = comm_to->no_of_neis, m = comm_from->no_of_neis;
+  long int i, j, k, c, p1, p2, start, oldmax;
+  long int *neis_to, *neis_from, *merged;
+  igraph_real_t olddq, a_to = VECTOR(*a)[to], a_from = VECTOR(*a)[from];
+
+  IGRAPH_CHECK(igraph_i_fastgreedy_community_list_reserve(list, to, n + m,
+							    &start));
+  neis_to = list->pool + comm_to->neis;
+  neis_from = list->pool + comm_from->neis;
+  merged = list->pool + start;
+
+  i = j = k = 0;
+  while (i < n || j < m) {
+    p1 = i < n ? neis_to[i] : -1;
+    p2 = j < m ? neis_from[j] : -1;
+    if (p2 < 0 || (p1 >= 0 && pairs[p1].second < pairs[p2].second)) {
+      i++;
+      c = pairs[p1].second;
+      if (c == from) {
+        debug("    WILL REMOVE: %ld-%ld\n", to, from);
+        continue;
+      }
+      /* chain, case 1 */
+      oldmax = list->e[c].maxdq; olddq = DQ(list, oldmax);
+      DQ(list, p1) -= 2 * a_from * VECTOR(*a)[c];
+      debug("    CHAIN(1): %ld-%ld %ld, newdq=%.7f\n", to, c, from,
+	    DQ(list, p1));
+      merged[k++] = p1;
+      igraph_i_fastgreedy_community_update_max(list, c, OPPOSITE(p1),
+					       oldmax, olddq, -1);
+    } else if (p1 < 0 || pairs[p1].second > pairs[p2].second) {
+      j++;
+      c = pairs[p2].second;
+      if (c == to) {
+        debug("    WILL REMOVE: %ld-%ld\n", from, to);
+        continue;
       }
+      /* chain, case 2 */
+      oldmax = list->e[c].maxdq; olddq = DQ(list, oldmax);
+      DQ(list, p2) -= 2 * a_to * VECTOR(*a)[c];
+      debug("    CHAIN(2): %ld %ld-%ld, newdq=%.7f\n", to, c, from,
+	    DQ(list, p2));
+      pairs[p2].first = (igraph_integer_t) to;
+      igraph_i_fastgreedy_community_rename_nei(list, c, from, to);
+      merged[k++] = p2;
+      igraph_i_fastgreedy_community_update_max(list, c, OPPOSITE(p2),
+					       oldmax, olddq, -1);
+    } else {
+      /* p1->first, p1->second and p2->first form a triangle */
+      i++; j++;
+      c = pairs[p1].second;
+      oldmax = list->e[c].maxdq; olddq = DQ(list, oldmax);
+      DQ(list, p1) += DQ(list, p2);
+      debug("    TRIANGLE: %ld-%ld-%ld, newdq=%.7f\n", to, c, from,
+	    DQ(list, p1));
+      igraph_i_fastgreedy_community_remove_nei(list, c, from);
+      merged[k++] = p1;
+      igraph_i_fastgreedy_community_update_max(list, c, OPPOSITE(p1),
+					       oldmax, olddq, OPPOSITE(p2));
     }
   }
-  return 1;
+
+  /* The merged list is the last one in the pool, so the unused part of it
+   * can be given back right away */
+  igraph_i_fastgreedy_community_list_release(list, comm_to->neis);
+  igraph_i_fastgreedy_community_list_release(list, comm_from->neis);
+  list->pool[start-1] = k;
+  list->pool_end = start + k;
+  list->pool_used -= n + m - k;
+  comm_to->neis = start;
+  comm_to->no_of_neis = k;
+  comm_from->neis = -1;
+  comm_from->no_of_neis = 0;
+  comm_from->maxdq = -1;
+
+  igraph_i_fastgreedy_community_list_remove(list, from);
+  igraph_i_fastgreedy_community_rescan_max(list, to);
+  if (comm_to->maxdq >= 0) {
+    igraph_i_fastgreedy_community_list_update(list, to);
+  } else {
+    /* no more neighbors for this community, remove it from the heap */
+    debug("REMOVING (NO MORE NEIS): %ld\n", to);
+    igraph_i_fastgreedy_community_list_remove(list, to);
+  }
+
+  return 0;
 }
 
 /**
@@ -604,18 +581,14 @@ int igraph_community_fastgreedy(const igraph_t *graph,
 				igraph_vector_t *modularity, 
 				igraph_vector_t *membership) {
   long int no_of_edges, no_of_nodes, no_of_joins, total_joins;
-  long int i, j, k, n, m, from, to, dummy, best_no_of_joins;
-  igraph_integer_t ffrom, fto;
-  igraph_eit_t edgeit;
-  igraph_i_fastgreedy_commpair *pairs, *p1, *p2;
+  long int i, j, c, p, last, from, to, dummy, best_no_of_joins;
   igraph_i_fastgreedy_community_list communities;
+  igraph_i_fastgreedy_commpair *pairs;
   igraph_vector_t a;
   igraph_real_t q, *dq, bestq, weight_sum, loop_weight_sum;
   igraph_bool_t has_multiple;
   igraph_matrix_t merges_local;
-
-  /*long int join_order[] = { 16,5, 5,6, 6,0, 4,0, 10,0, 26,29, 29,33, 23,33, 27,33, 25,24, 24,31, 12,3, 21,1, 30,8, 8,32, 9,2, 17,1, 11,0, 7,3, 3,2, 13,2, 1,2, 28,31, 31,33, 22,32, 18,32, 20,32, 32,33, 15,33, 14,33, 0,19, 19,2, -1,-1 };*/
-  /*long int join_order[] = { 43,42, 42,41, 44,41, 41,36, 35,36, 37,36, 36,29, 38,29, 34,29, 39,29, 33,29, 40,29, 32,29, 14,29, 30,29, 31,29, 6,18, 18,4, 23,4, 21,4, 19,4, 27,4, 20,4, 22,4, 26,4, 25,4, 24,4, 17,4, 0,13, 13,2, 1,2, 11,2, 8,2, 5,2, 3,2, 10,2, 9,2, 7,2, 2,28, 28,15, 12,15, 29,16, 4,15, -1,-1 };*/
+  long int *unsorted;
 
   no_of_nodes = igraph_vcount(graph);
   no_of_edges = igraph_ecount(graph);
@@ -671,54 +644,39 @@ int igraph_community_fastgreedy(const igraph_t *graph,
 
   /* Create list of communities */
   debug("Creating community list\n");
+  memset(&communities, 0, sizeof(communities));
+  IGRAPH_FINALLY(igraph_i_fastgreedy_community_list_destroy, &communities);
   communities.n = no_of_nodes;
-  communities.no_of_communities = no_of_nodes;
-  communities.e = (igraph_i_fastgreedy_community*)calloc((size_t) no_of_nodes, sizeof(igraph_i_fastgreedy_community));
-  if (communities.e == 0) {
+  communities.e = igraph_Calloc(no_of_nodes, igraph_i_fastgreedy_community);
+  communities.heap = igraph_Calloc(no_of_nodes, igraph_integer_t);
+  communities.heapdq = igraph_Calloc(no_of_nodes, igraph_real_t);
+  communities.heapindex = igraph_Calloc(no_of_nodes, igraph_integer_t);
+  if (communities.e == 0 || communities.heap == 0 ||
+      communities.heapdq == 0 || communities.heapindex == 0) {
 	IGRAPH_ERROR("can't run fast greedy community detection", IGRAPH_ENOMEM);
   }
-  IGRAPH_FINALLY(free, communities.e);
-  communities.heap = (igraph_i_fastgreedy_community**)calloc((size_t) no_of_nodes, sizeof(igraph_i_fastgreedy_community*));
-  if (communities.heap == 0) {
-	IGRAPH_ERROR("can't run fast greedy community detection", IGRAPH_ENOMEM);
-  }
-  IGRAPH_FINALLY(free, communities.heap);
-  communities.heapindex = (igraph_integer_t*)calloc((size_t)no_of_nodes, sizeof(igraph_integer_t));
-  if (communities.heapindex == 0) {
-	IGRAPH_ERROR("can't run fast greedy community detection", IGRAPH_ENOMEM);
-  }
-  IGRAPH_FINALLY_CLEAN(2);
-  IGRAPH_FINALLY(igraph_i_fastgreedy_community_list_destroy, &communities);
   for (i=0; i<no_of_nodes; i++) {
-    igraph_vector_ptr_init(&communities.e[i].neis, 0);
     communities.e[i].id = (igraph_integer_t) i;
     communities.e[i].size = 1;
+    communities.e[i].neis = -1;
+    communities.e[i].maxdq = -1;
   }
 
   /* Create list of community pairs from edges */
   debug("Allocating dq vector\n");
-  dq = (igraph_real_t*)calloc((size_t) no_of_edges, sizeof(igraph_real_t));
-  if (dq == 0) {
-	IGRAPH_ERROR("can't run fast greedy community detection", IGRAPH_ENOMEM);
-  }
-  IGRAPH_FINALLY(free, dq);
+  dq = communities.dq = igraph_Calloc(no_of_edges, igraph_real_t);
   debug("Creating community pair list\n");
-  IGRAPH_CHECK(igraph_eit_create(graph, igraph_ess_all(0), &edgeit));
-  IGRAPH_FINALLY(igraph_eit_destroy, &edgeit);
-  pairs = (igraph_i_fastgreedy_commpair*)calloc(2*(size_t) no_of_edges, sizeof(igraph_i_fastgreedy_commpair));
-  if (pairs == 0) {
+  pairs = communities.pairs =
+    igraph_Calloc(2 * no_of_edges, igraph_i_fastgreedy_commpair);
+  if (dq == 0 || pairs == 0) {
 	IGRAPH_ERROR("can't run fast greedy community detection", IGRAPH_ENOMEM);
   }
-  IGRAPH_FINALLY(free, pairs);
   loop_weight_sum = 0;
-  for (i=0, j=0; !IGRAPH_EIT_END(edgeit); i+=2, j++, IGRAPH_EIT_NEXT(edgeit)) {
-    long int eidx = IGRAPH_EIT_GET(edgeit);
-    igraph_edge(graph, (igraph_integer_t) eidx, &ffrom, &fto);
-    
+  for (j=0; j<no_of_edges; j++) {
 	/* Create the pairs themselves */
-	from = (long int)ffrom; to = (long int)fto;
+	from = (long int) IGRAPH_FROM(graph, j); to = (long int) IGRAPH_TO(graph, j);
 	if (from == to) {
-      loop_weight_sum += weights ? 2*VECTOR(*weights)[eidx] : 2;
+      loop_weight_sum += weights ? 2*VECTOR(*weights)[j] : 2;
       continue;
     }
 
@@ -726,38 +684,76 @@ int igraph_community_fastgreedy(const igraph_t *graph,
 	  dummy=from; from=to; to=dummy;
 	}
     if (weights) {
-      dq[j]=2*(VECTOR(*weights)[eidx]/(weight_sum*2.0) - VECTOR(a)[from]*VECTOR(a)[to]/(4.0*weight_sum*weight_sum));
+      dq[j]=2*(VECTOR(*weights)[j]/(weight_sum*2.0) - VECTOR(a)[from]*VECTOR(a)[to]/(4.0*weight_sum*weight_sum));
     } else {
 	  dq[j]=2*(1.0/(no_of_edges*2.0) - VECTOR(a)[from]*VECTOR(a)[to]/(4.0*no_of_edges*no_of_edges));
     }
-	pairs[i].first = from;
-	pairs[i].second = to;
-    pairs[i].dq = &dq[j];
-	pairs[i].opposite = &pairs[i+1];
-	pairs[i+1].first = to;
-	pairs[i+1].second = from;
-	pairs[i+1].dq = pairs[i].dq;
-	pairs[i+1].opposite = &pairs[i];
-	/* Link the pair to the communities */
-	igraph_vector_ptr_push_back(&communities.e[from].neis, &pairs[i]);
-	igraph_vector_ptr_push_back(&communities.e[to].neis, &pairs[i+1]);
+	pairs[2*j].first = (igraph_integer_t) from;
+	pairs[2*j].second = (igraph_integer_t) to;
+	pairs[2*j+1].first = (igraph_integer_t) to;
+	pairs[2*j+1].second = (igraph_integer_t) from;
+	communities.e[from].no_of_neis++;
+	communities.e[to].no_of_neis++;
 	/* Update maximums */
-	if (communities.e[from].maxdq==0 || *communities.e[from].maxdq->dq < *pairs[i].dq)
-	  communities.e[from].maxdq = &pairs[i];
-	if (communities.e[to].maxdq==0 || *communities.e[to].maxdq->dq < *pairs[i+1].dq)
-	  communities.e[to].maxdq = &pairs[i+1];
+	if (communities.e[from].maxdq < 0 || dq[communities.e[from].maxdq >> 1] < dq[j])
+	  communities.e[from].maxdq = 2*j;
+	if (communities.e[to].maxdq < 0 || dq[communities.e[to].maxdq >> 1] < dq[j])
+	  communities.e[to].maxdq = 2*j+1;
+  }
+
+  /* Lay out the neighbor lists in the pool, leaving the same amount of
+   * free space for the merged lists */
+  for (i=0, p=0; i<no_of_nodes; i++) {
+    if (communities.e[i].no_of_neis > 0) {
+      communities.e[i].neis = p + 2;
+      p += communities.e[i].no_of_neis + 2;
+    }
+  }
+  communities.pool_end = communities.pool_used = p;
+  communities.pool_size = 2 * p;
+  communities.pool = igraph_Calloc(communities.pool_size > 0 ?
+				   communities.pool_size : 1, long int);
+  unsorted = igraph_Calloc(p > 0 ? p : 1, long int);
+  if (communities.pool == 0 || unsorted == 0) {
+    if (unsorted != 0) free(unsorted);
+	IGRAPH_ERROR("can't run fast greedy community detection", IGRAPH_ENOMEM);
   }
-  igraph_eit_destroy(&edgeit);
-  IGRAPH_FINALLY_CLEAN(1);
 
-  /* Sorting community neighbor lists by community IDs */
+  /* Sorting community neighbor lists by community IDs: we collect the
+   * pairs of each community first, then visit the communities in
+   * increasing order and append the opposite of each of their pairs to
+   * the list of the neighbor. */
   debug("Sorting community neighbor lists\n");
+  for (i=0; i<no_of_nodes; i++) communities.e[i].no_of_neis = 0;
+  for (p=0; p<2*no_of_edges; p++) {
+    if (pairs[p].first == pairs[p].second) continue;
+    c = pairs[p].first;
+    unsorted[communities.e[c].neis + communities.e[c].no_of_neis++] = p;
+  }
+  for (i=0; i<no_of_nodes; i++) {
+    if (communities.e[i].neis >= 0) {
+      communities.pool[communities.e[i].neis - 2] = i;
+      communities.pool[communities.e[i].neis - 1] = communities.e[i].no_of_neis;
+    }
+    communities.e[i].no_of_neis = 0;
+  }
+  for (i=0; i<no_of_nodes; i++) {
+    if (communities.e[i].neis < 0) continue;
+    last = communities.e[i].neis + communities.pool[communities.e[i].neis-1];
+    for (j=communities.e[i].neis; j<last; j++) {
+      p = OPPOSITE(unsorted[j]);
+      c = pairs[p].first;
+      communities.pool[communities.e[c].neis + communities.e[c].no_of_neis++] = p;
+    }
+  }
+  free(unsorted);
+
+  /* Isolated vertices and vertices with loop edges only won't be stored in
+   * the heap (to avoid maxdq == -1) */
   for (i=0, j=0; i<no_of_nodes; i++) {
-    igraph_i_fastgreedy_community_sort_neighbors_of(&communities, i, 0);
-    /* Isolated vertices and vertices with loop edges only won't be stored in
-     * the heap (to avoid maxdq == 0) */
-    if (communities.e[i].maxdq != 0) {
-      communities.heap[j] = &communities.e[i];
+    if (communities.e[i].maxdq >= 0) {
+      communities.heap[j] = (igraph_integer_t) i;
+      communities.heapdq[j] = DQ(&communities, communities.e[i].maxdq);
       communities.heapindex[i] = (igraph_integer_t) j;
       j++;
     } else {
@@ -805,168 +801,25 @@ int igraph_community_fastgreedy(const igraph_t *graph,
 
 	/* Some debug info if needed */
 	/* igraph_i_fastgreedy_community_list_check_heap(&communities); */
-#ifdef DEBUG
-	debug("===========================================\n");
-	for (i=0; i<communities.n; i++) {
-	  if (communities.e[i].maxdq == 0) {
-	    debug("Community #%ld: PASSIVE\n", i);
-	    continue;
-	  }
-      debug("Community #%ld\n ", i);
-	  for (j=0; j<igraph_vector_ptr_size(&communities.e[i].neis); j++) {
-	    p1=(igraph_i_fastgreedy_commpair*)VECTOR(communities.e[i].neis)[j];
-	    debug(" (%ld,%ld,%.4f)", p1->first, p1->second, *p1->dq);
-	  }
-	  p1=communities.e[i].maxdq;
-	  debug("\n  Maxdq: (%ld,%ld,%.4f)\n", p1->first, p1->second, *p1->dq);
-    }
-	debug("Global maxdq is: (%ld,%ld,%.4f)\n", communities.heap[0]->maxdq->first,
-	    communities.heap[0]->maxdq->second, *communities.heap[0]->maxdq->dq);
-    for (i=0; i<communities.no_of_communities; i++)
-	  debug("(%ld,%ld,%.4f) ", communities.heap[i]->maxdq->first, communities.heap[i]->maxdq->second, *communities.heap[0]->maxdq->dq);
-	debug("\n");
-#endif
-	if (communities.heap[0] == 0) break; /* no more communities */
-	if (communities.heap[0]->maxdq == 0) break; /* there are only isolated comms */
-    to=communities.heap[0]->maxdq->second;
-	from=communities.heap[0]->maxdq->first;
+	if (communities.no_of_communities == 0) break; /* there are only isolated comms */
+	from=communities.heap[0];
+	to=pairs[communities.e[from].maxdq].second;
 
 	debug("Q[%ld] = %.7f\tdQ = %.7f\t |H| = %ld\n",
-	  no_of_joins, q, *communities.heap[0]->maxdq->dq, no_of_nodes-no_of_joins-1);
-
-	/* DEBUG */
-	/* from=join_order[no_of_joins*2]; to=join_order[no_of_joins*2+1];
-	if (to == -1) break;
-    for (i=0; i<igraph_vector_ptr_size(&communities.e[to].neis); i++) {
-      p1=(igraph_i_fastgreedy_commpair*)VECTOR(communities.e[to].neis)[i];
-	  if (p1->second == from) communities.maxdq = p1;
-	} */
-
-	n = igraph_vector_ptr_size(&communities.e[to].neis);
-	m = igraph_vector_ptr_size(&communities.e[from].neis);
-	/*if (n>m) {
-	  dummy=n; n=m; m=dummy;
-	  dummy=to; to=from; from=dummy;
-	}*/
+	  no_of_joins, q, communities.heapdq[0], no_of_nodes-no_of_joins-1);
+
 	debug("  joining: %ld <- %ld\n", to, from);
-    q += *communities.heap[0]->maxdq->dq; 
+    q += communities.heapdq[0];
 	
 	/* Merge the second community into the first */
-	i = j = 0;
-	while (i<n && j<m) {
-	  p1 = (igraph_i_fastgreedy_commpair*)VECTOR(communities.e[to].neis)[i];
-	  p2 = (igraph_i_fastgreedy_commpair*)VECTOR(communities.e[from].neis)[j];
-	  debug("Pairs: %ld-%ld and %ld-%ld\n", p1->first, p1->second,
-		  p2->first, p2->second);
-	  if (p1->second < p2->second) {
-		/* Considering p1 from now on */
-		debug("    Considering: %ld-%ld\n", p1->first, p1->second);
-	    if (p1->second == from) {
-		  debug("    WILL REMOVE: %ld-%ld\n", to, from);
-	    } else {
-		  /* chain, case 1 */
-		  debug("    CHAIN(1): %ld-%ld %ld, now=%.7f, adding=%.7f, newdq(%ld,%ld)=%.7f\n",
-		    to, p1->second, from, *p1->dq, -2*VECTOR(a)[from]*VECTOR(a)[p1->second], p1->first, p1->second, *p1->dq-2*VECTOR(a)[from]*VECTOR(a)[p1->second]);
-		  igraph_i_fastgreedy_community_update_dq(&communities, p1, *p1->dq - 2*VECTOR(a)[from]*VECTOR(a)[p1->second]);
-		}
-		i++;
-	  } else if (p1->second == p2->second) {
-	    /* p1->first, p1->second and p2->first form a triangle */
-		debug("    Considering: %ld-%ld and %ld-%ld\n", p1->first, p1->second,
-		  p2->first, p2->second);
-		/* Update dq value */
-		debug("    TRIANGLE: %ld-%ld-%ld, now=%.7f, adding=%.7f, newdq(%ld,%ld)=%.7f\n",
-		  to, p1->second, from, *p1->dq, *p2->dq, p1->first, p1->second, *p1->dq+*p2->dq);
-		igraph_i_fastgreedy_community_update_dq(&communities, p1, *p1->dq + *p2->dq);
-        igraph_i_fastgreedy_community_remove_nei(&communities, p1->second, from);
-		i++;
-		j++;
-	  } else {
-		debug("    Considering: %ld-%ld\n", p2->first, p2->second);
-		if (p2->second == to) {
-		  debug("    WILL REMOVE: %ld-%ld\n", p2->second, p2->first);
-		} else {
-		  /* chain, case 2 */
-		  debug("    CHAIN(2): %ld %ld-%ld, newdq(%ld,%ld)=%.7f\n",
-		    to, p2->second, from, to, p2->second, *p2->dq-2*VECTOR(a)[to]*VECTOR(a)[p2->second]);
-		  p2->opposite->second=to;
-		  /* p2->opposite->second changed, so it means that
-		   * communities.e[p2->second].neis (which contains p2->opposite) is
-		   * not sorted any more. We have to find the index of p2->opposite in
-		   * this vector and move it to the correct place. Moving should be an
-		   * O(n) operation; re-sorting would be O(n*logn) or even worse,
-		   * depending on the pivoting strategy used by qsort() since the
-		   * vector is nearly sorted */
-		  igraph_i_fastgreedy_community_sort_neighbors_of(
-				  &communities, p2->second, p2->opposite);
-		  /* link from.neis[j] to the current place in to.neis if
-		   * from.neis[j] != to */
-		  p2->first=to;
-		  IGRAPH_CHECK(igraph_vector_ptr_insert(&communities.e[to].neis,i,p2));
-		  n++; i++;
-		  if (*p2->dq > *communities.e[to].maxdq->dq) {
-		    communities.e[to].maxdq = p2;
-            k=igraph_i_fastgreedy_community_list_find_in_heap(&communities, to);
-		    igraph_i_fastgreedy_community_list_sift_up(&communities, k);
-		  }
-		  igraph_i_fastgreedy_community_update_dq(&communities, p2, *p2->dq - 2*VECTOR(a)[to]*VECTOR(a)[p2->second]);
-		}
-		j++;
-	  }
-	}
-
-	while (i<n) {
-	  p1 = (igraph_i_fastgreedy_commpair*)VECTOR(communities.e[to].neis)[i];
-	  if (p1->second == from) {
-	    debug("    WILL REMOVE: %ld-%ld\n", p1->first, from);
-	  } else {
-	    /* chain, case 1 */
-	    debug("    CHAIN(1): %ld-%ld %ld, now=%.7f, adding=%.7f, newdq(%ld,%ld)=%.7f\n",
-	      to, p1->second, from, *p1->dq, -2*VECTOR(a)[from]*VECTOR(a)[p1->second], p1->first, p1->second, *p1->dq-2*VECTOR(a)[from]*VECTOR(a)[p1->second]);
-	    igraph_i_fastgreedy_community_update_dq(&communities, p1, *p1->dq - 2*VECTOR(a)[from]*VECTOR(a)[p1->second]);
-	  }
-	  i++;
-	}
-	while (j<m) {
-	  p2 = (igraph_i_fastgreedy_commpair*)VECTOR(communities.e[from].neis)[j];
-      if (to == p2->second) { j++; continue; }
-	  /* chain, case 2 */
-	  debug("    CHAIN(2): %ld %ld-%ld, newdq(%ld,%ld)=%.7f\n",
-	    to, p2->second, from, p1->first, p2->second, *p2->dq-2*VECTOR(a)[to]*VECTOR(a)[p2->second]);
-	  p2->opposite->second=to;
-	  /* need to re-sort community nei list `p2->second` */
-      igraph_i_fastgreedy_community_sort_neighbors_of(&communities, p2->second, p2->opposite);
-	  /* link from.neis[j] to the current place in to.neis if
-	   * from.neis[j] != to */
-	  p2->first=to;
-	  IGRAPH_CHECK(igraph_vector_ptr_push_back(&communities.e[to].neis,p2));
-	  if (*p2->dq > *communities.e[to].maxdq->dq) {
-	    communities.e[to].maxdq = p2;
-        k=igraph_i_fastgreedy_community_list_find_in_heap(&communities, to);
-		igraph_i_fastgreedy_community_list_sift_up(&communities, k);
-	  }
-	  igraph_i_fastgreedy_community_update_dq(&communities, p2, *p2->dq-2*VECTOR(a)[to]*VECTOR(a)[p2->second]);
-	  j++;
-	}
-
-	/* Now, remove community `from` from the neighbors of community `to` */
-	if (communities.no_of_communities > 2) {
-	  debug("    REMOVING: %ld-%ld\n", to, from);
-	  igraph_i_fastgreedy_community_remove_nei(&communities, to, from);
-	  i=igraph_i_fastgreedy_community_list_find_in_heap(&communities, from);
-	  igraph_i_fastgreedy_community_list_remove(&communities, i);
-    }
-	communities.e[from].maxdq=0;
+	IGRAPH_CHECK(igraph_i_fastgreedy_community_merge(&communities, &a,
+							 from, to));
 
     /* Update community sizes */
     communities.e[to].size += communities.e[from].size;
     communities.e[from].size = 0;
 
 	/* record what has been merged */
-	/* igraph_vector_ptr_clear is not enough here as it won't free
-	 * the memory consumed by communities.e[from].neis. Thanks
-	 * to Tom Gregorovic for pointing that out. */
-	igraph_vector_ptr_destroy(&communities.e[from].neis);
 	if (merges) {
 	  MATRIX(*merges, no_of_joins, 0) = communities.e[to].id;
 	  MATRIX(*merges, no_of_joins, 1) = communities.e[from].id;
@@ -1002,11 +855,9 @@ int igraph_community_fastgreedy(const igraph_t *graph,
   }
 
   debug("Freeing memory\n");
-  free(pairs);
-  free(dq);
   igraph_i_fastgreedy_community_list_destroy(&communities);
   igraph_vector_destroy(&a);
-  IGRAPH_FINALLY_CLEAN(4);
+  IGRAPH_FINALLY_CLEAN(2);
 
   if (membership) {
     IGRAPH_CHECK(igraph_community_to_membership(merges,
@@ -0,0 +1,369 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#include "igraph_foreign.h"
+#include "config.h"
+#include "igraph_memory.h"
+#include "igraph_attributes.h"
+#include "igraph_interface.h"
+#include "igraph_conversion.h"
+#include "igraph_interface_internal.h"
+
+#include <string.h>
+#include <limits.h>
+
+#ifdef HAVE_STDINT_H
+#  include <stdint.h>
+#else
+#  ifdef HAVE_SYS_INT_TYPES_H
+#    include <sys/int_types.h>
+#  else
+#    include "pstdint.h"
+#  endif
+#endif
+
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H) && \
+  defined(HAVE_SYS_STAT_H) && defined(HAVE_UNISTD_H)
+#  define IGRAPH_I_HAVE_MMAP 1
+#  include <sys/types.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+/*
+ * The binary format is a fixed size header, followed by the six
+ * vectors of the igraph_t index, in the byte order and integer size
+ * of the machine that wrote it: from, to, oi, ii (number of edges
+ * elements each), os and is (number of vertices plus one elements
+ * each). The header is 40 bytes, so the vectors are aligned if the
+ * header is.
+ */
+
+#define IGRAPH_I_BINARY_MAGIC "IGRAPHBI"
+#define IGRAPH_I_BINARY_VERSION 1
+#define IGRAPH_I_BINARY_BYTEORDER 0x01020304
+
+typedef struct igraph_i_binary_header_t {
+  char magic[8];
+  uint32_t version;
+  uint32_t byteorder;
+  uint32_t intsize;
+  uint32_t directed;
+  int64_t no_of_nodes;
+  int64_t no_of_edges;
+} igraph_i_binary_header_t;
+
+typedef struct igraph_i_mapping_t {
+  void *addr;
+  size_t length;
+} igraph_i_mapping_t;
+
+void igraph_i_mapping_release(void *mapping) {
+  igraph_i_mapping_t *m=(igraph_i_mapping_t*) mapping;
+#ifdef IGRAPH_I_HAVE_MMAP
+  munmap(m->addr, m->length);
+#endif
+  igraph_Free(m);
+}
+
+/**
+ * \ingroup loadsave
+ * \function igraph_write_graph_binary
+ * \brief Writes the graph to a file in igraph's binary format.
+ *
+ * </para><para>
+ * The binary format is a dump of the internal edge index of the
+ * graph, so it can be read back by \ref igraph_read_graph_binary()
+ * without any parsing or sorting. It is meant for fast loading of
+ * large graphs on the same machine: the file uses the byte order and
+ * the integer size of the writer, and it is not portable across
+ * platforms. Attributes are not written.
+ * \param graph The graph to write.
+ * \param outstream The stream to write to, it should be writable
+ *        and opened in binary mode.
+ * \return Error code:
+ *         \c IGRAPH_EFILE if there is an error writing the file.
+ *
+ * Time complexity: O(|V|+|E|), the number of vertices plus the
+ * number of edges.
+ */
+
+int igraph_write_graph_binary(const igraph_t *graph, FILE *outstream) {
+  igraph_i_binary_header_t header;
+  const igraph_vector_int_t *vecs[6];
+  int i;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, IGRAPH_I_BINARY_MAGIC, sizeof(header.magic));
+  header.version=IGRAPH_I_BINARY_VERSION;
+  header.byteorder=IGRAPH_I_BINARY_BYTEORDER;
+  header.intsize=sizeof(int);
+  header.directed=igraph_is_directed(graph) ? 1 : 0;
+  header.no_of_nodes=igraph_vcount(graph);
+  header.no_of_edges=igraph_ecount(graph);
+
+  if (fwrite(&header, sizeof(header), 1, outstream) != 1) {
+    IGRAPH_ERROR("Write error", IGRAPH_EFILE);
+  }
+
+  vecs[0]=&graph->from; vecs[1]=&graph->to;
+  vecs[2]=&graph->oi;   vecs[3]=&graph->ii;
+  vecs[4]=&graph->os;   vecs[5]=&graph->is;
+  for (i=0; i<6; i++) {
+    size_t n=(size_t) igraph_vector_int_size(vecs[i]);
+    if (n > 0 && fwrite(VECTOR(*vecs[i]), sizeof(int), n, outstream) != n) {
+      IGRAPH_ERROR("Write error", IGRAPH_EFILE);
+    }
+  }
+
+  return 0;
+}
+
+#ifdef IGRAPH_I_HAVE_MMAP
+
+/* Map the file, if it is a regular file and the data is suitably
+   aligned. Sets '*addr' to null if the file cannot be mapped. */
+
+static void igraph_i_binary_map(FILE *instream, long int offset,
+				 size_t length, void **addr) {
+  struct stat st;
+  int fd=fileno(instream);
+  void *p;
+
+  *addr=0;
+  if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) { return; }
+  if ((size_t) st.st_size < (size_t) offset + length) { return; }
+  if (offset % sizeof(int64_t) != 0) { return; }
+  p=mmap(0, (size_t) offset + length, PROT_READ, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED) { return; }
+  *addr=p;
+}
+
+#endif
+
+/* Check one half of the edge index read from a file: the ids in
+   'from' and 'to' are valid, 'os' is non-decreasing, and 'oi' is a
+   permutation of the edges that lists the edges of vertex v, ordered
+   by 'to', between os[v] and os[v+1]. The other half is checked
+   with 'from' and 'to' exchanged. 'seen' is a work vector. */
+
+static int igraph_i_binary_check_index(const igraph_vector_int_t *from,
+					const igraph_vector_int_t *to,
+					const igraph_vector_int_t *oi,
+					const igraph_vector_int_t *os,
+					long int no_of_nodes,
+					long int no_of_edges,
+					igraph_vector_bool_t *seen) {
+  long int v, k;
+
+  igraph_vector_bool_null(seen);
+  if (VECTOR(*os)[0] != 0 || VECTOR(*os)[no_of_nodes] != no_of_edges) {
+    IGRAPH_ERROR("Invalid binary graph file", IGRAPH_PARSEERROR);
+  }
+  for (v=0; v<no_of_nodes; v++) {
+    if (VECTOR(*os)[v] > VECTOR(*os)[v+1] ||
+	VECTOR(*os)[v+1] > no_of_edges) {
+      IGRAPH_ERROR("Invalid binary graph file", IGRAPH_PARSEERROR);
+    }
+    for (k=VECTOR(*os)[v]; k<VECTOR(*os)[v+1]; k++) {
+      int e=VECTOR(*oi)[k];
+      if (e < 0 || e >= no_of_edges || VECTOR(*seen)[e] ||
+	  VECTOR(*from)[e] != v ||
+	  VECTOR(*to)[e] < 0 || VECTOR(*to)[e] >= no_of_nodes ||
+	  (k > VECTOR(*os)[v] &&
+	   VECTOR(*to)[VECTOR(*oi)[k-1]] > VECTOR(*to)[e])) {
+	IGRAPH_ERROR("Invalid binary graph file", IGRAPH_PARSEERROR);
+      }
+      VECTOR(*seen)[e]=1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * \ingroup loadsave
+ * \function igraph_read_graph_binary
+ * \brief Reads a graph from a file in igraph's binary format.
+ *
+ * </para><para>
+ * Reads a graph written by \ref igraph_write_graph_binary(), from
+ * the current position of the stream. The file contains the edge
+ * index of the graph, so there is nothing to parse or sort.
+ *
+ * </para><para>
+ * If \p map is true, the stream is a regular file and the system
+ * supports it, then the file is mapped to memory read-only instead of
+ * being read. The graph can be queried right away, the operating
+ * system reads the parts of the file that are actually used, and
+ * several processes can share the same copy of a large graph. The
+ * file must not be modified while the graph exists, but the stream
+ * itself can be closed. Such a graph can be modified like any other
+ * graph: the index is copied to memory first. If the file cannot be
+ * mapped, then it is read into memory.
+ *
+ * </para><para>
+ * A file that is read into memory is checked completely, and a
+ * damaged file gives an \c IGRAPH_PARSEERROR. A mapped file is
+ * trusted: only its header and its size are checked, because checking
+ * the index would read the whole file. A damaged mapped file, or one
+ * that is modified while the graph exists, can make later igraph
+ * calls on the graph return wrong results or crash. Only map files
+ * written by \ref igraph_write_graph_binary() that you trust.
+ * \param graph Pointer to an uninitialized graph object.
+ * \param instream The stream to read from, opened in binary mode.
+ * \param map Whether to map the file into memory if possible,
+ *        instead of reading it.
+ * \return Error code:
+ *         \c IGRAPH_PARSEERROR if the file is not in igraph's
+ *         binary format, or it was written on a different platform,
+ *         \c IGRAPH_EFILE if there is an error reading the file.
+ *
+ * Time complexity: O(|V|+|E|), the number of vertices plus the
+ * number of edges, for reading the file into memory. O(1) plus the
+ * cost of the attribute handler, if the file is mapped.
+ */
+
+int igraph_read_graph_binary(igraph_t *graph, FILE *instream,
+			     igraph_bool_t map) {
+  igraph_i_binary_header_t header;
+  long int offset=ftell(instream);
+  long int no_of_nodes, no_of_edges;
+  size_t length;
+  igraph_vector_int_t *vecs[6];
+  long int sizes[6];
+  void *addr=0;
+  int i;
+
+  if (fread(&header, sizeof(header), 1, instream) != 1) {
+    IGRAPH_ERROR("Cannot read binary graph, file too short",
+		 IGRAPH_PARSEERROR);
+  }
+  if (memcmp(header.magic, IGRAPH_I_BINARY_MAGIC, sizeof(header.magic))) {
+    IGRAPH_ERROR("Not an igraph binary graph file", IGRAPH_PARSEERROR);
+  }
+  if (header.version != IGRAPH_I_BINARY_VERSION) {
+    IGRAPH_ERROR("Unknown igraph binary graph format version",
+		 IGRAPH_PARSEERROR);
+  }
+  if (header.byteorder != IGRAPH_I_BINARY_BYTEORDER ||
+      header.intsize != sizeof(int)) {
+    IGRAPH_ERROR("Binary graph file was written on a different platform",
+		 IGRAPH_PARSEERROR);
+  }
+  if (header.no_of_nodes < 0 || header.no_of_nodes >= INT_MAX ||
+      header.no_of_edges < 0 || header.no_of_edges > INT_MAX) {
+    IGRAPH_ERROR("Invalid binary graph file", IGRAPH_PARSEERROR);
+  }
+
+  no_of_nodes=(long int) header.no_of_nodes;
+  no_of_edges=(long int) header.no_of_edges;
+  sizes[0]=sizes[1]=sizes[2]=sizes[3]=no_of_edges;
+  sizes[4]=sizes[5]=no_of_nodes+1;
+  length=sizeof(int) * (4 * (size_t) no_of_edges + 2 * (size_t) no_of_nodes
+			+ 2);
+
+  graph->n=(igraph_integer_t) no_of_nodes;
+  graph->directed=header.directed ? 1 : 0;
+  graph->mapping=0;
+  graph->attr=0;
+  vecs[0]=&graph->from; vecs[1]=&graph->to;
+  vecs[2]=&graph->oi;   vecs[3]=&graph->ii;
+  vecs[4]=&graph->os;   vecs[5]=&graph->is;
+
+#ifdef IGRAPH_I_HAVE_MMAP
+  if (map && offset >= 0) {
+    igraph_i_binary_map(instream, offset + (long int) sizeof(header),
+			length, &addr);
+  }
+#endif
+
+  if (addr) {
+    igraph_i_mapping_t *mapping=igraph_Calloc(1, igraph_i_mapping_t);
+    const int *data;
+    if (!mapping) {
+#ifdef IGRAPH_I_HAVE_MMAP
+      munmap(addr, (size_t) offset + sizeof(header) + length);
+#endif
+      IGRAPH_ERROR("Cannot read binary graph", IGRAPH_ENOMEM);
+    }
+    mapping->addr=addr;
+    mapping->length=(size_t) offset + sizeof(header) + length;
+    data=(const int*) ((const char*) addr + offset + sizeof(header));
+    for (i=0; i<6; i++) {
+      igraph_vector_int_view(vecs[i], data, sizes[i]);
+      data += sizes[i];
+    }
+    graph->mapping=mapping;
+    IGRAPH_FINALLY(igraph_destroy, graph);
+    /* A mapped file is trusted, only the ends of the index are checked */
+    if (VECTOR(graph->os)[0] != 0 || VECTOR(graph->is)[0] != 0 ||
+	VECTOR(graph->os)[no_of_nodes] != no_of_edges ||
+	VECTOR(graph->is)[no_of_nodes] != no_of_edges) {
+      IGRAPH_ERROR("Invalid binary graph file", IGRAPH_PARSEERROR);
+    }
+    if (fseek(instream, offset + (long int) (sizeof(header) + length),
+	      SEEK_SET) != 0) {
+      IGRAPH_ERROR("Cannot read binary graph", IGRAPH_EFILE);
+    }
+  } else {
+    igraph_vector_bool_t seen;
+    for (i=0; i<6; i++) {
+      IGRAPH_VECTOR_INT_INIT_FINALLY(vecs[i], sizes[i]);
+    }
+    for (i=0; i<6; i++) {
+      if (sizes[i] > 0 &&
+	  fread(VECTOR(*vecs[i]), sizeof(int), (size_t) sizes[i],
+		instream) != (size_t) sizes[i]) {
+	IGRAPH_ERROR("Cannot read binary graph, file too short",
+		     IGRAPH_PARSEERROR);
+      }
+    }
+    IGRAPH_VECTOR_BOOL_INIT_FINALLY(&seen, no_of_edges);
+    IGRAPH_CHECK(igraph_i_binary_check_index(&graph->from, &graph->to,
+					     &graph->oi, &graph->os,
+					     no_of_nodes, no_of_edges, &seen));
+    IGRAPH_CHECK(igraph_i_binary_check_index(&graph->to, &graph->from,
+					     &graph->ii, &graph->is,
+					     no_of_nodes, no_of_edges, &seen));
+    igraph_vector_bool_destroy(&seen);
+    IGRAPH_FINALLY_CLEAN(7);
+    IGRAPH_FINALLY(igraph_destroy, graph);
+  }
+
+  /* Let the attribute handler know about the vertices and edges */
+  IGRAPH_CHECK(igraph_i_attribute_init(graph, 0));
+  if (graph->attr) {
+    igraph_vector_t edges;
+    IGRAPH_CHECK(igraph_i_attribute_add_vertices(graph, no_of_nodes, 0));
+    IGRAPH_VECTOR_INIT_FINALLY(&edges, 0);
+    IGRAPH_CHECK(igraph_get_edgelist(graph, &edges, /*bycol=*/ 0));
+    IGRAPH_CHECK(igraph_i_attribute_add_edges(graph, &edges, 0));
+    igraph_vector_destroy(&edges);
+    IGRAPH_FINALLY_CLEAN(1);
+  }
+
+  IGRAPH_FINALLY_CLEAN(1);
+  return 0;
+}
@@ -31,11 +31,21 @@
 #include "igraph_interrupt_internal.h"
 #include "igraph_constructors.h"
 #include "igraph_types_internal.h"
+#include "igraph_parallel_internal.h"
 
 #include <ctype.h>		/* isspace */
 #include <string.h>
 #include <time.h>
 
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H) && \
+  defined(HAVE_SYS_STAT_H) && defined(HAVE_UNISTD_H)
+#  define IGRAPH_I_HAVE_MMAP 1
+#  include <sys/types.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
 /**
  * \section about_loadsave 
  * 
@@ -47,6 +57,211 @@
  * operating systems supporting \quote non-standard\endquote streams.</para>
  */
 
+/*
+ * Edge list reader. The rest of the input is mapped to memory, or
+ * read into memory if it cannot be mapped, and cut into chunks at
+ * whitespace. The chunks are parsed in parallel, in two passes: the
+ * first one counts the numbers in each chunk, the second one writes
+ * them to their final place in the edge vector. Numbers are read like
+ * fscanf("%li") does, so octal and hexadecimal numbers are accepted.
+ */
+
+#define IGRAPH_I_EDGELIST_CHUNK (1 << 20)
+#define IGRAPH_I_ISSPACE(c) ((c) == ' ' || ((c) >= '\t' && (c) <= '\r'))
+
+typedef struct igraph_i_textbuf_t {
+  const char *data;
+  size_t size;
+  void *map_addr;
+  size_t map_length;
+  char *mem;
+} igraph_i_textbuf_t;
+
+static void igraph_i_textbuf_destroy(igraph_i_textbuf_t *buf) {
+#ifdef IGRAPH_I_HAVE_MMAP
+  if (buf->map_addr) { munmap(buf->map_addr, buf->map_length); }
+#endif
+  if (buf->mem) { igraph_Free(buf->mem); }
+}
+
+static int igraph_i_textbuf_init(igraph_i_textbuf_t *buf, FILE *instream) {
+  size_t alloc=IGRAPH_I_EDGELIST_CHUNK, n;
+
+  memset(buf, 0, sizeof(igraph_i_textbuf_t));
+
+#ifdef IGRAPH_I_HAVE_MMAP
+  {
+    long int offset=ftell(instream);
+    int fd=fileno(instream);
+    struct stat st;
+    if (offset >= 0 && fd >= 0 && fstat(fd, &st) == 0 && 
+	S_ISREG(st.st_mode) && st.st_size > offset) {
+      void *p=mmap(0, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      if (p != MAP_FAILED) {
+	buf->map_addr=p;
+	buf->map_length=(size_t) st.st_size;
+	buf->data=(const char *) p + offset;
+	buf->size=(size_t) (st.st_size - offset);
+	fseek(instream, 0, SEEK_END);
+	return 0;
+      }
+    }
+  }
+#endif
+
+  buf->mem=igraph_Calloc(alloc, char);
+  if (!buf->mem) {
+    IGRAPH_ERROR("Cannot read edge list", IGRAPH_ENOMEM);
+  }
+  while ((n=fread(buf->mem + buf->size, 1, alloc - buf->size, 
+		  instream)) > 0) {
+    buf->size += n;
+    if (buf->size == alloc) {
+      char *tmp=igraph_Realloc(buf->mem, 2*alloc, char);
+      if (!tmp) {
+	igraph_Free(buf->mem);
+	IGRAPH_ERROR("Cannot read edge list", IGRAPH_ENOMEM);
+      }
+      buf->mem=tmp;
+      alloc *= 2;
+    }
+  }
+  if (ferror(instream)) {
+    igraph_Free(buf->mem);
+    IGRAPH_ERROR("Cannot read edge list", IGRAPH_EFILE);
+  }
+  buf->data=buf->mem;
+  return 0;
+}
+
+static long int igraph_i_edgelist_count(const char *p, const char *end) {
+  long int n=0;
+  while (p < end) {
+    while (p < end && IGRAPH_I_ISSPACE(*p)) { p++; }
+    if (p < end) { n++; }
+    while (p < end && !IGRAPH_I_ISSPACE(*p)) { p++; }
+  }
+  return n;
+}
+
+/* Parses the numbers of a chunk into 'res'. Returns non-zero for a
+   syntax error. */
+
+static int igraph_i_edgelist_parse(const char *p, const char *end,
+				   igraph_real_t *res) {
+  while (p < end) {
+    igraph_real_t value=0;
+    int negative=0, base=10, digits=0;
+
+    while (p < end && IGRAPH_I_ISSPACE(*p)) { p++; }
+    if (p == end) { break; }
+
+    if (*p == '-' || *p == '+') { negative = *p == '-'; p++; }
+    if (p < end && *p == '0') {
+      base=8; digits=1; p++;
+      if (p+1 < end && (*p == 'x' || *p == 'X') && isxdigit((unsigned char) p[1])) {
+	base=16; p++;
+      }
+    }
+    while (p < end && !IGRAPH_I_ISSPACE(*p)) {
+      int d;
+      if (*p >= '0' && *p <= '9') {
+	d = *p - '0';
+      } else if (*p >= 'a' && *p <= 'f') {
+	d = *p - 'a' + 10;
+      } else if (*p >= 'A' && *p <= 'F') {
+	d = *p - 'A' + 10;
+      } else {
+	return 1;
+      }
+      if (d >= base) { return 1; }
+      value = value * base + d;
+      digits++;
+      p++;
+    }
+    if (!digits) { return 1; }
+    *(res++) = negative ? -value : value;
+  }
+  return 0;
+}
+
+static int igraph_i_read_edgelist(igraph_vector_t *edges, FILE *instream) {
+  igraph_i_textbuf_t buf;
+  igraph_vector_long_t bounds, counts;
+  long int no_of_chunks, no_of_numbers, k, first, step;
+  int nthreads;
+  igraph_bool_t failed=0;
+
+  IGRAPH_CHECK(igraph_i_textbuf_init(&buf, instream));
+  IGRAPH_FINALLY(igraph_i_textbuf_destroy, &buf);
+
+  /* Chunks end at whitespace, so that no number is split */
+  no_of_chunks=(long int) (buf.size / IGRAPH_I_EDGELIST_CHUNK) + 1;
+  IGRAPH_CHECK(igraph_vector_long_init(&bounds, no_of_chunks+1));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &bounds);
+  IGRAPH_CHECK(igraph_vector_long_init(&counts, no_of_chunks+1));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &counts);
+  for (k=1; k<no_of_chunks; k++) {
+    long int b=k * IGRAPH_I_EDGELIST_CHUNK;
+    if (b < VECTOR(bounds)[k-1]) { b=VECTOR(bounds)[k-1]; }
+    while (b < (long int) buf.size && !IGRAPH_I_ISSPACE(buf.data[b])) { b++; }
+    VECTOR(bounds)[k]=b;
+  }
+  VECTOR(bounds)[no_of_chunks]=(long int) buf.size;
+  nthreads=IGRAPH_I_THREAD_COUNT(no_of_chunks);
+
+  step=IGRAPH_I_PARALLEL_CHUNK(nthreads);
+  for (first=0; first<no_of_chunks; first+=step) {
+    long int last= first+step < no_of_chunks ? first+step : no_of_chunks;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic, 1)
+#endif
+    for (k=first; k<last; k++) {
+      VECTOR(counts)[k+1]=
+	igraph_i_edgelist_count(buf.data + VECTOR(bounds)[k],
+				buf.data + VECTOR(bounds)[k+1]);
+    }
+    IGRAPH_ALLOW_INTERRUPTION();
+  }
+
+  for (k=0; k<no_of_chunks; k++) {
+    VECTOR(counts)[k+1] += VECTOR(counts)[k];
+  }
+  no_of_numbers=VECTOR(counts)[no_of_chunks];
+  if (no_of_numbers % 2 != 0) {
+    IGRAPH_ERROR("parsing edgelist file failed", IGRAPH_PARSEERROR);
+  }
+  IGRAPH_CHECK(igraph_vector_resize(edges, no_of_numbers));
+
+  for (first=0; first<no_of_chunks && !failed; first+=step) {
+    long int last= first+step < no_of_chunks ? first+step : no_of_chunks;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic, 1)
+#endif
+    for (k=first; k<last; k++) {
+      if (igraph_i_edgelist_parse(buf.data + VECTOR(bounds)[k],
+				  buf.data + VECTOR(bounds)[k+1],
+				  VECTOR(*edges) + VECTOR(counts)[k])) {
+#ifdef _OPENMP
+#pragma omp atomic write
+#endif
+	failed=1;
+      }
+    }
+    IGRAPH_ALLOW_INTERRUPTION();
+  }
+  if (failed) {
+    IGRAPH_ERROR("parsing edgelist file failed", IGRAPH_PARSEERROR);
+  }
+
+  igraph_vector_long_destroy(&counts);
+  igraph_vector_long_destroy(&bounds);
+  igraph_i_textbuf_destroy(&buf);
+  IGRAPH_FINALLY_CLEAN(3);
+
+  return 0;
+}
+
 /**
  * \ingroup loadsave
  * \function igraph_read_graph_edgelist
@@ -57,8 +272,16 @@
  * whitespace. The one edge (ie. two integers) per line format is thus
  * not required (but recommended for readability). Edges of directed
  * graphs are assumed to be in from, to order.
+ * 
+ * </para><para>
+ * The rest of the stream is read at once; regular files are memory
+ * mapped, if the platform supports it. The text is then split into
+ * chunks, and these are parsed in parallel if igraph was compiled
+ * with OpenMP support. Numbers are read as by the \c %li conversion
+ * of \c fscanf, i.e. octal and hexadecimal numbers are also accepted.
  * \param graph Pointer to an uninitialized graph object.
- * \param instream Pointer to a stream, it should be readable.
+ * \param instream Pointer to a stream, it should be readable. It is
+ *        positioned at its end after the call.
  * \param n The number of vertices in the graph. If smaller than the
  *        largest integer in the file it will be ignored. It is thus
  *        safe to supply zero here.
@@ -79,41 +302,9 @@ int igraph_read_graph_edgelist(igraph_t *graph, FILE *instream,
 			       igraph_integer_t n, igraph_bool_t directed) {
 
   igraph_vector_t edges=IGRAPH_VECTOR_NULL;
-  long int from, to;
-  int c;
   
   IGRAPH_VECTOR_INIT_FINALLY(&edges, 0);
-  IGRAPH_CHECK(igraph_vector_reserve(&edges, 100));
-
-  /* skip all whitespace */
-  do {
-    c = getc (instream);
-  } while (isspace (c));
-  ungetc (c, instream);
-  
-  while (!feof(instream)) {
-    int read;
-
-    IGRAPH_ALLOW_INTERRUPTION();
-    
-    read=fscanf(instream, "%li", &from);
-    if (read != 1) { 
-      IGRAPH_ERROR("parsing edgelist file failed", IGRAPH_PARSEERROR); 
-    }
-    read=fscanf(instream, "%li", &to);
-    if (read != 1) { 
-      IGRAPH_ERROR("parsing edgelist file failed", IGRAPH_PARSEERROR); 
-    }
-    IGRAPH_CHECK(igraph_vector_push_back(&edges, from));
-    IGRAPH_CHECK(igraph_vector_push_back(&edges, to));
-    
-    /* skip all whitespace */
-    do {
-      c = getc (instream);
-    } while (isspace (c));
-    ungetc (c, instream);    
-  }
-  
+  IGRAPH_CHECK(igraph_i_read_edgelist(&edges, instream));
   IGRAPH_CHECK(igraph_create(graph, &edges, n, directed));
   igraph_vector_destroy(&edges);
   IGRAPH_FINALLY_CLEAN(1);
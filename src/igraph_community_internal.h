@@ -0,0 +1,62 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#ifndef IGRAPH_COMMUNITY_INTERNAL_H
+#define IGRAPH_COMMUNITY_INTERNAL_H
+
+#include "igraph_types.h"
+#include "igraph_datatype.h"
+#include "igraph_random.h"
+
+#undef __BEGIN_DECLS
+#undef __END_DECLS
+#ifdef __cplusplus
+# define __BEGIN_DECLS extern "C" {
+# define __END_DECLS }
+#else
+# define __BEGIN_DECLS /* empty */
+# define __END_DECLS /* empty */
+#endif
+
+__BEGIN_DECLS
+
+/*
+ * Independent Infomap runs on the same graph, for
+ * igraph_community_ensemble(). The flow graph is computed once,
+ * every run partitions its own copy of it. The partition function
+ * does not call the error handler, it returns IGRAPH_ENOMEM if it
+ * runs out of memory, so it can be called from a parallel region.
+ * 'membership' gets the module of every vertex.
+ */
+
+int igraph_i_infomap_flowgraph_init(const igraph_t *graph,
+				    const igraph_vector_t *e_weights,
+				    void **fgraph);
+void igraph_i_infomap_flowgraph_destroy(void *fgraph);
+int igraph_i_infomap_flowgraph_partition(const void *fgraph,
+					 igraph_rng_t *rng, int *membership,
+					 igraph_bool_t *interrupted);
+
+__END_DECLS
+
+#endif
@@ -0,0 +1,62 @@
+/* -*- mode: C -*-  */
+/* 
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+   
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA 
+   02110-1301 USA
+
+*/
+
+#ifndef IGRAPH_INTERFACE_INTERNAL_H
+#define IGRAPH_INTERFACE_INTERNAL_H
+
+#undef __BEGIN_DECLS
+#undef __END_DECLS
+#ifdef __cplusplus
+# define __BEGIN_DECLS extern "C" {
+# define __END_DECLS }
+#else
+# define __BEGIN_DECLS /* empty */
+# define __END_DECLS /* empty */
+#endif
+
+#include "igraph_types.h"
+#include "igraph_datatype.h"
+#include "igraph_vector.h"
+
+__BEGIN_DECLS
+
+/* Integer versions of igraph_neighbors() and igraph_incident(). These
+   copy straight from the integer edge index of igraph_t, without
+   going through igraph_real_t; they are used to build adjacency and
+   incidence lists. */
+
+int igraph_i_neighbors(const igraph_t *graph, igraph_vector_int_t *neis,
+		       igraph_integer_t pnode, igraph_neimode_t mode);
+int igraph_i_incident(const igraph_t *graph, igraph_vector_int_t *eids,
+		      igraph_integer_t pnode, igraph_neimode_t mode);
+
+/* Memory mapped graphs, see igraph_read_graph_binary(). The index
+   of such a graph is read-only, igraph_i_unmap() copies it to
+   memory, so that the graph can be modified. */
+
+int igraph_i_unmap(igraph_t *graph);
+void igraph_i_mapping_release(void *mapping);
+
+__END_DECLS
+
+#endif
@@ -0,0 +1,124 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#ifndef IGRAPH_PARALLEL_INTERNAL_H
+#define IGRAPH_PARALLEL_INTERNAL_H
+
+#include "config.h"
+#include "igraph_error.h"
+#include "igraph_progress.h"
+#include "igraph_interrupt_internal.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#undef __BEGIN_DECLS
+#undef __END_DECLS
+#ifdef __cplusplus
+# define __BEGIN_DECLS extern "C" {
+# define __END_DECLS }
+#else
+# define __BEGIN_DECLS /* empty */
+# define __END_DECLS /* empty */
+#endif
+
+__BEGIN_DECLS
+
+/*
+ * Helpers for the OpenMP parallel parts of the library.
+ *
+ * Code running inside a parallel region must not call IGRAPH_ERROR,
+ * IGRAPH_CHECK, IGRAPH_FINALLY or anything else that might use them:
+ * the error handler and the stack of temporary objects are global,
+ * unless igraph was built with thread-local storage, and even then
+ * the worker threads have their own, empty copies. All memory that
+ * the threads need is allocated before the parallel region, by the
+ * calling thread, and errors are reported after the region.
+ *
+ * Without OpenMP the same code runs with a single thread.
+ */
+
+/* The number of threads to use for 'n' independent work items */
+#ifdef _OPENMP
+#define IGRAPH_I_THREAD_COUNT(n) \
+  ((n) < omp_get_max_threads() ? ((n) > 1 ? (int) (n) : 1) : \
+   omp_get_max_threads())
+#define IGRAPH_I_THREAD_NUM() (omp_get_thread_num())
+#else
+#define IGRAPH_I_THREAD_COUNT(n) (1)
+#define IGRAPH_I_THREAD_NUM() (0)
+#endif
+
+#ifdef _OPENMP
+#define IGRAPH_I_IN_PARALLEL() (omp_in_parallel())
+#else
+#define IGRAPH_I_IN_PARALLEL() (0)
+#endif
+
+/*
+ * Progress reporting and interruption. The handlers must not run
+ * while other threads are working: they are thread-local if TLS is
+ * enabled, they are usually not thread-safe, and the interruption
+ * handler of the R interface calls IGRAPH_FINALLY_FREE(), which frees
+ * the buffers of the threads. So long parallel loops are split into
+ * chunks of IGRAPH_I_PARALLEL_CHUNK(nthreads) work items, each chunk
+ * with its own parallel region, and IGRAPH_PROGRESS() and
+ * IGRAPH_ALLOW_INTERRUPTION() are called between the chunks, by the
+ * calling thread.
+ *
+ * Functions that cannot return IGRAPH_INTERRUPTED, because they run
+ * both inside and outside of parallel regions, e.g. a single run of
+ * igraph_community_ensemble(), use
+ * IGRAPH_I_PARALLEL_ALLOW_INTERRUPTION(flag) instead. It calls the
+ * handler only outside of active parallel regions, i.e. when no other
+ * thread is running, and sets 'flag' to true if the user interrupted
+ * the computation. Inside an active region it does nothing, so the
+ * flag is never written while other threads read it; the caller
+ * checks for interruption between its parallel regions. After the
+ * region, IGRAPH_I_PARALLEL_INTERRUPTED(flag) frees the temporary
+ * objects and returns with IGRAPH_INTERRUPTED.
+ */
+
+#define IGRAPH_I_PARALLEL_CHUNK(nthreads) (64 * (long int) (nthreads))
+
+#define IGRAPH_I_PARALLEL_ALLOW_INTERRUPTION(flag)			\
+  do {									\
+    if (!IGRAPH_I_IN_PARALLEL() && !(flag) &&				\
+	igraph_i_interruption_handler &&				\
+	igraph_allow_interruption(NULL) != IGRAPH_SUCCESS) {		\
+      (flag) = 1;							\
+    }									\
+  } while (0)
+
+#define IGRAPH_I_PARALLEL_INTERRUPTED(flag)	\
+  do {						\
+    if (flag) {					\
+      IGRAPH_FINALLY_FREE();			\
+      return IGRAPH_INTERRUPTED;		\
+    }						\
+  } while (0)
+
+__END_DECLS
+
+#endif
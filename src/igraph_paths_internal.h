@@ -0,0 +1,132 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2013  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#ifndef IGRAPH_PATHS_INTERNAL_H
+#define IGRAPH_PATHS_INTERNAL_H
+
+#undef __BEGIN_DECLS
+#undef __END_DECLS
+#ifdef __cplusplus
+# define __BEGIN_DECLS extern "C" {
+# define __END_DECLS }
+#else
+# define __BEGIN_DECLS /* empty */
+# define __END_DECLS /* empty */
+#endif
+
+#include "config.h"
+#ifdef HAVE_STDINT_H
+#  include <stdint.h>
+#else
+#  ifdef HAVE_SYS_INT_TYPES_H
+#    include <sys/int_types.h>
+#  else
+#    include "pstdint.h"
+#  endif
+#endif
+
+#include "igraph_types.h"
+#include "igraph_datatype.h"
+#include "igraph_adjlist.h"
+#include "igraph_types_internal.h"
+
+__BEGIN_DECLS
+
+/*
+ * Shortest path lengths from many sources, BFS for unweighted and
+ * Dijkstra's algorithm for weighted graphs. igraph_i_sssp_init()
+ * creates a CSR snapshot of the graph and one work area for every
+ * thread that will run searches; igraph_i_sssp() does a
+ * single-source search in the work area of the given thread. It
+ * does not allocate memory and does not call the error handler, so
+ * it can be called from an OpenMP parallel region, as long as each
+ * thread uses its own work area.
+ *
+ * After a search, the first 'reached' elements of 'order' are the
+ * vertices reached from the source, in the order of their distance,
+ * and 'dist' contains their distances. It is -1 for the other
+ * vertices.
+ */
+
+typedef struct igraph_i_sssp_thread_t {
+  igraph_real_t *dist;
+  long int *order;
+  long int reached;
+  igraph_2wheap_t Q;
+  igraph_bool_t Q_init;
+} igraph_i_sssp_thread_t;
+
+typedef struct igraph_i_sssp_t {
+  igraph_csr_t csr;
+  int nthreads;
+  igraph_i_sssp_thread_t *threads;
+} igraph_i_sssp_t;
+
+int igraph_i_sssp_init(igraph_i_sssp_t *sssp, const igraph_t *graph,
+		       const igraph_vector_t *weights, igraph_neimode_t mode,
+		       long int no_of_sources);
+void igraph_i_sssp_destroy(igraph_i_sssp_t *sssp);
+long int igraph_i_sssp(igraph_i_sssp_t *sssp, int thread, long int source,
+		       igraph_real_t cutoff, const igraph_real_t *targets,
+		       long int no_of_targets);
+
+/*
+ * Bit-parallel multi-source BFS, for unweighted graphs. The sources
+ * are processed in batches of IGRAPH_I_MSBFS_BATCH, and a single
+ * traversal of the graph serves the whole batch: every vertex has a
+ * bit mask of the sources that reached it. Batches run in parallel.
+ *
+ * The visitor is called once for every vertex and distance, with the
+ * mask of the sources that reach the vertex at that distance first.
+ * Bit 'b' of the mask stands for source 'first+b' of the 'sources'
+ * vector. Visitors of different batches may run at the same time, so
+ * they must only write data that belongs to their own sources.
+ * The visitor must not allocate memory or call the error handler.
+ * Vertices farther than 'maxdist' are not visited, if it is not
+ * negative.
+ */
+
+typedef uint64_t igraph_i_msbfs_mask_t;
+
+#define IGRAPH_I_MSBFS_BATCH 64
+
+#if defined(__GNUC__)
+#define IGRAPH_I_MSBFS_LOWBIT(mask) (__builtin_ctzll(mask))
+#else
+int igraph_i_msbfs_lowbit(igraph_i_msbfs_mask_t mask);
+#define IGRAPH_I_MSBFS_LOWBIT(mask) (igraph_i_msbfs_lowbit(mask))
+#endif
+
+typedef void igraph_i_msbfs_visitor_t(long int first, long int vertex,
+				      long int dist,
+				      igraph_i_msbfs_mask_t sources,
+				      void *extra);
+
+int igraph_i_msbfs(const igraph_t *graph, const igraph_vector_t *sources,
+		   igraph_neimode_t mode, long int maxdist,
+		   igraph_i_msbfs_visitor_t *visitor, void *extra,
+		   const char *progress_message);
+
+__END_DECLS
+
+#endif
@@ -30,29 +30,33 @@
 */
 
 #include <cmath>
+#include <new>
 #include "igraph_interface.h"
 #include "igraph_community.h"
+#include "igraph_community_internal.h"
 #include "igraph_interrupt_internal.h"
+#include "igraph_parallel_internal.h"
+#include "igraph_random.h"
 
-
-#include "infomap_Node.h"
 #include "infomap_Greedy.h"
 
 /****************************************************************************/
-int infomap_partition(FlowGraph * fgraph, bool rcall) {
-  Greedy * greedy;
+/* Partitions 'fgraph', 'rng' is the random number generator of the
+   trial. The function does not call the error handler, memory errors
+   are reported by std::bad_alloc, interruption via 'interrupted'. */
+static void infomap_partition(FlowGraph * fgraph, bool rcall,
+			      igraph_rng_t *rng, bool &interrupted) {
 
   // save the original graph
-  FlowGraph * cpy_fgraph = new FlowGraph(fgraph);
-  IGRAPH_FINALLY(delete_FlowGraph, cpy_fgraph);
+  FlowGraph cpy_fgraph(*fgraph);
   
-  int Nnode = cpy_fgraph->Nnode; 
+  int Nnode = cpy_fgraph.Nnode; 
   // "real" number of vertex, ie. number of vertex of the graph	
 
   int iteration = 0;
   double outer_oldCodeLength, newCodeLength;
   
-  int *initial_move = NULL;
+  vector<int> initial_move;
   bool initial_move_done = true;
   
   do { // Main loop
@@ -64,61 +68,45 @@ int infomap_partition(FlowGraph * fgraph, bool rcall) {
       // ===========================================
       
       // intial_move indicate current clustering
-      initial_move = new int[Nnode];    
+      initial_move.resize(Nnode);
       // new_cluster_id --> old_cluster_id (save curent clustering state)
-      
-      IGRAPH_FINALLY(operator delete [], initial_move);
       initial_move_done = false;
       
-      int *subMoveTo = NULL; // enventual new partitionment of original graph
+      vector<int> subMoveTo; // enventual new partitionment of original graph
 			
       if ((iteration % 2 == 0) && (fgraph->Nnode > 1)) { 
 	// 0/ Submodule movements : partition each module of the 
 	// current partition (rec. call)
 	
-	subMoveTo = new int[Nnode];       
+	subMoveTo.resize(Nnode);
 	// vid_cpy_fgraph  --> new_cluster_id (new partition)
 
-	IGRAPH_FINALLY(operator delete [], subMoveTo);
-				
 	int subModIndex = 0;
 
 	for (int i=0 ; i < fgraph->Nnode ; i++) {
 	  // partition each non trivial module
-	  int sub_Nnode = fgraph->node[i]->members.size();
+	  int sub_Nnode = fgraph->nodeMembers(i);
+	  const int *sub_members = &fgraph->members[fgraph->memberStart[i]];
+	  // id_sub --> id
 	  if (sub_Nnode > 1) { // If the module is not trivial
-	    int *sub_members  = new int[sub_Nnode];      // id_sub --> id
-	    IGRAPH_FINALLY(operator delete [], sub_members); 
-	    
-	    for (int j=0 ; j < sub_Nnode ; j++)
-	      sub_members[j] = fgraph->node[i]->members[j];
-	    
 	    // extraction of the subgraph
-	    FlowGraph *sub_fgraph = new FlowGraph(cpy_fgraph, sub_Nnode, 
-						  sub_members);
-	    IGRAPH_FINALLY(delete_FlowGraph, sub_fgraph);
-	    sub_fgraph->initiate();
+	    FlowGraph sub_fgraph(cpy_fgraph, sub_Nnode, sub_members);
+	    sub_fgraph.initiate();
 	    
 	    // recursif call of partitionment on the subgraph
-	    infomap_partition(sub_fgraph, true);
+	    infomap_partition(&sub_fgraph, true, rng, interrupted);
 	    
 	    // Record membership changes
-	    for (int j=0; j < sub_fgraph->Nnode; j++) {
-	      int Nmembers = sub_fgraph->node[j]->members.size();
-	      for (int k=0; k<Nmembers; k++) {
-		subMoveTo[sub_members[sub_fgraph->node[j]->members[k]]] = 
-		  subModIndex;
+	    for (int j=0; j < sub_fgraph.Nnode; j++) {
+	      for (int k=sub_fgraph.memberStart[j]; 
+		   k<sub_fgraph.memberStart[j+1]; k++) {
+		subMoveTo[sub_members[sub_fgraph.members[k]]] = subModIndex;
 	      }
 	      initial_move[subModIndex] = i;
 	      subModIndex++;
 	    }
-	    
-	    delete sub_fgraph;
-	    IGRAPH_FINALLY_CLEAN(1);
-	    delete [] sub_members;
-	    IGRAPH_FINALLY_CLEAN(1);
 	  } else{
-	    subMoveTo[fgraph->node[i]->members[0]] = subModIndex;
+	    subMoveTo[sub_members[0]] = subModIndex;
 	    initial_move[subModIndex] = i;
 	    subModIndex++;
 	  }
@@ -127,25 +115,18 @@ int infomap_partition(FlowGraph * fgraph, bool rcall) {
 	// 1/ Single-node movements : allows each node to move (again)
 	// save current modules
 	for (int i=0; i < fgraph->Nnode; i++) { // for each module
-	  int Nmembers = fgraph->node[i]->members.size(); // Module size
-	  for (int j=0;j<Nmembers;j++) { // for each vertex (of the module)
-	    initial_move[fgraph->node[i]->members[j]] = i;
+	  for (int j=fgraph->memberStart[i]; j<fgraph->memberStart[i+1]; j++) {
+	    // for each vertex (of the module)
+	    initial_move[fgraph->members[j]] = i;
 	  }
 	}
       }
       
-      fgraph->back_to(cpy_fgraph);
-      if (subMoveTo) {
-	Greedy *cpy_greedy = new Greedy(fgraph);
-	IGRAPH_FINALLY(delete_Greedy, cpy_greedy);
-	
-	cpy_greedy->setMove(subMoveTo);
-	cpy_greedy->apply(false);
-	
-	delete_Greedy(cpy_greedy);
-	IGRAPH_FINALLY_CLEAN(1);
-	delete [] subMoveTo;
-	IGRAPH_FINALLY_CLEAN(1);
+      *fgraph = cpy_fgraph;
+      if (!subMoveTo.empty()) {
+	Greedy cpy_greedy(fgraph, rng);
+	cpy_greedy.setMove(subMoveTo);
+	cpy_greedy.apply(false);
       }
     }
     /**********************************************************************/
@@ -155,63 +136,87 @@ int infomap_partition(FlowGraph * fgraph, bool rcall) {
     
     do {
       // greedy optimizing object creation
-      greedy = new Greedy(fgraph);
-      IGRAPH_FINALLY(delete_Greedy, greedy);
+      Greedy greedy(fgraph, rng);
       
       // Initial move to apply ?
-      if (!initial_move_done && initial_move) {
+      if (!initial_move_done && !initial_move.empty()) {
 	initial_move_done = true;
-	greedy->setMove(initial_move);
+	greedy.setMove(initial_move);
       }
       
-      oldCodeLength = greedy->codeLength;
+      oldCodeLength = greedy.codeLength;
       bool moved = true;
-      int Nloops = 0;
-      //int count = 0;
       double inner_oldCodeLength = 1000;
       
       while (moved) { // main greedy optimizing loop
-	inner_oldCodeLength = greedy->codeLength;
-	moved = greedy->optimize();
+	inner_oldCodeLength = greedy.codeLength;
+	moved = greedy.optimize();
 
-	Nloops++;
-	//count++;
-	
-	if (fabs(greedy->codeLength - inner_oldCodeLength) < 1.0e-10) 
+	if (fabs(greedy.codeLength - inner_oldCodeLength) < 1.0e-10) 
 	  // if the move does'n reduce the codelenght -> exit !
 	  moved = false;
-	
-	//if (count == 10) {
-	//	greedy->tune();
-	//	count = 0;
-	//}
       }
       
       // transform the network to network of modules:
-      greedy->apply(true);
-      newCodeLength = greedy->codeLength;
-      
-      // destroy greedy object
-      delete greedy;
-      IGRAPH_FINALLY_CLEAN(1);
+      greedy.apply(true);
+      newCodeLength = greedy.codeLength;
       
     } while (oldCodeLength - newCodeLength >  1.0e-10); 
     // while there is some improvement
 		
-    if (iteration > 0) {
-      delete [] initial_move;
-      IGRAPH_FINALLY_CLEAN(1);
-    }
-    
     iteration++;
-    if (!rcall) IGRAPH_ALLOW_INTERRUPTION();
+    if (!rcall) IGRAPH_I_PARALLEL_ALLOW_INTERRUPTION(interrupted);
+    if (interrupted) return;
   } while (outer_oldCodeLength - newCodeLength > 1.0e-10);
-  
-  delete cpy_fgraph;
-  IGRAPH_FINALLY_CLEAN(1);
+}
+
+static void infomap_destroy_rngs(vector<igraph_rng_t> *rngs) {
+  for (size_t i=0; i<rngs->size(); i++) {
+    igraph_rng_destroy(&(*rngs)[i]);
+  }
+}
+
+/* The hooks of igraph_community_ensemble(), see
+   igraph_community_internal.h */
+
+int igraph_i_infomap_flowgraph_init(const igraph_t *graph,
+				    const igraph_vector_t *e_weights,
+				    void **fgraph) {
+  FlowGraph *fg = 0;
+  try {
+    fg = new FlowGraph(graph, e_weights, 0);
+    fg->initiate();
+  } catch (std::bad_alloc &) {
+    delete fg;
+    IGRAPH_ERROR("Cannot run Infomap", IGRAPH_ENOMEM);
+  }
+  *fgraph = fg;
   return IGRAPH_SUCCESS;
 }
 
+void igraph_i_infomap_flowgraph_destroy(void *fgraph) {
+  delete static_cast<FlowGraph *>(fgraph);
+}
+
+int igraph_i_infomap_flowgraph_partition(const void *fgraph,
+					 igraph_rng_t *rng, int *membership,
+					 igraph_bool_t *interrupted) {
+  bool intr = *interrupted;
+  try {
+    FlowGraph cpy_fgraph(*static_cast<const FlowGraph *>(fgraph));
+    infomap_partition(&cpy_fgraph, false, rng, intr);
+    for (int i=0 ; i < cpy_fgraph.Nnode ; i++) {
+      for (int k=cpy_fgraph.memberStart[i]; 
+	   k < cpy_fgraph.memberStart[i+1]; k++) {
+	membership[cpy_fgraph.members[k]] = i;
+      }
+    }
+  } catch (std::bad_alloc &) {
+    return IGRAPH_ENOMEM;
+  }
+  if (intr) { *interrupted = 1; }
+  return IGRAPH_SUCCESS;
+}
 
 /** 
  * \function igraph_community_infomap
@@ -245,6 +250,13 @@ int infomap_partition(FlowGraph * fgraph, bool rcall) {
  * If you want to specify a random seed (as in original
  * implementation) you can use \ref igraph_rng_seed().
  * 
+ * </para><para>
+ * If igraph was compiled with OpenMP support, the trials run in
+ * parallel, and so does the computation of the flow on large
+ * graphs. Every trial uses its own random number generator, seeded
+ * from the default one, so the result does not depend on the number
+ * of threads.
+ * 
  * \param graph The input graph.
  * \param e_weights Numeric vector giving the weights of the edges. 
  *     If it is a NULL pointer then all edges will have equal
@@ -272,46 +284,116 @@ int igraph_community_infomap(const igraph_t * graph,
                              igraph_vector_t *membership,
                              igraph_real_t *codelength) {
 
+  if (e_weights && igraph_vector_size(e_weights) != igraph_ecount(graph)) {
+    IGRAPH_ERROR("Invalid edge weight vector length", IGRAPH_EINVAL);
+  }
+  if (v_weights && igraph_vector_size(v_weights) != igraph_vcount(graph)) {
+    IGRAPH_ERROR("Invalid vertex weight vector length", IGRAPH_EINVAL);
+  }
+  if (nb_trials < 1) {
+    IGRAPH_ERROR("Number of trials must be at least one", IGRAPH_EINVAL);
+  }
+
   FlowGraph * fgraph = new FlowGraph(graph, e_weights, v_weights);
   IGRAPH_FINALLY(delete_FlowGraph, fgraph);
 	
   // compute stationary distribution
   fgraph->initiate();
 	
-  FlowGraph * cpy_fgraph ;
-  double shortestCodeLength = 1000.0;
-  
   // create membership vector
   int Nnode = fgraph->Nnode;
   IGRAPH_CHECK(igraph_vector_resize(membership, Nnode));
-  
+
+  // seeds of the trials, from the default generator
+  vector<unsigned long int> seeds(nb_trials);
+  RNG_BEGIN();
   for (int trial = 0; trial < nb_trials; trial++) {
-    cpy_fgraph = new FlowGraph(fgraph);
-    IGRAPH_FINALLY(delete_FlowGraph, cpy_fgraph);
+    seeds[trial] = RNG_INT31();
+  }
+  RNG_END();
+
+  // one generator and one best partition per thread
+  int nthreads = IGRAPH_I_THREAD_COUNT(nb_trials);
+  vector<igraph_rng_t> rngs;
+  rngs.reserve(nthreads);
+  IGRAPH_FINALLY(infomap_destroy_rngs, &rngs);
+  for (int t = 0; t < nthreads; t++) {
+    igraph_rng_t rng;
+    IGRAPH_CHECK(igraph_rng_init(&rng, &igraph_rngtype_mt19937));
+    rngs.push_back(rng);
+  }
+  vector<double> shortestCodeLength(nthreads, 1000.0);
+  vector<int> bestTrial(nthreads, -1);
+  vector<vector<int> > bestMembership(nthreads, vector<int>(Nnode));
+  bool interrupted = false, failed = false;
+
+  // one trial per thread at a time, the interruption handler is
+  // called between them, and also from the trial if there is a single
+  // thread
+  for (int first = 0; first < nb_trials && !interrupted && !failed;
+       first += nthreads) {
+    int last = first + nthreads < nb_trials ? first + nthreads : nb_trials;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic, 1)
+#endif
+    for (int trial = first; trial < last; trial++) {
+      int thread = IGRAPH_I_THREAD_NUM();
+      try {
+	igraph_rng_seed(&rngs[thread], seeds[trial]);
+	FlowGraph cpy_fgraph(*fgraph);
     
-    //partition the network
-    IGRAPH_CHECK(infomap_partition(cpy_fgraph, false));
+	//partition the network
+	infomap_partition(&cpy_fgraph, false, &rngs[thread], interrupted);
     
-    // if better than the better...
-    if (cpy_fgraph->codeLength < shortestCodeLength) {
-      shortestCodeLength = cpy_fgraph->codeLength;
-      // ... store the partition
-      for (int i=0 ; i < cpy_fgraph->Nnode ; i++) {
-	int Nmembers = cpy_fgraph->node[i]->members.size();
-	for (int k=0; k < Nmembers; k++) {
-	  //cluster[ cpy_fgraph->node[i]->members[k] ] = i;
-	  VECTOR(*membership)[cpy_fgraph->node[i]->members[k]] = i;
+	// if better than the better... A thread gets its trials in
+	// increasing order, so ties go to the first trial
+	if (!interrupted && cpy_fgraph.codeLength < shortestCodeLength[thread]) {
+	  shortestCodeLength[thread] = cpy_fgraph.codeLength;
+	  bestTrial[thread] = trial;
+	  // ... store the partition
+	  for (int i=0 ; i < cpy_fgraph.Nnode ; i++) {
+	    for (int k=cpy_fgraph.memberStart[i]; 
+		 k < cpy_fgraph.memberStart[i+1]; k++) {
+	      bestMembership[thread][cpy_fgraph.members[k]] = i;
+	    }
+	  }
 	}
+      } catch (std::bad_alloc &) {
+#ifdef _OPENMP
+#pragma omp atomic write
+#endif
+	failed = true;
       }
     }
-    
-    delete_FlowGraph(cpy_fgraph);
-    IGRAPH_FINALLY_CLEAN(1);
+    IGRAPH_I_PARALLEL_ALLOW_INTERRUPTION(interrupted);
+  }
+
+  IGRAPH_I_PARALLEL_INTERRUPTED(interrupted);
+  if (failed) {
+    IGRAPH_ERROR("Cannot run Infomap", IGRAPH_ENOMEM);
+  }
+
+  // the best trial of all threads
+  int best = -1;
+  for (int t = 0; t < nthreads; t++) {
+    if (bestTrial[t] < 0) { continue; }
+    if (best < 0 || shortestCodeLength[t] < shortestCodeLength[best] ||
+	(shortestCodeLength[t] == shortestCodeLength[best] &&
+	 bestTrial[t] < bestTrial[best])) {
+      best = t;
+    }
+  }
+  if (best >= 0) {
+    for (int i=0; i < Nnode; i++) {
+      VECTOR(*membership)[i] = bestMembership[best][i];
+    }
+    if (codelength) {
+      *codelength = (igraph_real_t) shortestCodeLength[best]/log(2.0);
+    }
   }
   
-  *codelength = (igraph_real_t) shortestCodeLength/log(2.0);
-  
+  infomap_destroy_rngs(&rngs);
   delete fgraph;
-  IGRAPH_FINALLY_CLEAN(1);
+  IGRAPH_FINALLY_CLEAN(2);
   return IGRAPH_SUCCESS;
 }
@@ -22,21 +22,74 @@
 
 */
 
+#include <cmath>
+
 #include "infomap_FlowGraph.h"
+#include "igraph_parallel_internal.h"
 
 #define plogp( x ) ( (x) > 0.0 ? (x)*log(x) : 0.0 )
 
+/* The nodes are split into chunks of this size for the parallel
+   loops of eigenvector(). The partial sums of the chunks are added
+   in order, so the result does not depend on the number of threads. */
+#define INFOMAP_CHUNK 4096
+
 void FlowGraph::init(int n, const igraph_vector_t *v_weights) {
   alpha = 0.15;
   beta  = 1.0 - alpha;
   Nnode = n;
-  node = new Node*[Nnode];
-  if (v_weights) {
-    for (int i=0;i<Nnode;i++) {
-      node[i] = new Node(i, (double)VECTOR(*v_weights)[i]);
-    }
-  } else {
-    for (int i=0;i<Nnode;i++) { node[i] = new Node(i, 1.0); }
+
+  // every node is a module of a single vertex
+  memberStart.resize(n+1);
+  members.resize(n);
+  for (int i=0;i<n;i++) { memberStart[i] = i; members[i] = i; }
+  memberStart[n] = n;
+
+  outStart.assign(n+1, 0);
+  inStart.assign(n+1, 0);
+  outNeis.clear(); outFlow.clear(); inNeis.clear(); inLink.clear();
+
+  selfLink.assign(n, 0.0);
+  danglingSize.assign(n, 0.0);
+  nodeExit.assign(n, 0.0);
+  size.assign(n, 0.0);
+  teleportWeight.resize(n);
+  for (int i=0;i<n;i++) {
+    teleportWeight[i] = v_weights ? (double)VECTOR(*v_weights)[i] : 1.0;
+  }
+}
+
+/* Creates the compressed sparse row form of the given links. The
+ * links of a node keep their order.
+ */
+void FlowGraph::setLinks(const vector<int> &from, const vector<int> &to,
+			 const vector<double> &flow) {
+  int Nlinks = from.size();
+
+  outStart.assign(Nnode+1, 0);
+  inStart.assign(Nnode+1, 0);
+  for (int k=0; k<Nlinks; k++) {
+    outStart[from[k]+1]++;
+    inStart[to[k]+1]++;
+  }
+  for (int i=0; i<Nnode; i++) {
+    outStart[i+1] += outStart[i];
+    inStart[i+1] += inStart[i];
+  }
+
+  outNeis.resize(Nlinks);
+  outFlow.resize(Nlinks);
+  inNeis.resize(Nlinks);
+  inLink.resize(Nlinks);
+  vector<int> outPos(outStart.begin(), outStart.end()-1);
+  vector<int> inPos(inStart.begin(), inStart.end()-1);
+  for (int k=0; k<Nlinks; k++) {
+    int j = outPos[from[k]]++;
+    int l = inPos[to[k]]++;
+    outNeis[j] = to[k];
+    outFlow[j] = flow[k];
+    inNeis[l]  = from[k];
+    inLink[l]  = j;
   }
 }
 
@@ -58,150 +111,66 @@ FlowGraph::FlowGraph(const igraph_t * graph,
   init(n, v_weights);
 	
   int directed = (int) igraph_is_directed(graph);
-  
-  double linkWeight = 1.0;
-  igraph_integer_t from, to;
-  
-  long int Nlinks = (long int) igraph_ecount(graph); 
-  if (!directed) Nlinks = Nlinks * 2 ;
-  for (int i=0; i<Nlinks; i++) {
-    if (!directed) { // not directed
-      if (i%2==0) {
-	linkWeight = e_weights ? (double)VECTOR(*e_weights)[i/2] : 1.0;
-	igraph_edge(graph, i/2    , &from, &to);
-      } else { 
-	igraph_edge(graph, (i-1)/2, &to,   &from); 
-      }
-    } else {         // directed
-      linkWeight = e_weights ? (double)VECTOR(*e_weights)[i] : 1.0;
-      igraph_edge(graph, i, &from, &to);
-    }
+  long int Nedges = (long int) igraph_ecount(graph); 
+
+  vector<int> from, to;
+  vector<double> flow;
+  from.reserve(directed ? Nedges : 2*Nedges);
+  to.reserve(directed ? Nedges : 2*Nedges);
+  flow.reserve(directed ? Nedges : 2*Nedges);
+
+  for (long int i=0; i<Nedges; i++) {
+    double linkWeight = e_weights ? (double)VECTOR(*e_weights)[i] : 1.0;
+    int f = (int) IGRAPH_FROM(graph, i), t = (int) IGRAPH_TO(graph, i);
     
-    // Populate node from igraph_graph
-    if (linkWeight > 0.0) {
-      if (from != to) {
-	node[(int) from]->outLinks.push_back(make_pair((int)to, linkWeight));
-	node[(int) to]->inLinks.push_back(make_pair((int) from, linkWeight));
+    // Populate node from igraph_graph, undirected edges go both ways
+    if (linkWeight > 0.0 && f != t) {
+      from.push_back(f); to.push_back(t); flow.push_back(linkWeight);
+      if (!directed) {
+	from.push_back(t); to.push_back(f); flow.push_back(linkWeight);
       }
     }
   }
-}
 
-FlowGraph::FlowGraph(FlowGraph * fgraph) {
-  int n = fgraph->Nnode;
-  init(n, NULL);
-  for (int i=0; i<n; i++) {
-    cpyNode(node[i], fgraph->node[i]);
-  }
-  
-  //XXX: quid de danglings et Ndanglings?
-  
-  alpha = fgraph->alpha ;
-  beta  = fgraph->beta ;
-  
-  exit = fgraph->exit;
-  exitFlow = fgraph->exitFlow;
-  exit_log_exit = fgraph->exit_log_exit;
-  size_log_size = fgraph->size_log_size ;
-  nodeSize_log_nodeSize = fgraph->nodeSize_log_nodeSize;
-  
-  codeLength = fgraph->codeLength;
+  setLinks(from, to, flow);
 }
 
-/** construct a graph by extracting a subgraph from the given graph
+/** construct a graph by extracting a subgraph from the given graph,
+ * node 'j' of the subgraph is node 'sub_members[j]' of 'fgraph'
  */
-FlowGraph::FlowGraph(FlowGraph * fgraph, int sub_Nnode, int * sub_members) {
+FlowGraph::FlowGraph(const FlowGraph &fgraph, int sub_Nnode,
+		     const int *sub_members) {
   init(sub_Nnode, NULL);
     
-  //XXX: use set of integer to ensure that elements are sorted
-  set<int> sub_mem;
-  for (int j=0 ; j<sub_Nnode ; j++) { sub_mem.insert(sub_members[j]); }
-  set<int>::iterator it_mem = sub_mem.begin();
-	
-  vector<int> sub_renumber = vector<int>(fgraph->Nnode);         
+  vector<int> sub_renumber = vector<int>(fgraph.Nnode, -1);
   // id --> sub_id
+  for (int j=0; j<sub_Nnode; j++) { sub_renumber[sub_members[j]] = j; }
 
-  for (int j=0; j<fgraph->Nnode; j++) { sub_renumber[j] = -1; }
-
-
+  vector<int> from, to;
+  vector<double> flow;
   for (int j=0; j<sub_Nnode; j++) {
-    //int orig_nr = sub_members[j];
-    int orig_nr = (*it_mem);
+    int orig_nr = sub_members[j];
 
-    node[j]->teleportWeight = fgraph->node[orig_nr]->teleportWeight;
-    node[j]->selfLink       = fgraph->node[orig_nr]->selfLink; 
+    teleportWeight[j] = fgraph.teleportWeight[orig_nr];
+    selfLink[j]       = fgraph.selfLink[orig_nr]; 
     // Take care of self-link
 
-    int orig_NoutLinks = fgraph->node[orig_nr]->outLinks.size();
-    int orig_NinLinks  = fgraph->node[orig_nr]->inLinks.size();
-    
-    sub_renumber[orig_nr] = j;
-    
-    for (int k=0; k<orig_NoutLinks; k++) {
-      int to = fgraph->node[orig_nr]->outLinks[k].first;
-      int to_newnr = sub_renumber[to];
-      double link_weight = fgraph->node[orig_nr]->outLinks[k].second;
-      
-      if (to < orig_nr) { 
-	// we add links if the destination (to) has already be seen 
-	// (ie. smaller than current id) => orig
-
-	if (sub_mem.find(to) != sub_mem.end()) {
-	  // printf("%2d | %4d to %4d\n", j, orig_nr, to);
-	  // printf("from %4d (%4d:%1.5f) to %4d (%4d)\n", j, orig_nr, 
-	  //        node[j]->selfLink, to_newnr, to);
-	  node[j]->outLinks.push_back(make_pair(to_newnr, link_weight));
-	  node[to_newnr]->inLinks.push_back(make_pair(j, link_weight));
-	}
+    for (int k=fgraph.outStart[orig_nr]; k<fgraph.outStart[orig_nr+1]; k++) {
+      int to_newnr = sub_renumber[fgraph.outNeis[k]];
+      if (to_newnr >= 0) {
+	from.push_back(j); to.push_back(to_newnr);
+	flow.push_back(fgraph.outFlow[k]);
       }
     }
-		
-    for (int k=0; k<orig_NinLinks; k++) {
-      int to = fgraph->node[orig_nr]->inLinks[k].first;
-      int to_newnr = sub_renumber[to];
-      double link_weight = fgraph->node[orig_nr]->inLinks[k].second;
-      if (to < orig_nr) {
-	if (sub_mem.find(to) != sub_mem.end()) {
-	  node[j]->inLinks.push_back(make_pair(to_newnr,link_weight));
-	  node[to_newnr]->outLinks.push_back(make_pair(j,link_weight));
-	}
-      }
-    }
-    it_mem++;
   }
-}
-
 
-FlowGraph::~FlowGraph() {
-  //printf("delete FlowGraph !\n");
-  for (int i=0;i<Nnode;i++) {
-    delete node[i];
-  }
-  delete [] node;
+  setLinks(from, to, flow);
 }
 
 void delete_FlowGraph(FlowGraph *fgraph) {
   delete fgraph;
 }
 
-
-/** Swap the graph with the one given
-    the graph is "re" calibrate
-    but NOT the given one.
- */
-void FlowGraph::swap(FlowGraph * fgraph) {
-  Node ** node_tmp = fgraph->node;
-  int Nnode_tmp    = fgraph->Nnode;
-  
-  fgraph->node = node;
-  fgraph->Nnode = Nnode;
-  
-  node = node_tmp;
-  Nnode = Nnode_tmp;
-  
-  calibrate();
-}
-
 /** Initialisation of the graph, compute the flow inside the graph
  *   - count danglings nodes
  *   - normalized edge weights
@@ -211,74 +180,55 @@ void FlowGraph::swap(FlowGraph * fgraph) {
 void FlowGraph::initiate() {
   // Take care of dangling nodes, normalize outLinks, and calculate
   // total teleport weight
-  Ndanglings = 0;
+  danglings.clear();
   double totTeleportWeight = 0.0;
-  for (int i=0;i<Nnode;i++) totTeleportWeight += node[i]->teleportWeight;
+  for (int i=0;i<Nnode;i++) totTeleportWeight += teleportWeight[i];
   
   for (int i=0;i<Nnode;i++) {
-    node[i]->teleportWeight /= totTeleportWeight; 
+    teleportWeight[i] /= totTeleportWeight; 
     // normalize teleportation weight
 
-    if (node[i]->outLinks.empty() && (node[i]->selfLink <= 0.0)) {
+    if (outStart[i] == outStart[i+1] && (selfLink[i] <= 0.0)) {
       danglings.push_back(i);
-      Ndanglings++;
     } else { // Normalize the weights
-      int NoutLinks = node[i]->outLinks.size();
-      double sum = node[i]->selfLink; // Take care of self-links
-      for (int j=0;j < NoutLinks; j++) sum += node[i]->outLinks[j].second;
-      node[i]->selfLink /= sum;
-      for (int j=0;j < NoutLinks; j++) node[i]->outLinks[j].second /= sum;
+      double sum = selfLink[i]; // Take care of self-links
+      for (int j=outStart[i]; j<outStart[i+1]; j++) sum += outFlow[j];
+      selfLink[i] /= sum;
+      for (int j=outStart[i]; j<outStart[i+1]; j++) outFlow[j] /= sum;
     }
   }
   
   // Calculate steady state matrix
   eigenvector();
   
-  // Update links to represent flow
+  // Update links to represent flow, the in-links share them
   for (int i=0; i<Nnode; i++) {
-    node[i]->selfLink = beta * node[i]->size * node[i]->selfLink;
-    //            (1 - \tau) *     \pi_i     *      P_{ii}
-    
-    if (!node[i]->outLinks.empty()) {
-      int NoutLinks = node[i]->outLinks.size();
-      for (int j=0;j < NoutLinks; j++) {
-	node[i]->outLinks[j].second = beta * node[i]->size *
-	  node[i]->outLinks[j].second;
-	//                      (1 - \tau) *     \pi_i     *          P_{ij}
-      }
-      
-      // Update values for corresponding inlink
-      for (int j=0; j < NoutLinks; j++) {
-	int NinLinks = node[node[i]->outLinks[j].first]->inLinks.size();
-	for (int k=0; k < NinLinks; k++) {
-	  if (node[node[i]->outLinks[j].first]->inLinks[k].first == i) {
-	    node[node[i]->outLinks[j].first]->inLinks[k].second = 
-	      node[i]->outLinks[j].second;
-	    k = NinLinks;
-	  }
-	}
-      }
+    selfLink[i] = beta * size[i] * selfLink[i];
+    //            (1 - \tau) *   \pi_i   *  P_{ii}
+    for (int j=outStart[i]; j<outStart[i+1]; j++) {
+      outFlow[j] = beta * size[i] * outFlow[j];
+      //        (1 - \tau) *  \pi_i  *  P_{ij}
     }
   }
   
   // To be able to handle dangling nodes efficiently
   for (int i=0;i<Nnode;i++)
-    if (node[i]->outLinks.empty() && (node[i]->selfLink <= 0.0)) {
-      node[i]->danglingSize = node[i]->size;
+    if (outStart[i] == outStart[i+1] && (selfLink[i] <= 0.0)) {
+      danglingSize[i] = size[i];
     } else {
-      node[i]->danglingSize = 0.0;
+      danglingSize[i] = 0.0;
     }
 
   nodeSize_log_nodeSize = 0.0 ;
   // The exit flow from each node at initiation
   for (int i=0;i<Nnode;i++) {
-    node[i]->exit = node[i]->size // Proba to be on i
-      - (alpha * node[i]->size + beta * node[i]->danglingSize) * 
-      node[i]->teleportWeight // Proba teleport back to i
-      - node[i]->selfLink;  // Proba stay on i
+    nodeExit[i] = size[i] // Proba to be on i
+      - (alpha * size[i] + beta * danglingSize[i]) * 
+      teleportWeight[i] // Proba teleport back to i
+      - selfLink[i];  // Proba stay on i
 
-    // node[i]->exit == q_{i\exit}
-    nodeSize_log_nodeSize += plogp(node[i]->size);
+    // nodeExit[i] == q_{i\exit}
+    nodeSize_log_nodeSize += plogp(size[i]);
   }
 
   calibrate();
@@ -286,10 +236,14 @@ void FlowGraph::initiate() {
 
 
 /* Compute steady state distribution (ie. PageRank) over the network
- * (for all i update node[i]->size)
+ * (for all i update size[i]). The flow into every node is collected
+ * from its in-links, the chunks of nodes run in parallel.
  */
 void FlowGraph::eigenvector() {
   vector<double> size_tmp = vector<double>(Nnode,1.0/Nnode);
+  int Nchunks = (Nnode + INFOMAP_CHUNK - 1) / INFOMAP_CHUNK;
+  vector<double> chunkSum(Nchunks), chunkDiff(Nchunks);
+  int nthreads = IGRAPH_I_THREAD_COUNT(Nchunks);
 
   int Niterations = 0;
   double danglingSize;
@@ -300,35 +254,49 @@ void FlowGraph::eigenvector() {
   do {
     // Calculate dangling size
     danglingSize = 0.0;
-    for (int i=0;i<Ndanglings;i++) {
+    for (size_t i=0;i<danglings.size();i++) {
       danglingSize += size_tmp[danglings[i]];
     }
+    double teleport = alpha + beta*danglingSize;
     
-    // Flow from teleportation
-    for (int i=0;i<Nnode;i++)
-      node[i]->size = (alpha + beta*danglingSize) * node[i]->teleportWeight;
-    
-    // Flow from network steps
-    for (int i=0;i<Nnode;i++) {
-      node[i]->size += beta * node[i]->selfLink * size_tmp[i];
-      int Nlinks = node[i]->outLinks.size();
-      for (int j=0; j < Nlinks; j++)
-	node[node[i]->outLinks[j].first]->size += beta * 
-	  node[i]->outLinks[j].second * size_tmp[i];
+    // Flow from teleportation and from network steps
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+#endif
+    for (int c=0; c<Nchunks; c++) {
+      int last = (c+1)*INFOMAP_CHUNK < Nnode ? (c+1)*INFOMAP_CHUNK : Nnode;
+      double s = 0.0;
+      for (int i=c*INFOMAP_CHUNK; i<last; i++) {
+	double v = teleport * teleportWeight[i] +
+	  beta * selfLink[i] * size_tmp[i];
+	for (int j=inStart[i]; j<inStart[i+1]; j++) {
+	  v += beta * outFlow[inLink[j]] * size_tmp[inNeis[j]];
+	}
+	size[i] = v;
+	s += v;
+      }
+      chunkSum[c] = s;
     }
     
     // Normalize
     sum = 0.0;
-    for (int i=0;i<Nnode;i++) {
-      sum += node[i]->size;
+    for (int c=0; c<Nchunks; c++) { sum += chunkSum[c]; }
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+#endif
+    for (int c=0; c<Nchunks; c++) {
+      int last = (c+1)*INFOMAP_CHUNK < Nnode ? (c+1)*INFOMAP_CHUNK : Nnode;
+      double d = 0.0;
+      for (int i=c*INFOMAP_CHUNK; i<last; i++) {
+	size[i] /= sum;
+	d += fabs(size[i] - size_tmp[i]);
+	size_tmp[i] = size[i];
+      }
+      chunkDiff[c] = d;
     }
     sqdiff_old = sqdiff;
     sqdiff = 0.0;
-    for (int i=0;i<Nnode;i++) {
-      node[i]->size /= sum;
-      sqdiff += fabs(node[i]->size - size_tmp[i]);
-      size_tmp[i] = node[i]->size;
-    }
+    for (int c=0; c<Nchunks; c++) { sqdiff += chunkDiff[c]; }
     Niterations++;
     
     if (sqdiff == sqdiff_old) {
@@ -337,18 +305,11 @@ void FlowGraph::eigenvector() {
     }
     
   } while ((Niterations < 200) && (sqdiff > 1.0e-15 || Niterations < 50));
-  
-  danglingSize = 0.0;
-  for (int i=0;i<Ndanglings;i++) {
-    danglingSize += size_tmp[danglings[i]];
-  }
-  // cout << "done! (the error is " << sqdiff << " after " << Niterations
-  //      << " iterations)" << endl;
 }
 
 
 /* Compute the codeLength of the given network 
- * note: (in **node, one node == one module)
+ * note: (one node == one module)
  */
 void FlowGraph::calibrate() {
   exit_log_exit = 0.0;
@@ -357,11 +318,11 @@ void FlowGraph::calibrate() {
   
   for (int i=0; i<Nnode; i++) { // For each module
     // own node/module codebook
-    size_log_size         += plogp(node[i]->exit + node[i]->size);
+    size_log_size         += plogp(nodeExit[i] + size[i]);
     
     // use of index codebook
-    exitFlow      += node[i]->exit; 
-    exit_log_exit += plogp(node[i]->exit);
+    exitFlow      += nodeExit[i]; 
+    exit_log_exit += plogp(nodeExit[i]);
   }
 
   exit = plogp(exitFlow);
@@ -371,33 +332,74 @@ void FlowGraph::calibrate() {
 }
 
 
-/* Restore the data from the given FlowGraph object
+/* Replace the nodes with the modules: node 'i' goes to module
+ * 'module[i]', and module 'm' of the new graph is module 'order[m]'
+ * of the 'mod_' arrays. Links inside a module disappear, the links
+ * between two modules are merged. The graph is "re" calibrated.
  */
-void FlowGraph::back_to(FlowGraph * fgraph) {
-  // delete current nodes
-  for (int i=0 ; i<Nnode ; i++) { delete node[i]; }
-  delete [] node;
-  
-  Nnode = fgraph->Nnode;
+void FlowGraph::setModules(int Nmod, const vector<int> &module,
+			   const vector<double> &mod_exit,
+			   const vector<double> &mod_size,
+			   const vector<double> &mod_danglingSize,
+			   const vector<double> &mod_teleportWeight,
+			   const vector<int> &order) {
+
+  // Members of the modules, in the order of the nodes
+  vector<int> newMemberStart(Nmod+1, 0);
+  vector<int> newMembers(members.size());
+  for (int i=0; i<Nnode; i++) { newMemberStart[module[i]+1] += nodeMembers(i); }
+  for (int m=0; m<Nmod; m++) { newMemberStart[m+1] += newMemberStart[m]; }
+  vector<int> pos(newMemberStart.begin(), newMemberStart.end()-1);
+  for (int i=0; i<Nnode; i++) {
+    for (int k=memberStart[i]; k<memberStart[i+1]; k++) {
+      newMembers[pos[module[i]]++] = members[k];
+    }
+  }
 
-  // copy original ones
-  node = new Node*[Nnode];
-  for (int i=0;i<Nnode;i++) {
-    node[i] = new Node();
-    cpyNode(node[i], fgraph->node[i]);
+  // Nodes grouped by module
+  vector<int> nodeStart(Nmod+1, 0), nodes(Nnode);
+  for (int i=0; i<Nnode; i++) { nodeStart[module[i]+1]++; }
+  for (int m=0; m<Nmod; m++) { nodeStart[m+1] += nodeStart[m]; }
+  pos.assign(nodeStart.begin(), nodeStart.end()-1);
+  for (int i=0; i<Nnode; i++) { nodes[pos[module[i]]++] = i; }
+
+  // Calculate flow of links to different modules
+  vector<int> redirect(Nmod, -1);
+  vector<int> from, to;
+  vector<double> flow;
+  for (int m=0; m<Nmod; m++) {
+    size_t first = flow.size();
+    for (int k=nodeStart[m]; k<nodeStart[m+1]; k++) {
+      int i = nodes[k];
+      for (int j=outStart[i]; j<outStart[i+1]; j++) {
+	int nb_M = module[outNeis[j]];
+	if (nb_M == m) { continue; }
+	if (redirect[nb_M] >= 0) {
+	  flow[redirect[nb_M]] += outFlow[j];
+	} else {
+	  redirect[nb_M] = flow.size();
+	  from.push_back(m); to.push_back(nb_M); flow.push_back(outFlow[j]);
+	}
+      }
+    }
+    for (size_t j=first; j<flow.size(); j++) { redirect[to[j]] = -1; }
   }
-  
-  // restore atributs
-  alpha = fgraph->alpha ;
-  beta  = fgraph->beta ;
-  
-  exit = fgraph->exit;
-  exitFlow = fgraph->exitFlow;
-  exit_log_exit = fgraph->exit_log_exit;
-  size_log_size = fgraph->size_log_size ;
-  nodeSize_log_nodeSize = fgraph->nodeSize_log_nodeSize;
-  
-  codeLength = fgraph->codeLength;
-}
 
+  Nnode = Nmod;
+  memberStart.swap(newMemberStart);
+  members.swap(newMembers);
+  selfLink.assign(Nmod, 0.0);
+  nodeExit.resize(Nmod);
+  size.resize(Nmod);
+  danglingSize.resize(Nmod);
+  teleportWeight.resize(Nmod);
+  for (int m=0; m<Nmod; m++) {
+    nodeExit[m]       = mod_exit[order[m]];
+    size[m]           = mod_size[order[m]];
+    danglingSize[m]   = mod_danglingSize[order[m]];
+    teleportWeight[m] = mod_teleportWeight[order[m]];
+  }
+  setLinks(from, to, flow);
 
+  calibrate();
+}
@@ -26,42 +26,64 @@
 #define FLOWGRAPH_H
 
 #include <vector>
-#include <set>
 
 #include "igraph_interface.h"
 
-#include "infomap_Node.h"
+using namespace std;
+
+/* The flow graph is stored in flat arrays. Node 'i' is a module of
+ * the original vertices 'members[memberStart[i]]' ...
+ * 'members[memberStart[i+1]-1]'. The links are in compressed sparse
+ * row form: the out-links of node 'i' go to 'outNeis[j]' with flow
+ * 'outFlow[j]', for 'j' from 'outStart[i]' to 'outStart[i+1]-1'. The
+ * in-links are the same links, grouped by their target: in-link 'j'
+ * of node 'i' comes from 'inNeis[j]' and it is the out-link
+ * 'inLink[j]' of that node, so its flow is 'outFlow[inLink[j]]'.
+ */
 
 class FlowGraph{ 
  private:
   void init(int n, const igraph_vector_t *nodeWeights);
+  void setLinks(const vector<int> &from, const vector<int> &to,
+		const vector<double> &flow);
 
  public:
   FlowGraph(int n);
   FlowGraph(int n, const igraph_vector_t *nodeWeights);
-  FlowGraph(FlowGraph * fgraph);
-  FlowGraph(FlowGraph * fgraph, int sub_Nnode, int * sub_members);
+  FlowGraph(const FlowGraph &fgraph, int sub_Nnode, const int *sub_members);
 
   FlowGraph(const igraph_t * graph, const igraph_vector_t *e_weights,
 	    const igraph_vector_t *v_weights);
 
-  ~FlowGraph();
-
-  void swap(FlowGraph * fgraph);
-
   void initiate();
   void eigenvector();
   void calibrate();
 
-  void back_to(FlowGraph * fgraph);
+  void setModules(int Nmod, const vector<int> &module,
+		  const vector<double> &mod_exit,
+		  const vector<double> &mod_size,
+		  const vector<double> &mod_danglingSize,
+		  const vector<double> &mod_teleportWeight,
+		  const vector<int> &order);
+
+  int nodeMembers(int i) const { return memberStart[i+1] - memberStart[i]; }
 
   /*************************************************************************/
-  Node **node;
   int  Nnode;
 
+  vector<int> memberStart, members;
+  vector<int> outStart, outNeis;
+  vector<double> outFlow;
+  vector<int> inStart, inNeis, inLink;
+
+  vector<double> selfLink;
+  vector<double> teleportWeight;
+  vector<double> danglingSize;
+  vector<double> nodeExit;
+  vector<double> size;
+
   double alpha,beta;
 
-  int Ndanglings;
   vector<int> danglings; // id of dangling nodes
 
   double exit;                  // 
@@ -23,11 +23,12 @@
 */
 
 #include "infomap_Greedy.h"
-#include <iterator>
+#include <algorithm>
 #define plogp( x ) ( (x) > 0.0 ? (x)*log(x) : 0.0 )
 
-Greedy::Greedy(FlowGraph * fgraph){
+Greedy::Greedy(FlowGraph * fgraph, igraph_rng_t *rng_){
   graph = fgraph;
+  rng = rng_;
   Nnode = graph->Nnode;
 	
   alpha = graph->alpha;// teleportation probability
@@ -42,21 +43,24 @@ Greedy::Greedy(FlowGraph * fgraph){
   vector<double>(Nnode).swap(mod_danglingSize);
   vector<double>(Nnode).swap(mod_teleportWeight);
   vector<int>(Nnode).swap(mod_members);
+
+  vector<int>(Nnode).swap(randomOrder);
+  vector<unsigned int>(Nnode).swap(redirect);
+  vector<pair<int,pair<double,double> > >(Nnode).swap(flowNtoM);
   
   nodeSize_log_nodeSize = graph->nodeSize_log_nodeSize;
   exit_log_exit         = graph->exit_log_exit;
   size_log_size         = graph->size_log_size;
   exitFlow              = graph->exitFlow;
   
-  Node ** node = graph->node;
   for (int i=0; i<Nnode; i++) { // For each module
     node_index[i]         = i;
-    mod_exit[i]           = node[i]->exit;
-    mod_size[i]           = node[i]->size;
+    mod_exit[i]           = graph->nodeExit[i];
+    mod_size[i]           = graph->size[i];
 
-    mod_danglingSize[i]   = node[i]->danglingSize;
-    mod_teleportWeight[i] = node[i]->teleportWeight;
-    mod_members[i]        = node[i]->members.size();
+    mod_danglingSize[i]   = graph->danglingSize[i];
+    mod_teleportWeight[i] = graph->teleportWeight[i];
+    mod_members[i]        = graph->nodeMembers(i);
   }
   
   exit = plogp(exitFlow);
@@ -68,27 +72,21 @@ Greedy::Greedy(FlowGraph * fgraph){
 Greedy::~Greedy() {
 }
 
-void delete_Greedy(Greedy *greedy) {
-  delete greedy;
-}
-
 
 /** Greedy optimizing (as in Blodel and Al.) :
  * for each vertex (selected in a random order) compute the best possible move within neighborhood
+ * The random numbers come from the RNG of the trial, so that the trials
+ * can run in parallel.
  */
 bool Greedy::optimize() {
   bool moved = false;
-  Node ** node = graph->node;
-	
-  RNG_BEGIN();
 	
   // Generate random enumeration of nodes
-  vector<int> randomOrder(Nnode);
   for (int i=0; i<Nnode; i++) { randomOrder[i] = i; }
   
   for (int i=0; i<Nnode-1; i++) {
     //int randPos = i ; //XXX
-    int randPos = RNG_INTEGER(i, Nnode-1);
+    int randPos = (int) igraph_rng_get_integer(rng, i, Nnode-1);
     // swap i & randPos
     int tmp              = randomOrder[i];
     randomOrder[i]       = randomOrder[randPos];
@@ -96,8 +94,7 @@ bool Greedy::optimize() {
   }
   
   unsigned int offset = 1;
-  vector<unsigned int> redirect(Nnode,0);
-  vector<pair<int,pair<double,double> > > flowNtoM(Nnode);
+  std::fill(redirect.begin(), redirect.end(), 0);
   
   for (int k=0; k<Nnode; k++) {
     
@@ -114,7 +111,7 @@ bool Greedy::optimize() {
     // Size of vector with module links
     int NmodLinks = 0;
     // For all outLinks
-    int NoutLinks = node[flip]->outLinks.size();
+    int NoutLinks = graph->outStart[flip+1] - graph->outStart[flip];
     if (NoutLinks == 0) { //dangling node, add node to calculate flow below
       redirect[oldM] = offset + NmodLinks;
       flowNtoM[NmodLinks].first = oldM;
@@ -122,10 +119,10 @@ bool Greedy::optimize() {
       flowNtoM[NmodLinks].second.second = 0.0;
       NmodLinks++;
     } else {
-      for (int j=0; j<NoutLinks; j++) {
-	int nb_M       = node_index[node[flip]->outLinks[j].first]; 
+      for (int j=graph->outStart[flip]; j<graph->outStart[flip+1]; j++) {
+	int nb_M       = node_index[graph->outNeis[j]]; 
 	// index destination du lien
-	double nb_flow = node[flip]->outLinks[j].second;           
+	double nb_flow = graph->outFlow[j];           
 	// wgt du lien
 	if (redirect[nb_M] >= offset) {
 	  flowNtoM[redirect[nb_M] - offset].second.first += nb_flow;
@@ -139,10 +136,9 @@ bool Greedy::optimize() {
       }
     }
     // For all inLinks
-    int NinLinks = node[flip]->inLinks.size();
-    for (int j=0; j<NinLinks; j++) {
-      int nb_M = node_index[node[flip]->inLinks[j].first];
-      double nb_flow = node[flip]->inLinks[j].second;
+    for (int j=graph->inStart[flip]; j<graph->inStart[flip+1]; j++) {
+      int nb_M = node_index[graph->inNeis[j]];
+      double nb_flow = graph->outFlow[graph->inLink[j]];
       
       if (redirect[nb_M] >= offset) {
 	flowNtoM[redirect[nb_M] - offset].second.second += nb_flow;
@@ -160,38 +156,38 @@ bool Greedy::optimize() {
       int newM = flowNtoM[j].first;
       if (newM == oldM) {
 	flowNtoM[j].second.first  += 
-	  (alpha*node[flip]->size + beta*node[flip]->danglingSize)*
-	  (mod_teleportWeight[oldM]-node[flip]->teleportWeight);
+	  (alpha*graph->size[flip] + beta*graph->danglingSize[flip])*
+	  (mod_teleportWeight[oldM]-graph->teleportWeight[flip]);
 	flowNtoM[j].second.second += 
-	  (alpha*(mod_size[oldM] - node[flip]->size) + 
-	   beta*(mod_danglingSize[oldM] - node[flip]->danglingSize)) * 
-	  node[flip]->teleportWeight;
+	  (alpha*(mod_size[oldM] - graph->size[flip]) + 
+	   beta*(mod_danglingSize[oldM] - graph->danglingSize[flip])) * 
+	  graph->teleportWeight[flip];
       } else {
 	flowNtoM[j].second.first  += 
-	  (alpha*node[flip]->size + beta*node[flip]->danglingSize) * 
+	  (alpha*graph->size[flip] + beta*graph->danglingSize[flip]) * 
 	  mod_teleportWeight[newM];
 	flowNtoM[j].second.second += 
 	  (alpha*mod_size[newM]   + beta*mod_danglingSize[newM]  ) * 
-	  node[flip]->teleportWeight;
+	  graph->teleportWeight[flip];
       }
     }
 
     // Calculate flow to/from own module (default value if no link to 
     // own module)
     double outFlowOldM = 
-      (alpha*node[flip]->size + beta*node[flip]->danglingSize) * 
-      (mod_teleportWeight[oldM] - node[flip]->teleportWeight) ;
+      (alpha*graph->size[flip] + beta*graph->danglingSize[flip]) * 
+      (mod_teleportWeight[oldM] - graph->teleportWeight[flip]) ;
     double inFlowOldM  = 
-      (alpha*(mod_size[oldM] - node[flip]->size) + 
-       beta*(mod_danglingSize[oldM] - node[flip]->danglingSize)) * 
-      node[flip]->teleportWeight;
+      (alpha*(mod_size[oldM] - graph->size[flip]) + 
+       beta*(mod_danglingSize[oldM] - graph->danglingSize[flip])) * 
+      graph->teleportWeight[flip];
     if (redirect[oldM] >= offset) {
       outFlowOldM = flowNtoM[redirect[oldM] - offset].second.first;
       inFlowOldM  = flowNtoM[redirect[oldM] - offset].second.second;
     }
 
     // Option to move to empty module (if node not already alone)
-    if (mod_members[oldM] > static_cast<int>(node[flip]->members.size())) {
+    if (mod_members[oldM] > graph->nodeMembers(flip)) {
       if (Nempty > 0) {
 	flowNtoM[NmodLinks].first = mod_empty[Nempty-1];
 	flowNtoM[NmodLinks].second.first = 0.0;
@@ -203,7 +199,7 @@ bool Greedy::optimize() {
     // Randomize link order for optimized search
     for (int j=0;j<NmodLinks-1;j++) {
       //int randPos = j ; // XXX
-      int randPos = RNG_INTEGER(j, NmodLinks-1);
+      int randPos = (int) igraph_rng_get_integer(rng, j, NmodLinks-1);
       int tmp_M = flowNtoM[j].first;
       double tmp_outFlow = flowNtoM[j].second.first;
       double tmp_inFlow = flowNtoM[j].second.second;
@@ -234,16 +230,16 @@ bool Greedy::optimize() {
 
 	double delta_exit_log_exit = - plogp(mod_exit[oldM]) - 
 	  plogp(mod_exit[newM])	+ 
-	  plogp(mod_exit[oldM] - node[flip]->exit + outFlowOldM + inFlowOldM)
-	  + plogp(mod_exit[newM] + node[flip]->exit - outFlowNewM - 
+	  plogp(mod_exit[oldM] - graph->nodeExit[flip] + outFlowOldM + inFlowOldM)
+	  + plogp(mod_exit[newM] + graph->nodeExit[flip] - outFlowNewM - 
 		  inFlowNewM);
 
 	double delta_size_log_size = - plogp(mod_exit[oldM] + mod_size[oldM])
 	  - plogp(mod_exit[newM] + mod_size[newM])
-	  + plogp(mod_exit[oldM] + mod_size[oldM] - node[flip]->exit -
-		  node[flip]->size + outFlowOldM + inFlowOldM)
-	  + plogp(mod_exit[newM] + mod_size[newM] + node[flip]->exit + 
-		  node[flip]->size - outFlowNewM - inFlowNewM);
+	  + plogp(mod_exit[oldM] + mod_size[oldM] - graph->nodeExit[flip] -
+		  graph->size[flip] + outFlowOldM + inFlowOldM)
+	  + plogp(mod_exit[newM] + mod_size[newM] + graph->nodeExit[flip] + 
+		  graph->size[flip] - outFlowNewM - inFlowNewM);
 
 	double deltaL = delta_exit - 2.0*delta_exit_log_exit +
 	  delta_size_log_size;
@@ -263,7 +259,7 @@ bool Greedy::optimize() {
       if (mod_members[bestM] == 0) {
 	Nempty--;
       }
-      if (mod_members[oldM] == static_cast<int>(node[flip]->members.size())) {
+      if (mod_members[oldM] == graph->nodeMembers(flip)) {
 	mod_empty[Nempty] = oldM;
 	Nempty++;
       }
@@ -274,19 +270,19 @@ bool Greedy::optimize() {
       size_log_size -= plogp(mod_exit[oldM] + mod_size[oldM]) +
 	plogp(mod_exit[bestM] + mod_size[bestM]);
 
-      mod_exit[oldM]            -= node[flip]->exit - outFlowOldM -
+      mod_exit[oldM]            -= graph->nodeExit[flip] - outFlowOldM -
 	                           inFlowOldM;
-      mod_size[oldM]            -= node[flip]->size;
-      mod_danglingSize[oldM]    -= node[flip]->danglingSize;
-      mod_teleportWeight[oldM]  -= node[flip]->teleportWeight;
-      mod_members[oldM]         -= node[flip]->members.size();
+      mod_size[oldM]            -= graph->size[flip];
+      mod_danglingSize[oldM]    -= graph->danglingSize[flip];
+      mod_teleportWeight[oldM]  -= graph->teleportWeight[flip];
+      mod_members[oldM]         -= graph->nodeMembers(flip);
       
-      mod_exit[bestM]           += node[flip]->exit - best_outFlow -
+      mod_exit[bestM]           += graph->nodeExit[flip] - best_outFlow -
 	                           best_inFlow;
-      mod_size[bestM]           += node[flip]->size;
-      mod_danglingSize[bestM]   += node[flip]->danglingSize;
-      mod_teleportWeight[bestM] += node[flip]->teleportWeight;
-      mod_members[bestM]        += node[flip]->members.size();
+      mod_size[bestM]           += graph->size[flip];
+      mod_danglingSize[bestM]   += graph->danglingSize[flip];
+      mod_teleportWeight[bestM] += graph->teleportWeight[flip];
+      mod_members[bestM]        += graph->nodeMembers(flip);
       
       exitFlow += mod_exit[oldM] + mod_exit[bestM];
 
@@ -308,138 +304,56 @@ bool Greedy::optimize() {
     offset += Nnode;
   }
 
-  RNG_END();
-
   return moved;
 }
 
+/* Order of the modules at the next level: decreasing size, and
+ * decreasing index among modules of the same size
+ */
+struct GreedyModuleOrder {
+  const vector<double> &mod_size;
+  GreedyModuleOrder(const vector<double> &s) : mod_size(s) { }
+  bool operator()(int a, int b) const {
+    if (mod_size[a] != mod_size[b]) { return mod_size[a] > mod_size[b]; }
+    return a > b;
+  }
+};
+
 /** Apply the move to the given network
  */
 void Greedy::apply(bool sort) {
-//void Greedy::level(Node ***node_tmp, bool sort) {
-	
-  //old fct prepare(sort)
   vector<int> modSnode;  // will give ids of no-empty modules (nodes)
-  int Nmod = 0;
-  if (sort) {
-    multimap<double,int> Msize;
-    for (int i=0; i<Nnode; i++) {
-      if (mod_members[i] > 0) {
-	Nmod++;
-	Msize.insert(pair<const double, int>(mod_size[i],i));
-      }
-    }
-    for (multimap<double,int>::reverse_iterator it = Msize.rbegin(); 
-	 it != Msize.rend(); it++) {
-      modSnode.push_back(it->second);
-    }
-  } else {
-    for (int i=0;i<Nnode;i++) {
-      if (mod_members[i] > 0) {
-	Nmod++;
-	modSnode.push_back(i);
-      }
+  for (int i=0;i<Nnode;i++) {
+    if (mod_members[i] > 0) {
+      modSnode.push_back(i);
     }
   }
+  int Nmod = modSnode.size();
+  if (sort) {
+    std::sort(modSnode.begin(), modSnode.end(), GreedyModuleOrder(mod_size));
+  }
   //modSnode[id_when_no_empty_node] = id_in_mod_tbl
 
-  // Create the new graph
-  FlowGraph * tmp_fgraph = new FlowGraph(Nmod);
-  IGRAPH_FINALLY(delete_FlowGraph, tmp_fgraph);
-  Node ** node_tmp = tmp_fgraph->node ;
-  
-  Node ** node = graph->node;
-  
   vector<int> nodeInMod = vector<int>(Nnode);
-  
-  // creation of new nodes
   for (int i=0;i<Nmod;i++) {
-    //node_tmp[i] = new Node();
-    vector<int>().swap(node_tmp[i]->members); // clear membership
-    node_tmp[i]->exit           =           mod_exit[modSnode[i]];
-    node_tmp[i]->size           =           mod_size[modSnode[i]];
-    node_tmp[i]->danglingSize   =   mod_danglingSize[modSnode[i]];
-    node_tmp[i]->teleportWeight = mod_teleportWeight[modSnode[i]];
-    
-    nodeInMod[modSnode[i]]      = i;
+    nodeInMod[modSnode[i]] = i;
   }
   //nodeInMode[id_in_mod_tbl] = id_when_no_empty_node
-  
-  // Calculate outflow of links to different modules
-  vector<map<int,double> > outFlowNtoM(Nmod);
-  map<int,double>::iterator it_M;
-  
-  for (int i=0;i<Nnode;i++) {
-    int i_M = nodeInMod[node_index[i]]; //final id of the module of the node i
-    // add node members to the module
-    copy( node[i]->members.begin(), node[i]->members.end(), 
-	  back_inserter( node_tmp[i_M]->members ) );
-
-    int NoutLinks = node[i]->outLinks.size();
-    for (int j=0; j<NoutLinks; j++) {
-      int nb         = node[i]->outLinks[j].first;
-      int nb_M       = nodeInMod[node_index[nb]];
-      double nb_flow = node[i]->outLinks[j].second;
-      if (nb != i) {
-	it_M = outFlowNtoM[i_M].find(nb_M);
-	if (it_M != outFlowNtoM[i_M].end()) {
-	  it_M->second += nb_flow;
-	} else {
-	  outFlowNtoM[i_M].insert(make_pair(nb_M,nb_flow));
-	}
-      }
-    }
-  }
-  
-  // Create outLinks at new level
-  for (int i=0;i<Nmod;i++) {
-    for (it_M = outFlowNtoM[i].begin(); it_M != outFlowNtoM[i].end(); it_M++) {
-      if (it_M->first != i) {
-	node_tmp[i]->outLinks.push_back(make_pair(it_M->first,it_M->second));
-      }
-    }
-  }
 
-  // Calculate inflow of links from different modules
-  vector<map<int,double> > inFlowNtoM(Nmod);
-  
+  // final id of the module of each node
+  vector<int> module = vector<int>(Nnode);
   for (int i=0;i<Nnode;i++) {
-    int i_M = nodeInMod[node_index[i]];
-    int NinLinks = node[i]->inLinks.size();
-    for (int j=0;j<NinLinks;j++) {
-      int nb         = node[i]->inLinks[j].first;
-      int nb_M       = nodeInMod[node_index[nb]];
-      double nb_flow = node[i]->inLinks[j].second;
-      if (nb != i) {
-	it_M = inFlowNtoM[i_M].find(nb_M);
-	if (it_M != inFlowNtoM[i_M].end()) {
-	  it_M->second += nb_flow;
-	} else {
-	  inFlowNtoM[i_M].insert(make_pair(nb_M,nb_flow));
-	}
-      }
-    }
-  }
-
-  // Create inLinks at new level
-  for (int i=0;i<Nmod;i++) {
-    for (it_M = inFlowNtoM[i].begin(); it_M != inFlowNtoM[i].end(); it_M++) {
-      if (it_M->first != i) {
-	node_tmp[i]->inLinks.push_back(make_pair(it_M->first,it_M->second));
-      }
-    }
+    module[i] = nodeInMod[node_index[i]];
   }
   
   // Option to move to empty module
   vector<int>().swap(mod_empty);
   Nempty = 0;
 
-  //swap node between tmp_graph and graph, then destroy tmp_fgraph
-  graph->swap(tmp_fgraph);
+  // Replace the nodes of the graph with the modules
+  graph->setModules(Nmod, module, mod_exit, mod_size, mod_danglingSize,
+		    mod_teleportWeight, modSnode);
   Nnode = Nmod;
-  
-  delete tmp_fgraph;
-  IGRAPH_FINALLY_CLEAN(1);
 }
 
 
@@ -456,7 +370,7 @@ void Greedy::apply(bool sort) {
  *  - exitFlow
  *  - exit
  *  - codeLength
- * according to **node / node[i]->index
+ * according to node_index
  */
 void Greedy::tune(void) {
 
@@ -472,20 +386,18 @@ void Greedy::tune(void) {
     mod_members[i] = 0;
   }
   
-  Node ** node = graph->node;
   // Update all values except contribution from teleportation
   for (int i=0; i < Nnode; i++) {
     int i_M = node_index[i]; // module id of node i
-    int Nlinks = node[i]->outLinks.size();
     
-    mod_size[i_M]           += node[i]->size;
-    mod_danglingSize[i_M]   += node[i]->danglingSize;
-    mod_teleportWeight[i_M] += node[i]->teleportWeight;
+    mod_size[i_M]           += graph->size[i];
+    mod_danglingSize[i_M]   += graph->danglingSize[i];
+    mod_teleportWeight[i_M] += graph->teleportWeight[i];
     mod_members[i_M]++;
     
-    for (int j=0;j<Nlinks;j++) {
-      int neighbor      = node[i]->outLinks[j].first;
-      double neighbor_w = node[i]->outLinks[j].second;
+    for (int j=graph->outStart[i]; j<graph->outStart[i+1]; j++) {
+      int neighbor      = graph->outNeis[j];
+      double neighbor_w = graph->outFlow[j];
       int neighbor_M    = node_index[neighbor];
       if (i_M != neighbor_M) // neighbor in an other module
 	mod_exit[i_M] += neighbor_w;
@@ -512,9 +424,8 @@ void Greedy::tune(void) {
 
 /* Compute the new CodeSize if modules are merged as indicated by moveTo
  */
-void Greedy::setMove(int *moveTo) {
+void Greedy::setMove(const vector<int> &moveTo) {
   //void Greedy::determMove(int *moveTo) {
-  Node ** node = graph->node;
   //printf("setMove nNode:%d \n", Nnode);
   for (int i=0 ; i<Nnode ; i++) { // pour chaque module
     int oldM = i;
@@ -525,23 +436,22 @@ void Greedy::setMove(int *moveTo) {
       // Si je comprend bien :
       // outFlow... : c'est le "flow" de i-> autre sommet du meme module
       // inFlow... : c'est le "flow" depuis un autre sommet du meme module --> i
-      double outFlowOldM = (alpha*node[i]->size + beta*node[i]->danglingSize)*
-	(mod_teleportWeight[oldM]-node[i]->teleportWeight);
-      double inFlowOldM  = (alpha*(mod_size[oldM]-node[i]->size) + 
+      double outFlowOldM = (alpha*graph->size[i] + beta*graph->danglingSize[i])*
+	(mod_teleportWeight[oldM]-graph->teleportWeight[i]);
+      double inFlowOldM  = (alpha*(mod_size[oldM]-graph->size[i]) + 
 			    beta*(mod_danglingSize[oldM] - 
-				  node[i]->danglingSize)) * 
-	node[i]->teleportWeight;
-      double outFlowNewM = (alpha*node[i]->size + beta*node[i]->danglingSize)
+				  graph->danglingSize[i])) * 
+	graph->teleportWeight[i];
+      double outFlowNewM = (alpha*graph->size[i] + beta*graph->danglingSize[i])
 	* mod_teleportWeight[newM];
       double inFlowNewM  = (alpha*mod_size[newM] + 
 			    beta*mod_danglingSize[newM]) * 
-	node[i]->teleportWeight;
+	graph->teleportWeight[i];
 
       // For all outLinks
-      int NoutLinks = node[i]->outLinks.size();
-      for (int j=0; j<NoutLinks; j++) {
-	int nb_M = node_index[node[i]->outLinks[j].first];
-	double nb_flow = node[i]->outLinks[j].second;
+      for (int j=graph->outStart[i]; j<graph->outStart[i+1]; j++) {
+	int nb_M = node_index[graph->outNeis[j]];
+	double nb_flow = graph->outFlow[j];
 	if (nb_M == oldM) {
 	  outFlowOldM += nb_flow;
 	}
@@ -551,10 +461,9 @@ void Greedy::setMove(int *moveTo) {
       }
       
       // For all inLinks
-      int NinLinks = node[i]->inLinks.size();
-      for (int j=0; j<NinLinks; j++) {
-	int nb_M = node_index[node[i]->inLinks[j].first];
-	double nb_flow = node[i]->inLinks[j].second;
+      for (int j=graph->inStart[i]; j<graph->inStart[i+1]; j++) {
+	int nb_M = node_index[graph->inNeis[j]];
+	double nb_flow = graph->outFlow[graph->inLink[j]];
 	if (nb_M == oldM) {
 	  inFlowOldM += nb_flow;
 	} else if (nb_M == newM) {
@@ -568,7 +477,7 @@ void Greedy::setMove(int *moveTo) {
 	// si le nouveau etait vide, on a un vide de moins...
 	Nempty--;
       }
-      if (mod_members[oldM] == static_cast<int>(node[i]->members.size())) {
+      if (mod_members[oldM] == graph->nodeMembers(i)) {
 	// si l'ancien avait la taille de celui qui bouge, un vide de plus
 	mod_empty[Nempty] = oldM;
 	Nempty++;
@@ -579,16 +488,16 @@ void Greedy::setMove(int *moveTo) {
       size_log_size -= plogp(mod_exit[oldM] + mod_size[oldM]) +
 	plogp(mod_exit[newM] + mod_size[newM]);
       
-      mod_exit[oldM] -= node[i]->exit - outFlowOldM - inFlowOldM;
-      mod_size[oldM] -= node[i]->size;
-      mod_danglingSize[oldM] -= node[i]->danglingSize;
-      mod_teleportWeight[oldM] -= node[i]->teleportWeight;
-      mod_members[oldM] -= node[i]->members.size();
-      mod_exit[newM] += node[i]->exit - outFlowNewM - inFlowNewM;
-      mod_size[newM] += node[i]->size;
-      mod_danglingSize[newM] += node[i]->danglingSize;
-      mod_teleportWeight[newM] += node[i]->teleportWeight;
-      mod_members[newM] += node[i]->members.size();
+      mod_exit[oldM] -= graph->nodeExit[i] - outFlowOldM - inFlowOldM;
+      mod_size[oldM] -= graph->size[i];
+      mod_danglingSize[oldM] -= graph->danglingSize[i];
+      mod_teleportWeight[oldM] -= graph->teleportWeight[i];
+      mod_members[oldM] -= graph->nodeMembers(i);
+      mod_exit[newM] += graph->nodeExit[i] - outFlowNewM - inFlowNewM;
+      mod_size[newM] += graph->size[i];
+      mod_danglingSize[newM] += graph->danglingSize[i];
+      mod_teleportWeight[newM] += graph->teleportWeight[i];
+      mod_members[newM] += graph->nodeMembers(i);
       
       exitFlow += mod_exit[oldM] + mod_exit[newM];
       exit_log_exit += plogp(mod_exit[oldM]) + plogp(mod_exit[newM]);
@@ -32,17 +32,16 @@
 
 #include "igraph_random.h"
 
-#include "infomap_Node.h"
 #include "infomap_FlowGraph.h"
 
 class Greedy {
  public:
-  Greedy(FlowGraph * fgraph); 
+  Greedy(FlowGraph * fgraph, igraph_rng_t *rng);
   // initialise les attributs par rapport au graph
 
   ~Greedy();
 
-   void setMove(int *moveTo);
+  void setMove(const vector<int> &moveTo);
   //virtual void determMove(int *moveTo);
   
   bool optimize();
@@ -56,6 +55,7 @@ class Greedy {
   /**************************************************************************/
 
   FlowGraph * graph;
+  igraph_rng_t *rng;       // random numbers of the trial
   int Nnode; 
   
   double exit;
@@ -79,7 +79,11 @@ class Greedy {
   vector<double> mod_danglingSize;
   vector<double> mod_teleportWeight;
   vector<int> mod_members;
+
+  // work areas of optimize()
+  vector<int> randomOrder;
+  vector<unsigned int> redirect;
+  vector<pair<int,pair<double,double> > > flowNtoM;
 };
 
-void delete_Greedy(Greedy *greedy);
 #endif
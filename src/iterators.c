@@ -25,6 +25,7 @@
 #include "igraph_memory.h"
 #include "igraph_random.h"
 #include "igraph_interface.h"
+#include "igraph_interface_internal.h"
 #include "config.h"
 
 #include <string.h>
@@ -577,6 +578,7 @@ int igraph_vs_type(const igraph_vs_t *vs) { return vs->type; }
 int igraph_vs_size(const igraph_t *graph, const igraph_vs_t *vs,
   igraph_integer_t *result) {
   igraph_vector_t vec;
+  igraph_vector_int_t ivec;
   igraph_bool_t *seen;
   long i;
 
@@ -597,30 +599,35 @@ int igraph_vs_size(const igraph_t *graph, const igraph_vs_t *vs,
       *result = igraph_vcount(graph); return 0;
 
     case IGRAPH_VS_ADJ:
-    IGRAPH_VECTOR_INIT_FINALLY(&vec, 0);
-    IGRAPH_CHECK(igraph_neighbors(graph,&vec,vs->data.adj.vid,vs->data.adj.mode));
-    *result=(igraph_integer_t) igraph_vector_size(&vec);
+    /* The number of neighbors is the degree with loops counted, we
+       can read it from the index in constant time */
+    IGRAPH_VECTOR_INIT_FINALLY(&vec, 1);
+    IGRAPH_CHECK(igraph_degree(graph, &vec, igraph_vss_1(vs->data.adj.vid),
+			       vs->data.adj.mode, IGRAPH_LOOPS));
+    *result=(igraph_integer_t) VECTOR(vec)[0];
     igraph_vector_destroy(&vec);
     IGRAPH_FINALLY_CLEAN(1);
     return 0;
     
     case IGRAPH_VS_NONADJ:
-    IGRAPH_VECTOR_INIT_FINALLY(&vec, 0);
-    IGRAPH_CHECK(igraph_neighbors(graph,&vec,vs->data.adj.vid,vs->data.adj.mode));
+    IGRAPH_CHECK(igraph_vector_int_init(&ivec, 0));
+    IGRAPH_FINALLY(igraph_vector_int_destroy, &ivec);
+    IGRAPH_CHECK(igraph_i_neighbors(graph, &ivec, vs->data.adj.vid,
+				    vs->data.adj.mode));
     *result=igraph_vcount(graph);
     seen=igraph_Calloc(*result, igraph_bool_t);
     if (seen==0) {
       IGRAPH_ERROR("Cannot calculate selector length", IGRAPH_ENOMEM);
     }
     IGRAPH_FINALLY(igraph_free, seen);
-    for (i=0; i<igraph_vector_size(&vec); i++) {
-      if (!seen[(long int)VECTOR(vec)[i]]) {
+    for (i=0; i<igraph_vector_int_size(&ivec); i++) {
+      if (!seen[VECTOR(ivec)[i]]) {
         (*result)--;
-	      seen[(long int)VECTOR(vec)[i]] = 1;
+	      seen[VECTOR(ivec)[i]] = 1;
       }
     }
     igraph_free(seen);
-    igraph_vector_destroy(&vec);
+    igraph_vector_int_destroy(&ivec);
     IGRAPH_FINALLY_CLEAN(2);
     return 0;
     
@@ -1456,10 +1463,13 @@ int igraph_es_size(const igraph_t *graph, const igraph_es_t *es,
       return 0;
 
     case IGRAPH_ES_INCIDENT:
-      IGRAPH_VECTOR_INIT_FINALLY(&v, 0);
-      IGRAPH_CHECK(igraph_incident(graph, &v,
-				 es->data.incident.vid, es->data.incident.mode));
-      *result = (igraph_integer_t) igraph_vector_size(&v);
+      /* The number of incident edges is the degree with loops
+	 counted, no need to collect them */
+      IGRAPH_VECTOR_INIT_FINALLY(&v, 1);
+      IGRAPH_CHECK(igraph_degree(graph, &v,
+				 igraph_vss_1(es->data.incident.vid),
+				 es->data.incident.mode, IGRAPH_LOOPS));
+      *result = (igraph_integer_t) VECTOR(v)[0];
       igraph_vector_destroy(&v);
       IGRAPH_FINALLY_CLEAN(1);
       return 0;
@@ -1589,36 +1599,41 @@ int igraph_i_eit_create_allfromto(const igraph_t *graph,
   IGRAPH_CHECK(igraph_vector_reserve(vec, igraph_ecount(graph)));
   
   if (igraph_is_directed(graph)) {
-    igraph_vector_t adj;
-    IGRAPH_VECTOR_INIT_FINALLY(&adj, 0);
+    igraph_vector_int_t adj;
+    long int j;
+    IGRAPH_CHECK(igraph_vector_int_init(&adj, 0));
+    IGRAPH_FINALLY(igraph_vector_int_destroy, &adj);
     for (i=0; i<no_of_nodes; i++) {
-      igraph_incident(graph, &adj, (igraph_integer_t) i, mode);
-      igraph_vector_append(vec, &adj);
+      igraph_i_incident(graph, &adj, (igraph_integer_t) i, mode);
+      for (j=0; j<igraph_vector_int_size(&adj); j++) {
+	igraph_vector_push_back(vec, VECTOR(adj)[j]); /* reserved */
+      }
     }
-    igraph_vector_destroy(&adj);
+    igraph_vector_int_destroy(&adj);
     IGRAPH_FINALLY_CLEAN(1);
 
   } else {
 
-    igraph_vector_t adj;
+    igraph_vector_int_t adj;
     igraph_bool_t *added;
     long int j;
-    IGRAPH_VECTOR_INIT_FINALLY(&adj, 0);
+    IGRAPH_CHECK(igraph_vector_int_init(&adj, 0));
+    IGRAPH_FINALLY(igraph_vector_int_destroy, &adj);
     added=igraph_Calloc(igraph_ecount(graph), igraph_bool_t);
     if (added==0) {
       IGRAPH_ERROR("Cannot create edge iterator", IGRAPH_ENOMEM);
     }
     IGRAPH_FINALLY(igraph_free, added);      
     for (i=0; i<no_of_nodes; i++) {
-      igraph_incident(graph, &adj, (igraph_integer_t) i, IGRAPH_ALL);
-      for (j=0; j<igraph_vector_size(&adj); j++) {
-	if (!added[ (long int)VECTOR(adj)[j] ]) {
-	  igraph_vector_push_back(vec, VECTOR(adj)[j]);
-	  added[ (long int)VECTOR(adj)[j] ]+=1;
+      igraph_i_incident(graph, &adj, (igraph_integer_t) i, IGRAPH_ALL);
+      for (j=0; j<igraph_vector_int_size(&adj); j++) {
+	if (!added[ VECTOR(adj)[j] ]) {
+	  igraph_vector_push_back(vec, VECTOR(adj)[j]); /* reserved */
+	  added[ VECTOR(adj)[j] ]+=1;
 	}
       }
     }
-    igraph_vector_destroy(&adj);
+    igraph_vector_int_destroy(&adj);
     igraph_Free(added);
     IGRAPH_FINALLY_CLEAN(2);
   }
@@ -41,6 +41,9 @@
 #include "igraph_blas.h"
 #include "igraph_centrality.h"
 #include "igraph_eigen.h"
+#include "igraph_blas_internal.h"
+#include "igraph_paths_internal.h"
+#include "igraph_parallel_internal.h"
 #include "config.h"
 #include <math.h>
 #include "igraph_math.h"
@@ -2195,6 +2198,268 @@ int igraph_layout_mds(const igraph_t* graph, igraph_matrix_t *res,
   return IGRAPH_SUCCESS;
 }
 
+#define IGRAPH_I_PIVOT_MDS_BLOCK 8192
+
+int igraph_i_layout_pivot_mds_dist(const igraph_t *graph,
+				   const igraph_vector_t *weights,
+				   long int no_of_pivots,
+				   igraph_matrix_t *dist);
+
+int igraph_i_layout_pivot_mds_single(igraph_matrix_t *dist,
+				     igraph_matrix_t *res, long int dim);
+
+/* Chooses the pivots by max-min sampling and calculates the distances
+ * of the vertices from them, column p of 'dist' belongs to pivot p.
+ * The first pivot is random, every further pivot is the vertex that
+ * is the farthest from the pivots chosen so far. Infinite distances
+ * are replaced by the largest finite one. */
+int igraph_i_layout_pivot_mds_dist(const igraph_t *graph,
+				   const igraph_vector_t *weights,
+				   long int no_of_pivots,
+				   igraph_matrix_t *dist) {
+
+  long int no_of_nodes=igraph_vcount(graph);
+  long int i, p, next;
+  igraph_i_sssp_t sssp;
+  igraph_vector_t mindist;
+  igraph_real_t *d, maxdist=0;
+
+  IGRAPH_CHECK(igraph_matrix_resize(dist, no_of_nodes, no_of_pivots));
+  IGRAPH_VECTOR_INIT_FINALLY(&mindist, no_of_nodes);
+  igraph_vector_fill(&mindist, IGRAPH_INFINITY);
+  IGRAPH_CHECK(igraph_i_sssp_init(&sssp, graph, weights, IGRAPH_ALL,
+				  /*no_of_sources=*/ 1));
+  IGRAPH_FINALLY(igraph_i_sssp_destroy, &sssp);
+  d=sssp.threads[0].dist;
+
+  next=RNG_INTEGER(0, no_of_nodes-1);
+  for (p=0; p<no_of_pivots; p++) {
+    igraph_i_sssp(&sssp, /*thread=*/ 0, next, /*cutoff=*/ -1,
+		  /*targets=*/ 0, /*no_of_targets=*/ 0);
+    for (i=0; i<no_of_nodes; i++) {
+      if (d[i] < 0) {
+	MATRIX(*dist, i, p)=IGRAPH_INFINITY;
+	continue;
+      }
+      MATRIX(*dist, i, p)=d[i];
+      if (d[i] < VECTOR(mindist)[i]) { VECTOR(mindist)[i]=d[i]; }
+      if (d[i] > maxdist) { maxdist=d[i]; }
+    }
+    next=igraph_vector_which_max(&mindist);
+    IGRAPH_ALLOW_INTERRUPTION();
+  }
+
+  for (i=0; i<no_of_nodes*no_of_pivots; i++) {
+    if (!igraph_finite(VECTOR(dist->data)[i])) {
+      VECTOR(dist->data)[i]=maxdist;
+    }
+  }
+
+  igraph_i_sssp_destroy(&sssp);
+  igraph_vector_destroy(&mindist);
+  IGRAPH_FINALLY_CLEAN(2);
+
+  return IGRAPH_SUCCESS;
+}
+
+/* Pivot MDS from the n x k distance matrix, which is modified
+ * in-place. The embedding is given by the top eigenvectors of the
+ * small k x k matrix C^T C, where C is the double centered matrix of
+ * the squared distances. */
+int igraph_i_layout_pivot_mds_single(igraph_matrix_t *dist,
+				     igraph_matrix_t *res, long int dim) {
+
+  long int no_of_nodes=igraph_matrix_nrow(dist);
+  long int no_of_pivots=igraph_matrix_ncol(dist);
+  long int nev= dim < no_of_pivots ? dim : no_of_pivots;
+  igraph_matrix_t ctc, vectors;
+  igraph_vector_t values, row_means, col_means, partial;
+  igraph_real_t grand_mean, alpha=1.0, beta=0.0, scale;
+  igraph_eigen_which_t which;
+  long int i, j, k, b, first, no_of_blocks;
+  int num_threads;
+  int m=(int) no_of_pivots, n=(int) no_of_nodes;
+  char transa='T', transb='N';
+
+  /* Double centering of the squared distances */
+  IGRAPH_VECTOR_INIT_FINALLY(&row_means, no_of_nodes);
+  IGRAPH_VECTOR_INIT_FINALLY(&col_means, no_of_pivots);
+  for (j=0; j<no_of_pivots; j++) {
+    for (i=0; i<no_of_nodes; i++) {
+      MATRIX(*dist, i, j) *= MATRIX(*dist, i, j);
+      VECTOR(row_means)[i] += MATRIX(*dist, i, j) / no_of_pivots;
+      VECTOR(col_means)[j] += MATRIX(*dist, i, j) / no_of_nodes;
+    }
+  }
+  grand_mean=igraph_vector_sum(&col_means) / no_of_pivots;
+  for (j=0; j<no_of_pivots; j++) {
+    for (i=0; i<no_of_nodes; i++) {
+      MATRIX(*dist, i, j)=-0.5 * (MATRIX(*dist, i, j) - VECTOR(row_means)[i] -
+				  VECTOR(col_means)[j] + grand_mean);
+    }
+  }
+  igraph_vector_destroy(&col_means);
+  igraph_vector_destroy(&row_means);
+  IGRAPH_FINALLY_CLEAN(2);
+
+  /* C^T C, this is the expensive part. It is the sum of the products
+   * of blocks of rows; the blocks are multiplied in parallel, and
+   * added up in the same order for any number of threads. */
+  IGRAPH_MATRIX_INIT_FINALLY(&ctc, no_of_pivots, no_of_pivots);
+  no_of_blocks=(no_of_nodes + IGRAPH_I_PIVOT_MDS_BLOCK - 1) /
+    IGRAPH_I_PIVOT_MDS_BLOCK;
+  num_threads=IGRAPH_I_THREAD_COUNT(no_of_blocks);
+  IGRAPH_VECTOR_INIT_FINALLY(&partial, num_threads * m * m);
+  for (first=0; first<no_of_blocks; first+=num_threads) {
+    long int last= first+num_threads < no_of_blocks ?
+      first+num_threads : no_of_blocks;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads) schedule(static,1)
+#endif
+    for (b=first; b<last; b++) {
+      int rows=(int) (b < no_of_blocks-1 ? IGRAPH_I_PIVOT_MDS_BLOCK :
+		      no_of_nodes - b * IGRAPH_I_PIVOT_MDS_BLOCK);
+      igraph_real_t *block=&MATRIX(*dist, b * IGRAPH_I_PIVOT_MDS_BLOCK, 0);
+      igraphdgemm_(&transa, &transb, &m, &m, &rows, &alpha, block, &n,
+		   block, &n, &beta, &VECTOR(partial)[(b-first) * m * m], &m);
+    }
+    for (b=first; b<last; b++) {
+      for (i=0; i<m*m; i++) {
+	VECTOR(ctc.data)[i] += VECTOR(partial)[(b-first) * m * m + i];
+      }
+    }
+    IGRAPH_ALLOW_INTERRUPTION();
+  }
+  igraph_vector_destroy(&partial);
+  IGRAPH_FINALLY_CLEAN(1);
+
+  /* Its top eigenvectors */
+  IGRAPH_VECTOR_INIT_FINALLY(&values, 0);
+  IGRAPH_MATRIX_INIT_FINALLY(&vectors, 0, 0);
+  which.pos=IGRAPH_EIGEN_LA;
+  which.howmany=(int) nev;
+  IGRAPH_CHECK(igraph_eigen_matrix_symmetric(/*A=*/ &ctc, /*sA=*/ 0,
+			       /*fun=*/ 0, /*n=*/ m, /*extra=*/ 0,
+			       /*algorithm=*/ IGRAPH_EIGEN_LAPACK,
+			       &which, /*options=*/ 0, /*storage=*/ 0,
+			       &values, &vectors));
+
+  /* The coordinates are C v, scaled like in classical MDS: the
+   * eigenvalues of C^T C are about k/n times the squared eigenvalues
+   * of the full double centered matrix. The eigenvalues are in
+   * increasing order, the first coordinate belongs to the largest. */
+  IGRAPH_CHECK(igraph_matrix_resize(res, no_of_nodes, dim));
+  igraph_matrix_null(res);
+  for (k=0; k<nev; k++) {
+    igraph_real_t value=VECTOR(values)[nev-1-k];
+    if (value <= 0) { continue; }
+    scale=pow((double) no_of_nodes / no_of_pivots, 0.25) / pow(value, 0.25);
+    for (j=0; j<no_of_pivots; j++) {
+      igraph_real_t v=MATRIX(vectors, j, nev-1-k) * scale;
+      for (i=0; i<no_of_nodes; i++) {
+	MATRIX(*res, i, k) += MATRIX(*dist, i, j) * v;
+      }
+    }
+  }
+
+  igraph_matrix_destroy(&vectors);
+  igraph_vector_destroy(&values);
+  igraph_matrix_destroy(&ctc);
+  IGRAPH_FINALLY_CLEAN(3);
+
+  return IGRAPH_SUCCESS;
+}
+
+/**
+ * \function igraph_layout_pivot_mds
+ * \brief Multidimensional scaling with pivots, for large graphs.
+ *
+ * </para><para>
+ * \ref igraph_layout_mds() needs the full distance matrix and its
+ * eigenvectors, this is not feasible for graphs with more than a few
+ * thousand vertices. Pivot MDS approximates classical
+ * multidimensional scaling using the distances from a few pivot
+ * vertices only: it calculates the shortest path lengths from \c k
+ * pivots, double centers the squared distances in the resulting
+ * n times k matrix \c C, and uses the top eigenvectors of the small
+ * k times k matrix \c C^T \c C to calculate the coordinates.
+ *
+ * </para><para>
+ * The pivots are chosen by max-min sampling: the first pivot is
+ * random, and each further pivot is the vertex that is the farthest
+ * from the pivots chosen so far. Infinite distances of disconnected
+ * graphs are replaced by the largest finite distance.
+ *
+ * </para><para>
+ * The layout is scaled like the classical MDS layout, so the
+ * distances of the vertices approximate their graph theoretical
+ * distances. This makes it a good starting layout for force directed
+ * and stress based layouts.
+ *
+ * </para><para>
+ * Reference: Ulrik Brandes and Christian Pich: Eigensolver Methods
+ * for Progressive Multidimensional Scaling of Large Data. Graph
+ * Drawing, 2006, 42--53.
+ *
+ * \param graph The input graph, edge directions are ignored.
+ * \param res Pointer to an initialized matrix, the result is stored
+ *        here, one row for each vertex and one column for each
+ *        coordinate. It is resized as needed.
+ * \param dim The number of dimensions in the embedding space, a
+ *        positive integer.
+ * \param pivots The number of pivots, it must be larger than \p
+ *        dim. If it is larger than the number of vertices, all
+ *        vertices are pivots. 50 to 200 pivots are usually enough.
+ * \param weights Edge lengths, positive numbers, or a null pointer,
+ *        then all edges have unit length.
+ * \return Error code.
+ *
+ * Time complexity: O(k (|V| + |E|)) for the breadth-first searches
+ * from the pivots, O(k |V| log|V| + k |E|) if there are weights, and
+ * O(k^2 |V|) for the eigenvectors. The memory usage is O(k |V| + |E|).
+ */
+
+int igraph_layout_pivot_mds(const igraph_t *graph, igraph_matrix_t *res,
+			    long int dim, long int pivots,
+			    const igraph_vector_t *weights) {
+  long int no_of_nodes=igraph_vcount(graph);
+  long int no_of_edges=igraph_ecount(graph);
+  long int no_of_pivots;
+  igraph_matrix_t dist;
+
+  if (dim < 1) {
+    IGRAPH_ERROR("dim must be positive", IGRAPH_EINVAL);
+  }
+  if (pivots <= dim) {
+    IGRAPH_ERROR("number of pivots must be larger than dim", IGRAPH_EINVAL);
+  }
+  if (weights && igraph_vector_size(weights) != no_of_edges) {
+    IGRAPH_ERROR("Invalid weight vector length", IGRAPH_EINVAL);
+  }
+  if (weights && no_of_edges > 0 && igraph_vector_min(weights) <= 0) {
+    IGRAPH_ERROR("Weights must be positive for pivot MDS", IGRAPH_EINVAL);
+  }
+
+  if (no_of_nodes <= 1) {
+    IGRAPH_CHECK(igraph_matrix_resize(res, no_of_nodes, dim));
+    igraph_matrix_null(res);
+    return IGRAPH_SUCCESS;
+  }
+
+  no_of_pivots= pivots < no_of_nodes ? pivots : no_of_nodes;
+  IGRAPH_MATRIX_INIT_FINALLY(&dist, 0, 0);
+  RNG_BEGIN();
+  IGRAPH_CHECK(igraph_i_layout_pivot_mds_dist(graph, weights, no_of_pivots,
+					      &dist));
+  RNG_END();
+  IGRAPH_CHECK(igraph_i_layout_pivot_mds_single(&dist, res, dim));
+
+  igraph_matrix_destroy(&dist);
+  IGRAPH_FINALLY_CLEAN(1);
+
+  return IGRAPH_SUCCESS;
+}
+
 /**
  * \function igraph_layout_bipartite
  * Simple layout for bipartite graphs
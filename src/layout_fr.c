@@ -27,6 +27,9 @@
 #include "igraph_interface.h"
 #include "igraph_components.h"
 #include "igraph_types_internal.h"
+#include "igraph_memory.h"
+#include "igraph_interrupt_internal.h"
+#include "igraph_parallel_internal.h"
 
 int igraph_layout_i_fr(const igraph_t *graph,
     igraph_matrix_t *res,
@@ -421,6 +424,477 @@ int igraph_layout_i_grid_fr(const igraph_t *graph,
   return 0;
 }
 
+/*
+ * Barnes-Hut approximation of the repulsive forces, with a quadtree in
+ * 2D and an octree in 3D. The tree is rebuilt in every iteration. All
+ * nodes are in a single array, the 2^dim children of an internal node
+ * are consecutive. Every node stores the number of vertices in its cell
+ * and their center of mass; a leaf stores its vertex, or, at the
+ * maximum depth only, a chain of vertices with (almost) the same
+ * position. The cells themselves are not stored, they are recomputed
+ * from the root cell while walking down the tree.
+ *
+ * The force on a vertex only needs read access to the tree, so the
+ * vertices are processed in parallel, each thread writes the
+ * displacement of its own vertices only.
+ */
+
+#define IGRAPH_I_LAYOUT_BH_MAX_DEPTH 48
+#define IGRAPH_I_LAYOUT_BH_STACK ((8 - 1) * IGRAPH_I_LAYOUT_BH_MAX_DEPTH + 1)
+#define IGRAPH_I_LAYOUT_BH_PARALLEL_MIN 1000
+#define IGRAPH_I_LAYOUT_BH_THETA 0.8
+
+typedef struct igraph_i_layout_bh_node_t {
+  igraph_real_t com[3];         /* center of mass */
+  long int count;               /* number of vertices in the cell */
+  long int child;               /* index of the first child, -1 in leaves */
+  long int first;               /* leaves: first vertex, or -1 */
+} igraph_i_layout_bh_node_t;
+
+typedef struct igraph_i_layout_bh_tree_t {
+  int dim;
+  long int no_nodes, size;
+  igraph_i_layout_bh_node_t *nodes;
+  long int *next;               /* chains of the vertices in the leaves */
+  igraph_real_t *pos;           /* copy of the coordinates, row-wise */
+  long int *order;              /* the vertices in the order of the leaves */
+  igraph_real_t center[3], half; /* the root cell */
+} igraph_i_layout_bh_tree_t;
+
+typedef struct igraph_i_layout_bh_cell_t {
+  long int node;
+  igraph_real_t center[3], half;
+} igraph_i_layout_bh_cell_t;
+
+static void igraph_i_layout_bh_tree_destroy(igraph_i_layout_bh_tree_t *tree) {
+  igraph_Free(tree->nodes);
+  igraph_Free(tree->next);
+  igraph_Free(tree->pos);
+  igraph_Free(tree->order);
+}
+
+static int igraph_i_layout_bh_tree_init(igraph_i_layout_bh_tree_t *tree,
+                                        long int no_of_nodes, int dim) {
+  tree->dim=dim;
+  tree->no_nodes=0;
+  tree->size=2 * no_of_nodes + 1;
+  tree->nodes=igraph_Calloc(tree->size, igraph_i_layout_bh_node_t);
+  tree->next=igraph_Calloc(no_of_nodes > 0 ? no_of_nodes : 1, long int);
+  tree->pos=igraph_Calloc(no_of_nodes > 0 ? no_of_nodes * dim : 1,
+                          igraph_real_t);
+  tree->order=igraph_Calloc(no_of_nodes > 0 ? no_of_nodes : 1, long int);
+  if (!tree->nodes || !tree->next || !tree->pos || !tree->order) {
+    igraph_i_layout_bh_tree_destroy(tree);
+    IGRAPH_ERROR("Cannot build Barnes-Hut tree", IGRAPH_ENOMEM);
+  }
+  return 0;
+}
+
+static int igraph_i_layout_bh_octant(const igraph_real_t *p,
+                                     const igraph_real_t *center, int dim) {
+  int k, idx=0;
+  for (k=0; k<dim; k++) {
+    if (p[k] >= center[k]) { idx |= 1 << k; }
+  }
+  return idx;
+}
+
+/* Adds the empty children of a leaf, 'node' becomes an internal node */
+static int igraph_i_layout_bh_tree_split(igraph_i_layout_bh_tree_t *tree,
+                                         long int node) {
+  long int nchild=1 << tree->dim, i;
+  if (tree->no_nodes + nchild > tree->size) {
+    long int size=2 * tree->size;
+    igraph_i_layout_bh_node_t *tmp;
+    while (size < tree->no_nodes + nchild) { size *= 2; }
+    tmp=igraph_Realloc(tree->nodes, size, igraph_i_layout_bh_node_t);
+    if (!tmp) {
+      IGRAPH_ERROR("Cannot build Barnes-Hut tree", IGRAPH_ENOMEM);
+    }
+    tree->nodes=tmp;
+    tree->size=size;
+  }
+  tree->nodes[node].child=tree->no_nodes;
+  for (i=0; i<nchild; i++) {
+    igraph_i_layout_bh_node_t *n=&tree->nodes[tree->no_nodes++];
+    n->com[0] = n->com[1] = n->com[2] = 0.0;
+    n->count=0;
+    n->child=-1;
+    n->first=-1;
+  }
+  return 0;
+}
+
+static int igraph_i_layout_bh_tree_build(igraph_i_layout_bh_tree_t *tree,
+                                         const igraph_matrix_t *res) {
+  int dim=tree->dim, k;
+  long int no_of_nodes=igraph_matrix_nrow(res);
+  long int v, i;
+  igraph_real_t min[3], max[3];
+  igraph_i_layout_bh_node_t *root;
+
+  /* the root cell is the bounding box, made a square/cube */
+  for (k=0; k<dim; k++) {
+    min[k] = max[k] = no_of_nodes > 0 ? MATRIX(*res, 0, k) : 0.0;
+    for (v=0; v<no_of_nodes; v++) {
+      igraph_real_t p=MATRIX(*res, v, k);
+      tree->pos[v * dim + k]=p;
+      if (p < min[k]) { min[k]=p; }
+      if (p > max[k]) { max[k]=p; }
+    }
+  }
+  tree->half=0.0;
+  for (k=0; k<dim; k++) {
+    tree->center[k]=(min[k] + max[k]) / 2.0;
+    if ((max[k] - min[k]) / 2.0 > tree->half) {
+      tree->half=(max[k] - min[k]) / 2.0;
+    }
+  }
+  if (tree->half == 0.0) { tree->half=1.0; }
+
+  tree->no_nodes=1;
+  root=&tree->nodes[0];
+  root->com[0] = root->com[1] = root->com[2] = 0.0;
+  root->count=0;
+  root->child=-1;
+  root->first=-1;
+
+  for (v=0; v<no_of_nodes; v++) {
+    long int node=0;
+    int depth=0;
+    const igraph_real_t *p=&tree->pos[v * dim];
+    igraph_real_t c[3], h=tree->half;
+    for (k=0; k<dim; k++) { c[k]=tree->center[k]; }
+    while (1) {
+      igraph_i_layout_bh_node_t *n=&tree->nodes[node];
+      int idx;
+      for (k=0; k<dim; k++) { n->com[k] += p[k]; }
+      n->count += 1;
+      if (n->child < 0) {
+        long int u=n->first;
+        igraph_i_layout_bh_node_t *ch;
+        if (n->count == 1) {
+          n->first=v;
+          tree->next[v]=-1;
+          break;
+        }
+        if (depth == IGRAPH_I_LAYOUT_BH_MAX_DEPTH) {
+          tree->next[v]=n->first;
+          n->first=v;
+          break;
+        }
+        /* a leaf with one vertex below the maximum depth, split it
+           and move its vertex one level down */
+        IGRAPH_CHECK(igraph_i_layout_bh_tree_split(tree, node));
+        n=&tree->nodes[node];
+        n->first=-1;
+        ch=&tree->nodes[n->child +
+                        igraph_i_layout_bh_octant(&tree->pos[u * dim], c, dim)];
+        for (k=0; k<dim; k++) { ch->com[k]=tree->pos[u * dim + k]; }
+        ch->count=1;
+        ch->first=u;
+      }
+      idx=igraph_i_layout_bh_octant(p, c, dim);
+      h /= 2.0;
+      for (k=0; k<dim; k++) { c[k] += (idx & (1 << k)) ? h : -h; }
+      node=n->child + idx;
+      depth++;
+    }
+  }
+
+  for (i=0; i<tree->no_nodes; i++) {
+    igraph_i_layout_bh_node_t *n=&tree->nodes[i];
+    if (n->count > 1) {
+      for (k=0; k<dim; k++) { n->com[k] /= n->count; }
+    }
+  }
+
+  /* Vertices that are close to each other walk mostly the same part
+     of the tree, so they are processed in the order of the leaves */
+  if (no_of_nodes > 0) {
+    long int stack[IGRAPH_I_LAYOUT_BH_STACK], top=1, ptr=0;
+    int nchild=1 << dim;
+    stack[0]=0;
+    while (top > 0) {
+      const igraph_i_layout_bh_node_t *n=&tree->nodes[stack[--top]];
+      if (n->child < 0) {
+        for (v=n->first; v >= 0; v=tree->next[v]) { tree->order[ptr++]=v; }
+      } else {
+        for (i=nchild-1; i >= 0; i--) {
+          if (tree->nodes[n->child + i].count > 0) {
+            stack[top++]=n->child + i;
+          }
+        }
+      }
+    }
+  }
+
+  return 0;
+}
+
+/* Repulsion from 'mass' vertices at distance sqrt(dist2), in direction
+   'd'. For disconnected graphs there is also a weak attraction, that
+   keeps the components together, C is zero for connected graphs. */
+static void igraph_i_layout_bh_add(igraph_real_t *force,
+                                   const igraph_real_t *d,
+                                   igraph_real_t dist2, igraph_real_t mass,
+                                   igraph_real_t C, int dim) {
+  int k;
+  igraph_real_t f=C == 0 ? mass / dist2 :
+    mass * (C - dist2 * sqrt(dist2)) / (dist2 * C);
+  for (k=0; k<dim; k++) { force[k] += d[k] * f; }
+}
+
+/* Exact forces from the vertices of a leaf */
+static void igraph_i_layout_bh_leaf(const igraph_i_layout_bh_tree_t *tree,
+                                    const igraph_i_layout_bh_node_t *n,
+                                    long int v, igraph_real_t C,
+                                    igraph_real_t *force) {
+  int dim=tree->dim, k;
+  const igraph_real_t *p=&tree->pos[v * dim];
+  igraph_real_t d[3], dist2;
+  long int u;
+  for (u=n->first; u >= 0; u=tree->next[u]) {
+    if (u == v) { continue; }
+    dist2=0.0;
+    for (k=0; k<dim; k++) {
+      d[k]=p[k] - tree->pos[u * dim + k];
+      dist2 += d[k] * d[k];
+    }
+    if (dist2 == 0) {
+      /* push them apart, in opposite directions */
+      for (k=0; k<dim; k++) { d[k]=v < u ? 1e-9 : -1e-9; }
+      dist2=dim * 1e-18;
+    }
+    igraph_i_layout_bh_add(force, d, dist2, 1.0, C, dim);
+  }
+}
+
+static void igraph_i_layout_bh_force(const igraph_i_layout_bh_tree_t *tree,
+                                     long int v, igraph_real_t theta2,
+                                     igraph_real_t C, igraph_real_t *force) {
+  igraph_i_layout_bh_cell_t stack[IGRAPH_I_LAYOUT_BH_STACK];
+  int dim=tree->dim, nchild=1 << dim, k, top=1;
+  const igraph_real_t *p=&tree->pos[v * dim];
+
+  for (k=0; k<dim; k++) {
+    force[k]=0.0;
+    stack[0].center[k]=tree->center[k];
+  }
+  if (tree->nodes[0].child < 0) {
+    igraph_i_layout_bh_leaf(tree, &tree->nodes[0], v, C, force);
+    return;
+  }
+  stack[0].node=0;
+  stack[0].half=tree->half;
+
+  /* the cells on the stack are internal nodes that are too close, the
+     children are decided before pushing them */
+  while (top > 0) {
+    igraph_i_layout_bh_cell_t cell=stack[--top];
+    long int first=tree->nodes[cell.node].child;
+    igraph_real_t half=cell.half / 2.0;
+    int i;
+    for (i=0; i<nchild; i++) {
+      const igraph_i_layout_bh_node_t *n=&tree->nodes[first + i];
+      igraph_real_t c[3], d[3], dist2=0.0;
+      igraph_bool_t inside=1;
+      if (n->count == 0) { continue; }
+      if (n->child < 0) {
+        igraph_i_layout_bh_leaf(tree, n, v, C, force);
+        continue;
+      }
+      for (k=0; k<dim; k++) {
+        c[k]=cell.center[k] + ((i & (1 << k)) ? half : -half);
+        d[k]=p[k] - n->com[k];
+        dist2 += d[k] * d[k];
+        if (fabs(p[k] - c[k]) > half) { inside=0; }
+      }
+      if (!inside && 4.0 * half * half < theta2 * dist2) {
+        /* far enough, use the center of mass of the cell */
+        igraph_i_layout_bh_add(force, d, dist2, n->count, C, dim);
+      } else {
+        igraph_i_layout_bh_cell_t *ch=&stack[top++];
+        ch->node=first + i;
+        ch->half=half;
+        for (k=0; k<dim; k++) { ch->center[k]=c[k]; }
+      }
+    }
+  }
+}
+
+/* The 2D and 3D Barnes-Hut versions, minc and maxc have 'dim' elements */
+static int igraph_layout_i_bh_fr(const igraph_t *graph,
+    igraph_matrix_t *res,
+    igraph_bool_t use_seed,
+    igraph_integer_t niter,
+    igraph_real_t start_temp,
+    igraph_real_t theta,
+    const igraph_vector_t *weight,
+    const igraph_vector_t **minc,
+    const igraph_vector_t **maxc,
+    const igraph_vector_t *new_v,
+    int dim) {
+
+  long int no_nodes=igraph_vcount(graph);
+  long int no_edges=igraph_ecount(graph);
+  long int no_moving, i, j, e;
+  igraph_real_t temp=start_temp;
+  igraph_real_t difftemp=start_temp / niter;
+  igraph_real_t width=sqrt(no_nodes);
+  igraph_real_t theta2=theta * theta;
+  igraph_bool_t conn=1;
+  igraph_real_t C=0;
+  igraph_vector_t disp;
+  igraph_vector_long_t moving;
+  igraph_vector_char_t mark;
+  igraph_i_layout_bh_tree_t tree;
+  int k;
+
+  if (niter < 0) {
+    IGRAPH_ERROR("Number of iterations must be non-negative in "
+        "Fruchterman-Reingold layout", IGRAPH_EINVAL);
+  }
+  if (theta < 0) {
+    IGRAPH_ERROR("Barnes-Hut theta must be non-negative in "
+        "Fruchterman-Reingold layout", IGRAPH_EINVAL);
+  }
+  if (use_seed && (igraph_matrix_nrow(res) != no_nodes ||
+        igraph_matrix_ncol(res) != dim)) {
+    IGRAPH_ERROR("Invalid start position matrix size in "
+        "Fruchterman-Reingold layout", IGRAPH_EINVAL);
+  }
+  if (weight && igraph_vector_size(weight) != no_edges) {
+    IGRAPH_ERROR("Invalid weight vector length", IGRAPH_EINVAL);
+  }
+  for (k=0; k<dim; k++) {
+    if ((minc[k] && igraph_vector_size(minc[k]) != no_nodes) ||
+        (maxc[k] && igraph_vector_size(maxc[k]) != no_nodes)) {
+      IGRAPH_ERROR("Invalid coordinate bound vector length", IGRAPH_EINVAL);
+    }
+    if (minc[k] && maxc[k] && !igraph_vector_all_le(minc[k], maxc[k])) {
+      IGRAPH_ERROR("Lower coordinate bounds must not be greater than "
+          "the upper bounds", IGRAPH_EINVAL);
+    }
+  }
+  if (new_v && igraph_vector_size(new_v) > 0 &&
+      (igraph_vector_min(new_v) < 0 ||
+       igraph_vector_max(new_v) >= no_nodes)) {
+    IGRAPH_ERROR("Invalid vertex id in new_v", IGRAPH_EINVVID);
+  }
+
+  IGRAPH_CHECK(igraph_is_connected(graph, &conn, IGRAPH_WEAK));
+  if (!conn) { C=no_nodes * sqrt(no_nodes); }
+
+  /* the vertices that move, without duplicates */
+  IGRAPH_CHECK(igraph_vector_char_init(&mark, no_nodes));
+  IGRAPH_FINALLY(igraph_vector_char_destroy, &mark);
+  IGRAPH_CHECK(igraph_vector_long_init(&moving, 0));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &moving);
+  if (new_v) {
+    for (i=0; i<igraph_vector_size(new_v); i++) {
+      VECTOR(mark)[(long int) VECTOR(*new_v)[i]]=1;
+    }
+  } else {
+    igraph_vector_char_fill(&mark, 1);
+  }
+  for (i=0; i<no_nodes; i++) {
+    if (VECTOR(mark)[i]) {
+      IGRAPH_CHECK(igraph_vector_long_push_back(&moving, i));
+    }
+  }
+  no_moving=igraph_vector_long_size(&moving);
+
+  IGRAPH_VECTOR_INIT_FINALLY(&disp, no_nodes * dim);
+  IGRAPH_CHECK(igraph_i_layout_bh_tree_init(&tree, no_nodes, dim));
+  IGRAPH_FINALLY(igraph_i_layout_bh_tree_destroy, &tree);
+
+  RNG_BEGIN();
+
+  if (!use_seed) {
+    IGRAPH_CHECK(igraph_matrix_resize(res, no_nodes, dim));
+    for (i=0; i<no_nodes; i++) {
+      for (k=0; k<dim; k++) {
+        igraph_real_t lo=minc[k] ? VECTOR(*minc[k])[i] : -width/2;
+        igraph_real_t hi=maxc[k] ? VECTOR(*maxc[k])[i] :  width/2;
+        if (!igraph_finite(lo)) { lo=-width/2; }
+        if (!igraph_finite(hi)) { hi= width/2; }
+        MATRIX(*res, i, k)=RNG_UNIF(lo, hi);
+      }
+    }
+  }
+
+  for (i=0; i<niter; i++) {
+
+    IGRAPH_ALLOW_INTERRUPTION();
+
+    /* repulsive forces */
+    IGRAPH_CHECK(igraph_i_layout_bh_tree_build(&tree, res));
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(IGRAPH_I_THREAD_COUNT(no_moving)) \
+  schedule(dynamic, 256) if (no_moving >= IGRAPH_I_LAYOUT_BH_PARALLEL_MIN)
+#endif
+    for (j=0; j<no_nodes; j++) {
+      long int v=tree.order[j];
+      if (!VECTOR(mark)[v]) { continue; }
+      igraph_i_layout_bh_force(&tree, v, theta2, C,
+                               &VECTOR(disp)[v * dim]);
+    }
+
+    /* attractive forces */
+    for (e=0; e<no_edges; e++) {
+      long int v=IGRAPH_FROM(graph, e);
+      long int u=IGRAPH_TO(graph, e);
+      igraph_real_t w=weight ? VECTOR(*weight)[e] : 1.0;
+      igraph_real_t d[3], dlen=0.0;
+      if (!VECTOR(mark)[v] && !VECTOR(mark)[u]) { continue; }
+      for (k=0; k<dim; k++) {
+        d[k]=MATRIX(*res, v, k) - MATRIX(*res, u, k);
+        dlen += d[k] * d[k];
+      }
+      dlen=sqrt(dlen) * w;
+      for (k=0; k<dim; k++) {
+        if (VECTOR(mark)[v]) { VECTOR(disp)[v * dim + k] -= d[k] * dlen; }
+        if (VECTOR(mark)[u]) { VECTOR(disp)[u * dim + k] += d[k] * dlen; }
+      }
+    }
+
+    /* limit the displacement to the temperature and keep the
+       vertices within their bounds */
+    for (j=0; j<no_moving; j++) {
+      long int v=VECTOR(moving)[j];
+      igraph_real_t *dv=&VECTOR(disp)[v * dim];
+      igraph_real_t displen=0.0;
+      for (k=0; k<dim; k++) {
+        dv[k] += RNG_UNIF01() * 1e-9;
+        displen += dv[k] * dv[k];
+      }
+      displen=sqrt(displen);
+      for (k=0; k<dim; k++) {
+        if (displen > temp) { dv[k] *= temp / displen; }
+        MATRIX(*res, v, k) += dv[k];
+        if (minc[k] && MATRIX(*res, v, k) < VECTOR(*minc[k])[v]) {
+          MATRIX(*res, v, k)=VECTOR(*minc[k])[v];
+        }
+        if (maxc[k] && MATRIX(*res, v, k) > VECTOR(*maxc[k])[v]) {
+          MATRIX(*res, v, k)=VECTOR(*maxc[k])[v];
+        }
+      }
+    }
+
+    temp -= difftemp;
+  }
+
+  RNG_END();
+
+  igraph_i_layout_bh_tree_destroy(&tree);
+  igraph_vector_destroy(&disp);
+  igraph_vector_long_destroy(&moving);
+  igraph_vector_char_destroy(&mark);
+  IGRAPH_FINALLY_CLEAN(4);
+  return 0;
+}
+
 /**
  * \ingroup layout
  * \function igraph_layout_fruchterman_reingold
@@ -446,9 +920,11 @@ int igraph_layout_i_grid_fr(const igraph_t *graph,
  * \param grid Whether to use the (fast but less accurate) grid based
  *        version of the algorithm. Possible values: \c
  *        IGRAPH_LAYOUT_GRID, \c IGRAPH_LAYOUT_NOGRID, \c
- *        IGRAPH_LAYOUT_AUTOGRID. The last one uses the grid based
- *        version only for large graphs, currently the ones with
- *        more than 1000 vertices.
+ *        IGRAPH_LAYOUT_AUTOGRID, \c IGRAPH_LAYOUT_BARNES_HUT. The
+ *        third one uses the grid based version only for large graphs,
+ *        currently the ones with more than 1000 vertices. The last one
+ *        approximates the repulsive forces with a quadtree, see \ref
+ *        igraph_layout_fruchterman_reingold_bh(), with theta 0.8.
  * \param weight Pointer to a vector containing edge weights,
  *        the attraction along the edges will be multiplied by these.
  *        It will be ignored if it is a null-pointer.
@@ -526,7 +1002,11 @@ int igraph_layout_fruchterman_reingold(const igraph_t *graph,
     }
   }
 
-  if (grid == IGRAPH_LAYOUT_GRID) {
+  if (grid == IGRAPH_LAYOUT_BARNES_HUT) {
+    return igraph_layout_fruchterman_reingold_bh(graph, res, use_seed, niter,
+        start_temp, IGRAPH_I_LAYOUT_BH_THETA, weight, minx, maxx, miny, maxy,
+        new_v);
+  } else if (grid == IGRAPH_LAYOUT_GRID) {
     return igraph_layout_i_grid_fr(graph, res, use_seed, niter, start_temp,
         weight, minx, maxx, miny, maxy, new_v);
   } else {
@@ -801,3 +1281,154 @@ int igraph_layout_fruchterman_reingold_3d(const igraph_t *graph,
 
   return 0;
 }
+
+/**
+ * \function igraph_layout_fruchterman_reingold_bh
+ * \brief Fruchterman-Reingold layout with Barnes-Hut approximation.
+ *
+ * </para><para>
+ * This is the same force-directed layout as \ref
+ * igraph_layout_fruchterman_reingold(), but the repulsive forces are
+ * approximated as in Barnes, J. and Hut, P.: A hierarchical O(N log N)
+ * force-calculation algorithm. Nature, 324/4, 446--449, 1986. The
+ * vertices are put into a quadtree, and a cell that is small compared
+ * to its distance from a vertex acts on the vertex as if all its
+ * vertices were in their center of mass. Unlike the grid based version,
+ * this keeps the long range repulsion, so it is suitable for large
+ * graphs. The forces on the vertices are computed in parallel, if
+ * igraph was built with OpenMP support, the result does not depend on
+ * the number of threads.
+ *
+ * \param graph Pointer to an initialized graph object.
+ * \param res Pointer to an initialized matrix object. This will
+ *        contain the result and will be resized as needed.
+ * \param use_seed Logical, if true the supplied values in the
+ *        \p res argument are used as an initial layout, if
+ *        false a random initial layout is used.
+ * \param niter The number of iterations to do. A reasonable
+ *        default value is 500.
+ * \param start_temp Start temperature. This is the maximum amount
+ *        of movement allowed for a vertex within one step. It is
+ *        decreased linearly to zero during the iteration.
+ * \param theta The accuracy of the approximation. A cell is
+ *        replaced by its center of mass if its side length divided
+ *        by its distance from the vertex is less than \p theta.
+ *        Zero gives the exact forces, values between 0.5 and 1 are
+ *        usual; larger values are faster and less accurate.
+ * \param weight Pointer to a vector containing edge weights,
+ *        the attraction along the edges will be multiplied by these.
+ *        It will be ignored if it is a null-pointer.
+ * \param minx Pointer to a vector, or a \c NULL pointer. If not a
+ *        \c NULL pointer then the vector gives the minimum
+ *        \quote x \endquote coordinate for every vertex.
+ * \param maxx Same as \p minx, but the maximum \quote x \endquote
+ *        coordinates.
+ * \param miny Pointer to a vector, or a \c NULL pointer. If not a
+ *        \c NULL pointer then the vector gives the minimum
+ *        \quote y \endquote coordinate for every vertex.
+ * \param maxy Same as \p miny, but the maximum \quote y \endquote
+ *        coordinates.
+ * \param new_v Pointer to a vector of vertex ids, or a \c NULL
+ *        pointer. If not a \c NULL pointer, then only these vertices
+ *        are moved, the others stay where they are in \p res. This
+ *        only makes sense together with \p use_seed.
+ * \return Error code.
+ *
+ * Time complexity: O(|V| log |V| + |E|) in each iteration, for
+ * positive \p theta and a not too uneven distribution of the
+ * vertices; O(|V|^2 + |E|) for zero \p theta.
+ */
+
+int igraph_layout_fruchterman_reingold_bh(const igraph_t *graph,
+    igraph_matrix_t *res,
+    igraph_bool_t use_seed,
+    igraph_integer_t niter,
+    igraph_real_t start_temp,
+    igraph_real_t theta,
+    const igraph_vector_t *weight,
+    const igraph_vector_t *minx,
+    const igraph_vector_t *maxx,
+    const igraph_vector_t *miny,
+    const igraph_vector_t *maxy,
+    const igraph_vector_t *new_v) {
+
+  const igraph_vector_t *minc[2], *maxc[2];
+
+  minc[0]=minx; minc[1]=miny;
+  maxc[0]=maxx; maxc[1]=maxy;
+
+  return igraph_layout_i_bh_fr(graph, res, use_seed, niter, start_temp,
+      theta, weight, minc, maxc, new_v, 2);
+}
+
+/**
+ * \function igraph_layout_fruchterman_reingold_3d_bh
+ * \brief 3D Fruchterman-Reingold layout with Barnes-Hut approximation.
+ *
+ * This is the 3D version of \ref
+ * igraph_layout_fruchterman_reingold_bh(), it uses an octree instead
+ * of a quadtree.
+ *
+ * \param graph Pointer to an initialized graph object.
+ * \param res Pointer to an initialized matrix object. This will
+ *        contain the result and will be resized as needed.
+ * \param use_seed Logical, if true the supplied values in the
+ *        \p res argument are used as an initial layout, if
+ *        false a random initial layout is used.
+ * \param niter The number of iterations to do. A reasonable
+ *        default value is 500.
+ * \param start_temp Start temperature. This is the maximum amount
+ *        of movement allowed for a vertex within one step. It is
+ *        decreased linearly to zero during the iteration.
+ * \param theta The accuracy of the approximation, see \ref
+ *        igraph_layout_fruchterman_reingold_bh().
+ * \param weight Pointer to a vector containing edge weights,
+ *        the attraction along the edges will be multiplied by these.
+ *        It will be ignored if it is a null-pointer.
+ * \param minx Pointer to a vector, or a \c NULL pointer. If not a
+ *        \c NULL pointer then the vector gives the minimum
+ *        \quote x \endquote coordinate for every vertex.
+ * \param maxx Same as \p minx, but the maximum \quote x \endquote
+ *        coordinates.
+ * \param miny Pointer to a vector, or a \c NULL pointer. If not a
+ *        \c NULL pointer then the vector gives the minimum
+ *        \quote y \endquote coordinate for every vertex.
+ * \param maxy Same as \p miny, but the maximum \quote y \endquote
+ *        coordinates.
+ * \param minz Pointer to a vector, or a \c NULL pointer. If not a
+ *        \c NULL pointer then the vector gives the minimum
+ *        \quote z \endquote coordinate for every vertex.
+ * \param maxz Same as \p minz, but the maximum \quote z \endquote
+ *        coordinates.
+ * \param new_v Pointer to a vector of vertex ids to move, or a \c
+ *        NULL pointer to move all vertices.
+ * \return Error code.
+ *
+ * Time complexity: O(|V| log |V| + |E|) in each iteration, for
+ * positive \p theta and a not too uneven distribution of the
+ * vertices.
+ */
+
+int igraph_layout_fruchterman_reingold_3d_bh(const igraph_t *graph,
+    igraph_matrix_t *res,
+    igraph_bool_t use_seed,
+    igraph_integer_t niter,
+    igraph_real_t start_temp,
+    igraph_real_t theta,
+    const igraph_vector_t *weight,
+    const igraph_vector_t *minx,
+    const igraph_vector_t *maxx,
+    const igraph_vector_t *miny,
+    const igraph_vector_t *maxy,
+    const igraph_vector_t *minz,
+    const igraph_vector_t *maxz,
+    const igraph_vector_t *new_v) {
+
+  const igraph_vector_t *minc[3], *maxc[3];
+
+  minc[0]=minx; minc[1]=miny; minc[2]=minz;
+  maxc[0]=maxx; maxc[1]=maxy; maxc[2]=maxz;
+
+  return igraph_layout_i_bh_fr(graph, res, use_seed, niter, start_temp,
+      theta, weight, minc, maxc, new_v, 3);
+}
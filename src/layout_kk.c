@@ -36,6 +36,11 @@
  * This is a force directed layout, see  Kamada, T. and Kawai, S.: An
  * Algorithm for Drawing General Undirected Graphs. Information
  * Processing Letters, 31/1, 7--15, 1989.
+ *
+ * </para><para>
+ * This function stores the distances of all vertex pairs, so it needs
+ * quadratic memory. For large graphs use \ref
+ * igraph_layout_sparse_stress() instead.
  * \param graph A graph object.
  * \param res Pointer to an initialized matrix object. This will
  *        contain the result (x-positions in column zero and
@@ -297,6 +302,11 @@ int igraph_layout_kamada_kawai(const igraph_t *graph, igraph_matrix_t *res,
  * This is a force directed layout, see  Kamada, T. and Kawai, S.: An
  * Algorithm for Drawing General Undirected Graphs. Information
  * Processing Letters, 31/1, 7--15, 1989.
+ *
+ * </para><para>
+ * This function stores the distances of all vertex pairs, so it needs
+ * quadratic memory. For large graphs use \ref
+ * igraph_layout_sparse_stress() instead.
  * \param graph A graph object.
  * \param res Pointer to an initialized matrix object. This will
  *        contain the result (x-positions in column zero and
@@ -0,0 +1,414 @@
+/* -*- mode: C -*-  */
+/* vim:set ts=2 sw=2 sts=2 et: */
+/*
+   IGraph library.
+   Copyright (C) 2014  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#include "igraph_layout.h"
+#include "igraph_interface.h"
+#include "igraph_constructors.h"
+#include "igraph_adjlist.h"
+#include "igraph_random.h"
+#include "igraph_memory.h"
+#include "igraph_interrupt_internal.h"
+
+#include <math.h>
+
+/*
+ * A level of the multilevel layout: the graph is coarsened into
+ * 'coarse', 'group' gives the coarse vertex of every vertex of the
+ * finer level. The weights are the summed weights of the collapsed
+ * edges, the masses are the numbers of original vertices.
+ */
+
+typedef struct igraph_i_layout_ml_level_t {
+  igraph_t coarse;
+  igraph_vector_t weights;
+  igraph_vector_t mass;
+  igraph_vector_long_t group;
+} igraph_i_layout_ml_level_t;
+
+static void igraph_i_layout_ml_levels_destroy(igraph_vector_ptr_t *levels) {
+  long int i, n=igraph_vector_ptr_size(levels);
+  for (i=0; i<n; i++) {
+    igraph_i_layout_ml_level_t *level=VECTOR(*levels)[i];
+    igraph_destroy(&level->coarse);
+    igraph_vector_destroy(&level->weights);
+    igraph_vector_destroy(&level->mass);
+    igraph_vector_long_destroy(&level->group);
+    igraph_Free(level);
+  }
+  igraph_vector_ptr_destroy(levels);
+}
+
+/*
+ * Collapses a matching of the graph. The vertices are visited in
+ * random order, and every unmatched vertex is matched to the unmatched
+ * neighbor with the heaviest edge, relative to the masses of the two
+ * vertices, so that the coarse vertices stay balanced. A vertex that
+ * remains unmatched has only matched neighbors, it joins the lightest
+ * of their groups, relative to the edge weight; otherwise stars and
+ * similar structures would hardly shrink.
+ */
+
+static int igraph_i_layout_ml_group(const igraph_t *graph,
+                                    const igraph_vector_t *weights,
+                                    const igraph_vector_t *mass,
+                                    igraph_vector_long_t *group,
+                                    long int *no_groups) {
+  long int no_of_nodes=igraph_vcount(graph);
+  long int i, j, ng=0;
+  igraph_inclist_t inclist;
+  igraph_vector_t perm, gmass;
+
+  IGRAPH_CHECK(igraph_inclist_init(graph, &inclist, IGRAPH_ALL));
+  IGRAPH_FINALLY(igraph_inclist_destroy, &inclist);
+  IGRAPH_CHECK(igraph_vector_init_seq(&perm, 0, no_of_nodes - 1));
+  IGRAPH_FINALLY(igraph_vector_destroy, &perm);
+  IGRAPH_CHECK(igraph_vector_shuffle(&perm));
+  IGRAPH_VECTOR_INIT_FINALLY(&gmass, 0);
+  IGRAPH_CHECK(igraph_vector_long_resize(group, no_of_nodes));
+  igraph_vector_long_fill(group, -1);
+
+  for (i=0; i<no_of_nodes; i++) {
+    long int v=VECTOR(perm)[i], best=-1;
+    igraph_vector_int_t *incs=igraph_inclist_get(&inclist, v);
+    long int n=igraph_vector_int_size(incs);
+    igraph_real_t bestscore=0;
+    if (VECTOR(*group)[v] >= 0) { continue; }
+    for (j=0; j<n; j++) {
+      long int e=VECTOR(*incs)[j], u=IGRAPH_OTHER(graph, e, v);
+      igraph_real_t score;
+      if (u == v || VECTOR(*group)[u] >= 0) { continue; }
+      score=(weights ? VECTOR(*weights)[e] : 1.0) / VECTOR(*mass)[u];
+      if (score > bestscore) { best=u; bestscore=score; }
+    }
+    if (best >= 0) {
+      VECTOR(*group)[v] = VECTOR(*group)[best] = ng++;
+      IGRAPH_CHECK(igraph_vector_push_back(&gmass, VECTOR(*mass)[v] +
+                                           VECTOR(*mass)[best]));
+    }
+  }
+
+  for (i=0; i<no_of_nodes; i++) {
+    long int v=VECTOR(perm)[i], best=-1;
+    igraph_vector_int_t *incs=igraph_inclist_get(&inclist, v);
+    long int n=igraph_vector_int_size(incs);
+    igraph_real_t bestscore=0;
+    if (VECTOR(*group)[v] >= 0) { continue; }
+    for (j=0; j<n; j++) {
+      long int e=VECTOR(*incs)[j], u=IGRAPH_OTHER(graph, e, v);
+      igraph_real_t score;
+      if (u == v || VECTOR(*group)[u] < 0) { continue; }
+      score=(weights ? VECTOR(*weights)[e] : 1.0) /
+        VECTOR(gmass)[VECTOR(*group)[u]];
+      if (score > bestscore) { best=u; bestscore=score; }
+    }
+    if (best >= 0) {
+      VECTOR(*group)[v]=VECTOR(*group)[best];
+      VECTOR(gmass)[VECTOR(*group)[v]] += VECTOR(*mass)[v];
+    } else {
+      /* isolated vertex, or only self-loops */
+      VECTOR(*group)[v]=ng++;
+      IGRAPH_CHECK(igraph_vector_push_back(&gmass, VECTOR(*mass)[v]));
+    }
+  }
+
+  *no_groups=ng;
+
+  igraph_vector_destroy(&gmass);
+  igraph_vector_destroy(&perm);
+  igraph_inclist_destroy(&inclist);
+  IGRAPH_FINALLY_CLEAN(3);
+  return 0;
+}
+
+/* Creates the coarse graph of a grouping, multiple edges are merged
+   and their weights are summed, edges within a group are dropped */
+
+static int igraph_i_layout_ml_collapse(const igraph_t *graph,
+                                       const igraph_vector_t *weights,
+                                       const igraph_vector_t *mass,
+                                       const igraph_vector_long_t *group,
+                                       long int no_groups,
+                                       igraph_t *coarse,
+                                       igraph_vector_t *cweights,
+                                       igraph_vector_t *cmass) {
+  long int no_of_nodes=igraph_vcount(graph);
+  long int i, j, c;
+  igraph_inclist_t inclist;
+  igraph_vector_long_t cstart, cverts, mark, pos;
+  igraph_vector_t edges;
+
+  IGRAPH_CHECK(igraph_inclist_init(graph, &inclist, IGRAPH_ALL));
+  IGRAPH_FINALLY(igraph_inclist_destroy, &inclist);
+  IGRAPH_CHECK(igraph_vector_long_init(&cstart, no_groups + 1));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &cstart);
+  IGRAPH_CHECK(igraph_vector_long_init(&cverts, no_of_nodes));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &cverts);
+  IGRAPH_CHECK(igraph_vector_long_init(&mark, no_groups));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &mark);
+  IGRAPH_CHECK(igraph_vector_long_init(&pos, no_groups));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &pos);
+  IGRAPH_VECTOR_INIT_FINALLY(&edges, 0);
+
+  /* the members of the groups, by counting sort */
+  IGRAPH_CHECK(igraph_vector_resize(cmass, no_groups));
+  igraph_vector_null(cmass);
+  for (i=0; i<no_of_nodes; i++) {
+    VECTOR(cstart)[VECTOR(*group)[i] + 1] += 1;
+    VECTOR(*cmass)[VECTOR(*group)[i]] += VECTOR(*mass)[i];
+  }
+  for (c=0; c<no_groups; c++) {
+    VECTOR(cstart)[c + 1] += VECTOR(cstart)[c];
+  }
+  for (i=0; i<no_of_nodes; i++) {
+    VECTOR(cverts)[VECTOR(cstart)[VECTOR(*group)[i]]++]=i;
+  }
+  for (c=no_groups; c>0; c--) {
+    VECTOR(cstart)[c]=VECTOR(cstart)[c - 1];
+  }
+  VECTOR(cstart)[0]=0;
+
+  /* every coarse edge is created from its smaller endpoint */
+  igraph_vector_clear(cweights);
+  for (c=0; c<no_groups; c++) {
+    for (i=VECTOR(cstart)[c]; i<VECTOR(cstart)[c + 1]; i++) {
+      long int v=VECTOR(cverts)[i];
+      igraph_vector_int_t *incs=igraph_inclist_get(&inclist, v);
+      long int n=igraph_vector_int_size(incs);
+      for (j=0; j<n; j++) {
+        long int e=VECTOR(*incs)[j];
+        long int g=VECTOR(*group)[IGRAPH_OTHER(graph, e, v)];
+        igraph_real_t w=weights ? VECTOR(*weights)[e] : 1.0;
+        if (g <= c) { continue; }
+        if (VECTOR(mark)[g] != c + 1) {
+          VECTOR(mark)[g]=c + 1;
+          VECTOR(pos)[g]=igraph_vector_size(cweights);
+          IGRAPH_CHECK(igraph_vector_push_back(&edges, c));
+          IGRAPH_CHECK(igraph_vector_push_back(&edges, g));
+          IGRAPH_CHECK(igraph_vector_push_back(cweights, w));
+        } else {
+          VECTOR(*cweights)[VECTOR(pos)[g]] += w;
+        }
+      }
+    }
+  }
+
+  IGRAPH_CHECK(igraph_create(coarse, &edges, (igraph_integer_t) no_groups,
+                             IGRAPH_UNDIRECTED));
+
+  igraph_vector_destroy(&edges);
+  igraph_vector_long_destroy(&pos);
+  igraph_vector_long_destroy(&mark);
+  igraph_vector_long_destroy(&cverts);
+  igraph_vector_long_destroy(&cstart);
+  igraph_inclist_destroy(&inclist);
+  IGRAPH_FINALLY_CLEAN(6);
+  return 0;
+}
+
+static int igraph_i_layout_ml_fr(const igraph_t *graph, igraph_matrix_t *res,
+                                 igraph_bool_t use_seed, long int dim,
+                                 igraph_integer_t niter,
+                                 igraph_real_t start_temp, igraph_real_t theta,
+                                 const igraph_vector_t *weights) {
+  if (dim == 2) {
+    return igraph_layout_fruchterman_reingold_bh(graph, res, use_seed, niter,
+        start_temp, theta, weights, 0, 0, 0, 0, 0);
+  } else {
+    return igraph_layout_fruchterman_reingold_3d_bh(graph, res, use_seed,
+        niter, start_temp, theta, weights, 0, 0, 0, 0, 0, 0, 0);
+  }
+}
+
+/**
+ * \function igraph_layout_multilevel
+ * \brief Multilevel force-directed layout.
+ *
+ * </para><para>
+ * The graph is coarsened repeatedly, by collapsing a heavy edge
+ * matching of its vertices, until it has at most \p min_size
+ * vertices, or until it does not shrink considerably any more. The
+ * smallest graph is laid out with the Barnes-Hut version of the
+ * Fruchterman-Reingold algorithm, see \ref
+ * igraph_layout_fruchterman_reingold_bh(). Then the positions are
+ * prolonged to the next finer level: every vertex starts from the
+ * position of its coarse vertex, and the layout of the finer level is
+ * refined with the same algorithm, with a lower temperature. As every
+ * level is about half as large as the previous one, the total work is
+ * only about twice the work on the original graph, but the refinement
+ * needs much fewer iterations than a layout from scratch. See
+ * Hachul, S. and Juenger, M.: Drawing Large Graphs with a
+ * Potential-Field-Based Multilevel Algorithm. Graph Drawing 2004,
+ * LNCS 3383, 285--295, 2005.
+ *
+ * </para><para>
+ * Edge directions are ignored.
+ *
+ * \param graph The input graph.
+ * \param res Pointer to an initialized matrix, the result is stored
+ *        here, it will be resized as needed.
+ * \param dim The number of dimensions, 2 or 3.
+ * \param niter The number of Fruchterman-Reingold iterations on each
+ *        level. 100 is usually enough, as the levels start from the
+ *        layout of the coarser level.
+ * \param min_size The coarsening stops at this number of vertices. The
+ *        coarsest graph should be small enough to be laid out well
+ *        from a random start, e.g. 50.
+ * \param theta The accuracy of the Barnes-Hut approximation, see \ref
+ *        igraph_layout_fruchterman_reingold_bh().
+ * \param weights Edge weights, the attraction along the edges is
+ *        multiplied by them, and heavier edges are collapsed first.
+ *        Supply a null pointer here for unweighted graphs.
+ * \return Error code.
+ *
+ * Time complexity: O(niter (|V| log |V| + |E|)) for a not too uneven
+ * distribution of the vertices, as in \ref
+ * igraph_layout_fruchterman_reingold_bh().
+ */
+
+int igraph_layout_multilevel(const igraph_t *graph, igraph_matrix_t *res,
+                             igraph_integer_t dim, igraph_integer_t niter,
+                             igraph_integer_t min_size, igraph_real_t theta,
+                             const igraph_vector_t *weights) {
+
+  long int no_of_nodes=igraph_vcount(graph);
+  igraph_vector_ptr_t levels;
+  igraph_vector_t mass;
+  igraph_matrix_t coarse_res;
+  const igraph_t *g=graph;
+  const igraph_vector_t *w=weights;
+  const igraph_vector_t *m;
+  long int i, k, l;
+
+  if (dim != 2 && dim != 3) {
+    IGRAPH_ERROR("Multilevel layout is only implemented in 2 and 3 "
+                 "dimensions", IGRAPH_EINVAL);
+  }
+  if (niter < 0) {
+    IGRAPH_ERROR("Number of iterations must be non-negative in "
+                 "multilevel layout", IGRAPH_EINVAL);
+  }
+  if (min_size < 1) {
+    IGRAPH_ERROR("Minimum size must be positive in multilevel layout",
+                 IGRAPH_EINVAL);
+  }
+  if (weights && igraph_vector_size(weights) != igraph_ecount(graph)) {
+    IGRAPH_ERROR("Invalid weight vector length", IGRAPH_EINVAL);
+  }
+  if (weights && igraph_vector_size(weights) > 0 &&
+      igraph_vector_min(weights) <= 0) {
+    IGRAPH_ERROR("Weights must be positive in multilevel layout",
+                 IGRAPH_EINVAL);
+  }
+
+  IGRAPH_CHECK(igraph_vector_ptr_init(&levels, 0));
+  IGRAPH_FINALLY(igraph_i_layout_ml_levels_destroy, &levels);
+  IGRAPH_VECTOR_INIT_FINALLY(&mass, no_of_nodes);
+  igraph_vector_fill(&mass, 1.0);
+  m=&mass;
+
+  /* coarsening */
+  RNG_BEGIN();
+  while (igraph_vcount(g) > min_size) {
+    igraph_i_layout_ml_level_t *level;
+    long int no_groups;
+
+    IGRAPH_ALLOW_INTERRUPTION();
+
+    level=igraph_Calloc(1, igraph_i_layout_ml_level_t);
+    if (!level) {
+      IGRAPH_ERROR("Cannot coarsen graph for multilevel layout",
+                   IGRAPH_ENOMEM);
+    }
+    IGRAPH_FINALLY(igraph_free, level);
+    IGRAPH_CHECK(igraph_vector_long_init(&level->group, 0));
+    IGRAPH_FINALLY(igraph_vector_long_destroy, &level->group);
+    IGRAPH_CHECK(igraph_i_layout_ml_group(g, w, m, &level->group,
+                                          &no_groups));
+    if (no_groups > 0.9 * igraph_vcount(g)) {
+      /* hardly shrinks, stop here */
+      igraph_vector_long_destroy(&level->group);
+      igraph_Free(level);
+      IGRAPH_FINALLY_CLEAN(2);
+      break;
+    }
+    IGRAPH_VECTOR_INIT_FINALLY(&level->weights, 0);
+    IGRAPH_VECTOR_INIT_FINALLY(&level->mass, 0);
+    IGRAPH_CHECK(igraph_i_layout_ml_collapse(g, w, m, &level->group,
+                                             no_groups, &level->coarse,
+                                             &level->weights, &level->mass));
+    IGRAPH_FINALLY(igraph_destroy, &level->coarse);
+    IGRAPH_CHECK(igraph_vector_ptr_push_back(&levels, level));
+    IGRAPH_FINALLY_CLEAN(5);
+
+    g=&level->coarse;
+    w=&level->weights;
+    m=&level->mass;
+  }
+
+  /* the coarsest level, from a random layout */
+  IGRAPH_CHECK(igraph_i_layout_ml_fr(g, res, 0, dim, niter,
+                                     sqrt(igraph_vcount(g)), theta, w));
+
+  /* prolongation and refinement */
+  IGRAPH_CHECK(igraph_matrix_init(&coarse_res, 0, 0));
+  IGRAPH_FINALLY(igraph_matrix_destroy, &coarse_res);
+  for (l=igraph_vector_ptr_size(&levels) - 1; l >= 0; l--) {
+    igraph_i_layout_ml_level_t *level=VECTOR(levels)[l];
+    long int no_fine=igraph_vector_long_size(&level->group);
+    long int no_coarse=igraph_vcount(&level->coarse);
+    /* keep the density of the vertices */
+    igraph_real_t scale=pow((double) no_fine / no_coarse, 1.0 / dim);
+
+    IGRAPH_ALLOW_INTERRUPTION();
+
+    IGRAPH_CHECK(igraph_matrix_update(&coarse_res, res));
+    IGRAPH_CHECK(igraph_matrix_resize(res, no_fine, dim));
+    for (i=0; i<no_fine; i++) {
+      long int c=VECTOR(level->group)[i];
+      for (k=0; k<dim; k++) {
+        MATRIX(*res, i, k)=MATRIX(coarse_res, c, k) * scale +
+          RNG_UNIF(-0.5, 0.5);
+      }
+    }
+
+    if (l > 0) {
+      igraph_i_layout_ml_level_t *finer=VECTOR(levels)[l - 1];
+      g=&finer->coarse;
+      w=&finer->weights;
+    } else {
+      g=graph;
+      w=weights;
+    }
+    IGRAPH_CHECK(igraph_i_layout_ml_fr(g, res, 1, dim, niter,
+                                       sqrt(scale * scale + 1.0), theta, w));
+  }
+  RNG_END();
+
+  igraph_matrix_destroy(&coarse_res);
+  igraph_vector_destroy(&mass);
+  igraph_i_layout_ml_levels_destroy(&levels);
+  IGRAPH_FINALLY_CLEAN(3);
+
+  return 0;
+}
@@ -0,0 +1,536 @@
+/* -*- mode: C -*-  */
+/* vim:set ts=2 sw=2 sts=2 et: */
+/*
+   IGraph library.
+   Copyright (C) 2014  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#include "igraph_layout.h"
+#include "igraph_interface.h"
+#include "igraph_paths.h"
+#include "igraph_sparsemat.h"
+#include "igraph_random.h"
+#include "igraph_memory.h"
+#include "igraph_interrupt_internal.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#define IGRAPH_I_LAYOUT_STRESS_CG_MAXITER 100
+#define IGRAPH_I_LAYOUT_STRESS_CG_TOL 1e-4
+
+/*
+ * The terms of the sparse stress model: pair 'i' wants vertices
+ * from[i] and to[i] at distance dist[i], with weight weight[i]. These
+ * are the edges, and the pairs of the vertices and the pivots.
+ */
+
+typedef struct igraph_i_layout_stress_terms_t {
+  igraph_vector_int_t from, to;
+  igraph_vector_t dist, weight;
+} igraph_i_layout_stress_terms_t;
+
+static void igraph_i_layout_stress_terms_destroy(
+		       igraph_i_layout_stress_terms_t *terms) {
+  igraph_vector_int_destroy(&terms->from);
+  igraph_vector_int_destroy(&terms->to);
+  igraph_vector_destroy(&terms->dist);
+  igraph_vector_destroy(&terms->weight);
+}
+
+static int igraph_i_layout_stress_cmp(const void *a, const void *b) {
+  igraph_real_t da=*(const igraph_real_t *) a, db=*(const igraph_real_t *) b;
+  return da < db ? -1 : (da > db ? 1 : 0);
+}
+
+/*
+ * Chooses the pivots by max-min sampling: the first one is random,
+ * every further pivot is the vertex farthest from the pivots chosen so
+ * far, so every component gets a pivot before the second pivot of a
+ * component is chosen. Column 'p' of 'dist' is the distance of the
+ * vertices from pivot 'p', infinite distances are replaced by the
+ * largest finite one, like in the Kamada-Kawai layout.
+ */
+
+static int igraph_i_layout_stress_pivots(const igraph_t *graph,
+					 const igraph_vector_t *weights,
+					 long int no_of_pivots,
+					 igraph_vector_long_t *pivots,
+					 igraph_matrix_t *dist) {
+  long int no_of_nodes=igraph_vcount(graph);
+  long int i, p, next;
+  igraph_vector_t mindist;
+  igraph_matrix_t row;
+  igraph_real_t maxdist=0;
+
+  IGRAPH_CHECK(igraph_vector_long_resize(pivots, no_of_pivots));
+  IGRAPH_CHECK(igraph_matrix_resize(dist, no_of_nodes, no_of_pivots));
+  IGRAPH_VECTOR_INIT_FINALLY(&mindist, no_of_nodes);
+  igraph_vector_fill(&mindist, IGRAPH_INFINITY);
+  IGRAPH_MATRIX_INIT_FINALLY(&row, 1, no_of_nodes);
+
+  RNG_BEGIN();
+  next=RNG_INTEGER(0, no_of_nodes-1);
+  RNG_END();
+
+  for (p=0; p<no_of_pivots; p++) {
+    VECTOR(*pivots)[p]=next;
+    IGRAPH_CHECK(igraph_shortest_paths_dijkstra(graph, &row,
+						igraph_vss_1(next),
+						igraph_vss_all(), weights,
+						IGRAPH_ALL));
+    for (i=0; i<no_of_nodes; i++) {
+      igraph_real_t d=MATRIX(row, 0, i);
+      MATRIX(*dist, i, p)=d;
+      if (d < VECTOR(mindist)[i]) { VECTOR(mindist)[i]=d; }
+      if (igraph_finite(d) && d > maxdist) { maxdist=d; }
+    }
+    next=igraph_vector_which_max(&mindist);
+    IGRAPH_ALLOW_INTERRUPTION();
+  }
+
+  if (maxdist == 0) { maxdist=1; }
+  for (p=0; p<no_of_pivots; p++) {
+    for (i=0; i<no_of_nodes; i++) {
+      if (!igraph_finite(MATRIX(*dist, i, p))) {
+	MATRIX(*dist, i, p)=maxdist;
+      }
+    }
+  }
+
+  igraph_matrix_destroy(&row);
+  igraph_vector_destroy(&mindist);
+  IGRAPH_FINALLY_CLEAN(2);
+
+  return 0;
+}
+
+/*
+ * The stress terms, following Ortmann, Klimenta and Brandes: every
+ * edge is a term, and every vertex 'u' has a term with every pivot
+ * 'p'. The latter stands for the vertices close to 'p', so its weight
+ * is multiplied by the number of vertices in the region of 'p' (the
+ * vertices closest to 'p' among the pivots) that are not farther from
+ * 'p' than half of the distance of 'u'.
+ */
+
+static int igraph_i_layout_stress_terms(const igraph_t *graph,
+					const igraph_vector_t *weights,
+					const igraph_vector_long_t *pivots,
+					const igraph_matrix_t *dist,
+					igraph_i_layout_stress_terms_t *terms) {
+  long int no_of_nodes=igraph_vcount(graph);
+  long int no_of_edges=igraph_ecount(graph);
+  long int no_of_pivots=igraph_vector_long_size(pivots);
+  long int i, p, u;
+  igraph_vector_long_t region, offsets;
+  igraph_vector_t regdist;
+
+  IGRAPH_CHECK(igraph_vector_int_reserve(&terms->from, no_of_edges +
+					 no_of_nodes * no_of_pivots));
+  IGRAPH_CHECK(igraph_vector_int_reserve(&terms->to, no_of_edges +
+					 no_of_nodes * no_of_pivots));
+  IGRAPH_CHECK(igraph_vector_reserve(&terms->dist, no_of_edges +
+				     no_of_nodes * no_of_pivots));
+  IGRAPH_CHECK(igraph_vector_reserve(&terms->weight, no_of_edges +
+				     no_of_nodes * no_of_pivots));
+
+  for (i=0; i<no_of_edges; i++) {
+    long int from=IGRAPH_FROM(graph, i), to=IGRAPH_TO(graph, i);
+    igraph_real_t d=weights ? VECTOR(*weights)[i] : 1.0;
+    if (from == to) { continue; }
+    igraph_vector_int_push_back(&terms->from, (int) from);
+    igraph_vector_int_push_back(&terms->to, (int) to);
+    igraph_vector_push_back(&terms->dist, d);
+    igraph_vector_push_back(&terms->weight, 1.0 / (d * d));
+  }
+
+  /* The regions of the pivots, and the sorted distances in them */
+  IGRAPH_CHECK(igraph_vector_long_init(&region, no_of_nodes));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &region);
+  IGRAPH_CHECK(igraph_vector_long_init(&offsets, no_of_pivots+1));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &offsets);
+  IGRAPH_VECTOR_INIT_FINALLY(&regdist, no_of_nodes);
+  for (u=0; u<no_of_nodes; u++) {
+    long int nearest=0;
+    for (p=1; p<no_of_pivots; p++) {
+      if (MATRIX(*dist, u, p) < MATRIX(*dist, u, nearest)) { nearest=p; }
+    }
+    VECTOR(region)[u]=nearest;
+    VECTOR(offsets)[nearest+1] += 1;
+  }
+  for (p=0; p<no_of_pivots; p++) {
+    VECTOR(offsets)[p+1] += VECTOR(offsets)[p];
+  }
+  for (u=0; u<no_of_nodes; u++) {
+    long int r=VECTOR(region)[u];
+    VECTOR(regdist)[ VECTOR(offsets)[r]++ ]=MATRIX(*dist, u, r);
+  }
+  for (p=no_of_pivots; p>0; p--) {
+    VECTOR(offsets)[p]=VECTOR(offsets)[p-1];
+  }
+  VECTOR(offsets)[0]=0;
+  for (p=0; p<no_of_pivots; p++) {
+    qsort(VECTOR(regdist)+VECTOR(offsets)[p],
+	  (size_t) (VECTOR(offsets)[p+1]-VECTOR(offsets)[p]),
+	  sizeof(igraph_real_t), igraph_i_layout_stress_cmp);
+  }
+
+  for (p=0; p<no_of_pivots; p++) {
+    long int pivot=VECTOR(*pivots)[p];
+    const igraph_real_t *rd=VECTOR(regdist)+VECTOR(offsets)[p];
+    long int size=VECTOR(offsets)[p+1]-VECTOR(offsets)[p];
+    for (u=0; u<no_of_nodes; u++) {
+      igraph_real_t d=MATRIX(*dist, u, p), half=d/2;
+      long int lo=0, hi=size;
+      if (u == pivot) { continue; }
+      /* number of region distances not larger than d/2 */
+      while (lo < hi) {
+	long int mid=(lo+hi)/2;
+	if (rd[mid] <= half) { lo=mid+1; } else { hi=mid; }
+      }
+      igraph_vector_int_push_back(&terms->from, (int) u);
+      igraph_vector_int_push_back(&terms->to, (int) pivot);
+      igraph_vector_push_back(&terms->dist, d);
+      igraph_vector_push_back(&terms->weight, lo / (d * d));
+    }
+  }
+
+  igraph_vector_destroy(&regdist);
+  igraph_vector_long_destroy(&offsets);
+  igraph_vector_long_destroy(&region);
+  IGRAPH_FINALLY_CLEAN(3);
+
+  return 0;
+}
+
+/*
+ * The weighted Laplacian of the terms, in column-compressed format,
+ * and its diagonal, for the preconditioner.
+ */
+
+static int igraph_i_layout_stress_laplacian(long int no_of_nodes,
+				    const igraph_i_layout_stress_terms_t *terms,
+				    igraph_sparsemat_t *laplacian,
+				    igraph_vector_t *diag) {
+  long int no_of_terms=igraph_vector_int_size(&terms->from);
+  long int i;
+  igraph_sparsemat_t triplet;
+
+  IGRAPH_CHECK(igraph_sparsemat_init(&triplet, (int) no_of_nodes,
+				     (int) no_of_nodes,
+				     (int) (2*no_of_terms + no_of_nodes)));
+  IGRAPH_FINALLY(igraph_sparsemat_destroy, &triplet);
+  IGRAPH_CHECK(igraph_vector_resize(diag, no_of_nodes));
+  igraph_vector_null(diag);
+
+  for (i=0; i<no_of_terms; i++) {
+    int from=VECTOR(terms->from)[i], to=VECTOR(terms->to)[i];
+    igraph_real_t w=VECTOR(terms->weight)[i];
+    if (w == 0) { continue; }
+    IGRAPH_CHECK(igraph_sparsemat_entry(&triplet, from, to, -w));
+    IGRAPH_CHECK(igraph_sparsemat_entry(&triplet, to, from, -w));
+    VECTOR(*diag)[from] += w;
+    VECTOR(*diag)[to] += w;
+  }
+  for (i=0; i<no_of_nodes; i++) {
+    IGRAPH_CHECK(igraph_sparsemat_entry(&triplet, (int) i, (int) i,
+					VECTOR(*diag)[i]));
+  }
+
+  IGRAPH_CHECK(igraph_sparsemat_compress(&triplet, laplacian));
+  igraph_sparsemat_destroy(&triplet);
+  IGRAPH_FINALLY_CLEAN(1);
+  IGRAPH_FINALLY(igraph_sparsemat_destroy, laplacian);
+  IGRAPH_CHECK(igraph_sparsemat_dupl(laplacian));
+  IGRAPH_FINALLY_CLEAN(1);
+
+  return 0;
+}
+
+/*
+ * Solves laplacian * x = b with the Jacobi preconditioned conjugate
+ * gradient method, 'x' is the starting point. The Laplacian is
+ * singular, but 'b' sums up to zero, so the system is consistent.
+ * 'r', 'z', 'p' and 'q' are work vectors of the right size.
+ */
+
+static int igraph_i_layout_stress_cg(const igraph_sparsemat_t *laplacian,
+				     const igraph_vector_t *diag,
+				     const igraph_vector_t *b,
+				     igraph_vector_t *x,
+				     igraph_vector_t *r, igraph_vector_t *z,
+				     igraph_vector_t *p, igraph_vector_t *q) {
+  long int n=igraph_vector_size(x);
+  long int i, iter;
+  igraph_real_t rz=0, bnorm=0, rnorm;
+
+  /* r = b - L x */
+  igraph_vector_null(q);
+  IGRAPH_CHECK(igraph_sparsemat_gaxpy(laplacian, x, q));
+  for (i=0; i<n; i++) {
+    igraph_real_t d=VECTOR(*diag)[i];
+    VECTOR(*r)[i]=VECTOR(*b)[i] - VECTOR(*q)[i];
+    VECTOR(*z)[i]=d > 0 ? VECTOR(*r)[i] / d : 0.0;
+    VECTOR(*p)[i]=VECTOR(*z)[i];
+    rz += VECTOR(*r)[i] * VECTOR(*z)[i];
+    bnorm += VECTOR(*b)[i] * VECTOR(*b)[i];
+  }
+  bnorm=sqrt(bnorm);
+
+  for (iter=0; iter<IGRAPH_I_LAYOUT_STRESS_CG_MAXITER; iter++) {
+    igraph_real_t pq=0, alpha, rz_new=0;
+    rnorm=0;
+    for (i=0; i<n; i++) { rnorm += VECTOR(*r)[i] * VECTOR(*r)[i]; }
+    if (rz == 0 || sqrt(rnorm) <= IGRAPH_I_LAYOUT_STRESS_CG_TOL * bnorm) {
+      break;
+    }
+    igraph_vector_null(q);
+    IGRAPH_CHECK(igraph_sparsemat_gaxpy(laplacian, p, q));
+    for (i=0; i<n; i++) { pq += VECTOR(*p)[i] * VECTOR(*q)[i]; }
+    if (pq <= 0) { break; }
+    alpha=rz / pq;
+    for (i=0; i<n; i++) {
+      igraph_real_t d=VECTOR(*diag)[i];
+      VECTOR(*x)[i] += alpha * VECTOR(*p)[i];
+      VECTOR(*r)[i] -= alpha * VECTOR(*q)[i];
+      VECTOR(*z)[i]=d > 0 ? VECTOR(*r)[i] / d : 0.0;
+      rz_new += VECTOR(*r)[i] * VECTOR(*z)[i];
+    }
+    for (i=0; i<n; i++) {
+      VECTOR(*p)[i]=VECTOR(*z)[i] + rz_new / rz * VECTOR(*p)[i];
+    }
+    rz=rz_new;
+  }
+
+  return 0;
+}
+
+/**
+ * \function igraph_layout_sparse_stress
+ * \brief Sparse stress majorization layout, using pivots.
+ *
+ * </para><para>
+ * Stress majorization places the vertices so that their distances in
+ * the layout are close to their graph theoretical distances. The full
+ * model has a term for every pair of vertices, which needs quadratic
+ * time and memory, see \ref igraph_layout_kamada_kawai(). This
+ * function uses the sparse stress model of Ortmann, Klimenta and
+ * Brandes instead: the edges keep their terms, and every vertex has
+ * a term with each of a few pivot vertices only. The terms of a pivot
+ * are weighted by the number of vertices close to the pivot, so they
+ * stand for the omitted terms of these vertices.
+ *
+ * </para><para>
+ * The pivots are chosen by max-min sampling: the first pivot is
+ * random, and each further pivot is the vertex that is the farthest
+ * from the pivots chosen so far. The positions are updated by solving
+ * the linear system of the weighted Laplacian of the terms, with the
+ * conjugate gradient method, separately for each coordinate.
+ *
+ * </para><para>
+ * Infinite distances of disconnected graphs are replaced by the
+ * largest finite distance, as in the Kamada-Kawai layout.
+ *
+ * </para><para>
+ * Reference: Mark Ortmann, Mirza Klimenta and Ulrik Brandes: A Sparse
+ * Stress Model. Graph Drawing and Network Visualization, 2016,
+ * 18--32.
+ *
+ * \param graph The input graph, edge directions are ignored.
+ * \param res Pointer to an initialized matrix, the result is stored
+ *        here, one row for each vertex and one column for each
+ *        coordinate. It is resized as needed.
+ * \param use_seed Boolean, whether to start from the positions given
+ *        in \p res. If false, the vertices are placed randomly
+ *        first.
+ * \param dim The dimension of the layout, 2 or 3.
+ * \param pivots The number of pivots, a positive integer. If it is
+ *        larger than the number of vertices, all vertices are pivots;
+ *        this approximates the full stress model, but the terms of
+ *        the edges and of the pivot pairs are still counted
+ *        separately, so it is not identical to it. 50 to 200 pivots
+ *        are usually enough.
+ * \param maxiter The maximum number of majorization steps.
+ * \param epsilon Stop if the stress decreased less than this in a
+ *        step, relative to its value. Zero means that \p maxiter
+ *        steps are performed.
+ * \param weights Edge lengths, positive numbers, or a null pointer,
+ *        then all edges have unit length.
+ * \return Error code.
+ *
+ * Time complexity: O(p (|E| + |V| log|V|)) to choose the pivots and
+ * calculate the distances from them, and O(c (|E| + p |V|)) for each
+ * step, where p is the number of pivots and c is the number of
+ * conjugate gradient iterations, at most 100. The memory usage is
+ * O(|E| + p |V|).
+ */
+
+int igraph_layout_sparse_stress(const igraph_t *graph, igraph_matrix_t *res,
+				igraph_bool_t use_seed, igraph_integer_t dim,
+				igraph_integer_t pivots,
+				igraph_integer_t maxiter,
+				igraph_real_t epsilon,
+				const igraph_vector_t *weights) {
+  long int no_of_nodes=igraph_vcount(graph);
+  long int no_of_edges=igraph_ecount(graph);
+  long int no_of_pivots, no_of_terms, i, j, iter;
+  igraph_vector_long_t pivot_ids;
+  igraph_matrix_t dist;
+  igraph_i_layout_stress_terms_t terms;
+  igraph_sparsemat_t laplacian;
+  igraph_vector_t diag, x, b, r, z, p, q;
+  igraph_matrix_t rhs;
+  igraph_real_t stress, prev_stress=IGRAPH_INFINITY;
+
+  if (dim != 2 && dim != 3) {
+    IGRAPH_ERROR("Dimension must be 2 or 3 in sparse stress layout",
+		 IGRAPH_EINVAL);
+  }
+  if (pivots < 1) {
+    IGRAPH_ERROR("Number of pivots must be positive in sparse stress "
+		 "layout", IGRAPH_EINVAL);
+  }
+  if (maxiter < 0) {
+    IGRAPH_ERROR("Number of iterations must be non-negative in sparse "
+		 "stress layout", IGRAPH_EINVAL);
+  }
+  if (use_seed && (igraph_matrix_nrow(res) != no_of_nodes ||
+		   igraph_matrix_ncol(res) != dim)) {
+    IGRAPH_ERROR("Invalid start position matrix size in sparse stress "
+		 "layout", IGRAPH_EINVAL);
+  }
+  if (weights && igraph_vector_size(weights) != no_of_edges) {
+    IGRAPH_ERROR("Invalid weight vector length", IGRAPH_EINVAL);
+  }
+  if (weights && no_of_edges > 0 && igraph_vector_min(weights) <= 0) {
+    IGRAPH_ERROR("Weights must be positive in sparse stress layout",
+		 IGRAPH_EINVAL);
+  }
+
+  if (!use_seed) {
+    IGRAPH_CHECK(igraph_matrix_resize(res, no_of_nodes, dim));
+    igraph_matrix_null(res);
+  }
+  if (no_of_nodes <= 1) { return 0; }
+
+  no_of_pivots= pivots < no_of_nodes ? pivots : no_of_nodes;
+  IGRAPH_CHECK(igraph_vector_long_init(&pivot_ids, 0));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &pivot_ids);
+  IGRAPH_MATRIX_INIT_FINALLY(&dist, 0, 0);
+  IGRAPH_CHECK(igraph_i_layout_stress_pivots(graph, weights, no_of_pivots,
+					     &pivot_ids, &dist));
+
+  if (!use_seed) {
+    igraph_real_t size=igraph_matrix_max(&dist);
+    RNG_BEGIN();
+    for (i=0; i<no_of_nodes; i++) {
+      for (j=0; j<dim; j++) {
+	MATRIX(*res, i, j)=RNG_UNIF(-size/2, size/2);
+      }
+    }
+    RNG_END();
+  }
+
+  IGRAPH_CHECK(igraph_vector_int_init(&terms.from, 0));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &terms.from);
+  IGRAPH_CHECK(igraph_vector_int_init(&terms.to, 0));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &terms.to);
+  IGRAPH_VECTOR_INIT_FINALLY(&terms.dist, 0);
+  IGRAPH_VECTOR_INIT_FINALLY(&terms.weight, 0);
+  IGRAPH_FINALLY_CLEAN(4);
+  IGRAPH_FINALLY(igraph_i_layout_stress_terms_destroy, &terms);
+  IGRAPH_CHECK(igraph_i_layout_stress_terms(graph, weights, &pivot_ids,
+					    &dist, &terms));
+  no_of_terms=igraph_vector_int_size(&terms.from);
+
+  /* The distances are not needed any more, only the terms */
+  igraph_matrix_destroy(&dist);
+  igraph_vector_long_destroy(&pivot_ids);
+  IGRAPH_FINALLY_CLEAN(3);
+  IGRAPH_FINALLY(igraph_i_layout_stress_terms_destroy, &terms);
+
+  IGRAPH_VECTOR_INIT_FINALLY(&diag, no_of_nodes);
+  IGRAPH_CHECK(igraph_i_layout_stress_laplacian(no_of_nodes, &terms,
+						&laplacian, &diag));
+  IGRAPH_FINALLY(igraph_sparsemat_destroy, &laplacian);
+
+  IGRAPH_MATRIX_INIT_FINALLY(&rhs, no_of_nodes, dim);
+  IGRAPH_VECTOR_INIT_FINALLY(&x, no_of_nodes);
+  IGRAPH_VECTOR_INIT_FINALLY(&b, no_of_nodes);
+  IGRAPH_VECTOR_INIT_FINALLY(&r, no_of_nodes);
+  IGRAPH_VECTOR_INIT_FINALLY(&z, no_of_nodes);
+  IGRAPH_VECTOR_INIT_FINALLY(&p, no_of_nodes);
+  IGRAPH_VECTOR_INIT_FINALLY(&q, no_of_nodes);
+
+  for (iter=0; iter<maxiter; iter++) {
+
+    /* The right hand side of the majorization step, and the stress of
+       the current layout */
+    igraph_matrix_null(&rhs);
+    stress=0;
+    for (i=0; i<no_of_terms; i++) {
+      long int from=VECTOR(terms.from)[i], to=VECTOR(terms.to)[i];
+      igraph_real_t w=VECTOR(terms.weight)[i], d=VECTOR(terms.dist)[i];
+      igraph_real_t diff[3], len=0, c;
+      for (j=0; j<dim; j++) {
+	diff[j]=MATRIX(*res, from, j) - MATRIX(*res, to, j);
+	len += diff[j] * diff[j];
+      }
+      len=sqrt(len);
+      stress += w * (len - d) * (len - d);
+      if (len == 0) { continue; }
+      c=w * d / len;
+      for (j=0; j<dim; j++) {
+	MATRIX(rhs, from, j) += c * diff[j];
+	MATRIX(rhs, to, j) -= c * diff[j];
+      }
+    }
+
+    if (epsilon > 0 && prev_stress - stress < epsilon * prev_stress) {
+      break;
+    }
+    prev_stress=stress;
+
+    for (j=0; j<dim; j++) {
+      IGRAPH_CHECK(igraph_matrix_get_col(res, &x, j));
+      IGRAPH_CHECK(igraph_matrix_get_col(&rhs, &b, j));
+      IGRAPH_CHECK(igraph_i_layout_stress_cg(&laplacian, &diag, &b, &x,
+					     &r, &z, &p, &q));
+      IGRAPH_CHECK(igraph_matrix_set_col(res, &x, j));
+    }
+
+    IGRAPH_ALLOW_INTERRUPTION();
+  }
+
+  igraph_vector_destroy(&q);
+  igraph_vector_destroy(&p);
+  igraph_vector_destroy(&z);
+  igraph_vector_destroy(&r);
+  igraph_vector_destroy(&b);
+  igraph_vector_destroy(&x);
+  igraph_matrix_destroy(&rhs);
+  igraph_sparsemat_destroy(&laplacian);
+  igraph_vector_destroy(&diag);
+  igraph_i_layout_stress_terms_destroy(&terms);
+  IGRAPH_FINALLY_CLEAN(10);
+
+  return 0;
+}
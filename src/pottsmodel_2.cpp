@@ -56,12 +56,14 @@ using namespace std;
 #include "config.h"
 
 //#################################################################################################
-PottsModel::PottsModel(network *n, unsigned int qvalue, int m) : acceptance(0)
+PottsModel::PottsModel(network *n, unsigned int qvalue, int m,
+		       igraph_rng_t *r) : acceptance(0)
 {
   DLList_Iter<NNode*> iter;
   NNode *n_cur;
-  unsigned int *i_ptr;
+  unsigned long i, k, num_of_entries;
   net=n;
+  rng=r ? r : igraph_rng_default();
   q=qvalue;
   operation_mode=m;
   k_max=0;
@@ -75,20 +77,39 @@ PottsModel::PottsModel(network *n, unsigned int qvalue, int m) : acceptance(0)
 
   num_of_nodes=net->node_list->Size();
   num_of_links=net->link_list->Size();
-  
+
+  //the adjacency as flat arrays, the Monte Carlo process does not
+  //touch the linked lists of the network, so several models can
+  //work on the same network at the same time
+  num_of_entries=2*num_of_links;
+  link_start =new unsigned long[num_of_nodes+1];
+  link_nei   =new unsigned long[num_of_entries];
+  link_weight=new double[num_of_entries];
+  node_weight=new double[num_of_nodes];
+  spin       =new unsigned int[num_of_nodes];
+  igraph_i_network_adjacency(net, link_start, link_nei, link_weight, 0);
+
+  //these arrays are needed to keep track of spin states for parallel update mode
+  new_spins=new unsigned int[num_of_nodes];
+  previous_spins=new unsigned int[num_of_nodes];
+  for (i=0; i<num_of_nodes; i++)
+  {
+    if (k_max<link_start[i+1]-link_start[i]) k_max=link_start[i+1]-link_start[i];
+    new_spins[i]=0;
+    previous_spins[i]=0;
+    spin[i]=0;
+    // we keep the sum of the weights or the degree of each node, this way
+    // we do not have to calculate it again.
+    node_weight[i]=0.0;
+    for (k=link_start[i]; k<link_start[i+1]; k++)
+      node_weight[i]+=link_weight[k];  //weight should be one, in case we are not using it.
+  }
+  //FindCommunityFromStart() takes it from the nodes
+  i=0;
   n_cur=iter.First(net->node_list);
-  //these lists are needed to keep track of spin states for parallel update mode
-  new_spins=new DL_Indexed_List<unsigned int*>();
-  previous_spins=new DL_Indexed_List<unsigned int*>();
   while (!iter.End())
   {
-    if (k_max<n_cur->Get_Degree()) k_max=n_cur->Get_Degree();
-    i_ptr=new unsigned int;
-    *i_ptr=0;
-    new_spins->Push(i_ptr);
-    i_ptr=new unsigned int;
-    *i_ptr=0;
-    previous_spins->Push(i_ptr);
+    n_cur->Set_Weight(node_weight[i++]);
     n_cur=iter.Next();
   }
   return;
@@ -98,13 +119,13 @@ PottsModel::PottsModel(network *n, unsigned int qvalue, int m) : acceptance(0)
 //########################################################
 PottsModel::~PottsModel()
 {
-  /* The DLItem destructor does not delete its item currently, 
-     because of some bad design. As a workaround, we delete them here
-     by hand */
-  new_spins->delete_items();
-  previous_spins->delete_items();
-  delete new_spins;
-  delete previous_spins;
+  delete [] new_spins;
+  delete [] previous_spins;
+  delete [] link_start;
+  delete [] link_nei;
+  delete [] link_weight;
+  delete [] node_weight;
+  delete [] spin;
   delete [] Qa;
   delete [] weights;
   delete [] color_field;
@@ -117,36 +138,23 @@ PottsModel::~PottsModel()
 //when called with positve one.
 //This may be handy, if you want to warm up the network.
 //####################################################
-unsigned long PottsModel::assign_initial_conf(int spin)
+unsigned long PottsModel::assign_initial_conf(int init_spin)
 {
   int s;
-  DLList_Iter<NNode*> iter;
-  DLList_Iter<NLink*> l_iter;
-  NNode *n_cur;
-  NLink *l_cur;
   double sum_weight;
   double av_k_squared=0.0;
   double av_k=0.0;
+  unsigned long i=0;
 //   printf("Assigning initial configuration...\n");
   // initialize colorfield
-  for (unsigned int i=0; i<=q; i++) color_field[i]=0.0;
+  for (unsigned int j=0; j<=q; j++) color_field[j]=0.0;
   //
   total_degree_sum=0.0;
-  n_cur=iter.First(net->node_list);
-  while (!iter.End())
+  for (i=0; i<num_of_nodes; i++)
   {
-    if (spin<0) s=RNG_INTEGER(1,q); else s=spin;
-    n_cur->Set_ClusterIndex(s);
-      l_cur=l_iter.First(n_cur->Get_Links());
-      sum_weight=0;
-      while (!l_iter.End())
-      {
-        sum_weight+=l_cur->Get_Weight();   //weight should be one, in case we are not using it.
-        l_cur=l_iter.Next();
-      }
-      // we set the sum of the weights or the degree as the weight of the node, this way
-      // we do not have to calculate it again.
-      n_cur->Set_Weight(sum_weight);
+    if (init_spin<0) s=igraph_rng_get_integer(rng,1,q); else s=init_spin;
+    spin[i]=s;
+      sum_weight=node_weight[i];
       av_k_squared+=sum_weight*sum_weight;
       av_k+=sum_weight;
 
@@ -158,20 +166,19 @@ unsigned long PottsModel::assign_initial_conf(int spin)
     }
     // or in case we want to use a weight of each link that is proportional to k_i\times k_j
       total_degree_sum+=sum_weight;
-    n_cur=iter.Next();
   }
-  av_k_squared/=double(net->node_list->Size());
-          av_k/=double(net->node_list->Size());
+  av_k_squared/=double(num_of_nodes);
+          av_k/=double(num_of_nodes);
   // total_degree_sum-=av_k_squared/av_k;
 //   printf("Total Degree Sum=2M=%f\n",total_degree_sum);
-  return net->node_list->Size();
+  return num_of_nodes;
 }
 //#####################################################################
 //If I ever manage to write a decent LookUp function, it will be here
 //#####################################################################
 unsigned long PottsModel::initialize_lookup(double kT, double gamma)
 {
-  IGRAPH_UNUSED(kT); 
+  IGRAPH_UNUSED(kT);
   IGRAPH_UNUSED(gamma);
   /*
   double beta;
@@ -199,15 +206,13 @@ unsigned long PottsModel::initialize_lookup(double kT, double gamma)
 }
 //#####################################################################
 // Q denotes the modulary of the network
-// This function calculates it initially 
+// This function calculates it initially
 // In the event of a spin changing its state, it only needs updating
-// Note that Qmatrix and Qa are only counting! The normalization 
+// Note that Qmatrix and Qa are only counting! The normalization
 // by num_of_links is done later
 //####################################################################
 double PottsModel::initialize_Qmatrix(void)
 {
-  DLList_Iter<NLink*> l_iter;
-  NLink *l_cur;
   unsigned int i,j;
   //initialize with zeros
   num_of_links=net->link_list->Size();
@@ -220,17 +225,16 @@ double PottsModel::initialize_Qmatrix(void)
       }
   }
   //go over all links and make corresponding entries in Q matrix
-  //An edge connecting state i wiht state j will get an entry in Qij and Qji
-  l_cur=l_iter.First(net->link_list);
-  while (!l_iter.End())
+  //An edge connecting state i wiht state j will get an entry in Qij and Qji,
+  //every link is seen from both of its ends here
+  for (unsigned long v=0; v<num_of_nodes; v++)
   {
-    i=l_cur->Get_Start()->Get_ClusterIndex();
-    j=l_cur->Get_End()->Get_ClusterIndex();
-    //printf("%d %d\n",i,j);
-    Qmatrix[i][j]+=l_cur->Get_Weight();
-    Qmatrix[j][i]+=l_cur->Get_Weight();
-
-    l_cur=l_iter.Next();
+    i=spin[v];
+    for (unsigned long k=link_start[v]; k<link_start[v+1]; k++)
+    {
+      j=spin[link_nei[k]];
+      Qmatrix[i][j]+=link_weight[k];
+    }
   }
   //Finally, calculate sum over rows and keep in Qa
   for (i=0; i<=q; i++)
@@ -240,7 +244,7 @@ double PottsModel::initialize_Qmatrix(void)
   return calculate_Q();
 }
 //####################################################################
-// This function does the actual calculation of Q from the matrix 
+// This function does the actual calculation of Q from the matrix
 // The normalization by num_of_links is done here
 //####################################################################
 double PottsModel::calculate_Q()
@@ -280,14 +284,13 @@ double PottsModel::calculate_genQ(double gamma)
 double PottsModel::calculate_energy(double gamma)
 {
   double e=0.0;
-  DLList_Iter<NLink*> l_iter;
-  NLink *l_cur;
-  l_cur=l_iter.First(net->link_list);
-  //every in-cluster edge contributes -1
-  while (!l_iter.End())
+  //every in-cluster edge contributes -1, it is seen from both ends
+  for (unsigned long v=0; v<num_of_nodes; v++)
   {
-    if (l_cur->Get_Start()->Get_ClusterIndex()==l_cur->Get_End()->Get_ClusterIndex()) e--;;
-   l_cur=l_iter.Next();
+    for (unsigned long k=link_start[v]; k<link_start[v+1]; k++)
+    {
+      if (link_nei[k]>v && spin[link_nei[k]]==spin[v]) e--;
+    }
   }
   //and the penalty term contributes according to cluster sizes
   for (unsigned int i=1; i<=q; i++)
@@ -298,7 +301,7 @@ double PottsModel::calculate_energy(double gamma)
   return e;
 }
 //##########################################################################
-// We would like to start from a temperature with at least 95 of all proposed 
+// We would like to start from a temperature with at least 95 of all proposed
 // spin changes accepted in 50 sweeps over the network
 // The function returns the Temperature found
 //#########################################################################
@@ -334,59 +337,43 @@ double PottsModel::FindStartTemp(double gamma, double prob, double ts)
 //##############################################################
 long PottsModel::HeatBathParallelLookupZeroTemp(double gamma, double prob, unsigned int max_sweeps)
 {
-  DLList_Iter<NNode*> iter, net_iter;
-  DLList_Iter<NLink*> l_iter;
-  DLList_Iter<unsigned int*> i_iter, i_iter2;
-  NNode *node, *n_cur;
-  NLink *l_cur;
-  unsigned int *SPIN, *P_SPIN, new_spin, spin_opt, old_spin, spin, sweep;
+  unsigned int new_spin, spin_opt, old_spin, s, sweep;
+  unsigned long v, k, nei;
   // long h; // degree;
   unsigned long changes;
   double h, delta=0, deltaE, deltaEmin, w, degree;
-  //HugeArray<double> neighbours;
   bool cyclic=0;
-  
+
   sweep=0;
-  changes=1;  
+  changes=1;
   while (sweep<max_sweeps && changes)
   {
     cyclic=true;
     sweep++;
     changes=0;
     //Loop over all nodes
-    node=net_iter.First(net->node_list);
-    SPIN=i_iter.First(new_spins);
-    while (!net_iter.End())
+    for (v=0; v<num_of_nodes; v++)
     {
       // How many neigbors of each type?
       // set them all zero
       for (unsigned int i=0; i<=q; i++) neighbours[i]=0;
-      degree=node->Get_Weight();
+      degree=node_weight[v];
       //Loop over all links (=neighbours)
-      l_cur=l_iter.First(node->Get_Links());
-      while (!l_iter.End())
+      for (k=link_start[v]; k<link_start[v+1]; k++)
       {
-        //printf("%s %s\n",node->Get_Name(),n_cur->Get_Name());
-	w=l_cur->Get_Weight();
-	if (node==l_cur->Get_Start()) {
-	  n_cur=l_cur->Get_End();
-	} else { 
-	  n_cur=l_cur->Get_Start(); 
-	}
-        neighbours[n_cur->Get_ClusterIndex()]+=w;
-        l_cur=l_iter.Next();
+        neighbours[spin[link_nei[k]]]+=link_weight[k];
       }
-      //Search optimal Spin      
-      old_spin=node->Get_ClusterIndex();
+      //Search optimal Spin
+      old_spin=spin[v];
       //degree=node->Get_Degree();
       switch (operation_mode) {
-      case 0: { 
-	delta=1.0; 
+      case 0: {
+	delta=1.0;
 	break;
-      } 
-      case 1: { //newman modularity 
-	prob=degree/total_degree_sum; 
-	delta=degree; 
+      }
+      case 1: { //newman modularity
+	prob=degree/total_degree_sum;
+	delta=degree;
 	break;
        }
       }
@@ -394,70 +381,56 @@ long PottsModel::HeatBathParallelLookupZeroTemp(double gamma, double prob, unsig
 
       spin_opt=old_spin;
       deltaEmin=0.0;
-      for (spin=1; spin<=q; spin++)  // all possible spin states
+      for (s=1; s<=q; s++)  // all possible spin states
       {
-          if (spin!=old_spin)
+          if (s!=old_spin)
           {
-            h=color_field[spin]+delta-color_field[old_spin];
-            deltaE=double(neighbours[old_spin]-neighbours[spin])+gamma*prob*double(h);
+            h=color_field[s]+delta-color_field[old_spin];
+            deltaE=double(neighbours[old_spin]-neighbours[s])+gamma*prob*double(h);
             if (deltaE<deltaEmin) {
-              spin_opt=spin;
+              spin_opt=s;
               deltaEmin=deltaE;
             }
           }
-      } // for spin
+      } // for s
 
-     //Put optimal spin on list for later update 
-     *SPIN=spin_opt;     
-     node=net_iter.Next();
-     SPIN=i_iter.Next();
-    } // while !net_iter.End()
+     //Put optimal spin on list for later update
+     new_spins[v]=spin_opt;
+    } // for v
 
     //-------------------------------
     //Now set all spins to new values
-    node=net_iter.First(net->node_list);
-    SPIN=i_iter.First(new_spins);
-    P_SPIN=i_iter2.First(previous_spins);    
-    while (!net_iter.End())
+    for (v=0; v<num_of_nodes; v++)
     {
-      old_spin=node->Get_ClusterIndex();
-      new_spin=*SPIN;
+      old_spin=spin[v];
+      new_spin=new_spins[v];
       if (new_spin!=old_spin) // Do we really have a change??
       {
         changes++;
-        node->Set_ClusterIndex(new_spin);
+        spin[v]=new_spin;
 	//this is important!!
 	//In Parallel update, there occur cyclic attractors of size two
 	//which then make the program run for ever
-        if (new_spin!=*P_SPIN) cyclic=false;
-        *P_SPIN=old_spin;
+        if (new_spin!=previous_spins[v]) cyclic=false;
+        previous_spins[v]=old_spin;
         color_field[old_spin]--;
         color_field[new_spin]++;
 
         //Qmatrix update
         //iteration over all neighbours
-        l_cur=l_iter.First(node->Get_Links());
-        while (!l_iter.End())
+        for (k=link_start[v]; k<link_start[v+1]; k++)
         {
-	   w=l_cur->Get_Weight();
-	   if (node==l_cur->Get_Start()) {
-	     n_cur=l_cur->Get_End();
-	   } else { 
-	     n_cur=l_cur->Get_Start(); 
-	   }
-          Qmatrix[old_spin][n_cur->Get_ClusterIndex()]-=w;
-          Qmatrix[new_spin][n_cur->Get_ClusterIndex()]+=w;
-          Qmatrix[n_cur->Get_ClusterIndex()][old_spin]-=w;
-          Qmatrix[n_cur->Get_ClusterIndex()][new_spin]+=w;
+          w=link_weight[k];
+          nei=spin[link_nei[k]];
+          Qmatrix[old_spin][nei]-=w;
+          Qmatrix[new_spin][nei]+=w;
+          Qmatrix[nei][old_spin]-=w;
+          Qmatrix[nei][new_spin]+=w;
           Qa[old_spin]-=w;
           Qa[new_spin]+=w;
-          l_cur=l_iter.Next();
-        }  // while l_iter
+        }  // for k
       }
-      node=net_iter.Next();
-      SPIN=i_iter.Next();
-      P_SPIN=i_iter2.Next();
-    } // while (!net_iter.End())
+    } // for v
   }  // while markov
 
   // In case of a cyclic attractor, we want to interrupt
@@ -471,21 +444,16 @@ long PottsModel::HeatBathParallelLookupZeroTemp(double gamma, double prob, unsig
   }
 }
 //###################################################################################
-//The same function as before, but rather than parallel update, it pics the nodes to update 
+//The same function as before, but rather than parallel update, it pics the nodes to update
 //randomly
 //###################################################################################
 double PottsModel::HeatBathLookupZeroTemp(double gamma, double prob, unsigned int max_sweeps)
 {
-  DLList_Iter<NNode*> iter;
-  DLList_Iter<NLink*> l_iter;
-  DLList_Iter<unsigned int*> i_iter, i_iter2;
-  NNode *node, *n_cur;
-  NLink *l_cur;
-  unsigned int new_spin, spin_opt, old_spin, spin, sweep;
+  unsigned int new_spin, spin_opt, old_spin, s, sweep;
+  unsigned long k, nei;
   long r;// degree;
   unsigned long changes;
   double delta=0, h, deltaE, deltaEmin,w,degree;
-  //HugeArray<int> neighbours;
 
   sweep=0;
   changes=0;
@@ -497,38 +465,28 @@ double PottsModel::HeatBathLookupZeroTemp(double gamma, double prob, unsigned in
     {
       r=-1;
       while ((r<0) || (r>(long)num_of_nodes-1))
-	r=RNG_INTEGER(0,num_of_nodes-1);
+	r=igraph_rng_get_integer(rng,0,num_of_nodes-1);
       /* r=long(double(num_of_nodes*double(rand())/double(RAND_MAX+1.0)));*/
-      node=net->node_list->Get(r);
       // Wir zaehlen, wieviele Nachbarn von jedem spin vorhanden sind
       // erst mal alles Null setzen
       for (unsigned int i=0; i<=q; i++) neighbours[i]=0;
-      degree=node->Get_Weight();
+      degree=node_weight[r];
       //Loop over all links (=neighbours)
-      l_cur=l_iter.First(node->Get_Links());
-      while (!l_iter.End())
+      for (k=link_start[r]; k<link_start[r+1]; k++)
       {
-        //printf("%s %s\n",node->Get_Name(),n_cur->Get_Name());
-	w=l_cur->Get_Weight();
-	if (node==l_cur->Get_Start()) {
-	  n_cur=l_cur->Get_End();
-	} else { 
-	  n_cur=l_cur->Get_Start(); 
-	}
-        neighbours[n_cur->Get_ClusterIndex()]+=w;
-        l_cur=l_iter.Next();
+        neighbours[spin[link_nei[k]]]+=link_weight[k];
       }
-      //Search optimal Spin      
-      old_spin=node->Get_ClusterIndex();
+      //Search optimal Spin
+      old_spin=spin[r];
       //degree=node->Get_Degree();
       switch (operation_mode) {
-      case 0: { 
-	delta=1.0; 
+      case 0: {
+	delta=1.0;
 	break;
-      } 
-      case 1: { //newman modularity 
-	prob=degree/total_degree_sum; 
-	delta=degree; 
+      }
+      case 1: { //newman modularity
+	prob=degree/total_degree_sum;
+	delta=degree;
 	break;
        }
       }
@@ -536,18 +494,18 @@ double PottsModel::HeatBathLookupZeroTemp(double gamma, double prob, unsigned in
 
       spin_opt=old_spin;
       deltaEmin=0.0;
-      for (spin=1; spin<=q; spin++)  // alle moeglichen Spins
+      for (s=1; s<=q; s++)  // alle moeglichen Spins
       {
-          if (spin!=old_spin)
+          if (s!=old_spin)
           {
-            h=color_field[spin]+delta-color_field[old_spin];
-            deltaE=double(neighbours[old_spin]-neighbours[spin])+gamma*prob*double(h);
+            h=color_field[s]+delta-color_field[old_spin];
+            deltaE=double(neighbours[old_spin]-neighbours[s])+gamma*prob*double(h);
             if (deltaE<deltaEmin) {
-              spin_opt=spin;
+              spin_opt=s;
               deltaEmin=deltaE;
             }
           }
-      } // for spin
+      } // for s
 
       //-------------------------------
       //Now update the spins
@@ -555,29 +513,23 @@ double PottsModel::HeatBathLookupZeroTemp(double gamma, double prob, unsigned in
       if (new_spin!=old_spin) // Did we really change something??
       {
         changes++;
-        node->Set_ClusterIndex(new_spin);
+        spin[r]=new_spin;
         color_field[old_spin]-=delta;
         color_field[new_spin]+=delta;
 
         //Qmatrix update
         //iteration over all neighbours
-        l_cur=l_iter.First(node->Get_Links());
-        while (!l_iter.End())
+        for (k=link_start[r]; k<link_start[r+1]; k++)
         {
-	   w=l_cur->Get_Weight();
-	   if (node==l_cur->Get_Start()) {
-	     n_cur=l_cur->Get_End();
-	   } else { 
-	     n_cur=l_cur->Get_Start(); 
-	   }
-          Qmatrix[old_spin][n_cur->Get_ClusterIndex()]-=w;
-          Qmatrix[new_spin][n_cur->Get_ClusterIndex()]+=w;
-          Qmatrix[n_cur->Get_ClusterIndex()][old_spin]-=w;
-          Qmatrix[n_cur->Get_ClusterIndex()][new_spin]+=w;
+          w=link_weight[k];
+          nei=spin[link_nei[k]];
+          Qmatrix[old_spin][nei]-=w;
+          Qmatrix[new_spin][nei]+=w;
+          Qmatrix[nei][old_spin]-=w;
+          Qmatrix[nei][new_spin]+=w;
           Qa[old_spin]-=w;
           Qa[new_spin]+=w;
-          l_cur=l_iter.Next();
-        }  // while l_iter
+        }  // for k
        }
     } // for n
   }  // while markov
@@ -590,33 +542,23 @@ double PottsModel::HeatBathLookupZeroTemp(double gamma, double prob, unsigned in
 //#####################################################################################
 long PottsModel::HeatBathParallelLookup(double gamma, double prob, double kT, unsigned int max_sweeps)
 {
-  DLList_Iter<NNode*> iter, net_iter;
-  DLList_Iter<NLink*> l_iter;
-  DLList_Iter<unsigned int*> i_iter, i_iter2;
-  NNode *node, *n_cur;
-  NLink *l_cur;
   unsigned int new_spin, spin_opt, old_spin;
-  unsigned int *SPIN, *P_SPIN;
   unsigned int sweep;
+  unsigned long v, k, nei;
   long max_q;
   unsigned long changes, /*degree,*/ problemcount;
-  //HugeArray<int> neighbours;
   double h, delta=0, norm, r, beta,minweight, prefac=0,w, degree;
   bool cyclic=0, found;
-  unsigned long num_of_nodes;
 
   sweep=0;
   changes=1;
-  num_of_nodes=net->node_list->Size();
   while (sweep<max_sweeps && changes)
   {
     cyclic=true;
     sweep++;
     changes=0;
     //Loop over all nodes
-    node=net_iter.First(net->node_list);
-    SPIN=i_iter.First(new_spins);
-    while (!net_iter.End())
+    for (v=0; v<num_of_nodes; v++)
     {
       // Initialize neighbours and weights
       problemcount=0;
@@ -625,34 +567,25 @@ long PottsModel::HeatBathParallelLookup(double gamma, double prob, double kT, un
         weights[i]=0;
       }
       norm=0.0;
-      degree=node->Get_Weight();
+      degree=node_weight[v];
       //Loop over all links (=neighbours)
-      l_cur=l_iter.First(node->Get_Links());
-      while (!l_iter.End())
+      for (k=link_start[v]; k<link_start[v+1]; k++)
       {
-        //printf("%s %s\n",node->Get_Name(),n_cur->Get_Name());
-	w=l_cur->Get_Weight();
-	if (node==l_cur->Get_Start()) {
-	  n_cur=l_cur->Get_End();
-	} else { 
-	  n_cur=l_cur->Get_Start(); 
-	}
-        neighbours[n_cur->Get_ClusterIndex()]+=w;
-        l_cur=l_iter.Next();
+        neighbours[spin[link_nei[k]]]+=link_weight[k];
       }
-      //Search optimal Spin      
-      old_spin=node->Get_ClusterIndex();
+      //Search optimal Spin
+      old_spin=spin[v];
       //degree=node->Get_Degree();
       switch (operation_mode) {
-      case 0: { 
-	prefac=1.0; 
-	delta=1.0; 
+      case 0: {
+	prefac=1.0;
+	delta=1.0;
 	break;
-      } 
-      case 1: { //newman modularity 
-	prefac=1.0; 
-	prob=degree/total_degree_sum; 
-	delta=degree; 
+      }
+      case 1: { //newman modularity
+	prefac=1.0;
+	prob=degree/total_degree_sum;
+	delta=degree;
 	break;
        }
       }
@@ -660,25 +593,25 @@ long PottsModel::HeatBathParallelLookup(double gamma, double prob, double kT, un
       beta=1.0/kT*prefac;
       minweight=0.0;
       weights[old_spin]=0.0;
-      for (unsigned spin=1; spin<=q; spin++)  // loop over all possible new spins
+      for (unsigned s=1; s<=q; s++)  // loop over all possible new spins
       {
-          if (spin!=old_spin) // only if we have a different than old spin!
+          if (s!=old_spin) // only if we have a different than old spin!
           {
-            h=color_field[spin]+delta-color_field[old_spin];
-            weights[spin]=double(neighbours[old_spin]-neighbours[spin])+gamma*prob*double(h);
-            if (weights[spin]<minweight) minweight=weights[spin];
+            h=color_field[s]+delta-color_field[old_spin];
+            weights[s]=double(neighbours[old_spin]-neighbours[s])+gamma*prob*double(h);
+            if (weights[s]<minweight) minweight=weights[s];
           }
-      }   // for spin      
-      for (unsigned spin=1; spin<=q; spin++)  // loop over all possibe spins
+      }   // for s
+      for (unsigned s=1; s<=q; s++)  // loop over all possibe spins
       {
-            weights[spin]-=minweight;         // subtract minweight
+            weights[s]-=minweight;         // subtract minweight
                                               // to avoid numerical problems with large exponents
-            weights[spin]=exp(-beta*weights[spin]);
-            norm+=weights[spin];
-      }   // for spin
+            weights[s]=exp(-beta*weights[s]);
+            norm+=weights[s];
+      }   // for s
 
      //now choose a new spin
-     r = RNG_UNIF(0, norm);
+     r = igraph_rng_get_unif(rng, 0, norm);
      /* norm*double(rand())/double(RAND_MAX + 1.0); */
      new_spin=1;
      found=false;
@@ -695,54 +628,39 @@ long PottsModel::HeatBathParallelLookup(double gamma, double prob, double kT, un
         problemcount++;
      }
      //Put new spin on list
-     *SPIN=spin_opt;
-
-     node=net_iter.Next();
-     SPIN=i_iter.Next();
-    } // while !net_iter.End()
+     new_spins[v]=spin_opt;
+    } // for v
 
     //-------------------------------
     //now update all spins
-    node=net_iter.First(net->node_list);
-    SPIN=i_iter.First(new_spins);
-    P_SPIN=i_iter2.First(previous_spins);
-    while (!net_iter.End())
+    for (v=0; v<num_of_nodes; v++)
     {
-      old_spin=node->Get_ClusterIndex();
-      new_spin=*SPIN;
+      old_spin=spin[v];
+      new_spin=new_spins[v];
       if (new_spin!=old_spin) // Did we really change something??
       {
         changes++;
-        node->Set_ClusterIndex(new_spin);
-        if (new_spin!=*P_SPIN) cyclic=false;
-        *P_SPIN=old_spin;
+        spin[v]=new_spin;
+        if (new_spin!=previous_spins[v]) cyclic=false;
+        previous_spins[v]=old_spin;
         color_field[old_spin]-=delta;
         color_field[new_spin]+=delta;
 
         //Qmatrix update
         //iteration over all neighbours
-        l_cur=l_iter.First(node->Get_Links());
-        while (!l_iter.End())
+        for (k=link_start[v]; k<link_start[v+1]; k++)
         {
-	   w=l_cur->Get_Weight();
-	   if (node==l_cur->Get_Start()) {
-	     n_cur=l_cur->Get_End();
-	   } else { 
-	     n_cur=l_cur->Get_Start(); 
-	   }
-          Qmatrix[old_spin][n_cur->Get_ClusterIndex()]-=w;
-          Qmatrix[new_spin][n_cur->Get_ClusterIndex()]+=w;
-          Qmatrix[n_cur->Get_ClusterIndex()][old_spin]-=w;
-          Qmatrix[n_cur->Get_ClusterIndex()][new_spin]+=w;
+          w=link_weight[k];
+          nei=spin[link_nei[k]];
+          Qmatrix[old_spin][nei]-=w;
+          Qmatrix[new_spin][nei]+=w;
+          Qmatrix[nei][old_spin]-=w;
+          Qmatrix[nei][new_spin]+=w;
           Qa[old_spin]-=w;
           Qa[new_spin]+=w;
-          l_cur=l_iter.Next();
-        }  // while l_iter
+        }  // for k
       }
-      node=net_iter.Next();
-      SPIN=i_iter.Next();
-      P_SPIN=i_iter2.Next();
-    } // while (!net_iter.End())
+    } // for v
 
   }  // while markov
   max_q=0;
@@ -759,28 +677,23 @@ long PottsModel::HeatBathParallelLookup(double gamma, double prob, double kT, un
   }
 }
 //##############################################################
-// This is the function generally used for optimisation, 
+// This is the function generally used for optimisation,
 // as the parallel update has its flaws, due to the cyclic attractors
 //##############################################################
 double PottsModel::HeatBathLookup(double gamma, double prob, double kT, unsigned int max_sweeps)
 {
-  DLList_Iter<NNode*> iter;
-  DLList_Iter<NLink*> l_iter;
-  DLList_Iter<unsigned int*> i_iter, i_iter2;
-  NNode *node, *n_cur;
-  NLink *l_cur;
   unsigned int new_spin, spin_opt, old_spin;
   unsigned int sweep;
+  unsigned long k, nei;
   long max_q, rn;
   unsigned long changes, /*degree,*/ problemcount;
   double degree,w, delta=0, h;
-  //HugeArray<int> neighbours;
   double norm, r, beta,minweight, prefac=0;
   bool found;
   long int num_of_nodes;
   sweep=0;
   changes=0;
-  num_of_nodes=net->node_list->Size();
+  num_of_nodes=this->num_of_nodes;
   while (sweep<max_sweeps)
   {
     sweep++;
@@ -789,10 +702,9 @@ double PottsModel::HeatBathLookup(double gamma, double prob, double kT, unsigned
     {
       rn=-1;
       while ((rn<0) || (rn>num_of_nodes-1))
-	rn=RNG_INTEGER(0, num_of_nodes-1);
+	rn=igraph_rng_get_integer(rng, 0, num_of_nodes-1);
       /* rn=long(double(num_of_nodes*double(rand())/double(RAND_MAX+1.0))); */
-        
-      node=net->node_list->Get(rn);
+
       // initialize the neighbours and the weights
       problemcount=0;
       for (unsigned int i=0; i<=q; i++) {
@@ -800,36 +712,27 @@ double PottsModel::HeatBathLookup(double gamma, double prob, double kT, unsigned
         weights[i]=0.0;
       }
       norm=0.0;
-      degree=node->Get_Weight();
+      degree=node_weight[rn];
       //Loop over all links (=neighbours)
-      l_cur=l_iter.First(node->Get_Links());
-      while (!l_iter.End())
+      for (k=link_start[rn]; k<link_start[rn+1]; k++)
       {
-        //printf("%s %s\n",node->Get_Name(),n_cur->Get_Name());
-	w=l_cur->Get_Weight();
-	if (node==l_cur->Get_Start()) {
-	  n_cur=l_cur->Get_End();
-	} else { 
-	  n_cur=l_cur->Get_Start(); 
-	}
-        neighbours[n_cur->Get_ClusterIndex()]+=w;
-        l_cur=l_iter.Next();
+        neighbours[spin[link_nei[k]]]+=link_weight[k];
       }
-      
+
       //Look for optimal spin
-      
-      old_spin=node->Get_ClusterIndex();
+
+      old_spin=spin[rn];
       //degree=node->Get_Degree();
       switch (operation_mode) {
-      case 0: { 
-	prefac=1.0; 
-	delta=1.0; 
+      case 0: {
+	prefac=1.0;
+	delta=1.0;
 	break;
-      } 
-      case 1:  {//newman modularity 
-	prefac=1.0; 
-	prob=degree/total_degree_sum; 
-	delta=degree; 
+      }
+      case 1:  {//newman modularity
+	prefac=1.0;
+	prob=degree/total_degree_sum;
+	delta=degree;
 	break;
        }
       }
@@ -837,27 +740,27 @@ double PottsModel::HeatBathLookup(double gamma, double prob, double kT, unsigned
       beta=1.0/kT*prefac;
       minweight=0.0;
       weights[old_spin]=0.0;
-      for (unsigned spin=1; spin<=q; spin++)  // all possible new spins
+      for (unsigned s=1; s<=q; s++)  // all possible new spins
       {
-          if (spin!=old_spin) // except the old one!
+          if (s!=old_spin) // except the old one!
           {
-            h=color_field[spin]-(color_field[old_spin]-delta);
-            weights[spin]=neighbours[old_spin]-neighbours[spin]+gamma*prob*h;
-            if (weights[spin]<minweight) minweight=weights[spin];
+            h=color_field[s]-(color_field[old_spin]-delta);
+            weights[s]=neighbours[old_spin]-neighbours[s]+gamma*prob*h;
+            if (weights[s]<minweight) minweight=weights[s];
           }
-      }   // for spin      
-      for (unsigned spin=1; spin<=q; spin++)  // all possible new spins
+      }   // for s
+      for (unsigned s=1; s<=q; s++)  // all possible new spins
       {
-            weights[spin]-=minweight;         // subtract minweigt
+            weights[s]-=minweight;         // subtract minweigt
                                               // for numerical stability
-            weights[spin]=exp(-beta*weights[spin]);
-            norm+=weights[spin];
-      }   // for spin
-      
+            weights[s]=exp(-beta*weights[s]);
+            norm+=weights[s];
+      }   // for s
+
 
      //choose a new spin
 /*      r = norm*double(rand())/double(RAND_MAX + 1.0); */
-     r=RNG_UNIF(0, norm);
+     r=igraph_rng_get_unif(rng, 0, norm);
      new_spin=1;
      found=false;
      while (!found && new_spin<=q) {
@@ -878,29 +781,23 @@ double PottsModel::HeatBathLookup(double gamma, double prob, double kT, unsigned
     if (new_spin!=old_spin) // Did we really change something??
     {
         changes++;
-        node->Set_ClusterIndex(new_spin);
+        spin[rn]=new_spin;
         color_field[old_spin]-=delta;
         color_field[new_spin]+=delta;
 
         //Qmatrix update
         //iteration over all neighbours
-        l_cur=l_iter.First(node->Get_Links());
-        while (!l_iter.End())
+        for (k=link_start[rn]; k<link_start[rn+1]; k++)
         {
-	   w=l_cur->Get_Weight();
-	   if (node==l_cur->Get_Start()) {
-	     n_cur=l_cur->Get_End();
-	   } else { 
-	     n_cur=l_cur->Get_Start(); 
-	   }
-          Qmatrix[old_spin][n_cur->Get_ClusterIndex()]-=w;
-          Qmatrix[new_spin][n_cur->Get_ClusterIndex()]+=w;
-          Qmatrix[n_cur->Get_ClusterIndex()][old_spin]-=w;
-          Qmatrix[n_cur->Get_ClusterIndex()][new_spin]+=w;
+          w=link_weight[k];
+          nei=spin[link_nei[k]];
+          Qmatrix[old_spin][nei]-=w;
+          Qmatrix[new_spin][nei]+=w;
+          Qmatrix[nei][old_spin]-=w;
+          Qmatrix[nei][new_spin]+=w;
           Qa[old_spin]-=w;
           Qa[new_spin]+=w;
-          l_cur=l_iter.Next();
-        }  // while l_iter
+        }  // for k
       }
     } // for n
   }  // while markov
@@ -1177,12 +1074,10 @@ long PottsModel::WriteClusters(igraph_real_t *modularity,
 			       igraph_vector_t *membership,
 			       double kT, double gamma)
 {
-  NNode *n_cur, *n_cur2;
   /*
   double a1,a2,a3,p,p1,p2;
   long n,N,lin,lout;
   */
-  DLList_Iter<NNode*> iter, iter2;
   HugeArray<int> inner_links;
   HugeArray<int> outer_links;
   HugeArray<int> nodes;
@@ -1201,26 +1096,20 @@ long PottsModel::WriteClusters(igraph_real_t *modularity,
 
   if (csize || membership || modularity) {
     // TODO: count the number of clusters
-    for (unsigned int spin=1; spin<=q; spin++)
+    for (unsigned int s=1; s<=q; s++)
+      {
+	inner_links[s]=0;
+	outer_links[s]=0;
+	nodes[s]=0;
+      }
+    for (unsigned long v=0; v<num_of_nodes; v++)
       {
-	inner_links[spin]=0;
-	outer_links[spin]=0;
-	nodes[spin]=0;
-	n_cur=iter.First(net->node_list);
-	while (!iter.End())
+	unsigned int s=spin[v];
+	nodes[s]++;
+	for (unsigned long k=link_start[v]; k<link_start[v+1]; k++)
 	  {
-	    if (n_cur->Get_ClusterIndex()==spin)
-	      {
-		nodes[spin]++;
-		n_cur2=iter2.First(n_cur->Get_Neighbours());
-		while (!iter2.End())
-		  {
-		    if (n_cur2->Get_ClusterIndex()==spin) inner_links[spin]++;
-		    else outer_links[spin]++;
-		    n_cur2=iter2.Next();
-		  }
-	      }
-	    n_cur=iter.Next();
+	    if (spin[link_nei[k]]==s) inner_links[s]++;
+	    else outer_links[s]++;
 	  }
       }
   }
@@ -1277,22 +1166,18 @@ long PottsModel::WriteClusters(igraph_real_t *modularity,
   //die Elemente der Cluster
   if (membership) {
     long int no=-1;
+    HugeArray<long int> cluster_no;
     IGRAPH_CHECK(igraph_vector_resize(membership, num_of_nodes));
-    for (unsigned int spin=1; spin<=q; spin++)
+    for (unsigned int s=1; s<=q; s++)
       {
-	if (nodes[spin]>0) {
+	if (nodes[s]>0) {
 	  no++;
 	}
-	n_cur=iter.First(net->node_list);
-	while (!iter.End())
-	  {
-	    if (n_cur->Get_ClusterIndex()==spin)
-	      {
-		//         fprintf(file,"%d\t%s\n",spin,n_cur->Get_Name());
-		VECTOR(*membership)[ n_cur->Get_Index() ]=no;
-	      }
-	    n_cur=iter.Next();
-	  }
+	cluster_no[s]=no;
+      }
+    for (unsigned long v=0; v<num_of_nodes; v++)
+      {
+	VECTOR(*membership)[v]=cluster_no[spin[v]];
       }
   }
   
@@ -1438,7 +1323,7 @@ double PottsModel::GammaSweep(double gamma_start, double gamma_stop, double prob
         n_cur2=iter2.First(net->node_list);
         while (!iter2.End())
         {
-          if (n_cur->Get_ClusterIndex()==n_cur2->Get_ClusterIndex())
+          if (spin[n_cur->Get_Index()]==spin[n_cur2->Get_Index()])
           {
             correlation[n_cur->Get_Index()]->Set(n_cur2->Get_Index())+=0.5;
           }
@@ -1514,7 +1399,7 @@ double PottsModel::GammaSweepZeroTemp(double gamma_start, double gamma_stop, dou
         n_cur2=iter2.First(net->node_list);
         while (!iter2.End())
         {
-          if (n_cur->Get_ClusterIndex()==n_cur2->Get_ClusterIndex())
+          if (spin[n_cur->Get_Index()]==spin[n_cur2->Get_Index()])
           {
             correlation[n_cur->Get_Index()]->Set(n_cur2->Get_Index())+=0.5;
             correlation[n_cur2->Get_Index()]->Set(n_cur->Get_Index())+=0.5;
@@ -1586,39 +1471,114 @@ double PottsModel::GammaSweepZeroTemp(double gamma_start, double gamma_stop, dou
 //##############################################################################
 
 //#################################################################################################
-PottsModelN::PottsModelN(network *n, unsigned int num_communities, bool directed)
+PottsModelN::PottsModelN(network *n, unsigned int num_communities, bool directed,
+			 igraph_rng_t *r)
 {
 	//Set internal variable
 	net	= n;
+	rng	= r ? r : igraph_rng_default();
 	q	= num_communities;
-	
+
 	is_directed = directed;
-	
-	is_init = false;
-	
+
 	num_nodes	= net->node_list->Size();
+
+	//The links as flat arrays, the heat bath does not touch the
+	//linked lists of the network
+	unsigned long num_entries = 2 * net->link_list->Size();
+	link_start	= new unsigned long[num_nodes+1];
+	link_nei	= new unsigned long[num_entries];
+	link_weight	= new double[num_entries];
+	link_out	= new bool[num_entries];
+	igraph_i_network_adjacency(net, link_start, link_nei, link_weight, link_out);
+
+	//Bookkeeping of the various degrees (positive/negative) and (in/out)
+	degree_pos_in	= new double[num_nodes]; //Postive indegree of the nodes (or sum of weights)
+	degree_neg_in	= new double[num_nodes]; //Negative indegree of the nodes (or sum of weights)
+	degree_pos_out	= new double[num_nodes]; //Postive outdegree of the nodes (or sum of weights)
+	degree_neg_out	= new double[num_nodes]; //Negative outdegree of the nodes (or sum of weights)
+
+	spin			= new unsigned int[num_nodes]; //The spin state of each node
+
+	//Bookkeep of occupation numbers of spin states or the number of links in community...
+	degree_community_pos_in		= new double[q+1]; //Positive sum of indegree for communities
+	degree_community_neg_in		= new double[q+1]; //Negative sum of indegree for communities
+	degree_community_pos_out	= new double[q+1];//Positive sum of outegree for communities
+	degree_community_neg_out	= new double[q+1]; //Negative sum of outdegree for communities
+
+	//...and of weights and neighbours for in the HeathBathLookup
+	weights						= new double[q+1]; //The weights for changing to another spin state
+	neighbours					= new double[q+1]; //The number of neighbours (or weights) in different spin states
+	csize						= new unsigned int[q+1]; //The number of nodes in each community
+
+	//The degrees do not change
+	double sum_weight_pos_in, sum_weight_pos_out, sum_weight_neg_in, sum_weight_neg_out;
+	for (unsigned int v = 0; v < num_nodes; v++)
+	{
+		sum_weight_pos_in	= 0.0;
+		sum_weight_pos_out	= 0.0;
+		sum_weight_neg_in	= 0.0;
+		sum_weight_neg_out	= 0.0;
+
+		for (unsigned long k = link_start[v]; k < link_start[v+1]; k++)
+		{
+			double w = link_weight[k];
+			if (link_out[k]) //From this to other, so outgoing link
+				if (w > 0)
+					sum_weight_pos_out += w;   //Increase positive outgoing weight
+				else
+					sum_weight_neg_out -= w;	//Increase negative outgoing weight
+			else
+				if (w > 0)
+					sum_weight_pos_in += w;   //Increase positive incoming weight
+				else
+					sum_weight_neg_in -= w;	//Increase negative incoming weight
+		}
+
+		if (!is_directed)
+		{
+			double sum_weight_pos		= sum_weight_pos_out + sum_weight_pos_in;
+				   sum_weight_pos_out	= sum_weight_pos;
+				   sum_weight_pos_in	= sum_weight_pos;
+			double sum_weight_neg = sum_weight_neg_out + sum_weight_neg_in;
+				   sum_weight_neg_out	= sum_weight_neg;
+				   sum_weight_neg_in	= sum_weight_neg;
+		}
+
+		degree_pos_in[v]	= sum_weight_pos_in;
+		degree_neg_in[v]	= sum_weight_neg_in;
+		degree_pos_out[v]	= sum_weight_pos_out;
+		degree_neg_out[v]	= sum_weight_neg_out;
+
+		spin[v]	= 0;
+	}
 }
 //#######################################################
 //Destructor of PottsModel
 //########################################################
 PottsModelN::~PottsModelN()
 {
-	delete degree_pos_in;
-	delete degree_neg_in;
-	delete degree_pos_out;
-	delete degree_neg_out;
-	
-	delete degree_community_pos_in;
-	delete degree_community_neg_in;	
-	delete degree_community_pos_out;
-	delete degree_community_neg_out;
-	
-	delete weights;
-	delete neighbours;
-	delete csize;
-	
-	delete spin;
-	
+	delete [] link_start;
+	delete [] link_nei;
+	delete [] link_weight;
+	delete [] link_out;
+
+	delete [] degree_pos_in;
+	delete [] degree_neg_in;
+	delete [] degree_pos_out;
+	delete [] degree_neg_out;
+
+	delete [] degree_community_pos_in;
+	delete [] degree_community_neg_in;
+	delete [] degree_community_pos_out;
+	delete [] degree_community_neg_out;
+
+	delete [] weights;
+	delete [] neighbours;
+	delete [] csize;
+
+	delete [] spin;
+
 	return;
 }
 
@@ -1628,87 +1588,22 @@ void PottsModelN::assign_initial_conf(bool init_spins)
 	printf("Start assigning.\n");
 	#endif
 	int s;
-	DLList_Iter<NNode*> iter;
-	DLList_Iter<NLink*> l_iter;
-	NNode *n_cur;
-	NLink *l_cur;
-	
-
-	if(init_spins)
-	{
-		#ifdef DEBUG
-		printf("Initializing spin.\n");
-		#endif
-		//Bookkeeping of the various degrees (positive/negative) and (in/out)
-		degree_pos_in	= new double[num_nodes]; //Postive indegree of the nodes (or sum of weights)
-		degree_neg_in	= new double[num_nodes]; //Negative indegree of the nodes (or sum of weights)
-		degree_pos_out	= new double[num_nodes]; //Postive outdegree of the nodes (or sum of weights)
-		degree_neg_out	= new double[num_nodes]; //Negative outdegree of the nodes (or sum of weights)	
-				
-		spin			= new unsigned int[num_nodes]; //The spin state of each node
-	}
-	
-	if (is_init)
-	{
-		delete degree_community_pos_in;
-		delete degree_community_neg_in;
-		delete degree_community_pos_out;
-		delete degree_community_neg_out;
-		
-		delete weights;
-		delete neighbours;
-		delete csize;
-	}
-	
-	is_init = true;
-	
-	//Bookkeep of occupation numbers of spin states or the number of links in community...
-	degree_community_pos_in		= new double[q+1]; //Positive sum of indegree for communities
-	degree_community_neg_in		= new double[q+1]; //Negative sum of indegree for communities
-	degree_community_pos_out	= new double[q+1];//Positive sum of outegree for communities
-	degree_community_neg_out	= new double[q+1]; //Negative sum of outdegree for communities	
-
-	//...and of weights and neighbours for in the HeathBathLookup
-	weights						= new double[q+1]; //The weights for changing to another spin state
-	neighbours					= new double[q+1]; //The number of neighbours (or weights) in different spin states
-	csize						= new unsigned int[q+1]; //The number of nodes in each community	
-	
 
 	//Initialize communities
-	for (unsigned int i=0; i<=q; i++) 
+	for (unsigned int i=0; i<=q; i++)
 	{
 		degree_community_pos_in[i]	= 0.0;
-		degree_community_neg_in[i]	= 0.0;	
+		degree_community_neg_in[i]	= 0.0;
 		degree_community_pos_out[i]	= 0.0;
 		degree_community_neg_out[i]	= 0.0;
-		
+
 		csize[i]					= 0;
 	}
-	
-	//Initialize vectors
-	if (init_spins)
-	{	
-		for (unsigned int i = 0; i < num_nodes; i++)
-		{
-			degree_pos_in[i]	= 0.0;
-			degree_neg_in[i]	= 0.0;
-			degree_pos_out[i]	= 0.0;
-			degree_neg_out[i]	= 0.0;
-			
-			#ifdef DEBUG
-			printf("Initializing spin %d", i);
-			#endif
-			spin[i]	= 0;
-		}
-	}
+
 	m_p=0.0;
 	m_n=0.0;
-	//Set community for each node, and 
+	//Set community for each node, and
 	//correctly store it in the bookkeeping
-	
-	double sum_weight_pos_in, sum_weight_pos_out, sum_weight_neg_in, sum_weight_neg_out;
-	//double av_w = 0.0, av_k=0.0;
-	//int l = 0;
 	#ifdef DEBUG
 	printf("Visiting each node.\n");
 	#endif
@@ -1716,79 +1611,30 @@ void PottsModelN::assign_initial_conf(bool init_spins)
 	{
 		if (init_spins)
 		{
-			s = RNG_INTEGER(1, q);  //The new spin s
+			s = igraph_rng_get_integer(rng, 1, q);  //The new spin s
 			spin[v] = (unsigned int)s;
 		}
 		else
 			s = spin[v];
-		
-		#ifdef DEBUG		
+
+		#ifdef DEBUG
 		printf("Spin %d assigned to node %d.\n", s, v);
 		#endif
-			
-		n_cur				=  net->node_list->Get(v);
-		
-		l_cur				= l_iter.First(n_cur->Get_Links());
-		
-		sum_weight_pos_in	= 0.0;
-		sum_weight_pos_out	= 0.0;
-		sum_weight_neg_in	= 0.0;
-		sum_weight_neg_out	= 0.0;
-		
-		while (!l_iter.End())
-		{
-			double w = l_cur->Get_Weight();
-			//av_w = (av_w*l + w)/(l+1); //Average weight
-			//l++;
-			if (l_cur->Get_Start() == n_cur) //From this to other, so outgoing link
-				if (w > 0)
-					sum_weight_pos_out += w;   //Increase positive outgoing weight
-				else
-					sum_weight_neg_out -= w;	//Increase negative outgoing weight
-			else
-				if (w > 0)
-					sum_weight_pos_in += w;   //Increase positive incoming weight
-				else
-					sum_weight_neg_in -= w;	//Increase negative incoming weight			
-			
-			l_cur=l_iter.Next();
-		}
-		
-		if (!is_directed)
-		{
-			double sum_weight_pos		= sum_weight_pos_out + sum_weight_pos_in; 
-				   sum_weight_pos_out	= sum_weight_pos; 
-				   sum_weight_pos_in	= sum_weight_pos;
-			double sum_weight_neg = sum_weight_neg_out + sum_weight_neg_in;
-				   sum_weight_neg_out	= sum_weight_neg; 
-				   sum_weight_neg_in	= sum_weight_neg;			
-		}
-		
-		//av_k = (av_k*l + sum_weight_pos_in)/(l+1); //Average k
-		
-		if (init_spins)
-		{
-			//Set the degrees correctly
-			degree_pos_in[v]	= sum_weight_pos_in;
-			degree_neg_in[v]	= sum_weight_neg_in;
-			degree_pos_out[v]	= sum_weight_pos_out;
-			degree_neg_out[v]	= sum_weight_neg_out;
-		}
-		
+
 		//Correct the community bookkeeping
-		degree_community_pos_in[s]	+= sum_weight_pos_in;
-		degree_community_neg_in[s]	+= sum_weight_neg_in;
-		degree_community_pos_out[s]	+= sum_weight_pos_out;
-		degree_community_neg_out[s]	+= sum_weight_neg_out;
-		
+		degree_community_pos_in[s]	+= degree_pos_in[v];
+		degree_community_neg_in[s]	+= degree_neg_in[v];
+		degree_community_pos_out[s]	+= degree_pos_out[v];
+		degree_community_neg_out[s]	+= degree_neg_out[v];
+
 		//Community just increased
 		csize[s]++;
-	
+
 		//Sum the weights (notice that sum of indegrees equals sum of outdegrees)
-		m_p += sum_weight_pos_in;
-		m_n += sum_weight_neg_in;
+		m_p += degree_pos_in[v];
+		m_n += degree_neg_in[v];
 	}
-	
+
 	#ifdef DEBUG
 	printf("Done assigning.\n");
 	#endif
@@ -1804,11 +1650,6 @@ double PottsModelN::HeatBathLookup(double gamma, double lambda, double t, unsign
 	#ifdef DEBUG
 	printf("Starting sweep at temperature %f.\n", t);
 	#endif
-	DLList_Iter<NNode*> iter;
-	DLList_Iter<NLink*> l_iter;
-	DLList_Iter<unsigned int*> i_iter, i_iter2;
-	NNode *node, *n_cur;
-	NLink *l_cur;
 	/* The new_spin contains the spin to which we will update,
 	 * the spin_opt is the optional spin we will consider and
 	 * the old_spin is the spin of the node we are currently
@@ -1826,9 +1667,6 @@ double PottsModelN::HeatBathLookup(double gamma, double lambda, double t, unsign
 	double delta_pos_out, delta_pos_in, delta_neg_out, delta_neg_in;
 	double k_v_pos_out, k_v_pos_in, k_v_neg_out, k_v_neg_in;
 	
-	//weight of edge
-	double w;
-	
 	double beta = 1/t; //Weight for probabilities
 	double r = 0.0; //random number used for assigning new spin
 	
@@ -1853,11 +1691,9 @@ double PottsModelN::HeatBathLookup(double gamma, double lambda, double t, unsign
 		for (unsigned int n = 0; n < num_nodes; n++)
 		{
 			//Look for a random node
-			v = RNG_INTEGER(0, num_nodes-1);
+			v = igraph_rng_get_integer(rng, 0, num_nodes-1);
 			//We will be investigating node v
 			
-			node=net->node_list->Get(v);
-			
 			/*******************************************/
 			// initialize the neighbours and the weights
 			problemcount=0;
@@ -1867,18 +1703,10 @@ double PottsModelN::HeatBathLookup(double gamma, double lambda, double t, unsign
 			}
 
 			//Loop over all links (=neighbours)
-			l_cur=l_iter.First(node->Get_Links());
-			while (!l_iter.End())
+			for (unsigned long k = link_start[v]; k < link_start[v+1]; k++)
 			{
-				w=l_cur->Get_Weight();
-				if (node==l_cur->Get_Start()) {
-					n_cur=l_cur->Get_End();
-				} else { 
-					n_cur=l_cur->Get_Start(); 
-				}
 				//Add the link to the correct cluster
-				neighbours[spin[n_cur->Get_Index()]]+=w;
-				l_cur=l_iter.Next();
+				neighbours[spin[link_nei[k]]]+=link_weight[k];
 			}
 			//We now have the weight of the (in and out) neighbours 
 			//in each cluster available to us.
@@ -1945,7 +1773,7 @@ double PottsModelN::HeatBathLookup(double gamma, double lambda, double t, unsign
 			
 			/*******************************************/
 			//Choose a new spin dependent on the calculated probabilities
-			r = RNG_UNIF(0, sum_weights);
+			r = igraph_rng_get_unif(rng, 0, sum_weights);
 			new_spin = 1;
 			
 			bool found = false;
@@ -50,6 +50,7 @@
 #include "igraph_types.h"
 #include "igraph_vector.h"
 #include "igraph_matrix.h"
+#include "igraph_random.h"
 
 #define qmax 500
 
@@ -57,10 +58,17 @@ class PottsModel {
   private:
   //  HugeArray<double> neg_gammalookup;
   //  HugeArray<double> pos_gammalookup;
-    DL_Indexed_List<unsigned int*> *new_spins;
-    DL_Indexed_List<unsigned int*> *previous_spins;
+    unsigned int *new_spins;
+    unsigned int *previous_spins;
     HugeArray<HugeArray<double>*> correlation;
     network *net;
+    igraph_rng_t *rng;
+    // the links of the network as flat arrays, see
+    // igraph_i_network_adjacency(), and the weighted degrees
+    unsigned long *link_start, *link_nei;
+    double *link_weight;
+    double *node_weight;
+    unsigned int *spin; // the spin state of each node
     unsigned int q;
     unsigned int operation_mode;
     FILE *Qfile, *Magfile;
@@ -75,10 +83,11 @@ class PottsModel {
     double acceptance;
     double *neighbours;
   public:
-    PottsModel(network *net, unsigned int q, int norm_by_degree);
+    PottsModel(network *net, unsigned int q, int norm_by_degree,
+	       igraph_rng_t *rng=0);
     ~PottsModel();
     double* color_field;
-    unsigned long assign_initial_conf(int spin);
+    unsigned long assign_initial_conf(int init_spin);
     unsigned long initialize_lookup(double kT, double gamma);
     double initialize_Qmatrix(void);
     double calculate_Q(void);
@@ -111,10 +120,13 @@ class PottsModelN {
   private:
   //  HugeArray<double> neg_gammalookup;
   //  HugeArray<double> pos_gammalookup;
-    DL_Indexed_List<unsigned int*> *new_spins;
-    DL_Indexed_List<unsigned int*> *previous_spins;
     HugeArray<HugeArray<double>*> correlation;
     network *net;
+    igraph_rng_t *rng;
+    // the links of the network, see igraph_i_network_adjacency()
+    unsigned long *link_start, *link_nei;
+    double *link_weight;
+    bool *link_out;
 		
     unsigned int q; //number of communities
     double m_p; //number of positive ties (or sum of degrees), this equals the number of edges only if it is undirected and each edge has a weight of 1
@@ -122,8 +134,6 @@ class PottsModelN {
 	unsigned int num_nodes; //number of nodes
 	bool is_directed;
 	
-	bool is_init;
-	
 	double *degree_pos_in; //Postive indegree of the nodes (or sum of weights)
 	double *degree_neg_in; //Negative indegree of the nodes (or sum of weights)
 	double *degree_pos_out; //Postive outdegree of the nodes (or sum of weights)
@@ -141,7 +151,8 @@ class PottsModelN {
     double *weights; //Weights of all possible transitions to another community
 	
   public:
-    PottsModelN(network *n, unsigned int num_communities, bool directed);
+    PottsModelN(network *n, unsigned int num_communities, bool directed,
+		igraph_rng_t *rng=0);
     ~PottsModelN();
     void assign_initial_conf(bool init_spins);
 	double FindStartTemp(double gamma, double lambda, double ts);
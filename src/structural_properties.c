@@ -32,6 +32,8 @@
 #include "igraph_interface.h"
 #include "igraph_progress.h"
 #include "igraph_interrupt_internal.h"
+#include "igraph_parallel_internal.h"
+#include "igraph_paths_internal.h"
 #include "igraph_centrality.h"
 #include "igraph_components.h"
 #include "igraph_constructors.h"
@@ -55,6 +57,155 @@
  * of a graph, like its diameter, the degree of the nodes, etc.</para>
  */
 
+/*
+ * Multi-source shortest path lengths, see igraph_paths_internal.h.
+ * The number of work areas is the number of threads that OpenMP
+ * would use, but at most the number of sources.
+ */
+
+void igraph_i_sssp_destroy(igraph_i_sssp_t *sssp) {
+  int i;
+  if (sssp->threads) {
+    for (i=0; i<sssp->nthreads; i++) {
+      igraph_i_sssp_thread_t *t=&sssp->threads[i];
+      if (t->dist) { igraph_Free(t->dist); }
+      if (t->order) { igraph_Free(t->order); }
+      if (t->Q_init) { igraph_2wheap_destroy(&t->Q); }
+    }
+    igraph_Free(sssp->threads);
+  }
+  igraph_csr_destroy(&sssp->csr);
+}
+
+int igraph_i_sssp_init(igraph_i_sssp_t *sssp, const igraph_t *graph,
+		       const igraph_vector_t *weights, igraph_neimode_t mode,
+		       long int no_of_sources) {
+  long int no_of_nodes=igraph_vcount(graph);
+  long int alloc_nodes= no_of_nodes > 0 ? no_of_nodes : 1;
+  long int i, j;
+
+  IGRAPH_CHECK(igraph_csr_init(graph, &sssp->csr, mode, weights));
+  sssp->nthreads=IGRAPH_I_THREAD_COUNT(no_of_sources);
+  sssp->threads=igraph_Calloc(sssp->nthreads, igraph_i_sssp_thread_t);
+  if (!sssp->threads) {
+    igraph_csr_destroy(&sssp->csr);
+    IGRAPH_ERROR("shortest paths failed", IGRAPH_ENOMEM);
+  }
+  IGRAPH_FINALLY(igraph_i_sssp_destroy, sssp);
+
+  for (i=0; i<sssp->nthreads; i++) {
+    igraph_i_sssp_thread_t *t=&sssp->threads[i];
+    t->dist=igraph_Calloc(alloc_nodes, igraph_real_t);
+    t->order=igraph_Calloc(alloc_nodes, long int);
+    if (!t->dist || !t->order) {
+      IGRAPH_ERROR("shortest paths failed", IGRAPH_ENOMEM);
+    }
+    for (j=0; j<no_of_nodes; j++) {
+      t->dist[j] = -1.0;
+    }
+    if (weights) {
+      IGRAPH_CHECK(igraph_2wheap_init(&t->Q, no_of_nodes));
+      t->Q_init=1;
+      /* Every vertex enters the heap at most once, make sure that
+	 the heap never needs to grow during the search */
+      IGRAPH_CHECK(igraph_vector_reserve(&t->Q.data, no_of_nodes));
+      IGRAPH_CHECK(igraph_vector_long_reserve(&t->Q.index, no_of_nodes));
+    }
+  }
+
+  IGRAPH_FINALLY_CLEAN(1);
+  return 0;
+}
+
+/*
+ * A single-source search. Vertices at distance 'cutoff' or more are
+ * not expanded, if 'cutoff' is not negative. If 'targets' is not a
+ * null pointer, then the search stops after 'no_of_targets' vertices
+ * with non-zero elements in 'targets' were reached. The result is
+ * valid until the next search in the same work area. Returns the
+ * number of reached vertices.
+ */
+
+long int igraph_i_sssp(igraph_i_sssp_t *sssp, int thread, long int source,
+		       igraph_real_t cutoff, const igraph_real_t *targets,
+		       long int no_of_targets) {
+  const igraph_csr_t *csr=&sssp->csr;
+  igraph_i_sssp_thread_t *t=&sssp->threads[thread];
+  igraph_real_t *dist=t->dist;
+  long int *order=t->order;
+  long int i, j, nlen, head=0, tail=0, found=0;
+
+  /* Forget about the previous search */
+  for (i=0; i<t->reached; i++) {
+    dist[order[i]] = -1.0;
+  }
+
+  if (!csr->weighted) {
+
+    order[tail++]=source;
+    dist[source]=0;
+    while (head < tail) {
+      long int act=order[head++];
+      igraph_real_t actdist=dist[act];
+      const int *neis;
+      if (targets && targets[act] && ++found == no_of_targets) { break; }
+      if (cutoff >= 0 && actdist >= cutoff) { continue; }
+      neis=igraph_csr_neis(csr, act);
+      nlen=igraph_csr_degree(csr, act);
+      for (j=0; j<nlen; j++) {
+	long int neighbor=neis[j];
+	if (dist[neighbor] >= 0) { continue; }
+	dist[neighbor]=actdist+1;
+	order[tail++]=neighbor;
+      }
+    }
+
+  } else {
+
+    igraph_2wheap_t *Q=&t->Q;
+
+    /* The heap has enough space reserved, pushing cannot fail */
+    igraph_2wheap_push_with_index(Q, source, 0);
+    dist[source]=0;
+    while (!igraph_2wheap_empty(Q)) {
+      long int minnei=igraph_2wheap_max_index(Q);
+      igraph_real_t mindist=-igraph_2wheap_delete_max(Q);
+      const int *neis;
+      const igraph_real_t *w;
+      order[tail++]=minnei;
+      if (targets && targets[minnei] && ++found == no_of_targets) { break; }
+      if (cutoff >= 0 && mindist >= cutoff) { continue; }
+      neis=igraph_csr_neis(csr, minnei);
+      w=igraph_csr_weights(csr, minnei);
+      nlen=igraph_csr_degree(csr, minnei);
+      for (j=0; j<nlen; j++) {
+	long int to=neis[j];
+	igraph_real_t altdist=mindist + w[j];
+	igraph_real_t curdist=dist[to];
+	if (curdist < 0) {
+	  /* This is the first finite distance */
+	  dist[to]=altdist;
+	  igraph_2wheap_push_with_index(Q, to, -altdist);
+	} else if (altdist < curdist) {
+	  /* This is a shorter path */
+	  dist[to]=altdist;
+	  igraph_2wheap_modify(Q, to, -altdist);
+	}
+      }
+    }
+
+    /* If we stopped early, the vertices left in the heap were not
+       reached yet */
+    while (!igraph_2wheap_empty(Q)) {
+      dist[igraph_2wheap_max_index(Q)] = -1.0;
+      igraph_2wheap_delete_max(Q);
+    }
+  }
+
+  t->reached=tail;
+  return tail;
+}
+
 /**
  * \ingroup structural
  * \function igraph_diameter
@@ -94,67 +245,88 @@ int igraph_diameter(const igraph_t *graph, igraph_integer_t *pres,
 		    igraph_bool_t directed, igraph_bool_t unconn) {
 
   long int no_of_nodes=igraph_vcount(graph);
-  long int i, j, n;
-  long int *already_added;
-  long int nodes_reached;
   long int from=0, to=0;
-  long int res=0;
-
-  igraph_dqueue_t q=IGRAPH_DQUEUE_NULL;
-  igraph_vector_int_t *neis;
+  igraph_real_t res=0;
   igraph_neimode_t dirmode;
-  igraph_adjlist_t allneis;
+  igraph_i_sssp_t sssp;
+  igraph_bool_t disconnected=0;
+  long int first, chunk;
   
   if (directed) { dirmode=IGRAPH_OUT; } else { dirmode=IGRAPH_ALL; }
-  already_added=igraph_Calloc(no_of_nodes, long int);
-  if (already_added==0) {
-    IGRAPH_ERROR("diameter failed", IGRAPH_ENOMEM);
-  }
-  IGRAPH_FINALLY(igraph_free, already_added);
-  IGRAPH_DQUEUE_INIT_FINALLY(&q, 100);
-  
-  IGRAPH_CHECK(igraph_adjlist_init(graph, &allneis, dirmode));
-  IGRAPH_FINALLY(igraph_adjlist_destroy, &allneis);
-  
-  for (i=0; i<no_of_nodes; i++) {
-    nodes_reached=1;
-    IGRAPH_CHECK(igraph_dqueue_push(&q, i));
-    IGRAPH_CHECK(igraph_dqueue_push(&q, 0));
-    already_added[i]=i+1;
 
-    IGRAPH_PROGRESS("Diameter: ", 100.0*i/no_of_nodes, NULL);
+  IGRAPH_CHECK(igraph_i_sssp_init(&sssp, graph, 0, dirmode, no_of_nodes));
+  IGRAPH_FINALLY(igraph_i_sssp_destroy, &sssp);
+  
+  chunk=IGRAPH_I_PARALLEL_CHUNK(sssp.nthreads);
+  for (first=0; first<no_of_nodes && !disconnected; first+=chunk) {
+    long int last= first+chunk < no_of_nodes ? first+chunk : no_of_nodes;
+    IGRAPH_PROGRESS("Diameter: ", 100.0*first/no_of_nodes, 0);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(sssp.nthreads)
+#endif
+    {
+      int thread=IGRAPH_I_THREAD_NUM();
+      igraph_i_sssp_thread_t *t=&sssp.threads[thread];
+      igraph_real_t my_res=0;
+      long int my_from=0, my_to=0, i, k;
+      igraph_bool_t my_disconnected=0;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+      for (i=first; i<last; i++) {
+	long int reached, far;
+	igraph_real_t ecc;
+	if (my_disconnected) { continue; }
+
+	reached=igraph_i_sssp(&sssp, thread, i, -1, 0, 0);
+
+	/* not connected, return largest possible */
+	if (reached != no_of_nodes && !unconn) {
+	  my_disconnected=1;
+	  continue;
+	}
 
-    IGRAPH_ALLOW_INTERRUPTION();
-    
-    while (!igraph_dqueue_empty(&q)) {
-      long int actnode=(long int) igraph_dqueue_pop(&q);
-      long int actdist=(long int) igraph_dqueue_pop(&q);
-      if (actdist>res) { 
-        res=actdist; 
-        from=i;
-        to=actnode;
+	/* The first of the farthest vertices, in BFS order. From the
+	   sources with the same eccentricity, the first one is kept. */
+	ecc=0; far=i;
+	for (k=0; k<reached; k++) {
+	  long int v=t->order[k];
+	  if (t->dist[v] > ecc) {
+	    ecc=t->dist[v];
+	    far=v;
+	  }
+	}
+	if (ecc > my_res || (ecc == my_res && ecc > 0 && i < my_from)) {
+	  my_res=ecc;
+	  my_from=i;
+	  my_to=far;
+	}
       }
-      
-      neis=igraph_adjlist_get(&allneis, actnode);
-      n=igraph_vector_int_size(neis);
-      for (j=0; j<n; j++) {
-	long int neighbor=(long int) VECTOR(*neis)[j];
-	if (already_added[neighbor] == i+1) { continue; }
-	already_added[neighbor]=i+1;
-	nodes_reached++;
-	IGRAPH_CHECK(igraph_dqueue_push(&q, neighbor));
-	IGRAPH_CHECK(igraph_dqueue_push(&q, actdist+1));
+
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+      {
+	if (my_res > res || (my_res == res && my_res > 0 && my_from < from)) {
+	  res=my_res;
+	  from=my_from;
+	  to=my_to;
+	}
+	if (my_disconnected) { disconnected=1; }
       }
-    } /* while !igraph_dqueue_empty */
-    
-    /* not connected, return largest possible */
-    if (nodes_reached != no_of_nodes && !unconn) {
-      res=no_of_nodes;
-      from=-1;
-      to=-1;
-      break;
     }
-  } /* for i<no_of_nodes */
+    IGRAPH_ALLOW_INTERRUPTION();
+  }
+
+
+  igraph_i_sssp_destroy(&sssp);
+  IGRAPH_FINALLY_CLEAN(1);
+
+  if (disconnected) {
+    res=no_of_nodes;
+    from=-1;
+    to=-1;
+  }
 
   IGRAPH_PROGRESS("Diameter: ", 100.0, NULL);
   
@@ -185,12 +357,6 @@ int igraph_diameter(const igraph_t *graph, igraph_integer_t *pres,
     }
   }
   
-  /* clean */
-  igraph_Free(already_added);
-  igraph_dqueue_destroy(&q);
-  igraph_adjlist_destroy(&allneis);
-  IGRAPH_FINALLY_CLEAN(3);
-
   return 0;
 }
 
@@ -222,68 +388,66 @@ int igraph_diameter(const igraph_t *graph, igraph_integer_t *pres,
 int igraph_average_path_length(const igraph_t *graph, igraph_real_t *res,
 			       igraph_bool_t directed, igraph_bool_t unconn) {
   long int no_of_nodes=igraph_vcount(graph);
-  long int i, j, n;
-  long int *already_added;
-  long int nodes_reached=0;
-  igraph_real_t normfact=0.0;
-
-  igraph_dqueue_t q=IGRAPH_DQUEUE_NULL;
-  igraph_vector_int_t *neis;
+  igraph_real_t sum=0.0, normfact=0.0;
   igraph_neimode_t dirmode;
-  igraph_adjlist_t allneis;
+  igraph_i_sssp_t sssp;
+  long int first, chunk;
 
-  *res=0;  
   if (directed) { dirmode=IGRAPH_OUT; } else { dirmode=IGRAPH_ALL; }
-  already_added=igraph_Calloc(no_of_nodes, long int);
-  if (already_added==0) {
-    IGRAPH_ERROR("average path length failed", IGRAPH_ENOMEM);
-  }
-  IGRAPH_FINALLY(free, already_added); /* TODO: hack */
-  IGRAPH_DQUEUE_INIT_FINALLY(&q, 100);
 
-  igraph_adjlist_init(graph, &allneis, dirmode);
-  IGRAPH_FINALLY(igraph_adjlist_destroy, &allneis);
+  IGRAPH_CHECK(igraph_i_sssp_init(&sssp, graph, 0, dirmode, no_of_nodes));
+  IGRAPH_FINALLY(igraph_i_sssp_destroy, &sssp);
+
+  /* The partial sums are integers, so they do not depend on the
+     order of the additions */
+  chunk=IGRAPH_I_PARALLEL_CHUNK(sssp.nthreads);
+  for (first=0; first<no_of_nodes; first+=chunk) {
+    long int last= first+chunk < no_of_nodes ? first+chunk : no_of_nodes;
+#ifdef _OPENMP
+#pragma omp parallel num_threads(sssp.nthreads)
+#endif
+    {
+      int thread=IGRAPH_I_THREAD_NUM();
+      igraph_i_sssp_thread_t *t=&sssp.threads[thread];
+      igraph_real_t my_sum=0.0, my_normfact=0.0;
+      long int i, k;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+      for (i=first; i<last; i++) {
+	long int nodes_reached;
+
+	/* the source itself is not counted */
+	nodes_reached=igraph_i_sssp(&sssp, thread, i, -1, 0, 0) - 1;
+	for (k=1; k<=nodes_reached; k++) {
+	  my_sum += t->dist[t->order[k]];
+	}
+	my_normfact += nodes_reached;
 
-  for (i=0; i<no_of_nodes; i++) {
-    nodes_reached=0;
-    IGRAPH_CHECK(igraph_dqueue_push(&q, i));
-    IGRAPH_CHECK(igraph_dqueue_push(&q, 0));
-    already_added[i]=i+1;
+	/* not connected, return largest possible */
+	if (!unconn) {
+	  my_sum += (no_of_nodes * (no_of_nodes-1-nodes_reached));
+	  my_normfact += no_of_nodes-1-nodes_reached;
+	}
+      }
 
-    IGRAPH_ALLOW_INTERRUPTION();
-    
-    while (!igraph_dqueue_empty(&q)) {
-      long int actnode=(long int) igraph_dqueue_pop(&q);
-      long int actdist=(long int) igraph_dqueue_pop(&q);
-    
-      neis=igraph_adjlist_get(&allneis, actnode);
-      n=igraph_vector_int_size(neis);
-      for (j=0; j<n; j++) {
-	long int neighbor=(long int) VECTOR(*neis)[j];
-	if (already_added[neighbor] == i+1) { continue; }
-	already_added[neighbor]=i+1;
-	nodes_reached++;
-	*res += actdist+1;
-	normfact+=1;
-	IGRAPH_CHECK(igraph_dqueue_push(&q, neighbor));
-	IGRAPH_CHECK(igraph_dqueue_push(&q, actdist+1));
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+      {
+	sum += my_sum;
+	normfact += my_normfact;
       }
-    } /* while !igraph_dqueue_empty */
-    
-    /* not connected, return largest possible */
-    if (!unconn) {
-      *res += (no_of_nodes * (no_of_nodes-1-nodes_reached));
-      normfact += no_of_nodes-1-nodes_reached;
-    }    
-  } /* for i<no_of_nodes */
+    }
+    IGRAPH_ALLOW_INTERRUPTION();
+  }
 
-  *res /= normfact;
+
+  *res = sum / normfact;
 
   /* clean */
-  igraph_Free(already_added);
-  igraph_dqueue_destroy(&q);
-  igraph_adjlist_destroy(&allneis);
-  IGRAPH_FINALLY_CLEAN(3);
+  igraph_i_sssp_destroy(&sssp);
+  IGRAPH_FINALLY_CLEAN(1);
 
   return 0;
 }
@@ -319,65 +483,66 @@ int igraph_path_length_hist(const igraph_t *graph, igraph_vector_t *res,
 			    igraph_real_t *unconnected, igraph_bool_t directed) {
 
   long int no_of_nodes=igraph_vcount(graph);
-  long int i,j,n;
-  igraph_vector_long_t already_added;
-  long int nodes_reached;
-  
-  igraph_dqueue_t q=IGRAPH_DQUEUE_NULL;
-  igraph_vector_int_t *neis;
+  long int i, j;
   igraph_neimode_t dirmode;
-  igraph_adjlist_t allneis;
+  igraph_i_sssp_t sssp;
+  igraph_matrix_t hist;
   igraph_real_t unconn = 0;
-  long int ressize;
+  long int ressize, first, chunk;
   
   if (directed) { dirmode=IGRAPH_OUT; } else { dirmode=IGRAPH_ALL; }
 
-  IGRAPH_CHECK(igraph_vector_long_init(&already_added, no_of_nodes));
-  IGRAPH_FINALLY(igraph_vector_long_destroy, &already_added);
-  IGRAPH_DQUEUE_INIT_FINALLY(&q, 100);
-  IGRAPH_CHECK(igraph_adjlist_init(graph, &allneis, dirmode));
-  IGRAPH_FINALLY(igraph_adjlist_destroy, &allneis);
-  
-  IGRAPH_CHECK(igraph_vector_resize(res, 0));
-  ressize=0;
-  
-  for (i=0; i<no_of_nodes; i++) {
-    nodes_reached=1;		/* itself */
-    IGRAPH_CHECK(igraph_dqueue_push(&q, i));
-    IGRAPH_CHECK(igraph_dqueue_push(&q, 0));
-    VECTOR(already_added)[i]=i+1;
-    
-    IGRAPH_PROGRESS("Path-hist: ", 100.0*i/no_of_nodes, NULL);
-
-    IGRAPH_ALLOW_INTERRUPTION();
-    
-    while (!igraph_dqueue_empty(&q)) {
-      long int actnode=(long int) igraph_dqueue_pop(&q);
-      long int actdist=(long int) igraph_dqueue_pop(&q);
-      
-      neis=igraph_adjlist_get(&allneis, actnode);
-      n=igraph_vector_int_size(neis);
-      for (j=0; j<n; j++) {
-	long int neighbor=(long int) VECTOR(*neis)[j];
-	if (VECTOR(already_added)[neighbor] == i+1) { continue; }
-	VECTOR(already_added)[neighbor] = i+1;
-	nodes_reached++;
-	if (actdist+1 > ressize) {
-	  IGRAPH_CHECK(igraph_vector_resize(res, actdist+1));
-	  for (; ressize<actdist+1; ressize++) {
-	    VECTOR(*res)[ressize]=0;
-	  }
+  IGRAPH_CHECK(igraph_i_sssp_init(&sssp, graph, 0, dirmode, no_of_nodes));
+  IGRAPH_FINALLY(igraph_i_sssp_destroy, &sssp);
+
+  /* One histogram column and one unconnected count per thread, no
+     path is longer than no_of_nodes-1 */
+  IGRAPH_CHECK(igraph_matrix_init(&hist, no_of_nodes+1, sssp.nthreads));
+  IGRAPH_FINALLY(igraph_matrix_destroy, &hist);
+  
+  chunk=IGRAPH_I_PARALLEL_CHUNK(sssp.nthreads);
+  for (first=0; first<no_of_nodes; first+=chunk) {
+    long int last= first+chunk < no_of_nodes ? first+chunk : no_of_nodes;
+    IGRAPH_PROGRESS("Path-hist: ", 100.0*first/no_of_nodes, 0);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(sssp.nthreads)
+#endif
+    {
+      int thread=IGRAPH_I_THREAD_NUM();
+      igraph_i_sssp_thread_t *t=&sssp.threads[thread];
+      igraph_real_t *my_hist=&MATRIX(hist, 0, thread);
+      long int k;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+      for (i=first; i<last; i++) {
+	long int nodes_reached;
+
+	nodes_reached=igraph_i_sssp(&sssp, thread, i, -1, 0, 0);
+	for (k=1; k<nodes_reached; k++) {
+	  my_hist[(long int) t->dist[t->order[k]] - 1] += 1;
 	}
-	VECTOR(*res)[actdist] += 1;
-
-	IGRAPH_CHECK(igraph_dqueue_push(&q, neighbor));
-	IGRAPH_CHECK(igraph_dqueue_push(&q, actdist+1));
+	my_hist[no_of_nodes] += (no_of_nodes-nodes_reached);
       }
-    } /* while !igraph_dqueue_empty */
+    }
+    IGRAPH_ALLOW_INTERRUPTION();
+  }
 
-    unconn += (no_of_nodes-nodes_reached);
 
-  } /* for i<no_of_nodes */
+  for (j=1; j<sssp.nthreads; j++) {
+    for (i=0; i<=no_of_nodes; i++) {
+      MATRIX(hist, i, 0) += MATRIX(hist, i, j);
+    }
+  }
+  for (ressize=no_of_nodes; ressize>0; ressize--) {
+    if (MATRIX(hist, ressize-1, 0) != 0) { break; }
+  }
+  unconn=MATRIX(hist, no_of_nodes, 0);
+
+  IGRAPH_CHECK(igraph_vector_resize(res, ressize));
+  for (i=0; i<ressize; i++) {
+    VECTOR(*res)[i] = MATRIX(hist, i, 0);
+  }
 
   IGRAPH_PROGRESS("Path-hist: ", 100.0, NULL);
 
@@ -389,10 +554,9 @@ int igraph_path_length_hist(const igraph_t *graph, igraph_vector_t *res,
     unconn /= 2;
   }
 
-  igraph_vector_long_destroy(&already_added);
-  igraph_dqueue_destroy(&q);
-  igraph_adjlist_destroy(&allneis);
-  IGRAPH_FINALLY_CLEAN(3);
+  igraph_matrix_destroy(&hist);
+  igraph_i_sssp_destroy(&sssp);
+  IGRAPH_FINALLY_CLEAN(2);
 
   if (unconnected)
 	*unconnected = unconn;
@@ -400,6 +564,165 @@ int igraph_path_length_hist(const igraph_t *graph, igraph_vector_t *res,
   return 0;
 }
 
+/* Unweighted distances, from a batch of BFS sources */
+
+typedef struct igraph_i_shortest_paths_t {
+  igraph_matrix_t *res;
+  const igraph_real_t *indexv;
+} igraph_i_shortest_paths_t;
+
+static void igraph_i_shortest_paths_visitor(long int first, long int vertex,
+					    long int dist,
+					    igraph_i_msbfs_mask_t sources,
+					    void *extra) {
+  igraph_i_shortest_paths_t *data=(igraph_i_shortest_paths_t *) extra;
+  long int col=vertex;
+  if (data->indexv) {
+    if (!data->indexv[vertex]) { return; }
+    col=(long int) data->indexv[vertex] - 1;
+  }
+  while (sources) {
+    MATRIX(*data->res, first + IGRAPH_I_MSBFS_LOWBIT(sources), col) = dist;
+    sources &= sources-1;
+  }
+}
+
+/* One search per source, the sources are distributed among the
+   threads, and every thread writes the rows of its own sources */
+
+static int igraph_i_shortest_paths_sssp(const igraph_t *graph,
+					igraph_matrix_t *res,
+					const igraph_vector_t *fromv,
+					const igraph_real_t *indexv,
+					long int no_of_to,
+					const igraph_vector_t *weights,
+					igraph_neimode_t mode) {
+
+  long int no_of_from=igraph_vector_size(fromv);
+  long int i, first, chunk;
+  igraph_i_sssp_t sssp;
+
+  IGRAPH_CHECK(igraph_i_sssp_init(&sssp, graph, weights, mode, no_of_from));
+  IGRAPH_FINALLY(igraph_i_sssp_destroy, &sssp);
+
+  chunk=IGRAPH_I_PARALLEL_CHUNK(sssp.nthreads);
+  for (first=0; first<no_of_from; first+=chunk) {
+    long int last= first+chunk < no_of_from ? first+chunk : no_of_from;
+#ifdef _OPENMP
+#pragma omp parallel num_threads(sssp.nthreads)
+#endif
+    {
+      int thread=IGRAPH_I_THREAD_NUM();
+      igraph_i_sssp_thread_t *t=&sssp.threads[thread];
+      long int k;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+      for (i=first; i<last; i++) {
+	long int source=(long int) VECTOR(*fromv)[i], reached;
+
+	if (!indexv) {
+	  reached=igraph_i_sssp(&sssp, thread, source, -1, 0, 0);
+	  for (k=0; k<reached; k++) {
+	    long int v=t->order[k];
+	    MATRIX(*res, i, v) = t->dist[v];
+	  }
+	} else {
+	  reached=igraph_i_sssp(&sssp, thread, source, -1, indexv,
+				no_of_to);
+	  for (k=0; k<reached; k++) {
+	    long int v=t->order[k];
+	    if (indexv[v]) {
+	      MATRIX(*res, i, (long int) indexv[v] - 1) = t->dist[v];
+	    }
+	  }
+	}
+      }
+    }
+    IGRAPH_ALLOW_INTERRUPTION();
+  }
+
+
+  igraph_i_sssp_destroy(&sssp);
+  IGRAPH_FINALLY_CLEAN(1);
+
+  return 0;
+}
+
+/*
+ * The common part of igraph_shortest_paths() and
+ * igraph_shortest_paths_dijkstra(). With many sources, unweighted
+ * distances are computed with the bit-parallel BFS.
+ */
+
+static int igraph_i_shortest_paths(const igraph_t *graph,
+				   igraph_matrix_t *res,
+				   const igraph_vs_t from,
+				   const igraph_vs_t to,
+				   const igraph_vector_t *weights,
+				   igraph_neimode_t mode) {
+
+  long int no_of_nodes=igraph_vcount(graph);
+  long int no_of_from, no_of_to;
+  igraph_bool_t all_to;
+  long int i;
+  igraph_vit_t fromvit, tovit;
+  igraph_vector_t fromv, indexv;
+  igraph_real_t my_infinity=IGRAPH_INFINITY;
+
+  IGRAPH_CHECK(igraph_vit_create(graph, from, &fromvit));
+  IGRAPH_FINALLY(igraph_vit_destroy, &fromvit);
+  IGRAPH_VECTOR_INIT_FINALLY(&fromv, 0);
+  IGRAPH_CHECK(igraph_vit_as_vector(&fromvit, &fromv));
+  no_of_from=IGRAPH_VIT_SIZE(fromvit);
+
+  if ( (all_to=igraph_vs_is_all(&to)) ) {
+    no_of_to=no_of_nodes;
+  } else {
+    IGRAPH_VECTOR_INIT_FINALLY(&indexv, no_of_nodes);
+    IGRAPH_CHECK(igraph_vit_create(graph, to, &tovit));
+    IGRAPH_FINALLY(igraph_vit_destroy, &tovit);
+    no_of_to=IGRAPH_VIT_SIZE(tovit);
+    for (i=0; !IGRAPH_VIT_END(tovit); IGRAPH_VIT_NEXT(tovit)) {
+      long int v=IGRAPH_VIT_GET(tovit);
+      if (VECTOR(indexv)[v]) {
+	IGRAPH_ERROR("Duplicate vertices in `to', this is not allowed", 
+		     IGRAPH_EINVAL);
+      }
+      VECTOR(indexv)[v] = ++i;
+    }
+  }
+
+  IGRAPH_CHECK(igraph_matrix_resize(res, no_of_from, no_of_to));
+  igraph_matrix_fill(res, my_infinity);
+
+  if (!weights && no_of_from > 1) {
+    /* Many BFS sources, do them in batches */
+    igraph_i_shortest_paths_t data;
+    data.res=res;
+    data.indexv= all_to ? 0 : VECTOR(indexv);
+    IGRAPH_CHECK(igraph_i_msbfs(graph, &fromv, mode, /*maxdist=*/ -1,
+				igraph_i_shortest_paths_visitor, &data,
+				/*progress_message=*/ 0));
+  } else {
+    IGRAPH_CHECK(igraph_i_shortest_paths_sssp(graph, res, &fromv, 
+					      all_to ? 0 : VECTOR(indexv),
+					      no_of_to, weights, mode));
+  }
+
+  if (!all_to) {
+    igraph_vit_destroy(&tovit);
+    igraph_vector_destroy(&indexv);
+    IGRAPH_FINALLY_CLEAN(2);
+  }
+
+  igraph_vector_destroy(&fromv);
+  igraph_vit_destroy(&fromvit);
+  IGRAPH_FINALLY_CLEAN(2);
+
+  return 0;
+}
+
 /**
  * \ingroup structural
  * \function igraph_shortest_paths
@@ -455,110 +778,12 @@ int igraph_shortest_paths(const igraph_t *graph, igraph_matrix_t *res,
 			  const igraph_vs_t from, const igraph_vs_t to,
 			  igraph_neimode_t mode) {
 
-  long int no_of_nodes=igraph_vcount(graph);
-  long int no_of_from, no_of_to;
-  long int *already_counted;
-  igraph_adjlist_t adjlist;
-  igraph_dqueue_t q=IGRAPH_DQUEUE_NULL;
-  igraph_vector_int_t *neis;
-  igraph_bool_t all_to;
-
-  long int i, j;
-  igraph_vit_t fromvit, tovit;
-  igraph_real_t my_infinity=IGRAPH_INFINITY;
-  igraph_vector_t indexv;
-
   if (mode != IGRAPH_OUT && mode != IGRAPH_IN && 
       mode != IGRAPH_ALL) {
     IGRAPH_ERROR("Invalid mode argument", IGRAPH_EINVMODE);
   }
 
-  IGRAPH_CHECK(igraph_vit_create(graph, from, &fromvit));
-  IGRAPH_FINALLY(igraph_vit_destroy, &fromvit);
-  no_of_from=IGRAPH_VIT_SIZE(fromvit);
-
-  IGRAPH_CHECK(igraph_adjlist_init(graph, &adjlist, mode));
-  IGRAPH_FINALLY(igraph_adjlist_destroy, &adjlist);
-
-  already_counted=igraph_Calloc(no_of_nodes, long int);
-  if (already_counted==0) {
-    IGRAPH_ERROR("shortest paths failed", IGRAPH_ENOMEM);
-  }
-  IGRAPH_FINALLY(free, already_counted);
-  IGRAPH_DQUEUE_INIT_FINALLY(&q, 100);
-
-  if ( (all_to=igraph_vs_is_all(&to)) ) {
-    no_of_to=no_of_nodes;
-  } else {
-    IGRAPH_VECTOR_INIT_FINALLY(&indexv, no_of_nodes);
-    IGRAPH_CHECK(igraph_vit_create(graph, to, &tovit));
-    IGRAPH_FINALLY(igraph_vit_destroy, &tovit);
-    no_of_to=IGRAPH_VIT_SIZE(tovit);
-    for (i=0; !IGRAPH_VIT_END(tovit); IGRAPH_VIT_NEXT(tovit)) {
-      long int v=IGRAPH_VIT_GET(tovit);
-      if (VECTOR(indexv)[v]) {
-	IGRAPH_ERROR("Duplicate vertices in `to', this is not allowed", 
-		     IGRAPH_EINVAL);
-      }
-      VECTOR(indexv)[v] = ++i;
-    }
-  }
-
-  IGRAPH_CHECK(igraph_matrix_resize(res, no_of_from, no_of_to));
-  igraph_matrix_fill(res, my_infinity);
-
-  for (IGRAPH_VIT_RESET(fromvit), i=0; 
-       !IGRAPH_VIT_END(fromvit); 
-       IGRAPH_VIT_NEXT(fromvit), i++) {
-    long int reached=0;
-    IGRAPH_CHECK(igraph_dqueue_push(&q, IGRAPH_VIT_GET(fromvit)));
-    IGRAPH_CHECK(igraph_dqueue_push(&q, 0));
-    already_counted[ (long int) IGRAPH_VIT_GET(fromvit) ] = i+1;
-    
-    IGRAPH_ALLOW_INTERRUPTION();
-
-    while (!igraph_dqueue_empty(&q)) {
-      long int act=(long int) igraph_dqueue_pop(&q);
-      long int actdist=(long int) igraph_dqueue_pop(&q);
-
-      if (all_to) {
-	MATRIX(*res, i, act)=actdist;
-      } else {
-	if (VECTOR(indexv)[act]) {
-	  MATRIX(*res, i, (long int)(VECTOR(indexv)[act]-1)) = actdist;
-	  reached++;
-	  if (reached==no_of_to) {
-	    igraph_dqueue_clear(&q);
-	    break;
-	  }
-	}
-      }
-      
-      neis = igraph_adjlist_get(&adjlist, act);
-      for (j=0; j<igraph_vector_int_size(neis); j++) {
-        long int neighbor=(long int) VECTOR(*neis)[j];
-        if (already_counted[neighbor] == i+1) { continue; }
-        already_counted[neighbor] = i+1;
-        IGRAPH_CHECK(igraph_dqueue_push(&q, neighbor));
-        IGRAPH_CHECK(igraph_dqueue_push(&q, actdist+1));
-      }
-    }
-  }
-
-  /* Clean */
-  if (!all_to) {
-    igraph_vit_destroy(&tovit);
-    igraph_vector_destroy(&indexv);
-    IGRAPH_FINALLY_CLEAN(2);
-  }
-
-  igraph_Free(already_counted);
-  igraph_dqueue_destroy(&q);
-  igraph_vit_destroy(&fromvit);
-  igraph_adjlist_destroy(&adjlist);
-  IGRAPH_FINALLY_CLEAN(4);
-
-  return 0;
+  return igraph_i_shortest_paths(graph, res, from, to, /*weights=*/ 0, mode);
 }
 
 /**
@@ -2909,17 +3134,32 @@ int igraph_density(const igraph_t *graph, igraph_real_t *res,
  * the calculation is performed, d is the average degree, o is the order.
  */ 
 
+typedef struct igraph_i_neighborhood_size_t {
+  igraph_vector_t *res;
+  long int mindist;
+} igraph_i_neighborhood_size_t;
+
+static void igraph_i_neighborhood_size_visitor(long int first, 
+					       long int vertex,
+					       long int dist,
+					       igraph_i_msbfs_mask_t sources,
+					       void *extra) {
+  igraph_i_neighborhood_size_t *data=(igraph_i_neighborhood_size_t *) extra;
+  if (dist < data->mindist) { return; }
+  while (sources) {
+    VECTOR(*data->res)[first + IGRAPH_I_MSBFS_LOWBIT(sources)] += 1;
+    sources &= sources-1;
+  }
+}
+
 int igraph_neighborhood_size(const igraph_t *graph, igraph_vector_t *res,
 			     igraph_vs_t vids, igraph_integer_t order,
 			     igraph_neimode_t mode,
 			     igraph_integer_t mindist) {
 
-  long int no_of_nodes=igraph_vcount(graph);
-  igraph_dqueue_t q;
   igraph_vit_t vit;
-  long int i, j;
-  long int *added;
-  igraph_vector_t neis;
+  igraph_vector_t vidv;
+  igraph_i_neighborhood_size_t data;
   
   if (order < 0) {
     IGRAPH_ERROR("Negative order in neighborhood size", IGRAPH_EINVAL);
@@ -2930,66 +3170,22 @@ int igraph_neighborhood_size(const igraph_t *graph, igraph_vector_t *res,
 		 IGRAPH_EINVAL);
   }
 
-  added=igraph_Calloc(no_of_nodes, long int);
-  if (added==0) {
-    IGRAPH_ERROR("Cannot calculate neighborhood size", IGRAPH_ENOMEM);
-  }
-  IGRAPH_FINALLY(igraph_free, added);
-  IGRAPH_DQUEUE_INIT_FINALLY(&q, 100);
   IGRAPH_CHECK(igraph_vit_create(graph, vids, &vit));
   IGRAPH_FINALLY(igraph_vit_destroy, &vit);
-  IGRAPH_VECTOR_INIT_FINALLY(&neis, 0);
+  IGRAPH_VECTOR_INIT_FINALLY(&vidv, 0);
+  IGRAPH_CHECK(igraph_vit_as_vector(&vit, &vidv));
   IGRAPH_CHECK(igraph_vector_resize(res, IGRAPH_VIT_SIZE(vit)));
-  
-  for (i=0; !IGRAPH_VIT_END(vit); IGRAPH_VIT_NEXT(vit), i++) {
-    long int node=IGRAPH_VIT_GET(vit);
-    long int size=mindist==0 ? 1 : 0;
-    added[node]=i+1;
-    igraph_dqueue_clear(&q);
-    if (order > 0) {
-      igraph_dqueue_push(&q, node);
-      igraph_dqueue_push(&q, 0);
-    }
-    
-    while (!igraph_dqueue_empty(&q)) {
-      long int actnode=(long int) igraph_dqueue_pop(&q);
-      long int actdist=(long int) igraph_dqueue_pop(&q);
-      long int n;
-      igraph_neighbors(graph, &neis, (igraph_integer_t) actnode, mode);
-      n=igraph_vector_size(&neis);
-
-      if (actdist<order-1) {
-	/* we add them to the q */
-	for (j=0; j<n; j++) {
-	  long int nei=(long int) VECTOR(neis)[j];
-	  if (added[nei] != i+1) {
-	    added[nei]=i+1;
-	    IGRAPH_CHECK(igraph_dqueue_push(&q, nei));
-	    IGRAPH_CHECK(igraph_dqueue_push(&q, actdist+1));
-	    if (actdist+1 >= mindist) { size++; }
-	  }
-	}
-      } else {
-	/* we just count them, but don't add them */
-	for (j=0; j<n; j++) {
-	  long int nei=(long int) VECTOR(neis)[j];
-	  if (added[nei] != i+1) {
-	    added[nei]=i+1;
-	    if (actdist+1 >= mindist) { size++; }
-	  }
-	}
-      }
-
-    } /* while q not empty */
+  igraph_vector_null(res);
 
-    VECTOR(*res)[i]=size;
-  } /* for VIT, i */
+  data.res=res;
+  data.mindist=mindist;
+  IGRAPH_CHECK(igraph_i_msbfs(graph, &vidv, mode, order,
+			      igraph_i_neighborhood_size_visitor, &data,
+			      /*progress_message=*/ 0));
 
-  igraph_vector_destroy(&neis);
+  igraph_vector_destroy(&vidv);
   igraph_vit_destroy(&vit);
-  igraph_dqueue_destroy(&q);
-  igraph_Free(added);
-  IGRAPH_FINALLY_CLEAN(4);
+  IGRAPH_FINALLY_CLEAN(2);
 
   return 0;
 }
@@ -4248,31 +4444,7 @@ int igraph_shortest_paths_dijkstra(const igraph_t *graph,
 				   const igraph_vector_t *weights, 
 				   igraph_neimode_t mode) {
 
-  /* Implementation details. This is the basic Dijkstra algorithm, 
-     with a binary heap. The heap is indexed, i.e. it stores not only
-     the distances, but also which vertex they belong to.
-
-     From now on we use a 2-way heap, so the distances can be queried
-     directly from the heap.
-
-     Dirty tricks:
-     - the opposite of the distance is stored in the heap, as it is a
-       maximum heap and we need a minimum heap.
-     - we don't use IGRAPH_INFINITY in the res matrix during the
-       computation, as IGRAPH_FINITE() might involve a function call 
-       and we want to spare that. -1 will denote infinity instead.
-  */
-  
-  long int no_of_nodes=igraph_vcount(graph);
   long int no_of_edges=igraph_ecount(graph);
-  igraph_2wheap_t Q;
-  igraph_vit_t fromvit, tovit;
-  long int no_of_from, no_of_to;
-  igraph_lazy_inclist_t inclist;
-  long int i,j;
-  igraph_real_t my_infinity=IGRAPH_INFINITY;
-  igraph_bool_t all_to;
-  igraph_vector_t indexv;
 
   if (!weights) {
     return igraph_shortest_paths(graph, res, from, to, mode);
@@ -4281,102 +4453,11 @@ int igraph_shortest_paths_dijkstra(const igraph_t *graph,
   if (igraph_vector_size(weights) != no_of_edges) {
     IGRAPH_ERROR("Weight vector length does not match", IGRAPH_EINVAL);
   }
-  if (igraph_vector_min(weights) < 0) {
+  if (no_of_edges > 0 && igraph_vector_min(weights) < 0) {
     IGRAPH_ERROR("Weight vector must be non-negative", IGRAPH_EINVAL);
   }
 
-  IGRAPH_CHECK(igraph_vit_create(graph, from, &fromvit));
-  IGRAPH_FINALLY(igraph_vit_destroy, &fromvit);
-  no_of_from=IGRAPH_VIT_SIZE(fromvit);
-  
-  IGRAPH_CHECK(igraph_2wheap_init(&Q, no_of_nodes));
-  IGRAPH_FINALLY(igraph_2wheap_destroy, &Q);
-  IGRAPH_CHECK(igraph_lazy_inclist_init(graph, &inclist, mode));
-  IGRAPH_FINALLY(igraph_lazy_inclist_destroy, &inclist);
-
-  if ( (all_to=igraph_vs_is_all(&to)) ) {
-    no_of_to=no_of_nodes;
-  } else {
-    IGRAPH_VECTOR_INIT_FINALLY(&indexv, no_of_nodes);
-    IGRAPH_CHECK(igraph_vit_create(graph, to, &tovit));
-    IGRAPH_FINALLY(igraph_vit_destroy, &tovit);
-    no_of_to=IGRAPH_VIT_SIZE(tovit);
-    for (i=0; !IGRAPH_VIT_END(tovit); IGRAPH_VIT_NEXT(tovit)) {
-      long int v=IGRAPH_VIT_GET(tovit);
-      if (VECTOR(indexv)[v]) {
-	IGRAPH_ERROR("Duplicate vertices in `to', this is not allowed", 
-		     IGRAPH_EINVAL);
-      }
-      VECTOR(indexv)[v] = ++i;
-    }
-  }
-
-  IGRAPH_CHECK(igraph_matrix_resize(res, no_of_from, no_of_to));
-  igraph_matrix_fill(res, my_infinity);
-
-  for (IGRAPH_VIT_RESET(fromvit), i=0; 
-       !IGRAPH_VIT_END(fromvit);
-       IGRAPH_VIT_NEXT(fromvit), i++) {
-    
-    long int reached=0;
-    long int source=IGRAPH_VIT_GET(fromvit);
-    igraph_2wheap_clear(&Q);
-    igraph_2wheap_push_with_index(&Q, source, -1.0);
-    
-    while (!igraph_2wheap_empty(&Q)) {
-      long int minnei=igraph_2wheap_max_index(&Q);
-      igraph_real_t mindist=-igraph_2wheap_deactivate_max(&Q);
-      igraph_vector_t *neis;
-      long int nlen;
-
-      if (all_to) {
-	MATRIX(*res, i, minnei)=mindist-1.0;
-      } else {
-	if (VECTOR(indexv)[minnei]) {
-	  MATRIX(*res, i, (long int)(VECTOR(indexv)[minnei]-1)) = mindist-1.0;
-	  reached++;
-	  if (reached==no_of_to) {
-	    igraph_2wheap_clear(&Q);
-	    break;
-	  }
-	}
-      }
-
-      /* Now check all neighbors of 'minnei' for a shorter path */
-      neis=igraph_lazy_inclist_get(&inclist, (igraph_integer_t) minnei);
-      nlen=igraph_vector_size(neis);
-      for (j=0; j<nlen; j++) {
-	long int edge=(long int) VECTOR(*neis)[j];
-	long int tto=IGRAPH_OTHER(graph, edge, minnei);
-	igraph_real_t altdist=mindist + VECTOR(*weights)[edge];
-	igraph_bool_t active=igraph_2wheap_has_active(&Q, tto);
-	igraph_bool_t has=igraph_2wheap_has_elem(&Q, tto);
-	igraph_real_t curdist= active ? -igraph_2wheap_get(&Q, tto) : 0.0;
-	if (!has) {
-	  /* This is the first non-infinite distance */
-	  IGRAPH_CHECK(igraph_2wheap_push_with_index(&Q, tto, -altdist));
-	} else if (altdist < curdist) {
-	  /* This is a shorter path */
-	  IGRAPH_CHECK(igraph_2wheap_modify(&Q, tto, -altdist));
-	}
-      }
-      
-    } /* !igraph_2wheap_empty(&Q) */
-
-  } /* !IGRAPH_VIT_END(fromvit) */
-
-  if (!all_to) {
-    igraph_vit_destroy(&tovit);
-    igraph_vector_destroy(&indexv);
-    IGRAPH_FINALLY_CLEAN(2);
-  }  
-  
-  igraph_lazy_inclist_destroy(&inclist);
-  igraph_2wheap_destroy(&Q);
-  igraph_vit_destroy(&fromvit);
-  IGRAPH_FINALLY_CLEAN(3);
-  
-  return 0;
+  return igraph_i_shortest_paths(graph, res, from, to, weights, mode);
 }
 
 /**
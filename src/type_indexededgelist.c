@@ -25,13 +25,15 @@
 #include "igraph_interface.h"
 #include "igraph_attributes.h"
 #include "igraph_memory.h"
+#include "igraph_interface_internal.h"
+#include "igraph_qsort.h"
 #include <string.h>		/* memset & co. */
 #include "config.h"
 
 /* Internal functions */
 
-int igraph_i_create_start(igraph_vector_t *res, igraph_vector_t *el, igraph_vector_t *index, 
-			  igraph_integer_t nodes);
+int igraph_i_create_start(igraph_vector_int_t *res, igraph_vector_int_t *el,
+			  igraph_vector_int_t *index, igraph_integer_t nodes);
 
 /**
  * \section about_basic_interface
@@ -123,12 +125,13 @@ int igraph_empty_attrs(igraph_t *graph, igraph_integer_t n, igraph_bool_t direct
 
   graph->n=0;
   graph->directed=directed;
-  IGRAPH_VECTOR_INIT_FINALLY(&graph->from, 0);
-  IGRAPH_VECTOR_INIT_FINALLY(&graph->to, 0);
-  IGRAPH_VECTOR_INIT_FINALLY(&graph->oi, 0);
-  IGRAPH_VECTOR_INIT_FINALLY(&graph->ii, 0);
-  IGRAPH_VECTOR_INIT_FINALLY(&graph->os, 1);
-  IGRAPH_VECTOR_INIT_FINALLY(&graph->is, 1);
+  graph->mapping=0;
+  IGRAPH_VECTOR_INT_INIT_FINALLY(&graph->from, 0);
+  IGRAPH_VECTOR_INT_INIT_FINALLY(&graph->to, 0);
+  IGRAPH_VECTOR_INT_INIT_FINALLY(&graph->oi, 0);
+  IGRAPH_VECTOR_INT_INIT_FINALLY(&graph->ii, 0);
+  IGRAPH_VECTOR_INT_INIT_FINALLY(&graph->os, 1);
+  IGRAPH_VECTOR_INT_INIT_FINALLY(&graph->is, 1);
 
   VECTOR(graph->os)[0]=0;
   VECTOR(graph->is)[0]=0;
@@ -165,16 +168,54 @@ int igraph_destroy(igraph_t *graph) {
 
   IGRAPH_I_ATTRIBUTE_DESTROY(graph);
 
-  igraph_vector_destroy(&graph->from);
-  igraph_vector_destroy(&graph->to);
-  igraph_vector_destroy(&graph->oi);
-  igraph_vector_destroy(&graph->ii);
-  igraph_vector_destroy(&graph->os);
-  igraph_vector_destroy(&graph->is);
+  if (graph->mapping) {
+    /* The vectors are views into the mapping */
+    igraph_i_mapping_release(graph->mapping);
+    graph->mapping=0;
+    return 0;
+  }
+
+  igraph_vector_int_destroy(&graph->from);
+  igraph_vector_int_destroy(&graph->to);
+  igraph_vector_int_destroy(&graph->oi);
+  igraph_vector_int_destroy(&graph->ii);
+  igraph_vector_int_destroy(&graph->os);
+  igraph_vector_int_destroy(&graph->is);
   
   return 0;
 }
 
+/* Copy the index of a memory mapped graph to memory, and release the
+   mapping. Called before every modification of the graph. */
+
+int igraph_i_unmap(igraph_t *graph) {
+  igraph_vector_int_t from, to, oi, ii, os, is;
+
+  if (!graph->mapping) { return 0; }
+
+  IGRAPH_CHECK(igraph_vector_int_copy(&from, &graph->from));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &from);
+  IGRAPH_CHECK(igraph_vector_int_copy(&to, &graph->to));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &to);
+  IGRAPH_CHECK(igraph_vector_int_copy(&oi, &graph->oi));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &oi);
+  IGRAPH_CHECK(igraph_vector_int_copy(&ii, &graph->ii));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &ii);
+  IGRAPH_CHECK(igraph_vector_int_copy(&os, &graph->os));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &os);
+  IGRAPH_CHECK(igraph_vector_int_copy(&is, &graph->is));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &is);
+
+  igraph_i_mapping_release(graph->mapping);
+  graph->mapping=0;
+  graph->from=from; graph->to=to;
+  graph->oi=oi; graph->ii=ii;
+  graph->os=os; graph->is=is;
+
+  IGRAPH_FINALLY_CLEAN(6);
+  return 0;
+}
+
 /**
  * \ingroup interface
  * \function igraph_copy
@@ -204,18 +245,19 @@ int igraph_destroy(igraph_t *graph) {
 int igraph_copy(igraph_t *to, const igraph_t *from) {
   to->n=from->n;
   to->directed=from->directed;
-  IGRAPH_CHECK(igraph_vector_copy(&to->from, &from->from));
-  IGRAPH_FINALLY(igraph_vector_destroy, &to->from);
-  IGRAPH_CHECK(igraph_vector_copy(&to->to, &from->to));
-  IGRAPH_FINALLY(igraph_vector_destroy, &to->to);
-  IGRAPH_CHECK(igraph_vector_copy(&to->oi, &from->oi));
-  IGRAPH_FINALLY(igraph_vector_destroy, &to->oi);
-  IGRAPH_CHECK(igraph_vector_copy(&to->ii, &from->ii));
-  IGRAPH_FINALLY(igraph_vector_destroy, &to->ii);
-  IGRAPH_CHECK(igraph_vector_copy(&to->os, &from->os));
-  IGRAPH_FINALLY(igraph_vector_destroy, &to->os);
-  IGRAPH_CHECK(igraph_vector_copy(&to->is, &from->is));
-  IGRAPH_FINALLY(igraph_vector_destroy, &to->is);
+  to->mapping=0;
+  IGRAPH_CHECK(igraph_vector_int_copy(&to->from, &from->from));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &to->from);
+  IGRAPH_CHECK(igraph_vector_int_copy(&to->to, &from->to));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &to->to);
+  IGRAPH_CHECK(igraph_vector_int_copy(&to->oi, &from->oi));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &to->oi);
+  IGRAPH_CHECK(igraph_vector_int_copy(&to->ii, &from->ii));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &to->ii);
+  IGRAPH_CHECK(igraph_vector_int_copy(&to->os, &from->os));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &to->os);
+  IGRAPH_CHECK(igraph_vector_int_copy(&to->is, &from->is));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &to->is);
 
   IGRAPH_I_ATTRIBUTE_COPY(to, from, 1,1,1); /* does IGRAPH_CHECK */
 
@@ -223,6 +265,98 @@ int igraph_copy(igraph_t *to, const igraph_t *from) {
   return 0;
 }
 
+/* Order of the edge index: by the first column, then by the second
+   column, and edges with the same end points in decreasing edge id.
+   This is what igraph_vector_int_order() produces, and the
+   incremental update below must reproduce it exactly. */
+
+typedef struct igraph_i_add_edges_cmp_t {
+  const int *col1, *col2;
+} igraph_i_add_edges_cmp_t;
+
+static int igraph_i_add_edges_cmp(void *extra, const void *a, 
+				  const void *b) {
+  igraph_i_add_edges_cmp_t *data=(igraph_i_add_edges_cmp_t*) extra;
+  int e1=*(const int*) a, e2=*(const int*) b;
+  if (data->col1[e1] != data->col1[e2]) {
+    return data->col1[e1] < data->col1[e2] ? -1 : 1;
+  }
+  if (data->col2[e1] != data->col2[e2]) {
+    return data->col2[e1] < data->col2[e2] ? -1 : 1;
+  }
+  return e1 < e2 ? 1 : (e1 > e2 ? -1 : 0);
+}
+
+/* Sort the ids of the edges no_of_edges, no_of_edges+1, ... by
+   (col1, col2), into 'newidx' which must have the right length. */
+
+static void igraph_i_add_edges_sort(igraph_vector_int_t *newidx,
+				    const igraph_vector_int_t *col1,
+				    const igraph_vector_int_t *col2,
+				    long int no_of_edges) {
+  igraph_i_add_edges_cmp_t data;
+  long int i, n=igraph_vector_int_size(newidx);
+  data.col1=VECTOR(*col1);
+  data.col2=VECTOR(*col2);
+  for (i=0; i<n; i++) {
+    VECTOR(*newidx)[i] = (int) (no_of_edges+i);
+  }
+  igraph_qsort_r(VECTOR(*newidx), (size_t) n, sizeof(int), &data,
+		 igraph_i_add_edges_cmp);
+}
+
+/* Merge the sorted new edges into the index and update the start
+   vector. 'index' must have enough capacity reserved for the new
+   edges, so this cannot fail. The merge goes backwards and in place:
+   the insertion point of each new edge is found with a binary search
+   in the block of its first end point, and the index entries between
+   two insertion points are moved with a single memmove(), so the old
+   index is never compared element by element and entries before the
+   first insertion point are not touched at all. */
+
+static void igraph_i_add_edges_merge(igraph_vector_int_t *index,
+				     igraph_vector_int_t *start,
+				     const igraph_vector_int_t *newidx,
+				     const igraph_vector_int_t *col1,
+				     const igraph_vector_int_t *col2,
+				     long int no_of_nodes) {
+  long int no_of_edges=igraph_vector_int_size(index);
+  long int k=igraph_vector_int_size(newidx);
+  long int end=no_of_edges, j, v;
+  const int *c1=VECTOR(*col1), *c2=VECTOR(*col2);
+  int *idx;
+
+  igraph_vector_int_resize(index, no_of_edges+k); /* reserved */
+  idx=VECTOR(*index);
+
+  for (j=k-1; j>=0; j--) {
+    int e=VECTOR(*newidx)[j];
+    long int lo=VECTOR(*start)[ c1[e] ], hi=VECTOR(*start)[ c1[e]+1 ];
+    /* New edges go before the old ones with the same end points,
+       they have larger ids */
+    while (lo < hi) {
+      long int mid=lo+(hi-lo)/2;
+      if (c2[ idx[mid] ] < c2[e]) {
+	lo=mid+1;
+      } else {
+	hi=mid;
+      }
+    }
+    if (end > lo) {
+      memmove(idx+lo+j+1, idx+lo, sizeof(int) * (size_t) (end-lo));
+    }
+    idx[lo+j]=e;
+    end=lo;
+  }
+
+  /* Every vertex is shifted by the number of new edges in the
+     blocks of the vertices before it */
+  for (v=0, j=0; v<=no_of_nodes; v++) {
+    while (j<k && c1[ VECTOR(*newidx)[j] ] < v) { j++; }
+    VECTOR(*start)[v] += (int) j;
+  }
+}
+
 /**
  * \ingroup interface
  * \function igraph_add_edges
@@ -248,22 +382,31 @@ int igraph_copy(igraph_t *to, const igraph_t *from) {
  * This function invalidates all iterators.
  *
  * </para><para>
+ * If only a few edges are added to a large graph, then the new
+ * edges are sorted on their own and merged into the existing edge
+ * index, instead of sorting the whole edge list again. This makes
+ * adding a stream of small edge batches much cheaper.
+ *
  * Time complexity: O(|V|+|E|) where
  * |V| is the number of vertices and
  * |E| is the number of
- * edges in the \em new, extended graph.
+ * edges in the \em new, extended graph. When the number of new edges,
+ * k, is small compared to |V|+|E|, this is a sequential merge with
+ * O(|V|+|E|+k log k) cost, and the O(|E|) part is only a shift of the
+ * index past the first insertion point.
  * 
  * \example examples/simple/igraph_add_edges.c
  */
 int igraph_add_edges(igraph_t *graph, const igraph_vector_t *edges,
 		     void *attr) {
-  long int no_of_edges=igraph_vector_size(&graph->from);
+  long int no_of_edges=igraph_vector_int_size(&graph->from);
   long int edges_to_add=igraph_vector_size(edges)/2;
   long int i=0;
   igraph_error_handler_t *oldhandler;
   int ret1, ret2;
-  igraph_vector_t newoi, newii;
+  igraph_vector_int_t newoi, newii;
   igraph_bool_t directed=igraph_is_directed(graph);
+  igraph_bool_t incremental;
 
   if (igraph_vector_size(edges) % 2 != 0) {
     IGRAPH_ERROR("invalid (odd) length of edges vector", IGRAPH_EINVEVECTOR);
@@ -272,39 +415,61 @@ int igraph_add_edges(igraph_t *graph, const igraph_vector_t *edges,
     IGRAPH_ERROR("cannot add edges", IGRAPH_EINVVID);
   }
 
+  IGRAPH_CHECK(igraph_i_unmap(graph));
+
   /* from & to */
-  IGRAPH_CHECK(igraph_vector_reserve(&graph->from, no_of_edges+edges_to_add));
-  IGRAPH_CHECK(igraph_vector_reserve(&graph->to  , no_of_edges+edges_to_add));
+  IGRAPH_CHECK(igraph_vector_int_reserve(&graph->from, no_of_edges+edges_to_add));
+  IGRAPH_CHECK(igraph_vector_int_reserve(&graph->to  , no_of_edges+edges_to_add));
 
   while (i<edges_to_add*2) {
-    if (directed || VECTOR(*edges)[i] > VECTOR(*edges)[i+1]) {
-      igraph_vector_push_back(&graph->from, VECTOR(*edges)[i++]); /* reserved */
-      igraph_vector_push_back(&graph->to,   VECTOR(*edges)[i++]); /* reserved */
+    int v1=(int) VECTOR(*edges)[i++];
+    int v2=(int) VECTOR(*edges)[i++];
+    if (directed || v1 > v2) {
+      igraph_vector_int_push_back(&graph->from, v1); /* reserved */
+      igraph_vector_int_push_back(&graph->to,   v2); /* reserved */
     } else {
-      igraph_vector_push_back(&graph->to,   VECTOR(*edges)[i++]); /* reserved */
-      igraph_vector_push_back(&graph->from, VECTOR(*edges)[i++]); /* reserved */
+      igraph_vector_int_push_back(&graph->to,   v1); /* reserved */
+      igraph_vector_int_push_back(&graph->from, v2); /* reserved */
     }      
   }
 
+  /* Merge the new edges into the index if there are only a few of
+     them, otherwise sort everything again, that is linear anyway */
+  incremental = no_of_edges > 0 && 
+    edges_to_add * 16 < no_of_edges + graph->n;
+
   /* disable the error handler temporarily */
   oldhandler=igraph_set_error_handler(igraph_error_handler_ignore);
     
-  /* oi & ii */
-  ret1=igraph_vector_init(&newoi, no_of_edges);
-  ret2=igraph_vector_init(&newii, no_of_edges);
+  /* oi & ii; in incremental mode these are the sorted new edges */
+  ret1=igraph_vector_int_init(&newoi, incremental ? edges_to_add : 
+			      no_of_edges);
+  ret2=igraph_vector_int_init(&newii, incremental ? edges_to_add : 
+			      no_of_edges);
   if (ret1 != 0 || ret2 != 0) {
-    igraph_vector_resize(&graph->from, no_of_edges); /* gets smaller */
-    igraph_vector_resize(&graph->to, no_of_edges);   /* gets smaller */
+    igraph_vector_int_resize(&graph->from, no_of_edges); /* gets smaller */
+    igraph_vector_int_resize(&graph->to, no_of_edges);   /* gets smaller */
     igraph_set_error_handler(oldhandler);
     IGRAPH_ERROR("cannot add edges", IGRAPH_ERROR_SELECT_2(ret1, ret2));
   }  
-  ret1=igraph_vector_order(&graph->from, &graph->to, &newoi, graph->n);
-  ret2=igraph_vector_order(&graph->to  , &graph->from, &newii, graph->n);
+  if (incremental) {
+    ret1=igraph_vector_int_reserve(&graph->oi, no_of_edges+edges_to_add);
+    ret2=igraph_vector_int_reserve(&graph->ii, no_of_edges+edges_to_add);
+    if (ret1 == 0 && ret2 == 0) {
+      igraph_i_add_edges_sort(&newoi, &graph->from, &graph->to, 
+			      no_of_edges);
+      igraph_i_add_edges_sort(&newii, &graph->to, &graph->from, 
+			      no_of_edges);
+    }
+  } else {
+    ret1=igraph_vector_int_order(&graph->from, &graph->to, &newoi, graph->n);
+    ret2=igraph_vector_int_order(&graph->to  , &graph->from, &newii, graph->n);
+  }
   if (ret1 != 0 || ret2 != 0) {
-    igraph_vector_resize(&graph->from, no_of_edges);
-    igraph_vector_resize(&graph->to, no_of_edges);
-    igraph_vector_destroy(&newoi);
-    igraph_vector_destroy(&newii);
+    igraph_vector_int_resize(&graph->from, no_of_edges);
+    igraph_vector_int_resize(&graph->to, no_of_edges);
+    igraph_vector_int_destroy(&newoi);
+    igraph_vector_int_destroy(&newii);
     igraph_set_error_handler(oldhandler);
     IGRAPH_ERROR("cannot add edges", IGRAPH_ERROR_SELECT_2(ret1, ret2));
   }  
@@ -315,22 +480,34 @@ int igraph_add_edges(igraph_t *graph, const igraph_vector_t *edges,
     ret1=igraph_i_attribute_add_edges(graph, edges, attr);
     igraph_set_error_handler(igraph_error_handler_ignore);
     if (ret1 != 0) {
-      igraph_vector_resize(&graph->from, no_of_edges);
-      igraph_vector_resize(&graph->to, no_of_edges);
-      igraph_vector_destroy(&newoi);
-      igraph_vector_destroy(&newii);
+      igraph_vector_int_resize(&graph->from, no_of_edges);
+      igraph_vector_int_resize(&graph->to, no_of_edges);
+      igraph_vector_int_destroy(&newoi);
+      igraph_vector_int_destroy(&newii);
       igraph_set_error_handler(oldhandler);
       IGRAPH_ERROR("cannot add edges", ret1);
     }  
   }
   
+  if (incremental) {
+    /* all memory is reserved, error safe */
+    igraph_i_add_edges_merge(&graph->oi, &graph->os, &newoi, &graph->from,
+			     &graph->to, graph->n);
+    igraph_i_add_edges_merge(&graph->ii, &graph->is, &newii, &graph->to,
+			     &graph->from, graph->n);
+    igraph_vector_int_destroy(&newoi);
+    igraph_vector_int_destroy(&newii);
+    igraph_set_error_handler(oldhandler);
+    return 0;
+  }
+
   /* os & is, its length does not change, error safe */
   igraph_i_create_start(&graph->os, &graph->from, &newoi, graph->n);
   igraph_i_create_start(&graph->is, &graph->to  , &newii, graph->n);
 
   /* everything went fine  */
-  igraph_vector_destroy(&graph->oi);
-  igraph_vector_destroy(&graph->ii);
+  igraph_vector_int_destroy(&graph->oi);
+  igraph_vector_int_destroy(&graph->ii);
   graph->oi=newoi;
   graph->ii=newii;
   igraph_set_error_handler(oldhandler);
@@ -369,11 +546,13 @@ int igraph_add_vertices(igraph_t *graph, igraph_integer_t nv, void *attr) {
     IGRAPH_ERROR("cannot add negative number of vertices", IGRAPH_EINVAL);
   }
 
-  IGRAPH_CHECK(igraph_vector_reserve(&graph->os, graph->n+nv+1));
-  IGRAPH_CHECK(igraph_vector_reserve(&graph->is, graph->n+nv+1));
+  IGRAPH_CHECK(igraph_i_unmap(graph));
+
+  IGRAPH_CHECK(igraph_vector_int_reserve(&graph->os, graph->n+nv+1));
+  IGRAPH_CHECK(igraph_vector_int_reserve(&graph->is, graph->n+nv+1));
   
-  igraph_vector_resize(&graph->os, graph->n+nv+1); /* reserved */
-  igraph_vector_resize(&graph->is, graph->n+nv+1); /* reserved */
+  igraph_vector_int_resize(&graph->os, graph->n+nv+1); /* reserved */
+  igraph_vector_int_resize(&graph->is, graph->n+nv+1); /* reserved */
   for (i=graph->n+1; i<graph->n+nv+1; i++) {
     VECTOR(graph->os)[i]=ec;
     VECTOR(graph->is)[i]=ec;
@@ -420,10 +599,12 @@ int igraph_delete_edges(igraph_t *graph, igraph_es_t edges) {
   long int remaining_edges;
   igraph_eit_t eit;
   
-  igraph_vector_t newfrom, newto, newoi;
+  igraph_vector_int_t newfrom, newto, newoi;
 
   int *mark;
   long int i, j;
+
+  IGRAPH_CHECK(igraph_i_unmap(graph));
   
   mark=igraph_Calloc(no_of_edges, int);
   if (mark==0) {
@@ -447,8 +628,8 @@ int igraph_delete_edges(igraph_t *graph, igraph_es_t edges) {
   igraph_eit_destroy(&eit);
   IGRAPH_FINALLY_CLEAN(1);
 
-  IGRAPH_VECTOR_INIT_FINALLY(&newfrom, remaining_edges);
-  IGRAPH_VECTOR_INIT_FINALLY(&newto, remaining_edges);
+  IGRAPH_VECTOR_INT_INIT_FINALLY(&newfrom, remaining_edges);
+  IGRAPH_VECTOR_INT_INIT_FINALLY(&newto, remaining_edges);
   
   /* Actually remove the edges, move from pos i to pos j in newfrom/newto */
   for (i=0,j=0; j<remaining_edges; i++) {
@@ -460,9 +641,11 @@ int igraph_delete_edges(igraph_t *graph, igraph_es_t edges) {
   }
 
   /* Create index, this might require additional memory */
-  IGRAPH_VECTOR_INIT_FINALLY(&newoi, remaining_edges);
-  IGRAPH_CHECK(igraph_vector_order(&newfrom, &newto, &newoi, no_of_nodes));
-  IGRAPH_CHECK(igraph_vector_order(&newto, &newfrom, &graph->ii, no_of_nodes));
+  IGRAPH_VECTOR_INT_INIT_FINALLY(&newoi, remaining_edges);
+  IGRAPH_CHECK(igraph_vector_int_order(&newfrom, &newto, &newoi, 
+				       (igraph_integer_t) no_of_nodes));
+  IGRAPH_CHECK(igraph_vector_int_order(&newto, &newfrom, &graph->ii, 
+				       (igraph_integer_t) no_of_nodes));
 
   /* Edge attributes, we need an index that gives the ids of the 
      original edges for every new edge. 
@@ -481,9 +664,9 @@ int igraph_delete_edges(igraph_t *graph, igraph_es_t edges) {
   }
 
   /* Ok, we've all memory needed, free the old structure  */
-  igraph_vector_destroy(&graph->from);
-  igraph_vector_destroy(&graph->to);
-  igraph_vector_destroy(&graph->oi);
+  igraph_vector_int_destroy(&graph->from);
+  igraph_vector_int_destroy(&graph->to);
+  igraph_vector_int_destroy(&graph->oi);
   graph->from=newfrom;
   graph->to=newto;
   graph->oi=newoi;
@@ -590,30 +773,33 @@ int igraph_delete_vertices_idx(igraph_t *graph, const igraph_vs_t vertices,
   /* start creating the graph */
   newgraph.n=(igraph_integer_t) remaining_vertices;
   newgraph.directed=graph->directed;  
+  newgraph.mapping=0;
 
   /* allocate vectors */
-  IGRAPH_VECTOR_INIT_FINALLY(&newgraph.from, remaining_edges);
-  IGRAPH_VECTOR_INIT_FINALLY(&newgraph.to, remaining_edges);
-  IGRAPH_VECTOR_INIT_FINALLY(&newgraph.oi, remaining_edges);
-  IGRAPH_VECTOR_INIT_FINALLY(&newgraph.ii, remaining_edges);
-  IGRAPH_VECTOR_INIT_FINALLY(&newgraph.os, remaining_vertices+1);
-  IGRAPH_VECTOR_INIT_FINALLY(&newgraph.is, remaining_vertices+1);
+  IGRAPH_VECTOR_INT_INIT_FINALLY(&newgraph.from, remaining_edges);
+  IGRAPH_VECTOR_INT_INIT_FINALLY(&newgraph.to, remaining_edges);
+  IGRAPH_VECTOR_INT_INIT_FINALLY(&newgraph.oi, remaining_edges);
+  IGRAPH_VECTOR_INT_INIT_FINALLY(&newgraph.ii, remaining_edges);
+  IGRAPH_VECTOR_INT_INIT_FINALLY(&newgraph.os, remaining_vertices+1);
+  IGRAPH_VECTOR_INT_INIT_FINALLY(&newgraph.is, remaining_vertices+1);
   
   /* Add the edges */
   for (i=0, j=0; j<remaining_edges; i++) {
     if (VECTOR(edge_recoding)[i]>0) {
       long int from=(long int) VECTOR(graph->from)[i];
       long int to=(long int) VECTOR(graph->to  )[i];
-      VECTOR(newgraph.from)[j]=VECTOR(*my_vertex_recoding)[from]-1;
-      VECTOR(newgraph.to  )[j]=VECTOR(*my_vertex_recoding)[to]-1;
+      VECTOR(newgraph.from)[j]=(int) VECTOR(*my_vertex_recoding)[from]-1;
+      VECTOR(newgraph.to  )[j]=(int) VECTOR(*my_vertex_recoding)[to]-1;
       j++;
     }
   }
   /* update oi & ii */
-  IGRAPH_CHECK(igraph_vector_order(&newgraph.from, &newgraph.to, &newgraph.oi, 
-				   remaining_vertices));
-  IGRAPH_CHECK(igraph_vector_order(&newgraph.to, &newgraph.from, &newgraph.ii, 
-				   remaining_vertices));  
+  IGRAPH_CHECK(igraph_vector_int_order(&newgraph.from, &newgraph.to, 
+				       &newgraph.oi, (igraph_integer_t)
+				       remaining_vertices));
+  IGRAPH_CHECK(igraph_vector_int_order(&newgraph.to, &newgraph.from, 
+				       &newgraph.ii, (igraph_integer_t)
+				       remaining_vertices));  
 
   IGRAPH_CHECK(igraph_i_create_start(&newgraph.os, &newgraph.from, 
 				     &newgraph.oi, (igraph_integer_t) 
@@ -703,7 +889,7 @@ igraph_integer_t igraph_vcount(const igraph_t *graph) {
  * Time complexity: O(1)
  */
 igraph_integer_t igraph_ecount(const igraph_t *graph) {
-  return (igraph_integer_t) igraph_vector_size(&graph->from);
+  return (igraph_integer_t) igraph_vector_int_size(&graph->from);
 }
 
 /**
@@ -827,46 +1013,125 @@ int igraph_neighbors(const igraph_t *graph, igraph_vector_t *neis, igraph_intege
   return 0;
 }
 
+/* The same as igraph_neighbors(), but the result is an integer
+   vector, so the ids are copied from the index without conversion. */
+
+int igraph_i_neighbors(const igraph_t *graph, igraph_vector_int_t *neis,
+		       igraph_integer_t pnode, igraph_neimode_t mode) {
+
+  long int length=0, idx=0;
+  long int i, j;
+  long int node=pnode;
+  const int *to=VECTOR(graph->to), *from=VECTOR(graph->from);
+  const int *oi=VECTOR(graph->oi), *ii=VECTOR(graph->ii);
+
+  if (node<0 || node>igraph_vcount(graph)-1) {
+    IGRAPH_ERROR("cannot get neighbors", IGRAPH_EINVVID);
+  }
+  if (mode != IGRAPH_OUT && mode != IGRAPH_IN && 
+      mode != IGRAPH_ALL) {
+    IGRAPH_ERROR("cannot get neighbors", IGRAPH_EINVMODE);
+  }
+
+  if (! graph->directed) {
+    mode=IGRAPH_ALL;
+  }
+
+  if (mode & IGRAPH_OUT) {
+    length += (VECTOR(graph->os)[node+1] - VECTOR(graph->os)[node]);
+  }
+  if (mode & IGRAPH_IN) {
+    length += (VECTOR(graph->is)[node+1] - VECTOR(graph->is)[node]);
+  }
+  
+  IGRAPH_CHECK(igraph_vector_int_resize(neis, length));
+  
+  if (!igraph_is_directed(graph) || mode != IGRAPH_ALL) {
+    if (mode & IGRAPH_OUT) {
+      j=VECTOR(graph->os)[node+1];
+      for (i=VECTOR(graph->os)[node]; i<j; i++) {
+	VECTOR(*neis)[idx++] = to[ oi[i] ];
+      }
+    }
+    if (mode & IGRAPH_IN) {
+      j=VECTOR(graph->is)[node+1];
+      for (i=VECTOR(graph->is)[node]; i<j; i++) {
+	VECTOR(*neis)[idx++] = from[ ii[i] ];
+      }
+    }
+  } else {
+    /* merge the sorted out- and in-neighbors */
+    long int jj1=VECTOR(graph->os)[node+1];
+    long int j2=VECTOR(graph->is)[node+1];
+    long int i1=VECTOR(graph->os)[node];
+    long int i2=VECTOR(graph->is)[node];
+    while (i1 < jj1 && i2 < j2) {
+      int n1=to[ oi[i1] ];
+      int n2=from[ ii[i2] ];
+      if (n1<n2) {
+	VECTOR(*neis)[idx++]=n1;
+	i1++;
+      } else if (n1>n2) {
+	VECTOR(*neis)[idx++]=n2;
+	i2++;
+      } else {
+	VECTOR(*neis)[idx++]=n1;
+	VECTOR(*neis)[idx++]=n2;
+	i1++;
+	i2++;
+      }
+    }
+    while (i1 < jj1) {
+      VECTOR(*neis)[idx++]=to[ oi[i1++] ];
+    }
+    while (i2 < j2) {
+      VECTOR(*neis)[idx++]=from[ ii[i2++] ];
+    }
+  }
+
+  return 0;
+}
+
 /**
  * \ingroup internal
  * 
  */
 
-int igraph_i_create_start(igraph_vector_t *res, igraph_vector_t *el, igraph_vector_t *iindex, 
-			  igraph_integer_t nodes) {
+int igraph_i_create_start(igraph_vector_int_t *res, igraph_vector_int_t *el,
+			  igraph_vector_int_t *iindex, igraph_integer_t nodes) {
   
-# define EDGE(i) (VECTOR(*el)[ (long int) VECTOR(*iindex)[(i)] ])
+# define EDGE(i) (VECTOR(*el)[ VECTOR(*iindex)[(i)] ])
   
   long int no_of_nodes;
   long int no_of_edges;
   long int i, j, idx;
   
   no_of_nodes=nodes;
-  no_of_edges=igraph_vector_size(el);
+  no_of_edges=igraph_vector_int_size(el);
   
   /* result */
   
-  IGRAPH_CHECK(igraph_vector_resize(res, nodes+1));
+  IGRAPH_CHECK(igraph_vector_int_resize(res, nodes+1));
   
   /* create the index */
 
-  if (igraph_vector_size(el)==0) {
+  if (no_of_edges==0) {
     /* empty graph */
-    igraph_vector_null(res);
+    igraph_vector_int_null(res);
   } else {
     idx=-1;
     for (i=0; i<=EDGE(0); i++) {
       idx++; VECTOR(*res)[idx]=0;
     }
     for (i=1; i<no_of_edges; i++) {
-      long int n=(long int) (EDGE(i) - EDGE((long int)VECTOR(*res)[idx]));
+      long int n=(long int) (EDGE(i) - EDGE(VECTOR(*res)[idx]));
       for (j=0; j<n; j++) {
-	idx++; VECTOR(*res)[idx]=i;
+	idx++; VECTOR(*res)[idx]=(int) i;
       }
     }
-    j=(long int) EDGE((long int)VECTOR(*res)[idx]);
+    j=(long int) EDGE(VECTOR(*res)[idx]);
     for (i=0; i<no_of_nodes-j; i++) {
-      idx++; VECTOR(*res)[idx]=no_of_edges;
+      idx++; VECTOR(*res)[idx]=(int) no_of_edges;
     }
   }
 
@@ -1707,3 +1972,50 @@ int igraph_incident(const igraph_t *graph, igraph_vector_t *eids,
 
   return 0;
 }
+
+/* The same as igraph_incident(), but the result is an integer
+   vector. */
+
+int igraph_i_incident(const igraph_t *graph, igraph_vector_int_t *eids,
+		      igraph_integer_t pnode, igraph_neimode_t mode) {
+
+  long int length=0, idx=0;
+  long int i, j;
+  long int node=pnode;
+
+  if (node<0 || node>igraph_vcount(graph)-1) {
+    IGRAPH_ERROR("cannot get neighbors", IGRAPH_EINVVID);
+  }
+  if (mode != IGRAPH_OUT && mode != IGRAPH_IN && 
+      mode != IGRAPH_ALL) {
+    IGRAPH_ERROR("cannot get neighbors", IGRAPH_EINVMODE);
+  }
+
+  if (! graph->directed) {
+    mode=IGRAPH_ALL;
+  }
+
+  if (mode & IGRAPH_OUT) {
+    length += (VECTOR(graph->os)[node+1] - VECTOR(graph->os)[node]);
+  }
+  if (mode & IGRAPH_IN) {
+    length += (VECTOR(graph->is)[node+1] - VECTOR(graph->is)[node]);
+  }
+  
+  IGRAPH_CHECK(igraph_vector_int_resize(eids, length));
+  
+  if (mode & IGRAPH_OUT) {
+    j=VECTOR(graph->os)[node+1];
+    for (i=VECTOR(graph->os)[node]; i<j; i++) {
+      VECTOR(*eids)[idx++] = VECTOR(graph->oi)[i];
+    }
+  }
+  if (mode & IGRAPH_IN) {
+    j=VECTOR(graph->is)[node+1];
+    for (i=VECTOR(graph->is)[node]; i<j; i++) {
+      VECTOR(*eids)[idx++] = VECTOR(graph->ii)[i];
+    }
+  }
+
+  return 0;
+}
@@ -285,6 +285,96 @@ int igraph_vector_order1_int(const igraph_vector_t* v,
   return 0;
 }
 
+/**
+ * \ingroup vector
+ * \function igraph_vector_int_order
+ * \brief Calculate the order of the elements in an integer vector.
+ *
+ * </para><para>
+ * This is the same two-key radix sort as \ref igraph_vector_order(),
+ * but it works on integer vectors and uses integer work arrays, so
+ * it needs half the temporary memory. It is used to build the edge
+ * index of \type igraph_t.
+ * \param v The primary key, an \type igraph_vector_int_t object.
+ * \param v2 The secondary key, another \type igraph_vector_int_t object.
+ * \param res An initialized \type igraph_vector_int_t object, it will be
+ *    resized to match the size of \p v. The
+ *    result of the computation will be stored here.
+ * \param nodes The largest element in \p v and \p v2.
+ * \return Error code:
+ *         \c IGRAPH_ENOMEM: out of memory
+ *
+ * Time complexity: O(n+nodes), n is the length of \p v.
+ */
+
+int igraph_vector_int_order(const igraph_vector_int_t* v,
+			    const igraph_vector_int_t *v2,
+			    igraph_vector_int_t* res, igraph_integer_t nodes) {
+  long int edges=igraph_vector_int_size(v);
+  igraph_vector_int_t ptr;
+  igraph_vector_int_t rad;
+  long int i, j;
+
+  assert(v!=NULL);
+  assert(v->stor_begin != NULL);
+
+  IGRAPH_CHECK(igraph_vector_int_init(&ptr, (long int) nodes+1));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &ptr);
+  IGRAPH_CHECK(igraph_vector_int_init(&rad, edges));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &rad);
+  IGRAPH_CHECK(igraph_vector_int_resize(res, edges));
+
+  for (i=0; i<edges; i++) {
+    long int radix=v2->stor_begin[i];
+    if (VECTOR(ptr)[radix]!=0) {
+      VECTOR(rad)[i]=VECTOR(ptr)[radix];
+    }
+    VECTOR(ptr)[radix]=(int) i+1;
+  }
+
+  j=0;
+  for (i=0; i<nodes+1; i++) {
+    if (VECTOR(ptr)[i] != 0) {
+      long int next=VECTOR(ptr)[i]-1;
+      res->stor_begin[j++]=(int) next;
+      while (VECTOR(rad)[next] != 0) {
+	next=VECTOR(rad)[next]-1;
+	res->stor_begin[j++]=(int) next;
+      }
+    }
+  }
+
+  igraph_vector_int_null(&ptr);
+  igraph_vector_int_null(&rad);
+
+  for (i=0; i<edges; i++) {
+    long int edge=VECTOR(*res)[edges-i-1];
+    long int radix=VECTOR(*v)[edge];
+    if (VECTOR(ptr)[radix]!= 0) {
+      VECTOR(rad)[edge]=VECTOR(ptr)[radix];
+    }
+    VECTOR(ptr)[radix]=(int) edge+1;
+  }
+
+  j=0;
+  for (i=0; i<nodes+1; i++) {
+    if (VECTOR(ptr)[i] != 0) {
+      long int next=VECTOR(ptr)[i]-1;
+      res->stor_begin[j++]=(int) next;
+      while (VECTOR(rad)[next] != 0) {
+	next=VECTOR(rad)[next]-1;
+	res->stor_begin[j++]=(int) next;
+      }
+    }
+  }
+
+  igraph_vector_int_destroy(&ptr);
+  igraph_vector_int_destroy(&rad);
+  IGRAPH_FINALLY_CLEAN(2);
+
+  return 0;
+}
+
 int igraph_vector_rank(const igraph_vector_t *v, igraph_vector_t *res,
 		       long int nodes) {
 
@@ -116,6 +116,10 @@ using namespace igraph::walktrap;
  * \sa \ref igraph_community_spinglass(), \ref
  * igraph_community_edge_betweenness(). 
  * 
+ * </para><para>
+ * See \ref igraph_community_walktrap_memory() for a version with a
+ * memory limit.
+ *
  * Time complexity: O(|E||V|^2) in the worst case, O(|V|^2 log|V|) typically, 
  * |V| is the number of vertices, |E| is the number of edges.
  * 
@@ -128,15 +132,82 @@ int igraph_community_walktrap(const igraph_t *graph,
 			      igraph_matrix_t *merges,
 			      igraph_vector_t *modularity, 
 			      igraph_vector_t *membership) {
+  return igraph_community_walktrap_memory(graph, weights, steps,
+					  /*max_memory=*/ -1, merges,
+					  modularity, membership,
+					  /*peak_memory=*/ 0);
+}
+
+/** 
+ * \function igraph_community_walktrap_memory
+ * \brief Walktrap community finding with a memory limit
+ * 
+ * This function is the same as \ref igraph_community_walktrap(), but
+ * it limits the memory used by the probability vectors of the random
+ * walks. Walktrap keeps the probability vectors of the communities it
+ * has computed, in a cache. If the memory use goes over the limit,
+ * then the least recently used vectors are dropped, and they are
+ * computed again from the vertices of the community, if needed
+ * later.
+ * 
+ * </para><para>
+ * If igraph was compiled with OpenMP support, the probability vectors
+ * of the single vertex communities are computed in parallel on large
+ * graphs, as long as they fit into the memory limit. Every thread
+ * needs a work area of about 20 bytes per vertex. The result does
+ * not depend on the number of threads, but with a memory limit it
+ * may slightly differ from the result without one, because the
+ * recomputed vectors are rounded differently.
+ * 
+ * \param graph The input graph, edge directions are ignored.
+ * \param weights Numeric vector giving the weights of the edges. 
+ *     If it is a NULL pointer then all edges will have equal
+ *     weights. The weights are expected to be positive.
+ * \param steps Integer constant, the length of the random walks.
+ * \param max_memory The memory limit, in bytes. It includes the
+ *     graph and the other data structures of the algorithm, these
+ *     are never dropped. Give a negative value for no limit.
+ * \param merges Pointer to a matrix, the merges performed by the
+ *     algorithm will be stored here (if not NULL). See \ref
+ *     igraph_community_walktrap() for its format.
+ * \param modularity Pointer to a vector. If not NULL then the
+ *     modularity score of the current clustering is stored here after
+ *     each merge operation. 
+ * \param membership Pointer to a vector. If not a NULL pointer, then
+ *     the membership vector corresponding to the maximal modularity
+ *     score is stored here. If it is not a NULL pointer, then neither
+ *     \p modularity nor \p merges may be NULL.
+ * \param peak_memory Pointer to a real, if not NULL, then the peak
+ *     memory use of the algorithm, in bytes, is stored here.
+ * \return Error code.
+ * 
+ * \sa \ref igraph_community_walktrap().
+ * 
+ * Time complexity: O(|E||V|^2) in the worst case, O(|V|^2 log|V|) typically, 
+ * |V| is the number of vertices, |E| is the number of edges. With a
+ * small memory limit, the probability vectors may be computed many
+ * times.
+ */
+
+int igraph_community_walktrap_memory(const igraph_t *graph, 
+				     const igraph_vector_t *weights,
+				     int steps, igraph_real_t max_memory,
+				     igraph_matrix_t *merges,
+				     igraph_vector_t *modularity, 
+				     igraph_vector_t *membership,
+				     igraph_real_t *peak_memory) {
 
   long int no_of_nodes=(long int)igraph_vcount(graph);
   int length=steps;
-  long max_memory=-1;
+  long max_mem= max_memory < 0 ? -1 : (long) max_memory;
 
   if (membership && !(modularity && merges)) {
     IGRAPH_ERROR("Cannot calculate membership without modularity or merges",
 		 IGRAPH_EINVAL);
   }
+  if (weights && igraph_vector_size(weights) != igraph_ecount(graph)) {
+    IGRAPH_ERROR("Invalid weight vector length", IGRAPH_EINVAL);
+  }
 
   Graph* G = new Graph;
   if (G->convert_from_igraph(graph, weights))
@@ -152,13 +223,17 @@ int igraph_community_walktrap(const igraph_t *graph,
     IGRAPH_CHECK(igraph_vector_resize(modularity, no_of_nodes));
 	igraph_vector_null(modularity);
   }
-  Communities C(G, length, max_memory, merges, modularity);
+  Communities C(G, length, max_mem, merges, modularity);
   
   while (!C.H->is_empty()) {
     IGRAPH_ALLOW_INTERRUPTION();
     C.merge_nearest_communities();
   }
   
+  if (peak_memory) {
+    *peak_memory = C.peak_memory;
+  }
+
   delete G;
 
   if (membership) {
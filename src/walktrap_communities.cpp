@@ -58,22 +58,43 @@
 #include <iostream>
 #include <cmath>
 #include <algorithm>
+#include <climits>
 
 #include "config.h"
+#include "igraph_parallel_internal.h"
 
 namespace igraph {
 
 namespace walktrap {
 
-IGRAPH_THREAD_LOCAL int Probabilities::length = 0;
-IGRAPH_THREAD_LOCAL Communities* Probabilities::C = 0;
-IGRAPH_THREAD_LOCAL float* Probabilities::tmp_vector1 = 0;
-IGRAPH_THREAD_LOCAL float* Probabilities::tmp_vector2 = 0;
-IGRAPH_THREAD_LOCAL int* Probabilities::id = 0;
-IGRAPH_THREAD_LOCAL int* Probabilities::vertices1 = 0;
-IGRAPH_THREAD_LOCAL int* Probabilities::vertices2 = 0;
-IGRAPH_THREAD_LOCAL int Probabilities::current_id = 0;
+/* The probability vectors of the single vertex communities are
+   computed in advance, in parallel, on graphs with at least this many
+   vertices. */
+#define WALKTRAP_PARALLEL_MIN 10000
+/* Number of vertices in a block of the parallel computation */
+#define WALKTRAP_BLOCK 65536
+
+Walk_work::Walk_work(int nb_vertices) {
+  tmp_vector1 = new float[nb_vertices];
+  tmp_vector2 = new float[nb_vertices];
+  id = new int[nb_vertices];
+  for(int i = 0; i < nb_vertices; i++) id[i] = 0;
+  vertices1 = new int[nb_vertices];
+  vertices2 = new int[nb_vertices];
+  current_id = 0;
+}
 
+Walk_work::~Walk_work() {
+  delete[] tmp_vector1;
+  delete[] tmp_vector2;
+  delete[] id;
+  delete[] vertices1;
+  delete[] vertices2;
+}
+
+static long walk_work_memory(int nb_vertices) {
+  return sizeof(Walk_work) + long(nb_vertices)*(2*sizeof(float) + 3*sizeof(int));
+}
 
 Neighbor::Neighbor() {
   next_community1 = 0;
@@ -81,19 +102,30 @@ Neighbor::Neighbor() {
   next_community2 = 0;	     
   previous_community2 = 0;
   heap_index = -1;
+  exact_delta_sigma = -1.;
 }
 
 Probabilities::~Probabilities() {
-  C->memory_used -= memory();
   if(P) delete[] P;
   if(vertices) delete[] vertices;
 }
 
-Probabilities::Probabilities(int community) {
+Probabilities::Probabilities(const Communities* C, Walk_work* W, int community) {
   Graph* G = C->G;
+  int length = C->length;
+  float* tmp_vector1 = W->tmp_vector1;
+  float* tmp_vector2 = W->tmp_vector2;
+  int* id = W->id;
+  int* vertices1 = W->vertices1;
+  int* vertices2 = W->vertices2;
   int nb_vertices1 = 0;
   int nb_vertices2 = 0;
 
+  if(W->current_id > INT_MAX - length - 1) {
+    for(int i = 0; i < G->nb_vertices; i++) id[i] = 0;
+    W->current_id = 0;
+  }
+
   float initial_proba = 1./float(C->communities[community].size);
   int last =  C->members[C->communities[community].last_member];  
   for(int m = C->communities[community].first_member; m != last; m = C->members[m]) {
@@ -102,7 +134,7 @@ Probabilities::Probabilities(int community) {
   }
   
   for(int t = 0; t < length; t++) {
-    current_id++;    
+    int current_id = ++W->current_id;
     if(nb_vertices1 > (G->nb_vertices/2)) {
       nb_vertices2 = G->nb_vertices;
       for(int i = 0; i < G->nb_vertices; i++)
@@ -170,19 +202,19 @@ Probabilities::Probabilities(int community) {
     P = new float[nb_vertices1];
     size = nb_vertices1;
     vertices = new int[nb_vertices1];
-    int j = 0;
-    for(int i = 0; i < G->nb_vertices; i++) {
-      if(id[i] == current_id) {
-	P[j] = tmp_vector1[i]/sqrt(G->vertices[i].total_weight);
-	vertices[j] = i;
-	j++;
-      }
+    // the vertices reached by the walk, in increasing order
+    sort(vertices1, vertices1 + nb_vertices1);
+    for(int j = 0; j < nb_vertices1; j++) {
+      int i = vertices1[j];
+      P[j] = tmp_vector1[i]/sqrt(G->vertices[i].total_weight);
+      vertices[j] = i;
     }
   }
-  C->memory_used += memory();
 }
 
-Probabilities::Probabilities(int community1, int community2) {
+Probabilities::Probabilities(const Communities* C, Walk_work* W, int community1, int community2) {
+  float* tmp_vector1 = W->tmp_vector1;
+  int* vertices1 = W->vertices1;
   // The two following probability vectors must exist.
   // Do not call this function if it is not the case.
   Probabilities* P1 = C->communities[community1].P;
@@ -284,8 +316,6 @@ Probabilities::Probabilities(int community1, int community2) {
       }
     }
   }
-
-  C->memory_used += memory();
 }
 
 double Probabilities::compute_distance(const Probabilities* P2) const {
@@ -360,6 +390,8 @@ long Probabilities::memory() {
 
 Community::Community() {
   P = 0;
+  previous_used = -1;
+  next_used = -1;
   first_neighbor = 0;
   last_neighbor = 0;
   sub_community_of = -1;
@@ -374,6 +406,10 @@ Community::~Community() {
   if(P) delete P;
 }
 
+static double delta_sigma(const Probabilities* P1, const Probabilities* P2,
+			  int size1, int size2) {
+  return P1->compute_distance(P2)*double(size1)*double(size2)/double(size1 + size2);
+}
 
 Communities::Communities(Graph* graph, int random_walks_length, 
 			 long m, igraph_matrix_t *pmerges,
@@ -384,17 +420,11 @@ Communities::Communities(Graph* graph, int random_walks_length,
   merges=pmerges;
   mergeidx=0;
   modularity=pmodularity;
+  length = random_walks_length;
   
-  Probabilities::C = this;
-  Probabilities::length = random_walks_length;
-  Probabilities::tmp_vector1 = new float[G->nb_vertices];
-  Probabilities::tmp_vector2 = new float[G->nb_vertices];
-  Probabilities::id = new int[G->nb_vertices];
-  for(int i = 0; i < G->nb_vertices; i++) Probabilities::id[i] = 0;
-  Probabilities::vertices1 = new int[G->nb_vertices];
-  Probabilities::vertices2 = new int[G->nb_vertices];
-  Probabilities::current_id = 0;
-
+  work = new Walk_work(G->nb_vertices);
+  first_used = -1;
+  last_used = -1;
   
   members = new int[G->nb_vertices];  
   for(int i = 0; i < G->nb_vertices; i++)
@@ -405,10 +435,6 @@ Communities::Communities(Graph* graph, int random_walks_length,
 
 // init the n single vertex communities
 
-  if(max_memory != -1)
-    min_delta_sigma = new Min_delta_sigma_heap(G->nb_vertices*2);
-  else min_delta_sigma = 0;
-  
   for(int i = 0; i < G->nb_vertices; i++) {
     communities[i].this_community = i;
     communities[i].first_member = i;
@@ -434,61 +460,103 @@ Communities::Communities(Graph* graph, int random_walks_length,
 	add_neighbor(N);
       }
 
-  if(max_memory != -1) {
-    memory_used += min_delta_sigma->memory();
-    memory_used += 2*long(G->nb_vertices)*sizeof(Community);
-    memory_used += long(G->nb_vertices)*(2*sizeof(float) + 3*sizeof(int)); // the static data of Probabilities class
-    memory_used += H->memory() + long(G->nb_edges)*sizeof(Neighbor);
-    memory_used += G->memory();    
+  Q = 0.;
+  if(modularity) {
+    for(int i = 0; i < G->nb_vertices; i++)
+      Q += (communities[i].internal_weight - communities[i].total_weight*communities[i].total_weight/G->total_weight)/G->total_weight;
   }
 
-/*   int c = 0; */
+  memory_used += 2*long(G->nb_vertices)*sizeof(Community);
+  memory_used += long(G->nb_vertices)*sizeof(int);	// the members
+  memory_used += walk_work_memory(G->nb_vertices);
+  memory_used += H->memory() + long(G->nb_edges)*sizeof(Neighbor);
+  memory_used += G->memory();    
+  peak_memory = memory_used;
+
   Neighbor* N = H->get_first();  
   if (N == 0)
     return;   /* this can happen if there are no edges */
+
+  if(G->nb_vertices >= WALKTRAP_PARALLEL_MIN)
+    compute_initial_probabilities();
+
   while(!N->exact) {
-    update_neighbor(N, compute_delta_sigma(N->community1, N->community2));
+    if(N->exact_delta_sigma >= 0.)
+      update_neighbor(N, N->exact_delta_sigma);
+    else
+      update_neighbor(N, compute_delta_sigma(N->community1, N->community2));
     N->exact = true;
     N = H->get_first();
-    if(max_memory != -1) manage_memory();
     /* TODO: this could use igraph_progress */
-/*     if(!silent) { */
-/*       c++; */
-/*       for(int k = (500*(c-1))/G->nb_edges + 1; k <= (500*c)/G->nb_edges; k++) { */
-/* 	if(k % 50 == 1) {cerr.width(2); cerr << endl << k/ 5 << "% ";} */
-/* 	cerr << "."; */
-/*       } */
-/*     } */
   }
   
 }
 
+/* Compute the probability vectors of the single vertex communities
+   and the exact delta sigma of their neighbors in advance, in
+   parallel. The vectors are computed in blocks of vertices, and
+   stored as long as they fit in the memory limit, the others are
+   computed later, when needed. The result does not depend on the
+   number of threads. */
+void Communities::compute_initial_probabilities() {
+  int n = G->nb_vertices;
+  int nthreads = IGRAPH_I_THREAD_COUNT(n / 1024);
+  long work_memory = (nthreads - 1)*walk_work_memory(n);
+  Walk_work** works = new Walk_work*[nthreads];
+  works[0] = work;
+  for(int t = 1; t < nthreads; t++) works[t] = new Walk_work(n);
+  int block_size = n < WALKTRAP_BLOCK ? n : WALKTRAP_BLOCK;
+  Probabilities** block = new Probabilities*[block_size];
+  memory_used += work_memory + long(block_size)*sizeof(Probabilities*);
+  if(memory_used > peak_memory) peak_memory = memory_used;
+
+  for(int first = 0; first < n; first += block_size) {
+    int last = first + block_size < n ? first + block_size : n;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic, 64)
+#endif
+    for(int i = first; i < last; i++)
+      block[i - first] = new Probabilities(this, works[IGRAPH_I_THREAD_NUM()], i);
+    
+    int i = first;
+    for(; i < last && (max_memory == -1 || memory_used + block[i - first]->memory() <= max_memory); i++)
+      store_probabilities(i, block[i - first]);
+    if(i < last) {
+      for(; i < last; i++)
+	delete block[i - first];
+      break;
+    }
+  }
+
+  memory_used -= work_memory + long(block_size)*sizeof(Probabilities*);
+  for(int t = 1; t < nthreads; t++) delete works[t];
+  delete[] works;
+  delete[] block;
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic, 256)
+#endif
+  for(int i = 0; i < n; i++) {
+    if(!communities[i].P) continue;
+    for(Neighbor* N = communities[i].first_neighbor; N != 0;) {
+      if(N->community1 == i) {
+	if(communities[N->community2].P)
+	  N->exact_delta_sigma = delta_sigma(communities[i].P, communities[N->community2].P, 1, 1);
+	N = N->next_community1;
+      }
+      else
+	N = N->next_community2;
+    }
+  }
+}
+
 Communities::~Communities() {
   delete[] members;
   delete[] communities;
   delete H;
-  if(min_delta_sigma) delete min_delta_sigma;
-  
-  delete[] Probabilities::tmp_vector1;
-  delete[] Probabilities::tmp_vector2;
-  delete[] Probabilities::id;
-  delete[] Probabilities::vertices1;
-  delete[] Probabilities::vertices2;
+  delete work;
 }
 
-float Community::min_delta_sigma() {
-  float r = 1.;
-  for(Neighbor* N = first_neighbor; N != 0;) {
-    if(N->delta_sigma < r) r = N->delta_sigma;
-    if(N->community1 == this_community)
-      N = N->next_community1;
-    else
-      N = N->next_community2;
-  }
-  return r;
-}
-
-
 void Community::add_neighbor(Neighbor* N) { // add a new neighbor at the end of the list
   if (last_neighbor) {
     if(last_neighbor->community1 == this_community)
@@ -550,76 +618,68 @@ void Communities::remove_neighbor(Neighbor* N) {
   communities[N->community1].remove_neighbor(N);
   communities[N->community2].remove_neighbor(N);
   H->remove(N);
-
-  if(max_memory !=-1) {
-    if(N->delta_sigma == min_delta_sigma->delta_sigma[N->community1]) {
-      min_delta_sigma->delta_sigma[N->community1] = communities[N->community1].min_delta_sigma();
-      if(communities[N->community1].P) min_delta_sigma->update(N->community1);
-    }
-
-    if(N->delta_sigma == min_delta_sigma->delta_sigma[N->community2]) {
-      min_delta_sigma->delta_sigma[N->community2] = communities[N->community2].min_delta_sigma();
-      if(communities[N->community2].P) min_delta_sigma->update(N->community2);
-    }
-  }
 }
 
 void Communities::add_neighbor(Neighbor* N) {
   communities[N->community1].add_neighbor(N);
   communities[N->community2].add_neighbor(N);
   H->add(N);
+}
 
-  if(max_memory !=-1) {
-    if(N->delta_sigma < min_delta_sigma->delta_sigma[N->community1]) {
-      min_delta_sigma->delta_sigma[N->community1] = N->delta_sigma;
-      if(communities[N->community1].P) min_delta_sigma->update(N->community1);
-    }
+void Communities::update_neighbor(Neighbor* N, float new_delta_sigma) {
+  N->delta_sigma = new_delta_sigma;
+  H->update(N);
+}
 
-    if(N->delta_sigma < min_delta_sigma->delta_sigma[N->community2]) {
-      min_delta_sigma->delta_sigma[N->community2] = N->delta_sigma;
-      if(communities[N->community2].P) min_delta_sigma->update(N->community2);
-    }
-  }
+void Communities::unlink_probabilities(int c) {
+  Community &C = communities[c];
+  if(C.previous_used != -1)
+    communities[C.previous_used].next_used = C.next_used;
+  else
+    first_used = C.next_used;
+  if(C.next_used != -1)
+    communities[C.next_used].previous_used = C.previous_used;
+  else
+    last_used = C.previous_used;
 }
 
-void Communities::update_neighbor(Neighbor* N, float new_delta_sigma) {
-  if(max_memory !=-1) {
-    if(new_delta_sigma < min_delta_sigma->delta_sigma[N->community1]) {
-      min_delta_sigma->delta_sigma[N->community1] = new_delta_sigma;
-      if(communities[N->community1].P) min_delta_sigma->update(N->community1);
-    }
-   
-    if(new_delta_sigma < min_delta_sigma->delta_sigma[N->community2]) {
-      min_delta_sigma->delta_sigma[N->community2] = new_delta_sigma;
-      if(communities[N->community2].P) min_delta_sigma->update(N->community2);
-    }
+void Communities::use_probabilities(int c) {
+  if(c == last_used) return;
+  unlink_probabilities(c);
+  communities[c].previous_used = last_used;
+  communities[c].next_used = -1;
+  communities[last_used].next_used = c;
+  last_used = c;
+}
 
-    float old_delta_sigma = N->delta_sigma;
-    N->delta_sigma = new_delta_sigma;
-    H->update(N);
+void Communities::store_probabilities(int c, Probabilities* P) {
+  communities[c].P = P;
+  communities[c].previous_used = last_used;
+  communities[c].next_used = -1;
+  if(last_used != -1)
+    communities[last_used].next_used = c;
+  else
+    first_used = c;
+  last_used = c;
 
-    if(old_delta_sigma == min_delta_sigma->delta_sigma[N->community1]) {
-      min_delta_sigma->delta_sigma[N->community1] = communities[N->community1].min_delta_sigma();
-      if(communities[N->community1].P) min_delta_sigma->update(N->community1);
-    }
+  memory_used += P->memory();
+  if(memory_used > peak_memory) peak_memory = memory_used;
+}
 
-    if(old_delta_sigma == min_delta_sigma->delta_sigma[N->community2]) {
-      min_delta_sigma->delta_sigma[N->community2] = communities[N->community2].min_delta_sigma();
-      if(communities[N->community2].P) min_delta_sigma->update(N->community2);
-    }
-  }
-  else {
-    N->delta_sigma = new_delta_sigma;
-    H->update(N);
-  }
+void Communities::remove_probabilities(int c) {
+  unlink_probabilities(c);
+  memory_used -= communities[c].P->memory();
+  delete communities[c].P;
+  communities[c].P = 0;
 }
 
-void Communities::manage_memory() {
-  while((memory_used > max_memory) && !min_delta_sigma->is_empty()) {
-    int c = min_delta_sigma->get_max_community();
-    delete communities[c].P;
-    communities[c].P = 0;
-    min_delta_sigma->remove_community(c);
+void Communities::manage_memory(long needed, int c1, int c2) {
+  if(max_memory == -1) return;
+  int c = first_used;
+  while((memory_used + needed > max_memory) && c != -1) {
+    int next = communities[c].next_used;
+    if(c != c1 && c != c2) remove_probabilities(c);
+    c = next;
   }  
 }
 
@@ -647,23 +707,14 @@ void Communities::merge_communities(Neighbor* merge_N) {
 
 // update the new probability vector...
   
-  if(communities[c1].P && communities[c2].P) communities[nb_communities].P = new Probabilities(c1, c2);
-
-  if(communities[c1].P) {
-    delete communities[c1].P; 
-    communities[c1].P = 0;
-    if(max_memory != -1) min_delta_sigma->remove_community(c1);
-  }
-  if(communities[c2].P) {
-    delete communities[c2].P;
-    communities[c2].P = 0;
-    if(max_memory != -1) min_delta_sigma->remove_community(c2);
-  }
-
-  if(max_memory != -1) {
-    min_delta_sigma->delta_sigma[c1] = -1.;		    // to avoid to update the min_delta_sigma for these communities
-    min_delta_sigma->delta_sigma[c2] = -1.;		    // 
-    min_delta_sigma->delta_sigma[nb_communities] = -1.;
+  Probabilities* P = 0;
+  if(communities[c1].P && communities[c2].P) P = new Probabilities(this, work, c1, c2);
+
+  if(communities[c1].P) remove_probabilities(c1);
+  if(communities[c2].P) remove_probabilities(c2);
+  if(P) {
+    manage_memory(P->memory());
+    store_probabilities(nb_communities, P);
   }
   
 // update the new neighbors
@@ -775,11 +826,6 @@ void Communities::merge_communities(Neighbor* merge_N) {
     }
   }
 
-  if(max_memory != -1) {
-    min_delta_sigma->delta_sigma[nb_communities] = communities[nb_communities].min_delta_sigma();
-    min_delta_sigma->update(nb_communities);
-  } 
-
   nb_communities++;
   nb_active_communities--;
 }
@@ -787,17 +833,18 @@ void Communities::merge_communities(Neighbor* merge_N) {
 double Communities::merge_nearest_communities() {
   Neighbor* N = H->get_first();  
   while(!N->exact) {
-    update_neighbor(N, compute_delta_sigma(N->community1, N->community2));
+    if(N->exact_delta_sigma >= 0.)
+      update_neighbor(N, N->exact_delta_sigma);
+    else
+      update_neighbor(N, compute_delta_sigma(N->community1, N->community2));
     N->exact = true;
     N = H->get_first();
-    if(max_memory != -1) manage_memory();
   }
 
   double d = N->delta_sigma;
   remove_neighbor(N);
 
   merge_communities(N);
-  if(max_memory != -1) manage_memory();
   
   if (merges) {
     MATRIX(*merges, mergeidx, 0)=N->community1;
@@ -806,11 +853,11 @@ double Communities::merge_nearest_communities() {
   }
 
   if (modularity) {
-    float Q = 0.;
-    for(int i = 0; i < nb_communities; i++) {
-      if(communities[i].sub_community_of == 0) {
-	Q += (communities[i].internal_weight - communities[i].total_weight*communities[i].total_weight/G->total_weight)/G->total_weight;
-      }
+    // the two merged communities are replaced by the new one
+    int c[3] = { N->community1, N->community2, nb_communities - 1 };
+    for(int k = 0; k < 3; k++) {
+      double q = (communities[c[k]].internal_weight - communities[c[k]].total_weight*communities[c[k]].total_weight/G->total_weight)/G->total_weight;
+      Q += (k < 2) ? -q : q;
     }
     VECTOR(*modularity)[mergeidx]=Q;
   }
@@ -828,16 +875,18 @@ double Communities::merge_nearest_communities() {
 }
 
 double Communities::compute_delta_sigma(int community1, int community2) {
-  if(!communities[community1].P) {
-    communities[community1].P = new Probabilities(community1);
-    if(max_memory != -1) min_delta_sigma->update(community1);
-  }
-  if(!communities[community2].P) {
-    communities[community2].P = new Probabilities(community2);
-    if(max_memory != -1) min_delta_sigma->update(community2);
+  for(int k = 0; k < 2; k++) {
+    int c = k == 0 ? community1 : community2;
+    if(!communities[c].P) {
+      Probabilities* P = new Probabilities(this, work, c);
+      manage_memory(P->memory(), community1, community2);
+      store_probabilities(c, P);
+    }
+    else
+      use_probabilities(c);
   }
   
-  return communities[community1].P->compute_distance(communities[community2].P)*double(communities[community1].size)*double(communities[community2].size)/double(communities[community1].size + communities[community2].size);
+  return delta_sigma(communities[community1].P, communities[community2].P, communities[community1].size, communities[community2].size);
 }
 
 } }    /* end of namespaces */
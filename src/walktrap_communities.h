@@ -68,27 +68,30 @@ namespace igraph {
 namespace walktrap {
 
 class Communities;
-class Probabilities {
-public:
-  static IGRAPH_THREAD_LOCAL float* tmp_vector1;	// 
-  static IGRAPH_THREAD_LOCAL float* tmp_vector2;	// 
-  static IGRAPH_THREAD_LOCAL int* id;	    // 
-  static IGRAPH_THREAD_LOCAL int* vertices1;    //
-  static IGRAPH_THREAD_LOCAL int* vertices2;    //  
-  static IGRAPH_THREAD_LOCAL int current_id;    // 
 
-  static IGRAPH_THREAD_LOCAL Communities* C;				    // pointer to all the communities
-  static IGRAPH_THREAD_LOCAL int length;					    // length of the random walks
+class Walk_work {	// work area of the random walks, one per thread
+public:
+  float* tmp_vector1;	// 
+  float* tmp_vector2;	// 
+  int* id;		// 
+  int* vertices1;	//
+  int* vertices2;	//  
+  int current_id;	// 
+
+  Walk_work(int nb_vertices);
+  ~Walk_work();
+};
 
-  
+class Probabilities {
+public:
   int size;						    // number of probabilities stored
   int* vertices;					    // the vertices corresponding to the stored probabilities, 0 if all the probabilities are stored
   float* P;						    // the probabilities
   
   long memory();					    // the memory (in Bytes) used by the object
   double compute_distance(const Probabilities* P2) const;   // compute the squared distance r^2 between this probability vector and P2
-  Probabilities(int community);				    // compute the probability vector of a community
-  Probabilities(int community1, int community2);	    // merge the probability vectors of two communities in a new one
+  Probabilities(const Communities* C, Walk_work* W, int community);	// compute the probability vector of a community
+  Probabilities(const Communities* C, Walk_work* W, int community1, int community2);	// merge the probability vectors of two communities in a new one
 							    // the two communities must have their probability vectors stored
 							    
   ~Probabilities();					    // destructor
@@ -106,6 +109,8 @@ public:
   int size;			// number of members of the community
   
   Probabilities* P;		// the probability vector, 0 if not stored.  
+  int previous_used;		// the communities with a stored probability vector
+  int next_used;		// in a list, from the least recently used one
 
 
   float sigma;			// sigma(C) of the community
@@ -120,7 +125,6 @@ public:
   void merge(Community &C1, Community &C2);	// create a new community by merging C1 an C2
   void add_neighbor(Neighbor* N);
   void remove_neighbor(Neighbor* N);
-  float min_delta_sigma();			// compute the minimal delta sigma among all the neighbors of this community
   
   Community();			// create an empty community
   ~Community();			// destructor
@@ -132,11 +136,20 @@ private:
   igraph_matrix_t *merges;
   long int mergeidx;
   igraph_vector_t *modularity;
+  double Q;		// the modularity of the current communities
+  
+  Walk_work* work;	// the work area of the sequential random walks
+  int first_used;	// the least recently used probability vector
+  int last_used;	// the most recently used probability vector
+
+  void compute_initial_probabilities();
+  void unlink_probabilities(int c);
   
 public:
   
   long memory_used;				    // in bytes
-  Min_delta_sigma_heap* min_delta_sigma;    	    // the min delta_sigma of the community with a saved probability vector (for memory management)
+  long peak_memory;				    // the maximum of memory_used
+  int length;					    // length of the random walks
   
   Graph* G;		    // the graph
   int* members;		    // the members of each community represented as a chained list.
@@ -166,7 +179,10 @@ public:
   void add_neighbor(Neighbor* N);
   void update_neighbor(Neighbor* N, float new_delta_sigma);
 
-  void manage_memory();
+  void store_probabilities(int c, Probabilities* P);	// store the probability vector of a community
+  void remove_probabilities(int c);			// delete the probability vector of a community
+  void use_probabilities(int c);			// mark the vector of a community as the most recently used one
+  void manage_memory(long needed, int c1 = -1, int c2 = -1);	// delete the least recently used vectors, except those of c1 and c2, to make room for needed bytes
   
 };
 